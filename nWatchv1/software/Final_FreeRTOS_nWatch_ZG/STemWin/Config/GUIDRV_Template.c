@@ -28,8 +28,9 @@ Full source code is available at: www.segger.com
 We appreciate your understanding and fairness.
 ----------------------------------------------------------------------
 File        : GUIDRV_Template.c
-Purpose     : Template driver, could be used as starting point for new
-              simple display drivers supporting only one color depth.
+Purpose     : Driver for the 8-bit FSMC panel of LCD_nokia1.c, 16bpp
+              indices sent as 3 bytes per pixel, read back from a
+              shadow RAM.
 ---------------------------END-OF-HEADER------------------------------
 */
 
@@ -53,10 +54,18 @@ Purpose     : Template driver, could be used as starting point for new
   */
 
 #include <stddef.h>
+#include <string.h>
 
 #include "LCD_Private.h"
 #include "GUI_Private.h"
 #include "LCD_ConfDefaults.h"
+#include "GUIDRV_Template.h"
+
+#ifndef GUIDRV_TEMPLATE_HOST
+  #include "stm32f4xx.h"
+  #include "LCD_6300.h"
+  #include "lcd_dma.h"
+#endif
 
 /*********************************************************************
 *
@@ -64,47 +73,55 @@ Purpose     : Template driver, could be used as starting point for new
 *
 **********************************************************************
 */
-/*********************************************************************
-*
-*       Macros for MIRROR_, SWAP_ and LUT_
-*/
-#if (!defined (LCD_LUT_COM) && !defined(LCD_LUT_SEG))
-  #if   (!LCD_MIRROR_X && !LCD_MIRROR_Y && !LCD_SWAP_XY) 
-    #define LOG2PHYS_X(x, y) x
-    #define LOG2PHYS_Y(x, y) y
-  #elif (!LCD_MIRROR_X && !LCD_MIRROR_Y &&  LCD_SWAP_XY) 
-    #define LOG2PHYS_X(x, y) y
-    #define LOG2PHYS_Y(x, y) x
-  #elif (!LCD_MIRROR_X &&  LCD_MIRROR_Y && !LCD_SWAP_XY) 
-    #define LOG2PHYS_X(x, y) x
-    #define LOG2PHYS_Y(x, y) LCD_YSIZE - 1 - (y)
-  #elif (!LCD_MIRROR_X &&  LCD_MIRROR_Y &&  LCD_SWAP_XY) 
-    #define LOG2PHYS_X(x, y) y
-    #define LOG2PHYS_Y(x, y) LCD_XSIZE - 1 - (x)
-  #elif ( LCD_MIRROR_X && !LCD_MIRROR_Y && !LCD_SWAP_XY) 
-    #define LOG2PHYS_X(x, y) LCD_XSIZE - 1 - (x)
-    #define LOG2PHYS_Y(x, y) y
-  #elif ( LCD_MIRROR_X && !LCD_MIRROR_Y &&  LCD_SWAP_XY) 
-    #define LOG2PHYS_X(x, y) LCD_YSIZE - 1 - (y)
-    #define LOG2PHYS_Y(x, y) x
-  #elif ( LCD_MIRROR_X &&  LCD_MIRROR_Y && !LCD_SWAP_XY) 
-    #define LOG2PHYS_X(x, y) LCD_XSIZE - 1 - (x)
-    #define LOG2PHYS_Y(x, y) LCD_YSIZE - 1 - (y)
-  #elif ( LCD_MIRROR_X &&  LCD_MIRROR_Y &&  LCD_SWAP_XY) 
-    #define LOG2PHYS_X(x, y) LCD_YSIZE - 1 - (y)
-    #define LOG2PHYS_Y(x, y) LCD_XSIZE - 1 - (x)
-  #endif
+//
+// The orientation is set by MADCTR in LCD_init(), not by the driver
+//
+#if LCD_MIRROR_X || LCD_MIRROR_Y || LCD_SWAP_XY || defined(LCD_LUT_COM) || defined(LCD_LUT_SEG)
+  #error Mirroring and swapping are not supported, use MADCTR
+#endif
+
+//
+// Size of the shadow RAM, XSIZE_PHYS and YSIZE_PHYS of LCDConf.c
+//
+#define SHADOW_XSIZE  320
+#define SHADOW_YSIZE  240
+
+//
+// Bytes per pixel on the bus, in the order of LCD_pixel()
+//
+#define BYTES_PER_PIXEL  3
+#define INDEX_BYTE0(Index) (U8)((Index) << 3)
+#define INDEX_BYTE1(Index) (U8)(((Index) >> 3) & 0xFC)
+#define INDEX_BYTE2(Index) (U8)(((Index) >> 8) & 0xF8)
+
+//
+// Shorter fills are written by the CPU, the DMA setup costs more
+//
+#define FILL_DMA_MIN  16
+
+//
+// Largest DMA transfer, NDTR is 16 bits
+//
+#define DMA_MAX_BYTES  0xFFFF
+
+//
+// Bus access: FSMC and the queue of lcd_dma.c on the target, the
+// framebuffer of LCD_Host.c on the host.
+// DMA_START() queues a transfer and returns its sequence number,
+// DMA_WAIT_SEQ() waits for one transfer and DMA_WAIT() for all.
+//
+#ifdef GUIDRV_TEMPLATE_HOST
+  #define LCD_DATA(Data)                LCDHost_Data(Data)
+  #define DMA_START(pData, NumBytes, Inc) LCDHost_DMA(pData, NumBytes, Inc)
+  #define DMA_WAIT_SEQ(Seq)             LCDHost_WaitSeq(Seq)
+  #define DMA_WAIT()                    LCDHost_Wait()
+  #define SHADOW_SECTION
 #else
-  #if   ( defined (LCD_LUT_COM) && !defined(LCD_LUT_SEG))
-    #define LOG2PHYS_X(x, y) x
-    #define LOG2PHYS_Y(x, y) LCD__aLine2Com0[y]
-  #elif (!defined (LCD_LUT_COM) &&  defined(LCD_LUT_SEG))
-    #define LOG2PHYS_X(x, y) LCD__aCol2Seg0[x]
-    #define LOG2PHYS_Y(x, y) y
-  #elif ( defined (LCD_LUT_COM) &&  defined(LCD_LUT_SEG))
-    #define LOG2PHYS_X(x, y) LCD__aCol2Seg0[x]
-    #define LOG2PHYS_Y(x, y) LCD__aLine2Com0[y]
-  #endif
+  #define LCD_DATA(Data)                LCD_WRITE_DATA = (Data)
+  #define DMA_START(pData, NumBytes, Inc) LCD_DMA_Write(pData, NumBytes, Inc)
+  #define DMA_WAIT_SEQ(Seq)             LCD_DMA_WaitSeq(Seq)
+  #define DMA_WAIT()                    LCD_DMA_Wait()
+  #define SHADOW_SECTION                __attribute((section(".ExRam")))
 #endif
 
 /*********************************************************************
@@ -121,12 +138,131 @@ typedef struct {
   int BitsPerPixel;
 } DRIVER_CONTEXT_TEMPLATE;
 
+/*********************************************************************
+*
+*       Static data
+*
+**********************************************************************
+*/
+//
+// Copy of the display RAM, the panel is too slow to read back
+//
+static U16 _aShadow[SHADOW_XSIZE * SHADOW_YSIZE] SHADOW_SECTION;
+
+//
+// Two bus lines: one is sent by the DMA while the other is converted
+//
+static U8 _aLine[2][SHADOW_XSIZE * BYTES_PER_PIXEL];
+static U32 _aLineSeq[2];
+
 /*********************************************************************
 *
 *       Static functions
 *
 **********************************************************************
 */
+/*********************************************************************
+*
+*       _SetWindow
+*
+* Purpose:
+*   Sets the drawing window and starts RAMWR. The pixels that follow
+*   fill it row by row.
+*/
+static void _SetWindow(int x0, int y0, int x1, int y1) {
+  DMA_WAIT();
+  LCD_area(x0, y0, x1, y1);
+}
+
+/*********************************************************************
+*
+*       _WriteIndex
+*
+* Purpose:
+*   Writes NumPixels of the same index by the CPU.
+*/
+static void _WriteIndex(LCD_PIXELINDEX Index, int NumPixels) {
+  U8 b0, b1, b2;
+
+  b0 = INDEX_BYTE0(Index);
+  b1 = INDEX_BYTE1(Index);
+  b2 = INDEX_BYTE2(Index);
+  while (NumPixels--) {
+    LCD_DATA(b0);
+    LCD_DATA(b1);
+    LCD_DATA(b2);
+  }
+}
+
+/*********************************************************************
+*
+*       _WriteLine
+*
+* Purpose:
+*   Converts a line of indices into bus bytes and starts its DMA. The
+*   two line buffers are used in turn, so the next line is converted
+*   while this one is sent.
+*/
+static void _WriteLine(const U16 * pIndex, int NumPixels) {
+  static int Buffer;
+  U8 * p;
+  int i;
+
+  DMA_WAIT_SEQ(_aLineSeq[Buffer]);
+  p = _aLine[Buffer];
+  for (i = 0; i < NumPixels; i++) {
+    *p++ = INDEX_BYTE0(pIndex[i]);
+    *p++ = INDEX_BYTE1(pIndex[i]);
+    *p++ = INDEX_BYTE2(pIndex[i]);
+  }
+  _aLineSeq[Buffer] = DMA_START(_aLine[Buffer], NumPixels * BYTES_PER_PIXEL, 1);
+  Buffer ^= 1;
+}
+
+/*********************************************************************
+*
+*       _WriteFill
+*
+* Purpose:
+*   Sends NumPixels of the same index to the open window. If the three
+*   bytes of the pixel are the same the DMA source is fixed on one byte,
+*   else a line of the pixel pattern is sent again and again.
+*/
+static void _WriteFill(LCD_PIXELINDEX Index, U32 NumPixels) {
+  U8 * p;
+  U32 NumBytes, n, i;
+
+  if (NumPixels < FILL_DMA_MIN) {
+    _WriteIndex(Index, NumPixels);
+    return;
+  }
+  NumBytes = NumPixels * BYTES_PER_PIXEL;
+  p = _aLine[0];
+  p[0] = INDEX_BYTE0(Index);
+  p[1] = INDEX_BYTE1(Index);
+  p[2] = INDEX_BYTE2(Index);
+  if ((p[0] == p[1]) && (p[1] == p[2])) {
+    while (NumBytes) {
+      n = (NumBytes > DMA_MAX_BYTES) ? DMA_MAX_BYTES : NumBytes;
+      _aLineSeq[0] = DMA_START(p, n, 0);
+      NumBytes -= n;
+    }
+  } else {
+    n = (NumPixels < SHADOW_XSIZE) ? NumPixels : SHADOW_XSIZE;
+    for (i = 1; i < n; i++) {
+      memcpy(p + i * BYTES_PER_PIXEL, p, BYTES_PER_PIXEL);
+    }
+    n *= BYTES_PER_PIXEL;
+    while (NumBytes) {
+      if (n > NumBytes) {
+        n = NumBytes;
+      }
+      _aLineSeq[0] = DMA_START(p, n, 1);
+      NumBytes -= n;
+    }
+  }
+}
+
 /*********************************************************************
 *
 *       _SetPixelIndex
@@ -137,33 +273,10 @@ typedef struct {
 *   that no check on the parameters needs to be performed.
 */
 static void _SetPixelIndex(GUI_DEVICE * pDevice, int x, int y, int PixelIndex) {
-    //
-    // Convert logical into physical coordinates (Dep. on LCDConf.h)
-    //
-    #if (LCD_MIRROR_X == 1) || (LCD_MIRROR_Y == 1) || (LCD_SWAP_XY == 1)
-      int xPhys, yPhys;
-
-      xPhys = LOG2PHYS_X(x, y);
-      yPhys = LOG2PHYS_Y(x, y);
-    #else
-      #define xPhys x
-      #define yPhys y
-    #endif
-    GUI_USE_PARA(pDevice);
-    GUI_USE_PARA(x);
-    GUI_USE_PARA(y);
-    GUI_USE_PARA(PixelIndex);
-    {
-      //
-      // Write into hardware ... Adapt to your system
-      //
-      // TBD by customer...
-      //
-    }
-    #if (LCD_MIRROR_X == 0) && (LCD_MIRROR_Y == 0) && (LCD_SWAP_XY == 0)
-      #undef xPhys
-      #undef yPhys
-    #endif
+  GUI_USE_PARA(pDevice);
+  _SetWindow(x, y, x, y);
+  _WriteIndex(PixelIndex, 1);
+  _aShadow[y * SHADOW_XSIZE + x] = PixelIndex;
 }
 
 /*********************************************************************
@@ -171,40 +284,11 @@ static void _SetPixelIndex(GUI_DEVICE * pDevice, int x, int y, int PixelIndex) {
 *       _GetPixelIndex
 *
 * Purpose:
-*   Returns the index of the given pixel. The upper layers
-*   calling this routine make sure that the coordinates are in range, so
-*   that no check on the parameters needs to be performed.
+*   Returns the index of the given pixel, from the shadow RAM.
 */
 static unsigned int _GetPixelIndex(GUI_DEVICE * pDevice, int x, int y) {
-  unsigned int PixelIndex;
-    //
-    // Convert logical into physical coordinates (Dep. on LCDConf.h)
-    //
-    #if (LCD_MIRROR_X == 1) || (LCD_MIRROR_Y == 1) || (LCD_SWAP_XY == 1)
-      int xPhys, yPhys;
-
-      xPhys = LOG2PHYS_X(x, y);
-      yPhys = LOG2PHYS_Y(x, y);
-    #else
-      #define xPhys x
-      #define yPhys y
-    #endif
-    GUI_USE_PARA(pDevice);
-    GUI_USE_PARA(x);
-    GUI_USE_PARA(y);
-    {
-      //
-      // Write into hardware ... Adapt to your system
-      //
-      // TBD by customer...
-      //
-      PixelIndex = 0;
-    }
-    #if (LCD_MIRROR_X == 0) && (LCD_MIRROR_Y == 0) && (LCD_SWAP_XY == 0)
-      #undef xPhys
-      #undef yPhys
-    #endif
-  return PixelIndex;
+  GUI_USE_PARA(pDevice);
+  return _aShadow[y * SHADOW_XSIZE + x];
 }
 
 /*********************************************************************
@@ -223,25 +307,39 @@ static void _XorPixel(GUI_DEVICE * pDevice, int x, int y) {
 /*********************************************************************
 *
 *       _FillRect
+*
+* Purpose:
+*   One window for the rectangle. The shadow RAM is updated while the
+*   DMA sends the pixels.
 */
 static void _FillRect(GUI_DEVICE * pDevice, int x0, int y0, int x1, int y1) {
   LCD_PIXELINDEX PixelIndex;
-  int x;
+  LCD_PIXELINDEX IndexMask;
+  U16 * pShadow;
+  int x, xSize;
 
-  PixelIndex = LCD__GetColorIndex();
+  xSize = x1 - x0 + 1;
+  _SetWindow(x0, y0, x1, y1);
   if (GUI_pContext->DrawMode & LCD_DRAWMODE_XOR) {
+    IndexMask = pDevice->pColorConvAPI->pfGetIndexMask();
     for (; y0 <= y1; y0++) {
-      for (x = x0; x <= x1; x++) {
-        _XorPixel(pDevice, x, y0);
+      pShadow = &_aShadow[y0 * SHADOW_XSIZE + x0];
+      for (x = 0; x < xSize; x++) {
+        pShadow[x] ^= IndexMask;
       }
+      _WriteLine(pShadow, xSize);
     }
   } else {
+    PixelIndex = LCD__GetColorIndex();
+    _WriteFill(PixelIndex, (U32)xSize * (y1 - y0 + 1));
     for (; y0 <= y1; y0++) {
-      for (x = x0; x <= x1; x++) {
-        _SetPixelIndex(pDevice, x, y0, PixelIndex);
+      pShadow = &_aShadow[y0 * SHADOW_XSIZE + x0];
+      for (x = 0; x < xSize; x++) {
+        pShadow[x] = PixelIndex;
       }
     }
   }
+  DMA_WAIT();
 }
 
 /*********************************************************************
@@ -254,7 +352,7 @@ static void _DrawHLine(GUI_DEVICE * pDevice, int x0, int y, int x1) {
 
 /*********************************************************************
 *
-*       _DrawVLine, not optimized
+*       _DrawVLine
 */
 static void _DrawVLine(GUI_DEVICE * pDevice, int x, int y0, int y1) {
   _FillRect(pDevice, x, y0, x, y1);
@@ -262,315 +360,83 @@ static void _DrawVLine(GUI_DEVICE * pDevice, int x, int y0, int y1) {
 
 /*********************************************************************
 *
-*       Draw Bitmap 1 BPP
-*/
-static void _DrawBitLine1BPP(GUI_DEVICE * pDevice, int x, int y, U8 const GUI_UNI_PTR * p, int Diff, int xsize, const LCD_PIXELINDEX * pTrans) {
-  LCD_PIXELINDEX IndexMask, Index0, Index1, Pixel;
-
-  Index0 = *(pTrans + 0);
-  Index1 = *(pTrans + 1);
-  x += Diff;
-  switch (GUI_pContext->DrawMode & (LCD_DRAWMODE_TRANS | LCD_DRAWMODE_XOR)) {
-  case 0:
-    do {
-      _SetPixelIndex(pDevice, x++, y, (*p & (0x80 >> Diff)) ? Index1 : Index0);
-      if (++Diff == 8) {
-        Diff = 0;
-        p++;
-      }
-    } while (--xsize);
-    break;
-  case LCD_DRAWMODE_TRANS:
-    do {
-      if (*p & (0x80 >> Diff))
-        _SetPixelIndex(pDevice, x, y, Index1);
-      x++;
-      if (++Diff == 8) {
-        Diff = 0;
-        p++;
-      }
-    } while (--xsize);
-    break;
-  case LCD_DRAWMODE_XOR | LCD_DRAWMODE_TRANS:
-  case LCD_DRAWMODE_XOR:
-    IndexMask = pDevice->pColorConvAPI->pfGetIndexMask();
-    do {
-      if (*p & (0x80 >> Diff)) {
-        Pixel = _GetPixelIndex(pDevice, x, y);
-        _SetPixelIndex(pDevice, x, y, Pixel ^ IndexMask);
-      }
-      x++;
-      if (++Diff == 8) {
-        Diff = 0;
-        p++;
-      }
-    } while (--xsize);
-    break;
-  }
-}
-
-/*********************************************************************
+*       _ReadBitLine
 *
-*       Draw Bitmap 2 BPP
-*/
-static void  _DrawBitLine2BPP(GUI_DEVICE * pDevice, int x, int y, U8 const GUI_UNI_PTR * p, int Diff, int xsize, const LCD_PIXELINDEX * pTrans) {
-  LCD_PIXELINDEX Pixels, PixelIndex;
-  int CurrentPixel, Shift, Index;
-
-  Pixels = *p;
-  CurrentPixel = Diff;
-  x += Diff;
-  switch (GUI_pContext->DrawMode & (LCD_DRAWMODE_TRANS | LCD_DRAWMODE_XOR)) {
-  case 0:
-    if (pTrans) {
-      do {
-        Shift = (3 - CurrentPixel) << 1;
-        Index = (Pixels & (0xC0 >> (6 - Shift))) >> Shift;
-        PixelIndex = *(pTrans + Index);
-        _SetPixelIndex(pDevice, x++, y, PixelIndex);
-        if (++CurrentPixel == 4) {
-          CurrentPixel = 0;
-          Pixels = *(++p);
-        }
-      } while (--xsize);
-    } else {
-      do {
-        Shift = (3 - CurrentPixel) << 1;
-        Index = (Pixels & (0xC0 >> (6 - Shift))) >> Shift;
-        _SetPixelIndex(pDevice, x++, y, Index);
-        if (++CurrentPixel == 4) {
-          CurrentPixel = 0;
-          Pixels = *(++p);
-        }
-      } while (--xsize);
-    }
-    break;
-  case LCD_DRAWMODE_TRANS:
-    if (pTrans) {
-      do {
-        Shift = (3 - CurrentPixel) << 1;
-        Index = (Pixels & (0xC0 >> (6 - Shift))) >> Shift;
-        if (Index) {
-          PixelIndex = *(pTrans + Index);
-          _SetPixelIndex(pDevice, x, y, PixelIndex);
-        }
-        x++;
-        if (++CurrentPixel == 4) {
-          CurrentPixel = 0;
-          Pixels = *(++p);
-        }
-      } while (--xsize);
-    } else {
-      do {
-        Shift = (3 - CurrentPixel) << 1;
-        Index = (Pixels & (0xC0 >> (6 - Shift))) >> Shift;
-        if (Index) {
-          _SetPixelIndex(pDevice, x, y, Index);
-        }
-        x++;
-        if (++CurrentPixel == 4) {
-          CurrentPixel = 0;
-          Pixels = *(++p);
-        }
-      } while (--xsize);
-    }
-    break;
-  }
-}
-
-/*********************************************************************
-*
-*       Draw Bitmap 4 BPP
-*/
-static void  _DrawBitLine4BPP(GUI_DEVICE * pDevice, int x, int y, U8 const GUI_UNI_PTR * p, int Diff, int xsize, const LCD_PIXELINDEX * pTrans) {
-  LCD_PIXELINDEX Pixels, PixelIndex;
-  int CurrentPixel, Shift, Index;
-
-  Pixels = *p;
-  CurrentPixel = Diff;
-  x += Diff;
-  switch (GUI_pContext->DrawMode & (LCD_DRAWMODE_TRANS | LCD_DRAWMODE_XOR)) {
-  case 0:
-    if (pTrans) {
-      do {
-        Shift = (1 - CurrentPixel) << 2;
-        Index = (Pixels & (0xF0 >> (4 - Shift))) >> Shift;
-        PixelIndex = *(pTrans + Index);
-        _SetPixelIndex(pDevice, x++, y, PixelIndex);
-        if (++CurrentPixel == 2) {
-          CurrentPixel = 0;
-          Pixels = *(++p);
-        }
-      } while (--xsize);
-    } else {
-      do {
-        Shift = (1 - CurrentPixel) << 2;
-        Index = (Pixels & (0xF0 >> (4 - Shift))) >> Shift;
-        _SetPixelIndex(pDevice, x++, y, Index);
-        if (++CurrentPixel == 2) {
-          CurrentPixel = 0;
-          Pixels = *(++p);
-        }
-      } while (--xsize);
-    }
-    break;
-  case LCD_DRAWMODE_TRANS:
-    if (pTrans) {
-      do {
-        Shift = (1 - CurrentPixel) << 2;
-        Index = (Pixels & (0xF0 >> (4 - Shift))) >> Shift;
-        if (Index) {
-          PixelIndex = *(pTrans + Index);
-          _SetPixelIndex(pDevice, x, y, PixelIndex);
-        }
-        x++;
-        if (++CurrentPixel == 2) {
-          CurrentPixel = 0;
-          Pixels = *(++p);
-        }
-      } while (--xsize);
-    } else {
-      do {
-        Shift = (1 - CurrentPixel) << 2;
-        Index = (Pixels & (0xF0 >> (4 - Shift))) >> Shift;
-        if (Index) {
-          _SetPixelIndex(pDevice, x, y, Index);
-        }
-        x++;
-        if (++CurrentPixel == 2) {
-          CurrentPixel = 0;
-          Pixels = *(++p);
-        }
-      } while (--xsize);
-    }
-    break;
-  }
-}
-
-/*********************************************************************
-*
-*       Draw Bitmap 8 BPP
+* Purpose:
+*   Draws a bitmap line of 1, 2, 4 or 8bpp into the shadow RAM. In
+*   transparent mode the pixels of index 0 keep the shadow value, in
+*   XOR mode the other pixels are inverted.
 */
-static void  _DrawBitLine8BPP(GUI_DEVICE * pDevice, int x, int y, U8 const GUI_UNI_PTR * p, int xsize, const LCD_PIXELINDEX * pTrans) {
-  LCD_PIXELINDEX Pixel;
+static void _ReadBitLine(U16 * pShadow, U8 const GUI_UNI_PTR * p, int Diff, int xSize,
+                         int BitsPerPixel, const LCD_PIXELINDEX * pTrans, LCD_PIXELINDEX IndexMask) {
+  unsigned Mask, Shift, Pixel, Mode;
+  int x;
 
-  switch (GUI_pContext->DrawMode & (LCD_DRAWMODE_TRANS | LCD_DRAWMODE_XOR)) {
-  case 0:
-    if (pTrans) {
-      for (; xsize > 0; xsize--, x++, p++) {
-        Pixel = *p;
-        _SetPixelIndex(pDevice, x, y, *(pTrans + Pixel));
-      }
-    } else {
-      for (; xsize > 0; xsize--, x++, p++) {
-        _SetPixelIndex(pDevice, x, y, *p);
-      }
+  Mode  = GUI_pContext->DrawMode & (LCD_DRAWMODE_TRANS | LCD_DRAWMODE_XOR);
+  Mask  = (1 << BitsPerPixel) - 1;
+  Diff *= BitsPerPixel;
+  for (x = 0; x < xSize; x++) {
+    Shift = 8 - BitsPerPixel - Diff;
+    Pixel = (*p >> Shift) & Mask;
+    Diff += BitsPerPixel;
+    if (Diff == 8) {
+      Diff = 0;
+      p++;
     }
-    break;
-  case LCD_DRAWMODE_TRANS:
-    if (pTrans) {
-      for (; xsize > 0; xsize--, x++, p++) {
-        Pixel = *p;
-        if (Pixel) {
-          _SetPixelIndex(pDevice, x, y, *(pTrans + Pixel));
-        }
-      }
-    } else {
-      for (; xsize > 0; xsize--, x++, p++) {
-        Pixel = *p;
-        if (Pixel) {
-          _SetPixelIndex(pDevice, x, y, Pixel);
-        }
+    if (Mode & LCD_DRAWMODE_XOR) {
+      if (Pixel) {
+        pShadow[x] ^= IndexMask;
       }
+    } else if (Pixel || !(Mode & LCD_DRAWMODE_TRANS)) {
+      pShadow[x] = pTrans ? *(pTrans + Pixel) : Pixel;
     }
-    break;
-  }
-}
-
-/*********************************************************************
-*
-*       Draw Bitmap 16 BPP, not optimized
-*
-* Purpose:
-*   Drawing of 16bpp high color bitmaps.
-*   Only required for 16bpp color depth of target. Should be removed otherwise.
-*/
-static void _DrawBitLine16BPP(GUI_DEVICE * pDevice, int x, int y, U16 const GUI_UNI_PTR * p, int xsize) {
-  for (;xsize > 0; xsize--, x++, p++) {
-    _SetPixelIndex(pDevice, x, y, *p);
   }
 }
 
 /*********************************************************************
 *
-*       Draw Bitmap 32 BPP, not optimized
+*       _DrawBitmap
 *
 * Purpose:
-*   Drawing of 32bpp true color bitmaps.
-*   Only required for 32bpp color depth of target. Should be removed otherwise.
-*/
-static void _DrawBitLine32BPP(GUI_DEVICE * pDevice, int x, int y, U32 const GUI_UNI_PTR * p, int xsize) {
-  for (;xsize > 0; xsize--, x++, p++) {
-    _SetPixelIndex(pDevice, x, y, *p);
-  }
-}
-
-/*********************************************************************
-*
-*       _DrawBitmap
+*   One window for the bitmap. Each line is drawn into the shadow RAM
+*   and sent from there by the DMA, so transparent and XOR pixels need
+*   no extra window.
 */
 static void _DrawBitmap(GUI_DEVICE * pDevice, int x0, int y0,
                        int xSize, int ySize,
-                       int BitsPerPixel, 
+                       int BitsPerPixel,
                        int BytesPerLine,
                        const U8 GUI_UNI_PTR * pData, int Diff,
                        const LCD_PIXELINDEX * pTrans) {
-  int i;
-
-  switch (BitsPerPixel) {
-  case 1:
-    for (i = 0; i < ySize; i++) {
-      _DrawBitLine1BPP(pDevice, x0, i + y0, pData, Diff, xSize, pTrans);
-      pData += BytesPerLine;
-    }
-    break;
-  case 2:
-    for (i = 0; i < ySize; i++) {
-      _DrawBitLine2BPP(pDevice, x0, i + y0, pData, Diff, xSize, pTrans);
-      pData += BytesPerLine;
-    }
-    break;
-  case 4:
-    for (i = 0; i < ySize; i++) {
-      _DrawBitLine4BPP(pDevice, x0, i + y0, pData, Diff, xSize, pTrans);
-      pData += BytesPerLine;
-    }
-    break;
-  case 8:
-    for (i = 0; i < ySize; i++) {
-      _DrawBitLine8BPP(pDevice, x0, i + y0, pData, xSize, pTrans);
-      pData += BytesPerLine;
-    }
-    break;
-  //
-  // Only required for 16bpp color depth of target. Should be removed otherwise.
-  //
-  case 16:
-    for (i = 0; i < ySize; i++) {
-      _DrawBitLine16BPP(pDevice, x0, i + y0, (const U16 *)pData, xSize);
-      pData += BytesPerLine;
-    }
-    break;
-  //
-  // Only required for 32bpp color depth of target. Should be removed otherwise.
-  //
-  case 32:
-    for (i = 0; i < ySize; i++) {
-      _DrawBitLine32BPP(pDevice, x0, i + y0, (const U32 *)pData, xSize);
-      pData += BytesPerLine;
+  LCD_PIXELINDEX IndexMask;
+  U16 * pShadow;
+  int x, y;
+
+  IndexMask = pDevice->pColorConvAPI->pfGetIndexMask();
+  x0 += Diff;
+  _SetWindow(x0, y0, x0 + xSize - 1, y0 + ySize - 1);
+  for (y = 0; y < ySize; y++) {
+    pShadow = &_aShadow[(y0 + y) * SHADOW_XSIZE + x0];
+    switch (BitsPerPixel) {
+    case 1:
+    case 2:
+    case 4:
+    case 8:
+      _ReadBitLine(pShadow, pData, Diff, xSize, BitsPerPixel, pTrans, IndexMask);
+      break;
+    case 16:
+      memcpy(pShadow, pData, xSize * sizeof(U16));
+      break;
+    case 32:
+      for (x = 0; x < xSize; x++) {
+        pShadow[x] = *((const U32 *)pData + x);
+      }
+      break;
     }
-    break;
+    _WriteLine(pShadow, xSize);
+    pData += BytesPerLine;
   }
+  DMA_WAIT();
 }
 
 /*********************************************************************
@@ -638,7 +504,7 @@ static void * _GetDevData(GUI_DEVICE * pDevice, int Index) {
   #if GUI_SUPPORT_MEMDEV
     switch (Index) {
     case LCD_DEVDATA_MEMDEV:
-      return (void *)&GUI_MEMDEV_DEVICE_16; // TBD: Has to be adapted to the right memory device depending on the used color depth!
+      return (void *)&GUI_MEMDEV_DEVICE_16;
     }
   #else
     GUI_USE_PARA(Index);
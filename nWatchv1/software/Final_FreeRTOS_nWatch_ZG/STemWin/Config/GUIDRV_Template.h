@@ -68,6 +68,41 @@ extern const GUI_DEVICE_API GUIDRV_Template_API;
 //
 #define GUIDRV_TEMPLATE            &GUIDRV_Template_API
 
+/*********************************************************************
+*
+*       Host back-end, LCD_Host.c
+*
+* Build with GUIDRV_TEMPLATE_HOST defined to draw into a framebuffer
+* instead of the FSMC, and count the bus writes. The DMA transfers are
+* queued as by lcd_dma.c and timed against the CPU work, in ns.
+*/
+#ifdef GUIDRV_TEMPLATE_HOST
+typedef struct {
+  U32 Windows;   // LCD_area() calls
+  U32 Commands;  // Command bytes
+  U32 Data;      // Data bytes written by the CPU
+  U32 DMAs;      // DMA transfers
+  U32 DMABytes;  // Data bytes written by the DMA
+  U32 Elapsed;   // CPU time since LCDHost_ResetStats()
+  U32 Work;      // CPU time given to LCDHost_Work()
+  U32 Busy;      // DMA transfer time
+  U32 Waited;    // CPU time waiting for the DMA
+  U32 Waits;     // Waits that blocked
+  U32 Overlap;   // DMA transfer time while the CPU ran
+  U32 Conflicts; // CPU bus writes during a DMA transfer
+} LCDHOST_STATS;
+
+void LCD_area      (int x, int y, int x1, int y1);
+void LCDHost_Data  (U8 Data);
+U32  LCDHost_DMA   (const U8 * pData, U32 NumBytes, int Inc);
+void LCDHost_WaitSeq(U32 Seq);
+void LCDHost_Wait  (void);
+void LCDHost_Work  (U32 ns);
+void LCDHost_GetStats(LCDHOST_STATS * pStats);
+void LCDHost_ResetStats(void);
+U32  LCDHost_GetPixel(int x, int y);
+#endif
+
 #endif
 
 /*************************** End of file ****************************/
@@ -76,8 +76,6 @@ Purpose     : Display controller configuration (single layer)
 *
 **********************************************************************
 */
-void FillRect(int LayerIndex, int x0, int y0, int x1, int y1, int PixelIndex);
-
 #ifndef   VXSIZE_PHYS
   #define VXSIZE_PHYS XSIZE_PHYS
 #endif
@@ -95,60 +93,6 @@ void FillRect(int LayerIndex, int x0, int y0, int x1, int y1, int PixelIndex);
 #endif
 
 
-/*********************************************************************
-*
-*       Local functions
-*
-**********************************************************************
-*/
-/********************************************************************
-*
-*       LcdWriteReg
-*
-* Function description:
-*   Sets display register
-*/
-static void LcdWriteReg(U16 Data) {
-  // ... TBD by user
-}
-
-/********************************************************************
-*
-*       LcdWriteData
-*
-* Function description:
-*   Writes a value to a display register
-*/
-static void LcdWriteData(U16 Data) {
-  // ... TBD by user
-}
-
-/********************************************************************
-*
-*       LcdWriteDataMultiple
-*
-* Function description:
-*   Writes multiple values to a display register.
-*/
-static void LcdWriteDataMultiple(U16 * pData, int NumItems) {
-  while (NumItems--) {
-    // ... TBD by user
-  }
-}
-
-/********************************************************************
-*
-*       LcdReadDataMultiple
-*
-* Function description:
-*   Reads multiple values from a display register.
-*/
-static void LcdReadDataMultiple(U16 * pData, int NumItems) {
-  while (NumItems--) {
-    // ... TBD by user
-  }
-}
-
 /*********************************************************************
 *
 *       Public functions
@@ -169,8 +113,6 @@ void LCD_X_Config(void)
   GUI_DEVICE * pDevice;
   GUI_PORT_API PortAPI = {0};
 
-  LCD_SetDevFunc(0, LCD_DEVFUNC_FILLRECT, (void(*)(void))FillRect);
-
   pDevice = GUI_DEVICE_CreateAndLink(GUIDRV_TEMPLATE, GUI_COLOR_CONV_565, 0, 0);
 //  pDevice = GUI_DEVICE_CreateAndLink(GUIDRV_TEMPLATE, GUI_COLOR_CONV_8888, 0, 0);
   LCD_SetSizeEx (0, XSIZE_PHYS , YSIZE_PHYS);
@@ -217,14 +159,3 @@ int LCD_X_DisplayDriver(unsigned LayerIndex, unsigned Cmd, void * pData) {
   }
   return r;
 }
-
-void FillRect(int LayerIndex, int x0, int y0, int x1, int y1, int PixelIndex)
-{
-	LCD_area(x0,y0,x1,y1);
-	DMA_Config(abs(x1-x0)*abs(y1-y0),PixelIndex);
-}
-//void drwbitmap(int LayerIndex, int x0, int y0, int x1, int y1, int PixelIndex)
-//{
-//	LCD_area(x0,y0,x1,y1);
-//	DMA_Config(abs(x1-x0)*abs(y1-y0),PixelIndex);
-//}
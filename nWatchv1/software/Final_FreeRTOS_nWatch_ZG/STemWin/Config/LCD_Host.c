@@ -0,0 +1,392 @@
+/*********************************************************************
+*
+* LCD_Host.c
+*
+* Host back-end of GUIDRV_Template.c: a model of the panel command set
+* used by the driver (CASET, RASET, RAMWR) drawing into a framebuffer,
+* with counters of the bus writes.
+*
+* The DMA transfers are queued as by lcd_dma.c, HOST_QUEUE_LEN deep, and
+* timed on a simulated clock in ns: a transfer starts when the one before
+* ends, the CPU time moves on with LCDHost_Work(), the bus writes of the
+* CPU and the waits. Overlap is the DMA time during which the CPU ran.
+*
+* Built with LCDHOST_MAIN it is a program that times the producers of
+* lcd_dma.c, sending each buffer and waiting for it, and double-buffered:
+*   gcc -O2 -DGUIDRV_TEMPLATE_HOST -DLCDHOST_MAIN -ISTemWin/Config
+*       -ISTemWin/inc -o lcd_host STemWin/Config/LCD_Host.c
+*
+**********************************************************************
+*/
+#ifdef GUIDRV_TEMPLATE_HOST
+
+#include <string.h>
+
+#include "GUI.h"
+#include "GUIDRV_Template.h"
+
+/*********************************************************************
+*
+*       Defines
+*
+**********************************************************************
+*/
+#define HOST_XSIZE  320
+#define HOST_YSIZE  240
+
+#define CASET  0x2A
+#define RASET  0x2B
+#define RAMWR  0x2C
+
+//
+// Bus timing: a FSMC write with SetupTime 1, WaitSetupTime 2 and
+// HoldSetupTime 1 is about 5 HCLK at 168 MHz, by the CPU or the DMA.
+// The submit is LCD_DMA_Submit() and LCD_DMA_Start().
+//
+#define HOST_NS_PER_BYTE  30
+#define HOST_NS_SUBMIT    600
+#define HOST_QUEUE_LEN    8   // LCD_DMA_QUEUE_LEN
+
+/*********************************************************************
+*
+*       Static data
+*
+**********************************************************************
+*/
+static U8 _aFrame[HOST_YSIZE][HOST_XSIZE][3];
+static LCDHOST_STATS _Stats;
+static U8  _Cmd;
+static int _NumArgs;
+static U8  _aArg[4];
+static int _x0, _x1, _y0, _y1;
+static int _x, _y, _Byte;
+static U32 _Now;                    // CPU time
+static U32 _Start;                  // _Now at LCDHost_ResetStats()
+static U32 _DMAEnd;                 // End of the last queued transfer
+static U32 _Seq;                    // Transfers queued
+static U32 _aEnd[HOST_QUEUE_LEN];   // End of the queued transfers
+
+/*********************************************************************
+*
+*       Static functions
+*
+**********************************************************************
+*/
+/*********************************************************************
+*
+*       _WaitUntil
+*
+* Purpose:
+*   The CPU waits for the DMA until Time. The DMA is busy all along:
+*   the transfer that ends at Time was queued before now.
+*/
+static void _WaitUntil(U32 Time) {
+  if (Time > _Now) {
+    _Stats.Waits++;
+    _Stats.Waited += Time - _Now;
+    _Now = Time;
+  }
+}
+
+/*********************************************************************
+*
+*       _BusWrite
+*
+* Purpose:
+*   A bus write of the CPU. During a DMA transfer it would mix its
+*   byte into the pixels on the target, it is counted as a conflict.
+*/
+static void _BusWrite(void) {
+  if (_DMAEnd > _Now) {
+    _Stats.Conflicts++;
+  }
+  _Now += HOST_NS_PER_BYTE;
+}
+
+/*********************************************************************
+*
+*       _Command
+*/
+static void _Command(U8 Cmd) {
+  _Stats.Commands++;
+  _BusWrite();
+  _Cmd     = Cmd;
+  _NumArgs = 0;
+  if (Cmd == RAMWR) {
+    _x    = _x0;
+    _y    = _y0;
+    _Byte = 0;
+  }
+}
+
+/*********************************************************************
+*
+*       _Write
+*
+* Purpose:
+*   A data byte, argument of CASET and RASET or pixel byte of RAMWR.
+*   The pixels fill the window row by row and wrap at its end.
+*/
+static void _Write(U8 Data) {
+  switch (_Cmd) {
+  case CASET:
+  case RASET:
+    if (_NumArgs < 4) {
+      _aArg[_NumArgs++] = Data;
+    }
+    if (_NumArgs == 4) {
+      if (_Cmd == CASET) {
+        _x0 = _aArg[0] << 8 | _aArg[1];
+        _x1 = _aArg[2] << 8 | _aArg[3];
+      } else {
+        _y0 = _aArg[0] << 8 | _aArg[1];
+        _y1 = _aArg[2] << 8 | _aArg[3];
+      }
+    }
+    break;
+  case RAMWR:
+    if ((_x < HOST_XSIZE) && (_y < HOST_YSIZE)) {
+      _aFrame[_y][_x][_Byte] = Data;
+    }
+    if (++_Byte == 3) {
+      _Byte = 0;
+      if (++_x > _x1) {
+        _x = _x0;
+        if (++_y > _y1) {
+          _y = _y0;
+        }
+      }
+    }
+    break;
+  }
+}
+
+/*********************************************************************
+*
+*       Public code
+*
+**********************************************************************
+*/
+/*********************************************************************
+*
+*       LCD_area
+*
+* Purpose:
+*   Same bus writes as LCD_area() of LCD_nokia1.c.
+*/
+void LCD_area(int x, int y, int x1, int y1) {
+  _Stats.Windows++;
+  _Command(CASET);
+  LCDHost_Data((U8)(x >> 8));
+  LCDHost_Data((U8)x);
+  LCDHost_Data((U8)(x1 >> 8));
+  LCDHost_Data((U8)x1);
+  _Command(RASET);
+  LCDHost_Data((U8)(y >> 8));
+  LCDHost_Data((U8)y);
+  LCDHost_Data((U8)(y1 >> 8));
+  LCDHost_Data((U8)y1);
+  _Command(RAMWR);
+}
+
+/*********************************************************************
+*
+*       LCDHost_Data
+*/
+void LCDHost_Data(U8 Data) {
+  _Stats.Data++;
+  _BusWrite();
+  _Write(Data);
+}
+
+/*********************************************************************
+*
+*       LCDHost_DMA
+*
+* Purpose:
+*   Queues a transfer, waiting first for the oldest one if the queue is
+*   full. The bytes go to the framebuffer at once, the transfer starts
+*   when the one before ends. Returns its sequence number.
+*/
+U32 LCDHost_DMA(const U8 * pData, U32 NumBytes, int Inc) {
+  U32 Start;
+
+  if (_Seq >= HOST_QUEUE_LEN) {
+    _WaitUntil(_aEnd[_Seq % HOST_QUEUE_LEN]);
+  }
+  _Now += HOST_NS_SUBMIT;
+  Start   = (_DMAEnd > _Now) ? _DMAEnd : _Now;
+  _DMAEnd = Start + NumBytes * HOST_NS_PER_BYTE;
+  _aEnd[_Seq % HOST_QUEUE_LEN] = _DMAEnd;
+  _Stats.DMAs++;
+  _Stats.DMABytes += NumBytes;
+  _Stats.Busy     += _DMAEnd - Start;
+  while (NumBytes--) {
+    _Write(*pData);
+    if (Inc) {
+      pData++;
+    }
+  }
+  return ++_Seq;
+}
+
+/*********************************************************************
+*
+*       LCDHost_WaitSeq
+*
+* Purpose:
+*   Waits for a transfer, 0 is always done. A transfer whose queue entry
+*   was taken again was waited for then.
+*/
+void LCDHost_WaitSeq(U32 Seq) {
+  if ((Seq == 0) || (_Seq - Seq >= HOST_QUEUE_LEN)) {
+    return;
+  }
+  _WaitUntil(_aEnd[(Seq - 1) % HOST_QUEUE_LEN]);
+}
+
+/*********************************************************************
+*
+*       LCDHost_Wait
+*/
+void LCDHost_Wait(void) {
+  _WaitUntil(_DMAEnd);
+}
+
+/*********************************************************************
+*
+*       LCDHost_Work
+*
+* Purpose:
+*   CPU work of a producer, filling a buffer.
+*/
+void LCDHost_Work(U32 ns) {
+  _Stats.Work += ns;
+  _Now        += ns;
+}
+
+/*********************************************************************
+*
+*       LCDHost_GetStats
+*
+* Purpose:
+*   The counters, with the times up to now. The DMA time still ahead is
+*   not in Overlap.
+*/
+void LCDHost_GetStats(LCDHOST_STATS * pStats) {
+  U32 Ahead;
+
+  Ahead = (_DMAEnd > _Now) ? _DMAEnd - _Now : 0;
+  _Stats.Elapsed = _Now - _Start;
+  _Stats.Overlap = _Stats.Busy - Ahead - _Stats.Waited;
+  *pStats = _Stats;
+}
+
+/*********************************************************************
+*
+*       LCDHost_ResetStats
+*
+* Purpose:
+*   Clears the counters after waiting for the queued transfers.
+*/
+void LCDHost_ResetStats(void) {
+  _Now = (_DMAEnd > _Now) ? _DMAEnd : _Now;
+  _Start = _Now;
+  memset(&_Stats, 0, sizeof(_Stats));
+}
+
+/*********************************************************************
+*
+*       LCDHost_GetPixel
+*
+* Purpose:
+*   The three bytes of a framebuffer pixel, first byte in bits 0-7.
+*/
+U32 LCDHost_GetPixel(int x, int y) {
+  return _aFrame[y][x][0] | (U32)_aFrame[y][x][1] << 8 | (U32)_aFrame[y][x][2] << 16;
+}
+
+#ifdef LCDHOST_MAIN
+
+#include <stdio.h>
+
+/*********************************************************************
+*
+*       _Produce
+*
+* Purpose:
+*   Sends a full screen in buffers of NumBytes, each filled with
+*   NsPerByte of CPU work. With one buffer each transfer is waited for
+*   before the next fill, as the DMA_Config() callers did; with two the
+*   next one is filled while the other is sent.
+*/
+static void _Produce(const char * sName, U32 NumBytes, U32 NsPerByte, int NumBuffers) {
+  static U8 _aBuffer[2][HOST_XSIZE * 16 * 3];
+  LCDHOST_STATS Stats;
+  U32 aSeq[2] = { 0, 0 };
+  U32 Left, n;
+  int i;
+
+  LCDHost_ResetStats();
+  LCD_area(0, 0, HOST_XSIZE - 1, HOST_YSIZE - 1);
+  Left = HOST_XSIZE * HOST_YSIZE * 3;
+  i = 0;
+  while (Left) {
+    n = (Left < NumBytes) ? Left : NumBytes;
+    LCDHost_WaitSeq(aSeq[i]);
+    memset(_aBuffer[i], (U8)Left, n);
+    LCDHost_Work(n * NsPerByte);
+    aSeq[i] = LCDHost_DMA(_aBuffer[i], n, 1);
+    if (NumBuffers == 1) {
+      LCDHost_WaitSeq(aSeq[i]);
+    } else {
+      i ^= 1;
+    }
+    Left -= n;
+  }
+  LCDHost_Wait();
+  LCDHost_GetStats(&Stats);
+  printf("%-10s %5u B %4u ns/B %u buf: %6u us, work %6u us, dma %5u us, waited %5u us, overlap %3u %%%s\n",
+         sName, (unsigned)NumBytes, (unsigned)NsPerByte, NumBuffers,
+         (unsigned)(Stats.Elapsed / 1000), (unsigned)(Stats.Work / 1000), (unsigned)(Stats.Busy / 1000),
+         (unsigned)(Stats.Waited / 1000), (unsigned)(Stats.Overlap / (Stats.Busy / 100)),
+         Stats.Conflicts ? ", bus conflicts" : "");
+}
+
+/*********************************************************************
+*
+*       main
+*
+* Purpose:
+*   The producers of lcd_dma.c: bitmap_RGB() sends 2048 byte SD reads
+*   (SDIO at 24 MHz, about 100 ns per byte), tjd_output() 16 line bands
+*   and the GUI driver one line at a time. The work per byte is swept
+*   for the two that depend on the decoder or the drawing.
+*/
+int main(void) {
+  static const U32 _aNsPerByte[] = { 10, 30, 100, 300 };
+  unsigned i;
+
+  _Produce("bitmap", 2048, 100, 1);
+  _Produce("bitmap", 2048, 100, 2);
+  for (i = 0; i < GUI_COUNTOF(_aNsPerByte); i++) {
+    _Produce("jpeg band", HOST_XSIZE * 16 * 3, _aNsPerByte[i], 1);
+    _Produce("jpeg band", HOST_XSIZE * 16 * 3, _aNsPerByte[i], 2);
+  }
+  for (i = 0; i < GUI_COUNTOF(_aNsPerByte); i++) {
+    _Produce("gui line", HOST_XSIZE * 3, _aNsPerByte[i], 1);
+    _Produce("gui line", HOST_XSIZE * 3, _aNsPerByte[i], 2);
+  }
+  return 0;
+}
+
+#endif
+
+#else
+
+void LCD_Host_C(void); // Avoid empty object files
+void LCD_Host_C(void) {}
+
+#endif
+
+/*************************** End of file ****************************/
@@ -7,6 +7,7 @@
 #include "list1.h"
 #include "stmpe811.h"
 #include "LCD_6300.h"
+#include "lcd_dma.h"
 #include "explorer.h"
 #include "ff.h"
 #include "textbox.h"
@@ -271,12 +272,10 @@ void icon(u8 wh, u16 x, u16 y, u16 lx, u16 ly)
 //	lx/=2;
 //	ly/=2;
 	int BUF=lx*ly*3;
-	LCD_area(x,y,x+lx-1,y+ly-1);
-	if(wh==0)DMA_Config(BUF,fols);
-	else if(wh==1)DMA_Config(BUF,files);
-	else if(wh==2)DMA_Config(BUF,fileb);
-	while(!(DMA2->LISR & DMA_LISR_TCIF0)){};
-	DMA2->LISR=0x00000000;
+	if(wh==0)LCD_DMA_Blit(x,y,x+lx-1,y+ly-1,fols,BUF);
+	else if(wh==1)LCD_DMA_Blit(x,y,x+lx-1,y+ly-1,files,BUF);
+	else if(wh==2)LCD_DMA_Blit(x,y,x+lx-1,y+ly-1,fileb,BUF);
+	LCD_DMA_Wait();
 
 }
 
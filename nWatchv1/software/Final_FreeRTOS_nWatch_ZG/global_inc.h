@@ -41,10 +41,13 @@ static TCHAR lfname[_MAX_LFN];
 ////////graphic////////////
 #include "bsp.h"
 #include "GUIDRV_Template.h"
+#include "lcd_dma.h"
 ////////////////////////////////////SENSOR//////////////////////////////////////
 #include <MPU5060.h>
 ////////////////////////////////////MUSIC////////////////////////////////////////////
 #include "vs1003.h"
+#include "vs1003_stream.h"
+#include "playlist.h"
 ////////////////////////////////////FreeRTOS///////////////////////////////////////////
 #include "FreeRTOS.h"
 #include "task.h"
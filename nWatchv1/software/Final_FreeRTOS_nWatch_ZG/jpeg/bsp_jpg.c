@@ -1,25 +1,68 @@
 
+#include <string.h>
 #include "bsp_jpg.h"
+#include "lcd_dma.h"
+
+/*
+ * JPEG viewer on TJpgDec.
+ *
+ * The file is read by whole sectors into jpg_in and handed to the decoder
+ * from there. The decoded MCUs of a row are put side by side in a band
+ * buffer, and the band goes to the LCD as one DMA job while the next row is
+ * decoded into the other band buffer. The image is scaled down by 1/2, 1/4
+ * or 1/8 to fit the panel and centered on it.
+ */
 
 FIL fsrc;
 
+static BYTE jpg_in[JPG_INBUF] __attribute__ ((aligned(4)));
+static UINT jpg_in_pos, jpg_in_len;
+static BYTE jpg_band[2][JPG_BAND] __attribute((section(".ExRam")));
+static uint32_t jpg_seq[2];
+static BYTE jpg_cur;
+static UINT jpg_x0, jpg_y0;		/* Panel position of the image */
+static UINT jpg_w, jpg_h;		/* Image size on the panel */
+static UINT jpg_right;			/* Last column of the scaled image, may be out of the panel */
+static JPG_STATS jpg_stats;
+
 UINT tjd_input (
 	JDEC* jd,		/* Decompression object */
 	BYTE* buff,		/* Pointer to the read buffer (NULL:skip) */
 	UINT nd			/* Number of bytes to read/skip from input stream */
 ){
+	FIL *fp = (FIL*)jd->device;
+	DWORD ofs;
+	UINT n, got = 0;
 
-	UINT rb;
-	if (buff)
+	while (got < nd)
 	{
-		/* Read nd bytes from the input strem */
-		f_read(&fsrc, buff, nd, &rb);
-		return rb;	/* Returns number of bytes could be read */
-
-	} else
-	{	/* Skip nd bytes on the input stream */
-		return (f_lseek(&fsrc, f_tell(&fsrc) + nd) == FR_OK) ? nd : 0;
+		if (jpg_in_pos == jpg_in_len)
+		{
+			/* Long skip on an empty buffer: seek */
+			if (!buff && nd - got > JPG_INBUF)
+			{
+				ofs = f_tell(fp);
+				if (f_lseek(fp, ofs + nd - got) == FR_OK) got += f_tell(fp) - ofs;
+				break;
+			}
+
+			/* Up to the next sector boundary, then whole sectors: FatFs reads them straight into jpg_in */
+			n = JPG_INBUF - f_tell(fp) % JPG_SECTOR;
+			if (f_read(fp, jpg_in, n, &jpg_in_len) != FR_OK) jpg_in_len = 0;
+			jpg_in_pos = 0;
+			jpg_stats.reads++;
+			jpg_stats.bytes_in += jpg_in_len;
+			if (!jpg_in_len) break;
+		}
+
+		n = jpg_in_len - jpg_in_pos;
+		if (n > nd - got) n = nd - got;
+		if (buff) memcpy(buff + got, jpg_in + jpg_in_pos, n);
+		jpg_in_pos += n;
+		got += n;
 	}
+
+	return got;	/* Returns number of bytes could be read */
 }
 
 /* User defined call-back function to output RGB bitmap */
@@ -29,41 +72,98 @@ UINT tjd_output (
 	JRECT* rect		/* Rectangular region to output */
 )
 {
+	BYTE *s = (BYTE*)bitmap, *d;
+	UINT xc = rect->right - rect->left + 1;		/* Horizontal size */
+	UINT yc = rect->bottom - rect->top + 1;		/* Vertical size */
+	UINT n = xc, y;
+
 	jd = jd;	/* Suppress warning (device identifier is not needed in this appication) */
 
-	LCD_area( rect->left ,rect->top,rect->right, rect->bottom);
+	if (rect->top >= jpg_h) return 0;	/* Below the panel, stop decoding */
+	if (rect->bottom >= jpg_h) yc = jpg_h - rect->top;
 
-	int yc = rect->bottom - rect->top + 1;			/* Vertical size */
-	int xc = rect->right - rect->left + 1;
+	jpg_stats.mcus++;
 
-	DMA_Config(yc*xc*3,(uint8_t*)bitmap);
+	/* First MCU of a row: the band buffer may still be in transfer */
+	if (rect->left == 0) LCD_DMA_WaitSeq(jpg_seq[jpg_cur]);
 
-	while(!(DMA2->LISR & DMA_LISR_TCIF0)){};
-	DMA2->LISR=0x00000000;
+	if (rect->left < jpg_w)
+	{
+		if (rect->right >= jpg_w) n = jpg_w - rect->left;
+		d = jpg_band[jpg_cur] + rect->left * 3;
+		for (y = 0; y < yc; y++)
+		{
+			memcpy(d, s, n * 3);
+			d += jpg_w * 3;
+			s += xc * 3;
+		}
+	}
+
+	/* Last MCU of the row: send the band and decode on in the other buffer */
+	if (rect->right == jpg_right)
+	{
+		jpg_seq[jpg_cur] = LCD_DMA_Blit(jpg_x0, jpg_y0 + rect->top, jpg_x0 + jpg_w - 1, jpg_y0 + rect->top + yc - 1,
+				jpg_band[jpg_cur], jpg_w * yc * 3);
+		jpg_stats.bands++;
+		jpg_stats.bytes_out += jpg_w * yc * 3;
+		jpg_cur ^= 1;
+	}
 
-	return 1;	/* Continue to decompression */  ////////1
+	return 1;	/* Continue to decompression */
 }
 
-void load_jpg (
-	FIL *fp,	/* File to open */
-	char *fn,
+JRESULT load_jpg (
+	FIL *fp,	/* Open file, read from its current position if fn is "-" */
+	char *fn,	/* File to open */
 	void *work,		/* Pointer to the working buffer (must be 4-byte aligned) */
 	UINT sz_work	/* Size of the working buffer (must be power of 2) */
 )
 {
 	JDEC jd;		/* Decompression object (70 bytes) */
 	JRESULT rc;
-	BYTE scale=0;
+	BYTE scale;
 
-	if(*fn!='-')f_open(&fsrc,fn, FA_READ | FA_OPEN_EXISTING);
+	if (*fn != '-')
+	{
+		if (f_open(&fsrc, fn, FA_READ | FA_OPEN_EXISTING) != FR_OK) return JDR_INP;
+		fp = &fsrc;
+	}
+
+	memset(&jpg_stats, 0, sizeof(jpg_stats));
+	jpg_in_pos = jpg_in_len = 0;
 
 	rc = jd_prepare(&jd, tjd_input, (uint8_t*)work, sz_work, fp);
 
 	if (rc == JDR_OK)
 	{
-		rc = jd_decomp(&jd, tjd_output, 0);
+		/* Largest scale that fits, else 1/8 and clipped */
+		for (scale = 0; scale < 3; scale++)
+			if ((jd.width >> scale) <= JPG_LCD_W && (jd.height >> scale) <= JPG_LCD_H) break;
+
+		jpg_right = (jd.width >> scale) - 1;
+		jpg_w = (jd.width >> scale) < JPG_LCD_W ? (jd.width >> scale) : JPG_LCD_W;
+		jpg_h = (jd.height >> scale) < JPG_LCD_H ? (jd.height >> scale) : JPG_LCD_H;
+		jpg_x0 = (JPG_LCD_W - jpg_w) / 2;
+		jpg_y0 = (JPG_LCD_H - jpg_h) / 2;
+		jpg_stats.width = jpg_w;
+		jpg_stats.height = jpg_h;
+		jpg_stats.scale = scale;
+
+		rc = jd_decomp(&jd, tjd_output, scale);
+		if (rc == JDR_INTR) rc = JDR_OK;	/* Stopped at the bottom of the panel */
 	}
+	LCD_DMA_Wait();
+
+	if (*fn != '-') f_close(&fsrc);
 
+	return rc;
+}
+
+void JPG_GetStats (
+	JPG_STATS *stats	/* Counters of the last load_jpg */
+)
+{
+	*stats = jpg_stats;
 }
 
 
@@ -12,8 +12,27 @@
 #include "tjpgd.h"
 #include "ff.h"
 
+#define JPG_SECTOR		512						/* Input reads start on a sector boundary */
+#define JPG_INBUF		(8*JPG_SECTOR)			/* Input buffer, whole sectors */
+#define JPG_LCD_W		320
+#define JPG_LCD_H		240
+#define JPG_BAND		(JPG_LCD_W*16*3)		/* One row of MCUs, panel wide, 3 bytes per pixel */
+
+typedef struct
+{
+	uint32_t reads;								/* f_read calls */
+	uint32_t bytes_in;							/* File bytes read */
+	uint32_t bytes_out;							/* Bytes queued to the LCD */
+	uint32_t mcus;								/* MCU blocks decoded */
+	uint32_t bands;								/* LCD jobs, one per row of MCUs */
+	uint16_t width, height;						/* Image size on the panel */
+	uint8_t scale;								/* 1/(1<<scale) */
+} JPG_STATS;
+
 UINT tjd_input (JDEC* jd,BYTE* buff,UINT nd);
 UINT tjd_output (JDEC* jd,void* bitmap,JRECT* rect);
+JRESULT load_jpg (FIL *fp, char *fn, void *work, UINT sz_work);
+void JPG_GetStats (JPG_STATS *stats);
 
 
 #endif _BSP_JPG_H
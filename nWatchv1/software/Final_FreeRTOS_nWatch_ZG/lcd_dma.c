@@ -0,0 +1,336 @@
+/*
+ * lcd_dma.c
+ *
+ * LCD transfer service.
+ *
+ * DMA2 Stream0 is set up once by LCD_DMA_Init as a memory to memory transfer
+ * into the FSMC data register: for each transfer only the source address,
+ * the count and the source increment bit are written. Producers queue jobs
+ * with LCD_DMA_Submit and get a sequence number back; the transfer complete
+ * interrupt starts the next job (a window first if the job has one, then
+ * its bytes in chunks of up to LCD_DMA_MAX_CHUNK) and calls the job callback.
+ *
+ * A buffer given to a job belongs to the DMA until the job is done, see
+ * LCD_DMA_IsDone and LCD_DMA_WaitSeq. With two buffers a producer fills one
+ * while the other is sent, the way bitmap_RGB, tjd_output and the GUI
+ * driver do. Direct CPU writes to the panel (LCD_area, LCD_nokia1.c) must
+ * call LCD_DMA_Wait first.
+ *
+ * The interrupt runs at LCD_DMA_IRQ_PRIORITY to give the done semaphore.
+ * When it cannot run (critical section, interrupts off) or a task cannot
+ * block (scheduler not running) the waits poll the flags instead.
+ */
+#include "global_inc.h"
+#include "semphr.h"
+#include "lcd_dma.h"
+
+#define LCD_DMA_FLAGS   (DMA_LIFCR_CTCIF0 | DMA_LIFCR_CHTIF0 | DMA_LIFCR_CTEIF0 | DMA_LIFCR_CDMEIF0 | DMA_LIFCR_CFEIF0)
+
+static LCD_JOB lcd_queue[LCD_DMA_QUEUE_LEN];
+static volatile uint32_t lcd_submitted;         // Jobs queued, LCD_DMA_Submit only
+static volatile uint32_t lcd_done;              // Jobs sent, interrupt only
+static volatile uint32_t lcd_pos;               // Bytes of the current job sent
+static volatile uint32_t lcd_chunk;             // Bytes of the transfer in progress
+static volatile uint8_t lcd_busy;               // Transfer in progress
+static SemaphoreHandle_t lcd_sem;
+static LCD_DMA_STATS lcd_stats;
+
+/*******************************************************************************
+* Function Name  : LCD_DMA_Start
+* Description    : Starts the next chunk of the current job, or the next job.
+*                  Jobs without bytes only set their window. Interrupt
+*                  context or interrupts off.
+* Input          : None
+* Output         : None
+* Return         : None
+*******************************************************************************/
+static void LCD_DMA_Start(void)
+{
+	LCD_JOB *job;
+	LCD_DMA_CALLBACK done;
+	uint32_t n;
+
+	while(lcd_done != lcd_submitted)
+	{
+		job = &lcd_queue[lcd_done % LCD_DMA_QUEUE_LEN];
+
+		if(lcd_pos == 0 && job->window) LCD_area(job->x0, job->y0, job->x1, job->y1);
+
+		n = job->len - lcd_pos;
+		if(n)
+		{
+			if(n > LCD_DMA_MAX_CHUNK) n = LCD_DMA_MAX_CHUNK;
+			lcd_chunk = n;
+			lcd_busy = 1;
+
+			DMA2->LIFCR = LCD_DMA_FLAGS;
+			DMA2_Stream0->PAR = (uint32_t)(job->inc ? job->buf + lcd_pos : job->buf);
+			DMA2_Stream0->NDTR = n;
+			if(job->inc) DMA2_Stream0->CR |= DMA_SxCR_PINC;
+			else DMA2_Stream0->CR &= ~DMA_SxCR_PINC;
+			DMA2_Stream0->CR |= DMA_SxCR_EN;
+			return;
+		}
+
+		/* Job sent, its queue entry is free once lcd_done moves */
+		done = job->done;
+		lcd_pos = 0;
+		lcd_stats.jobs++;
+		lcd_done++;
+		if(done) done(job->arg);
+	}
+
+	lcd_busy = 0;
+}
+
+/*******************************************************************************
+* Function Name  : LCD_DMA_Complete
+* Description    : Ends the transfer in progress if its flags are set and
+*                  starts the next one. Interrupt context or interrupts off.
+* Input          : None
+* Output         : None
+* Return         : 1 if a transfer ended
+*******************************************************************************/
+static uint8_t LCD_DMA_Complete(void)
+{
+	uint32_t isr = DMA2->LISR;
+
+	if(!lcd_busy || !(isr & (DMA_LISR_TCIF0 | DMA_LISR_TEIF0))) return 0;
+
+	DMA2->LIFCR = LCD_DMA_FLAGS;
+	if(isr & DMA_LISR_TEIF0) lcd_stats.errors++;
+
+	lcd_stats.chunks++;
+	lcd_stats.bytes += lcd_chunk;
+	lcd_pos += lcd_chunk;
+
+	LCD_DMA_Start();
+	return 1;
+}
+
+/*******************************************************************************
+* Function Name  : DMA2_Stream0_IRQHandler
+* Description    : Transfer complete or error of the LCD DMA
+* Input          : None
+* Output         : None
+* Return         : None
+*******************************************************************************/
+void DMA2_Stream0_IRQHandler(void)
+{
+	BaseType_t woken = pdFALSE;
+	uint32_t done = lcd_done;
+
+	if(!LCD_DMA_Complete()) return;
+
+	if(lcd_done != done && lcd_sem) xSemaphoreGiveFromISR(lcd_sem, &woken);
+	portEND_SWITCHING_ISR(woken);
+}
+
+/*******************************************************************************
+* Function Name  : LCD_DMA_Masked
+* Description    : Checks if the waits have to poll: the interrupt is masked
+*                  or the caller cannot block
+* Input          : None
+* Output         : None
+* Return         : 1 to poll
+*******************************************************************************/
+static uint8_t LCD_DMA_Masked(void)
+{
+	uint32_t basepri = __get_BASEPRI();
+
+	if(__get_PRIMASK()) return 1;
+	if(basepri && basepri <= (LCD_DMA_IRQ_PRIORITY << (8 - __NVIC_PRIO_BITS))) return 1;
+	return xTaskGetSchedulerState() != taskSCHEDULER_RUNNING;
+}
+
+/*******************************************************************************
+* Function Name  : LCD_DMA_Poll
+* Description    : Does the interrupt work if the flags are set
+* Input          : None
+* Output         : None
+* Return         : None
+*******************************************************************************/
+static void LCD_DMA_Poll(void)
+{
+	uint32_t primask = __get_PRIMASK();
+
+	__disable_irq();
+	LCD_DMA_Complete();
+	__set_PRIMASK(primask);
+}
+
+/*******************************************************************************
+* Function Name  : LCD_DMA_Init
+* Description    : Configures DMA2 Stream0 for the LCD data register, its
+*                  interrupt and the done semaphore. FSMC_NAND_Init first.
+* Input          : None
+* Output         : None
+* Return         : None
+*******************************************************************************/
+void LCD_DMA_Init(void)
+{
+	RCC->AHB1ENR |= RCC_AHB1ENR_DMA2EN;
+
+	/* Memory to memory, channel 0, bytes: PAR is the source, M0AR the panel */
+	DMA2_Stream0->CR &= ~DMA_SxCR_EN;
+	while(DMA2_Stream0->CR & DMA_SxCR_EN);
+	DMA2->LIFCR = LCD_DMA_FLAGS;
+	DMA2_Stream0->M0AR = (uint32_t)&LCD_WRITE_DATA;
+	DMA2_Stream0->FCR = DMA_SxFCR_DMDIS | DMA_SxFCR_FTH;
+	DMA2_Stream0->CR = DMA_SxCR_DIR_1 | DMA_SxCR_PL | DMA_SxCR_TCIE | DMA_SxCR_TEIE;
+
+	lcd_submitted = 0;
+	lcd_done = 0;
+	lcd_pos = 0;
+	lcd_busy = 0;
+
+	if(lcd_sem == NULL) lcd_sem = xSemaphoreCreateBinary();
+
+	NVIC_SetPriority(DMA2_Stream0_IRQn, LCD_DMA_IRQ_PRIORITY);
+	NVIC_EnableIRQ(DMA2_Stream0_IRQn);
+}
+
+/*******************************************************************************
+* Function Name  : LCD_DMA_Submit
+* Description    : Queues a job, starts it at once if the DMA is idle. Waits
+*                  while the queue is full. Task context, not from a job
+*                  callback.
+* Input          : job--copied, job->buf must stay valid until it is done
+* Output         : None
+* Return         : Sequence number of the job
+*******************************************************************************/
+uint32_t LCD_DMA_Submit(const LCD_JOB *job)
+{
+	uint32_t primask, seq;
+
+	while(1)
+	{
+		primask = __get_PRIMASK();
+		__disable_irq();
+		if(lcd_submitted - lcd_done < LCD_DMA_QUEUE_LEN) break;
+		__set_PRIMASK(primask);
+
+		lcd_stats.full++;
+		LCD_DMA_WaitSeq(lcd_done + 1);
+	}
+
+	lcd_queue[lcd_submitted % LCD_DMA_QUEUE_LEN] = *job;
+	seq = ++lcd_submitted;
+	if(!lcd_busy) LCD_DMA_Start();
+
+	__set_PRIMASK(primask);
+
+	return seq;
+}
+
+/*******************************************************************************
+* Function Name  : LCD_DMA_Blit
+* Description    : Queues a window and the bytes that fill it
+* Input          : x0, y0, x1, y1--window, inclusive
+*                  buf--bytes, 3 per pixel
+*                  len--bytes
+* Output         : None
+* Return         : Sequence number of the job
+*******************************************************************************/
+uint32_t LCD_DMA_Blit(uint16_t x0, uint16_t y0, uint16_t x1, uint16_t y1, const void *buf, uint32_t len)
+{
+	LCD_JOB job;
+
+	job.window = 1;
+	job.x0 = x0;
+	job.y0 = y0;
+	job.x1 = x1;
+	job.y1 = y1;
+	job.buf = buf;
+	job.len = len;
+	job.inc = 1;
+	job.done = NULL;
+	job.arg = NULL;
+
+	return LCD_DMA_Submit(&job);
+}
+
+/*******************************************************************************
+* Function Name  : LCD_DMA_Write
+* Description    : Queues bytes for the window open now, or opened by the
+*                  jobs before
+* Input          : buf--bytes
+*                  len--bytes
+*                  inc--1 to send buf, 0 to send buf[0] len times
+* Output         : None
+* Return         : Sequence number of the job
+*******************************************************************************/
+uint32_t LCD_DMA_Write(const void *buf, uint32_t len, uint8_t inc)
+{
+	LCD_JOB job;
+
+	job.window = 0;
+	job.buf = buf;
+	job.len = len;
+	job.inc = inc;
+	job.done = NULL;
+	job.arg = NULL;
+
+	return LCD_DMA_Submit(&job);
+}
+
+/*******************************************************************************
+* Function Name  : LCD_DMA_IsDone
+* Description    : Checks if a job was sent
+* Input          : seq--from LCD_DMA_Submit, 0 is always done
+* Output         : None
+* Return         : 1 if sent
+*******************************************************************************/
+uint8_t LCD_DMA_IsDone(uint32_t seq)
+{
+	if((int32_t)(lcd_done - seq) >= 0) return 1;
+	if(LCD_DMA_Masked()) LCD_DMA_Poll();
+	return (int32_t)(lcd_done - seq) >= 0;
+}
+
+/*******************************************************************************
+* Function Name  : LCD_DMA_WaitSeq
+* Description    : Waits until a job was sent, its buffer is free then
+* Input          : seq--from LCD_DMA_Submit
+* Output         : None
+* Return         : None
+*******************************************************************************/
+void LCD_DMA_WaitSeq(uint32_t seq)
+{
+	if(LCD_DMA_IsDone(seq)) return;
+
+	if(LCD_DMA_Masked())
+	{
+		lcd_stats.polls++;
+		while(!LCD_DMA_IsDone(seq));
+		return;
+	}
+
+	/* Several tasks can wait, the one that misses the give looks again later */
+	lcd_stats.waits++;
+	while(!LCD_DMA_IsDone(seq)) xSemaphoreTake(lcd_sem, LCD_DMA_WAIT_TICKS);
+}
+
+/*******************************************************************************
+* Function Name  : LCD_DMA_Wait
+* Description    : Waits until every queued job was sent
+* Input          : None
+* Output         : None
+* Return         : None
+*******************************************************************************/
+void LCD_DMA_Wait(void)
+{
+	LCD_DMA_WaitSeq(lcd_submitted);
+}
+
+/*******************************************************************************
+* Function Name  : LCD_DMA_GetStats
+* Description    : Copies the counters
+* Input          : None
+* Output         : stats--counters since power up
+* Return         : None
+*******************************************************************************/
+void LCD_DMA_GetStats(LCD_DMA_STATS *stats)
+{
+	*stats = lcd_stats;
+}
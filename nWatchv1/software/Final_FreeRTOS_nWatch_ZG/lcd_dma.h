@@ -0,0 +1,51 @@
+/*
+ * lcd_dma.h
+ *
+ * LCD transfer service: a queue of jobs (window, buffer, length, source
+ * increment) sent to the FSMC data register by DMA2 Stream0, one after the
+ * other, from the transfer complete interrupt.
+ */
+#ifndef LCD_DMA_H
+#define LCD_DMA_H
+
+#include "stm32f4xx.h"
+
+#define LCD_DMA_QUEUE_LEN       8               // Jobs queued or in progress
+#define LCD_DMA_MAX_CHUNK       0xFFFF          // Bytes per DMA transfer, NDTR is 16 bits
+#define LCD_DMA_IRQ_PRIORITY    configLIBRARY_MAX_SYSCALL_INTERRUPT_PRIORITY  // Gives a semaphore
+#define LCD_DMA_WAIT_TICKS      2               // Semaphore wait, the counters are checked again after it
+
+typedef void (*LCD_DMA_CALLBACK)(void *arg);
+
+typedef struct
+{
+	uint8_t window;                             // Set x0, y0, x1, y1 and RAMWR first, else go on in the open window
+	uint16_t x0, y0, x1, y1;
+	const uint8_t *buf;
+	uint32_t len;                               // Bytes
+	uint8_t inc;                                // 1 buf is read through, 0 buf[0] is sent len times
+	LCD_DMA_CALLBACK done;                      // Called from the interrupt when the job is sent, may be NULL
+	void *arg;
+} LCD_JOB;
+
+typedef struct
+{
+	uint32_t jobs;                              // Jobs sent
+	uint32_t bytes;                             // Bytes sent
+	uint32_t chunks;                            // DMA transfers
+	uint32_t full;                              // LCD_DMA_Submit waited for a free queue entry
+	uint32_t waits;                             // LCD_DMA_WaitSeq blocked
+	uint32_t polls;                             // Waits served by polling, in a critical section or before the scheduler
+	uint32_t errors;                            // Transfer errors
+} LCD_DMA_STATS;
+
+void LCD_DMA_Init(void);
+uint32_t LCD_DMA_Submit(const LCD_JOB *job);
+uint32_t LCD_DMA_Blit(uint16_t x0, uint16_t y0, uint16_t x1, uint16_t y1, const void *buf, uint32_t len);
+uint32_t LCD_DMA_Write(const void *buf, uint32_t len, uint8_t inc);
+uint8_t LCD_DMA_IsDone(uint32_t seq);
+void LCD_DMA_WaitSeq(uint32_t seq);
+void LCD_DMA_Wait(void);
+void LCD_DMA_GetStats(LCD_DMA_STATS *stats);
+
+#endif
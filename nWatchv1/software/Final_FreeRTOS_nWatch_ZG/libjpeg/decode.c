@@ -30,6 +30,7 @@
 #include "jpeglib.h"
 #include "jmorecfg.h"
 #include "ili9320.h"
+#include "lcd_dma.h"
 /* Private typedef -----------------------------------------------------------*/
   /* This struct contains the JPEG decompression parameters */
 int line_cnt=0;
@@ -87,7 +88,6 @@ void jpeg_decode(FIL *file, uint32_t width, uint32_t * buff, uint8_t (*callback)
 	  if(line_cnt==320)line_cnt=0;
 	  int a=0;
 
-	  LCD_area(0,line_cnt,cinfo.image_width,320);
 
 //	  for(int i=0;i<cinfo.image_width*cinfo.num_components;)
 //	  {
@@ -98,9 +98,8 @@ void jpeg_decode(FIL *file, uint32_t width, uint32_t * buff, uint8_t (*callback)
 //		  buffek[a++]=buffer[0][i++];
 //	  }
 
-	   DMA_Config(720,buffer[0]);
-	   while(!(DMA2->LISR & DMA_LISR_TCIF0)){};
-	   DMA2->LISR=0x00000000;
+	   /* The row buffer is decoded into again next, wait for the DMA */
+	   LCD_DMA_WaitSeq(LCD_DMA_Blit(0,line_cnt,cinfo.image_width,320,buffer[0],720));
 	  line_cnt++;
   }
 
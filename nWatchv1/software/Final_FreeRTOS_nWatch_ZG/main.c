@@ -108,7 +108,6 @@ void delay(unsigned int ms);
 void FSMC_init(void);
 void GPIO_Config(void);
 void SPI_Config(void);
-void DMA_Config(int ele, int* buf);
 void exti_init(void);
 void delay_init(void);
 int get_random(int form,int to);
@@ -149,6 +148,7 @@ int main(void)
 	  GPIO_cfg();
 	  SRAM_Init();
 	  FSMC_NAND_Init();
+	  LCD_DMA_Init();
 	  delay_init();
 	  init_USART(115200);
 	  RNG_Cmd(ENABLE);
@@ -268,26 +268,35 @@ static void vTimerCallback( xTimerHandle pxTimer )
 }
 void bitmap_RGB(char *sc , u16 x, u16 y, u16 lx, u16 ly)
 {
+	  static uint8_t buf[2][2048]__attribute((section(".ExRam")));
+	  uint32_t seq[2]={0,0};
+	  int read= lx*ly*3;
+	  UINT s1=0;
+	  int n, i=0;
+
+	  LCD_DMA_Wait();
 	LCD_WRITE_COMMAND=(MADCTR);
 	LCD_WRITE_DATA = (0x86);
 
 	  f = f_open(&fsrc,sc, FA_READ | FA_OPEN_EXISTING );
-	  int read= lx*ly*3;
-	  int s1=0;
-	  int BUF=2048;
-	  LCD_area(x,y,x+lx-1,y+ly-1);
 //	  LCD_area(y,x,y+ly-1,x+lx-1);
 
-	  while(read>0)
+	  /* One buffer is read while the other is sent */
+	  while(f==FR_OK && read>0)
 	  {
-		  f = f_read(&fsrc, aucLine, BUF, &s1);
-
-		  DMA_Config(BUF,aucLine);
-		  while(!(DMA2->LISR & DMA_LISR_TCIF0)){};
-		  DMA2->LISR=0x00000000;
-		  read-=BUF;
+		  n = read<(int)sizeof(buf[0]) ? read : (int)sizeof(buf[0]);
+		  LCD_DMA_WaitSeq(seq[i]);
+		  f = f_read(&fsrc, buf[i], n, &s1);
+		  if(f!=FR_OK || !s1) break;
+
+		  if(read==lx*ly*3) seq[i]=LCD_DMA_Blit(x,y,x+lx-1,y+ly-1,buf[i],s1);
+		  else seq[i]=LCD_DMA_Write(buf[i],s1,1);
+		  read-=s1;
+		  i^=1;
 	  }
+	  f_close(&fsrc);
 
+	  LCD_DMA_Wait();
 		LCD_WRITE_COMMAND=(MADCTR);
 		LCD_WRITE_DATA = (0x66);
 
@@ -347,39 +356,6 @@ void exti_init(void)
     SYSCFG ->EXTICR[1] = SYSCFG_EXTICR2_EXTI5_PC;
 }
 
-void DMA_Config(int ele, int* buf)
-{
-
-	DMA_InitTypeDef SDDMA_InitStructure;
-//	DMA2->LIFCR=0x00000000;
-//	DMA2->HIFCR=0x00000000;
-	/* DMA2 Stream3  or Stream6 disable */
-//	DMA_Cmd(DMA2_Stream0, DISABLE);
-	DMA_Cmd(DMA2_Stream0, ENABLE);
-	/* DMA2 Stream3  or Stream6 Config */
-	DMA_DeInit(DMA2_Stream0);
-
-	SDDMA_InitStructure.DMA_Channel = DMA_Channel_0;
-	SDDMA_InitStructure.DMA_PeripheralBaseAddr = buf;
-	SDDMA_InitStructure.DMA_Memory0BaseAddr =&LCD_WRITE_DATA;  /////nokia
-//	SDDMA_InitStructure.DMA_Memory0BaseAddr =&LCD_RAM;   ////ili9320
-	SDDMA_InitStructure.DMA_DIR = DMA_DIR_MemoryToMemory;
-	SDDMA_InitStructure.DMA_BufferSize = ele;
-	SDDMA_InitStructure.DMA_PeripheralInc = DMA_PeripheralInc_Enable;
-	SDDMA_InitStructure.DMA_MemoryInc = DMA_MemoryInc_Disable;
-	SDDMA_InitStructure.DMA_PeripheralDataSize = DMA_PeripheralDataSize_Byte;////////////////////////
-	SDDMA_InitStructure.DMA_MemoryDataSize = DMA_MemoryDataSize_Byte; /* DMA_MemoryDataSize_Word; */
-	SDDMA_InitStructure.DMA_Mode = DMA_Mode_Normal;
-	SDDMA_InitStructure.DMA_Priority = DMA_Priority_VeryHigh;
-	SDDMA_InitStructure.DMA_FIFOMode = DMA_FIFOMode_Enable;
-	SDDMA_InitStructure.DMA_FIFOThreshold = DMA_FIFOThreshold_3QuartersFull; /* DMA_FIFOThreshold_Full */
-	SDDMA_InitStructure.DMA_MemoryBurst = DMA_MemoryBurst_Single; /* DMA_MemoryBurst_INC4 */
-	SDDMA_InitStructure.DMA_PeripheralBurst = DMA_PeripheralBurst_Single;
-	DMA_Init (DMA2_Stream0, &SDDMA_InitStructure);
-	/* DMA2 Stream3  or Stream6 enable */
-	DMA_Cmd(DMA2_Stream0, ENABLE);
-
-}
 void backlight( int pwm)
 {
 //	TIM3->PSC =   1000;
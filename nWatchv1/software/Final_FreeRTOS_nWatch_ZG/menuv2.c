@@ -1737,6 +1737,7 @@ void Menu(void *pvParameters)
 	 }
 	 else if( MP3_Handle != NULL )
 	 {
+		 VS1003_StreamClose();
 		 vTaskDelete(MP3_Handle);
 	 }
 	 else if( Calc_Handle != NULL )
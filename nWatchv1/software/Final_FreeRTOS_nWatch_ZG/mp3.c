@@ -25,9 +25,7 @@
 #include "mp3.h"
 
 
-char name[107];//__attribute((section(".ExRam")));
-u8 rand[250];//__attribute((section(".ExRam")));
-u8 buffez[1024];//__attribute((section(".ExRam")));
+static char path[PL_PATH_LEN];
 
 
 static const GUI_WIDGET_CREATE_INFO _aDialogCreate[] =
@@ -187,72 +185,39 @@ WM_HWIN CreateWindow(void)
 // USER END
 void MP3_player(void *pvParameters)
 {
-	u16 br=0;
 	u8 fin=1;
 	u8 play=0;
-	u8 rd=0;
-	FRESULT f;
-	int size=0,co=0,vol=0x4a,on=1;
-	int next=0;
-	FIL fsrc;
-	DIR dir;
+	u8 queued=0;
+	int vol=0x4a,vol_set=-1,on=1;
+	int next=-1;
+	uint32_t pos;
 	FATFS fs;
-	FILINFO fno;
+	PL_TRACK track,after;
 
 //	vTaskDelay(10);
 
 	taskENTER_CRITICAL();
-
-	f=f_mount(&fs,"",0);
-	f=f_opendir(&dir,"0:music");
-
-	fno.lfname = lfname;
-	fno.lfsize = _MAX_LFN;
-
-	while(!f_readdir(&dir, &fno) && fno.fname[0])
-	{
-		co++;
-	}
-	rd=co;
-
-	while(rd--)
-	{
-		int k=get_random(0,co);
-
-		for(int j=0;j<co-1;j++)
-		{
-			if(k==rand[j])br=1;
-		}
-		if(br==0)rand[rd]=k;
-		else
-		{
-			br=0;
-			rd++;
-		}
-	}
-
-	br=0;
-	rd=0;
-
+	f_mount(&fs,"",0);
 	taskEXIT_CRITICAL();
 
+	// Only the new files are parsed, see playlist.c
+	PL_Scan();
+	PL_Shuffle();
+	memset(&track,0,sizeof(track));
+
 	GUI_SetFont(GUI_FONT_COMIC18B_ASCII);
 	WM_HWIN hWin=CreateWindow();
-	WM_HWIN hText,hText1;
+	WM_HWIN hText;
 	WM_HWIN hSlider;
 	WM_HWIN hProgBar;
 	WM_HWIN hButton,hButton1,hButton2;
 
-	name[0]='m';
-	name[1]='u';
-	name[2]='s';
-	name[3]='i';
-	name[4]='c';
-	name[5]='/';
-
 	if(Menu_Handle!=NULL)vTaskDelete(Menu_Handle);
 	Menu_Handle=NULL;
 
+	VS1003_StreamInit();
+	VS1003_StreamPause(1);
+
 	while(1)
 	{
 
@@ -268,34 +233,44 @@ void MP3_player(void *pvParameters)
 
 		if(play==1)
 		{
-			SCI_ChipSelect(RESET);
-			taskENTER_CRITICAL();
-			f=f_read(&fsrc, buffez, sizeof(buffez), &br);
-
-			   if(f == 0)
-			   {
-				   vol=SLIDER_GetValue(hSlider);
-
-				   SDI_ChipSelect(SET);
-				   for (int i=0;i<br;i++)
-				   {
-						 SPIPutChar(buffez[i]);
-						 while(DREQ);
-				   }
-				   SDI_ChipSelect(RESET);
-				   Mp3SetVolume(vol, vol);
-
-				   if(br<sizeof(buffez))
-				   {
-					   fin=1;
-				   }
-			   }
-			   Mp3SoftReset();
-
-			 int dec1=size/(VS1003_GetBitrate()*1000/8);
-			 u16 dec=Mp3ReadRegister(SPI_DECODE_TIME);
-			 PROGBAR_SetValue(hProgBar, dec*100/dec1 );
-			 taskEXIT_CRITICAL();
+			// The data goes out by DMA, see vs1003_stream.c
+			if(VS1003_StreamNext())
+			{
+				// The queued track follows without a gap
+				next=(next+1)%PL_Count();
+				track=after;
+				TEXT_SetText(hText,track.name);
+				queued=0;
+			}
+			else if(VS1003_StreamDone())
+			{
+				fin=1;
+			}
+
+			if(!queued && !fin && !PL_Get(next+1,&after))
+			{
+				PL_Path(&after,path);
+				VS1003_StreamQueue(path,after.offset);
+				queued=1;
+			}
+
+			vol=SLIDER_GetValue(hSlider);
+			if(vol!=vol_set)
+			{
+				Mp3SetVolume(vol, vol);
+				vol_set=vol;
+			}
+
+			// Progress from the bytes sent and the index, no SCI access
+			pos=VS1003_StreamTell();
+			if(track.ms && track.kbps)
+			{
+				PROGBAR_SetValue(hProgBar, (uint64_t)pos*8*100/track.kbps/track.ms);
+			}
+			else if(track.size>track.offset)
+			{
+				PROGBAR_SetValue(hProgBar, (uint64_t)pos*100/(track.size-track.offset));
+			}
 		}
 
 		if(vol_up)
@@ -327,6 +302,7 @@ void MP3_player(void *pvParameters)
 			while(BUTTON_IsPressed(hButton2)){};
 			if(play==1)play=0;
 			else play=1;
+			VS1003_StreamPause(!play);
 		}
 		if(BUTTON_IsPressed(hButton1))
 		{
@@ -337,71 +313,23 @@ void MP3_player(void *pvParameters)
 		}
 //
 
-		if(fin==1)
+		if(fin==1 && PL_Count())
 		{
+			next=(next+1+PL_Count())%PL_Count();
+			fin=0;
+			queued=0;
 
-			taskENTER_CRITICAL();
-
-			next++;
-
-			if(next==co)
+			if(!PL_Get(next,&track))
 			{
-				next=0;
-			}
-//
-				fno.lfname = lfname;
-				fno.lfsize = _MAX_LFN;
-
-				for(u8 k=6;k<106;k++)
-				{
-					name[k]=0;
-				}
-
-
-				f_opendir(&dir,"0:music");
-
-				rd=0;
-
-				while(rd!=rand[next])
-				{
-					f_readdir(&dir, &fno);
-					rd++;
-				}
-
-
-
-				if(!f_readdir(&dir, &fno) && fno.fname[0])
-				{
-					taskEXIT_CRITICAL();
-					int b=sizeof(fno.fname);
-					int h=6;
-
-					if(*fno.lfname!=0)
-					{
-						while(*fno.lfname != 0)
-						{
-							name[h]=*fno.lfname;
-							fno.lfname++;
-							h++;
-						}
-					}
-					else
-					{
-						for(int j=6;j<b+6;j++)
-						{
-							name[j]=fno.fname[j-6];
-						}
-					}
-				}
-
-			Mp3Reset();
-			taskENTER_CRITICAL();
-			f_open(&fsrc,name,FA_READ | FA_OPEN_EXISTING);
-			size=f_size(&fsrc);
-			taskEXIT_CRITICAL();
+				PL_Path(&track,path);
+
+				VS1003_StreamClose();
+				Mp3Reset();
+				vol_set=-1;
+				if(VS1003_StreamOpen(path,track.offset,NULL))fin=1;
 //
-			TEXT_SetText(hText,&name[6]);
-			fin=0;
+				TEXT_SetText(hText,track.name);
+			}
 
 //			vTaskDelay(500);
 //			vTaskResume(Heading_Handle);
@@ -411,4 +339,4 @@ void MP3_player(void *pvParameters)
 		vTaskDelay(200);
 	}
 
-}
+}
\ No newline at end of file
@@ -123,6 +123,7 @@ void LCD_char_lc(char c, int col, int line, int size, int fColor, int bColor, in
 //void LCD_box_mid_round(unsigned int x, unsigned int y, unsigned int lx, unsigned int ly, unsigned int color, u8 rad);
 void LCD_box_mid_round(unsigned int x, unsigned int y, unsigned int lx, unsigned int ly, unsigned int color, u8 rad, u8 fill);
 void LCD_goto(unsigned int x, unsigned int y);
+void LCD_area(int x, int y, int x1, int y1);
 int test_str_len(char* text, uint8_t size, u8 ret_typ);
 u8 test_resize(u8 resize);
 
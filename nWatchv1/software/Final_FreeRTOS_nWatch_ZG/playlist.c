@@ -0,0 +1,459 @@
+/*
+ * playlist.c
+ *
+ * Track index of the MP3 player.
+ *
+ * PL_INDEX holds a PL_HEADER and one PL_TRACK for each audio file of PL_DIR,
+ * in directory order, with the bitrate and duration parsed from the MPEG
+ * header. PL_Scan reads the directory once to hash it: if the hash matches
+ * the header the index is used as it is. Otherwise the directory is read
+ * again and merged with the old index (the entries keep their order on FAT,
+ * a moved one is searched PL_LOOKAHEAD records ahead), the new or changed
+ * files get a record without PL_PROBED.
+ *
+ * Those files are parsed by PL_Get, the first time they are asked for, and
+ * the record is written back. Parsing them in PL_Scan would cost one f_open
+ * each, and f_open searches the directory from its first entry: quadratic
+ * in the directory size.
+ *
+ * The play order is a table of record numbers in the external RAM, shuffled
+ * with Fisher-Yates. PL_Get reads one record from the index.
+ */
+#ifdef PLAYLIST_HOST
+  /* Host test, playlist_host.c: FatFs over a RAM image, no scheduler */
+  #include <string.h>
+  #include "ff.h"
+  #include "playlist.h"
+  #define taskENTER_CRITICAL()
+  #define taskEXIT_CRITICAL()
+  static TCHAR lfname[_MAX_LFN];
+#else
+  #include "global_inc.h"
+  #include "playlist.h"
+#endif
+
+int get_random(int from,int to);
+
+static FIL pl_file;                             // PL_INDEX, open for PL_Get
+static u8 pl_file_open;
+static uint16_t pl_count;
+static uint16_t pl_order[PL_MAX_TRACKS]__attribute((section(".ExRam")));
+static u8 pl_buf[512];
+static PL_STATS pl_stats;
+
+static const uint16_t pl_kbps[2][16] =
+{
+	{ 0, 32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320, 0 },     // MPEG1 layer III
+	{ 0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160, 0 }          // MPEG2 and 2.5 layer III
+};
+static const uint16_t pl_rate[3] = { 44100, 48000, 32000 };
+
+/*******************************************************************************
+* Function Name  : PL_Ext
+* Description    : Checks a file name extension, ignoring the case
+* Input          : name--file name
+*                  ext--extension, lower case, with the dot
+* Output         : None
+* Return         : 1 if the name ends with ext
+*******************************************************************************/
+static u8 PL_Ext(const char *name, const char *ext)
+{
+	const char *p = strrchr(name, '.');
+
+	if(p == NULL) return 0;
+
+	while(*p && *ext)
+	{
+		if((*p | 0x20) != *ext) return 0;
+		p++;
+		ext++;
+	}
+	return *p == *ext;
+}
+
+/*******************************************************************************
+* Function Name  : PL_IsAudio
+* Description    : Checks if the VS1003 can play a file
+* Input          : name--file name
+* Output         : None
+* Return         : 1 for mp3, wav, wma and mid files
+*******************************************************************************/
+static u8 PL_IsAudio(const char *name)
+{
+	return PL_Ext(name, ".mp3") || PL_Ext(name, ".wav") || PL_Ext(name, ".wma") || PL_Ext(name, ".mid");
+}
+
+/*******************************************************************************
+* Function Name  : PL_Hash
+* Description    : FNV-1a of the fields that change with the file
+* Input          : h--hash so far
+*                  t--track
+* Output         : None
+* Return         : The new hash
+*******************************************************************************/
+static uint32_t PL_Hash(uint32_t h, const PL_TRACK *t)
+{
+	const u8 *p;
+	uint32_t v[2];
+	u8 i;
+
+	for(p = (const u8 *)t->name; *p; p++)
+		h = (h ^ *p) * 16777619;
+
+	v[0] = t->size;
+	v[1] = (uint32_t)t->fdate << 16 | t->ftime;
+	for(p = (const u8 *)v, i = 0; i < sizeof(v); i++)
+		h = (h ^ p[i]) * 16777619;
+
+	return h;
+}
+
+/*******************************************************************************
+* Function Name  : PL_Same
+* Description    : Compares the fields that change with the file
+* Input          : a, b--tracks
+* Output         : None
+* Return         : 1 if a and b are the same file, unchanged
+*******************************************************************************/
+static u8 PL_Same(const PL_TRACK *a, const PL_TRACK *b)
+{
+	return a->size == b->size && a->fdate == b->fdate && a->ftime == b->ftime && !strcmp(a->name, b->name);
+}
+
+/*******************************************************************************
+* Function Name  : PL_ReadDir
+* Description    : Reads the next audio file of the directory
+* Input          : dir--open directory
+*                  fno--entry, with the long name buffer set
+* Output         : t--name, size and date, the other fields cleared
+* Return         : 1 if found, 0 at the end of the directory
+*******************************************************************************/
+static u8 PL_ReadDir(DIR *dir, FILINFO *fno, PL_TRACK *t)
+{
+	const char *name;
+
+	while(f_readdir(dir, fno) == FR_OK && fno->fname[0])
+	{
+		if(fno->fattrib & (AM_DIR | AM_HID | AM_SYS)) continue;
+
+		name = fno->fname;
+		if(*fno->lfname && strlen(fno->lfname) < PL_NAME_LEN) name = fno->lfname;
+		if(!PL_IsAudio(name)) continue;
+
+		memset(t, 0, sizeof(PL_TRACK));
+		strcpy(t->name, name);
+		t->size = fno->fsize;
+		t->fdate = fno->fdate;
+		t->ftime = fno->ftime;
+		return 1;
+	}
+	return 0;
+}
+
+/*******************************************************************************
+* Function Name  : PL_Probe
+* Description    : Skips the ID3v2 tag and parses the first MPEG layer III
+*                  frame, and its Xing/Info header if any
+* Input          : t--track, name and size set
+* Output         : t--offset, kbps, ms and flags, PL_PROBED set
+* Return         : None
+*******************************************************************************/
+static void PL_Probe(PL_TRACK *t)
+{
+	FIL f;
+	UINT br = 0, i, x;
+	u8 *h = pl_buf;
+	uint32_t off = 0, sr, spf, audio;
+	u8 ver;
+	char path[PL_PATH_LEN];
+
+	t->flags |= PL_PROBED;
+	if(!PL_Ext(t->name, ".mp3")) return;
+
+	pl_stats.probed++;
+	PL_Path(t, path);
+	if(f_open(&f, path, FA_READ | FA_OPEN_EXISTING) != FR_OK) return;
+
+	if(f_read(&f, pl_buf, 10, &br) == FR_OK && br == 10 && !memcmp(pl_buf, "ID3", 3))
+	{
+		off = 10 + ((uint32_t)(pl_buf[6] & 0x7f) << 21 | (uint32_t)(pl_buf[7] & 0x7f) << 14 |
+				(pl_buf[8] & 0x7f) << 7 | (pl_buf[9] & 0x7f));
+		if(pl_buf[5] & 0x10) off += 10;
+	}
+	if(off >= t->size || f_lseek(&f, off) != FR_OK || f_read(&f, pl_buf, sizeof(pl_buf), &br) != FR_OK) br = 0;
+	f_close(&f);
+
+	t->offset = off < t->size ? off : 0;
+
+	for(i = 0; i + 4 <= br; i++)
+	{
+		h = &pl_buf[i];
+		if(h[0] != 0xFF || (h[1] & 0xE0) != 0xE0) continue;
+		ver = (h[1] >> 3) & 3;                  // 3 MPEG1, 2 MPEG2, 0 MPEG2.5
+		if(ver == 1 || ((h[1] >> 1) & 3) != 1) continue;
+		if((h[2] >> 4) == 0 || (h[2] >> 4) == 15 || ((h[2] >> 2) & 3) == 3) continue;
+		break;
+	}
+	if(i + 4 > br) return;
+
+	t->offset = off + i;
+	t->kbps = pl_kbps[ver != 3][h[2] >> 4];
+	sr = pl_rate[(h[2] >> 2) & 3] >> (ver == 3 ? 0 : ver == 2 ? 1 : 2);
+	spf = ver == 3 ? 1152 : 576;
+	audio = t->size - t->offset;
+
+	/* The Xing/Info header follows the side information */
+	if((h[3] >> 6) == 3) x = ver == 3 ? 17 : 9;
+	else x = ver == 3 ? 32 : 17;
+	x += i + 4;
+
+	if(x + 12 <= br && (!memcmp(&pl_buf[x], "Xing", 4) || !memcmp(&pl_buf[x], "Info", 4)) && (pl_buf[x + 7] & 1))
+	{
+		uint32_t frames = (uint32_t)pl_buf[x + 8] << 24 | (uint32_t)pl_buf[x + 9] << 16 | pl_buf[x + 10] << 8 | pl_buf[x + 11];
+
+		t->ms = (uint64_t)frames * spf * 1000 / sr;
+		if(t->ms) t->kbps = (uint64_t)audio * 8 / t->ms;
+		if(pl_buf[x] == 'X') t->flags |= PL_VBR;
+	}
+	else
+	{
+		t->ms = (uint64_t)audio * 8 / t->kbps;
+	}
+}
+
+/*******************************************************************************
+* Function Name  : PL_Record
+* Description    : Reads a record of the open index
+* Input          : f--index
+*                  n--record number
+* Output         : t--record
+* Return         : 1 if read
+*******************************************************************************/
+static u8 PL_Record(FIL *f, uint32_t n, PL_TRACK *t)
+{
+	UINT br;
+
+	if(f_lseek(f, sizeof(PL_HEADER) + n * sizeof(PL_TRACK)) != FR_OK) return 0;
+	return f_read(f, t, sizeof(PL_TRACK), &br) == FR_OK && br == sizeof(PL_TRACK);
+}
+
+/*******************************************************************************
+* Function Name  : PL_Scan
+* Description    : Checks PL_INDEX against PL_DIR, rebuilds it if a file was
+*                  added, removed or changed, and opens it. The play order is
+*                  reset to the directory order.
+* Input          : None
+* Output         : None
+* Return         : The track count, -1 if PL_DIR or PL_INDEX can not be read
+*******************************************************************************/
+int PL_Scan(void)
+{
+	DIR dir;
+	FILINFO fno;
+	FIL out;
+	PL_HEADER h, old;
+	PL_TRACK t, o;
+	UINT bw;
+	uint32_t n = 0, cur = 0, k, sign = 2166136261u;
+	u8 have = 0, ok;
+
+	fno.lfname = lfname;
+	fno.lfsize = _MAX_LFN;
+
+	memset(&pl_stats, 0, sizeof(pl_stats));
+	pl_count = 0;
+
+	taskENTER_CRITICAL();
+	if(pl_file_open) f_close(&pl_file);
+	pl_file_open = 0;
+
+	/* Hash of the directory */
+	ok = f_opendir(&dir, PL_DIR) == FR_OK;
+	if(ok)
+	{
+		while(n < PL_MAX_TRACKS && PL_ReadDir(&dir, &fno, &t))
+		{
+			sign = PL_Hash(sign, &t);
+			n++;
+		}
+		f_closedir(&dir);
+	}
+
+	if(ok && f_open(&pl_file, PL_INDEX, FA_READ | FA_WRITE | FA_OPEN_EXISTING) == FR_OK)
+	{
+		pl_file_open = 1;
+		have = f_read(&pl_file, &old, sizeof(old), &bw) == FR_OK && bw == sizeof(old) &&
+			   old.magic == PL_MAGIC && old.recsize == sizeof(PL_TRACK);
+	}
+	taskEXIT_CRITICAL();
+
+	if(!ok) return -1;
+
+	if(!have || old.count != n || old.sign != sign)
+	{
+		/* Merge the directory with the old index into PL_INDEX_TMP */
+		taskENTER_CRITICAL();
+		ok = f_open(&out, PL_INDEX_TMP, FA_WRITE | FA_CREATE_ALWAYS) == FR_OK;
+		memset(&h, 0, sizeof(h));
+		ok = ok && f_write(&out, &h, sizeof(h), &bw) == FR_OK && f_opendir(&dir, PL_DIR) == FR_OK;
+		taskEXIT_CRITICAL();
+
+		n = 0;
+		while(ok && n < PL_MAX_TRACKS)
+		{
+			taskENTER_CRITICAL();
+			if(!PL_ReadDir(&dir, &fno, &t))
+			{
+				taskEXIT_CRITICAL();
+				break;
+			}
+
+			for(k = 0; have && k < PL_LOOKAHEAD && cur + k < old.count; k++)
+			{
+				if(PL_Record(&pl_file, cur + k, &o) && PL_Same(&o, &t)) break;
+			}
+
+			if(have && k < PL_LOOKAHEAD && cur + k < old.count)
+			{
+				t = o;
+				cur += k + 1;
+				pl_stats.kept++;
+			}
+			else
+			{
+				pl_stats.added++;
+			}
+
+			ok = f_write(&out, &t, sizeof(t), &bw) == FR_OK && bw == sizeof(t);
+			taskEXIT_CRITICAL();
+			n++;
+		}
+
+		taskENTER_CRITICAL();
+		f_closedir(&dir);
+
+		h.magic = PL_MAGIC;
+		h.count = n;
+		h.sign = sign;
+		h.recsize = sizeof(PL_TRACK);
+		ok = ok && f_lseek(&out, 0) == FR_OK && f_write(&out, &h, sizeof(h), &bw) == FR_OK;
+		ok = f_close(&out) == FR_OK && ok;
+
+		if(pl_file_open) f_close(&pl_file);
+		pl_file_open = 0;
+
+		if(ok)
+		{
+			f_unlink(PL_INDEX);
+			ok = f_rename(PL_INDEX_TMP, PL_INDEX) == FR_OK;
+		}
+		if(ok) ok = f_open(&pl_file, PL_INDEX, FA_READ | FA_WRITE | FA_OPEN_EXISTING) == FR_OK;
+		pl_file_open = ok;
+		taskEXIT_CRITICAL();
+
+		if(!ok) return -1;
+		pl_stats.rebuilt = 1;
+	}
+	else
+	{
+		pl_stats.kept = n;
+	}
+
+	pl_count = n;
+	pl_stats.count = n;
+	for(k = 0; k < n; k++) pl_order[k] = k;
+
+	return n;
+}
+
+/*******************************************************************************
+* Function Name  : PL_Count
+* Description    : Tracks in the index
+* Input          : None
+* Output         : None
+* Return         : The track count
+*******************************************************************************/
+uint16_t PL_Count(void)
+{
+	return pl_count;
+}
+
+/*******************************************************************************
+* Function Name  : PL_Shuffle
+* Description    : Shuffles the play order, Fisher-Yates with the RNG
+* Input          : None
+* Output         : None
+* Return         : None
+*******************************************************************************/
+void PL_Shuffle(void)
+{
+	uint16_t i, j, k;
+
+	for(i = pl_count; i > 1; i--)
+	{
+		j = get_random(0, i);
+		k = pl_order[i - 1];
+		pl_order[i - 1] = pl_order[j];
+		pl_order[j] = k;
+	}
+}
+
+/*******************************************************************************
+* Function Name  : PL_Get
+* Description    : Reads a track, parses the file and updates the index if
+*                  it was not done yet
+* Input          : pos--position in the play order, modulo the track count
+* Output         : track--the index record
+* Return         : 0 on success, 1 if empty or on read error
+*******************************************************************************/
+int PL_Get(uint16_t pos, PL_TRACK *track)
+{
+	uint16_t n;
+	UINT bw;
+	u8 ok;
+
+	if(!pl_count || !pl_file_open) return 1;
+	n = pl_order[pos % pl_count];
+
+	taskENTER_CRITICAL();
+	ok = PL_Record(&pl_file, n, track);
+	if(ok && !(track->flags & PL_PROBED))
+	{
+		PL_Probe(track);
+
+		/* A failed write only means parsing again next time */
+		if(f_lseek(&pl_file, sizeof(PL_HEADER) + n * sizeof(PL_TRACK)) == FR_OK &&
+		   f_write(&pl_file, track, sizeof(PL_TRACK), &bw) == FR_OK)
+		{
+			f_sync(&pl_file);
+		}
+	}
+	taskEXIT_CRITICAL();
+
+	return !ok;
+}
+
+/*******************************************************************************
+* Function Name  : PL_Path
+* Description    : Builds the path of a track
+* Input          : track--the index record
+* Output         : path--PL_PATH_LEN bytes
+* Return         : None
+*******************************************************************************/
+void PL_Path(const PL_TRACK *track, char *path)
+{
+	strcpy(path, PL_DIR "/");
+	strcat(path, track->name);
+}
+
+/*******************************************************************************
+* Function Name  : PL_GetStats
+* Description    : Copies the counters of the last PL_Scan
+* Input          : None
+* Output         : stats--counters
+* Return         : None
+*******************************************************************************/
+void PL_GetStats(PL_STATS *stats)
+{
+	*stats = pl_stats;
+}
@@ -0,0 +1,60 @@
+/*
+ * playlist.h
+ *
+ * Track index of the MP3 player, kept on the card in PL_INDEX, and the
+ * shuffled play order.
+ */
+#ifndef PLAYLIST_H
+#define PLAYLIST_H
+
+#include "stm32f4xx.h"
+
+#define PL_DIR                  "0:music"
+#define PL_INDEX                "0:tracks.idx"
+#define PL_INDEX_TMP            "0:tracks.tmp"
+#define PL_MAGIC                0x31494C50      // "PLI1"
+#define PL_MAX_TRACKS           8192
+#define PL_NAME_LEN             100             // Long name if it fits, else the 8.3 name
+#define PL_PATH_LEN             (sizeof(PL_DIR) + PL_NAME_LEN)
+#define PL_LOOKAHEAD            8               // Index records searched for a moved entry
+
+#define PL_VBR                  0x0001          // Duration from the Xing frame count
+#define PL_PROBED               0x0002          // offset, ms and kbps are set
+
+typedef struct
+{
+	char name[PL_NAME_LEN];
+	uint32_t size;                              // File size
+	uint32_t offset;                            // First audio byte, after the ID3v2 tag
+	uint32_t ms;                                // Duration, 0 if unknown
+	uint16_t kbps;                              // Average bitrate, 0 if unknown
+	uint16_t fdate;                             // FAT date and time, to see changes
+	uint16_t ftime;
+	uint16_t flags;
+} PL_TRACK;
+
+typedef struct
+{
+	uint32_t magic;
+	uint32_t count;
+	uint32_t sign;                              // Hash of the names, sizes and dates
+	uint32_t recsize;                           // sizeof(PL_TRACK)
+} PL_HEADER;
+
+typedef struct
+{
+	uint32_t count;                             // Tracks in the index
+	uint32_t added;                             // New or changed files found by the last scan
+	uint32_t kept;                              // Records reused by the last scan
+	uint32_t probed;                            // Files parsed since the last scan
+	uint8_t rebuilt;                            // The last scan wrote a new index
+} PL_STATS;
+
+int PL_Scan(void);
+uint16_t PL_Count(void);
+void PL_Shuffle(void);
+int PL_Get(uint16_t pos, PL_TRACK *track);
+void PL_Path(const PL_TRACK *track, char *path);
+void PL_GetStats(PL_STATS *stats);
+
+#endif
@@ -0,0 +1,374 @@
+/*
+ * playlist_host.c
+ *
+ * Host test of playlist.c: FatFs over a FAT image in RAM, 0:music holding
+ * PLH_TRACKS MP3 files with long names. It checks the first index build,
+ * the rescan of an unchanged directory, the incremental rescan after files
+ * are removed, changed and added, the records against the directory order,
+ * the parse done by PL_Get, and that PL_Shuffle gives a permutation.
+ *
+ * Build and run from this directory:
+ *   gcc -O2 -DPLAYLIST_HOST -DSTM32F4XX -DUSE_STDPERIPH_DRIVER -I. -Iff
+ *       -Icmsis_boot -Icmsis -Icmsis_lib/include -o playlist_host
+ *       playlist_host.c playlist.c ff/ff.c ff/ccsbcs.c
+ *   ./playlist_host
+ */
+#ifdef PLAYLIST_HOST
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "ff.h"
+#include "diskio.h"
+#include "playlist.h"
+
+#define PLH_SECTORS             (64 * 2048)     // 64 MB image
+#define PLH_TRACKS              5000
+#define PLH_REMOVED             10              // Every PLH_TRACKS / PLH_REMOVED-th file
+#define PLH_CHANGED             5
+#define PLH_ADDED               20
+#define PLH_SERIALS             (PLH_TRACKS + PLH_ADDED)
+#define PLH_FRAME               417             // 128 kbps, 44.1 kHz, no padding
+
+static BYTE plh_disk[PLH_SECTORS][512];
+static FATFS plh_fs;
+static u8 plh_data[4096];
+static uint32_t plh_size[PLH_SERIALS];          // Bytes of each file, 0 if removed
+static uint32_t plh_id3[PLH_SERIALS];           // ID3v2 tag bytes
+static uint16_t plh_dir[PLH_SERIALS];           // Serials in directory order
+static uint8_t plh_seen[PLH_SERIALS];
+static int plh_fails;
+
+#define PLH_CHECK(c)    do { if(!(c)) { printf("%s:%d: %s\n", __FILE__, __LINE__, #c); plh_fails++; } } while(0)
+
+/*******************************************************************************
+* Function Name  : disk_initialize, disk_status, disk_read, disk_write,
+*                  disk_ioctl, get_fattime
+* Description    : FatFs disk layer over plh_disk
+*******************************************************************************/
+DSTATUS disk_initialize(BYTE pdrv)
+{
+	return pdrv ? STA_NOINIT : 0;
+}
+
+DSTATUS disk_status(BYTE pdrv)
+{
+	return pdrv ? STA_NOINIT : 0;
+}
+
+DRESULT disk_read(BYTE pdrv, BYTE *buff, DWORD sector, UINT count)
+{
+	if(pdrv || sector + count > PLH_SECTORS) return RES_PARERR;
+	memcpy(buff, plh_disk[sector], count * 512);
+	return RES_OK;
+}
+
+DRESULT disk_write(BYTE pdrv, const BYTE *buff, DWORD sector, UINT count)
+{
+	if(pdrv || sector + count > PLH_SECTORS) return RES_PARERR;
+	memcpy(plh_disk[sector], buff, count * 512);
+	return RES_OK;
+}
+
+DRESULT disk_ioctl(BYTE pdrv, BYTE cmd, void *buff)
+{
+	switch(cmd)
+	{
+	case CTRL_SYNC:
+		return RES_OK;
+	case GET_SECTOR_COUNT:
+		*(DWORD *)buff = PLH_SECTORS;
+		return RES_OK;
+	case GET_SECTOR_SIZE:
+		*(WORD *)buff = 512;
+		return RES_OK;
+	case GET_BLOCK_SIZE:
+		*(DWORD *)buff = 1;
+		return RES_OK;
+	}
+	return RES_PARERR;
+}
+
+DWORD get_fattime(void)
+{
+	return (DWORD)(2015 - 1980) << 25 | 6 << 21 | 1 << 16;
+}
+
+/*******************************************************************************
+* Function Name  : get_random
+* Description    : Same range as the RNG one of main.c
+* Input          : from, to--range
+* Output         : None
+* Return         : from to from + to - 1
+*******************************************************************************/
+int get_random(int from, int to)
+{
+	return rand() % to + from;
+}
+
+/*******************************************************************************
+* Function Name  : PLH_Name
+* Description    : Long name of a track
+* Input          : serial--track number
+*                  dir--1 for the path in PL_DIR
+* Output         : path--the path, or the name alone
+* Return         : None
+*******************************************************************************/
+static void PLH_Name(uint32_t serial, char *path, u8 dir)
+{
+	sprintf(path, "%sSome Artist - Track Title %05u.mp3", dir ? PL_DIR "/" : "", (unsigned)serial);
+}
+
+/*******************************************************************************
+* Function Name  : PLH_Serial
+* Description    : Track number of a long name
+* Input          : name--from PLH_Name
+* Output         : None
+* Return         : The track number
+*******************************************************************************/
+static uint32_t PLH_Serial(const char *name)
+{
+	size_t len = strlen(name);
+
+	return len < 9 ? PLH_SERIALS : (uint32_t)atoi(name + len - 9);
+}
+
+/*******************************************************************************
+* Function Name  : PLH_Write
+* Description    : Writes an MP3 file: an ID3v2 tag for one track in three,
+*                  then 128 kbps MPEG1 layer III frames. The size depends on
+*                  the serial and on gen, to change a file.
+* Input          : serial--track number
+*                  gen--0 the first time, 1 for a changed file
+* Output         : None
+* Return         : 1 if written
+*******************************************************************************/
+static u8 PLH_Write(uint32_t serial, u8 gen)
+{
+	FIL f;
+	UINT bw;
+	char path[PL_PATH_LEN];
+	uint32_t id3 = serial % 3 ? 0 : 100 + serial % 200;
+	uint32_t frames = 2 + (serial + gen) % 5, len = 0, i;
+
+	if(id3)
+	{
+		memcpy(plh_data, "ID3\x03\x00\x00", 6);
+		plh_data[6] = 0;
+		plh_data[7] = 0;
+		plh_data[8] = (id3 - 10) >> 7;
+		plh_data[9] = (id3 - 10) & 0x7f;
+		memset(plh_data + 10, 0, id3 - 10);
+		len = id3;
+	}
+	for(i = 0; i < frames; i++, len += PLH_FRAME)
+	{
+		memset(plh_data + len, 0x55, PLH_FRAME);
+		plh_data[len] = 0xFF;
+		plh_data[len + 1] = 0xFB;
+		plh_data[len + 2] = 0x90;
+		plh_data[len + 3] = 0x64;
+	}
+
+	PLH_Name(serial, path, 1);
+	if(f_open(&f, path, FA_WRITE | FA_CREATE_ALWAYS) != FR_OK) return 0;
+	if(f_write(&f, plh_data, len, &bw) != FR_OK || bw != len) bw = 0;
+	if(f_close(&f) != FR_OK) bw = 0;
+
+	plh_size[serial] = len;
+	plh_id3[serial] = id3;
+	return bw == len;
+}
+
+/*******************************************************************************
+* Function Name  : PLH_Remove
+* Description    : Deletes a track
+* Input          : serial--track number
+* Output         : None
+* Return         : 1 if deleted
+*******************************************************************************/
+static u8 PLH_Remove(uint32_t serial)
+{
+	char path[PL_PATH_LEN];
+
+	PLH_Name(serial, path, 1);
+	plh_size[serial] = 0;
+	return f_unlink(path) == FR_OK;
+}
+
+/*******************************************************************************
+* Function Name  : PLH_ReadDir
+* Description    : Lists the serials of 0:music in directory order
+* Input          : None
+* Output         : plh_dir
+* Return         : Tracks found
+*******************************************************************************/
+static uint32_t PLH_ReadDir(void)
+{
+	DIR dir;
+	FILINFO fno;
+	static TCHAR name[_MAX_LFN];
+	uint32_t n = 0;
+
+	fno.lfname = name;
+	fno.lfsize = _MAX_LFN;
+	if(f_opendir(&dir, PL_DIR) != FR_OK) return 0;
+	while(f_readdir(&dir, &fno) == FR_OK && fno.fname[0])
+	{
+		if(fno.fattrib & AM_DIR || !strstr(fno.lfname, ".mp3")) continue;
+		plh_dir[n++] = PLH_Serial(fno.lfname);
+	}
+	f_closedir(&dir);
+	return n;
+}
+
+/*******************************************************************************
+* Function Name  : PLH_Scan
+* Description    : Runs PL_Scan and prints its counters and time
+* Input          : what--label
+* Output         : stats--counters of the scan
+* Return         : PL_Scan result
+*******************************************************************************/
+static int PLH_Scan(const char *what, PL_STATS *stats)
+{
+	clock_t t = clock();
+	int n = PL_Scan();
+
+	t = clock() - t;
+	PL_GetStats(stats);
+	printf("%-12s %5d tracks, added %5u kept %5u rebuilt %u, %6.1f ms\n", what, n,
+		   (unsigned)stats->added, (unsigned)stats->kept, stats->rebuilt, t * 1000.0 / CLOCKS_PER_SEC);
+	return n;
+}
+
+/*******************************************************************************
+* Function Name  : PLH_Check
+* Description    : Reads every position of the play order with PL_Get and
+*                  checks the record against the file, and that each track
+*                  of the directory comes once
+* Input          : n--tracks
+* Output         : None
+* Return         : Positions that hold the track of the directory order
+*******************************************************************************/
+static uint32_t PLH_Check(uint32_t n)
+{
+	PL_TRACK t;
+	uint32_t i, s, same = 0, bad = 0;
+
+	memset(plh_seen, 0, sizeof(plh_seen));
+	for(i = 0; i < n; i++)
+	{
+		if(PL_Get(i, &t))
+		{
+			bad++;
+			continue;
+		}
+		s = PLH_Serial(t.name);
+		if(s >= PLH_SERIALS || plh_seen[s]++ || !plh_size[s] || t.size != plh_size[s] ||
+		   !(t.flags & PL_PROBED) || t.offset != plh_id3[s] || t.kbps != 128 ||
+		   t.ms != (t.size - t.offset) * 8 / 128)
+		{
+			bad++;
+			continue;
+		}
+		if(s == plh_dir[i]) same++;
+	}
+	for(i = 0; i < n; i++)
+	{
+		if(!plh_seen[plh_dir[i]]) bad++;
+	}
+	PLH_CHECK(bad == 0);
+	return same;
+}
+
+int main(void)
+{
+	PL_STATS st;
+	PL_TRACK t;
+	clock_t c;
+	uint32_t i, n, probed, same;
+
+	PLH_CHECK(f_mount(&plh_fs, "", 0) == FR_OK);
+	PLH_CHECK(f_mkfs("", 1, 0) == FR_OK);
+	PLH_CHECK(f_mkdir(PL_DIR) == FR_OK);
+
+	c = clock();
+	for(i = 0; i < PLH_TRACKS; i++)
+	{
+		if(!PLH_Write(i, 0))
+		{
+			printf("writing track %u failed\n", (unsigned)i);
+			return 1;
+		}
+	}
+	printf("%u files written, %.1f ms\n", PLH_TRACKS, (clock() - c) * 1000.0 / CLOCKS_PER_SEC);
+
+	/* First scan: every record is new */
+	n = PLH_ReadDir();
+	PLH_CHECK(n == PLH_TRACKS);
+	PLH_CHECK(PLH_Scan("build", &st) == PLH_TRACKS);
+	PLH_CHECK(st.rebuilt && st.added == PLH_TRACKS && st.kept == 0 && st.probed == 0);
+
+	/* Unchanged directory: the index is used as it is */
+	PLH_CHECK(PLH_Scan("rescan", &st) == PLH_TRACKS);
+	PLH_CHECK(!st.rebuilt && st.added == 0 && st.kept == PLH_TRACKS);
+
+	/* Directory order, every file parsed once and written back */
+	c = clock();
+	same = PLH_Check(n);
+	PL_GetStats(&st);
+	printf("%-12s %5u records, %u parsed, %.1f ms\n", "get", (unsigned)n, (unsigned)st.probed,
+		   (clock() - c) * 1000.0 / CLOCKS_PER_SEC);
+	PLH_CHECK(same == n && st.probed == n);
+	PLH_CHECK(PL_Get(n + 3, &t) == 0 && PLH_Serial(t.name) == plh_dir[3]);
+	PL_GetStats(&st);
+	probed = st.probed;
+	PLH_Check(n);
+	PL_GetStats(&st);
+	PLH_CHECK(st.probed == probed);
+
+	/* Remove, change and add files: only those get new records */
+	for(i = 0; i < PLH_REMOVED; i++) PLH_CHECK(PLH_Remove(i * (PLH_TRACKS / PLH_REMOVED) + 7));
+	for(i = 0; i < PLH_CHANGED; i++) PLH_CHECK(PLH_Write(i * (PLH_TRACKS / PLH_CHANGED) + 250, 1));
+	for(i = 0; i < PLH_ADDED; i++) PLH_CHECK(PLH_Write(PLH_TRACKS + i, 0));
+
+	n = PLH_ReadDir();
+	PLH_CHECK(n == PLH_TRACKS - PLH_REMOVED + PLH_ADDED);
+	PLH_CHECK(PLH_Scan("incremental", &st) == (int)n);
+	PLH_CHECK(st.rebuilt && st.added == PLH_CHANGED + PLH_ADDED);
+	PLH_CHECK(st.kept == PLH_TRACKS - PLH_REMOVED - PLH_CHANGED);
+
+	/* The kept records keep their parse, the new ones are parsed */
+	same = PLH_Check(n);
+	PL_GetStats(&st);
+	printf("%-12s %5u records, %u parsed\n", "get", (unsigned)n, (unsigned)st.probed);
+	PLH_CHECK(same == n && st.probed == PLH_CHANGED + PLH_ADDED);
+
+	/* Fisher-Yates: a permutation of the directory order */
+	srand(1);
+	PL_Shuffle();
+	same = PLH_Check(n);
+	printf("%-12s %5u records, %u in place\n", "shuffle", (unsigned)n, (unsigned)same);
+	PLH_CHECK(same < 10);
+	PL_Shuffle();
+	PLH_Check(n);
+
+	/* A new index is read back from the card as it was written */
+	PLH_CHECK(PLH_Scan("rescan", &st) == (int)n);
+	PLH_CHECK(!st.rebuilt && st.kept == n);
+	PLH_CHECK(PLH_Check(n) == n);
+	PL_GetStats(&st);
+	PLH_CHECK(st.probed == 0);
+
+	printf("%s\n", plh_fails ? "FAILED" : "passed");
+	return plh_fails != 0;
+}
+
+#else
+
+void playlist_host_c(void); // Avoid empty object files
+void playlist_host_c(void) {}
+
+#endif
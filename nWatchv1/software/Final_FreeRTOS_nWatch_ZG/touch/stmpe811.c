@@ -8,6 +8,7 @@
 #include <stm32f4xx_rcc.h>
 #include <stm32f4xx_i2c.h>
 #include "stmpe811.h"
+#include "vs1003_stream.h"
 #include "list1.h"
 #include "textbox.h"
 
@@ -395,6 +396,14 @@ void EXTI9_5_IRQHandler(void)
 	u8 zk=0;
 	u8 x[1]={0},y[1]={0};
 
+	if(EXTI->PR & EXTI_PR_PR8)
+	{
+		EXTI->PR = EXTI_PR_PR8;
+		VS1003_StreamDREQ_IRQ();
+	}
+
+	if(!(EXTI->PR & EXTI_PR_PR5)) return;
+
 	I2C_Read_Reg( 0x0b,&zk,1);
 
 	if((zk & 0x02))
@@ -417,7 +426,7 @@ void EXTI9_5_IRQHandler(void)
 	I2C_Write_Byte(0x4b, 0x01);
 	I2C_Write_Byte(0x4b, 0x00);
 
-	EXTI->PR |= EXTI_PR_PR5;
+	EXTI->PR = EXTI_PR_PR5;
 }
 void stmpe(void)
 {
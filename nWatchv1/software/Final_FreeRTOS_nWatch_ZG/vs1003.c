@@ -1,5 +1,6 @@
 /* Includes ------------------------------------------------------------------*/
 #include "vs1003.h"
+#include "vs1003_stream.h"
 
 /* Const define  -------------------------------------------------------------*/
 #define RXNE    0x01
@@ -294,6 +295,7 @@ void VsRamTest(void)
 *******************************************************************************/
 void Mp3WriteRegister(unsigned char addressbyte, unsigned char highbyte, unsigned char lowbyte)
 {
+	VS1003_StreamHold();
 	SDI_ChipSelect(RESET);
 	while(DREQ);
 	SCI_ChipSelect(SET);
@@ -304,6 +306,7 @@ void Mp3WriteRegister(unsigned char addressbyte, unsigned char highbyte, unsigne
 	SCI_ChipSelect(RESET);
 	while(DREQ);
 	SCI_ChipSelect(RESET);
+	VS1003_StreamRelease();
 
 }
 
@@ -317,6 +320,7 @@ void Mp3WriteRegister(unsigned char addressbyte, unsigned char highbyte, unsigne
 u16 Mp3ReadRegister(unsigned char addressbyte)
 {
 	u16 resultvalue = 0;
+	VS1003_StreamHold();
 	SDI_ChipSelect(RESET);
 	while(DREQ);
 	SCI_ChipSelect(SET);				//XCS = 0
@@ -326,6 +330,7 @@ u16 Mp3ReadRegister(unsigned char addressbyte)
 	resultvalue |= SPIGetChar();  	//ȥ8Ν
 	while(DREQ);
 	SCI_ChipSelect(RESET);
+	VS1003_StreamRelease();
 	return resultvalue;           	//16ΝĴ־
 
 }
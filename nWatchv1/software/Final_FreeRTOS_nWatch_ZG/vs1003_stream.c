@@ -0,0 +1,562 @@
+/*
+ * vs1003_stream.c
+ *
+ * VS1003 data streaming without busy waits.
+ *
+ * A producer task reads the file into a ring of STREAM_BUF_COUNT buffers.
+ * The VS1003 raises DREQ when its FIFO can take STREAM_BURST bytes: the DREQ
+ * rising edge (EXTI line 8) starts a SPI1 TX DMA burst, and the end of the
+ * burst (RX DMA transfer complete, the last byte is out of the shifter) starts
+ * the next one while DREQ stays high. The task only sleeps and reads.
+ *
+ * The two interrupts run at the same priority, above
+ * configMAX_SYSCALL_INTERRUPT_PRIORITY: they are not masked by the critical
+ * sections of the other tasks and do not call FreeRTOS. The ring counters
+ * have one writer each (stream_filled the task, stream_drained the
+ * interrupts), so no lock is needed.
+ *
+ * VS1003_StreamQueue names the track that follows. The task opens it and
+ * reads its first STREAM_BUF_SIZE bytes while the current one plays; at the
+ * end of the current file it goes on with the queued one in the same ring
+ * buffer, so the decoder never sees a gap. The byte where the new track
+ * starts is kept, VS1003_StreamNext reports when the decoder got there.
+ *
+ * Load: 128 to 320 kbps is 16000 to 40000 bytes/s, 500 to 1250 bursts/s,
+ * with two interrupts per burst at most (DMA end, DREQ edge). SPI1 runs at
+ * 84MHz/32, a burst takes 98us: the bus is busy 12% of the time at 320kbps.
+ * The 3 buffers queued ahead of the one being sent last 384ms at 128kbps
+ * and 154ms at 320kbps; a slower f_read (read_max) ends in an underrun.
+ * isr_cycles counts the DWT cycles of both interrupts, without their entry
+ * and exit: the load is isr_cycles / (SystemCoreClock * seconds played).
+ */
+#include "global_inc.h"
+#include "vs1003_stream.h"
+
+#define STREAM_RX_FLAGS (DMA_LIFCR_CTCIF2 | DMA_LIFCR_CHTIF2 | DMA_LIFCR_CTEIF2 | DMA_LIFCR_CDMEIF2 | DMA_LIFCR_CFEIF2)
+#define STREAM_TX_FLAGS (DMA_HIFCR_CTCIF5 | DMA_HIFCR_CHTIF5 | DMA_HIFCR_CTEIF5 | DMA_HIFCR_CDMEIF5 | DMA_HIFCR_CFEIF5)
+
+#define NEXT_NONE   0
+#define NEXT_OPEN   1                           // Queued, the task opens it
+#define NEXT_READY  2                           // Open, first bytes in stream_pre
+
+static u8 stream_buf[STREAM_BUF_COUNT][STREAM_BUF_SIZE];
+static u8 stream_pre[STREAM_BUF_SIZE];          // First bytes of the queued track
+static volatile u8 stream_dummy;                // RX DMA sink
+static FIL stream_file;
+static FIL stream_next;
+static char stream_next_path[STREAM_PATH_LEN];
+static uint32_t stream_next_offset;
+static xTaskHandle stream_task;
+
+static volatile uint32_t stream_filled;         // Buffers written, producer task only
+static volatile uint32_t stream_drained;        // Buffers sent, interrupts only
+static volatile uint32_t stream_pos;            // Offset in the buffer being sent
+static volatile u8 stream_open;                 // File open
+static volatile u8 stream_paused;
+static volatile u8 stream_eof;                  // Last buffer queued
+static volatile u8 stream_pad;                  // Queue one more zero buffer, then end
+static volatile u8 stream_busy;                 // Burst in progress
+static volatile u8 stream_held;                 // SCI access in progress, see VS1003_StreamHold
+static volatile u8 stream_starved;              // DREQ high and nothing to send
+static volatile u8 stream_next_state;           // NEXT_NONE, NEXT_OPEN, NEXT_READY
+static volatile u8 stream_switch;               // The task moved to the queued track
+static u8 stream_pre_cur;                       // stream_pre belongs to the current track
+static UINT stream_pre_pos;
+static UINT stream_pre_len;
+static volatile uint32_t stream_sent;           // Bytes sent since VS1003_StreamOpen, interrupts only
+static uint32_t stream_queued;                  // Bytes of file data in the ring since VS1003_StreamOpen
+static volatile uint32_t stream_boundary;       // stream_queued where the queued track starts
+static uint32_t stream_start;                   // stream_sent where the current track starts
+static STREAM_STATS stream_stats;
+
+/*******************************************************************************
+* Function Name  : Stream_Kick
+* Description    : Pends EXTI line 8, as a DREQ rising edge would do
+* Input          : None
+* Output         : None
+* Return         : None
+*******************************************************************************/
+static void Stream_Kick(void)
+{
+	EXTI->SWIER |= EXTI_SWIER_SWIER8;
+}
+
+/*******************************************************************************
+* Function Name  : Stream_Pump
+* Description    : Starts a DMA burst if the VS1003 wants data and the ring
+*                  has some. Interrupt context only.
+* Input          : None
+* Output         : None
+* Return         : None
+*******************************************************************************/
+static void Stream_Pump(void)
+{
+	u8 *p;
+
+	if(stream_busy || stream_held || stream_paused || !stream_open) return;
+	if(DREQ) return;
+
+	if(stream_filled == stream_drained)
+	{
+		if(!stream_eof && !stream_starved) stream_stats.underruns++;
+		stream_starved = 1;
+		return;
+	}
+	stream_starved = 0;
+
+	p = &stream_buf[stream_drained % STREAM_BUF_COUNT][stream_pos];
+	stream_busy = 1;
+
+	GPIO_ResetBits(XDCS_PORT, XDCS_PIN);
+
+	DMA2->LIFCR = STREAM_RX_FLAGS;
+	DMA2->HIFCR = STREAM_TX_FLAGS;
+	DMA2_Stream5->M0AR = (uint32_t)p;
+	DMA2_Stream5->NDTR = STREAM_BURST;
+	DMA2_Stream2->NDTR = STREAM_BURST;
+	DMA2_Stream2->CR |= DMA_SxCR_EN;
+	DMA2_Stream5->CR |= DMA_SxCR_EN;
+	SPI1->CR2 |= SPI_CR2_RXDMAEN | SPI_CR2_TXDMAEN;
+}
+
+/*******************************************************************************
+* Function Name  : DMA2_Stream2_IRQHandler
+* Description    : End of a burst, SPI1 RX DMA transfer complete
+* Input          : None
+* Output         : None
+* Return         : None
+*******************************************************************************/
+void DMA2_Stream2_IRQHandler(void)
+{
+	uint32_t t = DWT->CYCCNT;
+
+	if(!(DMA2->LISR & DMA_LISR_TCIF2)) return;
+
+	DMA2->LIFCR = STREAM_RX_FLAGS;
+	SPI1->CR2 &= ~(SPI_CR2_RXDMAEN | SPI_CR2_TXDMAEN);
+
+	stream_stats.bytes += STREAM_BURST;
+	stream_stats.bursts++;
+	stream_sent += STREAM_BURST;
+
+	stream_pos += STREAM_BURST;
+	if(stream_pos == STREAM_BUF_SIZE)
+	{
+		stream_pos = 0;
+		stream_drained++;
+	}
+	stream_busy = 0;
+
+	Stream_Pump();
+
+	stream_stats.isr_cycles += DWT->CYCCNT - t;
+}
+
+/*******************************************************************************
+* Function Name  : VS1003_StreamDREQ_IRQ
+* Description    : DREQ rising edge, called from EXTI9_5_IRQHandler
+* Input          : None
+* Output         : None
+* Return         : None
+*******************************************************************************/
+void VS1003_StreamDREQ_IRQ(void)
+{
+	uint32_t t = DWT->CYCCNT;
+
+	Stream_Pump();
+
+	stream_stats.isr_cycles += DWT->CYCCNT - t;
+}
+
+/*******************************************************************************
+* Function Name  : Stream_Prefetch
+* Description    : Opens the queued track and reads its first bytes. Waits
+*                  while stream_pre still holds data of the current track.
+*                  Producer task only.
+* Input          : None
+* Output         : None
+* Return         : None
+*******************************************************************************/
+static void Stream_Prefetch(void)
+{
+	if(stream_next_state != NEXT_OPEN || stream_pre_cur) return;
+
+	if(f_open(&stream_next, stream_next_path, FA_READ | FA_OPEN_EXISTING) != FR_OK)
+	{
+		stream_stats.errors++;
+		stream_next_state = NEXT_NONE;
+		return;
+	}
+
+	if(f_lseek(&stream_next, stream_next_offset) != FR_OK ||
+	   f_read(&stream_next, stream_pre, STREAM_BUF_SIZE, &stream_pre_len) != FR_OK)
+	{
+		stream_stats.errors++;
+		f_close(&stream_next);
+		stream_next_state = NEXT_NONE;
+		return;
+	}
+
+	stream_pre_pos = 0;
+	stream_next_state = NEXT_READY;
+}
+
+/*******************************************************************************
+* Function Name  : Stream_Read
+* Description    : Reads the current track, then the queued one once the
+*                  current one ends. Producer task only.
+* Input          : n--bytes wanted
+* Output         : p--data
+* Return         : Bytes read, less than n at the end of the last track
+*******************************************************************************/
+static UINT Stream_Read(u8 *p, UINT n)
+{
+	UINT got = 0, br;
+	FRESULT f;
+	TickType_t t;
+
+	while(got < n)
+	{
+		if(stream_pre_cur)
+		{
+			br = stream_pre_len - stream_pre_pos;
+			if(br > n - got) br = n - got;
+			memcpy(p + got, &stream_pre[stream_pre_pos], br);
+			stream_pre_pos += br;
+			got += br;
+			if(stream_pre_pos == stream_pre_len) stream_pre_cur = 0;
+			continue;
+		}
+
+		t = xTaskGetTickCount();
+		f = f_read(&stream_file, p + got, n - got, &br);
+		t = xTaskGetTickCount() - t;
+
+		stream_stats.reads++;
+		if(t > stream_stats.read_max) stream_stats.read_max = t;
+		if(f != FR_OK)
+		{
+			stream_stats.errors++;
+			br = 0;
+		}
+
+		got += br;
+		if(got == n) break;
+
+		/* End of the track, go on with the queued one */
+		Stream_Prefetch();
+		if(stream_next_state != NEXT_READY) break;
+
+		f_close(&stream_file);
+		stream_file = stream_next;
+		stream_pre_cur = 1;
+		stream_boundary = stream_queued + got;
+		stream_switch = 1;
+		stream_next_state = NEXT_NONE;
+		stream_stats.gapless++;
+	}
+
+	return got;
+}
+
+/*******************************************************************************
+* Function Name  : Stream_Task
+* Description    : Producer, fills the free buffers of the ring from the file.
+*                  Ends the last file with STREAM_BUF_SIZE zero bytes at
+*                  least, so the VS1003 plays its last frame.
+* Input          : None
+* Output         : None
+* Return         : None
+*******************************************************************************/
+static void Stream_Task(void *pvParameters)
+{
+	u8 *p;
+	UINT br;
+
+	while(1)
+	{
+		while(stream_open && !stream_eof && stream_filled - stream_drained < STREAM_BUF_COUNT)
+		{
+			p = stream_buf[stream_filled % STREAM_BUF_COUNT];
+			br = 0;
+
+			if(!stream_pad) br = Stream_Read(p, STREAM_BUF_SIZE);
+			stream_queued += br;
+
+			if(br < STREAM_BUF_SIZE)
+			{
+				memset(p + br, 0, STREAM_BUF_SIZE - br);
+				if(br) stream_pad = 1;
+				else stream_eof = 1;
+			}
+
+			stream_filled++;
+
+			if(stream_starved) Stream_Kick();
+		}
+
+		if(stream_open) Stream_Prefetch();
+
+		ulTaskNotifyTake(pdTRUE, STREAM_POLL_MS / portTICK_PERIOD_MS);
+	}
+}
+
+/*******************************************************************************
+* Function Name  : VS1003_StreamInit
+* Description    : Configures SPI1 DMA, the DREQ interrupt and the producer
+*                  task. SPI1 itself is configured by VS1003_Config.
+* Input          : None
+* Output         : None
+* Return         : None
+*******************************************************************************/
+void VS1003_StreamInit(void)
+{
+	DMA_InitTypeDef DMA_InitStructure;
+
+	RCC->AHB1ENR |= RCC_AHB1ENR_DMA2EN;
+	RCC->APB2ENR |= RCC_APB2ENR_SYSCFGEN;
+
+	/* Cycle counter of isr_cycles */
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+	DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+	/* SPI1_TX: DMA2 Stream5 Channel3, the address is set for each burst */
+	DMA_Cmd(DMA2_Stream5, DISABLE);
+	DMA_DeInit(DMA2_Stream5);
+	DMA_InitStructure.DMA_Channel = DMA_Channel_3;
+	DMA_InitStructure.DMA_PeripheralBaseAddr = (uint32_t)&SPI1->DR;
+	DMA_InitStructure.DMA_Memory0BaseAddr = (uint32_t)stream_buf;
+	DMA_InitStructure.DMA_DIR = DMA_DIR_MemoryToPeripheral;
+	DMA_InitStructure.DMA_BufferSize = STREAM_BURST;
+	DMA_InitStructure.DMA_PeripheralInc = DMA_PeripheralInc_Disable;
+	DMA_InitStructure.DMA_MemoryInc = DMA_MemoryInc_Enable;
+	DMA_InitStructure.DMA_PeripheralDataSize = DMA_PeripheralDataSize_Byte;
+	DMA_InitStructure.DMA_MemoryDataSize = DMA_MemoryDataSize_Byte;
+	DMA_InitStructure.DMA_Mode = DMA_Mode_Normal;
+	DMA_InitStructure.DMA_Priority = DMA_Priority_High;
+	DMA_InitStructure.DMA_FIFOMode = DMA_FIFOMode_Disable;
+	DMA_InitStructure.DMA_FIFOThreshold = DMA_FIFOThreshold_Full;
+	DMA_InitStructure.DMA_MemoryBurst = DMA_MemoryBurst_Single;
+	DMA_InitStructure.DMA_PeripheralBurst = DMA_PeripheralBurst_Single;
+	DMA_Init(DMA2_Stream5, &DMA_InitStructure);
+
+	/* SPI1_RX: DMA2 Stream2 Channel3, drains DR and ends the burst */
+	DMA_Cmd(DMA2_Stream2, DISABLE);
+	DMA_DeInit(DMA2_Stream2);
+	DMA_InitStructure.DMA_Memory0BaseAddr = (uint32_t)&stream_dummy;
+	DMA_InitStructure.DMA_DIR = DMA_DIR_PeripheralToMemory;
+	DMA_InitStructure.DMA_MemoryInc = DMA_MemoryInc_Disable;
+	DMA_Init(DMA2_Stream2, &DMA_InitStructure);
+	DMA_ITConfig(DMA2_Stream2, DMA_IT_TC, ENABLE);
+
+	NVIC_SetPriority(DMA2_Stream2_IRQn, STREAM_IRQ_PRIORITY);
+	NVIC_EnableIRQ(DMA2_Stream2_IRQn);
+
+	/* DREQ: PA8 rising edge, shares EXTI9_5 with the touch panel */
+	SYSCFG->EXTICR[2] &= ~SYSCFG_EXTICR3_EXTI8;
+	EXTI->RTSR |= EXTI_RTSR_TR8;
+	EXTI->IMR |= EXTI_IMR_MR8;
+	NVIC_SetPriority(EXTI9_5_IRQn, STREAM_IRQ_PRIORITY);
+	NVIC_EnableIRQ(EXTI9_5_IRQn);
+
+	if(stream_task == NULL)
+		xTaskCreate(Stream_Task, (char const*)"Stream", STREAM_TASK_STACK, NULL, STREAM_TASK_PRIORITY, &stream_task);
+}
+
+/*******************************************************************************
+* Function Name  : VS1003_StreamOpen
+* Description    : Closes the current file, opens a new one and fills the ring.
+*                  Sending starts at once unless paused.
+* Input          : path--file name
+*                  offset--first byte to send, to skip a tag
+* Output         : size--file size, can be NULL
+* Return         : FR_OK, or the f_open/f_lseek error
+*******************************************************************************/
+int VS1003_StreamOpen(const char *path, uint32_t offset, uint32_t *size)
+{
+	FRESULT f;
+
+	VS1003_StreamClose();
+
+	taskENTER_CRITICAL();
+	f = f_open(&stream_file, path, FA_READ | FA_OPEN_EXISTING);
+	if(f == FR_OK)
+	{
+		f = f_lseek(&stream_file, offset);
+		if(f != FR_OK) f_close(&stream_file);
+	}
+	taskEXIT_CRITICAL();
+
+	if(f != FR_OK) return f;
+	if(size) *size = f_size(&stream_file);
+
+	stream_next_state = NEXT_NONE;
+	stream_switch = 0;
+	stream_pre_cur = 0;
+	stream_sent = 0;
+	stream_queued = 0;
+	stream_start = 0;
+	stream_filled = 0;
+	stream_drained = 0;
+	stream_pos = 0;
+	stream_eof = 0;
+	stream_pad = 0;
+	stream_starved = 0;
+	stream_open = 1;
+
+	/* The producer has the higher priority, the ring is full on return */
+	xTaskNotifyGive(stream_task);
+	Stream_Kick();
+
+	return FR_OK;
+}
+
+/*******************************************************************************
+* Function Name  : VS1003_StreamQueue
+* Description    : Names the track that follows the current one. The task
+*                  opens it and reads its first bytes at once.
+* Input          : path--file name, STREAM_PATH_LEN at most
+*                  offset--first byte to send, to skip a tag
+* Output         : None
+* Return         : 0 if queued, 1 if a track is queued already or the current
+*                  one ended
+*******************************************************************************/
+int VS1003_StreamQueue(const char *path, uint32_t offset)
+{
+	if(!stream_open || stream_eof || stream_pad) return 1;
+	if(stream_next_state != NEXT_NONE || stream_switch) return 1;
+	if(strlen(path) >= STREAM_PATH_LEN) return 1;
+
+	strcpy(stream_next_path, path);
+	stream_next_offset = offset;
+	stream_next_state = NEXT_OPEN;
+
+	xTaskNotifyGive(stream_task);
+
+	return 0;
+}
+
+/*******************************************************************************
+* Function Name  : VS1003_StreamTell
+* Description    : Bytes of the current track sent to the VS1003, from the
+*                  offset given to VS1003_StreamOpen/VS1003_StreamQueue
+* Input          : None
+* Output         : None
+* Return         : The byte count
+*******************************************************************************/
+uint32_t VS1003_StreamTell(void)
+{
+	uint32_t sent = stream_sent;
+
+	if(stream_switch && sent >= stream_boundary)
+	{
+		stream_start = stream_boundary;
+		stream_switch = 0;
+	}
+
+	return sent - stream_start;
+}
+
+/*******************************************************************************
+* Function Name  : VS1003_StreamNext
+* Description    : Checks if the VS1003 got to the queued track
+* Input          : None
+* Output         : None
+* Return         : 1 once, when the queued track became the current one
+*******************************************************************************/
+uint8_t VS1003_StreamNext(void)
+{
+	if(!stream_switch || stream_sent < stream_boundary) return 0;
+
+	VS1003_StreamTell();
+	return 1;
+}
+
+/*******************************************************************************
+* Function Name  : VS1003_StreamClose
+* Description    : Stops sending after the current burst and closes the file,
+*                  and the queued one. Data already in the VS1003 FIFO is not
+*                  flushed.
+* Input          : None
+* Output         : None
+* Return         : None
+*******************************************************************************/
+void VS1003_StreamClose(void)
+{
+	if(!stream_open) return;
+
+	stream_open = 0;
+	while(stream_busy);
+	GPIO_SetBits(XDCS_PORT, XDCS_PIN);
+
+	taskENTER_CRITICAL();
+	f_close(&stream_file);
+	if(stream_next_state == NEXT_READY) f_close(&stream_next);
+	taskEXIT_CRITICAL();
+
+	stream_next_state = NEXT_NONE;
+}
+
+/*******************************************************************************
+* Function Name  : VS1003_StreamPause
+* Description    : Stops or restarts sending. The ring stays full.
+* Input          : pause--1 to stop, 0 to restart
+* Output         : None
+* Return         : None
+*******************************************************************************/
+void VS1003_StreamPause(uint8_t pause)
+{
+	stream_paused = pause;
+	if(!pause) Stream_Kick();
+}
+
+/*******************************************************************************
+* Function Name  : VS1003_StreamDone
+* Description    : Checks the end of the file
+* Input          : None
+* Output         : None
+* Return         : 1 when the whole file and its end fill were sent
+*******************************************************************************/
+uint8_t VS1003_StreamDone(void)
+{
+	return stream_open && stream_eof && !stream_busy && stream_filled == stream_drained;
+}
+
+/*******************************************************************************
+* Function Name  : VS1003_StreamGetStats
+* Description    : Copies the counters
+* Input          : None
+* Output         : stats--counters since VS1003_StreamInit
+* Return         : None
+*******************************************************************************/
+void VS1003_StreamGetStats(STREAM_STATS *stats)
+{
+	*stats = stream_stats;
+}
+
+/*******************************************************************************
+* Function Name  : VS1003_StreamHold
+* Description    : Waits for the current burst and keeps SPI1 for SCI access,
+*                  see Mp3WriteRegister. Calls can nest. Task context only.
+* Input          : None
+* Output         : None
+* Return         : None
+*******************************************************************************/
+void VS1003_StreamHold(void)
+{
+	stream_held++;
+	while(stream_busy);
+}
+
+/*******************************************************************************
+* Function Name  : VS1003_StreamRelease
+* Description    : Ends VS1003_StreamHold, the DREQ edges missed meanwhile
+*                  are served at once.
+* Input          : None
+* Output         : None
+* Return         : None
+*******************************************************************************/
+void VS1003_StreamRelease(void)
+{
+	if(stream_held && !--stream_held) Stream_Kick();
+}
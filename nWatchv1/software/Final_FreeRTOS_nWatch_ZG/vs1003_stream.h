@@ -0,0 +1,48 @@
+/*
+ * vs1003_stream.h
+ *
+ * VS1003 data streaming: a producer task fills a ring of buffers from FatFs,
+ * SPI1 TX DMA sends them in 32 byte bursts whenever DREQ is high. A queued
+ * track is opened and prefetched ahead, and follows the current one without
+ * a gap.
+ */
+#ifndef VS1003_STREAM_H
+#define VS1003_STREAM_H
+
+#include "stm32f4xx.h"
+
+#define STREAM_BUF_COUNT        4               // Ring buffers
+#define STREAM_BUF_SIZE         2048            // Bytes per ring buffer, one f_read
+#define STREAM_BURST            32              // Bytes the VS1003 takes for each DREQ
+#define STREAM_POLL_MS          10              // Producer period, the ring holds 200ms at 320kbps
+#define STREAM_TASK_PRIORITY    8               // Above every task using FatFs
+#define STREAM_TASK_STACK       256
+#define STREAM_IRQ_PRIORITY     1               // EXTI9_5 and DMA2_Stream2, no FreeRTOS calls
+#define STREAM_PATH_LEN         112             // Queued file name, with the directory
+
+typedef struct
+{
+	uint32_t bytes;                             // Bytes sent to the VS1003
+	uint32_t bursts;                            // DMA bursts
+	uint32_t underruns;                         // DREQ high with an empty ring, not at end of file
+	uint32_t reads;                             // f_read calls
+	uint32_t read_max;                          // Slowest f_read, in ticks
+	uint32_t errors;                            // f_open, f_lseek and f_read errors
+	uint32_t gapless;                           // Queued tracks joined to the previous one
+	uint32_t isr_cycles;                        // CPU cycles in the DREQ and DMA interrupts, wraps
+} STREAM_STATS;
+
+void VS1003_StreamInit(void);
+int VS1003_StreamOpen(const char *path, uint32_t offset, uint32_t *size);
+int VS1003_StreamQueue(const char *path, uint32_t offset);
+uint32_t VS1003_StreamTell(void);
+uint8_t VS1003_StreamNext(void);
+void VS1003_StreamClose(void);
+void VS1003_StreamPause(uint8_t pause);
+uint8_t VS1003_StreamDone(void);
+void VS1003_StreamGetStats(STREAM_STATS *stats);
+void VS1003_StreamHold(void);
+void VS1003_StreamRelease(void);
+void VS1003_StreamDREQ_IRQ(void);
+
+#endif
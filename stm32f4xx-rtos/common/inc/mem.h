@@ -25,6 +25,9 @@
 
 #include <plat_ostypes.h>
 
+/* Event of __memCpyAsync(), see core/inc/event.h */
+struct __eventTag;
+
 /** @addtogroup Common
   * @{
   */
@@ -34,9 +37,11 @@
   */
 
 
-__VOID	__memSet(__PVOID ptr, u8 fill, u16 qty);
-__VOID	__memCpy(__PVOID dst, __CONST __PVOID src, u16 qty);
-u8 		__memCmp(__CONST __PVOID ptr1, __CONST __PVOID ptr2, u16 qty);
+__VOID	__memSet(__PVOID ptr, u8 fill, u32 qty);
+__VOID	__memCpy(__PVOID dst, __CONST __PVOID src, u32 qty);
+__VOID	__memMove(__PVOID dst, __CONST __PVOID src, u32 qty);
+u8 		__memCmp(__CONST __PVOID ptr1, __CONST __PVOID ptr2, u32 qty);
+__BOOL	__memCpyAsync(__PVOID dst, __CONST __PVOID src, u32 qty, struct __eventTag *ev);
 
 /**
   * @}
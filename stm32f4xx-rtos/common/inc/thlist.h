@@ -26,9 +26,36 @@
 #include <plat_ostypes.h>
 #include <core/inc/thread.h>
 
-void __thlAddPrioList(__PTHREAD th, __PTHREAD* thb);
-void __thlRemovePrioList(__PTHREAD* thb);
+/** @addtogroup Thread_ListFunctions
+  * @{
+  */
+
+#define __THL_PRIO_LEVELS		256								/*!< @brief Thread priority levels (u8) */
+#define __THL_PRIO_WORDS		(__THL_PRIO_LEVELS / 32)		/*!< @brief Bitmap words */
+
+/*!
+ * @brief Ready queue.
+ *
+ * One FIFO per priority level plus a two-level bitmap of the non-empty levels.
+ * Priority @c p is stored in @c map[p >> 5] as bit (31 - (p & 31)), and
+ * @c map[n] being not empty is stored in @c group as bit (31 - n), so the
+ * highest priority (lowest value) is found with two count-leading-zeros.
+ */
+typedef struct __thlReadyQueueTag {
+	u32				group;							/*!< @brief Non-empty map words */
+	u32				map[__THL_PRIO_WORDS];			/*!< @brief Non-empty priority levels */
+	__PTHREAD		head[__THL_PRIO_LEVELS];		/*!< @brief FIFO head for each level */
+} __THL_READYQ, *__PTHL_READYQ;
+
+/**
+  * @}
+  */
+
+void __thlAddReadyQueue(__PTHREAD th, __PTHL_READYQ rq);
+void __thlRemoveReadyQueue(__PTHREAD th, __PTHL_READYQ rq);
+__PTHREAD __thlGetReadyQueueHead(__PTHL_READYQ rq);
 void __thlAddSuspList(__PTHREAD th, __PTHREAD* thl);
+void __thlAddTimeoutList(__PTHREAD th, __PTHREAD* thb, __PTHREAD* thl);
 void __thlRemoveSuspList(__PTHREAD th, __PTHREAD* thb, __PTHREAD* thl);
 void __thlAddEvtPrio(__PTHREAD th, __PTHREAD* the);
 void __thlRemoveEvtPrio(__PTHREAD th, __PTHREAD* the);
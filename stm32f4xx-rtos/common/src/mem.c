@@ -21,46 +21,226 @@
 ***************************************************************************/
 
 #include "mem.h"
+#include <core/inc/event.h>
 
 /** @addtogroup Memory
   * @{
   */
 
+/*
+ * Word access to byte buffers, exempt from the strict aliasing rules.
+ */
+typedef u32 __attribute__ ((__may_alias__)) __MEM_WORD;
+
+/*
+ * Word access with no alignment requirement: the Cortex-M3/M4 LDR and STR
+ * instructions support it (LDM and STM do not).
+ */
+typedef __TYPEDEF_PRE struct {
+	__MEM_WORD		w;
+} __TYPEDEF_POST __attribute__ ((__may_alias__)) __MEM_UWORD;
+
+/* Misalignment of a pointer, in bytes */
+#define __MEM_ALIGN(p)			((u32) (p) & (sizeof(u32) - 1))
+
+/* Bytes moved by a block (four registers of LDM/STM) */
+#define __MEM_BLOCK				(4 * sizeof(u32))
+
+/* Below this size the byte loops are faster than aligning the pointers */
+#define __MEM_WORD_MIN			(2 * sizeof(u32))
+
+#if defined(__PCD_MEM_BLOCKS)
+
+#define __memCopyBlocks(d, s, n)	__pcd_MemCopyBlocks((pu32) (d), (pu32) (s), (n))
+#define __memFillBlocks(d, w, n)	__pcd_MemFillBlocks((pu32) (d), (w), (n))
+
+#else
+
+/*
+ * Copies n blocks between word-aligned pointers.
+ */
+__STATIC __VOID __memCopyBlocks(__PVOID dst, __PVOID src, u32 n)
+{
+	__MEM_WORD* d = dst;
+	__MEM_WORD* s = src;
+	u32 w0, w1, w2, w3;
+
+	while (n-- > 0)
+	{
+		w0 = s[0]; w1 = s[1]; w2 = s[2]; w3 = s[3];
+		d[0] = w0; d[1] = w1; d[2] = w2; d[3] = w3;
+		d += 4;
+		s += 4;
+	}
+}
+
+/*
+ * Fills n blocks at a word-aligned pointer.
+ */
+__STATIC __VOID __memFillBlocks(__PVOID dst, u32 w, u32 n)
+{
+	__MEM_WORD* d = dst;
+
+	while (n-- > 0)
+	{
+		d[0] = w; d[1] = w; d[2] = w; d[3] = w;
+		d += 4;
+	}
+}
+
+#endif /* defined(__PCD_MEM_BLOCKS) */
+
 /*!
  * @brief Fills memory with char.
  *
+ * Bytes are written up to the first word boundary, then whole blocks and
+ * words, then the remaining bytes.
+ *
  * @param ptr	Pointer to memory to be filled.
  * @param fill	Value to fill into.
  * @param qty	Quantity of bytes to fill.
  * @return		Nothing.
- *
+ *
  */
-__VOID 	__memSet(__PVOID ptr, u8 fill, u16 qty)
+__VOID 	__memSet(__PVOID ptr, u8 fill, u32 qty)
 {
 	pu8		p = ptr;
+	u32		w, n;
 
-	if (qty > 0)
+	if (qty >= __MEM_WORD_MIN)
 	{
-		while (qty-- > 0)
+		while (__MEM_ALIGN(p))
+		{
 			*p++ = fill;
+			qty--;
+		}
+
+		w = (u32) fill * 0x01010101;
+		n = qty / __MEM_BLOCK;
+		if (n > 0)
+		{
+			__memFillBlocks(p, w, n);
+			p += n * __MEM_BLOCK;
+			qty -= n * __MEM_BLOCK;
+		}
+
+		while (qty >= sizeof(u32))
+		{
+			*(__MEM_WORD*) p = w;
+			p += sizeof(u32);
+			qty -= sizeof(u32);
+		}
 	}
+
+	while (qty-- > 0)
+		*p++ = fill;
 }
 
 /*!
  * @brief Copies a memory block.
  *
+ * The destination is aligned first; if the source is aligned as well the
+ * copy runs by blocks and words, otherwise by words read unaligned. The
+ * blocks must not overlap, unless \c dst is below \c src (see __memMove()).
+ *
  * @param dst	Pointer to destination.
  * @param src	Pointer to source.
  * @param qty	Quantity of bytes to copy.
  * @return		Nothing.
  *
  */
-__VOID __memCpy(__PVOID dst, __CONST __PVOID src, u16 qty)
+__VOID __memCpy(__PVOID dst, __CONST __PVOID src, u32 qty)
 {
-	__PSTRING	ds = (__PSTRING) dst;
-	__PSTRING	sr = (__PSTRING) src;
+	pu8		d = dst;
+	pu8		s = (pu8) src;
+	u32		n;
+
+	if (qty >= __MEM_WORD_MIN)
+	{
+		while (__MEM_ALIGN(d))
+		{
+			*d++ = *s++;
+			qty--;
+		}
+
+		if (!__MEM_ALIGN(s))
+		{
+			n = qty / __MEM_BLOCK;
+			if (n > 0)
+			{
+				__memCopyBlocks(d, s, n);
+				d += n * __MEM_BLOCK;
+				s += n * __MEM_BLOCK;
+				qty -= n * __MEM_BLOCK;
+			}
+
+			while (qty >= sizeof(u32))
+			{
+				*(__MEM_WORD*) d = *(__MEM_WORD*) s;
+				d += sizeof(u32);
+				s += sizeof(u32);
+				qty -= sizeof(u32);
+			}
+		} else
+		{
+			while (qty >= sizeof(u32))
+			{
+				*(__MEM_WORD*) d = ((__MEM_UWORD*) s)->w;
+				d += sizeof(u32);
+				s += sizeof(u32);
+				qty -= sizeof(u32);
+			}
+		}
+	}
 
-	while (qty-- > 0) *ds++ = *sr++;
+	while (qty-- > 0)
+		*d++ = *s++;
+}
+
+/*!
+ * @brief Copies a memory block that may overlap the destination.
+ *
+ * @param dst	Pointer to destination.
+ * @param src	Pointer to source.
+ * @param qty	Quantity of bytes to copy.
+ * @return		Nothing.
+ *
+ */
+__VOID __memMove(__PVOID dst, __CONST __PVOID src, u32 qty)
+{
+	pu8		d = dst;
+	pu8		s = (pu8) src;
+
+	/* A forward copy reads every word before overwriting it */
+	if (d <= s || d >= s + qty)
+	{
+		__memCpy(dst, src, qty);
+		return;
+	}
+
+	/* Backward from the end */
+	d += qty;
+	s += qty;
+
+	if (qty >= __MEM_WORD_MIN && __MEM_ALIGN(d) == __MEM_ALIGN(s))
+	{
+		while (__MEM_ALIGN(d))
+		{
+			*--d = *--s;
+			qty--;
+		}
+
+		while (qty >= sizeof(u32))
+		{
+			d -= sizeof(u32);
+			s -= sizeof(u32);
+			*(__MEM_WORD*) d = *(__MEM_WORD*) s;
+			qty -= sizeof(u32);
+		}
+	}
+
+	while (qty-- > 0)
+		*--d = *--s;
 }
 
 /*!
@@ -72,17 +252,97 @@ __VOID __memCpy(__PVOID dst, __CONST __PVOID src, u16 qty)
  * @return		Zero if the blocks are equal, otherwise nonzero.
  *
  */
-u8 __memCmp(__CONST __PVOID ptr1, __CONST __PVOID ptr2, u16 qty)
+u8 __memCmp(__CONST __PVOID ptr1, __CONST __PVOID ptr2, u32 qty)
 {
 	pu8		p1 = (pu8) ptr1;
 	pu8		p2 = (pu8) ptr2;
 
+	if (qty >= __MEM_WORD_MIN && __MEM_ALIGN(p1) == __MEM_ALIGN(p2))
+	{
+		while (__MEM_ALIGN(p1))
+		{
+			if (*p1++ != *p2++) return(1);
+			qty--;
+		}
+
+		while (qty >= sizeof(u32))
+		{
+			if (*(__MEM_WORD*) p1 != *(__MEM_WORD*) p2) return(1);
+			p1 += sizeof(u32);
+			p2 += sizeof(u32);
+			qty -= sizeof(u32);
+		}
+	}
+
 	while (qty-- > 0)
 		if (*p1++ != *p2++) return(1);
 
 	return(0);
 }
 
+#if __PLATCONFIG_DMA_MEMCPY
+
+/*
+ * DMA transfer complete, called from its interrupt.
+ */
+__STATIC __VOID __memCpyAsyncDone(__PVOID arg)
+{
+	__eventSet((__PEVENT) arg);
+}
+
+#endif /* __PLATCONFIG_DMA_MEMCPY */
+
+/*!
+ * @brief Copies a memory block in background.
+ *
+ * Blocks of at least __CONFIG_MEM_DMA_THRESHOLD bytes, with \c dst and
+ * \c src aligned alike, are moved by the DMA stream of the platform while
+ * the caller runs; the unaligned head and tail bytes are copied at once.
+ * Otherwise, or if the stream is busy, the copy is done by __memCpy() before
+ * returning. In both cases \c ev is reset and then set once the copy ends:
+ * neither block may be touched before, and \c ev must stay valid.
+ *
+ * @param dst	Pointer to destination.
+ * @param src	Pointer to source.
+ * @param qty	Quantity of bytes to copy.
+ * @param ev	Event set at the end of the copy.
+ * @return		__TRUE if the copy runs in background, __FALSE if it is
+ * 				already done.
+ *
+ */
+__BOOL __memCpyAsync(__PVOID dst, __CONST __PVOID src, u32 qty, __PEVENT ev)
+{
+#if __PLATCONFIG_DMA_MEMCPY
+	pu8		d = dst;
+	pu8		s = (pu8) src;
+	u32		head, tail;
+#endif
+
+	__eventReset(ev);
+
+#if __PLATCONFIG_DMA_MEMCPY
+	if (qty >= __CONFIG_MEM_DMA_THRESHOLD && __MEM_ALIGN(d) == __MEM_ALIGN(s))
+	{
+		/* The DMA moves whole words */
+		head = (sizeof(u32) - __MEM_ALIGN(d)) & (sizeof(u32) - 1);
+		tail = (qty - head) & (sizeof(u32) - 1);
+		__memCpy(d, s, head);
+		__memCpy(d + qty - tail, s + qty - tail, tail);
+
+		if (__cpuDmaMemCpy(d + head, s + head, qty - head - tail, __memCpyAsyncDone, ev))
+			return __TRUE;
+
+		__memCpy(d + head, s + head, qty - head - tail);
+		__eventSet(ev);
+		return __FALSE;
+	}
+#endif /* __PLATCONFIG_DMA_MEMCPY */
+
+	__memCpy(dst, src, qty);
+	__eventSet(ev);
+	return __FALSE;
+}
+
 /**
   * @}
   */
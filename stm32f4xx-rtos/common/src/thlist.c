@@ -32,19 +32,21 @@
   * module in order to manage the thread linked lists.
   *
   * Milos scheduler manages three lists by now:
-  * -	A list representing the threads ready to run, ordered by priority.
-  * 		That is the __threadReady list, defined in thread.c
-  * -	A list of suspended threads, ordered by time of arrival (threads
-  *  		are appended at the end of the list).
+  * -	A ready queue holding the threads ready to run: one FIFO for each
+  * 		priority level and a bitmap of the non-empty levels (see
+  * 		__THL_READYQ). That is the __threadReadyQueue, defined in thread.c
+  * -	A list of suspended threads with a timeout, ordered by the system
+  *  		tick at which the timeout expires (@c th_timeout), so the tick
+  *  		only has to check the head of the list.
   * -	For each event in the system, a list containing the threads that
   *  		are waiting for that particular event, ordered by priority.
   *
-  * The first two methods (__thlAddPrioList()  and __thlRemovePrioList())
-  * are used to keep track of the ready threads ordered by priority.
-  * __thlAddSuspList()  and __thlRemoveSuspList() manages those threads
-  * in suspended (sleeping or waiting) state.
+  * The ready queue methods (__thlAddReadyQueue(), __thlRemoveReadyQueue()
+  * and __thlGetReadyQueueHead()) run in constant time, whatever the number
+  * of ready threads. __thlAddTimeoutList()  and __thlRemoveSuspList() manages
+  * those threads in suspended (sleeping or waiting) state.
   *
-  * Note that the four methods described above use the same linked pointers
+  * Note that the methods described above use the same linked pointers
   * (@c th_qnext and @c thq_prev). That is because a ready thread cannot be
   * in the suspended list and vice-versa.
   *
@@ -56,101 +58,118 @@
 
 
 /*!
- * @brief Adds the thread in a priority ordered list.
+ * @brief Adds the thread at the end of its priority level FIFO.
  *
  * Even this function can be called from outside @ref Core module, it
  * should not.
  *
- * Since we are always removing only the head of the priority ordered
- * list do not use @c th_qprev value when ordering by priority.
+ * Threads with the same priority are kept in order of arrival, so
+ * re-adding a preempted thread gives round-robin between equal priorities.
+ * The head of each level keeps the tail in @c th_qprev, the tail has a
+ * null @c th_qnext. The thread priority must not change while queued.
  *
- * @param	th		Pointer to a thread pointer.
- * @param 	thb		Pointer to the thread at the head of the list.
+ * @param	th		Pointer to a thread.
+ * @param 	rq		Pointer to the ready queue.
  *
  * @return		Nothing.
  *
  */
-void __thlAddPrioList(__PTHREAD th, __PTHREAD* thb)
+void __thlAddReadyQueue(__PTHREAD th, __PTHL_READYQ rq)
 {
-	__PTHREAD tl = __NULL;
-	__PTHREAD p = *thb;
+	u32 prio = th->th_priority & (__THL_PRIO_LEVELS - 1);
+	__PTHREAD head = rq->head[prio];
 
-	/* Set null here, we are doing it anyway ahead in the code
-	 * whenever the exit condition.
-	 */
-	th->th_qnext = th->th_qprev = __NULL;
+	th->th_qnext = __NULL;
 
-	if (p == __NULL)
+	if (head == __NULL)
 	{
-		*thb = th;
+		/* First thread on this level: it is the head and the tail */
+		th->th_qprev = th;
+		rq->head[prio] = th;
+		rq->map[prio >> 5] |= (0x80000000 >> (prio & 31));
+		rq->group |= (0x80000000 >> (prio >> 5));
 		return;
 	}
 
-	/*
-	 * The worst case here is when N threads equals ALL threads - 1,
-	 * and we are adding a thread with the lowest priority
-	 */
-	while (p && p->th_priority <= th->th_priority)
-	{
-		tl = p;
-		p = p->th_qnext;
-	}
+	/* Append after the current tail */
+	th->th_qprev = head->th_qprev;
+	head->th_qprev->th_qnext = th;
+	head->th_qprev = th;
+}
 
-	/* Exit conditions:
-	 * - 	p is null and is equal to *thb, so
-	 * 		th becomes the head of the list (*thb = th).
-	 * 		This condition is already checked at the beginning
-	 * 		of the function.
-	 *
-	 * -	p is null means we reached the end of the list.
-	 *
-	 * -	p is not null and is equal to *thb so
-	 * 		th replaces p as the head of the list (*thb = th).
-	 *
-	 * -	p is not null and is not equal to *thb so th is
-	 * 		inserted somewhere in the list.
-	 */
+/*!
+ * @brief Removes a thread from the ready queue.
+ *
+ * Even this function can be called from outside @ref Core module, it
+ * should not.
+ *
+ * Usually called with the head returned by __thlGetReadyQueueHead(), but
+ * any queued thread can be removed in constant time.
+ *
+ * @param	th		Pointer to a thread in the ready queue.
+ * @param 	rq		Pointer to the ready queue.
+ *
+ * @return		Nothing.
+ *
+ */
+void __thlRemoveReadyQueue(__PTHREAD th, __PTHL_READYQ rq)
+{
+	u32 prio = th->th_priority & (__THL_PRIO_LEVELS - 1);
+	__PTHREAD head = rq->head[prio];
 
-	if (p == __NULL)
+	if (th == head)
 	{
-		tl->th_qnext = th;
+		if (th->th_qnext == __NULL)
+		{
+			/* Level is now empty */
+			rq->head[prio] = __NULL;
+			rq->map[prio >> 5] &= ~(0x80000000 >> (prio & 31));
+			if (rq->map[prio >> 5] == 0)
+			{
+				rq->group &= ~(0x80000000 >> (prio >> 5));
+			}
+		} else
+		{
+			/* The next thread becomes the head, and inherits the tail */
+			th->th_qnext->th_qprev = th->th_qprev;
+			rq->head[prio] = th->th_qnext;
+		}
 	} else
 	{
-		if (p == *thb)
+		th->th_qprev->th_qnext = th->th_qnext;
+		if (th->th_qnext)
 		{
-			th->th_qnext = p;
-			*thb = th;
+			th->th_qnext->th_qprev = th->th_qprev;
 		} else
 		{
-			th->th_qnext = tl->th_qnext;
-			tl->th_qnext = th;
+			/* Removing the tail */
+			head->th_qprev = th->th_qprev;
 		}
 	}
+
+	th->th_qnext = th->th_qprev = __NULL;
 }
 
 /*!
- * @brief Removes the first thread from a priority ordered list.
+ * @brief Returns the first thread of the highest non-empty priority level.
  *
  * Even this function can be called from outside @ref Core module, it
  * should not.
  *
- * It's a priority ordered list, and this function is called when
- * we are about to execute the thread with highest priority (among those
- * that are ready to run). So is enough to remove only the first thread pointer.
+ * @param 	rq		Pointer to the ready queue.
  *
- * @param	thb		Pointer to a thread pointer.
- *
- * @return		Nothing.
+ * @return		The next thread to run, __NULL if the queue is empty.
  *
  */
-void __thlRemovePrioList(__PTHREAD* thb)
+__PTHREAD __thlGetReadyQueueHead(__PTHL_READYQ rq)
 {
-	__PTHREAD th = *thb;
+	u32 word;
 
-	*thb = th->th_qnext;
-	th->th_qnext = th->th_qprev = __NULL;
-}
+	if (rq->group == 0) return __NULL;
 
+	word = __cpuCountLeadingZeros(rq->group);
+	return rq->head[(word << 5) | __cpuCountLeadingZeros(rq->map[word])];
+}
 
 /*!
  * @brief Adds the thread to the end of the suspended threads list.
@@ -175,6 +194,55 @@ void __thlAddSuspList(__PTHREAD th, __PTHREAD* thl)
 	*thl = th;
 }
 
+/*!
+ * @brief Adds the thread to the suspended threads list, ordered by timeout.
+ *
+ * Even this function can be called from outside @ref Core module, it
+ * should not.
+ *
+ * The list is ordered by @c th_timeout, the system tick at which the thread
+ * has to be waked up. Threads with the same timeout are kept in order of
+ * arrival. The list is scanned from the tail since a new timeout is usually
+ * the farthest one. Timeouts are compared by their signed difference, so
+ * the tick counter can overflow.
+ *
+ * @param 	th		Pointer to a thread, with @c th_timeout set.
+ * @param	thb		Pointer to the first thread pointer.
+ * @param	thl		Pointer to the last thread pointer.
+ *
+ * @return		Nothing.
+ *
+ */
+void __thlAddTimeoutList(__PTHREAD th, __PTHREAD* thb, __PTHREAD* thl)
+{
+	__PTHREAD p = *thl;
+
+	while (p && (i32) (th->th_timeout - p->th_timeout) < 0)
+	{
+		p = p->th_qprev;
+	}
+
+	/* Insert after p, or as the head of the list if p is null */
+	th->th_qprev = p;
+	if (p)
+	{
+		th->th_qnext = p->th_qnext;
+		p->th_qnext = th;
+	} else
+	{
+		th->th_qnext = *thb;
+		*thb = th;
+	}
+
+	if (th->th_qnext)
+	{
+		th->th_qnext->th_qprev = th;
+	} else
+	{
+		*thl = th;
+	}
+}
+
 /*!
  * @brief Removes the thread from the suspended threads list.
  *
@@ -240,8 +240,45 @@ typedef struct __deviceTag {
 	__DEV_FLUSH			*dv_flush;					/*!< @brief Flush device function */
 	__DEV_SIZE			*dv_size;					/*!< @brief Get size function */
 	__DEV_PLAT_IOCTL	*dv_plat_ioctl;				/*!< @brief Platform-related IO control */
+
+	/* Set by __deviceAdd() */
+	u32					dv_hash;					/*!< @brief Name hash */
+	struct __deviceTag*	dv_hnext;					/*!< @brief Next device in the hash bucket */
 } __DEVICE, *__PDEVICE;
 
+/**
+ * @brief Handle of an opened device, see __deviceOpenHandle().
+ *
+ * Caches the driver functions resolved at open time: __deviceHRead() and
+ * __deviceHWrite() call them directly, without the checks of __deviceRead()
+ * and __deviceWrite().
+ */
+typedef struct {
+	__PDEVICE			dh_dev;						/*!< @brief Device */
+	__DEV_READ			*dh_read;					/*!< @brief Read function */
+	__DEV_WRITE			*dh_write;					/*!< @brief Write function, flushing with __DEV_AUTOFLUSH */
+} __DEVHANDLE, *__PDEVHANDLE;
+
+/**
+ * @brief Buffer of __deviceReadV() and __deviceWriteV().
+ */
+typedef struct {
+	__PVOID				iov_base;					/*!< @brief Data */
+	u16					iov_len;					/*!< @brief Bytes */
+} __DEVIOVEC, *__PDEVIOVEC;
+
+/**
+ * @brief Buffered line reader, see __deviceLineInit().
+ */
+typedef struct {
+	__PDEVHANDLE		lr_handle;					/*!< @brief Handle to read from */
+	u8*					lr_buf;						/*!< @brief Bytes read ahead */
+	u16					lr_size;					/*!< @brief Size of \c lr_buf */
+	u16					lr_start;					/*!< @brief First byte not returned yet */
+	u16					lr_end;						/*!< @brief End of the bytes read */
+	u8					lr_cr;						/*!< @brief Last line ended by CR, skip a LF */
+} __DEVLINE, *__PDEVLINE;
+
 /**
   * @}
   */
@@ -261,6 +298,14 @@ i32 __deviceWrite(__PDEVICE dv, __CONST __PVOID buf, u16 qty);
 i32 __deviceFlush(__PDEVICE dv);
 i32 __deviceSize(__PDEVICE dv, u8 mode);
 
+i32 __deviceReadV(__PDEVICE dv, __PDEVIOVEC iov, u8 count);
+i32 __deviceWriteV(__PDEVICE dv, __CONST __PDEVIOVEC iov, u8 count);
+
+i32 __deviceOpenHandle(__PDEVHANDLE dh, __PDEVICE dv, u32 param);
+i32 __deviceCloseHandle(__PDEVHANDLE dh);
+__VOID __deviceLineInit(__PDEVLINE lr, __PDEVHANDLE dh, __PVOID buf, u16 size);
+i32 __deviceLineRead(__PDEVLINE lr, __PSTRING buf, u16 qty);
+
 __VOID __deviceAdd(__PDEVICE dv, u8 count);
 __VOID __deviceRemove(__PDEVICE dv);
 __VOID __deviceDbgTermOutput(__VOID);
@@ -268,6 +313,12 @@ __VOID __deviceDbgTermOutput(__VOID);
 #define __deviceInitialized(dv)	(dv->dv_initd)
 #define __deviceOpened(dv)		(dv->dv_opcnt)
 
+/*! @brief Reads from a handle opened with __deviceOpenHandle(), see __deviceRead() */
+#define __deviceHRead(dh, buf, qty)		((*(dh)->dh_read)((dh)->dh_dev, (buf), (qty)))
+
+/*! @brief Writes to a handle opened with __deviceOpenHandle(), see __deviceWrite() */
+#define __deviceHWrite(dh, buf, qty)	((*(dh)->dh_write)((dh)->dh_dev, (buf), (qty)))
+
 /**
   * @}
   */
@@ -63,6 +63,44 @@
 #define	__EV_TIMEOUT		0xFC	/*!< @brief Event timeout */
 #define	__EV_ABORT			0xFB	/*!< @brief Event aborted */
 
+/**
+  * @}
+  */
+
+/** @defgroup Event_GroupModes Event group wait modes
+  * @brief Bitwise values for the \c mode parameter of __evGroupWait().
+  * @{
+  */
+
+#define __EVGROUP_ANY		0x00	/*!< @brief Wait for any of the flags */
+#define __EVGROUP_ALL		0x01	/*!< @brief Wait for all the flags */
+#define __EVGROUP_CLEAR		0x02	/*!< @brief Clear the flags waited for on success */
+
+/**
+  * @}
+  */
+
+/** @defgroup Event_WaitTypes Wait object types
+  * @brief Values for \c wo_type of __WAIT_OBJ.
+  * @{
+  */
+
+#define __WAIT_EVENT		0x00	/*!< @brief __PEVENT, ready when not in __EV_RESET state */
+#define __WAIT_EVGROUP		0x01	/*!< @brief __PEVGROUP, ready when any of \c wo_flags is set */
+#define __WAIT_QUEUE		0x02	/*!< @brief __PQUEUE, ready when it has items */
+
+/**
+  * @}
+  */
+
+/** @defgroup Event_WaitReturnValues __waitMultiple() return values
+  * @brief Negative values returned by __waitMultiple(), otherwise it returns an index.
+  * @{
+  */
+
+#define __WAIT_TIMEOUT		-1		/*!< @brief No object ready before the timeout */
+#define __WAIT_ERROR		-2		/*!< @brief Invalid parameters */
+
 /**
   * @}
   */
@@ -75,12 +113,45 @@
   * @{
   */
 
+typedef struct __eventLinkTag __EVENT_LINK, *__PEVENT_LINK;
+
 typedef struct __eventTag {
 
 	u8				ev_state;		/*!< @brief Event state */
 	__PTHREAD		ev_threads;		/*!< @brief list of waiting threads */
+	__PEVENT_LINK	ev_links;		/*!< @brief Events to set when this one is signaled */
 } __EVENT, *__PEVENT;
 
+/*!
+ * @brief Forwards the signals of an event to another one. Used by __waitMultiple().
+ */
+struct __eventLinkTag {
+	__PEVENT		el_target;		/*!< @brief Event to set */
+	__PEVENT_LINK	el_next;		/*!< @brief Next link of the same event */
+};
+
+/*!
+ * @brief Event group: 32 flags sharing one event.
+ *
+ * Flags are set and cleared independently. Threads wait for any or all of a
+ * set of flags with __evGroupWait().
+ */
+typedef struct __evGroupTag {
+	__VOLATILE u32	eg_flags;		/*!< @brief Flags */
+	__EVENT			eg_event;		/*!< @brief Set on each __evGroupSet() */
+} __EVGROUP, *__PEVGROUP;
+
+/*!
+ * @brief Object waited for by __waitMultiple().
+ */
+typedef struct __waitObjTag {
+	u8				wo_type;		/*!< @brief Object type (@ref Event_WaitTypes) */
+	__PVOID			wo_obj;			/*!< @brief Pointer to the object */
+	u32				wo_flags;		/*!< @brief Flags to wait for (__WAIT_EVGROUP only) */
+	u8				wo_ready;		/*!< @brief Output: __TRUE if the object was ready on return */
+	__EVENT_LINK	wo_link;		/*!< @brief Internal use */
+} __WAIT_OBJ, *__PWAIT_OBJ;
+
 /**
   * @}
   */
@@ -92,6 +163,26 @@ __VOID __eventSetOne(__PEVENT ev);
 __VOID __eventAbort(__PEVENT ev);
 __PTHREAD __eventGetWaitingThreads(__PEVENT ev);
 
+__VOID __evGroupInit(__PEVGROUP eg);
+__VOID __evGroupSet(__PEVGROUP eg, u32 flags);
+__VOID __evGroupClear(__PEVGROUP eg, u32 flags);
+u32 __evGroupWait(__PEVGROUP eg, u32 flags, u8 mode, u32 timeout);
+
+i32 __waitMultiple(__PWAIT_OBJ objs, u8 qty, u32 timeout);
+
+/** @defgroup Event_PublicMacros Public macros
+  * @{
+  */
+
+/*!
+ * @brief Returns the flags of an event group.
+ */
+#define __evGroupGet(x)		((x)->eg_flags)
+
+/**
+  * @}
+  */
+
 /**
   * @}
   */
@@ -41,8 +41,8 @@ typedef	__BOOL (__HEAPCALLBACK)(__PVOID, u32, __BOOL, __PTHREAD, __PVOID arg);
   */
 
 
-__PVOID		__heapAlloc(u16 size);
-__PVOID		__heapAllocZero(u16 size);
+__PVOID		__heapAlloc(u32 size);
+__PVOID		__heapAllocZero(u32 size);
 __VOID		__heapFree(__PVOID ptr);
 u32			__heapAvailable(__VOID);
 __VOID		__heapInit(__PVOID mem, u32 size);
@@ -57,6 +57,12 @@
   * @}
   */
 
+/*! @brief Flag in the \c owner word: threads are waiting for the lock. */
+#define __LOCK_WAITERS			1
+
+/*! @brief Maximum depth followed to propagate priority inheritance. */
+#define __LOCK_MAX_NESTING		8
+
 /**
   * @}
   */
@@ -75,12 +81,17 @@ struct __threadTag;
 
 struct __lockTag {
 
-	__VOLATILE u8					state;
-	u8								type;
-	__PTHREAD						owner;
-	__PTHREAD						parent;
-	__EVENT							event;
-	__VOLATILE __PLOCK				next;
+	__VOLATILE u8					state;		/*!< @brief Lock state, informational */
+	u8								type;		/*!< @brief Lock type */
+	__VOLATILE __PTHREAD			owner;		/*!< @brief Owner thread, with the __LOCK_WAITERS flag */
+	__PTHREAD						parent;		/*!< @brief Creator thread */
+	__EVENT							event;		/*!< @brief Event for waiting threads */
+	__VOLATILE __PLOCK				next;		/*!< @brief Next lock with waiters of the same owner */
+	u32								taken;		/*!< @brief System tick of the last acquisition */
+	u32								owns;		/*!< @brief Acquisitions count */
+	u32								contended;	/*!< @brief Acquisitions that found the lock owned */
+	u32								hold_max;	/*!< @brief Longest hold time in ticks */
+	u32								hold_total;	/*!< @brief Total hold time in ticks */
 };
 
 typedef struct __lockListTag  __LOCK_LIST, *__PLOCK_LIST;	/*!< @brief Lock list structure. */
@@ -101,6 +112,11 @@ __VOID	__lockDestroy(__PLOCK lock);
 u32		__lockGetCount(__VOID);
 __PLOCK_LIST __lockGetList(__VOID);
 
+/*!
+ * @brief Returns the thread owning the lock, __NULL if released.
+ */
+#define __lockGetOwner(x)		((__PTHREAD) ((u32) (x)->owner & ~__LOCK_WAITERS))
+
 /**
   * @}
   */
@@ -0,0 +1,172 @@
+/***************************************************************************
+ * log.h
+ * (C) 2010 Ivan Meleca
+ * Based on original code written by Ruben Meleca
+ * www.milos.it
+
+#   This program is free software; you can redistribute it and/or modify
+#   it under the terms of the GNU General Public License as published by
+#   the Free Software Foundation; either version 2 of the License, or
+#   (at your option) any later version.
+#
+#   This program is distributed in the hope that it will be useful,
+#   but WITHOUT ANY WARRANTY; without even the implied warranty of
+#   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#   GNU General Public License for more details.
+#
+#   You should have received a copy of the GNU General Public License
+#   along with this program; if not, write to the Free Software
+#   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+***************************************************************************/
+#ifndef __LOG_H__
+#define __LOG_H__
+
+#include <plat_cpu.h>
+#include "thread.h"
+
+#if __CONFIG_LOG
+
+/** @addtogroup Log
+  * @{
+  */
+
+/** @defgroup Log_Constants Constants
+  * @{
+  */
+
+#define __LOG_MAGIC				0x31474F4C	/*!< @brief Snapshot header magic, "LOG1" */
+#define __LOG_MAX_ARGS			8			/*!< @brief Arguments of a record */
+
+/** @defgroup Log_Levels Levels
+  * @{
+  */
+
+#define __LOG_OFF				0			/*!< @brief Module level that disables every record */
+#define __LOG_ERROR				1			/*!< @brief Error */
+#define __LOG_WARN				2			/*!< @brief Warning */
+#define __LOG_INFO				3			/*!< @brief Information */
+#define __LOG_DEBUG				4			/*!< @brief Debug */
+
+/**
+  * @}
+  */
+
+/** @defgroup Log_Modules Modules
+  *
+  * Modules of the system. Applications use the numbers from __LOG_MOD_APP up to
+  * __CONFIG_LOG_MODULES - 1.
+  * @{
+  */
+
+#define __LOG_MOD_CORE			0			/*!< @brief Kernel */
+#define __LOG_MOD_DRIVERS		1			/*!< @brief Device drivers */
+#define __LOG_MOD_APP			2			/*!< @brief First module of the application */
+
+/**
+  * @}
+  */
+
+/** @defgroup Log_Record Record header
+  *
+  * A record is its header word, a timestamp word and the argument words. The
+  * header is written last: zero means the record is not complete yet.
+  * @{
+  */
+
+#define __LOG_HDR_ID(h)			((h) >> 16)			/*!< @brief Format string offset in the format strings section */
+#define __LOG_HDR_MODULE(h)		(((h) >> 8) & 0xFF)	/*!< @brief Module */
+#define __LOG_HDR_LEVEL(h)		(((h) >> 5) & 0x07)	/*!< @brief Level */
+#define __LOG_HDR_VALID			0x10				/*!< @brief Always set */
+#define __LOG_HDR_ARGS(h)		((h) & 0x0F)		/*!< @brief Argument words */
+#define __LOG_HDR_WORDS(h)		(__LOG_HDR_ARGS(h) + 2)	/*!< @brief Record words */
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+/** @defgroup Log_Typedefs Typedefs
+  * @{
+  */
+
+/*!
+ * @brief Snapshot header, followed by \c lh_modules drop counters, \c lh_fmtlen
+ * bytes of format strings and \c lh_words record words. All the values are
+ * little-endian.
+ */
+typedef struct __logHeaderTag {
+	u32			lh_magic;		/*!< @brief __LOG_MAGIC */
+	u32			lh_hz;			/*!< @brief Timestamp counts per second */
+	u32			lh_modules;		/*!< @brief Drop counters */
+	u32			lh_fmtlen;		/*!< @brief Format strings bytes, multiple of 4 */
+	u32			lh_words;		/*!< @brief Record words */
+	u32			lh_drops;		/*!< @brief Records dropped, every module */
+} __LOG_HEADER, *__PLOG_HEADER;
+
+/**
+  * @}
+  */
+
+extern u8 __logLevels[];
+extern __CONST char __start_milos_log[];
+extern __CONST char __stop_milos_log[];
+
+__VOID	__logInit(__VOID);
+__VOID	__logStart(__VOID);
+__VOID	__logWrite(u32 hdr, __CONST char* fmt, __CONST u32* args, u32 nargs);
+u32		__logRead(pu32 buf, u32 len);
+__VOID	__logSetLevel(u32 module, u32 level);
+u32		__logGetDrops(u32 module);
+u32		__logGetUsed(__VOID);
+u32		__logSnapshot(__PVOID buf, u32 len);
+
+/*!
+ * @brief Logs a record for \c mod at level \c lvl, if the level of the module allows it.
+ *
+ * \c fmt is a string literal, stored with the other format strings in the
+ * "milos_log" section: the record keeps its offset there, plus up to
+ * __LOG_MAX_ARGS arguments as 32 bit words (cast pointers to u32). The text is
+ * formatted later, by the log thread or by the host tool reading a snapshot,
+ * so %s arguments must point to constant strings.
+ *
+ * The format string is a \c static variable: __STATIC is empty in __DEBUG builds.
+ */
+#define __LOG(mod, lvl, fmt, ...)													\
+	do {																			\
+		if ((lvl) <= __logLevels[(mod)])											\
+		{																			\
+			static __CONST char __logFmt[] __attribute__ ((section("milos_log"))) = fmt;	\
+			__logWrite(((mod) << 8) | ((lvl) << 5) | __LOG_HDR_VALID, __logFmt,		\
+					(__CONST u32[]) { 0, ##__VA_ARGS__ } + 1,						\
+					sizeof((u32[]) { 0, ##__VA_ARGS__ }) / sizeof(u32) - 1);		\
+		}																			\
+	} while (0)
+
+/*! @brief Error record */
+#define LOGE(mod, fmt, ...)		__LOG(mod, __LOG_ERROR, fmt, ##__VA_ARGS__)
+/*! @brief Warning record */
+#define LOGW(mod, fmt, ...)		__LOG(mod, __LOG_WARN, fmt, ##__VA_ARGS__)
+/*! @brief Information record */
+#define LOGI(mod, fmt, ...)		__LOG(mod, __LOG_INFO, fmt, ##__VA_ARGS__)
+/*! @brief Debug record */
+#define LOGD(mod, fmt, ...)		__LOG(mod, __LOG_DEBUG, fmt, ##__VA_ARGS__)
+
+/**
+  * @}
+  */
+
+#else
+
+#define __LOG(mod, lvl, fmt, ...)
+#define LOGE(mod, fmt, ...)
+#define LOGW(mod, fmt, ...)
+#define LOGI(mod, fmt, ...)
+#define LOGD(mod, fmt, ...)
+
+#endif /* __CONFIG_LOG */
+
+#endif /* __LOG_H__ */
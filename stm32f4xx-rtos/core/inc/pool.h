@@ -0,0 +1,108 @@
+/***************************************************************************
+ * pool.h
+ * (C) 2010 Ivan Meleca
+ * Based on original code written by Ruben Meleca
+ * www.milos.it
+
+#   This program is free software; you can redistribute it and/or modify
+#   it under the terms of the GNU General Public License as published by
+#   the Free Software Foundation; either version 2 of the License, or
+#   (at your option) any later version.
+#
+#   This program is distributed in the hope that it will be useful,
+#   but WITHOUT ANY WARRANTY; without even the implied warranty of
+#   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#   GNU General Public License for more details.
+#
+#   You should have received a copy of the GNU General Public License
+#   along with this program; if not, write to the Free Software
+#   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+***************************************************************************/
+#ifndef __POOL_H__
+#define __POOL_H__
+
+#include <plat_ostypes.h>
+#include "thread.h"
+#include "event.h"
+
+#if __CONFIG_COMPILE_POOL
+
+/** @addtogroup Pool Pool
+  * @{
+  */
+
+/** @defgroup Pool_Constants Constants
+  * @{
+  */
+
+/*!
+ * @brief Values for pool type.
+ */
+#define __POOL_STATIC			0		/*!< @brief Blocks stored in a user provided area */
+#define __POOL_ALLOC			1		/*!< @brief Blocks allocated with __heapAlloc() */
+
+/**
+  * @}
+  */
+
+/** @defgroup Pool_Typedefs Typedefs
+  * @{
+  */
+
+typedef struct __poolTag __POOL, *__PPOOL;
+
+/*!
+ * @brief Main pool structure.
+ */
+struct __poolTag {
+	__VOLATILE __PVOID free;	/*!< @brief First free block */
+	__PVOID ref;				/*!< @brief Base address */
+	u32 block_size;				/*!< @brief Size of each block, word aligned */
+	u32 block_qty;				/*!< @brief Quantity of blocks */
+	__VOLATILE u32 avail;		/*!< @brief Free blocks */
+	__VOLATILE u32 min_avail;	/*!< @brief Lowest value reached by \c avail */
+	__VOLATILE u32 allocs;		/*!< @brief Successful allocations */
+	__VOLATILE u32 fails;		/*!< @brief Allocations that found the pool empty */
+	__VOLATILE u32 waiting;		/*!< @brief Threads waiting for a free block */
+	__EVENT event;				/*!< @brief Event for waiting for a free block */
+	u8 type;					/*!< @brief Pool type */
+	__PPOOL next;				/*!< @brief Next pool in the system list */
+};
+
+/**
+  * @}
+  */
+
+__BOOL	__poolCreate(u8 type, __PPOOL pool, u32 block_size, u32 block_qty, __PVOID ptr, u32 ptr_size);
+__VOID	__poolDestroy(__PPOOL pool);
+__PVOID	__poolAlloc(__PPOOL pool);
+__PVOID	__poolAllocWait(__PPOOL pool, u32 timeout);
+__BOOL	__poolFree(__PPOOL pool, __PVOID ptr);
+__PPOOL	__poolGetList(__VOID);
+
+/** @defgroup Pool_PublicMacros Public macros
+  * @{
+  */
+
+/*!
+ * @brief Size of the area needed by a static pool of \c qty blocks of \c size bytes.
+ */
+#define __POOL_AREA_SIZE(size, qty)	((((size) + sizeof(__PVOID) - 1) & ~(sizeof(__PVOID) - 1)) * (qty))
+
+/*!
+ * @brief Return the quantity of free blocks in the pool.
+ */
+#define __poolGetAvailable(x)		(x->avail)
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+#endif /* __CONFIG_COMPILE_POOL */
+
+#endif /* __POOL_H__ */
@@ -0,0 +1,134 @@
+/***************************************************************************
+ * profile.h
+ * (C) 2010 Ivan Meleca
+ * Based on original code written by Ruben Meleca
+ * www.milos.it
+
+#   This program is free software; you can redistribute it and/or modify
+#   it under the terms of the GNU General Public License as published by
+#   the Free Software Foundation; either version 2 of the License, or
+#   (at your option) any later version.
+#
+#   This program is distributed in the hope that it will be useful,
+#   but WITHOUT ANY WARRANTY; without even the implied warranty of
+#   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#   GNU General Public License for more details.
+#
+#   You should have received a copy of the GNU General Public License
+#   along with this program; if not, write to the Free Software
+#   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+***************************************************************************/
+#ifndef __PROFILE_H__
+#define __PROFILE_H__
+
+#include <plat_cpu.h>
+#include "thread.h"
+
+#if __CONFIG_PROFILER
+
+/** @addtogroup Profiler
+  * @{
+  */
+
+/** @defgroup Profiler_Constants Constants
+  * @{
+  */
+
+#define __PROF_MAGIC			0x31465250	/*!< @brief Snapshot header magic, "PRF1" */
+
+/**
+  * @}
+  */
+
+/** @defgroup Profiler_Typedefs Typedefs
+  * @{
+  */
+
+/*!
+ * @brief Snapshot header, followed by \c ph_threads __PROF_THREAD and \c ph_sites
+ * __PROF_SITE records. All the values are little-endian.
+ */
+typedef struct __profHeaderTag {
+	u32			ph_magic;		/*!< @brief __PROF_MAGIC */
+	u32			ph_hz;			/*!< @brief Cycles per second */
+	u32			ph_threads;		/*!< @brief Thread records */
+	u32			ph_sites;		/*!< @brief Critical section records */
+	u32			ph_switches;	/*!< @brief Context switches */
+	u32			ph_isrcount;	/*!< @brief Interrupts served */
+	u32			ph_isrmax;		/*!< @brief Longest interrupt, in cycles */
+	u32			ph_reserved;	/*!< @brief Zero */
+	u64			ph_idle;		/*!< @brief Cycles with no thread running */
+	u64			ph_isr;			/*!< @brief Cycles in interrupts */
+} __PROF_HEADER, *__PPROF_HEADER;
+
+/*!
+ * @brief Snapshot record of a thread.
+ */
+typedef struct __profThreadTag {
+	__STRING	pt_name[8];		/*!< @brief Name, not terminated if 8 characters long */
+	u64			pt_cycles;		/*!< @brief Cycles running, interrupts excluded */
+	u32			pt_switches;	/*!< @brief Times switched in */
+	u32			pt_preempts;	/*!< @brief Times switched out while still ready */
+	u32			pt_priority;	/*!< @brief Priority */
+	u32			pt_reserved;	/*!< @brief Zero */
+} __PROF_THREAD, *__PPROF_THREAD;
+
+/*!
+ * @brief Critical section call site (snapshot record too).
+ */
+typedef struct __profSiteTag {
+	u32			ps_site;		/*!< @brief Return address of the outermost __systemStop() */
+	u32			ps_max;			/*!< @brief Longest section, in cycles */
+	u32			ps_count;		/*!< @brief Sections opened here */
+} __PROF_SITE, *__PPROF_SITE;
+
+/**
+  * @}
+  */
+
+__VOID	__profInit(__VOID);
+__VOID	__profReset(__VOID);
+__VOID	__profSwitch(__PTHREAD next);
+__VOID	__profTick(__VOID);
+__VOID	__profCsEnter(u32 site);
+__VOID	__profCsLeave(__VOID);
+__VOID	__profCsRestart(__VOID);
+__VOID	__profIsrEnter(__VOID);
+__VOID	__profIsrLeave(__VOID);
+u32		__profSnapshot(__PVOID buf, u32 len);
+__PPROF_SITE __profGetSites(__VOID);
+__PPROF_HEADER __profGetTotals(__PPROF_HEADER hdr);
+
+/**
+  * @}
+  */
+
+/*! @brief Profiler hook in __systemStop(), outermost section only */
+#define __PROF_CS_ENTER()		__profCsEnter((u32) __builtin_return_address(0))
+/*! @brief Profiler hook in __systemStart(), outermost section only */
+#define __PROF_CS_LEAVE()		__profCsLeave()
+/*! @brief Restarts the running section measure (after sleeping with interrupts disabled) */
+#define __PROF_CS_RESTART()		__profCsRestart()
+/*! @brief Profiler hook in __systemEnterISR(), outermost interrupt only */
+#define __PROF_ISR_ENTER()		__profIsrEnter()
+/*! @brief Profiler hook in __systemLeaveISR(), outermost interrupt only */
+#define __PROF_ISR_LEAVE()		__profIsrLeave()
+/*! @brief Profiler hook in __threadChange() */
+#define __PROF_SWITCH(th)		__profSwitch(th)
+/*! @brief Profiler hook in the system tick */
+#define __PROF_TICK()			__profTick()
+
+#else
+
+#define __PROF_CS_ENTER()
+#define __PROF_CS_LEAVE()
+#define __PROF_CS_RESTART()
+#define __PROF_ISR_ENTER()
+#define __PROF_ISR_LEAVE()
+#define __PROF_SWITCH(th)
+#define __PROF_TICK()
+
+#endif /* __CONFIG_PROFILER */
+
+#endif /* __PROFILE_H__ */
@@ -25,6 +25,7 @@
 #include <plat_ostypes.h>
 #include "thread.h"
 #include "event.h"
+#include "pool.h"
 
 #if __CONFIG_COMPILE_QUEUE
 
@@ -40,10 +41,12 @@
  * @brief Bitwise values for queue type.
  * Bit 0: 	If 1 data is allocated dynamically. Otherwise a pointer must be provided
  * Bit 1: 	If 1 item data in queue has a fixed size, otherwise has a dynamic size.
+ * Bit 2:	If 1 the queue is a lock-free ring for one producer and one consumer.
  */
 #define __QUEUE_STATIC			0
 #define __QUEUE_ALLOC			1
 #define __QUEUE_FIXED_SIZE		2
+#define __QUEUE_SPSC			4
 
 /**
   * @}
@@ -68,6 +71,11 @@ typedef struct queueTag {
 	__PVOID data_w;				/*<! @brief Pointer to first-to-write */
 	__PVOID data_r;				/*<! @brief Pointer to first-to-read */
 	__PVOID ref;				/*<! @brief Base address */
+	__VOLATILE u32 wr;			/*<! @brief Items committed (__QUEUE_SPSC), written by the producer only */
+	__VOLATILE u32 rd;			/*<! @brief Items released (__QUEUE_SPSC), written by the consumer only */
+#if __CONFIG_COMPILE_POOL
+	__PPOOL pool;				/*<! @brief Pool for items, if not allocated from heap */
+#endif
 } __QUEUE, *__PQUEUE;
 
 /**
@@ -77,22 +85,37 @@ typedef struct queueTag {
 __BOOL __queueCreate(u8 type, __PQUEUE queue, u32 item_qty, u32 item_size, u8* ptr, u32 ptr_size);
 __BOOL __queueAdd(__PQUEUE queue, __PVOID data, u32 size);
 __BOOL __queueGet(__PQUEUE queue, __PVOID data, u32* len);
-/*! @brief To be implemented */
 __BOOL __queuePeekFirst(__PQUEUE queue, __PVOID data, u32 size);
-/*! @brief To be implemented */
 __BOOL __queuePeekLast(__PQUEUE queue, __PVOID data, u32 size);
+__PVOID __queueReserve(__PQUEUE queue);
+__BOOL __queueCommit(__PQUEUE queue, u32 size);
+__PVOID __queuePeek(__PQUEUE queue, u32* len);
+__BOOL __queueRelease(__PQUEUE queue);
 __BOOL __queueWaitForData(__PQUEUE queue, u32 timeout);
 __BOOL __queueWaitForEmpty(__PQUEUE queue, u32 timeout);
 __BOOL __queueIsReady(__PQUEUE queue);
+#if __CONFIG_COMPILE_POOL
+__BOOL __queueSetPool(__PQUEUE queue, __PPOOL pool);
+#endif
 
 /** @defgroup Queue_PublicMacros Public macros
   * @{
   */
 
 /*!
- * @brief Return the quantity of items in the queue.
+ * @brief Return the quantity of items in the queue.
  */
-#define __queueGetItemCount(x)		(x->item_count)
+#define __queueGetItemCount(x)		((x->type & __QUEUE_SPSC) ? x->wr - x->rd : x->item_count)
+
+/*!
+ * @brief Size of each item slot in a __QUEUE_SPSC queue (length word and data).
+ */
+#define __QUEUE_SPSC_SLOT(size)		(sizeof(u32) + (((size) + 3) & ~3))
+
+/*!
+ * @brief Size of the memory area for a static __QUEUE_SPSC queue.
+ */
+#define __QUEUE_SPSC_AREA_SIZE(size, qty)	(__QUEUE_SPSC_SLOT(size) * (qty))
 
 /**
   * @}
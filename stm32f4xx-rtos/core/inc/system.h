@@ -51,7 +51,9 @@ __VOID __systemScheduleThreadChange(__VOID);
 __BOOL __systemSchedulerDisabled(__VOID);
 __VOID __systemEnterISR(__VOID);
 __VOID __systemLeaveISR(__VOID);
+__VOID __systemIdle(__VOID);
 u32 __systemGetTickCount(__VOID);
+u32 __systemGetIdleTicks(__VOID);
 u32 __systemGetSecondsCount(__VOID);
 u32 __systemGetIrqCount(__VOID);
 
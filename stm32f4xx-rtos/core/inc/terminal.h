@@ -49,6 +49,8 @@ struct __terminalTag;
  * @param params	Pointer to a null-terminated string indicating the received parameters for
  * 					the \c cmd command.
  *
+ * The line is also split at the spaces in the \c argc and \c argv members of \c term.
+ *
  * @return Nothing.
  *
  */
@@ -67,6 +69,8 @@ typedef __VOID (__TERMINALRXCMD)(struct __terminalTag* term, __PSTRING cmd, __PS
   */
 
 #define __TERMINAL_DEF_LINELEN		64
+#define __TERMINAL_DEF_COMMANDS		16		/*!< @brief First size of the command table */
+#define __TERMINAL_MAXARGS			8		/*!< @brief Most arguments in \c argv, the last one takes the rest of the line */
 
 /**
   * @}
@@ -114,6 +118,12 @@ typedef struct __terminalTag
 	__PLOCK lock;							/*!< @brief Write lock. */
 	u8 flags;								/*!< @brief Flags. */
 	__PTERMINALCMD cmds;					/*!< @brief Registered commands for this terminal. */
+	__PTERMINALCMD* cmdtab;					/*!< @brief Registered commands sorted by name. */
+	u16 cmdcnt;								/*!< @brief Commands in \c cmdtab. */
+	u16 cmdmax;								/*!< @brief Size of \c cmdtab. */
+	__PSTRING arg_line;						/*!< @brief Copy of the RX line split into \c argv. */
+	u8 argc;								/*!< @brief Arguments of the running command, the command included. */
+	__PSTRING argv[__TERMINAL_MAXARGS];		/*!< @brief Arguments of the running command, argv[0] is the command. */
 } __TERMINAL, *__PTERMINAL;
 
 /**
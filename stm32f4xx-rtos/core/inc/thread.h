@@ -38,10 +38,12 @@
   */
 
 #define	__TH_MAXNAMELEN			8			/*!< @brief Max thread name length */
-#define	__TH_MINSTACKSIZE		64			/*!< @brief Minimum stack size */
+#define	__TH_MINSTACKSIZE		256			/*!< @brief Minimum stack size (a thread switched out with FPU context uses 204 bytes) */
 #define	__TH_MINTICKS			1			/*!< @brief Minimum ticks */
 #define	__TH_DEFSLEEPTICKS		1			/*!< @brief Default sleep ticks */
 #define	__TH_DEFWAITTICKS		1			/*!< @brief Default wait ticks */
+#define	__TH_STACKPAINT			0xA5		/*!< @brief Byte filling the unused stack (__CONFIG_STACK_CHECK) */
+#define	__TH_STACKGUARD			32			/*!< @brief Guard region under the stack (__CONFIG_STACK_GUARD), power of two */
 
 /**
   * @}
@@ -79,9 +81,11 @@ typedef struct __threadTag {
 
 	__VOLATILE u8		th_status;						/*!< @brief Thread status */
 	u32					th_priority;					/*!< @brief Thread priority (0-255) */
+	u32					th_basepriority;				/*!< @brief Priority without lock inheritance */
 	u32					th_ttl;							/*!< @brief Time to live */
 	u32					th_load;						/*!< @brief Time to live reload value */
 	__VOLATILE u32 		th_wait;						/*!< @brief Time to wait/sleep */
+	u32					th_timeout;						/*!< @brief System tick when th_wait expires */
 	u16					th_stksize;						/*!< @brief Stack size in bytes */
 	__VOLATILE u32		th_sp;							/*!< @brief Stack pointer save area */
 	pu8					th_stkptr;						/*!< @brief Stack pointer memory block*/
@@ -91,6 +95,17 @@ typedef struct __threadTag {
 	struct __threadTag* th_evprev;
 	struct __threadTag* th_evnext;
 	struct __threadTag*	th_lstnext;						/*!< @brief Next thread in creation list*/
+	struct __lockTag*	th_locks;						/*!< @brief Owned locks with waiting threads */
+	struct __lockTag*	th_lockwait;					/*!< @brief Lock the thread is waiting for */
+#if __CONFIG_PROFILER
+	u64					th_cycles;						/*!< @brief Cycles running (@ref Profiler) */
+	u32					th_switches;					/*!< @brief Times switched in (@ref Profiler) */
+	u32					th_preempts;					/*!< @brief Times switched out while ready (@ref Profiler) */
+#endif /* __CONFIG_PROFILER */
+#if __CONFIG_STACK_CHECK
+	u16					th_stkfree;						/*!< @brief Painted words at the stack bottom, last seen */
+	u16					th_stkscan;						/*!< @brief Next word to check by __threadStackCheck() */
+#endif /* __CONFIG_STACK_CHECK */
 } __THREAD, *__PTHREAD;
 
 /**
@@ -134,8 +149,21 @@ __VOID 		__threadMaintenance(__VOID);
 __VOID		__threadSuspend(__PTHREAD th, u8 newstate);
 __VOID 		__threadAddToReadyList(__PTHREAD th);
 __VOID		__threadRemoveFromSuspended(__PTHREAD th);
+__VOID		__threadSetPriority(__PTHREAD th, u32 prio);
+u32			__threadGetNextTimeout(__VOID);
 __VOID		__threadYield(__VOID);
 
+#if __CONFIG_POST_STACK_OVERFLOW || __CONFIG_STACK_GUARD
+__VOID		__threadPostStackOverflow(__PTHREAD th);
+#endif /* __CONFIG_POST_STACK_OVERFLOW || __CONFIG_STACK_GUARD */
+
+#if __CONFIG_STACK_CHECK
+u32			__threadStackUsed(__PTHREAD th);
+u32			__threadStackPeak(__PTHREAD th);
+u32			__threadStackSuggest(__PTHREAD th);
+__VOID		__threadStackCheck(__VOID);
+#endif /* __CONFIG_STACK_CHECK */
+
 /**
   * @}
   */
@@ -47,8 +47,8 @@ typedef	__VOID (__TIMERFUNC)(__PVOID);
   * @{
   */
 
-#define	__TM_NORMAL			0x00		/*!< @brief Normal timer */
-#define	__TM_ONESHOOT		0x01		/*!< @brief One shot timer */
+#define	__TM_NORMAL			0x00		/*!< @brief Normal (periodic) timer */
+#define	__TM_ONESHOOT		0x01		/*!< @brief One shot timer, freed after its function returns */
 
 /**
   * @}
@@ -61,6 +61,7 @@ typedef	__VOID (__TIMERFUNC)(__PVOID);
 #define	__TM_READY			0x00		/*!< @brief Timer ready to execute */
 #define	__TM_INUSE			0x01		/*!< @brief Timer is in use */
 #define	__TM_DELETE			0x02		/*!< @brief Marked for deletion */
+#define	__TM_STOPPED		0x04		/*!< @brief Timer not armed */
 
 /**
   * @}
@@ -80,11 +81,13 @@ struct __timerTag {
 
 	u8						ti_type;	/*!< @brief Timer type */
 	u8						ti_state;	/*!< @brief Timer state */
-	u32						ti_time;	/*!< @brief Ticks to reload */
-	u32						ti_load;	/*!< @brief Ticks */
+	u32						ti_time;	/*!< @brief System tick of the next expiry */
+	u32						ti_load;	/*!< @brief Period in ticks */
 	__PVOID					ti_param;	/*!< @brief Timer optional parameter */
 	__TIMERFUNC				*ti_func;	/*!< @brief Timer function */
-	__PTIMER				ti_next;	/*!< @brief Pointer to next timer */
+	__PTIMER				ti_child;	/*!< @brief First child in the timer heap */
+	__PTIMER				ti_prev;	/*!< @brief Left sibling, or parent for the first child */
+	__PTIMER				ti_next;	/*!< @brief Right sibling, or next expired timer */
 
 };
 
@@ -95,6 +98,9 @@ struct __timerTag {
 __VOID			__timerInit(u32 stksize);
 __PTIMER		__timerCreate(u8 type, u32 time, __TIMERFUNC *func, __PVOID param);
 __BOOL			__timerDestroy(__PTIMER ti);
+__BOOL			__timerStart(__PTIMER ti, u32 time);
+__BOOL			__timerStop(__PTIMER ti);
+u32				__timerGetCount(__VOID);
 
 /**
   * @}
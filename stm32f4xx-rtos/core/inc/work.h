@@ -0,0 +1,154 @@
+/***************************************************************************
+ * work.h
+ * (C) 2010 Ivan Meleca
+ * Based on original code written by Ruben Meleca
+ * www.milos.it
+
+#   This program is free software; you can redistribute it and/or modify
+#   it under the terms of the GNU General Public License as published by
+#   the Free Software Foundation; either version 2 of the License, or
+#   (at your option) any later version.
+#
+#   This program is distributed in the hope that it will be useful,
+#   but WITHOUT ANY WARRANTY; without even the implied warranty of
+#   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#   GNU General Public License for more details.
+#
+#   You should have received a copy of the GNU General Public License
+#   along with this program; if not, write to the Free Software
+#   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+***************************************************************************/
+#ifndef __WORK_H__
+#define __WORK_H__
+
+#include <plat_cpu.h>
+#include "thread.h"
+#include "event.h"
+#include "timer.h"
+
+#if __CONFIG_COMPILE_WORK
+
+/** @addtogroup Work
+  * @{
+  */
+
+/** @defgroup Work_FunctionPrototypes Prototypes
+  * @{
+  */
+
+typedef	__VOID (__WORKFUNC)(__PVOID);
+
+/**
+  * @}
+  */
+
+/** @defgroup Work_Constants Constants
+  * @{
+  */
+
+/** @defgroup Work_Queues System queues
+  * @{
+  */
+
+#define __WORK_HIGH				0		/*!< @brief Queue served at __CONFIG_PRIO_WORKHIGH */
+#define __WORK_LOW				1		/*!< @brief Queue served at __CONFIG_PRIO_WORKLOW */
+#define __WORK_QUEUES			2		/*!< @brief Quantity of system queues */
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+/** @defgroup Work_Typedefs Typedefs
+  * @{
+  */
+
+typedef struct __workTag __WORK, *__PWORK;
+
+/*!
+ * @brief Work item, a function and its argument.
+ *
+ * The item belongs to the queue from __workSubmit() until its function is
+ * called: it can be submitted again from then on, even by the function itself.
+ */
+struct __workTag {
+	__PWORK				wk_next;		/*!< @brief Next item of the queue */
+	__WORKFUNC			*wk_func;		/*!< @brief Function to call */
+	__PVOID				wk_arg;			/*!< @brief Function argument */
+	__VOLATILE u32		wk_pending;		/*!< @brief Queued, not called yet */
+};
+
+typedef struct __workQueueTag __WORKQUEUE, *__PWORKQUEUE;
+
+/*!
+ * @brief Work queue, served by one thread.
+ */
+struct __workQueueTag {
+	__VOLATILE u32		wq_head;		/*!< @brief Last submitted item (__PWORK), items are linked newest first */
+	__EVENT				wq_event;		/*!< @brief Set when an item is submitted to the empty queue */
+	__PTHREAD			wq_thread;		/*!< @brief Worker thread */
+	u32					wq_runs;		/*!< @brief Items called */
+	u32					wq_batch;		/*!< @brief Most items taken at once */
+	__PWORKQUEUE		wq_next;		/*!< @brief Next queue in the system list */
+};
+
+/*!
+ * @brief Work item submitted after a delay, see __workSubmitDelayed().
+ */
+typedef struct {
+	__WORK				dw_work;		/*!< @brief Item submitted when the delay expires */
+	__PWORKQUEUE		dw_queue;		/*!< @brief Queue to submit to */
+	__PTIMER			dw_timer;		/*!< @brief Timer created on first use, stopped when it expires */
+} __DELAYED_WORK, *__PDELAYED_WORK;
+
+/**
+  * @}
+  */
+
+/** @defgroup Work_PublicMacros Public macros
+  * @{
+  */
+
+/*!
+ * @brief Static initializer of a __WORK item.
+ */
+#define __WORK_INITIALIZER(func, arg)	{ __NULL, (func), (arg), 0 }
+
+/*!
+ * @brief Returns one of the system queues (__WORK_HIGH or __WORK_LOW), __NULL
+ * before __workInit().
+ */
+#define __workGetQueue(tier)			(__workQueues[(tier)])
+
+/*!
+ * @brief Return __TRUE if the item is queued and its function not called yet.
+ */
+#define __workIsPending(wk)				((wk)->wk_pending != 0)
+
+/**
+  * @}
+  */
+
+extern __PWORKQUEUE __workQueues[__WORK_QUEUES];
+
+__VOID			__workInit(__VOID);
+__PWORKQUEUE	__workQueueCreate(__CONST __PSTRING name, u8 prio, u16 stack);
+__PWORKQUEUE	__workGetQueueList(__VOID);
+__VOID			__workPrepare(__PWORK wk, __WORKFUNC *func, __PVOID arg);
+__BOOL			__workSubmit(__PWORKQUEUE wq, __PWORK wk);
+__VOID			__workPrepareDelayed(__PDELAYED_WORK dw, __WORKFUNC *func, __PVOID arg);
+__BOOL			__workSubmitDelayed(__PWORKQUEUE wq, __PDELAYED_WORK dw, u32 ms);
+__BOOL			__workCancelDelayed(__PDELAYED_WORK dw);
+__VOID			__workDestroyDelayed(__PDELAYED_WORK dw);
+
+/**
+  * @}
+  */
+
+#endif /* __CONFIG_COMPILE_WORK */
+
+#endif /* __WORK_H__ */
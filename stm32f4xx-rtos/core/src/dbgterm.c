@@ -24,6 +24,10 @@
 #include "heap.h"
 #include "lock.h"
 #include "device.h"
+#include "pool.h"
+#include "profile.h"
+#include "log.h"
+#include "work.h"
 #include <common/inc/common.h>
 #if __CONFIG_COMPILE_FAT
 #include <fs/fat.h>
@@ -70,12 +74,15 @@ __STATIC __PTERMINAL __dbgTerminal = __NULL;	/*!< @brief Debug Terminal structur
 typedef struct __heapWalkTag {
 	u32 free;
 	u32 busy;
+	u32 largest;
+	u32 fblocks;
 	__PTERMINAL term;
 } __HEAPWALK;
 
 typedef struct __threadWalkTag {
 	__PTHREAD th;
 	u32 mem;
+	u32 blocks;
 } __THREADWALK_MEM;
 
 
@@ -99,6 +106,8 @@ __STATIC __BOOL __dbgHeapCallBack(__PVOID ptr, u32 size, __BOOL fr, __PTHREAD th
 	if (fr == __TRUE)
 	{
 		walk->free += size;
+		walk->fblocks++;
+		if (size > walk->largest) walk->largest = size;
 		__terminalWriteLine(walk->term, "%08lXh %6lu free  ", ptr, size);
 	} else {
 		walk->busy += size;
@@ -117,10 +126,50 @@ __STATIC __BOOL __dbgThreadCallBack(__PVOID ptr, u32 size, __BOOL fr, __PTHREAD
 {
 	__THREADWALK_MEM* mem = (__THREADWALK_MEM*) arg;
 
-	if (mem->th == th && fr == __FALSE) mem->mem += size;
+	if (mem->th == th && fr == __FALSE)
+	{
+		mem->mem += size;
+		mem->blocks++;
+	}
 	return(__TRUE);
 }
 
+/*!
+ * @brief Outputs the heap usage of every thread to the terminal.
+ *
+ * Blocks allocated before the scheduler was started, or from
+ * interrupt context, have no owner and are accounted as "system".
+ *
+ * @return	Nothing.
+ */
+__STATIC __VOID __dbgHeapThreads(__PTERMINAL term)
+{
+	__PTHREAD	th = __threadGetChain();
+	__THREADWALK_MEM mem;
+
+	__terminalWriteLine(term, "Owner    Blocks  Bytes");
+	__terminalWriteLine(term, "-------------------------------------");
+
+	for (;;)
+	{
+		mem.th = th;
+		mem.mem = mem.blocks = 0;
+
+		__heapWalk(__dbgThreadCallBack, &mem);
+
+		if (mem.blocks)
+		{
+			__terminalWriteLine(term, "%8s %6lu %6lu",
+							(th) ? (__PSTRING) th->th_name : "system",
+							mem.blocks,
+							mem.mem);
+		}
+
+		if (th == __NULL) break;
+		th = (__PTHREAD) th->th_lstnext;
+	}
+}
+
 /*!
  * @brief Entry point for "threads" terminal command.
  */
@@ -153,6 +202,69 @@ __STATIC __VOID	__dbgThreads(__PTERMINAL term)
 	}
 }
 
+#if __CONFIG_STACK_CHECK
+
+/*!
+ * @brief Entry point for "stack" terminal command.
+ *
+ * Size, use when switched out and peak use of each thread stack. Peaks are
+ * updated by the system thread a few words at a time (__threadStackCheck()),
+ * a thread just created shows only its first frame.
+ */
+__STATIC __VOID __dbgStack(__PTERMINAL term)
+{
+	__PTHREAD th = __threadGetChain();
+
+	__terminalWriteLine(term, "");
+	__terminalWriteLine(term, "Name      Size  Used  Peak  Free");
+	__terminalWriteLine(term, "--------------------------------");
+
+	while (th)
+	{
+		__terminalWriteLine(term, "%8s %5lu %5lu %5lu %5lu%s",
+						th->th_name,
+						(u32) th->th_stksize,
+						__threadStackUsed(th),
+						__threadStackPeak(th),
+						(u32) th->th_stksize - __threadStackPeak(th),
+						(th->th_stkfree) ? "" : " overflow");
+
+		th = (__PTHREAD) th->th_lstnext;
+	}
+
+	__terminalWriteLine(term, "");
+}
+
+/*!
+ * @brief Entry point for "stack sizes" terminal command.
+ *
+ * Stack sizes to create the threads with, see __threadStackSuggest().
+ */
+__STATIC __VOID __dbgStackSizes(__PTERMINAL term)
+{
+	__PTHREAD th = __threadGetChain();
+	u32 size = 0, suggest = 0;
+
+	__terminalWriteLine(term, "");
+	__terminalWriteLine(term, "Suggested stack sizes (peak + %lu%%):", (u32) __CONFIG_STACK_CHECK_MARGIN);
+	__terminalWriteLine(term, "");
+
+	while (th)
+	{
+		__terminalWriteLine(term, "%8s %5lu -> %5lu", th->th_name, (u32) th->th_stksize, __threadStackSuggest(th));
+
+		size += th->th_stksize;
+		suggest += __threadStackSuggest(th);
+		th = (__PTHREAD) th->th_lstnext;
+	}
+
+	__terminalWriteLine(term, "");
+	__terminalWriteLine(term, "Total: %lu -> %lu bytes", size, suggest);
+	__terminalWriteLine(term, "");
+}
+
+#endif /* __CONFIG_STACK_CHECK */
+
 /*!
  * @brief Outputs lock information to the terminal.
  *
@@ -174,8 +286,8 @@ __VOID	__dbgLocks(__PTERMINAL term)
 	__terminalWriteLine(term, "Locks defined: %lu", count);
 	__terminalWriteLine(term, "");
 
-	__terminalWriteLine(term, "Parent        Type     Status   Owner");
-	__terminalWriteLine(term, "-------------------------------------");
+	__terminalWriteLine(term, "Parent        Type     Status   Owner    Owns Contended HoldMax HoldAvg");
+	__terminalWriteLine(term, "-----------------------------------------------------------------------");
 
 	while(list)
 	{
@@ -205,14 +317,20 @@ __VOID	__dbgLocks(__PTERMINAL term)
 									break;
 		}
 
-		if (list->lock->owner != __NULL)
+		if (__lockGetOwner(list->lock) != __NULL)
 		{
-			__terminalWrite(term, "%9s", list->lock->owner->th_name);
+			__terminalWrite(term, "%9s", __lockGetOwner(list->lock)->th_name);
 		} else
 		{
 			__terminalWrite(term, "%9s", "None");
 		}
 
+		__terminalWrite(term, "%8lu %9lu %7lu %7lu",
+						list->lock->owns,
+						list->lock->contended,
+						list->lock->hold_max,
+						(list->lock->owns) ? list->lock->hold_total / list->lock->owns : 0);
+
 		__terminalWrite(term, "\r\n");
 
 		list = list->next;
@@ -265,6 +383,177 @@ __VOID __dbgDevices(__PTERMINAL term)
 	__terminalWriteLine(term, "");
 }
 
+#if __CONFIG_COMPILE_POOL
+
+/*!
+ * @brief Outputs the block pools statistics through the debug terminal.
+ *
+ * @return Nothing.
+ */
+__VOID __dbgPools(__PTERMINAL term)
+{
+	__PPOOL pool = __poolGetList();
+
+	__terminalWriteLine(term, "");
+
+	if (!pool)
+	{
+		__terminalWriteLine(term, "No pools defined");
+		return;
+	}
+
+	__terminalWriteLine(term, "Address   Block  Total  Free   Min Allocs     Fails");
+	__terminalWriteLine(term, "---------------------------------------------------");
+
+	while (pool)
+	{
+		__terminalWriteLine(term, "%08lXh %5lu %6lu %5lu %5lu %10lu %5lu",
+						pool->ref,
+						pool->block_size,
+						pool->block_qty,
+						pool->avail,
+						pool->min_avail,
+						pool->allocs,
+						pool->fails);
+
+		pool = pool->next;
+	}
+
+	__terminalWriteLine(term, "");
+}
+
+#endif /* __CONFIG_COMPILE_POOL */
+
+#if __CONFIG_PROFILER
+
+/*!
+ * @brief Outputs the profiler measures through the debug terminal ("prof" command).
+ *
+ * CPU use is in tenths of percent of the cycles since the last reset.
+ *
+ * @return Nothing.
+ */
+__VOID __dbgProfile(__PTERMINAL term)
+{
+	__PPROF_SITE ps = __profGetSites();
+	__PROF_HEADER hdr;
+	__PTHREAD th;
+	u64 total;
+	u32 i;
+
+	__profGetTotals(&hdr);
+
+	total = hdr.ph_idle + hdr.ph_isr;
+	for (th = __threadGetChain(); th; th = th->th_lstnext) total += th->th_cycles;
+	if (!total) total = 1;
+
+	__terminalWriteLine(term, "");
+	__terminalWriteLine(term, "Name       CPU   kCycles  Switches  Preempts");
+	__terminalWriteLine(term, "--------------------------------------------");
+
+	for (th = __threadGetChain(); th; th = th->th_lstnext)
+	{
+		i = (u32) (th->th_cycles * 1000 / total);
+		__terminalWriteLine(term, "%8s %3lu.%lu %9lu %9lu %9lu",
+						th->th_name,
+						i / 10, i % 10,
+						(u32) (th->th_cycles / 1000),
+						th->th_switches,
+						th->th_preempts);
+	}
+
+	i = (u32) (hdr.ph_idle * 1000 / total);
+	__terminalWriteLine(term, "%8s %3lu.%lu %9lu", "idle", i / 10, i % 10, (u32) (hdr.ph_idle / 1000));
+
+	i = (u32) (hdr.ph_isr * 1000 / total);
+	__terminalWriteLine(term, "%8s %3lu.%lu %9lu %9lu", "isr", i / 10, i % 10, (u32) (hdr.ph_isr / 1000), hdr.ph_isrcount);
+
+	__terminalWriteLine(term, "");
+	__terminalWriteLine(term, "Context switches: %lu", hdr.ph_switches);
+	__terminalWriteLine(term, "Longest interrupt: %lu cycles", hdr.ph_isrmax);
+	__terminalWriteLine(term, "CPU clock: %lu Hz", hdr.ph_hz);
+
+	__terminalWriteLine(term, "");
+	__terminalWriteLine(term, "Critical section  Max cycles     Count");
+	__terminalWriteLine(term, "--------------------------------------");
+
+	for (i = 0; i < hdr.ph_sites; i++)
+	{
+		__terminalWriteLine(term, "%08lXh        %10lu %9lu", ps[i].ps_site, ps[i].ps_max, ps[i].ps_count);
+	}
+
+	__terminalWriteLine(term, "");
+}
+
+#endif /* __CONFIG_PROFILER */
+
+#if __CONFIG_LOG
+
+/*!
+ * @brief Outputs the binary log levels and drop counters through the debug terminal ("log" command).
+ *
+ * @return Nothing.
+ */
+__VOID __dbgLog(__PTERMINAL term)
+{
+	u32 i;
+
+	__terminalWriteLine(term, "");
+	__terminalWriteLine(term, "Ring: %lu of %lu words used", __logGetUsed(), (u32) __CONFIG_LOG_WORDS);
+	__terminalWriteLine(term, "");
+	__terminalWriteLine(term, "Module Level  Drops");
+	__terminalWriteLine(term, "-------------------");
+
+	for (i = 0; i < __CONFIG_LOG_MODULES; i++)
+	{
+		__terminalWriteLine(term, "%6lu %5lu %6lu", i, (u32) __logLevels[i], __logGetDrops(i));
+	}
+
+	__terminalWriteLine(term, "");
+	__terminalWriteLine(term, "Dropped: %lu", __logGetDrops(__CONFIG_LOG_MODULES));
+	__terminalWriteLine(term, "");
+}
+
+#endif /* __CONFIG_LOG */
+
+#if __CONFIG_COMPILE_WORK
+
+/*!
+ * @brief Outputs the work queues through the debug terminal ("work" command).
+ *
+ * @return Nothing.
+ */
+__VOID __dbgWork(__PTERMINAL term)
+{
+	__PWORKQUEUE wq = __workGetQueueList();
+
+	__terminalWriteLine(term, "");
+
+	if (!wq)
+	{
+		__terminalWriteLine(term, "No work queues defined");
+		return;
+	}
+
+	__terminalWriteLine(term, "Thread          Prio       Runs  Batch");
+	__terminalWriteLine(term, "--------------------------------------");
+
+	while (wq)
+	{
+		__terminalWriteLine(term, "%14s %5lu %10lu %6lu",
+						wq->wq_thread->th_name,
+						(u32) wq->wq_thread->th_priority,
+						wq->wq_runs,
+						wq->wq_batch);
+
+		wq = wq->wq_next;
+	}
+
+	__terminalWriteLine(term, "");
+}
+
+#endif /* __CONFIG_COMPILE_WORK */
+
 #if __CONFIG_COMPILE_NET
 
 /*!
@@ -382,6 +671,9 @@ __VOID __dbgNetif(__PTERMINAL term)
 __VOID __dbgTerminalIn(__PTERMINAL term, __PSTRING str, __PSTRING params)
 {
 	__HEAPWALK mem;
+#if __CONFIG_LOG
+	__PSTRING arg;
+#endif
 	u16 days;
 	u8 hours;
 	u8 minutes;
@@ -395,14 +687,17 @@ __VOID __dbgTerminalIn(__PTERMINAL term, __PSTRING str, __PSTRING params)
 		__terminalWriteLine(term, "Address     Size State  Owner");
 		__terminalWriteLine(term, "-------------------------------------");
 
-		mem.free = mem.busy = 0;
+		mem.free = mem.busy = mem.largest = mem.fblocks = 0;
 		mem.term = term;
 					
 		__heapWalk(__dbgHeapCallBack, &mem);
 		__terminalWriteLine(term, "");
 
+		__dbgHeapThreads(term);
+		__terminalWriteLine(term, "");
+
 		__terminalWriteLine(term, "Busy: %lu bytes", mem.busy);
-		__terminalWriteLine(term, "Free: %lu bytes", mem.free);
+		__terminalWriteLine(term, "Free: %lu bytes in %lu blocks, largest %lu", mem.free, mem.fblocks, mem.largest);
 
 		__terminalWriteLine(term, "");
 		return;
@@ -437,6 +732,76 @@ __VOID __dbgTerminalIn(__PTERMINAL term, __PSTRING str, __PSTRING params)
 		return;
 	}
 
+#if __CONFIG_COMPILE_POOL
+	/* POOLS */
+	if (__strCmp(str, "pools") == 0)
+	{
+		__dbgPools(term);
+		return;
+	}
+#endif
+
+#if __CONFIG_PROFILER
+	/* PROFILER */
+	if (__strCmp(str, "prof") == 0)
+	{
+		__dbgProfile(term);
+		return;
+	}
+
+	if (__strCmp(str, "prof reset") == 0)
+	{
+		__profReset();
+		return;
+	}
+#endif
+
+#if __CONFIG_STACK_CHECK
+	/* STACK */
+	if (__strCmp(str, "stack") == 0)
+	{
+		__dbgStack(term);
+		return;
+	}
+
+	/* STACK SIZES */
+	if (__strCmp(str, "stack sizes") == 0)
+	{
+		__dbgStackSizes(term);
+		return;
+	}
+#endif
+
+#if __CONFIG_COMPILE_WORK
+	/* WORK */
+	if (__strCmp(str, "work") == 0)
+	{
+		__dbgWork(term);
+		return;
+	}
+#endif
+
+#if __CONFIG_LOG
+	/* LOG */
+	if (__strCmp(str, "log") == 0)
+	{
+		__dbgLog(term);
+		return;
+	}
+
+	/* LOG LEVEL <module> <level> */
+	if (__strnCmp(str, "log level ", 10) == 0)
+	{
+		arg = __strChr(str + 10, ' ');
+		if (arg)
+		{
+			*arg++ = 0;
+			__logSetLevel(__strToU32(str + 10), __strToU32(arg));
+		}
+		return;
+	}
+#endif
+
 	/* DEFRAG */
 	if (__strCmp(str, "defrag") == 0)
 	{
@@ -460,6 +825,10 @@ __VOID __dbgTerminalIn(__PTERMINAL term, __PSTRING str, __PSTRING params)
 						(u32) minutes,
 						(u32) seconds);
 
+		__terminalWriteLine(term, "Idle: %lu%%",
+						(__systemGetTickCount() >= 100) ?
+						__systemGetIdleTicks() / (__systemGetTickCount() / 100) : (u32) 0);
+
 		__terminalWriteLine(term, (""));
 		return;
 	}
@@ -24,6 +24,7 @@
 #include <core/inc/system.h>
 #include <core/inc/dbgterm.h>
 #include <common/inc/string.h>
+#include <common/inc/mem.h>
 
 /** @addtogroup Core
   * @{
@@ -45,6 +46,12 @@
   * switching boards for a specific development may still find the "serial1" device wherever is located on the
   * board.
   *
+  * Devices are found by name through a hash table filled by __deviceAdd().
+  * Threads reading or writing often can open a __DEVHANDLE with
+  * __deviceOpenHandle(): __deviceHRead() and __deviceHWrite() call the driver
+  * functions cached in the handle. __deviceLineRead() reads lines reading
+  * ahead all the buffered bytes at once, instead of one call per byte.
+  *
   * @{
   */
 
@@ -78,6 +85,7 @@
   */
 
 __STATIC __PDEVICE __deviceChain = __NULL;	/*!< @brief Device list chain */
+__STATIC __PDEVICE __deviceTable[__CONFIG_DEVICE_HASH];	/*!< @brief Devices by name hash */
 
 /**
   * @}
@@ -88,6 +96,59 @@ __STATIC __PDEVICE __deviceChain = __NULL;	/*!< @brief Device list chain */
   * @{
   */
 
+/*!
+ * @brief Hashes a device name (FNV-1a).
+ *
+ * Internal use.
+ * @param	name		Device name.
+ * @return				The hash.
+ */
+__STATIC u32 __deviceHash(__CONST __PSTRING name)
+{
+	u32 hash = 2166136261UL;
+
+	while (*name) hash = (hash ^ (u8) *name++) * 16777619UL;
+
+	return hash;
+}
+
+/*!
+ * @brief Read function of the handles with no read function.
+ *
+ * Internal use.
+ * @return				__DEV_ERROR.
+ */
+__STATIC i32 __deviceNoRead(__PDEVICE dv, __PVOID buf, u16 qty)
+{
+	return __DEV_ERROR;
+}
+
+/*!
+ * @brief Write function of the handles with no write function.
+ *
+ * Internal use.
+ * @return				__DEV_ERROR.
+ */
+__STATIC i32 __deviceNoWrite(__PDEVICE dv, __CONST __PVOID buf, u16 qty)
+{
+	return __DEV_ERROR;
+}
+
+/*!
+ * @brief Write function of the handles of __DEV_AUTOFLUSH devices.
+ *
+ * Internal use.
+ * @return				Bytes written, or an error code.
+ */
+__STATIC i32 __deviceWriteFlush(__PDEVICE dv, __CONST __PVOID buf, u16 qty)
+{
+	i32 res = (*dv->dv_write)(dv, buf, qty);
+
+	if (res > __DEV_OK && dv->dv_flush) (*dv->dv_flush)(dv);
+
+	return res;
+}
+
 /*!
  * @brief Find device by name.
  *
@@ -100,12 +161,13 @@ __STATIC __PDEVICE __deviceChain = __NULL;	/*!< @brief Device list chain */
  */
 __PDEVICE __deviceFind(__CONST __PSTRING name)
 {
-	__PDEVICE	dv = __deviceChain;
+	u32			hash = __deviceHash(name);
+	__PDEVICE	dv = __deviceTable[hash & (__CONFIG_DEVICE_HASH - 1)];
 
 	while(dv)
 	{
-		if (__strCmp(dv->dv_name,name) == 0) return(dv);
-		dv = dv->dv_next;
+		if (dv->dv_hash == hash && __strCmp(dv->dv_name,name) == 0) return(dv);
+		dv = dv->dv_hnext;
 	}
 	return(__NULL);
 }
@@ -444,6 +506,241 @@ i32	__deviceSize(__PDEVICE dv, u8 mode)
 	return __DEV_ERROR;
 }
 
+/*!
+ * @brief Reads from device into several buffers.
+ *
+ * Generates a call to the __DEV_READ() function for each buffer, stopping at
+ * the first one not filled.
+ *
+ * @param 	dv 		Pointer to valid device to read from.
+ * @param 	iov		Buffers.
+ * @param 	count	Quantity of buffers.
+ *
+ * @return			Quantity of bytes read. A negative value on error, if
+ * 					nothing was read.
+ */
+i32	__deviceReadV(__PDEVICE dv, __PDEVIOVEC iov, u8 count)
+{
+	i32 ret, total = 0;
+
+	/* Check for initialized or opened */
+	if (!dv->dv_initd || !dv->dv_opcnt) return __DEV_ERROR;
+	if (dv->dv_owner == __NULL || dv->dv_read == __NULL) return __DEV_ERROR;
+
+	for (; count; count--, iov++)
+	{
+		if (!iov->iov_len) continue;
+
+		ret = (*dv->dv_read)(dv, iov->iov_base, iov->iov_len);
+		if (ret < 0) return (total) ? total : ret;
+
+		total += ret;
+		if (ret < iov->iov_len) break;
+	}
+
+	return total;
+}
+
+/*!
+ * @brief Writes several buffers to a device.
+ *
+ * Generates a call to the __DEV_WRITE() function for each buffer, stopping at
+ * the first one not fully written. With __DEV_AUTOFLUSH, flushes once at the end.
+ *
+ * @param 	dv		Pointer to a valid device to write to.
+ * @param 	iov		Buffers.
+ * @param 	count	Quantity of buffers.
+ *
+ * @return			Quantity of bytes written. A negative value on error, if
+ * 					nothing was written.
+ */
+i32	__deviceWriteV(__PDEVICE dv, __CONST __PDEVIOVEC iov, u8 count)
+{
+	__PDEVIOVEC v = iov;
+	i32 ret = 0, total = 0;
+
+	/* Check for initialized or opened */
+	if (!dv->dv_initd || !dv->dv_opcnt) return __DEV_ERROR;
+	if (dv->dv_owner == __NULL || dv->dv_write == __NULL) return __DEV_ERROR;
+
+	for (; count; count--, v++)
+	{
+		if (!v->iov_len) continue;
+
+		ret = (*dv->dv_write)(dv, v->iov_base, v->iov_len);
+		if (ret < 0) break;
+
+		total += ret;
+		if (ret < v->iov_len) break;
+	}
+
+	if (total && (dv->dv_flags & __DEV_AUTOFLUSH)) __deviceFlush(dv);
+
+	return (total || ret >= 0) ? total : ret;
+}
+
+/*!
+ * @brief Opens a device and fills a handle for it.
+ *
+ * See __deviceOpen(). The handle caches the driver functions, with the
+ * flags set by __deviceInit() at this time: use __deviceHRead() and
+ * __deviceHWrite() until __deviceCloseHandle().
+ *
+ * @param	dh		Handle to fill.
+ * @param	dv		Pointer to valid device to open.
+ * @param	param	Optional value. It will be passed to the @ref __DEV_OPEN function.
+ *
+ * @return		__DEV_OK on success, non-zero on failure. On failure the
+ * 				handle functions return __DEV_ERROR.
+ */
+i32 __deviceOpenHandle(__PDEVHANDLE dh, __PDEVICE dv, u32 param)
+{
+	i32 ret;
+
+	dh->dh_dev = dv;
+	dh->dh_read = __deviceNoRead;
+	dh->dh_write = __deviceNoWrite;
+
+	if (!dv) return __DEV_ERROR;
+	if ((ret = __deviceOpen(dv, param)) != __DEV_OK) return ret;
+
+	if (dv->dv_read) dh->dh_read = dv->dv_read;
+	if (dv->dv_write) dh->dh_write = (dv->dv_flags & __DEV_AUTOFLUSH) ? __deviceWriteFlush : dv->dv_write;
+
+	return __DEV_OK;
+}
+
+/*!
+ * @brief Closes a handle opened with __deviceOpenHandle().
+ *
+ * See __deviceClose().
+ *
+ * @param	dh		Handle.
+ *
+ * @return		__DEV_OK on success, non-zero on failure.
+ */
+i32 __deviceCloseHandle(__PDEVHANDLE dh)
+{
+	i32 ret;
+
+	if (!dh->dh_dev) return __DEV_ERROR;
+	if ((ret = __deviceClose(dh->dh_dev)) != __DEV_OK) return ret;
+
+	dh->dh_read = __deviceNoRead;
+	dh->dh_write = __deviceNoWrite;
+
+	return __DEV_OK;
+}
+
+/*!
+ * @brief Prepares a buffered line reader.
+ *
+ * @param	lr		Line reader.
+ * @param	dh		Opened handle to read from.
+ * @param	buf		Read ahead buffer, the more bytes are buffered by the
+ * 					driver the less calls to read them.
+ * @param	size	Size of \c buf.
+ * @return	Nothing.
+ */
+__VOID __deviceLineInit(__PDEVLINE lr, __PDEVHANDLE dh, __PVOID buf, u16 size)
+{
+	lr->lr_handle = dh;
+	lr->lr_buf = buf;
+	lr->lr_size = size;
+	lr->lr_start = lr->lr_end = 0;
+	lr->lr_cr = 0;
+}
+
+/*!
+ * @brief Reads a line of text through a line reader.
+ *
+ * Like __deviceReadLine(), but each read call takes all the bytes buffered
+ * by the driver (at least one, waiting for it) into the line reader buffer.
+ * The bytes after the end of line are kept for the next call.
+ *
+ * With __DEV_RD_CRLF both CR and LF end the line, a LF right after the CR
+ * is skipped. CR and LF are never copied to \c buf.
+ *
+ * @param 	lr		Line reader.
+ * @param	buf		Buffer to receive the ASCII line.
+ * @param	qty		Size of \c buf. A longer line is returned in parts.
+ * @return 			Bytes read or an error code.
+ */
+i32 __deviceLineRead(__PDEVLINE lr, __PSTRING buf, u16 qty)
+{
+	__PDEVICE	dv = lr->lr_handle->dh_dev;
+	u32			mode = dv->dv_flags & __DEV_RD_CRLFMASK;
+	pu8			p;
+	pu8			q;
+	pu8			end;
+	u16			n = 0;
+	i32			len;
+	u8			c;
+
+	if (!qty) return __DEV_ERROR;
+
+	for (;;)
+	{
+		while (lr->lr_start < lr->lr_end)
+		{
+			/* Scan up to the next CR or LF, or up to the room left */
+			p = lr->lr_buf + lr->lr_start;
+			end = lr->lr_buf + lr->lr_end;
+			if (end - p > qty - 1 - n) end = p + (qty - 1 - n);
+
+			for (q = p; q < end && *q != __DEV_CR && *q != __DEV_LF; q++);
+
+			if (q > p)
+			{
+				__memCpy(buf + n, p, q - p);
+				n += q - p;
+				lr->lr_start += q - p;
+				lr->lr_cr = 0;
+			}
+
+			if (n == qty - 1)
+			{
+				buf[n] = __DEV_EOL;
+				return n;
+			}
+
+			if (lr->lr_start == lr->lr_end) break;
+
+			c = lr->lr_buf[lr->lr_start++];
+
+			if (c == __DEV_LF && lr->lr_cr)
+			{
+				lr->lr_cr = 0;
+				continue;
+			}
+
+			lr->lr_cr = 0;
+
+			if ((c == __DEV_CR && (mode & __DEV_RD_CR)) || (c == __DEV_LF && (mode & __DEV_RD_LF)))
+			{
+				lr->lr_cr = (c == __DEV_CR && (mode & __DEV_RD_LF));
+				buf[n] = __DEV_EOL;
+				return n;
+			}
+		}
+
+		/* Read ahead everything buffered, at least one byte */
+		len = (dv->dv_size) ? (*dv->dv_size)(dv, __DEV_RXSIZE) : 0;
+		if (len < 1) len = 1;
+		if (len > lr->lr_size) len = lr->lr_size;
+
+		lr->lr_start = lr->lr_end = 0;
+
+		if ((len = __deviceHRead(lr->lr_handle, lr->lr_buf, len)) <= 0)
+		{
+			buf[n] = __DEV_EOL;
+			return __DEV_ERROR;
+		}
+
+		lr->lr_end = len;
+	}
+}
+
 /*!
  * @brief Reads a line of text from the device.
  *
@@ -587,6 +884,10 @@ __VOID __deviceAdd(__PDEVICE dv, u8 count)
 	{
 		dv->dv_next = __deviceChain;
 		__deviceChain = dv;
+
+		dv->dv_hash = __deviceHash(dv->dv_name);
+		dv->dv_hnext = __deviceTable[dv->dv_hash & (__CONFIG_DEVICE_HASH - 1)];
+		__deviceTable[dv->dv_hash & (__CONFIG_DEVICE_HASH - 1)] = dv;
 		dv++;
 	}
 }
@@ -603,9 +904,19 @@ __VOID __deviceAdd(__PDEVICE dv, u8 count)
 __VOID __deviceRemove(__PDEVICE dv)
 {
 	__PDEVICE list;
+	__PDEVICE* link;
 
 	__systemDisableScheduler();
 
+	for (link = &__deviceTable[dv->dv_hash & (__CONFIG_DEVICE_HASH - 1)]; *link; link = &(*link)->dv_hnext)
+	{
+		if (*link == dv)
+		{
+			*link = dv->dv_hnext;
+			break;
+		}
+	}
+
 	list = __deviceChain;
 
 	if (list == dv)
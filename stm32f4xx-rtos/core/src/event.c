@@ -22,6 +22,7 @@
 
 #include "event.h"
 #include "system.h"
+#include "queue.h"
 #include <common/inc/thlist.h>
 
 /** @addtogroup Core
@@ -33,8 +34,15 @@
   *
   * This module defines the common code for events.
   * Event are used to signal the occurrence of an event from an ISR to a thread, or from a thread
-  * to another thread. A thread can wait only for a single event, and many threads can wait for
-  * the same event. Events are heavily used, for example in @ref Lock and @ref Queue.
+  * to another thread. Many threads can wait for the same event. Events are heavily used, for
+  * example in @ref Lock and @ref Queue.
+  *
+  * An event group holds 32 flags; threads wait for any or all of them with __evGroupWait().
+  *
+  * __waitMultiple() sleeps on several events, event groups and queues at once. It links each
+  * object's event to a private event of the caller: signaling a linked event also sets the
+  * private one. Locks can't be waited for this way, a lock's waiters are tracked by priority
+  * inheritance and have to take it with __lockOwn().
   *
   * @{
   */
@@ -85,6 +93,43 @@ __STATIC __VOID __eventDequeueThread(__PEVENT ev, __PTHREAD th)
 	__thlRemoveEvtPrio(th, &ev->ev_threads);
 }
 
+/*!
+ * @brief Sets the events linked by __waitMultiple() callers.
+ * @param ev	Pointer to event.
+ * @return Nothing.
+ */
+__STATIC __VOID __eventForward(__PEVENT ev)
+{
+	__PEVENT_LINK el;
+
+	if (!ev->ev_links) return;
+
+	__systemStop();
+	for (el = ev->ev_links; el; el = el->el_next) __eventSet(el->el_target);
+	__systemStart();
+}
+
+/*!
+ * @brief Returns the milliseconds left of a timeout.
+ * @param start		System tick count at the beginning of the wait.
+ * @param timeout	Timeout in milliseconds, zero for infinite.
+ * @param left		Receives the milliseconds left (zero if infinite).
+ * @return __FALSE if the timeout expired.
+ */
+__STATIC __BOOL __eventTimeLeft(u32 start, u32 timeout, u32* left)
+{
+	u32 elapsed;
+
+	*left = 0;
+	if (!timeout) return __TRUE;
+
+	elapsed = CPU_TICKS_TO_MS(__systemGetTickCount() - start);
+	if (elapsed >= timeout) return __FALSE;
+
+	*left = timeout - elapsed;
+	return __TRUE;
+}
+
 /*!
  * @brief Signals an event with a return code.
  * @param ev	Pointer to event.
@@ -98,6 +143,8 @@ __STATIC __VOID __eventSignal(__PEVENT ev, u8 val)
 	/* Signal the event */
 	ev->ev_state = val;
 
+	__eventForward(ev);
+
 	/* wake up the thread
 	 * (if any, we can be setting an event with no one waiting for it)
 	 */
@@ -231,7 +278,8 @@ u8	__eventWait(__PEVENT ev, u32 timeout)
 	/* Enable interrupts */
 	__systemStart();
 
-	while (th->th_status != __THSTS_RUNNING);
+	/* Until scheduled again, this context is also the idle loop */
+	while (th->th_status != __THSTS_RUNNING) __systemIdle();
 	
 	/* At this point the thread resumes. Test for state and
 	 * eventually timeout.
@@ -332,6 +380,8 @@ __VOID __eventSetOne(__PEVENT ev)
 		__thlRemoveEvtPrio(ev->ev_threads, (__PTHREAD*) &ev->ev_threads);
 	}
 
+	__eventForward(ev);
+
 	__systemStart();
 }
 
@@ -379,6 +429,270 @@ __PTHREAD __eventGetWaitingThreads(__PEVENT ev)
 	return ev->ev_threads;
 }
 
+/*!
+ * @brief Initializes an event group, with all the flags cleared.
+ *
+ * @param eg	Pointer to the event group.
+ *
+ * @return Nothing.
+ */
+__VOID __evGroupInit(__PEVGROUP eg)
+{
+	eg->eg_flags = 0;
+	eg->eg_event.ev_state = __EV_RESET;
+	eg->eg_event.ev_threads = __NULL;
+	eg->eg_event.ev_links = __NULL;
+}
+
+/*!
+ * @brief Sets flags of an event group.
+ *
+ * Wakes up the threads waiting on the group, each one checks its own
+ * condition. Can be called from interrupts.
+ *
+ * @param eg	Pointer to the event group.
+ * @param flags	Flags to set.
+ *
+ * @return Nothing.
+ */
+__VOID __evGroupSet(__PEVGROUP eg, u32 flags)
+{
+	__systemStop();
+	eg->eg_flags |= flags;
+	__systemStart();
+
+	__eventSet(&eg->eg_event);
+}
+
+/*!
+ * @brief Clears flags of an event group.
+ *
+ * Can be called from interrupts.
+ *
+ * @param eg	Pointer to the event group.
+ * @param flags	Flags to clear.
+ *
+ * @return Nothing.
+ */
+__VOID __evGroupClear(__PEVGROUP eg, u32 flags)
+{
+	__systemStop();
+	eg->eg_flags &= ~flags;
+	__systemStart();
+}
+
+/*!
+ * @brief Waits for flags of an event group.
+ *
+ * Returns at once if the condition is already met. Call this function from a thread.
+ *
+ * @param eg		Pointer to the event group.
+ * @param flags		Flags to wait for.
+ * @param mode		Bitwise value:
+ * @arg __EVGROUP_ANY	Any of \c flags set is enough.
+ * @arg __EVGROUP_ALL	All of \c flags must be set.
+ * @arg __EVGROUP_CLEAR	Clears the flags returned, atomically with the test.
+ * @param timeout	Maximum time to wait in milliseconds. Zero for infinite.
+ *
+ * @return The flags of \c flags set when the condition was met, zero on timeout.
+ */
+u32 __evGroupWait(__PEVGROUP eg, u32 flags, u8 mode, u32 timeout)
+{
+	u32 start = __systemGetTickCount();
+	u32 got, left;
+	u8 ret;
+
+	if (!flags) return 0;
+
+	for (;;)
+	{
+		/* Reset, test and queue on the event in one critical section: the
+		 * event is shared by all the waiters, so another waiter resetting it
+		 * between our test and our wait would lose the wakeup.
+		 * __eventWait() accepts being called with interrupts disabled.
+		 */
+		__systemStop();
+
+		__eventReset(&eg->eg_event);
+
+		got = eg->eg_flags & flags;
+		if ((mode & __EVGROUP_ALL) ? got == flags : got != 0)
+		{
+			if (mode & __EVGROUP_CLEAR) eg->eg_flags &= ~got;
+			__systemStart();
+			return got;
+		}
+
+		if (!__eventTimeLeft(start, timeout, &left))
+		{
+			__systemStart();
+			return 0;
+		}
+
+		ret = __eventWait(&eg->eg_event, left);
+		__systemStart();
+
+		if (ret == __EVRET_ABORT) return 0;
+	}
+}
+
+/*!
+ * @brief Returns the event signaled by a wait object.
+ * @param wo	Wait object.
+ * @return The event, or __NULL if the type is unknown.
+ */
+__STATIC __PEVENT __waitGetEvent(__PWAIT_OBJ wo)
+{
+	if (!wo->wo_obj) return __NULL;
+
+	switch (wo->wo_type)
+	{
+		case __WAIT_EVENT:
+			return (__PEVENT) wo->wo_obj;
+
+		case __WAIT_EVGROUP:
+			return &((__PEVGROUP) wo->wo_obj)->eg_event;
+
+#if __CONFIG_COMPILE_QUEUE
+		case __WAIT_QUEUE:
+			return &((__PQUEUE) wo->wo_obj)->event_r;
+#endif /* __CONFIG_COMPILE_QUEUE */
+	}
+
+	return __NULL;
+}
+
+/*!
+ * @brief Updates \c wo_ready of each wait object.
+ * @param objs	Wait objects.
+ * @param qty	Quantity of objects.
+ * @return The index of the first ready object, or __WAIT_TIMEOUT if none.
+ */
+__STATIC i32 __waitCheck(__PWAIT_OBJ objs, u8 qty)
+{
+	i32 ret = __WAIT_TIMEOUT;
+	__PVOID obj;
+	u8 i;
+
+	for (i = 0; i < qty; i++)
+	{
+		obj = objs[i].wo_obj;
+
+		switch (objs[i].wo_type)
+		{
+			case __WAIT_EVENT:
+				objs[i].wo_ready = ((__PEVENT) obj)->ev_state != __EV_RESET;
+				break;
+
+			case __WAIT_EVGROUP:
+				objs[i].wo_ready = (((__PEVGROUP) obj)->eg_flags & objs[i].wo_flags) != 0;
+				break;
+
+#if __CONFIG_COMPILE_QUEUE
+			case __WAIT_QUEUE:
+				objs[i].wo_ready = __queueGetItemCount(((__PQUEUE) obj)) != 0;
+				break;
+#endif /* __CONFIG_COMPILE_QUEUE */
+		}
+
+		if (objs[i].wo_ready && ret == __WAIT_TIMEOUT) ret = i;
+	}
+
+	return ret;
+}
+
+/*!
+ * @brief Removes the links added by __waitMultiple().
+ * @param objs	Wait objects.
+ * @param qty	Quantity of linked objects.
+ * @return Nothing.
+ */
+__STATIC __VOID __waitUnlink(__PWAIT_OBJ objs, u8 qty)
+{
+	__PEVENT_LINK* link;
+	u8 i;
+
+	__systemStop();
+
+	for (i = 0; i < qty; i++)
+	{
+		for (link = &__waitGetEvent(&objs[i])->ev_links; *link; link = &(*link)->el_next)
+		{
+			if (*link == &objs[i].wo_link)
+			{
+				*link = objs[i].wo_link.el_next;
+				break;
+			}
+		}
+	}
+
+	__systemStart();
+}
+
+/*!
+ * @brief Waits until any of several objects is ready.
+ *
+ * Objects are events (as __eventWait(), reset them before), event groups
+ * (any of \c wo_flags set) and queues (items available). Nothing is consumed:
+ * after the call the thread takes the data from the ready objects. The
+ * \c wo_ready member of each object tells which ones were ready on return.
+ * Call this function from a thread.
+ *
+ * @param objs		Array of wait objects. Must stay valid during the call.
+ * @param qty		Quantity of objects.
+ * @param timeout	Maximum time to wait in milliseconds. Zero for infinite.
+ *
+ * @return The index of the first ready object, __WAIT_TIMEOUT on timeout
+ * or __WAIT_ERROR on invalid parameters.
+ */
+i32 __waitMultiple(__PWAIT_OBJ objs, u8 qty, u32 timeout)
+{
+	u32 start = __systemGetTickCount();
+	__EVENT wake;
+	__PEVENT ev;
+	u32 left;
+	i32 ret;
+	u8 i;
+
+	if (!objs || !qty) return __WAIT_ERROR;
+
+	wake.ev_state = __EV_RESET;
+	wake.ev_threads = __NULL;
+	wake.ev_links = __NULL;
+
+	/* Link every object's event to ours */
+	__systemStop();
+
+	for (i = 0; i < qty; i++)
+	{
+		if ((ev = __waitGetEvent(&objs[i])) == __NULL)
+		{
+			__systemStart();
+			__waitUnlink(objs, i);
+			return __WAIT_ERROR;
+		}
+
+		objs[i].wo_link.el_target = &wake;
+		objs[i].wo_link.el_next = ev->ev_links;
+		ev->ev_links = &objs[i].wo_link;
+	}
+
+	__systemStart();
+
+	for (;;)
+	{
+		/* Reset before testing, so a signal from now on wakes us */
+		__eventReset(&wake);
+		if ((ret = __waitCheck(objs, qty)) != __WAIT_TIMEOUT) break;
+
+		if (!__eventTimeLeft(start, timeout, &left)) break;
+		__eventWait(&wake, left);
+	}
+
+	__waitUnlink(objs, qty);
+	return ret;
+}
+
 /**
   * @}
   */
@@ -30,6 +30,23 @@
 
 /** @defgroup Heap Heap
   * Heap management functions.
+  *
+  * The heap is a Two-Level Segregated Fit (TLSF) allocator. Free blocks are
+  * kept in lists segregated by size: a first level for each power of two, split
+  * in __HEAP_SL_COUNT second levels. Two bitmaps tell which lists are not
+  * empty, so a suitable free block is found with a couple of count-leading-zeros,
+  * whatever the number of blocks. Freed blocks are merged with their free
+  * physical neighbors immediately, so there is no need to defrag the heap.
+  *
+  * Allocation and release are constant time and run with interrupts disabled
+  * for a short and bounded time, instead of stopping the scheduler while
+  * walking the heap.
+  *
+  * Every block has an 8 bytes header: the payload size (with the free flags)
+  * and the owner thread. A free block uses its payload to link the free list
+  * and stores a pointer to its header in its last word, so the next block can
+  * find it when merging.
+  *
   * @{
   */
 
@@ -37,8 +54,41 @@
   * @{
   */
 
-#define	__HEAPFREEFLAG	0x80000000
-#define	__MAXEXCEEDED	16
+#define __HEAP_ALIGN_LOG2		2									/*!< @brief Block sizes are multiple of 4 */
+#define __HEAP_ALIGN			(1 << __HEAP_ALIGN_LOG2)
+#define __HEAP_SL_LOG2			4									/*!< @brief Second level lists per first level (log2) */
+#define __HEAP_SL_COUNT			(1 << __HEAP_SL_LOG2)
+#define __HEAP_FL_SHIFT			(__HEAP_SL_LOG2 + __HEAP_ALIGN_LOG2)
+#define __HEAP_SMALL_BLOCK		(1 << __HEAP_FL_SHIFT)				/*!< @brief Sizes below this are all in the first level 0 */
+#define __HEAP_FL_MAX			18									/*!< @brief Largest block is below 2^(__HEAP_FL_MAX + 1) bytes */
+#define __HEAP_FL_COUNT			(__HEAP_FL_MAX - __HEAP_FL_SHIFT + 2)
+#define __HEAP_MAX_SIZE			((1 << (__HEAP_FL_MAX + 1)) - __HEAP_ALIGN)
+
+#define __HEAP_HDR_SIZE			((u32) &((__PHEAP_BLOCK) 0)->next)	/*!< @brief Block header size */
+#define __HEAP_MIN_SIZE			(3 * sizeof(__PVOID))				/*!< @brief Free list links and footer */
+
+#define	__HEAP_FREE				0x00000001							/*!< @brief Block is free */
+#define	__HEAP_PREV_FREE		0x00000002							/*!< @brief Previous physical block is free */
+#define __HEAP_FLAGS			(__HEAP_FREE | __HEAP_PREV_FREE)
+
+/**
+  * @}
+  */
+
+/** @defgroup Heap_PrivateTypedefs Private typedefs
+  * @{
+  */
+
+/*!
+ * @brief Heap block header. @c next and @c prev are valid only for free
+ * blocks, they are the first words of the payload.
+ */
+typedef struct __heapBlockTag {
+	u32							size;		/*!< @brief Payload size and flags */
+	__PTHREAD					owner;		/*!< @brief Thread that allocated the block */
+	struct __heapBlockTag*		next;		/*!< @brief Next free block in the list */
+	struct __heapBlockTag*		prev;		/*!< @brief Previous free block in the list */
+} __HEAP_BLOCK, *__PHEAP_BLOCK;
 
 /**
   * @}
@@ -48,9 +98,30 @@
   * @{
   */
 
-__STATIC pu32	__heapPool;			/*!< @brief Heap start pointer */
-__STATIC u32	__heapAvail;		/*!< @brief Available memory */
-__STATIC u32	__heapSize;			/*!< @brief Original heap size */
+__STATIC __PHEAP_BLOCK	__heapPool;								/*!< @brief Heap start pointer */
+__STATIC __PHEAP_BLOCK	__heapEnd;								/*!< @brief Sentinel block, end of the heap */
+__STATIC u32			__heapAvail;							/*!< @brief Available memory */
+__STATIC u32			__heapSize;								/*!< @brief Original heap size */
+__STATIC u32			__heapFlMap;							/*!< @brief Non-empty first levels */
+__STATIC u32			__heapSlMap[__HEAP_FL_COUNT];			/*!< @brief Non-empty second levels */
+__STATIC __PHEAP_BLOCK	__heapFreeList[__HEAP_FL_COUNT][__HEAP_SL_COUNT];	/*!< @brief Free lists */
+
+/**
+  * @}
+  */
+
+/** @defgroup Heap_PrivateMacros Private macros
+  * @{
+  */
+
+#define __heapBlockSize(b)			((b)->size & ~__HEAP_FLAGS)
+#define __heapBlockPayload(b)		((__PVOID) &(b)->next)
+#define __heapBlockFromPayload(p)	((__PHEAP_BLOCK) ((pu8) (p) - __HEAP_HDR_SIZE))
+#define __heapBlockNext(b)			((__PHEAP_BLOCK) ((pu8) __heapBlockPayload(b) + __heapBlockSize(b)))
+#define __heapBlockFooter(b)		((__PHEAP_BLOCK*) __heapBlockNext(b) - 1)
+#define __heapBlockPrev(b)			(*((__PHEAP_BLOCK*) (b) - 1))
+#define __heapFls(x)				(31 - __cpuCountLeadingZeros(x))
+#define __heapFfs(x)				(31 - __cpuCountLeadingZeros((x) & (~(x) + 1)))
 
 /**
   * @}
@@ -60,6 +131,140 @@ __STATIC u32	__heapSize;			/*!< @brief Original heap size */
   * @{
   */
 
+/*!
+ * @brief Finds the free lists for a block size.
+ *
+ * Internal use. Avoid calls to this function outside heap.c file.
+ * @param	size	Block payload size.
+ * @param	fl		Pointer to the first level index.
+ * @param	sl		Pointer to the second level index.
+ * @return	Nothing.
+ */
+__STATIC __VOID __heapMapping(u32 size, pu32 fl, pu32 sl)
+{
+	u32 f;
+
+	if (size < __HEAP_SMALL_BLOCK)
+	{
+		*fl = 0;
+		*sl = size >> __HEAP_ALIGN_LOG2;
+	} else
+	{
+		f = __heapFls(size);
+		*sl = (size >> (f - __HEAP_SL_LOG2)) ^ __HEAP_SL_COUNT;
+		*fl = f - (__HEAP_FL_SHIFT - 1);
+	}
+}
+
+/*!
+ * @brief Links a block in its free list and marks it as free.
+ *
+ * Internal use. Avoid calls to this function outside heap.c file.
+ * @param	b		Block to insert.
+ * @return	Nothing.
+ */
+__STATIC __VOID __heapInsertFree(__PHEAP_BLOCK b)
+{
+	u32 fl, sl;
+	__PHEAP_BLOCK next = __heapBlockNext(b);
+
+	__heapMapping(__heapBlockSize(b), &fl, &sl);
+
+	b->size |= __HEAP_FREE;
+	b->owner = __NULL;
+	b->prev = __NULL;
+	b->next = __heapFreeList[fl][sl];
+	if (b->next) b->next->prev = b;
+	__heapFreeList[fl][sl] = b;
+
+	__heapFlMap |= (1 << fl);
+	__heapSlMap[fl] |= (1 << sl);
+
+	/* Footer and flag for the next physical block */
+	*__heapBlockFooter(b) = b;
+	next->size |= __HEAP_PREV_FREE;
+
+	__heapAvail += __heapBlockSize(b);
+}
+
+/*!
+ * @brief Unlinks a block from its free list and marks it as used.
+ *
+ * Internal use. Avoid calls to this function outside heap.c file.
+ * @param	b		Block to remove.
+ * @return	Nothing.
+ */
+__STATIC __VOID __heapRemoveFree(__PHEAP_BLOCK b)
+{
+	u32 fl, sl;
+
+	__heapMapping(__heapBlockSize(b), &fl, &sl);
+
+	if (b->next) b->next->prev = b->prev;
+	if (b->prev)
+	{
+		b->prev->next = b->next;
+	} else
+	{
+		__heapFreeList[fl][sl] = b->next;
+		if (!b->next)
+		{
+			__heapSlMap[fl] &= ~(1 << sl);
+			if (!__heapSlMap[fl]) __heapFlMap &= ~(1 << fl);
+		}
+	}
+
+	b->size &= ~__HEAP_FREE;
+	__heapBlockNext(b)->size &= ~__HEAP_PREV_FREE;
+
+	__heapAvail -= __heapBlockSize(b);
+}
+
+/*!
+ * @brief Finds a free block of at least the requested size.
+ *
+ * Internal use. Avoid calls to this function outside heap.c file.
+ * The size is rounded up to the next list boundary, so any block of the list
+ * found is big enough (good fit, not best fit). When no such list exists, the
+ * head of the list holding the exact size is checked as a last resort, so a
+ * single large free block can still serve a request close to its size.
+ * @param	size	Required payload size. Must be normalized.
+ * @return 	Pointer to the free block, __NULL if there is not one.
+ */
+__STATIC __PHEAP_BLOCK __heapFindFree(u32 size)
+{
+	u32 fl, sl, map;
+	__PHEAP_BLOCK b;
+
+	__heapMapping(size, &fl, &sl);
+	if (fl >= __HEAP_FL_COUNT) return __NULL;
+
+	b = __heapFreeList[fl][sl];
+	if (b && __heapBlockSize(b) < size) b = __NULL;
+
+	if (size >= __HEAP_SMALL_BLOCK)
+	{
+		size += (1 << (__heapFls(size) - __HEAP_SL_LOG2)) - 1;
+	}
+
+	__heapMapping(size, &fl, &sl);
+	if (fl >= __HEAP_FL_COUNT) return b;
+
+	/* A list on the same first level, not smaller */
+	map = __heapSlMap[fl] & (~0UL << sl);
+	if (!map)
+	{
+		/* Any list of a bigger first level */
+		map = (fl + 1 < __HEAP_FL_COUNT) ? __heapFlMap & (~0UL << (fl + 1)) : 0;
+		if (!map) return b;
+
+		fl = __heapFfs(map);
+		map = __heapSlMap[fl];
+	}
+
+	return __heapFreeList[fl][__heapFfs(map)];
+}
+
 /*!
  * @brief Initializes the heap manager.
  *
@@ -68,31 +273,48 @@ __STATIC u32	__heapSize;			/*!< @brief Original heap size */
  * __CPU_HEAP_BASE and __CPU_HEAP_SIZE macros.
  * @param 	mem			Heap base address.
  * @param	size		Heap size.
- * @return	nothing.
+ * @return	nothing.
  */
 __VOID	__heapInit(__PVOID mem, u32 size)
 {
 	__STATIC u8 heap_init = 0;
+	__PHEAP_BLOCK b;
+	u32 align;
 
 	if (heap_init == 0)
 	{
-		__heapPool = (pu32) mem;
 		__memSet(mem,0,size);
-		size -= sizeof(u32);
-		*__heapPool = size | __HEAPFREEFLAG;
-		__heapAvail = __heapSize = size;
+
+		/* Align the start and the size */
+		align = (__HEAP_ALIGN - ((u32) mem & (__HEAP_ALIGN - 1))) & (__HEAP_ALIGN - 1);
+		mem = (pu8) mem + align;
+		size = (size - align) & ~(__HEAP_ALIGN - 1);
+
+		/* One free block, and a zero-sized used block to stop merging */
+		size -= 2 * __HEAP_HDR_SIZE;
+		if (size > __HEAP_MAX_SIZE) size = __HEAP_MAX_SIZE;
+
+		b = __heapPool = (__PHEAP_BLOCK) mem;
+		b->size = size;
+		__heapEnd = __heapBlockNext(b);
+		__heapEnd->size = 0;
+		__heapEnd->owner = __NULL;
+
+		__heapAvail = 0;
+		__heapSize = size;
+		__heapInsertFree(b);
+
 		heap_init = 1;
 	}
 }
 
 /*!
  * @brief Returns the available remaining heap size.
- * @return The available heap size.
+ * @return The available heap size.
  */
 u32	__heapAvailable(__VOID)
 {
-	if (__heapAvail < 8) return 0;
-	return(__heapAvail - (u32) 8);
+	return __heapAvail;
 }
 
 /*!
@@ -100,85 +322,18 @@ u32	__heapAvailable(__VOID)
  *
  * Internal use. Avoid calls to this functions outside heap.c file.
  * @param	size	The required size
- * @return	The size in module of 4.
+ * @return	The size in module of 4, not less than the minimum block size.
  */
-__STATIC u16 __heapNormalizeSize(u16 size)
+__STATIC u32 __heapNormalizeSize(u32 size)
 {
-	if (size & 0x0003)
+	if (size & (__HEAP_ALIGN - 1))
 	{
-		size += (4 - (size & 0x0003));
+		size += (__HEAP_ALIGN - (size & (__HEAP_ALIGN - 1)));
 	}
 
-	return(size + sizeof(u32));
-}
-
-/*!
- * @brief Find the best area to allocate the requested size.
- *
- * Internal use. Avoid calls to this function outside heap.c file.
- * @param	size		Required memory size. Must be normalized.
- * @param	rs			Pointer to the remaining free space.
- * @return 	Pointer to the memory block or __NULL if there is not
- * available free space.
- */
-__STATIC __PVOID __heapFindBest(u16 size, pu32 rs)
-{
-	pu32	ptr;
-	pu8		bak;
-	pu32	lastptr = __NULL;
-	u32		lastsize = 0xFFFFFFFF;
-	u32		avail;
-	u32		sum = 0;
-	u8		dsp;
-
-	/* Check for available free space */
-	if ((u32) size > __heapAvailable()) return(__NULL);
-
-	/* Walk heap searching for the best empty space according to required memory size */
-	ptr = __heapPool;
-	bak = (pu8) ptr;
-	for (;;)
-	{
-		avail = *ptr;
-		(avail & __HEAPFREEFLAG) ? (dsp = 1) : (dsp = 0);
-		avail &= ~__HEAPFREEFLAG;
-		if (dsp)
-		{
-			if (avail == (u32) size)
-			{
-				/* found it! */
-				*rs = 0;
-				return(ptr);
-			}
-
-			/* If free memory block is greater than size + __MAXEXCEEDED then allow storage */
-			if (avail >= (u32) size && avail <= ((u32) size + __MAXEXCEEDED))
-			{
-				*rs = avail - (u32) size;
-				return(ptr);
-			}
-
-			if (avail > size && (avail - (u32) size) < lastsize)
-			{
-				/* Store the last best fit area */
-				lastsize = avail - (u32) size;
-				lastptr  = ptr;
-			}
-		}
-
-		bak += (avail + sizeof(u32));
+	if (size < __HEAP_MIN_SIZE) size = __HEAP_MIN_SIZE;
 
-		ptr = (pu32) bak;
-		sum += avail;
-		if (sum > (__heapSize - 32)) break;
-	}
-	if (lastptr == __NULL) return(__NULL);
-	if (!(*lastptr & __HEAPFREEFLAG)) return(__NULL);
-
-	avail = *lastptr & ~__HEAPFREEFLAG;
-	/* remaining space of the block */
-	*rs = avail - (u32) size;
-	return(lastptr);
+	return(size);
 }
 
 /*!
@@ -186,49 +341,52 @@ __STATIC __PVOID __heapFindBest(u16 size, pu32 rs)
  *
  * Call this function to claim a free memory block from the heap.
  * @param	size	Requested size.
- * @return	Pointer to a free memory block or __NULL if no heap memory is available.
+ * @return	Pointer to a free memory block or __NULL if no heap memory is available.
  */
-__PVOID	__heapAlloc(u16 size)
+__PVOID	__heapAlloc(u32 size)
 {
-	pu32		ptr;
-	u32			rest = 0;
+	__PHEAP_BLOCK b, rest;
+	u32 avail;
 
-	if ((size = __heapNormalizeSize(size)) == 0) return(__NULL);
+	if (!size || size > __HEAP_MAX_SIZE) return(__NULL);
+	size = __heapNormalizeSize(size);
 
-	__systemDisableScheduler();
+	__systemStop();
 
-	if ((ptr = (pu32) __heapFindBest(size,&rest)) == __NULL)
+	if ((b = __heapFindFree(size)) == __NULL)
 	{
-		__systemEnableScheduler();
+		__systemStart();
 		return(__NULL);
 	}
 
-	if (rest <= (u32) __MAXEXCEEDED)
-	{
-		size += rest;
-		__heapAvail -= (u32) size;
-	} else
+	__heapRemoveFree(b);
+
+	/* Split, if the remaining space can hold a free block */
+	avail = __heapBlockSize(b);
+	if (avail >= size + __HEAP_HDR_SIZE + __HEAP_MIN_SIZE)
 	{
-		*(ptr + ((size + sizeof(u32)) / sizeof(u32))) = (rest -  (u32) sizeof(u32)) | __HEAPFREEFLAG;
-		__heapAvail -= (u32) (size + sizeof(u32));
+		b->size = size | (b->size & __HEAP_PREV_FREE);
+		rest = __heapBlockNext(b);
+		rest->size = avail - size - __HEAP_HDR_SIZE;
+		__heapInsertFree(rest);
 	}
 
-	*ptr = (u32) size;
-	*(ptr + (u32) (size / sizeof(u32))) = (u32) __threadGetCurrent();
+	b->owner = __threadGetCurrent();
 
-	__systemEnableScheduler();
+	__systemStart();
 
-	return(ptr + 1);
+	return(__heapBlockPayload(b));
 }
+
 /*!
  * @brief Allocates memory and fills it with zeroes.
  *
  * Generates a call to __heapAlloc() function, and then uses the __memSet() function
  * to fill the requested memory block with zeroes.
  * @param	size	Requested memory size.
- * @return	Pointer to a free memory block or __NULL if no heap memory is available.
+ * @return	Pointer to a free memory block or __NULL if no heap memory is available.
  */
-__PVOID	__heapAllocZero(u16 size)
+__PVOID	__heapAllocZero(u32 size)
 {
 	pu8		ptr;
 
@@ -243,97 +401,83 @@ __PVOID	__heapAllocZero(u16 size)
  * @brief Frees a previously allocated memory block.
  *
  * Call this function to free a claimed memory space returned by the __heapAlloc() function.
- * Beware that this function will not check the validity of the pointer passed as parameter.
- * The pointer must be exactly the same returned from the __heapAlloc() function.
- * The misuse of this function could lead to general system instability.
+ * The block is merged with the free blocks around it.
+ * Beware that this function will only check that the pointer is inside the heap and the
+ * block is not already free. The pointer must be exactly the same returned from the
+ * __heapAlloc() function. The misuse of this function could lead to general system instability.
  * @param ptr			Pointer to the block of memory to be freed.
- * @return Nothing.
+ * @return Nothing.
  */
 __VOID	__heapFree(__PVOID ptr)
 {
-	pu32		p = (pu32) ptr - 1;
+	__PHEAP_BLOCK b = __heapBlockFromPayload(ptr);
+	__PHEAP_BLOCK n;
 
 	/* Minimal sanity check */
-	if (!(*p & __HEAPFREEFLAG)) {
-		if ((pu32) ptr > __heapPool && (pu32) ptr < (__heapPool + (__heapSize / sizeof(u32))))
-		{
-			__heapAvail += *p;
-			*p |= __HEAPFREEFLAG;
-		}
+	if (b < __heapPool || b >= __heapEnd) return;
+
+	__systemStop();
+
+	if (b->size & __HEAP_FREE)
+	{
+		__systemStart();
+		return;
 	}
+
+	/* Merge with the previous block */
+	if (b->size & __HEAP_PREV_FREE)
+	{
+		n = b;
+		b = __heapBlockPrev(n);
+		__heapRemoveFree(b);
+		b->size += __HEAP_HDR_SIZE + __heapBlockSize(n);
+	}
+
+	/* Merge with the next block */
+	n = __heapBlockNext(b);
+	if (n->size & __HEAP_FREE)
+	{
+		__heapRemoveFree(n);
+		b->size += __HEAP_HDR_SIZE + __heapBlockSize(n);
+	}
+
+	__heapInsertFree(b);
+
+	__systemStart();
 }
 
 /*!
  * \brief Defragment free memory spaces.
  *
- * Call this function to perform a "defrag" on freed memory. Ensures system stability.
- * Call this anytime (better when the system is idling), and possibly with interrupts
- * disabled.
- * @return	Nothing.
+ * Kept for compatibility: free blocks are merged as soon as they are
+ * released by __heapFree(), so there is nothing to do.
+ * @return	Nothing.
  */
 __VOID	__heapDefrag(__VOID)
 {
-	u32		val;
-	u32		rsum = 0;
-	pu32	ptr = __heapPool;
-	pu32	rst = __NULL;
-
-	while (ptr < (__heapPool + (__heapSize / sizeof(u32))))
-	{
-		val = *ptr;
-		if (val & __HEAPFREEFLAG)
-		{
-			rsum += (val & ~__HEAPFREEFLAG);
-			if (rst == __NULL)
-			{
-				rst = ptr;
-			} else
-			{
-				rsum += sizeof(u32);
-				__heapAvail += sizeof(u32);
-			}
-		} else
-		{
-			if (rsum > 0L)
-			{
-				*rst = rsum | __HEAPFREEFLAG;
-				rst = __NULL;
-				rsum = 0;
-			}
-		}
-
-		ptr += (((val & ~__HEAPFREEFLAG) + sizeof(u32)) / sizeof(u32));
-	}
-	if (rsum > 0L) *rst = rsum | __HEAPFREEFLAG;
 }
 
 /*!
  * @brief Walks the heap.
  *
  * This function will walk through the heap and will call the provided __HEAPCALLBACK()
- * function on every block of memory found (free or not).
+ * function on every block of memory found (free or not), in address order.
+ * The callback receives the block header address, the payload size, the free state
+ * and the owner thread (__NULL for free blocks and blocks allocated outside a thread).
  * @param 	func 	A pointer to a __HEAPCALLBACK() function.
- * @param	arg		Optional parameter to pass to the __HEAPCALLBACK() function.
+ * @param	arg		Optional parameter to pass to the __HEAPCALLBACK() function.
  */
 __VOID	__heapWalk(__HEAPCALLBACK *func, __PVOID arg)
 {
-	u32			sz = 0;
-	u32			size;
-	u8			free;
-	__PTHREAD	th;
-	pu32		ptr = __heapPool;
+	__PHEAP_BLOCK b = __heapPool;
 
 	if (func != __NULL)
 	{
-		while (sz < (__heapSize - 4))
+		while (b && b != __heapEnd)
 		{
-			size = *ptr;
-			(size & __HEAPFREEFLAG) ? (free = __TRUE) : (free = __FALSE);
-			size &= ~__HEAPFREEFLAG;
-			th = (__PTHREAD) *(ptr + (size / sizeof(u32)));
-			if ((*func)(ptr,size,free,th,arg) == __FALSE) return;
-			sz += size + (sizeof(u32) * 2);
-			ptr += ((size / sizeof(u32)) + 1);
+			if ((*func)(b, __heapBlockSize(b), (b->size & __HEAP_FREE) ? __TRUE : __FALSE,
+					b->owner, arg) == __FALSE) return;
+			b = __heapBlockNext(b);
 		}
 	}
 }
@@ -38,9 +38,12 @@
   * call __lockOwn() and release the resource with __lockRelease(). Locks will enqueue
   * the threads waiting for a resource (lock) in a priority-ordered queue, so a high-priority
   * thread will be awakened first when the resource is freed.
-  * A timeout value can be passed on __lockOwn() to prevent deadlocks. This is, obviously, not
-  * enough and in some cases priority-inheritance or priority-ceiling algorithms could come handy
-  * (to be implemented).
+  * A timeout value can be passed on __lockOwn() to prevent deadlocks.
+  *
+  * The \c owner word holds the owner thread, and the __LOCK_WAITERS flag once a thread
+  * waits for the lock. While it is clear, owning and releasing is a single exclusive
+  * load/store on that word. Waiting threads use priority inheritance: the owner runs at
+  * the priority of its highest priority waiter (following nested locks) until release.
   *
   * @{
   */
@@ -87,7 +90,7 @@ __PLOCK_LIST	list_root = __NULL;
 	__systemStop();
 
 	/* Alloc and assign */
-	lock = __heapAlloc(sizeof(__LOCK));
+	lock = __heapAllocZero(sizeof(__LOCK));
 	if (!lock)
 	{
 		__systemStart();
@@ -153,6 +156,120 @@ __STATIC u8 __lockWait(__PLOCK lock, u32 wait)
 	return ret;
 }
 
+/*!
+ * @brief Takes a released lock without disabling interrupts.
+ *
+ * Internal use. The owner word is set with an exclusive load/store pair, so
+ * a preemption between both makes the store fail.
+ * @param lock	Pointer to a lock.
+ * @param th	New owner.
+ * @return __TRUE if the lock was taken, __FALSE if it is owned.
+ */
+__STATIC __BOOL __lockTryTake(__PLOCK lock, __PTHREAD th)
+{
+	do
+	{
+		if (__cpuLoadExclusive(&lock->owner))
+		{
+			__cpuClearExclusive();
+			return __FALSE;
+		}
+	} while (__cpuStoreExclusive((u32) th, &lock->owner));
+
+	return __TRUE;
+}
+
+/*!
+ * @brief Updates the lock after a successful acquisition.
+ *
+ * Internal use. Called by the new owner only, so the statistics do not
+ * need a critical section.
+ * @param lock	Pointer to a lock.
+ * @return Nothing.
+ */
+__STATIC __VOID __lockTaken(__PLOCK lock)
+{
+	lock->state = __LOCK_LOCKED;
+	lock->taken = __systemGetTickCount();
+	lock->owns++;
+}
+
+/*!
+ * @brief Computes the priority a thread must run at.
+ *
+ * Internal use, called with interrupts disabled. It is the highest priority
+ * between the thread's own one and the first waiter (the list is ordered by
+ * priority) of each lock it owns with waiters.
+ * @param th	Pointer to a thread.
+ * @return The priority.
+ */
+__STATIC u32 __lockInheritedPriority(__PTHREAD th)
+{
+	u32 prio = th->th_basepriority;
+	__PLOCK lock;
+
+	for (lock = th->th_locks; lock; lock = lock->next)
+	{
+		if (lock->event.ev_threads && lock->event.ev_threads->th_priority < prio)
+		{
+			prio = lock->event.ev_threads->th_priority;
+		}
+	}
+
+	return prio;
+}
+
+/*!
+ * @brief Raises the priority of the lock owner up to the waiter's priority.
+ *
+ * Internal use, called with interrupts disabled. If the owner is waiting
+ * for another lock, the owner of that lock is raised too, and so on.
+ * @param lock	Pointer to a lock.
+ * @param prio	Priority of the waiting thread.
+ * @return Nothing.
+ */
+__STATIC __VOID __lockInherit(__PLOCK lock, u32 prio)
+{
+	__PTHREAD owner;
+	u8 depth;
+
+	for (depth = 0; lock && depth < __LOCK_MAX_NESTING; depth++)
+	{
+		owner = __lockGetOwner(lock);
+		if (!owner || owner->th_priority <= prio) return;
+
+		__threadSetPriority(owner, prio);
+		lock = owner->th_lockwait;
+	}
+}
+
+/*!
+ * @brief Removes a lock from the list of locks with waiters of its owner.
+ *
+ * Internal use, called with interrupts disabled. The owner gets back the
+ * priority inherited from the locks it still owns.
+ * @param lock	Pointer to a lock.
+ * @param owner	Owner of the lock.
+ * @return Nothing.
+ */
+__STATIC __VOID __lockUnlink(__PLOCK lock, __PTHREAD owner)
+{
+	__PLOCK* link;
+
+	for (link = (__PLOCK*) &owner->th_locks; *link; link = (__PLOCK*) &(*link)->next)
+	{
+		if (*link == lock)
+		{
+			*link = lock->next;
+			break;
+		}
+	}
+
+	lock->next = __NULL;
+
+	__threadSetPriority(owner, __lockInheritedPriority(owner));
+}
+
 /*!
  * @brief Claims a lock. If it is not released, it will put the calling thread
  * into waiting state.
@@ -160,25 +277,45 @@ __STATIC u8 __lockWait(__PLOCK lock, u32 wait)
  * Call this function to claim a lock. If it is not released it will put the
  * calling thread into waiting state until released or the time elapses.
  * The thread will be added to the lock's priority list and waked up in order
- * of arrival. See the __lockAddToPriorityList() function.
+ * of priority.
+ *
+ * A released lock is taken with a single exclusive store, without disabling
+ * interrupts or the scheduler. Otherwise the owner inherits the priority of
+ * the calling thread until it releases the lock.
  * @param	lock	Pointer to a lock.
  * @param	wait	Time to wait in milliseconds.
  * @return	__TRUE on success claiming the lock, __FALSE otherwise.
  */
 __BOOL	__lockOwn(__PLOCK lock, u32 wait)
 {
+	__PTHREAD th = __threadGetCurrent();
+	__PTHREAD owner;
 	u32 time = 0;
 
-	__systemStop();
+	if (!lock) return __FALSE;
+
+	/* Not called from a thread (scheduler not started): nothing to
+	 * exclude, succeed if no thread owns the lock.
+	 */
+	if (!th) return (__lockGetOwner(lock) == __NULL);
 
 	/* Check if __lockOwn is not being called from an already
-	 * "owner" thread.
+	 * "owner" thread.
 	 */
-	if (lock->state == __LOCK_LOCKED && lock->owner == __threadGetCurrent()) {
-		__systemStart();
+	if (__lockGetOwner(lock) == th) return __TRUE;
+
+	if (__lockTryTake(lock, th))
+	{
+		__lockTaken(lock);
 		return __TRUE;
 	}
 
+	if (!wait) return __FALSE;
+
+	__systemStop();
+
+	lock->contended++;
+
 	/* Here, in the case of a failed lock wait, we will
 	 * reuse the time left to wait again.
 	 * For example can happen that:
@@ -193,25 +330,61 @@ __BOOL	__lockOwn(__PLOCK lock, u32 wait)
 	 * 		and goes suspended.
 	 * 5-	Thread2, waked up and ready to run by the __lockRelease() call (from Thread1)
 	 * 		tries to own the lock, but it founds it locked.
-	 *
+	 *
 	 */
 	time = wait;
-	while (lock->state != __LOCK_RELEASED && time)
+	for (;;)
 	{
+		owner = __lockGetOwner(lock);
+		if (!owner)
+		{
+			/* Released. If other threads are still waiting, keep the
+			 * waiters flag so the release takes the slow path and
+			 * wakes the next one.
+			 */
+			if (lock->event.ev_threads)
+			{
+				lock->owner = (__PTHREAD) ((u32) th | __LOCK_WAITERS);
+				lock->next = th->th_locks;
+				th->th_locks = lock;
+				__threadSetPriority(th, __lockInheritedPriority(th));
+			} else
+			{
+				lock->owner = th;
+			}
+			break;
+		}
+
+		if (!time) break;
+
+		/* Mark the lock, so the owner can't release it without waking us */
+		if (!((u32) lock->owner & __LOCK_WAITERS))
+		{
+			lock->owner = (__PTHREAD) ((u32) owner | __LOCK_WAITERS);
+			lock->next = owner->th_locks;
+			owner->th_locks = lock;
+		}
+
+		__lockInherit(lock, th->th_priority);
+
+		th->th_lockwait = lock;
 		__lockWait(lock, time);
-		time = __threadGetCurrent()->th_wait;
-	}
+		th->th_lockwait = __NULL;
 
-	if (lock->state != __LOCK_RELEASED)
-	{
-		__systemStart();
-		return __FALSE;
-	}
+		time = th->th_wait;
 
-	lock->state = __LOCK_LOCKED;
-	lock->owner	= __threadGetCurrent();
+		/* On timeout the owner may be running at our priority */
+		if (!time && (owner = __lockGetOwner(lock)) != __NULL)
+		{
+			__threadSetPriority(owner, __lockInheritedPriority(owner));
+		}
+	}
 
 	__systemStart();
+
+	if (__lockGetOwner(lock) != th) return __FALSE;
+
+	__lockTaken(lock);
 	return __TRUE;
 }
 
@@ -219,18 +392,46 @@ __BOOL	__lockOwn(__PLOCK lock, u32 wait)
  * @brief Releases a lock.
  *
  * Call this function to release a previously locked event. It will wake up
- * the first thread in the lock's priority list.
+ * the first thread in the lock's priority list, and restore the priority
+ * of the owner.
+ * If no thread is waiting, the lock is released with a single exclusive
+ * store, without disabling interrupts or the scheduler.
  * @param	lock	Pointer to a lock.
- * @return	__TRUE on success, otherwise __FALSE.
+ * @return	__TRUE on success, otherwise __FALSE.
  */
 __BOOL	__lockRelease(__PLOCK lock)
 {
+	__PTHREAD owner;
+	u32 hold;
+
 	if (!lock) return __FALSE;
 
-	__systemStop();
+	owner = __lockGetOwner(lock);
+	if (!owner) return __TRUE;
+
+	hold = __systemGetTickCount() - lock->taken;
+	lock->hold_total += hold;
+	if (hold > lock->hold_max) lock->hold_max = hold;
 	lock->state = __LOCK_RELEASED;
+
+	do
+	{
+		if (__cpuLoadExclusive(&lock->owner) != (u32) owner)
+		{
+			/* Waiters flag set */
+			__cpuClearExclusive();
+			break;
+		}
+
+		if (!__cpuStoreExclusive(0, &lock->owner)) return __TRUE;
+
+	} while (__TRUE);
+
+	__systemStop();
+
 	lock->owner = __NULL;
-	
+	__lockUnlink(lock, owner);
+
 	/* wake threads waiting for this lock */
 	__eventSetOne(&lock->event);
 	__systemStart();
@@ -242,7 +443,8 @@ __BOOL	__lockRelease(__PLOCK lock)
  * @brief Destroys a lock.
  *
  * Call this function to destroy a lock created with the __lockCreate()
- * function. It will be removed from the __lockList list.
+ * function. It will be removed from the __lockList list, and from the locks
+ * of its owner, which drops the priority inherited through it.
  * @param	lock	Pointer to a lock.
  * @return	Nothing.
  */
@@ -259,6 +461,8 @@ __PLOCK_LIST root_list 	= __NULL;
 	{
 		if (list->lock == lock)
 		{
+			if ((u32) lock->owner & __LOCK_WAITERS) __lockUnlink(lock, __lockGetOwner(lock));
+
 			__heapFree(lock);
 
 			if (__lockList == list)
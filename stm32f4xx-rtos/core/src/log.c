@@ -0,0 +1,370 @@
+/***************************************************************************
+ * log.c
+ * (C) 2010 Ivan Meleca
+ * Based on original code written by Ruben Meleca
+ * www.milos.it
+
+#   This program is free software; you can redistribute it and/or modify
+#   it under the terms of the GNU General Public License as published by
+#   the Free Software Foundation; either version 2 of the License, or
+#   (at your option) any later version.
+#
+#   This program is distributed in the hope that it will be useful,
+#   but WITHOUT ANY WARRANTY; without even the implied warranty of
+#   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#   GNU General Public License for more details.
+#
+#   You should have received a copy of the GNU General Public License
+#   along with this program; if not, write to the Free Software
+#   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+***************************************************************************/
+
+#include "log.h"
+#include "system.h"
+#include "dbgterm.h"
+#include <common/inc/mem.h>
+
+#if __CONFIG_LOG
+
+/** @addtogroup Core
+  * @{
+  */
+
+/** @defgroup Log Binary log
+  * @brief Logging with deferred formatting.
+  *
+  * __LOG() and its shortcuts LOGE(), LOGW(), LOGI() and LOGD() store a record in
+  * a RAM ring of __CONFIG_LOG_WORDS words: a header with the module, the level
+  * and the offset of the format string, a timestamp (__cpuGetCycles()) and the
+  * arguments. Nothing is formatted by the caller, which only reserves the words
+  * with an exclusive access and copies them: no lock is taken and interrupts
+  * stay enabled, so interrupt handlers can log too.
+  *
+  * Records are formatted later, either:
+  *
+  * - by the log thread (__CONFIG_LOG_THREAD), at a low priority, on the debug
+  *   terminal;
+  * - or on the host, by tools/logdecode reading a __logSnapshot() image.
+  *
+  * Each module has a level (__logSetLevel(), "log level" terminal command):
+  * records above it cost a compare. A record that does not fit in the ring is
+  * dropped and counted in the drop counter of its module.
+  *
+  * Timestamps are 32 bits wide: gaps longer than the counter wrap time (about
+  * 25 s at 168 MHz) are shown shorter.
+  *
+  * @{
+  */
+
+/** @defgroup Log_PrivateMacros Private macros
+  * @{
+  */
+
+/*! @brief Ring index mask */
+#define __LOG_MASK			(__CONFIG_LOG_WORDS - 1)
+
+#if (__CONFIG_LOG_WORDS & __LOG_MASK)
+#error "__CONFIG_LOG_WORDS must be a power of two"
+#endif
+
+/**
+  * @}
+  */
+
+/** @defgroup Log_PrivateVariables Private variables
+  * @{
+  */
+
+u8 __logLevels[__CONFIG_LOG_MODULES];						/*!< @brief Level of each module, read by __LOG() */
+
+__STATIC __VOLATILE u32 __logRing[__CONFIG_LOG_WORDS];		/*!< @brief Records ring, free words are zero */
+__STATIC __VOLATILE u32 __logHead = 0;						/*!< @brief Words reserved, wraps */
+__STATIC __VOLATILE u32 __logTail = 0;						/*!< @brief Words read, wraps */
+__STATIC __VOLATILE u32 __logDrops[__CONFIG_LOG_MODULES];	/*!< @brief Records dropped, by module */
+__STATIC __VOLATILE u32 __logDropsTotal = 0;				/*!< @brief Records dropped */
+
+#if __CONFIG_LOG_THREAD && __CONFIG_DBGTERM_ENABLED
+__STATIC __PTHREAD __logThreadPtr = __NULL;					/*!< @brief Log thread */
+__STATIC u32 __logLastStamp = 0;							/*!< @brief Timestamp of the last record shown */
+__STATIC u64 __logTime = 0;									/*!< @brief __logLastStamp, without wrapping */
+#endif /* __CONFIG_LOG_THREAD && __CONFIG_DBGTERM_ENABLED */
+
+/**
+  * @}
+  */
+
+/** @defgroup Log_Functions Functions
+  * @{
+  */
+
+/*!
+ * @brief Increments a counter, from threads and interrupts.
+ *
+ * @param	val		Counter.
+ * @return Nothing.
+ */
+__STATIC __VOID __logAtomicInc(__VOLATILE u32* val)
+{
+	u32 n;
+
+	do
+	{
+		n = __cpuLoadExclusive(val) + 1;
+	} while (__cpuStoreExclusive(n, val));
+}
+
+/*!
+ * @brief Sets every module to __CONFIG_LOG_LEVEL and starts the timestamp counter.
+ *
+ * Called from __systemInit().
+ *
+ * @return Nothing.
+ */
+__VOID __logInit(__VOID)
+{
+	__memSet(__logLevels, __CONFIG_LOG_LEVEL, sizeof(__logLevels));
+	__cpuInitCycleCounter();
+
+	/* Also the format string that makes sure the "milos_log" section exists */
+	LOGI(__LOG_MOD_CORE, "log: %lu words, %lu modules", __CONFIG_LOG_WORDS, __CONFIG_LOG_MODULES);
+}
+
+/*!
+ * @brief Stores a record, see __LOG().
+ *
+ * @param	hdr		Record header, without the format string ID and the arguments count.
+ * @param	fmt		Format string, in the "milos_log" section.
+ * @param	args	Arguments.
+ * @param	nargs	Arguments count, up to __LOG_MAX_ARGS (the next are ignored).
+ * @return Nothing.
+ */
+__VOID __logWrite(u32 hdr, __CONST char* fmt, __CONST u32* args, u32 nargs)
+{
+	u32 module = __LOG_HDR_MODULE(hdr);
+	u32 head, words, i;
+
+	if (module >= __CONFIG_LOG_MODULES) return;
+	if (nargs > __LOG_MAX_ARGS) nargs = __LOG_MAX_ARGS;
+	words = nargs + 2;
+
+	/* A writer that preempts this one makes the store fail, and reserves the next words */
+	do
+	{
+		head = __cpuLoadExclusive(&__logHead);
+		if (head + words - __logTail > __CONFIG_LOG_WORDS)
+		{
+			__cpuClearExclusive();
+			__logAtomicInc(&__logDrops[module]);
+			__logAtomicInc(&__logDropsTotal);
+			return;
+		}
+	} while (__cpuStoreExclusive(head + words, &__logHead));
+
+	__logRing[(head + 1) & __LOG_MASK] = __cpuGetCycles();
+	for (i = 0; i < nargs; i++) __logRing[(head + 2 + i) & __LOG_MASK] = args[i];
+
+	/* The header last, the reader takes the record when it is nonzero */
+	__cpuMemoryBarrier();
+	__logRing[head & __LOG_MASK] = hdr | ((u32) (fmt - __start_milos_log) << 16) | nargs;
+}
+
+/*!
+ * @brief Takes the oldest record out of the ring.
+ *
+ * Only one reader at a time: with the log thread running, only the log thread.
+ *
+ * @param	buf		Destination, at least __LOG_MAX_ARGS + 2 words: header,
+ * 					timestamp and arguments.
+ * @param	len		Words available in \c buf.
+ * @return	The record words, zero if the ring is empty, the oldest record is still
+ * 			being written or \c buf is too small.
+ */
+u32 __logRead(pu32 buf, u32 len)
+{
+	u32 tail = __logTail;
+	u32 hdr, words, i;
+
+	if (tail == __logHead) return 0;
+
+	hdr = __logRing[tail & __LOG_MASK];
+	words = __LOG_HDR_WORDS(hdr);
+	if (!hdr || words > len) return 0;
+
+	__cpuMemoryBarrier();
+
+	/* The words are cleared before being released to the writers */
+	for (i = 0; i < words; i++)
+	{
+		buf[i] = __logRing[(tail + i) & __LOG_MASK];
+		__logRing[(tail + i) & __LOG_MASK] = 0;
+	}
+
+	__cpuMemoryBarrier();
+	__logTail = tail + words;
+
+	return words;
+}
+
+/*!
+ * @brief Sets the level of a module.
+ *
+ * @param	module	Module, less than __CONFIG_LOG_MODULES.
+ * @param	level	Most verbose level stored, __LOG_OFF for none.
+ * @return Nothing.
+ */
+__VOID __logSetLevel(u32 module, u32 level)
+{
+	if (module < __CONFIG_LOG_MODULES) __logLevels[module] = (u8) level;
+}
+
+/*!
+ * @brief Reads the drop counter of a module.
+ *
+ * @param	module	Module, or __CONFIG_LOG_MODULES for all of them.
+ * @return	The records dropped because the ring was full.
+ */
+u32 __logGetDrops(u32 module)
+{
+	return (module < __CONFIG_LOG_MODULES) ? __logDrops[module] : __logDropsTotal;
+}
+
+/*!
+ * @brief Words of the ring in use.
+ *
+ * @return The words reserved and not read yet.
+ */
+u32 __logGetUsed(__VOID)
+{
+	return __logHead - __logTail;
+}
+
+/*!
+ * @brief Copies the records not read yet, in binary format, for tools/logdecode.
+ *
+ * The snapshot is a __LOG_HEADER, the drop counter of each module, the format
+ * strings and the complete records from the oldest one. It is taken with
+ * interrupts disabled, the records stay in the ring.
+ *
+ * @param	buf		Destination buffer, word aligned.
+ * @param	len		Length of \c buf.
+ * @return	The snapshot length, or zero if \c buf is too small.
+ */
+u32 __logSnapshot(__PVOID buf, u32 len)
+{
+	__PLOG_HEADER lh = buf;
+	u32 fmtlen = (u32) (__stop_milos_log - __start_milos_log);
+	pu32 dst;
+	u32 tail, hdr, i;
+
+	lh->lh_fmtlen = (fmtlen + 3) & ~3;
+	if (len < sizeof(__LOG_HEADER) + __CONFIG_LOG_MODULES * sizeof(u32) + lh->lh_fmtlen) return 0;
+	len -= sizeof(__LOG_HEADER) + __CONFIG_LOG_MODULES * sizeof(u32) + lh->lh_fmtlen;
+
+	lh->lh_magic = __LOG_MAGIC;
+	lh->lh_hz = __cpuGetCyclesPerSecond();
+	lh->lh_modules = __CONFIG_LOG_MODULES;
+	lh->lh_words = 0;
+
+	dst = (pu32) (lh + 1) + __CONFIG_LOG_MODULES;
+	__memSet((pu8) dst + fmtlen, 0, lh->lh_fmtlen - fmtlen);
+	__memCpy(dst, __start_milos_log, fmtlen);
+	dst += lh->lh_fmtlen / sizeof(u32);
+
+	__systemStop();
+
+	lh->lh_drops = __logDropsTotal;
+	for (i = 0; i < __CONFIG_LOG_MODULES; i++) ((pu32) (lh + 1))[i] = __logDrops[i];
+
+	for (tail = __logTail; tail != __logHead; tail += __LOG_HDR_WORDS(hdr))
+	{
+		hdr = __logRing[tail & __LOG_MASK];
+		if (!hdr || (lh->lh_words + __LOG_HDR_WORDS(hdr)) * sizeof(u32) > len) break;
+
+		for (i = 0; i < __LOG_HDR_WORDS(hdr); i++)
+			*dst++ = __logRing[(tail + i) & __LOG_MASK];
+
+		lh->lh_words += __LOG_HDR_WORDS(hdr);
+	}
+
+	__systemStart();
+
+	return sizeof(__LOG_HEADER) + (__CONFIG_LOG_MODULES + lh->lh_words) * sizeof(u32) + lh->lh_fmtlen;
+}
+
+#if __CONFIG_LOG_THREAD && __CONFIG_DBGTERM_ENABLED
+
+/*!
+ * @brief Formats a record on the debug terminal.
+ *
+ * @param	term	Debug terminal.
+ * @param	rec		Record read by __logRead().
+ * @return Nothing.
+ */
+__STATIC __VOID __logPrint(__PTERMINAL term, pu32 rec)
+{
+	__STATIC __CONST char levels[] = "-EWID???";
+	u32 hz = __cpuGetCyclesPerSecond();
+
+	__logTime += rec[1] - __logLastStamp;
+	__logLastStamp = rec[1];
+
+	__terminalWrite(term, "[%5lu.%06lu] %c %lu: ",
+					(u32) (__logTime / hz),
+					(u32) ((__logTime % hz) * 1000000 / hz),
+					levels[__LOG_HDR_LEVEL(rec[0])], __LOG_HDR_MODULE(rec[0]));
+	__terminalOut(term, __TRUE, (__PSTRING) (__start_milos_log + __LOG_HDR_ID(rec[0])), (__PSTRING) &rec[2]);
+}
+
+/*!
+ * @brief Log thread: formats the records on the debug terminal.
+ *
+ * @return Nothing.
+ */
+__STATIC __VOID __logThread(__VOID)
+{
+	u32 rec[__LOG_MAX_ARGS + 2];
+	__PTERMINAL term;
+
+	__logLastStamp = __cpuGetCycles();
+
+	for (;;)
+	{
+		term = __dbgGetSysTermPtr();
+
+		while (__logRead(rec, __LOG_MAX_ARGS + 2))
+			if (term) __logPrint(term, rec);
+
+		__threadSleep(__CONFIG_LOG_FLUSH_TIME);
+	}
+}
+
+#endif /* __CONFIG_LOG_THREAD && __CONFIG_DBGTERM_ENABLED */
+
+/*!
+ * @brief Creates the log thread, if __CONFIG_LOG_THREAD is set.
+ *
+ * Called from the system thread, after the debug terminal is started.
+ *
+ * @return Nothing.
+ */
+__VOID __logStart(__VOID)
+{
+#if __CONFIG_LOG_THREAD && __CONFIG_DBGTERM_ENABLED
+	if (!__logThreadPtr)
+	{
+		__logThreadPtr = __threadCreate("log", __logThread, __CONFIG_PRIO_LOGTHREAD,
+										__CONFIG_STACK_LOGTHREAD, 1, __NULL);
+	}
+#endif /* __CONFIG_LOG_THREAD && __CONFIG_DBGTERM_ENABLED */
+}
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+#endif /* __CONFIG_LOG */
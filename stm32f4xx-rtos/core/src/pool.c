@@ -0,0 +1,339 @@
+/***************************************************************************
+ * pool.c
+ * (C) 2010 Ivan Meleca
+ * Based on original code written by Ruben Meleca
+ * www.milos.it
+
+#   This program is free software; you can redistribute it and/or modify
+#   it under the terms of the GNU General Public License as published by
+#   the Free Software Foundation; either version 2 of the License, or
+#   (at your option) any later version.
+#
+#   This program is distributed in the hope that it will be useful,
+#   but WITHOUT ANY WARRANTY; without even the implied warranty of
+#   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#   GNU General Public License for more details.
+#
+#   You should have received a copy of the GNU General Public License
+#   along with this program; if not, write to the Free Software
+#   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+***************************************************************************/
+
+#include "pool.h"
+#include "system.h"
+#include "heap.h"
+#include <plat_cpu.h>
+
+#if __CONFIG_COMPILE_POOL
+
+/** @addtogroup Core
+  * @{
+  */
+
+/** @defgroup Pool Pool
+  * @brief Fixed-size block pools.
+  *
+  * A pool is a set of blocks of the same size, stored in a static area or in a
+  * single heap allocation. Free blocks are kept in a singly linked stack whose
+  * link lives in the first word of each free block.
+  *
+  * __poolAlloc() and __poolFree() never disable interrupts nor the scheduler:
+  * the stack head is updated with exclusive load/store, retried if the
+  * exclusive monitor was lost. The monitor is cleared on every exception entry
+  * and return, so a preemption between the load of the head and the store of
+  * the new one makes the store fail, and the usual ABA problem of lock-free
+  * stacks cannot happen. Both functions can be called from interrupts.
+  *
+  * @{
+  */
+
+/** @defgroup Pool_PrivateConstants Private constants
+  * @{
+  */
+
+#define __POOL_READY	0x80	/*!< @brief Pool ready flag */
+
+/**
+  * @}
+  */
+
+/** @defgroup Pool_PrivateMacros Private macros
+  * @{
+  */
+
+#define __poolReady(x)	(x && (x->type & __POOL_READY ? __TRUE : __FALSE))	/*!< @brief Checks if the pool is ready */
+
+/**
+  * @}
+  */
+
+/** @defgroup Pool_PrivateVariables Private variables
+  * @{
+  */
+
+__STATIC __PPOOL __poolList = __NULL;	/*!< @brief Created pools */
+
+/**
+  * @}
+  */
+
+/** @defgroup Pool_Functions Functions
+  * @{
+  */
+
+/*!
+ * @brief Atomically adds a value to a counter.
+ *
+ * Internal use.
+ * @param	val		Pointer to the counter.
+ * @param	inc		Value to add (can be negative).
+ * @return	The new value of the counter.
+ */
+__STATIC u32 __poolAtomicAdd(__VOLATILE u32* val, i32 inc)
+{
+	u32 ret;
+
+	do
+	{
+		ret = __cpuLoadExclusive(val) + inc;
+	} while (__cpuStoreExclusive(ret, val));
+
+	return ret;
+}
+
+/*!
+ * @brief Creates and prepares a pool structure.
+ *
+ * Call this function before calling any other pool functions.
+ * The block size is rounded up to a multiple of the pointer size, and can't
+ * be smaller than a pointer.
+ *
+ * @param	type		Pool type.
+ * @arg __POOL_STATIC	The user provides the area to store the blocks. Use
+ * 						__POOL_AREA_SIZE() to know the required size.
+ * @arg __POOL_ALLOC	The blocks are allocated at once with __heapAlloc().
+ * @param	pool		Pointer to the pool structure to be initialized.
+ * @param	block_size	Size of each block.
+ * @param	block_qty	Quantity of blocks.
+ * @param	ptr			Pointer to the blocks area (__POOL_STATIC only), word aligned.
+ * @param	ptr_size	Length of \c ptr area (__POOL_STATIC only).
+ *
+ * @return __TRUE on success, otherwise __FALSE.
+ */
+__BOOL __poolCreate(u8 type, __PPOOL pool, u32 block_size, u32 block_qty, __PVOID ptr, u32 ptr_size)
+{
+	__PVOID* blk;
+	u32 i;
+
+	if (!pool || !block_size || !block_qty) return __FALSE;
+	if (pool->type & __POOL_READY) return __FALSE;
+
+	block_size = __POOL_AREA_SIZE(block_size, 1);
+
+	if (type & __POOL_ALLOC)
+	{
+		if ((ptr = __heapAlloc(block_size * block_qty)) == __NULL) return __FALSE;
+	} else {
+		if (!ptr || ((u32) ptr & (sizeof(__PVOID) - 1))) return __FALSE;
+		if (ptr_size < block_size * block_qty) return __FALSE;
+	}
+
+	pool->ref = ptr;
+	pool->block_size = block_size;
+	pool->block_qty = block_qty;
+	pool->avail = pool->min_avail = block_qty;
+	pool->allocs = pool->fails = pool->waiting = 0;
+	pool->event.ev_state = __EV_RESET;
+	pool->event.ev_threads = __NULL;
+	pool->event.ev_links = __NULL;
+
+	/* Chain all the blocks, lower addresses first */
+	blk = ptr;
+	for (i = 1; i < block_qty; i++)
+	{
+		*blk = (u8*) blk + block_size;
+		blk = *blk;
+	}
+
+	*blk = __NULL;
+	pool->free = ptr;
+	pool->type = type | __POOL_READY;
+
+	__systemStop();
+	pool->next = __poolList;
+	__poolList = pool;
+	__systemStart();
+
+	return __TRUE;
+}
+
+/*!
+ * @brief Destroys a pool.
+ *
+ * Threads waiting for a block are woken up with a __NULL result.
+ * The blocks area is freed if the pool is of type __POOL_ALLOC.
+ * Blocks still in use must not be accessed after calling this function.
+ *
+ * @param	pool	Pointer to the pool.
+ * @return Nothing.
+ */
+__VOID __poolDestroy(__PPOOL pool)
+{
+	__PPOOL* link;
+
+	if (!__poolReady(pool)) return;
+
+	__systemStop();
+
+	for (link = &__poolList; *link; link = &(*link)->next)
+	{
+		if (*link == pool)
+		{
+			*link = pool->next;
+			break;
+		}
+	}
+
+	pool->type &= ~__POOL_READY;
+	pool->free = __NULL;
+
+	__systemStart();
+
+	__eventAbort(&pool->event);
+
+	if (pool->type & __POOL_ALLOC) __heapFree(pool->ref);
+	pool->ref = __NULL;
+}
+
+/*!
+ * @brief Gets a block from the pool.
+ *
+ * Never blocks, can be called from interrupts.
+ *
+ * @param	pool	Pointer to the pool.
+ * @return	Pointer to the block, or __NULL if the pool is empty.
+ */
+__PVOID __poolAlloc(__PPOOL pool)
+{
+	__PVOID* blk;
+	u32 avail;
+
+	if (!__poolReady(pool)) return __NULL;
+
+	do
+	{
+		blk = (__PVOID*) __cpuLoadExclusive(&pool->free);
+		if (!blk)
+		{
+			__cpuClearExclusive();
+			__poolAtomicAdd(&pool->fails, 1);
+			return __NULL;
+		}
+	} while (__cpuStoreExclusive((u32) *blk, &pool->free));
+
+	avail = __poolAtomicAdd(&pool->avail, -1);
+	__poolAtomicAdd(&pool->allocs, 1);
+
+	/* Low water mark */
+	do
+	{
+		if (__cpuLoadExclusive(&pool->min_avail) <= avail)
+		{
+			__cpuClearExclusive();
+			break;
+		}
+	} while (__cpuStoreExclusive(avail, &pool->min_avail));
+
+	return blk;
+}
+
+/*!
+ * @brief Gets a block from the pool, waiting for one if it is empty.
+ *
+ * Call this function from a thread only. A thread woken up by __poolFree()
+ * can find the pool empty again if an interrupt took the block first, then
+ * it waits again with the full \c timeout.
+ *
+ * @param	pool	Pointer to the pool.
+ * @param	timeout	Maximum time to wait in milliseconds. Zero for infinite.
+ * @return	Pointer to the block, or __NULL on timeout.
+ */
+__PVOID __poolAllocWait(__PPOOL pool, u32 timeout)
+{
+	__PVOID ptr;
+
+	if ((ptr = __poolAlloc(pool)) != __NULL) return ptr;
+	if (!__poolReady(pool)) return __NULL;
+
+	/* Counted before trying again, so a block freed from now on signals the event */
+	__poolAtomicAdd(&pool->waiting, 1);
+
+	for (;;)
+	{
+		__eventReset(&pool->event);
+		if ((ptr = __poolAlloc(pool)) != __NULL) break;
+
+		if (__eventWait(&pool->event, timeout) != __EVRET_SUCCESS) break;
+	}
+
+	__poolAtomicAdd(&pool->waiting, -1);
+	return ptr;
+}
+
+/*!
+ * @brief Returns a block to the pool.
+ *
+ * Can be called from interrupts. Wakes up a thread waiting in __poolAllocWait(), if any.
+ * Freeing the same block twice is not detected and corrupts the pool.
+ *
+ * @param	pool	Pointer to the pool.
+ * @param	ptr		Block returned by __poolAlloc() or __poolAllocWait().
+ * @return	__TRUE on success, __FALSE if the block does not belong to the pool.
+ */
+__BOOL __poolFree(__PPOOL pool, __PVOID ptr)
+{
+	__PVOID* blk = ptr;
+	u32 offset;
+
+	if (!__poolReady(pool)) return __FALSE;
+
+	offset = (u8*) ptr - (u8*) pool->ref;
+	if ((u8*) ptr < (u8*) pool->ref || offset >= pool->block_size * pool->block_qty ||
+		offset % pool->block_size) return __FALSE;
+
+	do
+	{
+		*blk = (__PVOID) __cpuLoadExclusive(&pool->free);
+	} while (__cpuStoreExclusive((u32) blk, &pool->free));
+
+	__poolAtomicAdd(&pool->avail, 1);
+
+	if (pool->waiting) __eventSetOne(&pool->event);
+
+	return __TRUE;
+}
+
+/*!
+ * @brief Returns the list of created pools.
+ *
+ * @return	The first pool. The list can be explored following the \c next member.
+ */
+__PPOOL __poolGetList(__VOID)
+{
+	return __poolList;
+}
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+#endif /* __CONFIG_COMPILE_POOL */
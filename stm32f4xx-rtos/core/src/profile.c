@@ -0,0 +1,422 @@
+/***************************************************************************
+ * profile.c
+ * (C) 2010 Ivan Meleca
+ * Based on original code written by Ruben Meleca
+ * www.milos.it
+
+#   This program is free software; you can redistribute it and/or modify
+#   it under the terms of the GNU General Public License as published by
+#   the Free Software Foundation; either version 2 of the License, or
+#   (at your option) any later version.
+#
+#   This program is distributed in the hope that it will be useful,
+#   but WITHOUT ANY WARRANTY; without even the implied warranty of
+#   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#   GNU General Public License for more details.
+#
+#   You should have received a copy of the GNU General Public License
+#   along with this program; if not, write to the Free Software
+#   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+***************************************************************************/
+
+#include "profile.h"
+#include "system.h"
+
+#if __CONFIG_PROFILER
+
+/** @addtogroup Core
+  * @{
+  */
+
+/** @defgroup Profiler Profiler
+  * @brief CPU usage and latency measurements.
+  *
+  * Every measure is taken from the CPU cycle counter (__cpuGetCycles(), the DWT
+  * cycle counter on Cortex-M4):
+  *
+  * - Cycles of each thread, accounted on each context switch and on each system
+  *   tick, minus the cycles spent in interrupts meanwhile. Cycles with no thread
+  *   running are accounted as idle.
+  * - Context switches of each thread, and how many of them happened while the
+  *   thread was still ready (preemption or time slice end).
+  * - Cycles in interrupts that call __systemEnterISR()/__systemLeaveISR().
+  * - Longest time with interrupts disabled by __systemStop(), for each call site
+  *   of the outermost __systemStop() (its return address). Up to
+  *   __CONFIG_PROFILER_SITES sites are tracked, the later ones are ignored.
+  *
+  * The counter is 32 bits wide, so no interval between two accounts can be longer
+  * than its wrap time (about 25 s at 168 MHz). The "prof" debug terminal command
+  * shows the values, __profSnapshot() copies them in a binary format for a host tool.
+  *
+  * @{
+  */
+
+/** @defgroup Profiler_PrivateMacros Private macros
+  * @{
+  */
+
+/*!
+ * @brief Disables interrupts without passing through __systemStop(), which is measured.
+ */
+#define __profLock()		__cpuDisableInterrupts()
+
+/*!
+ * @brief Enables interrupts again, unless __systemStop() disabled them.
+ */
+#define __profUnlock()		if (!__systemGetIrqCount()) __cpuEnableInterrupts()
+
+/**
+  * @}
+  */
+
+/** @defgroup Profiler_PrivateVariables Private variables
+  * @{
+  */
+
+__STATIC __PROF_SITE __profSites[__CONFIG_PROFILER_SITES];	/*!< @brief Critical section sites */
+__STATIC u32 __profCsStart = 0;			/*!< @brief Cycle count at the outermost __systemStop() */
+__STATIC u32 __profCsSite = 0;			/*!< @brief Call site of the outermost __systemStop() */
+
+__STATIC u32 __profIsrNesting = 0;		/*!< @brief Interrupts nesting */
+__STATIC u32 __profIsrStart = 0;		/*!< @brief Cycle count at the outermost interrupt entry */
+__STATIC u64 __profIsr = 0;				/*!< @brief Cycles in interrupts */
+__STATIC u32 __profIsrCount = 0;		/*!< @brief Interrupts served */
+__STATIC u32 __profIsrMax = 0;			/*!< @brief Longest interrupt */
+
+__STATIC __PTHREAD __profRunning = __NULL;	/*!< @brief Thread being accounted, __NULL while idle */
+__STATIC u32 __profRunStart = 0;		/*!< @brief Cycle count at the last account */
+__STATIC u64 __profIsrMark = 0;			/*!< @brief __profIsr at the last account */
+__STATIC u64 __profIdle = 0;			/*!< @brief Cycles with no thread running */
+__STATIC u32 __profSwitches = 0;		/*!< @brief Context switches */
+
+/**
+  * @}
+  */
+
+/** @defgroup Profiler_Functions Functions
+  * @{
+  */
+
+/*!
+ * @brief Credits the cycles since the last account to the running thread (or idle).
+ *
+ * Internal use, called with interrupts disabled.
+ *
+ * @param	now		Current cycle count.
+ * @return Nothing.
+ */
+__STATIC __VOID __profAccount(u32 now)
+{
+	u64 isr = __profIsr;
+	u32 run;
+
+	/* Part of the running interrupt, the rest is added when it ends */
+	if (__profIsrNesting) isr += now - __profIsrStart;
+
+	run = (now - __profRunStart) - (u32) (isr - __profIsrMark);
+
+	if (__profRunning)
+	{
+		__profRunning->th_cycles += run;
+	} else {
+		__profIdle += run;
+	}
+
+	__profRunStart = now;
+	__profIsrMark = isr;
+}
+
+/*!
+ * @brief Starts the cycle counter and clears the measures.
+ *
+ * Called from __systemInit().
+ *
+ * @return Nothing.
+ */
+__VOID __profInit(__VOID)
+{
+	__cpuInitCycleCounter();
+	__profReset();
+}
+
+/*!
+ * @brief Clears every measure.
+ *
+ * @return Nothing.
+ */
+__VOID __profReset(__VOID)
+{
+	__PTHREAD th;
+	u32 i;
+
+	__profLock();
+
+	for (th = __threadGetChain(); th; th = th->th_lstnext)
+	{
+		th->th_cycles = 0;
+		th->th_switches = th->th_preempts = 0;
+	}
+
+	for (i = 0; i < __CONFIG_PROFILER_SITES; i++)
+	{
+		__profSites[i].ps_site = __profSites[i].ps_max = __profSites[i].ps_count = 0;
+	}
+
+	__profIsr = __profIsrMark = __profIdle = 0;
+	__profIsrCount = __profIsrMax = __profSwitches = 0;
+	__profRunStart = __cpuGetCycles();
+
+	/* The running interrupt (if any) is counted from now */
+	if (__profIsrNesting) __profIsrStart = __profRunStart;
+
+	__profUnlock();
+}
+
+/*!
+ * @brief Accounts a context switch. Called from __threadChange().
+ *
+ * @param	next	Thread to run, __NULL if going idle.
+ * @return Nothing.
+ */
+__VOID __profSwitch(__PTHREAD next)
+{
+	__profAccount(__cpuGetCycles());
+
+	if (next == __profRunning) return;
+
+	/* Switched out while it could still run */
+	if (__profRunning && __profRunning->th_status == __THSTS_READY) __profRunning->th_preempts++;
+
+	if (next) next->th_switches++;
+
+	__profSwitches++;
+	__profRunning = next;
+}
+
+/*!
+ * @brief Accounts the running thread on each system tick, so long runs don't
+ * overflow the cycle counter.
+ *
+ * @return Nothing.
+ */
+__VOID __profTick(__VOID)
+{
+	__profLock();
+	__profAccount(__cpuGetCycles());
+	__profUnlock();
+}
+
+/*!
+ * @brief Starts measuring a critical section. Called with interrupts disabled.
+ *
+ * @param	site	Return address of __systemStop().
+ * @return Nothing.
+ */
+__VOID __profCsEnter(u32 site)
+{
+	__profCsSite = site;
+	__profCsStart = __cpuGetCycles();
+}
+
+/*!
+ * @brief Ends the measure of a critical section. Called with interrupts disabled.
+ *
+ * @return Nothing.
+ */
+__VOID __profCsLeave(__VOID)
+{
+	u32 len = __cpuGetCycles() - __profCsStart;
+	__PPROF_SITE ps;
+
+	for (ps = __profSites; ps < __profSites + __CONFIG_PROFILER_SITES; ps++)
+	{
+		if (ps->ps_site == __profCsSite || !ps->ps_site)
+		{
+			ps->ps_site = __profCsSite;
+			ps->ps_count++;
+			if (len > ps->ps_max) ps->ps_max = len;
+			return;
+		}
+	}
+}
+
+/*!
+ * @brief Restarts the measure of the running critical section.
+ *
+ * Used when the CPU sleeps with interrupts disabled, waiting for one.
+ *
+ * @return Nothing.
+ */
+__VOID __profCsRestart(__VOID)
+{
+	__profCsStart = __cpuGetCycles();
+}
+
+/*!
+ * @brief Accounts an interrupt entry. Called from __systemEnterISR().
+ *
+ * @return Nothing.
+ */
+__VOID __profIsrEnter(__VOID)
+{
+	__profLock();
+	if (!__profIsrNesting++) __profIsrStart = __cpuGetCycles();
+	__profUnlock();
+}
+
+/*!
+ * @brief Accounts an interrupt exit. Called from __systemLeaveISR().
+ *
+ * @return Nothing.
+ */
+__VOID __profIsrLeave(__VOID)
+{
+	u32 len;
+
+	__profLock();
+
+	if (__profIsrNesting && !--__profIsrNesting)
+	{
+		len = __cpuGetCycles() - __profIsrStart;
+		__profIsr += len;
+		__profIsrCount++;
+		if (len > __profIsrMax) __profIsrMax = len;
+	}
+
+	__profUnlock();
+}
+
+/*!
+ * @brief Returns the critical section sites table.
+ *
+ * @return	Array of __CONFIG_PROFILER_SITES sites, the unused ones have \c ps_site zero.
+ */
+__PPROF_SITE __profGetSites(__VOID)
+{
+	return __profSites;
+}
+
+/*!
+ * @brief Fills a snapshot header. Internal use, called with interrupts disabled.
+ *
+ * @param	hdr		Header to fill.
+ * @return Nothing.
+ */
+__STATIC __VOID __profTotals(__PPROF_HEADER hdr)
+{
+	__PTHREAD th;
+	u32 i;
+
+	__profAccount(__cpuGetCycles());
+
+	hdr->ph_magic = __PROF_MAGIC;
+	hdr->ph_hz = __cpuGetCyclesPerSecond();
+	hdr->ph_threads = hdr->ph_sites = 0;
+
+	for (th = __threadGetChain(); th; th = th->th_lstnext) hdr->ph_threads++;
+
+	for (i = 0; i < __CONFIG_PROFILER_SITES && __profSites[i].ps_site; i++) hdr->ph_sites++;
+
+	hdr->ph_switches = __profSwitches;
+	hdr->ph_isrcount = __profIsrCount;
+	hdr->ph_isrmax = __profIsrMax;
+	hdr->ph_reserved = 0;
+	hdr->ph_idle = __profIdle;
+	hdr->ph_isr = __profIsr;
+}
+
+/*!
+ * @brief Fills a snapshot header with the current totals.
+ *
+ * @param	hdr		Header to fill.
+ * @return	\c hdr.
+ */
+__PPROF_HEADER __profGetTotals(__PPROF_HEADER hdr)
+{
+	__profLock();
+	__profTotals(hdr);
+	__profUnlock();
+
+	return hdr;
+}
+
+/*!
+ * @brief Copies every measure in binary format.
+ *
+ * The snapshot is a __PROF_HEADER, followed by a __PROF_THREAD for each thread
+ * and a __PROF_SITE for each critical section site. It is taken with interrupts
+ * disabled, so all the values are coherent.
+ *
+ * @param	buf		Destination buffer, word aligned.
+ * @param	len		Length of \c buf.
+ * @return	The snapshot length, or zero if \c buf is too small.
+ */
+u32 __profSnapshot(__PVOID buf, u32 len)
+{
+	__PPROF_HEADER hdr = buf;
+	__PPROF_THREAD pt;
+	__PPROF_SITE ps;
+	__PTHREAD th;
+	u32 size, i;
+
+	if (len < sizeof(__PROF_HEADER)) return 0;
+
+	__profLock();
+
+	__profTotals(hdr);
+
+	size = sizeof(__PROF_HEADER) + hdr->ph_threads * sizeof(__PROF_THREAD) +
+			hdr->ph_sites * sizeof(__PROF_SITE);
+
+	if (size > len)
+	{
+		__profUnlock();
+		return 0;
+	}
+
+	pt = (__PPROF_THREAD) (hdr + 1);
+
+	for (th = __threadGetChain(); th; th = th->th_lstnext, pt++)
+	{
+		for (i = 0; i < sizeof(pt->pt_name); i++)
+		{
+#if __CONFIG_COMPILE_STRING
+			pt->pt_name[i] = th->th_name[i];
+			if (!th->th_name[i]) break;
+#else
+			pt->pt_name[i] = 0;
+#endif /* __CONFIG_COMPILE_STRING */
+		}
+
+		for (; i < sizeof(pt->pt_name); i++) pt->pt_name[i] = 0;
+
+		pt->pt_cycles = th->th_cycles;
+		pt->pt_switches = th->th_switches;
+		pt->pt_preempts = th->th_preempts;
+		pt->pt_priority = th->th_priority;
+		pt->pt_reserved = 0;
+	}
+
+	ps = (__PPROF_SITE) pt;
+
+	for (i = 0; i < hdr->ph_sites; i++) ps[i] = __profSites[i];
+
+	__profUnlock();
+
+	return size;
+}
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+#endif /* __CONFIG_PROFILER */
@@ -52,6 +52,9 @@
 
 #define __queueReady(x)	(x && (x->type & __QUEUE_READY ? __TRUE : __FALSE))	/*!< @brief Checks if the queue is ready */
 
+/*! @brief Slot (length word) of item \c i of a __QUEUE_SPSC queue */
+#define __queueSlot(x, i)	((pu32) ((u8*) x->ref + ((i) & (x->item_qty - 1)) * __QUEUE_SPSC_SLOT(x->item_size)))
+
 /**
   * @}
   */
@@ -78,6 +81,43 @@ typedef struct queueDataTag {
   * @{
   */
 
+/*!
+ * @brief Allocates an item for a queue without fixed size.
+ *
+ * Internal use. The item comes from the queue pool if one was set
+ * with __queueSetPool(), otherwise from the heap.
+ */
+__STATIC __PQUEUE_DATA __queueAllocItem(__PQUEUE queue, u32 size)
+{
+#if __CONFIG_COMPILE_POOL
+	if (queue->pool)
+	{
+		if (size > queue->pool->block_size - sizeof(__QUEUE_DATA)) return __NULL;
+		return __poolAlloc(queue->pool);
+	}
+#endif
+
+	return __heapAllocZero(sizeof(__QUEUE_DATA) + size);
+}
+
+/*!
+ * @brief Releases an item allocated with __queueAllocItem().
+ *
+ * Internal use.
+ */
+__STATIC __VOID __queueFreeItem(__PQUEUE queue, __PQUEUE_DATA item)
+{
+#if __CONFIG_COMPILE_POOL
+	if (queue->pool)
+	{
+		__poolFree(queue->pool, item);
+		return;
+	}
+#endif
+
+	__heapFree(item);
+}
+
 
 /*!
  * @brief Creates and prepares a queue structure.
@@ -103,11 +143,23 @@ typedef struct queueDataTag {
  * Users can wait for data using the __queueWaitForData(), that will put the calling thread
  * to sleep.
  *
+ * Items of a growing queue can be taken from a fixed-size block pool instead
+ * of the heap, see __queueSetPool().
+ *
+ * With the __QUEUE_SPSC flag the queue is a ring of \c item_qty slots (a power of two)
+ * of up to \c item_size bytes, for exactly one producer and one consumer, one of them
+ * possibly an ISR. No lock is taken: the producer only writes the \c wr counter and the
+ * consumer only writes the \c rd counter. Items can be built in place with
+ * __queueReserve()/__queueCommit() and used in place with __queuePeek()/__queueRelease().
+ * The events are set only when the queue goes from empty to non-empty (data) and
+ * back (empty). A static area must be __QUEUE_SPSC_AREA_SIZE() bytes, word aligned.
+ *
  * @param	type	Queue type. Bitwise value that determines the operating mode.
  * @arg __QUEUE_STATIC			The user provides a pointer to store the queue items. Using
  * 								this value forces the queue to work with __QUEUE_FIXED_DATA_SIZE
  * 								flag set.
  * @arg	__QUEUE_ALLOC			The queue functions will dynamically allocate memory with __heapAlloc().
+ * @arg __QUEUE_SPSC			Lock-free single producer, single consumer ring.
  * @arg __QUEUE_FIXED_SIZE		Items in the queue have a fixed size. When used with __QUEUE_ALLOC,
  * 								__queuePrepare() will allocate memory once, for all the possible
  * 								items (determined by the \c item_qty and \c item_size parameters).
@@ -131,10 +183,40 @@ __BOOL __queueCreate(u8 type, __PQUEUE queue, u32 item_qty, u32 item_size, u8* p
 	if (queue->type & __QUEUE_READY) return __FALSE;
 
 	queue->item_count = 0;
+	queue->wr = queue->rd = 0;
 	queue->type = type;
+#if __CONFIG_COMPILE_POOL
+	queue->pool = __NULL;
+#endif
 	__memSet(&queue->event_r, 0, sizeof(__EVENT));
 	__memSet(&queue->event_w, 0, sizeof(__EVENT));
 
+	if (type & __QUEUE_SPSC)
+	{
+		/*
+		 * The free running counters wrap properly only with
+		 * a power of two quantity of slots.
+		 */
+		if (!item_size || !item_qty || (item_qty & (item_qty - 1))) return __FALSE;
+
+		queue->item_size = item_size;
+		queue->item_qty = item_qty;
+		queue->data_size = __QUEUE_SPSC_AREA_SIZE(item_size, item_qty);
+
+		if (type & __QUEUE_ALLOC)
+		{
+			queue->ref = __heapAlloc(queue->data_size);
+			if (!queue->ref) return __FALSE;
+		} else {
+			if (!ptr || ((u32) ptr & 3) || ptr_size != queue->data_size) return __FALSE;
+			queue->ref = ptr;
+		}
+
+		queue->data_w = queue->data_r = queue->ref;
+		queue->type = (type & (__QUEUE_ALLOC | __QUEUE_SPSC)) | __QUEUE_READY;
+		return __TRUE;
+	}
+
 	/*
 	 * Check type.
 	 */
@@ -212,8 +294,18 @@ __BOOL __queueAdd(__PQUEUE queue, __PVOID data, u32 size)
 	 */
 	if (!__queueReady(queue)) return __FALSE;
 
+	if (queue->type & __QUEUE_SPSC)
+	{
+		__PVOID slot;
+
+		if (size > queue->item_size || (slot = __queueReserve(queue)) == __NULL) return __FALSE;
+
+		__memCpy(slot, data, size);
+		return __queueCommit(queue, size);
+	}
+
 	/*
-	 * TODO Check calling from isr and return __FALSE if so.
+	 * TODO Check calling from isr and return __FALSE if so.
 	 */
 
 	if (queue->type & __QUEUE_FIXED_SIZE)
@@ -248,9 +340,10 @@ __BOOL __queueAdd(__PQUEUE queue, __PVOID data, u32 size)
 		ptr = queue->data_w;
 		if (!ptr)
 		{
-			ptr = __heapAllocZero(sizeof(__QUEUE_DATA) + size);
+			ptr = __queueAllocItem(queue, size);
+			if (!ptr) return __FALSE;
 		} else {
-			ptr->next = __heapAllocZero(sizeof(__QUEUE_DATA) + size);
+			ptr->next = __queueAllocItem(queue, size);
 			if (!ptr->next) return __FALSE;
 			ptr = ptr->next;
 		}
@@ -297,6 +390,22 @@ __BOOL __queueGet(__PQUEUE queue, __PVOID buf, u32* len)
 	 */
 	if (!__queueReady(queue) || !len) return __FALSE;
 
+	if (queue->type & __QUEUE_SPSC)
+	{
+		u32 itemlen;
+
+		if ((ptr = __queuePeek(queue, &itemlen)) == __NULL) return __FALSE;
+
+		if (buf)
+		{
+			if (*len < itemlen) return __FALSE;
+			__memCpy(buf, ptr, itemlen);
+		}
+
+		*len = itemlen;
+		return (buf) ? __queueRelease(queue) : __TRUE;
+	}
+
 	/*
 	 * TODO Check calling from isr and return if so.
 	 */
@@ -342,9 +451,9 @@ __BOOL __queueGet(__PQUEUE queue, __PVOID buf, u32* len)
 		*len = queue->item_size;
 
 		/*
-		 * Move data_r to the next position.
+		 * Move data_r to the next position.
 		 */
-		queue->data_r = (u8*) queue->data_r + queue->item_size;
+		queue->data_r = (u8*) ptr + queue->item_size;
 
 		queue->item_count--;
 		__systemEnableScheduler();
@@ -386,9 +495,9 @@ __BOOL __queueGet(__PQUEUE queue, __PVOID buf, u32* len)
 		}
 
 		/*
-		 * Deallocate qd
+		 * Deallocate qd
 		 */
-		__heapFree(qd);
+		__queueFreeItem(queue, qd);
 
 		__systemEnableScheduler();
 
@@ -411,14 +520,18 @@ __BOOL __queueWaitForData(__PQUEUE queue, u32 timeout)
 	 */
 
 	/*
-	 * If already have items, return immediately.
+	 * Reset event before checking, so an item added from now on sets it.
 	 */
-	if (queue->item_count) return __TRUE;
+	__eventReset(&queue->event_r);
 
 	/*
-	 * Reset event and wait for data.
+	 * If already have items, return immediately.
+	 */
+	if (__queueGetItemCount(queue)) return __TRUE;
+
+	/*
+	 * Wait for data.
 	 */
-	__eventReset(&queue->event_r);
 	if (__eventWait(&queue->event_r, timeout) == __EVRET_SUCCESS)
 		return __TRUE;
 
@@ -437,14 +550,18 @@ __BOOL __queueWaitForEmpty(__PQUEUE queue, u32 timeout)
 	 */
 
 	/*
-	 * If already have items, return immediately.
+	 * Reset event before checking, so the queue getting empty from now on sets it.
 	 */
-	if (!queue->item_count) return __TRUE;
+	__eventReset(&queue->event_w);
 
 	/*
-	 * Reset event and wait for empty queue.
+	 * If already empty, return immediately.
+	 */
+	if (!__queueGetItemCount(queue)) return __TRUE;
+
+	/*
+	 * Wait for empty queue.
 	 */
-	__eventReset(&queue->event_w);
 	if (__eventWait(&queue->event_w, timeout) == __EVRET_SUCCESS)
 		return __TRUE;
 
@@ -456,6 +573,220 @@ __BOOL __queueIsReady(__PQUEUE queue)
 	return __queueReady(queue);
 }
 
+/*!
+ * @brief Copies the first or the last item of the queue, without removing it.
+ *
+ * Internal use, see __queuePeekFirst() and __queuePeekLast().
+ */
+__STATIC __BOOL __queuePeekItem(__PQUEUE queue, __PVOID data, u32 size, __BOOL last)
+{
+	__PVOID src;
+	pu32 slot;
+	u32 len;
+
+	if (!__queueReady(queue) || !data) return __FALSE;
+
+	if (queue->type & __QUEUE_SPSC)
+	{
+		if (queue->wr == queue->rd) return __FALSE;
+
+		/* Item data after the counter */
+		__cpuMemoryBarrier();
+
+		slot = __queueSlot(queue, (last) ? queue->wr - 1 : queue->rd);
+		__memCpy(data, slot + 1, (size < *slot) ? size : *slot);
+		return __TRUE;
+	}
+
+	__systemDisableScheduler();
+
+	if (!queue->item_count)
+	{
+		__systemEnableScheduler();
+		return __FALSE;
+	}
+
+	if (queue->type & __QUEUE_FIXED_SIZE)
+	{
+		if (last)
+		{
+			/* data_w is moved to the beginning only on the next write */
+			src = (u8*) queue->data_w - queue->item_size;
+		} else
+		{
+			src = queue->data_r;
+			if ((u8*) src >= ((u8*) queue->ref + queue->data_size)) src = queue->ref;
+		}
+
+		len = queue->item_size;
+	} else {
+		src = (last) ? ((__PQUEUE_DATA) queue->data_w)->data : ((__PQUEUE_DATA) queue->data_r)->data;
+		len = (last) ? ((__PQUEUE_DATA) queue->data_w)->datalen : ((__PQUEUE_DATA) queue->data_r)->datalen;
+	}
+
+	__memCpy(data, src, (size < len) ? size : len);
+
+	__systemEnableScheduler();
+	return __TRUE;
+}
+
+/*!
+ * @brief Copies the oldest item of the queue, without removing it.
+ *
+ * Up to \c size bytes are copied.
+ *
+ * @param queue		Pointer to the queue.
+ * @param data		Buffer to copy the item to.
+ * @param size		Size of the \c data buffer.
+ *
+ * @return	__TRUE on success, __FALSE if the queue is empty.
+ */
+__BOOL __queuePeekFirst(__PQUEUE queue, __PVOID data, u32 size)
+{
+	return __queuePeekItem(queue, data, size, __FALSE);
+}
+
+/*!
+ * @brief Copies the newest item of the queue, without removing it.
+ *
+ * Up to \c size bytes are copied. On a __QUEUE_SPSC queue call it from
+ * the consumer side.
+ *
+ * @param queue		Pointer to the queue.
+ * @param data		Buffer to copy the item to.
+ * @param size		Size of the \c data buffer.
+ *
+ * @return	__TRUE on success, __FALSE if the queue is empty.
+ */
+__BOOL __queuePeekLast(__PQUEUE queue, __PVOID data, u32 size)
+{
+	return __queuePeekItem(queue, data, size, __TRUE);
+}
+
+/*!
+ * @brief Reserves the next free slot of a __QUEUE_SPSC queue.
+ *
+ * Producer side. The item can be built directly in the slot, up to
+ * \c item_size bytes, and it is appended with __queueCommit(). Can be called
+ * from an ISR.
+ *
+ * @param queue		Pointer to the queue.
+ *
+ * @return	Pointer to the slot data, __NULL if the queue is full.
+ */
+__PVOID __queueReserve(__PQUEUE queue)
+{
+	if (!__queueReady(queue) || !(queue->type & __QUEUE_SPSC)) return __NULL;
+	if (queue->wr - queue->rd >= queue->item_qty) return __NULL;
+
+	return __queueSlot(queue, queue->wr) + 1;
+}
+
+/*!
+ * @brief Appends the item built in the slot returned by __queueReserve().
+ *
+ * Producer side, can be called from an ISR. Sets the data event if the
+ * queue was empty.
+ *
+ * @param queue		Pointer to the queue.
+ * @param size		Size of the item.
+ *
+ * @return	__TRUE on success, otherwise __FALSE.
+ */
+__BOOL __queueCommit(__PQUEUE queue, u32 size)
+{
+	if (!__queueReady(queue) || !(queue->type & __QUEUE_SPSC)) return __FALSE;
+	if (size > queue->item_size || queue->wr - queue->rd >= queue->item_qty) return __FALSE;
+
+	*__queueSlot(queue, queue->wr) = size;
+
+	/* Item stored before it is counted */
+	__cpuMemoryBarrier();
+	queue->wr++;
+
+	if (queue->wr - queue->rd == 1) __eventSet(&queue->event_r);
+	return __TRUE;
+}
+
+/*!
+ * @brief Returns the oldest item of a __QUEUE_SPSC queue, without copying it.
+ *
+ * Consumer side, can be called from an ISR. The item stays valid until
+ * __queueRelease() is called.
+ *
+ * @param queue		Pointer to the queue.
+ * @param len		Pointer to store the item size, can be __NULL.
+ *
+ * @return	Pointer to the item data, __NULL if the queue is empty.
+ */
+__PVOID __queuePeek(__PQUEUE queue, u32* len)
+{
+	pu32 slot;
+
+	if (!__queueReady(queue) || !(queue->type & __QUEUE_SPSC)) return __NULL;
+	if (queue->wr == queue->rd) return __NULL;
+
+	/* Item data after the counter */
+	__cpuMemoryBarrier();
+
+	slot = __queueSlot(queue, queue->rd);
+	if (len) *len = *slot;
+
+	return slot + 1;
+}
+
+/*!
+ * @brief Removes the item returned by __queuePeek().
+ *
+ * Consumer side, can be called from an ISR. Sets the empty event if it was
+ * the last item.
+ *
+ * @param queue		Pointer to the queue.
+ *
+ * @return	__TRUE on success, __FALSE if the queue is empty.
+ */
+__BOOL __queueRelease(__PQUEUE queue)
+{
+	if (!__queueReady(queue) || !(queue->type & __QUEUE_SPSC)) return __FALSE;
+	if (queue->wr == queue->rd) return __FALSE;
+
+	/* Done with the item before the slot is given back */
+	__cpuMemoryBarrier();
+	queue->rd++;
+
+	if (queue->wr == queue->rd) __eventSet(&queue->event_w);
+	return __TRUE;
+}
+
+#if __CONFIG_COMPILE_POOL
+
+/*!
+ * @brief Sets a pool to allocate the items of a queue.
+ *
+ * Only for queues created with __QUEUE_ALLOC and without __QUEUE_FIXED_SIZE,
+ * and while they are empty. Each item takes a pool block, so the pool block
+ * size limits the item size. Allocation never walks the heap and does not
+ * disable the scheduler. Call with \c pool set to __NULL to allocate from the
+ * heap again.
+ *
+ * @param queue		Pointer to the queue.
+ * @param pool		Pointer to a pool created with __poolCreate().
+ *
+ * @return	__TRUE on success, otherwise __FALSE.
+ */
+__BOOL __queueSetPool(__PQUEUE queue, __PPOOL pool)
+{
+	if (!__queueReady(queue)) return __FALSE;
+	if (!(queue->type & __QUEUE_ALLOC) || (queue->type & (__QUEUE_FIXED_SIZE | __QUEUE_SPSC))) return __FALSE;
+	if (queue->item_count) return __FALSE;
+	if (pool && pool->block_size <= sizeof(__QUEUE_DATA)) return __FALSE;
+
+	queue->pool = pool;
+	return __TRUE;
+}
+
+#endif /* __CONFIG_COMPILE_POOL */
+
 /**
   * @}
   */
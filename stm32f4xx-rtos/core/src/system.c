@@ -27,6 +27,9 @@
 #include "timer.h"
 #include "device.h"
 #include "rtc.h"
+#include "profile.h"
+#include "log.h"
+#include "work.h"
 
 /** @defgroup Milos Milos
   * @{
@@ -75,6 +78,7 @@ __STATIC __APP_ENTRY* 	__systemAppEntry = __NULL;		/*!< @brief Application entry
 __STATIC __VOLATILE u32	__systemIrqCount;				/*!< @brief Keeps track of disabled IRQ */
 __STATIC __VOLATILE u32	__systemTickCount = 0;			/*!< @brief System ticks counter */
 __STATIC __VOLATILE u32	__systemSecondsCount = 0;		/*!< @brief System seconds counter */
+__STATIC __VOLATILE u32	__systemIdleTicks = 0;			/*!< @brief Ticks spent with no thread running */
 __STATIC __VOLATILE u32	__systemContextSwCount = 0;		/*!< @brief Keeps track of disabled
  	 	 	 	 	 	 	 	 	 	 	 	 	 	 	 context switching */
 __STATIC __VOLATILE u32	__systemNestingISR = 0;			/*!< @brief Keeps track of ISR calls */
@@ -108,11 +112,21 @@ __VOID __systemThread(__VOID)
 	__timerInit(__CONFIG_STACK_TIMTHREAD);
 #endif
 
+	/* Start the system work queues */
+#if __CONFIG_COMPILE_WORK
+	__workInit();
+#endif /* __CONFIG_COMPILE_WORK */
+
 	/* Initialize the Debug Terminal, if enabled */
 #if __CONFIG_DBGTERM_ENABLED
 	__dbgInit();
 #endif // __CONFIG_DBGTERM_ENABLED
 
+	/* Start formatting the binary log */
+#if __CONFIG_LOG
+	__logStart();
+#endif /* __CONFIG_LOG */
+
 	if (__systemAppEntry)
 	{
 		(__systemAppEntry)();
@@ -145,6 +159,11 @@ __VOID __systemThread(__VOID)
 			ticks = __systemTickCount;
 		}
 
+		/* Stack high-water marks */
+#if __CONFIG_STACK_CHECK
+		__threadStackCheck();
+#endif /* __CONFIG_STACK_CHECK */
+
 		__threadSleep(__CONFIG_SYSTHREAD_SLEEP_TIME);
 	}
 }
@@ -202,6 +221,14 @@ __VOID __systemInit(__APP_ENTRY* entry)
 	/* Init Heap */
 	__heapInit(&__CPU_HEAP_BASE, (u32) &__CPU_HEAP_SIZE);
 
+#if __CONFIG_PROFILER
+	__profInit();
+#endif /* __CONFIG_PROFILER */
+
+#if __CONFIG_LOG
+	__logInit();
+#endif /* __CONFIG_LOG */
+
 	/* Init RTC */
 #if __CONFIG_COMPILE_RTC
 	__rtcInit();
@@ -243,9 +270,75 @@ __VOID __systemProcessTick(__VOID)
 {
 	/* Software system ticks */
 	__systemTickCount++;
+
+	/* Idle residency */
+	if (!__threadGetCurrent()) __systemIdleTicks++;
+
+	__PROF_TICK();
+
 	__threadProcessTick();
 }
 
+/*!
+ * @brief Idles the CPU until there is a thread to run.
+ *
+ * Called in a loop from __threadSleep() and __eventWait() while the calling
+ * thread waits to be scheduled again. When no thread is running that loop is
+ * the system idle loop.
+ *
+ * With __CONFIG_TICKLESS_IDLE set, if no thread is ready the system tick is
+ * stopped until the first suspended thread times out (or any other interrupt
+ * arrives) and the CPU sleeps. The ticks elapsed are then added to the system
+ * tick count and accounted as idle. Otherwise the CPU sleeps until the next
+ * interrupt, so waiting threads never spin.
+ *
+ * @return Nothing.
+ */
+__VOID __systemIdle(__VOID)
+{
+#if __CONFIG_TICKLESS_IDLE
+	u32 ticks;
+
+	__systemStop();
+
+	if (!__threadGetCurrent() && !__threadGetReady() && !__cpuThreadChangeScheduled())
+	{
+		ticks = __threadGetNextTimeout();
+		if (!ticks || ticks > __cpuTicklessMaxTicks()) ticks = __cpuTicklessMaxTicks();
+
+		if (ticks > 1)
+		{
+			__cpuTicklessEnter(ticks);
+			__cpuWaitForInterrupt();
+			__PROF_CS_RESTART();
+
+			/* Ticks not accounted by the system tick interrupt */
+			ticks = __cpuTicklessLeave();
+			__systemTickCount += ticks;
+			__systemIdleTicks += ticks;
+		} else
+		{
+			__cpuWaitForInterrupt();
+			__PROF_CS_RESTART();
+		}
+	}
+
+	/* Pending interrupts (the system tick among them) are served here */
+	__systemStart();
+#else
+	__systemStop();
+
+	/* WFI wakes up on a pending interrupt even if they are disabled */
+	if (!__threadGetCurrent() && !__threadGetReady() && !__cpuThreadChangeScheduled())
+	{
+		__cpuWaitForInterrupt();
+		__PROF_CS_RESTART();
+	}
+
+	__systemStart();
+#endif /* __CONFIG_TICKLESS_IDLE */
+}
+
 /*!
  * @brief Disables interrupts.
  *
@@ -256,6 +349,7 @@ __VOID __systemStop(__VOID)
 	if (!__systemIrqCount)
 	{
 		__cpuDisableInterrupts();
+		__PROF_CS_ENTER();
 	}
 	__systemIrqCount++;
 }
@@ -267,8 +361,9 @@ __VOID __systemStop(__VOID)
  */
 __VOID __systemStart(__VOID)
 {
-	if (__systemIrqCount && --__systemIrqCount) {
-		return;
+	if (__systemIrqCount) {
+		if (--__systemIrqCount) return;
+		__PROF_CS_LEAVE();
 	}
 
 	/* enable interrupts */
@@ -354,6 +449,7 @@ __VOID __systemScheduleThreadChange(__VOID)
 __VOID __systemEnterISR(__VOID)
 {
 	__systemNestingISR++;
+	__PROF_ISR_ENTER();
 }
 
 /*!
@@ -364,6 +460,7 @@ __VOID __systemEnterISR(__VOID)
 
 __VOID __systemLeaveISR(__VOID)
 {
+	__PROF_ISR_LEAVE();
 	__systemNestingISR--;
 }
 
@@ -378,6 +475,18 @@ u32 __systemGetTickCount(__VOID)
 	return __systemTickCount;
 }
 
+/*!
+ * @brief Gets the system ticks spent with no thread running.
+ *
+ * Compared to __systemGetTickCount() it gives the idle residency.
+ *
+ * @return The count of idle system ticks.
+ */
+u32 __systemGetIdleTicks(__VOID)
+{
+	return __systemIdleTicks;
+}
+
 /*!
  * @brief Gets the seconds passed from the last reset.
  *
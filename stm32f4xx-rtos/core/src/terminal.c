@@ -37,6 +37,12 @@
 
 /** @defgroup Terminal Terminal
   * Terminal functions.
+  *
+  * The commands of a terminal are kept in a table sorted by name: a received
+  * line is split once into \c argv, and its first word is found with a
+  * binary search. The TAB key completes the command being typed from the
+  * same table.
+  *
   * @{
   */
 
@@ -98,6 +104,26 @@ __TERMINALCMD __dbgCommands[] = {
 		{ "devices",	__dbgTerminalIn, __NULL},
 		{ "defrag",		__dbgTerminalIn, __NULL},
 
+#if __CONFIG_COMPILE_POOL
+		{ "pools",		__dbgTerminalIn, __NULL},
+#endif /* __CONFIG_COMPILE_POOL */
+
+#if __CONFIG_PROFILER
+		{ "prof",		__dbgTerminalIn, __NULL},
+#endif /* __CONFIG_PROFILER */
+
+#if __CONFIG_STACK_CHECK
+		{ "stack",		__dbgTerminalIn, __NULL},
+#endif /* __CONFIG_STACK_CHECK */
+
+#if __CONFIG_COMPILE_WORK
+		{ "work",		__dbgTerminalIn, __NULL},
+#endif /* __CONFIG_COMPILE_WORK */
+
+#if __CONFIG_LOG
+		{ "log",		__dbgTerminalIn, __NULL},
+#endif /* __CONFIG_LOG */
+
 #if __CONFIG_COMPILE_FAT
 		{ "dir",		__dbgTerminalIn, __NULL},
 #endif /* __CONFIG_COMPILE_FAT */
@@ -413,6 +439,192 @@ __STATIC __VOID __terminalWriteChar(__PTERMINAL term, u8 c)
 	}
 }
 
+/*!
+ * @brief Finds the first command not sorting before a name.
+ *
+ * Call with the scheduler disabled, \c cmdtab can be reallocated.
+ *
+ * @param	term	Pointer to a terminal.
+ * @param	name	Command name, or a prefix.
+ * @param	len		Characters of \c name to compare, the null one included for a full name.
+ *
+ * @return	Index in \c cmdtab, \c cmdcnt if every command sorts before. Names are unique.
+ *
+ */
+__STATIC u16 __terminalLowerBound(__PTERMINAL term, __CONST __PSTRING name, u16 len)
+{
+	u16 lo = 0;
+	u16 hi = term->cmdcnt;
+	u16 mid;
+
+	while (lo < hi)
+	{
+		mid = (lo + hi) >> 1;
+
+		if (__strnCmp(term->cmdtab[mid]->cmd, name, len) < 0)
+		{
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+
+	return lo;
+}
+
+/*!
+ * @brief Finds a command by name.
+ *
+ * @param	term	Pointer to a terminal.
+ * @param	name	Command name.
+ *
+ * @return	The command, __NULL if unknown.
+ *
+ */
+__STATIC __PTERMINALCMD __terminalFindCommand(__PTERMINAL term, __CONST __PSTRING name)
+{
+	__PTERMINALCMD cmd = __NULL;
+	u16 i;
+
+	__systemDisableScheduler();
+
+	i = __terminalLowerBound(term, name, __strLen(name) + 1);
+	if (i < term->cmdcnt && __strCmp(term->cmdtab[i]->cmd, name) == 0) cmd = term->cmdtab[i];
+
+	__systemEnableScheduler();
+
+	return cmd;
+}
+
+/*!
+ * @brief Returns a command starting with a prefix.
+ *
+ * @param	term	Pointer to a terminal.
+ * @param	prefix	Command prefix.
+ * @param	len		Length of \c prefix.
+ * @param	idx		Index of the command among the matching ones, in name order.
+ *
+ * @return	The command, __NULL after the last one.
+ *
+ */
+__STATIC __PTERMINALCMD __terminalMatchCommand(__PTERMINAL term, __CONST __PSTRING prefix, u16 len, u16 idx)
+{
+	__PTERMINALCMD cmd = __NULL;
+	u32 i;
+
+	__systemDisableScheduler();
+
+	i = (u32) __terminalLowerBound(term, prefix, len) + idx;
+	if (i < term->cmdcnt && __strnCmp(term->cmdtab[i]->cmd, prefix, len) == 0) cmd = term->cmdtab[i];
+
+	__systemEnableScheduler();
+
+	return cmd;
+}
+
+/*!
+ * @brief Splits the received line at the spaces.
+ *
+ * Fills the \c argc and \c argv members with the words of a copy of the line.
+ *
+ * @param	term	Pointer to a terminal.
+ *
+ * @return	Quantity of words.
+ *
+ */
+__STATIC u8 __terminalSplit(__PTERMINAL term)
+{
+	__PSTRING p = term->arg_line;
+
+	__strCpy(p, term->rx_line);
+	term->argc = 0;
+
+	while (term->argc < __TERMINAL_MAXARGS)
+	{
+		while (*p == 0x20) *p++ = 0;
+		if (!*p) break;
+
+		term->argv[term->argc++] = p;
+
+		/* The last argument takes the rest of the line */
+		if (term->argc == __TERMINAL_MAXARGS) break;
+
+		while (*p && *p != 0x20) p++;
+	}
+
+	return term->argc;
+}
+
+/*!
+ * @brief Completes the command being typed (TAB key).
+ *
+ * Adds the characters shared by every command starting with the typed ones,
+ * and a space when only one command is left. Otherwise, lists the commands.
+ *
+ * @param	term	Pointer to a terminal.
+ *
+ * @return	Nothing.
+ *
+ */
+__STATIC __VOID __terminalComplete(__PTERMINAL term)
+{
+	__PTERMINALCMD first = __NULL;
+	__PTERMINALCMD cmd;
+	u16 len = 0;
+	u16 cnt;
+	u16 i;
+
+	if (!(term->flags & __TERMINAL_ECHO_ENABLED)) return;
+
+	/* Only the command, with the cursor at the end */
+	if (term->cursor != term->rxoffs || __strChr(term->rx_line, 0x20)) return;
+
+	for (cnt = 0; (cmd = __terminalMatchCommand(term, term->rx_line, term->rxoffs, cnt)) != __NULL; cnt++)
+	{
+		if (!first)
+		{
+			first = cmd;
+			len = __strLen(cmd->cmd);
+		} else {
+			for (i = term->rxoffs; i < len && cmd->cmd[i] == first->cmd[i]; i++);
+			len = i;
+		}
+	}
+
+	if (!cnt) return;
+
+	if (len > term->rxoffs)
+	{
+		i = term->rxoffs;
+
+		if (len > term->linelen - 2) len = term->linelen - 2;
+		__memCpy(term->rx_line + i, first->cmd + i, len - i);
+		term->rxoffs = len;
+
+		if (cnt == 1) term->rx_line[term->rxoffs++] = 0x20;
+
+		term->rx_line[term->rxoffs] = 0;
+		term->cursor = term->rxoffs;
+
+		__terminalOut(term, __FALSE, term->rx_line + i, __NULL);
+		return;
+	}
+
+	if (cnt == 1) return;
+
+	__terminalWrite(term, "\r\n");
+
+	for (i = 0; (cmd = __terminalMatchCommand(term, term->rx_line, term->rxoffs, i)) != __NULL; i++)
+	{
+		__terminalOut(term, __FALSE, cmd->cmd, __NULL);
+		__terminalWrite(term, "  ");
+	}
+
+	__terminalWrite(term, "\r\n");
+	__terminalShowPrompt(term);
+	__terminalOut(term, __FALSE, term->rx_line, __NULL);
+}
+
 /*!
  * @brief Reads a single line of text.
  *
@@ -461,6 +673,7 @@ __STATIC __BOOL __terminalReadLine(__PTERMINAL term)
 					case 0x09:
 						save = __FALSE;
 						echo = __FALSE;
+						__terminalComplete(term);
 						break;
 
 					/* BACKSPACE */
@@ -595,7 +808,14 @@ __STATIC __BOOL __terminalReadLine(__PTERMINAL term)
 			}
 		}
 
-		__threadSleep(1);
+		/* Wait for the next character */
+		if (term->dv_in->dv_rxev)
+		{
+			__eventReset(term->dv_in->dv_rxev);
+			if (!__deviceSize(term->dv_in, __DEV_RXSIZE)) __eventWait(term->dv_in->dv_rxev, 0);
+		} else {
+			__threadSleep(1);
+		}
 	}
 
 	return __FALSE;
@@ -610,9 +830,8 @@ __STATIC __BOOL __terminalReadLine(__PTERMINAL term)
  */
 __VOID __terminalThread(__VOID)
 {
-	__PTERMINALCMD commands;
+	__PTERMINALCMD command;
 	__PSTRING 	str;
-	__BOOL		bKnown = __FALSE;
 	__PTERMINAL term = __threadGetParameter();
 
 	__terminalWriteLine(term, "\r\n\r\n");
@@ -625,48 +844,22 @@ __VOID __terminalThread(__VOID)
 		__memSet(term->rx_line, 0, term->linelen);
 		if (__terminalReadLine(term))
 		{
-			if (__strLen(term->rx_line))
+			if (__terminalSplit(term))
 			{
-				/* Cycle through all terminal commands */
-				commands = term->cmds;
-				bKnown = __FALSE;
-				
-				/* Command with parameters? */
-				str = __strChr(term->rx_line, 0x20);
-
-				while (commands && !bKnown)
-				{
-					if (str)
-					{
-						if (__strnCmp(term->rx_line, commands->cmd, (u16) (str - term->rx_line)) == 0)
-						{
-							if (commands->func) (commands->func) (term, term->rx_line, str);
-							bKnown = __TRUE;
-						}
-
-					} else {
-						/* No parameters, command must exactly match */
-						if (__strCmp(term->rx_line, commands->cmd) == 0)
-						{
-							if (commands->func) (commands->func) (term, term->rx_line, __NULL);
-							bKnown = __TRUE;
-						}
-					}
-
-					commands = commands->next;
-				}
+				command = __terminalFindCommand(term, term->argv[0]);
 
-				/* Unknown Command? */
-				if (bKnown == __FALSE)
+				if (command)
 				{
+					/* The line from the command, parameters after the first space */
+					str = term->rx_line + (term->argv[0] - term->arg_line);
+					if (command->func) (command->func) (term, str, __strChr(str, 0x20));
+				} else {
 					__terminalWriteLine(term, "Unknown Command\r\n");
 				}
 			}
 			
 			__terminalShowPrompt(term);
 		}
-		
-		__threadSleep(1);
 	}
 }
 
@@ -697,6 +890,13 @@ __BOOL __terminalStart(__PTERMINAL term)
 		if (!term->dv_out->dv_initd || !term->dv_out->dv_opcnt) return __FALSE;
 	}
 
+	/* Terminal filled by the caller? */
+	if (term->dv_in && !term->arg_line)
+	{
+		term->arg_line = __heapAllocZero(term->linelen);
+		if (!term->arg_line) return __FALSE;
+	}
+
 	term->flags |= __TERMINAL_STARTED;
 
 	/* Is the device has not an input device, do not start the terminal "read" thread */
@@ -829,6 +1029,16 @@ __PTERMINAL __terminalCreate(__PSTRING name, __PDEVICE in, __PDEVICE out, u16 li
 		return __NULL;
 	}
 
+	/* Allocate the line split into arguments */
+	term->arg_line = __heapAllocZero(linelen);
+	if (!term->arg_line)
+	{
+		__heapFree(term->rx_line);
+		__heapFree(term->tx_line);
+		__heapFree(term);
+		return __NULL;
+	}
+
 	/* If an output device is provided, create a lock
 	 * for writing */
 	if (out)
@@ -836,9 +1046,10 @@ __PTERMINAL __terminalCreate(__PSTRING name, __PDEVICE in, __PDEVICE out, u16 li
 		term->lock = __lockCreate();
 		if (!term->lock)
 		{
-			__heapFree(term);
 			__heapFree(term->rx_line);
 			__heapFree(term->tx_line);
+			__heapFree(term->arg_line);
+			__heapFree(term);
 			return __NULL;
 		}
 	}
@@ -881,6 +1092,7 @@ __PTERMINAL __terminalCreate(__PSTRING name, __PDEVICE in, __PDEVICE out, u16 li
  * will be called.
  *
  * Different commands can be registered in a single __terminalAddCommand() call.
+ * A command registered again with the same name replaces the previous one.
  *
  * @param	term 	Pointer to a terminal.
  * @param 	cmd		Pointer to a list of __TERMINALCMD structures.
@@ -891,15 +1103,63 @@ __PTERMINAL __terminalCreate(__PSTRING name, __PDEVICE in, __PDEVICE out, u16 li
  */
 __VOID __terminalAddCommand(__PTERMINAL term, __PTERMINALCMD cmd, u8 count)
 {
+	__PTERMINALCMD* tab = __NULL;
+	__PTERMINALCMD* old = __NULL;
+	u16 max;
+	u16 pos;
 	u8 i;
 
 	if (!term || !cmd || !count) return;
 
-	for (i = 0; i < count; i++)
+	/* Grow the table out of the critical section */
+	max = (term->cmdmax) ? term->cmdmax : __TERMINAL_DEF_COMMANDS;
+	while (max < term->cmdcnt + count) max <<= 1;
+
+	if (max != term->cmdmax)
 	{
-		cmd[i].next = term->cmds;
-		term->cmds = &cmd[i];
+		tab = __heapAlloc(max * sizeof(__PTERMINALCMD));
+		if (!tab) return;
 	}
+
+	__systemDisableScheduler();
+
+	if (tab && term->cmdcnt + count > term->cmdmax)
+	{
+		if (term->cmdcnt) __memCpy(tab, term->cmdtab, term->cmdcnt * sizeof(__PTERMINALCMD));
+
+		old = term->cmdtab;
+		term->cmdtab = tab;
+		term->cmdmax = max;
+		tab = __NULL;
+	}
+
+	if (term->cmdcnt + count <= term->cmdmax)
+	{
+		for (i = 0; i < count; i++)
+		{
+			cmd[i].next = term->cmds;
+			term->cmds = &cmd[i];
+
+			pos = __terminalLowerBound(term, cmd[i].cmd, __strLen(cmd[i].cmd) + 1);
+
+			/* Same name, replace */
+			if (pos < term->cmdcnt && __strCmp(term->cmdtab[pos]->cmd, cmd[i].cmd) == 0)
+			{
+				term->cmdtab[pos] = &cmd[i];
+				continue;
+			}
+
+			__memMove(&term->cmdtab[pos + 1], &term->cmdtab[pos], (term->cmdcnt - pos) * sizeof(__PTERMINALCMD));
+			term->cmdtab[pos] = &cmd[i];
+			term->cmdcnt++;
+		}
+	}
+
+	__systemEnableScheduler();
+
+	/* Not used, or replaced */
+	if (tab) __heapFree(tab);
+	if (old) __heapFree(old);
 }
 
 /*!
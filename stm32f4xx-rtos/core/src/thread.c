@@ -23,9 +23,11 @@
 #include "thread.h"
 #include "heap.h"
 #include "event.h"
+#include "lock.h"
 #include <common/inc/common.h>
 #include <common/inc/thlist.h>
 #include <core/inc/system.h>
+#include <core/inc/profile.h>
 
 /** @addtogroup Core
   * @{
@@ -52,13 +54,46 @@ u16						__threadCount;
 /*!< @brief Exchange SP area */
 __VOLATILE pu32			__threadSp;
 
+/*!< @brief Highest priority ready thread (head of __threadReadyQueue) */
 __VOLATILE __PTHREAD	__threadReady;
+
+/*!< @brief Ready threads, by priority */
+__STATIC __THL_READYQ	__threadReadyQueue;
+
+/*!< @brief Suspended threads with a timeout, ordered by th_timeout */
 __VOLATILE __PTHREAD 	__threadSusp;
 __VOLATILE __PTHREAD	__threadSuspLast;
 
 /*!< @brief Thread available charset */
 #define __TH_CHARSET	"0123456789-abcdefghijklmnopqrstuvwxyz_"
 
+#if __CONFIG_STACK_CHECK
+/*!< @brief Next thread whose stack __threadStackCheck() checks */
+__STATIC __PTHREAD		__threadStackNext;
+#endif /* __CONFIG_STACK_CHECK */
+
+/**
+  * @}
+  */
+
+/** @defgroup Thread_PrivateMacros Private macros
+  * @{
+  */
+
+#if __CONFIG_STACK_GUARD
+/*! @brief Bytes allocated besides the stack, for aligning and for the guard region */
+#define __TH_STACKEXTRA			(8 + 2 * __TH_STACKGUARD)
+
+/*! @brief Guard region, the first __TH_STACKGUARD aligned block of the stack allocation */
+#define __threadStackGuard(th)	(((u32) (th)->th_stkptr + __TH_STACKGUARD - 1) & ~(__TH_STACKGUARD - 1))
+
+/*! @brief Lowest usable stack word, above the guard region */
+#define __threadStackBottom(th)	((pu32) (__threadStackGuard(th) + __TH_STACKGUARD))
+#else
+#define __TH_STACKEXTRA			8
+#define __threadStackBottom(th)	((pu32) (th)->th_stkptr)
+#endif /* __CONFIG_STACK_GUARD */
+
 /**
   * @}
   */
@@ -68,55 +103,147 @@ __VOLATILE __PTHREAD	__threadSuspLast;
   */
 
 /*!
- * @brief Adds a thread to the head of the of list of suspended threads.
+ * @brief Suspends a thread.
  *
  * Called from __eventWait() and __threadSleep(), with interrupts
  * disabled. Even if this function is not declared as static,
  * avoid calls to this function outside @ref Core module.
  *
- * @return Nothing.
+ * If @c th_wait is set, the thread is inserted in the list of suspended
+ * threads, ordered by the tick at which it has to be waked up. Threads
+ * waiting with no timeout are not linked to any list.
+ *
+ * @return Nothing.
  */
 __VOID __threadSuspend(__PTHREAD th, u8 newstate)
 {
 	th->th_status = newstate;
-	__thlAddSuspList(th, (__PTHREAD*) &__threadSuspLast);
-	if (!__threadSusp) __threadSusp = __threadSuspLast;
+
+	if (th->th_wait)
+	{
+		th->th_timeout = __systemGetTickCount() + th->th_wait;
+		__thlAddTimeoutList(th, (__PTHREAD*) &__threadSusp, (__PTHREAD*) &__threadSuspLast);
+	} else
+	{
+		th->th_qnext = th->th_qprev = __NULL;
+	}
 }
 
 /*!
  * @brief Removes a thread from the list suspended threads.
  *
- * Called from __threadProcessTick() and __eventSet(). Avoid user calls to this function.
+ * Called from __eventSet() and __eventSetOne(). Avoid user calls to this function.
+ * @c th_wait is set to the time left before the timeout, at least 1, so the
+ * waked up thread can tell it from a timeout.
  *
  * @return Nothing.
  */
 __VOID __threadRemoveFromSuspended(__PTHREAD th)
 {
+	i32 left;
+
+	/* Threads waiting with no timeout are not in the list */
+	if (!th->th_qprev && __threadSusp != th) return;
+
 	__thlRemoveSuspList(th, (__PTHREAD*) &__threadSusp, (__PTHREAD*) &__threadSuspLast);
+
+	left = (i32) (th->th_timeout - __systemGetTickCount());
+	th->th_wait = (left > 0) ? (u32) left : 1;
 }
 
 /*!
- * @brief Adds a thread to the head of the list of threads with the
- * __THST_READY status set.
+ * @brief Returns the ticks left before the first suspended thread times out.
  *
- * @return Nothing.
+ * Used to know how long the system can stay idle.
+ *
+ * @return The ticks left, 1 if a timeout is already due, 0 if no thread
+ * is waiting with a timeout.
+ */
+u32 __threadGetNextTimeout(__VOID)
+{
+	i32 left;
+
+	if (!__threadSusp) return 0;
+
+	left = (i32) (__threadSusp->th_timeout - __systemGetTickCount());
+	return (left > 0) ? (u32) left : 1;
+}
+
+/*!
+ * @brief Adds a thread to the ready queue, with the __THST_READY
+ * status set.
+ *
+ * The thread is queued after the ready threads of the same priority.
+ * __threadReady is updated if the thread has a higher priority than
+ * the current head.
+ *
+ * @return Nothing.
  */
 __VOID __threadAddToReadyList(__PTHREAD th)
 {
 	th->th_status = __THSTS_READY;
-	__thlAddPrioList(th, (__PTHREAD*) &__threadReady);
+	__thlAddReadyQueue(th, &__threadReadyQueue);
+
+	if (!__threadReady || th->th_priority < __threadReady->th_priority)
+	{
+		__threadReady = th;
+	}
 }
 
 /*!
- * @brief Removes a thread from the list of threads with the
- * __THST_READY set. It will automatically set __threadReady
- * the value from th->th_rdynext.
+ * @brief Removes the __threadReady thread from the ready queue
+ * and sets __threadReady to the next thread to run.
  *
  * @return Nothing.
  */
 __STATIC __VOID __threadRemoveReadyListHead(__VOID)
 {
-	__thlRemovePrioList((__PTHREAD*) &__threadReady);
+	__thlRemoveReadyQueue(__threadReady, &__threadReadyQueue);
+	__threadReady = __thlGetReadyQueueHead(&__threadReadyQueue);
+}
+
+/*!
+ * @brief Changes the running priority of a thread.
+ *
+ * Used by locks for priority inheritance, \c th_basepriority is not changed.
+ * A ready thread is moved to the ready queue of its new priority. The current
+ * thread is preempted if it no longer has the highest priority, and a ready
+ * thread preempts the current one if it got a higher priority. A thread
+ * waiting for a lock is moved to its place in the lock's priority list.
+ * Call with interrupts disabled.
+ *
+ * @param	th		Pointer to the thread.
+ * @param	prio	New priority.
+ * @return	Nothing.
+ */
+__VOID __threadSetPriority(__PTHREAD th, u32 prio)
+{
+	if (th->th_priority == prio) return;
+
+	if (th->th_status == __THSTS_READY)
+	{
+		__thlRemoveReadyQueue(th, &__threadReadyQueue);
+		th->th_priority = prio;
+		__thlAddReadyQueue(th, &__threadReadyQueue);
+		__threadReady = __thlGetReadyQueueHead(&__threadReadyQueue);
+	} else if (th->th_lockwait && (th->th_evprev || th->th_lockwait->event.ev_threads == th))
+	{
+		__thlRemoveEvtPrio(th, &th->th_lockwait->event.ev_threads);
+		th->th_priority = prio;
+		__thlAddEvtPrio(th, &th->th_lockwait->event.ev_threads);
+	} else
+	{
+		th->th_priority = prio;
+	}
+
+	if (!__threadGetCurrent() || !__threadReady || __systemSchedulerDisabled()) return;
+
+	if (__threadReady->th_priority < __threadGetCurrent()->th_priority)
+	{
+		__threadAddToReadyList(__threadGetCurrent());
+		__threadSetCurrent(__NULL);
+		__systemScheduleThreadChange();
+	}
 }
 
 /*!
@@ -232,7 +359,7 @@ __PTHREAD	__threadCreate(__CONST __PSTRING name, __THREADFUNC *func, u8 prio, u1
 	}
 
 	/* Allocate stack into the heap */
-	if ((th->th_stkptr = __heapAllocZero(stack + 8)) == __NULL)
+	if ((th->th_stkptr = __heapAllocZero(stack + __TH_STACKEXTRA)) == __NULL)
 	{
 		__heapFree(th);
 		__systemStart();
@@ -243,7 +370,14 @@ __PTHREAD	__threadCreate(__CONST __PSTRING name, __THREADFUNC *func, u8 prio, u1
 		thread is destroyed */
 
 	/* Align stack pointer address (platform dependent) */
-	th->th_sp = __cpuStackFramePointer(th->th_stkptr, stack);
+	th->th_sp = __cpuStackFramePointer((pu8) __threadStackBottom(th), stack);
+
+#if __CONFIG_STACK_CHECK
+	/* Paint the stack, __threadStackCheck() finds the deepest word written */
+	th->th_stkfree = (th->th_sp - (u32) __threadStackBottom(th)) / sizeof(u32);
+	th->th_stkscan = 0;
+	__memSet(__threadStackBottom(th), __TH_STACKPAINT, th->th_stkfree * sizeof(u32));
+#endif /* __CONFIG_STACK_CHECK */
 
 	/*	All memory allocation succeeded
 		Fill the thread struct with appropriate values */
@@ -268,6 +402,9 @@ __PTHREAD	__threadCreate(__CONST __PSTRING name, __THREADFUNC *func, u8 prio, u1
 #else
 	th->th_priority	= prio;
 #endif
+	th->th_basepriority = th->th_priority;
+	th->th_locks	= __NULL;
+	th->th_lockwait	= __NULL;
 
 	/* Sets the stack to in a way it can be unwinded at the first call (platform dependent) */
 	th->th_sp = __cpuMakeStackFrame(th->th_sp, (__PVOID) func,param);
@@ -373,7 +510,8 @@ __VOID	__threadSleep(u32 ticks)
 	__systemScheduleThreadChange();
 	__systemStart();
 
-	while (th->th_status != __THSTS_RUNNING);
+	/* Until scheduled again, this context is also the idle loop */
+	while (th->th_status != __THSTS_RUNNING) __systemIdle();
 	return;
 }
 
@@ -423,20 +561,20 @@ __PVOID	__threadGetParameter(__VOID)
 /*!
  * @brief Manages threads timing.
  *
- * Called from the main system timer to decrement the time counter of
- * slept/waiting threads. This function also sets preemption and call
+ * Called from the main system timer to wake up the slept/waiting threads
+ * whose timeout expired. Since the suspended list is ordered by timeout only
+ * its head is checked. This function also sets preemption and call
  * context switch function if necessary.
  * Avoid user calls to this function.
  *
  * @return	Nothing.
  *
- * @todo To be heavily optimized.
- *
  */
 __VOID __threadProcessTick(__VOID)
 {
-	__PTHREAD tn, th;
+	__PTHREAD th;
 	__BOOL preempt = __FALSE;
+	u32 now = __systemGetTickCount();
 
 	__systemStop();
 
@@ -445,35 +583,41 @@ __VOID __threadProcessTick(__VOID)
 	{
 		/* Decrement thread time-to-live */
 		if (--__threadGetCurrent()->th_ttl == 0) {
-			/* The current thread should be no longer in execution, set scheduler */
-			preempt = __TRUE;
+			/* Round-robin: the current thread should be no longer in execution
+			 * only if a thread with the same (or higher) priority is ready.
+			 * Otherwise it keeps running for another time slice.
+			 */
+			if (__threadReady && __threadReady->th_priority <= __threadGetCurrent()->th_priority)
+			{
+				preempt = __TRUE;
+			} else
+			{
+				__threadGetCurrent()->th_ttl = __threadGetCurrent()->th_load;
+			}
 		}
 	}
 	
-	th = tn = __threadSusp;	
-	while (tn)
+	/* Wake up the threads whose timeout expired. The system tick count
+	 * can advance by more than one tick after a tickless idle period.
+	 */
+	while ((th = __threadSusp) != __NULL && (i32) (th->th_timeout - now) <= 0)
 	{
-		th = tn;
-		tn = tn->th_qnext;
+		__thlRemoveSuspList(th, (__PTHREAD*) &__threadSusp, (__PTHREAD*) &__threadSuspLast);
+		th->th_wait = 0;
+		__threadAddToReadyList(th);
 
-		if (th->th_wait && --th->th_wait == 0)
+		/* If the thread we just woke up has a higher priority than the current thread
+		 * then we need to preempt. If the current thread is __NULL, there is no thread in
+		 * execution, so preempt.
+		 */
+		if (!preempt)
 		{
-			__threadRemoveFromSuspended(th);
-			__threadAddToReadyList(th);
-
-			/* If the thread we just woke up has a higher priority than the current thread
-			 * then we need to preempt. If the current thread is __NULL, there is no thread in
-			 * execution, so preempt.
-			 */
-			if (!preempt)
+			if (__threadGetCurrent() == __NULL)
 			{
-				if (__threadGetCurrent() == __NULL)
-				{
-					preempt = __TRUE;
-				} else
-				{
-					if (th->th_priority < __threadGetCurrent()->th_priority) preempt = __TRUE;
-				}
+				preempt = __TRUE;
+			} else
+			{
+				if (th->th_priority < __threadGetCurrent()->th_priority) preempt = __TRUE;
 			}
 		}
 	}
@@ -499,15 +643,16 @@ __VOID __threadProcessTick(__VOID)
 	__systemStart();
 }
 
-#if (__CONFIG_POST_STACK_OVERFLOW == 1) || defined(__DOXYGEN__)
+#if __CONFIG_POST_STACK_OVERFLOW || __CONFIG_STACK_GUARD || defined(__DOXYGEN__)
 /*!
  * @brief Post stack overflow detect
  *
  * Called from __threadChange() (and so from an interrupt) when the next running
  * thread stack overflowed on the previous thread change (when all the registers
- * were pushed).
+ * were pushed), or from the memory fault handler when the running thread
+ * touched its guard region. The thread can't run anymore.
  *
- * Available only if __CONFIG_POST_STACK_OVERFLOW = 1.
+ * Available only if __CONFIG_POST_STACK_OVERFLOW = 1 or __CONFIG_STACK_GUARD = 1.
  *
  * @param th	The thread with the overflowed stack.
  * @return	Nothing.
@@ -517,7 +662,7 @@ __VOID __threadPostStackOverflow(__PTHREAD th)
 {
 
 }
-#endif /* __CONFIG_POST_STACK_OVERFLOW */
+#endif /* __CONFIG_POST_STACK_OVERFLOW || __CONFIG_STACK_GUARD */
 
 /*!
  * @brief Thread change routine.
@@ -533,18 +678,26 @@ __VOID __threadChange(__VOID)
 	if (!__threadReady)
 	{
 		/* going idle */
+		__PROF_SWITCH(__NULL);
 		__threadSetCurrent(__NULL);
 		__cpuIdleIn();
 		return;
 	}
 
 #if __CONFIG_POST_STACK_OVERFLOW
-	if (__threadReady->th_sp < (u32) __threadReady->th_stkptr)
+	if (__threadReady->th_sp < (u32) __threadStackBottom(__threadReady))
 	{
-		__threadPostStackOverflow();
+		__threadPostStackOverflow(__threadReady);
 	}
 #endif /* #ifdef __CONFIG_POST_STACK_OVERFLOW */
 
+#if __CONFIG_STACK_GUARD
+	/* Only the running thread stack is guarded */
+	__cpuStackGuard(__threadStackGuard(__threadReady));
+#endif /* __CONFIG_STACK_GUARD */
+
+	__PROF_SWITCH(__threadReady);
+
 	__threadSetCurrent(__threadReady);
 	__threadSp = &__threadReady->th_sp;
 	__threadReady->th_ttl = __threadReady->th_load;
@@ -628,6 +781,121 @@ __PTHREAD	__threadGetChain(__VOID)
 	return __threadChain;
 }
 
+#if __CONFIG_STACK_CHECK || defined(__DOXYGEN__)
+
+/*!
+ * @brief Checks up to \c budget words of a thread stack, from the bottom.
+ *
+ * The unused stack keeps the paint of __threadCreate(), and the stack only
+ * grows down: the first written word from the bottom is the high-water mark.
+ * Words above \c th_stkfree were already seen written, so each round checks
+ * the words from the bottom up to \c th_stkfree, over several calls, then
+ * starts again.
+ *
+ * Internal use.
+ * @param	th		Thread.
+ * @param	budget	Words to check at most.
+ * @return	The words checked.
+ */
+__STATIC u32 __threadStackScan(__PTHREAD th, u32 budget)
+{
+	pu32 stk = __threadStackBottom(th);
+	u32 start = th->th_stkscan;
+	u32 end = start + budget;
+	u32 i;
+
+	if (end > th->th_stkfree) end = th->th_stkfree;
+
+	for (i = start; i < end && stk[i] == __TH_STACKPAINT * 0x01010101UL; i++);
+
+	if (i < end)
+	{
+		/* The stack grew down to here */
+		th->th_stkfree = i;
+		th->th_stkscan = 0;
+		return i - start + 1;
+	}
+
+	th->th_stkscan = (i == th->th_stkfree) ? 0 : i;
+	return i - start;
+}
+
+/*!
+ * @brief Bytes of the thread stack used when the thread was switched out.
+ *
+ * @param	th		Thread.
+ * @return	The bytes used, zero if unknown.
+ */
+u32 __threadStackUsed(__PTHREAD th)
+{
+	u32 bottom = (u32) __threadStackBottom(th);
+	u32 top = __cpuStackFramePointer((pu8) bottom, th->th_stksize);
+
+	/* The host simulator runs the threads on other stacks */
+	if (th->th_sp < bottom || th->th_sp > top) return 0;
+
+	return top - th->th_sp;
+}
+
+/*!
+ * @brief Most bytes of the thread stack used, as found by __threadStackCheck().
+ *
+ * @param	th		Thread.
+ * @return	The bytes used at most.
+ */
+u32 __threadStackPeak(__PTHREAD th)
+{
+	return th->th_stksize - th->th_stkfree * sizeof(u32);
+}
+
+/*!
+ * @brief Stack size to create the thread with: the peak use, plus
+ * __CONFIG_STACK_CHECK_MARGIN percent, rounded up to 8 bytes.
+ *
+ * Meaningful once the thread ran through its deepest path.
+ *
+ * @param	th		Thread.
+ * @return	The stack size, at least __TH_MINSTACKSIZE.
+ */
+u32 __threadStackSuggest(__PTHREAD th)
+{
+	u32 size = __threadStackPeak(th);
+
+	size = (size + size * __CONFIG_STACK_CHECK_MARGIN / 100 + 7) & ~7;
+
+	return (size < __TH_MINSTACKSIZE) ? __TH_MINSTACKSIZE : size;
+}
+
+/*!
+ * @brief Checks up to __CONFIG_STACK_CHECK_WORDS words of the thread stacks,
+ * going on with the next call.
+ *
+ * Called by the system thread. Threads are never unlinked from the chain
+ * (__threadMaintenance() is not called), so the chain is walked without
+ * stopping the system.
+ *
+ * @return	Nothing.
+ */
+__VOID __threadStackCheck(__VOID)
+{
+	__PTHREAD th;
+	u32 budget, cnt;
+
+	/* Each thread at most once, their stacks can be fully checked already */
+	for (budget = __CONFIG_STACK_CHECK_WORDS, cnt = __threadCount; budget && cnt; cnt--)
+	{
+		if (!__threadStackNext) __threadStackNext = __threadChain;
+
+		th = __threadStackNext;
+		budget -= __threadStackScan(th, budget);
+
+		/* Round ended, next thread */
+		if (!th->th_stkscan) __threadStackNext = (__PTHREAD) th->th_lstnext;
+	}
+}
+
+#endif /* __CONFIG_STACK_CHECK */
+
 /*!
  * @brief Maintenance tasks.
  *
@@ -663,6 +931,10 @@ __VOID __threadMaintenance(__VOID)
 				/* Get the next thread in chain */
 				next = (__PTHREAD) th->th_lstnext;
 
+#if __CONFIG_STACK_CHECK
+				if (__threadStackNext == th) __threadStackNext = next;
+#endif /* __CONFIG_STACK_CHECK */
+
 				/* Free __PTHREAD */
 				__heapFree(th);
 
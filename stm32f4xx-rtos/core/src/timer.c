@@ -23,6 +23,7 @@
 #include "timer.h"
 #include "thread.h"
 #include "heap.h"
+#include "event.h"
 #include <core/inc/system.h>
 
 /** @addtogroup Core
@@ -32,20 +33,37 @@
 /** @defgroup Timer Timers
   * Timer functions.
   *
-  * All the timers will be called from a single thread. There is a list of callback functions that will
-  * be called from __timerDispatch() function. Note that these timers will not be as accurate as a hardware
-  * timer: it depends on the system tick granularity, the count down value will be calculated in __systemSleep(1)
-  * steps, so it also depends on the __timerThread() thread priority.
+  * All the timers will be called from a single thread, __timerThread(), never from the system
+  * tick interrupt. Armed timers are kept in a pairing heap ordered by expiry tick: arming a timer
+  * (and restarting a periodic one) is a constant time meld, and the thread sleeps on an event
+  * until the earliest expiry, or until an earlier timer is armed. Periodic timers are reloaded
+  * from their previous expiry, so they do not drift with the dispatch latency.
+  * Note that these timers will not be as accurate as a hardware timer: they depend on the system
+  * tick granularity and on the __timerThread() thread priority.
+  * The timer functions must be called from threads.
   * @{
   */
 
+/** @defgroup Timer_PrivateMacros Private macros
+  * @{
+  */
+
+/*! @brief Timer \c a expires before timer \c b (wrap-safe) */
+#define __timerBefore(a, b)		((i32) ((a)->ti_time - (b)->ti_time) < 0)
+
+/**
+  * @}
+  */
+
 /** @defgroup Timer_PrivateVariables Private variables
   * @{
   */
 
-__PTIMER		__timerChain = __NULL;		/*!< @brief Timer list chain */
+__PTIMER		__timerRoot = __NULL;		/*!< @brief Root of the armed timers heap */
+u32				__timerCount = 0;			/*!< @brief Created timers */
 u32				__timerStack = 0;			/*!< @brief Timer stack size */
 __PTHREAD		__timerThreadPtr = __NULL;	/*!< @brief Timer thread */
+__EVENT			__timerEvent;				/*!< @brief Wakes up the timer thread */
 
 /**
   * @}
@@ -56,33 +74,145 @@ __PTHREAD		__timerThreadPtr = __NULL;	/*!< @brief Timer thread */
   */
 
 /*!
- * @brief Finds a given timer through the list.
+ * @brief Melds two timer heaps.
+ *
+ * Internal use, called with the scheduler disabled. The root expiring
+ * later becomes the first child of the other one.
+ *
+ * @param a		Root of a heap, can be __NULL.
+ * @param b		Root of a heap, can be __NULL.
+ * @return The root of the melded heap.
+ */
+__STATIC __PTIMER __timerMeld(__PTIMER a, __PTIMER b)
+{
+	__PTIMER t;
+
+	if (!a) return b;
+	if (!b) return a;
+
+	if (__timerBefore(b, a))
+	{
+		t = a;
+		a = b;
+		b = t;
+	}
+
+	b->ti_prev = a;
+	b->ti_next = a->ti_child;
+	if (a->ti_child) a->ti_child->ti_prev = b;
+	a->ti_child = b;
+
+	return a;
+}
+
+/*!
+ * @brief Melds a list of sibling heaps into a single heap.
+ *
+ * Internal use, called with the scheduler disabled. Standard two-pass
+ * pairing: siblings are melded by pairs from left to right, then the
+ * pairs are melded from right to left.
+ *
+ * @param first		First sibling (the list follows \c ti_next).
+ * @return The root of the new heap.
+ */
+__STATIC __PTIMER __timerMergePairs(__PTIMER first)
+{
+	__PTIMER a;
+	__PTIMER b;
+	__PTIMER next;
+	__PTIMER list = __NULL;
+
+	while (first)
+	{
+		a = first;
+		b = a->ti_next;
+		next = (b) ? b->ti_next : __NULL;
+
+		a->ti_prev = a->ti_next = __NULL;
+		if (b)
+		{
+			b->ti_prev = b->ti_next = __NULL;
+			a = __timerMeld(a, b);
+		}
+
+		/* Pairs are pushed in reverse order */
+		a->ti_next = list;
+		list = a;
+		first = next;
+	}
+
+	while (list)
+	{
+		next = list->ti_next;
+		list->ti_next = __NULL;
+		first = __timerMeld(first, list);
+		list = next;
+	}
+
+	return first;
+}
+
+/*!
+ * @brief Removes an armed timer from the heap.
  *
- * @param ti	Pointer to a timer handle to verify.
- * @return __TRUE if the timer was found in the list, otherwise __FALSE.
- *
+ * Internal use, called with the scheduler disabled.
+ *
+ * @param ti	Pointer to the timer.
+ * @return Nothing.
  */
-__STATIC __BOOL __timerFind(__PTIMER ti)
+__STATIC __VOID __timerRemove(__PTIMER ti)
 {
-	__PTIMER	tr = __timerChain;
+	if (ti == __timerRoot)
+	{
+		__timerRoot = __timerMergePairs(ti->ti_child);
+	} else
+	{
+		/* ti_prev is the parent for a first child, the left sibling otherwise */
+		if (ti->ti_prev->ti_child == ti)
+		{
+			ti->ti_prev->ti_child = ti->ti_next;
+		} else
+		{
+			ti->ti_prev->ti_next = ti->ti_next;
+		}
 
-	if (ti == __NULL) return(__FALSE);
-	while (tr) {
-		if (tr == ti) return(__TRUE);
-		tr = (__PTIMER) tr->ti_next;
+		if (ti->ti_next) ti->ti_next->ti_prev = ti->ti_prev;
+
+		__timerRoot = __timerMeld(__timerRoot, __timerMergePairs(ti->ti_child));
 	}
-	return(__FALSE);
+
+	ti->ti_child = ti->ti_prev = ti->ti_next = __NULL;
+}
+
+/*!
+ * @brief Arms a timer to expire \c ti_load ticks from now.
+ *
+ * Internal use, called with the scheduler disabled.
+ *
+ * @param ti	Pointer to the timer, not armed.
+ * @return __TRUE if the timer is now the first to expire.
+ */
+__STATIC __BOOL __timerArm(__PTIMER ti)
+{
+	ti->ti_time = __systemGetTickCount() + ti->ti_load;
+	ti->ti_child = ti->ti_prev = ti->ti_next = __NULL;
+	ti->ti_state &= ~__TM_STOPPED;
+
+	__timerRoot = __timerMeld(__timerRoot, ti);
+	return (__timerRoot == ti);
 }
 
 /*!
- * @brief Creates and allocates a timer and adds it to the __timerChain list.
+ * @brief Creates and allocates a timer and arms it.
  *
- * When the time provided elapses, the __timerDispatch() function will call the
+ * When the time provided elapses, the __timerThread() thread will call the
  * __TIMERFUNC() function.
  *
  * @param type	Timer type.
  * @arg	__TM_NORMAL: normal timer.
- * @arg	__TM_ONESHOT: one-shot. Timer will be deleted after the first execution.
+ * @arg	__TM_ONESHOT: one-shot. Timer will be deleted after the first execution,
+ * 		unless its function arms it again with __timerStart(). The handle is not
+ * 		valid once the function returns.
  * @param time	Time-out value, in system ticks units (ussualy milliseconds).
  * @param func	Pointer to a __TIMERFUNC() function.
  * @param param	Optional parameter to be passed to the __TIMERFUNC() function.
@@ -92,21 +222,24 @@ __STATIC __BOOL __timerFind(__PTIMER ti)
 __PTIMER __timerCreate(u8 type, u32 time, __TIMERFUNC *func, __PVOID param)
 {
 	__PTIMER	ti;
+	__BOOL		first;
 
 	if (time < 1 || func == __NULL || type > 1) return(__NULL);
 	if ((ti = __heapAlloc(sizeof(__TIMER))) == __NULL) return(__NULL);
 
 	ti->ti_type					= type;
 	ti->ti_state				= __TM_READY;
-	ti->ti_time = ti->ti_load	= time;
+	ti->ti_load					= time;
 	ti->ti_param				= param;
 	ti->ti_func					= func;
 
-	/* Chain to list */
-	__systemStop();
-	ti->ti_next = __timerChain;
-	__timerChain = ti;
-	__systemStart();
+	__systemDisableScheduler();
+	first = __timerArm(ti);
+	__timerCount++;
+	__systemEnableScheduler();
+
+	/* Sleeping until a later expiry? */
+	if (first) __eventSet(&__timerEvent);
 
 	return(ti);
 }
@@ -114,92 +247,172 @@ __PTIMER __timerCreate(u8 type, u32 time, __TIMERFUNC *func, __PVOID param)
 /*!
  * @brief Destroy a timer.
  *
- * Call this function to destroy a timer. The timer is not immediately
- * destroyed, but flagged to do so. The __timerMaintenance() function
- * (called from the timers thread __timerThread() function)
- * will delete all flagged timers.
+ * Call this function to destroy a timer. The timer is disarmed and freed.
+ * If its function is running (the timer is destroyed from its own function),
+ * the timer is freed by the timer thread when the function returns.
  *
  * @param	ti		Pointer to a timer to destroy.
  * @return	__TRUE on success, otherwise __FALSE.
- *
+ *
  */
 __BOOL __timerDestroy(__PTIMER ti)
 {
-	if (__timerFind(ti) == __TRUE)
+	if (!ti || (ti->ti_state & __TM_DELETE)) return(__FALSE);
+
+	__systemDisableScheduler();
+
+	if (!(ti->ti_state & __TM_STOPPED)) __timerRemove(ti);
+	ti->ti_state |= __TM_STOPPED | __TM_DELETE;
+
+	if (ti->ti_state & __TM_INUSE)
 	{
-		ti->ti_type |= __TM_DELETE;
+		__systemEnableScheduler();
 		return(__TRUE);
 	}
-	return(__FALSE);
+
+	__timerCount--;
+	__systemEnableScheduler();
+
+	__heapFree(ti);
+	return(__TRUE);
+}
+
+/*!
+ * @brief (Re)starts a timer.
+ *
+ * The timer expires \c time ticks from now, and then every \c time ticks
+ * if it is periodic.
+ *
+ * @param	ti		Pointer to a timer.
+ * @param	time	New time-out value, zero to keep the current one.
+ * @return	__TRUE on success, otherwise __FALSE.
+ */
+__BOOL __timerStart(__PTIMER ti, u32 time)
+{
+	__BOOL first;
+
+	if (!ti || (ti->ti_state & __TM_DELETE)) return(__FALSE);
+
+	__systemDisableScheduler();
+
+	if (!(ti->ti_state & __TM_STOPPED)) __timerRemove(ti);
+	if (time) ti->ti_load = time;
+	first = __timerArm(ti);
+
+	__systemEnableScheduler();
+
+	if (first) __eventSet(&__timerEvent);
+	return(__TRUE);
+}
+
+/*!
+ * @brief Stops a timer. It can be armed again with __timerStart().
+ *
+ * @param	ti		Pointer to a timer.
+ * @return	__TRUE on success, otherwise __FALSE.
+ */
+__BOOL __timerStop(__PTIMER ti)
+{
+	if (!ti || (ti->ti_state & __TM_DELETE)) return(__FALSE);
+
+	__systemDisableScheduler();
+
+	if (!(ti->ti_state & __TM_STOPPED))
+	{
+		__timerRemove(ti);
+		ti->ti_state |= __TM_STOPPED;
+	}
+
+	__systemEnableScheduler();
+	return(__TRUE);
+}
+
+/*!
+ * @brief Returns the quantity of created timers.
+ *
+ * @return The timers count.
+ */
+u32 __timerGetCount(__VOID)
+{
+	return __timerCount;
 }
 
 /*!
  * @brief Timer dispatching.
  *
  * This function will be called from the timers thread (__timerThread() function).
- * It will check if the timer has gone into time-out and will call the registered
- * __TIMERFUNC() function. Avoid calls to this function.
+ * It calls the registered __TIMERFUNC() function of every expired timer, the
+ * earliest first. Periodic timers are armed again before calling the function,
+ * one-shot timers are freed after it unless the function armed them again.
+ * Avoid calls to this function.
  *
- * @return Nothing.
+ * @return Ticks until the next expiry, zero if no timer is armed.
  *
  */
-__VOID __timerDispatch(__VOID)
+__STATIC u32 __timerDispatch(__VOID)
 {
-	__PTIMER	ti = __timerChain;
-	__PTIMER	tb = __NULL;
+	__PTIMER	ti;
+	u32			now;
 
-	/* Cycle through timers */
-	while (ti)
+	for (;;)
 	{
-		/* Ready? */
-		if (ti->ti_state == __TM_READY)
+		__systemDisableScheduler();
+
+		now = __systemGetTickCount();
+		ti = __timerRoot;
+
+		/* Nothing expired? */
+		if (!ti || (i32) (ti->ti_time - now) > 0) break;
+
+		__timerRoot = __timerMergePairs(ti->ti_child);
+		ti->ti_child = ti->ti_prev = ti->ti_next = __NULL;
+
+		if (ti->ti_type == __TM_ONESHOOT)
 		{
-			/* Timeout? */
-			if (--ti->ti_time == 0)
+			ti->ti_state |= __TM_STOPPED;
+		} else
+		{
+			/* Next period from the last expiry, skipping the missed ones */
+			do
 			{
-				ti->ti_state = __TM_INUSE;
-				/* Call provided function */
-				(*ti->ti_func)(ti->ti_param);
-				if (ti->ti_type == __TM_ONESHOOT)
-				{
-					/* Delete */
-					ti->ti_state |= __TM_DELETE;
-				} else
-				{
-					/* Refresh time-out value */
-					ti->ti_time = ti->ti_load;
-					ti->ti_state = __TM_READY;
-				}
-			}
+				ti->ti_time += ti->ti_load;
+			} while ((i32) (ti->ti_time - now) <= 0);
+
+			__timerRoot = __timerMeld(__timerRoot, ti);
 		}
 
-		/* Flagged to delete? */
-		if (ti->ti_state == __TM_DELETE)
+		ti->ti_state |= __TM_INUSE;
+		__systemEnableScheduler();
+
+		/* Call provided function */
+		(*ti->ti_func)(ti->ti_param);
+
+		__systemDisableScheduler();
+		ti->ti_state &= ~__TM_INUSE;
+
+		/* Destroyed from its own function, or one-shot not armed again? */
+		if ((ti->ti_state & __TM_DELETE) || (ti->ti_type == __TM_ONESHOOT && (ti->ti_state & __TM_STOPPED)))
 		{
-			if (!tb) {
-				__systemStop();
-				__timerChain = __NULL;
-				__systemStart();
-				__heapFree(ti);
-				return;
-			} else
-			{
-				tb->ti_next = ti->ti_next;
-				__heapFree(ti);
-				ti = tb->ti_next;
-			}
-		} else {
-			tb = ti;
-			ti = (__PTIMER) ti->ti_next;
+			__timerCount--;
+			__systemEnableScheduler();
+			__heapFree(ti);
+		} else
+		{
+			__systemEnableScheduler();
 		}
 	}
+
+	now = (ti) ? ti->ti_time - now : 0;
+	__systemEnableScheduler();
+
+	return now;
 }
 
 /*!
  * @brief Timers thread.
  *
- * Timers thread function. Will maintain and poll every timer created with the
- * __timerCreate() function.
+ * Timers thread function. Calls the functions of the expired timers, then
+ * sleeps until the next expiry or until an earlier timer is armed.
  *
  * @return Nothing.
  *
@@ -208,8 +421,9 @@ __VOID __timerThread(__VOID)
 {
 	for(;;)
 	{
-		__timerDispatch();
-		__threadSleep(1);
+		/* Reset before dispatching, so a timer armed from now on wakes us */
+		__eventReset(&__timerEvent);
+		__eventWait(&__timerEvent, __timerDispatch());
 	}
 
 }
@@ -222,13 +436,17 @@ __VOID __timerThread(__VOID)
  *
  * @param stksize	Size of the timers thread stack.
  * @return Nothing.
- *
+ *
  */
 
 __VOID __timerInit(u32 stksize)
 {
 	if (!__timerThreadPtr)
 	{
+		__timerEvent.ev_state = __EV_RESET;
+		__timerEvent.ev_threads = __NULL;
+		__timerEvent.ev_links = __NULL;
+
 		__timerStack = stksize;
 		__timerThreadPtr = __threadCreate("timer", __timerThread, __CONFIG_PRIO_TIMTHREAD, __timerStack, 1, __NULL);
 	}
@@ -0,0 +1,345 @@
+/***************************************************************************
+ * work.c
+ * (C) 2010 Ivan Meleca
+ * Based on original code written by Ruben Meleca
+ * www.milos.it
+
+#   This program is free software; you can redistribute it and/or modify
+#   it under the terms of the GNU General Public License as published by
+#   the Free Software Foundation; either version 2 of the License, or
+#   (at your option) any later version.
+#
+#   This program is distributed in the hope that it will be useful,
+#   but WITHOUT ANY WARRANTY; without even the implied warranty of
+#   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#   GNU General Public License for more details.
+#
+#   You should have received a copy of the GNU General Public License
+#   along with this program; if not, write to the Free Software
+#   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+***************************************************************************/
+
+#include "work.h"
+#include "system.h"
+#include "heap.h"
+#include <common/inc/mem.h>
+
+#if __CONFIG_COMPILE_WORK
+
+/** @addtogroup Core
+  * @{
+  */
+
+/** @defgroup Work Work queues
+  * @brief Functions deferred from interrupt handlers to threads.
+  *
+  * An interrupt handler should only acknowledge the peripheral and move the
+  * data: the rest (parsing, waking up the application, starting the next
+  * transfer) can run later in a thread, with interrupts enabled. The handler
+  * fills a __WORK item with a function and its argument and calls
+  * __workSubmit(), which only links the item with an exclusive access: no lock
+  * is taken and interrupts stay enabled. The thread of the queue calls the
+  * functions in submission order.
+  *
+  * __workInit() creates two system queues, __WORK_HIGH and __WORK_LOW, served
+  * at __CONFIG_PRIO_WORKHIGH and __CONFIG_PRIO_WORKLOW; __workQueueCreate()
+  * adds queues at other priorities. A function can sleep, but it delays the
+  * other items of its queue.
+  *
+  * A __DELAYED_WORK item is submitted by a timer of the @ref Timer service when
+  * its delay expires (__workSubmitDelayed(), thread context only). The timer is
+  * periodic and stopped from its function, so it is kept for the next delay: a
+  * one shot timer would be freed.
+  *
+  * @{
+  */
+
+/** @defgroup Work_PrivateVariables Private variables
+  * @{
+  */
+
+__PWORKQUEUE __workQueues[__WORK_QUEUES];		/*!< @brief System queues */
+__STATIC __PWORKQUEUE __workQueueList = __NULL;	/*!< @brief Created queues */
+
+/**
+  * @}
+  */
+
+/** @defgroup Work_Functions Functions
+  * @{
+  */
+
+/*!
+ * @brief Worker thread, one for each queue (the thread parameter).
+ *
+ * Takes every submitted item at once, then calls them oldest first.
+ *
+ * Internal use.
+ * @return Nothing.
+ */
+__STATIC __VOID __workThread(__VOID)
+{
+	__PWORKQUEUE wq = __threadGetParameter();
+	__PWORK wk, next, list;
+	u32 head, cnt;
+
+	for (;;)
+	{
+		__eventWait(&wq->wq_event, 0);
+		__eventReset(&wq->wq_event);
+
+		do
+		{
+			head = __cpuLoadExclusive(&wq->wq_head);
+		} while (__cpuStoreExclusive(0, &wq->wq_head));
+
+		/* Items are linked newest first */
+		for (list = __NULL, wk = (__PWORK) head, cnt = 0; wk; wk = next, cnt++)
+		{
+			next = wk->wk_next;
+			wk->wk_next = list;
+			list = wk;
+		}
+
+		if (cnt > wq->wq_batch) wq->wq_batch = cnt;
+
+		while ((wk = list) != __NULL)
+		{
+			/* The item can be submitted again from here on */
+			list = wk->wk_next;
+			wk->wk_pending = 0;
+			__cpuMemoryBarrier();
+
+			wk->wk_func(wk->wk_arg);
+			wq->wq_runs++;
+		}
+	}
+}
+
+/*!
+ * @brief Creates the system queues.
+ *
+ * Called from the system thread, before the application's entry point.
+ *
+ * @return Nothing.
+ */
+__VOID __workInit(__VOID)
+{
+	if (!__workQueues[__WORK_HIGH])
+		__workQueues[__WORK_HIGH] = __workQueueCreate("workhi", __CONFIG_PRIO_WORKHIGH, __CONFIG_STACK_WORKTHREAD);
+
+	if (!__workQueues[__WORK_LOW])
+		__workQueues[__WORK_LOW] = __workQueueCreate("worklo", __CONFIG_PRIO_WORKLOW, __CONFIG_STACK_WORKTHREAD);
+}
+
+/*!
+ * @brief Creates a work queue and its thread.
+ *
+ * Queues are never destroyed.
+ *
+ * @param	name	Thread name.
+ * @param	prio	Thread priority.
+ * @param	stack	Thread stack size.
+ * @return	The queue, or __NULL on error.
+ */
+__PWORKQUEUE __workQueueCreate(__CONST __PSTRING name, u8 prio, u16 stack)
+{
+	__PWORKQUEUE wq;
+
+	if ((wq = __heapAllocZero(sizeof(__WORKQUEUE))) == __NULL) return __NULL;
+
+	wq->wq_event.ev_state = __EV_RESET;
+	wq->wq_event.ev_threads = __NULL;
+	wq->wq_event.ev_links = __NULL;
+
+	/* The thread can start at once, the queue must be ready */
+	__systemDisableScheduler();
+
+	wq->wq_thread = __threadCreate(name, __workThread, prio, stack, 1, wq);
+	if (wq->wq_thread)
+	{
+		wq->wq_next = __workQueueList;
+		__workQueueList = wq;
+	}
+
+	__systemEnableScheduler();
+
+	if (!wq->wq_thread)
+	{
+		__heapFree(wq);
+		return __NULL;
+	}
+
+	return wq;
+}
+
+/*!
+ * @brief Returns the first created queue, see __WORKQUEUE \c wq_next.
+ *
+ * @return	The queue list.
+ */
+__PWORKQUEUE __workGetQueueList(__VOID)
+{
+	return __workQueueList;
+}
+
+/*!
+ * @brief Prepares a work item.
+ *
+ * Items can also be initialized with __WORK_INITIALIZER(). Do not call while
+ * the item is pending.
+ *
+ * @param	wk		Item.
+ * @param	func	Function to call.
+ * @param	arg		Function argument.
+ * @return Nothing.
+ */
+__VOID __workPrepare(__PWORK wk, __WORKFUNC *func, __PVOID arg)
+{
+	wk->wk_next = __NULL;
+	wk->wk_func = func;
+	wk->wk_arg = arg;
+	wk->wk_pending = 0;
+}
+
+/*!
+ * @brief Submits a work item to a queue.
+ *
+ * Can be called from interrupt handlers. An item already pending is not
+ * queued twice: its function is called once.
+ *
+ * @param	wq		Queue, __NULL for the __WORK_HIGH system queue.
+ * @param	wk		Item.
+ * @return	__TRUE if queued, __FALSE if already pending (or no queue).
+ */
+__BOOL __workSubmit(__PWORKQUEUE wq, __PWORK wk)
+{
+	u32 head;
+
+	if (!wq) wq = __workQueues[__WORK_HIGH];
+	if (!wq || !wk) return __FALSE;
+
+	/* Only one caller takes the item */
+	do
+	{
+		if (__cpuLoadExclusive(&wk->wk_pending))
+		{
+			__cpuClearExclusive();
+			return __FALSE;
+		}
+	} while (__cpuStoreExclusive(1, &wk->wk_pending));
+
+	do
+	{
+		head = __cpuLoadExclusive(&wq->wq_head);
+		wk->wk_next = (__PWORK) head;
+	} while (__cpuStoreExclusive((u32) wk, &wq->wq_head));
+
+	/* The thread is woken up once, it takes every item queued meanwhile */
+	if (!head) __eventSet(&wq->wq_event);
+
+	return __TRUE;
+}
+
+/*!
+ * @brief Delayed work item expired.
+ *
+ * Internal use, called from the timer thread.
+ * @param	param	Delayed work item.
+ * @return Nothing.
+ */
+__STATIC __VOID __workDelayExpired(__PVOID param)
+{
+	__PDELAYED_WORK dw = param;
+
+	__timerStop(dw->dw_timer);
+	__workSubmit(dw->dw_queue, &dw->dw_work);
+}
+
+/*!
+ * @brief Prepares a delayed work item.
+ *
+ * @param	dw		Item.
+ * @param	func	Function to call.
+ * @param	arg		Function argument.
+ * @return Nothing.
+ */
+__VOID __workPrepareDelayed(__PDELAYED_WORK dw, __WORKFUNC *func, __PVOID arg)
+{
+	__workPrepare(&dw->dw_work, func, arg);
+	dw->dw_queue = __NULL;
+	dw->dw_timer = __NULL;
+}
+
+/*!
+ * @brief Submits a work item after a delay.
+ *
+ * The timer of the item is created on first use (starting the timer thread
+ * if needed), and destroyed by __workDestroyDelayed(). Submitting an item
+ * whose delay is running starts the delay again. Not for interrupt handlers.
+ *
+ * @param	wq		Queue, __NULL for the __WORK_HIGH system queue.
+ * @param	dw		Item.
+ * @param	ms		Delay in milliseconds, zero submits at once.
+ * @return	__TRUE on success, otherwise __FALSE.
+ */
+__BOOL __workSubmitDelayed(__PWORKQUEUE wq, __PDELAYED_WORK dw, u32 ms)
+{
+	if (!dw) return __FALSE;
+
+	dw->dw_queue = wq;
+
+	if (!ms) return __workSubmit(wq, &dw->dw_work);
+
+	if (dw->dw_timer) return __timerStart(dw->dw_timer, ms);
+
+	__timerInit(__CONFIG_STACK_TIMTHREAD);
+	dw->dw_timer = __timerCreate(__TM_NORMAL, ms, __workDelayExpired, dw);
+
+	return (dw->dw_timer != __NULL);
+}
+
+/*!
+ * @brief Stops the delay of an item. An item already submitted stays queued.
+ *
+ * @param	dw		Item.
+ * @return	__TRUE on success, otherwise __FALSE.
+ */
+__BOOL __workCancelDelayed(__PDELAYED_WORK dw)
+{
+	if (!dw || !dw->dw_timer) return __FALSE;
+
+	return __timerStop(dw->dw_timer);
+}
+
+/*!
+ * @brief Destroys the timer of a delayed work item.
+ *
+ * The item must not be pending.
+ *
+ * @param	dw		Item.
+ * @return Nothing.
+ */
+__VOID __workDestroyDelayed(__PDELAYED_WORK dw)
+{
+	if (dw && dw->dw_timer)
+	{
+		__timerDestroy(dw->dw_timer);
+		dw->dw_timer = __NULL;
+	}
+}
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+#endif /* __CONFIG_COMPILE_WORK */
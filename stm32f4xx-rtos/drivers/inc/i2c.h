@@ -25,6 +25,7 @@
 #include <core/inc/system.h>
 #include <core/inc/intrvect.h>
 #include <core/inc/device.h>
+#include <core/inc/work.h>
 #include <plat_i2c.h>
 
 #if __CONFIG_COMPILE_I2C
@@ -175,41 +176,6 @@
  */
 #define __I2C_PLAT_ABORT				14
 
-/*!
- * @brief Queries the platform about the working mode.
- *
- * The I2C driver will call the @ref __DEV_PLAT_IOCTL function with this
- * IO control code to determine if the platform can process the requests
- * with interrupts. Otherwise the @ref I2C driver will try to work in
- * polling mode. The platform should return __DEV_OK when it is able to
- * manage the interrupts.
- */
-#define __I2C_PLAT_USE_IRQ				15
-
-/*!
- * @brief Used when the I2C driver works in interrupt mode. Instructs the
- * platform to start transmission. Called from __i2cFlush().
- */
-#define __I2C_PLAT_INIT_TX				16
-
-/*!
- * @brief Used when the I2C driver works in interrupt mode. Instructs the
- * platform to end the transmission. Called from __i2cFlush().
- */
-#define __I2C_PLAT_END_TX				17
-
-/*!
- * @brief Used when the I2C driver works in interrupt mode. Instructs the
- * platform to start reading from the device. Called from __i2cRead().
- */
-#define __I2C_PLAT_INIT_RX				18
-
-/*!
- * @brief Used when the I2C driver works in interrupt mode. Instructs the
- * platform to stop reading from the device. Called from __i2cRead().
- */
-#define __I2C_PLAT_END_RX				19
-
 /*!
  * @brief Write a single byte.
  */
@@ -222,6 +188,14 @@
  */
 #define __I2C_PLAT_READ_BYTE			21
 
+/*!
+ * @brief Starts the job passed in the \c in argument of the @ref __DEV_PLAT_IOCTL
+ * function. The platform runs the whole job with interrupts (and DMA, if
+ * available) and calls __i2cJobDone() when it ends.
+ * Called from __i2cSubmit() and from interrupts.
+ */
+#define __I2C_PLAT_JOB_START			22
+
 /**
   * @}
   */
@@ -255,6 +229,11 @@
 
 #define	__I2C_ERR_OVERFLOW		0x01	/*!< @brief Receiver buffer overflow */
 
+/*!
+ * @brief Value of \c jb_status while the job is queued or running.
+ */
+#define __I2C_JOB_PENDING		1
+
 /**
   * @}
   */
@@ -263,17 +242,40 @@
   * @{
   */
 
+typedef struct __i2cJobTag __I2C_JOB, *__PI2C_JOB;
+
+/*!
+ * @brief I2C master job.
+ *
+ * Writes \c jb_txlen bytes to the slave, then reads \c jb_rxlen bytes after a
+ * repeated START, in a single transaction. Either phase can be empty; a job
+ * with both phases empty just checks that the slave acknowledges its address.
+ * The job belongs to the driver from __i2cSubmit() until \c jb_status is no
+ * longer __I2C_JOB_PENDING.
+ */
+struct __i2cJobTag {
+	u8					jb_addr;		/*!< @brief Slave address (7-bit, without the RW bit) */
+	__CONST u8*			jb_tx;			/*!< @brief Bytes to write (i.e. register address) */
+	u16					jb_txlen;		/*!< @brief Bytes to write */
+	u8*					jb_rx;			/*!< @brief Buffer for the bytes read */
+	u16					jb_rxlen;		/*!< @brief Bytes to read */
+	__VOLATILE i8		jb_status;		/*!< @brief __I2C_JOB_PENDING, __DEV_OK, __DEV_ERROR or __DEV_TIMEOUT */
+	__PEVENT			jb_event;		/*!< @brief Optional event, set when the job ends */
+#if __CONFIG_COMPILE_WORK
+	__PWORK				jb_work;		/*!< @brief Optional item, submitted to the __WORK_HIGH queue when the job ends */
+#endif /* __CONFIG_COMPILE_WORK */
+	__PI2C_JOB			jb_next;		/*!< @brief Next queued job */
+};
+
 /*!
  * @brief I2C driver Private Data block
  */
 
 typedef struct	__i2cpdbTag {
 	u32				pd_speed;		/*!< @brief Actual bus speed */
-	u8				pd_busy;		/*!< @brief Bus busy flag */
 	__VOLATILE u8	pd_mode;		/*!< @brief Master or slave / Repeat START */
 	u32				pd_rxtmo;		/*!< @brief RX timeout */
 	__VOLATILE u8	pd_rxerr;		/*!< @brief Receiver error */
-	__VOLATILE u16	pd_rxqty;		/*!< @brief Quantity to read */
 	__VOLATILE u16	pd_rcidx;		/*!< @brief Receiver buffer index */
 	__VOLATILE u16	pd_rbidx;		/*!< @brief Read buffer index */
 	__VOLATILE u16	pd_rxcnt;		/*!< @brief Received chars count */
@@ -289,6 +291,10 @@ typedef struct	__i2cpdbTag {
 	u8				pd_ownaddr;		/*!< @brief Own address */
 	u32				pd_subaddr;		/*!< @brief Sub address when reading */
 	u8				pd_subaddrlen;	/*!< @brief Sub address length (8/16/32) */
+	__PI2C_JOB		pd_jobhead;		/*!< @brief Running job */
+	__PI2C_JOB		pd_jobtail;		/*!< @brief Last queued job */
+	__VOLATILE u8	pd_jobstate;	/*!< @brief Running job phase, managed by the platform */
+	__VOLATILE u16	pd_jobidx;		/*!< @brief Bytes done in the running job phase */
 
 } __I2C_PDB, *__PI2C_PDB;
 
@@ -316,6 +322,9 @@ i32 __i2cSize(__PDEVICE dv, u8 mode);
 i32 __i2cFlush(__PDEVICE dv);
 i32 __i2cRead(__PDEVICE dv, __PVOID buf, u16 qty);
 i32 __i2cWrite(__PDEVICE dv, __CONST __PVOID buf, u16 qty);
+i32 __i2cSubmit(__PDEVICE dv, __PI2C_JOB job);
+i32 __i2cTransfer(__PDEVICE dv, __PI2C_JOB job, u32 timeout);
+__VOID __i2cJobDone(__PDEVICE dv, i32 status);
 
 /**
   * @}
@@ -263,6 +263,7 @@ typedef struct	__serialpdbTag {
 	__VOLATILE u16	pd_txcnt;		/*!< @brief Transmit chars count */
 	__VOLATILE u16	pd_txlen;		/*!< @brief TX buffer length */
 	pu8				pd_txbuf;		/*!< @brief TX buffer */
+	__VOLATILE u16	pd_txdma;		/*!< @brief Bytes being sent by DMA, starting at \c pd_tcidx */
 
 } __SERIAL_PDB, *__PSERIAL_PDB;
 
@@ -138,6 +138,20 @@
  */
 #define __SPI_PLAT_INIT_DEFAULTS	11
 
+/*!
+ * @brief Starts the transfer of the descriptor passed in the \c in parameter.
+ * If it is the first one of a transaction (__SPI_XF_START flag), the chip-select
+ * is asserted first. The platform calls __spiXferDone() when the transfer ends.
+ * Called from __spiTransfer() and from interrupts.
+ */
+#define __SPI_PLAT_XFER_START		12
+
+/*!
+ * @brief Called from interrupts at the end of a transaction, to release
+ * the chip-select and give the bus back to __spiWrite() and __spiFlush().
+ */
+#define __SPI_PLAT_XFER_END			13
+
 /**
   * @}
   */
@@ -163,6 +177,23 @@
   * @}
   */
 
+/** @defgroup SPI_XferFlagsDefines Transfer descriptor flags
+  * @{
+  */
+
+#define __SPI_XF_NOCS			0x01	/*!< @brief Don't drive a chip-select (first descriptor only) */
+#define __SPI_XF_START			0x40	/*!< @brief First descriptor of a transaction, set by __spiTransfer() */
+#define __SPI_XF_END			0x80	/*!< @brief Last descriptor of a transaction, set by __spiTransfer() */
+
+/**
+  * @}
+  */
+
+/*!
+ * @brief Value of \c xf_status while the descriptor is queued or being transferred.
+ */
+#define __SPI_XF_PENDING		1
+
 /**
   * @}
   */
@@ -171,6 +202,35 @@
   * @{
   */
 
+typedef struct __spiXferTag __SPI_XFER, *__PSPI_XFER;
+
+/*!
+ * @brief Transfer completion callback, called from interrupts.
+ */
+typedef __VOID (__SPI_XFER_CALLBACK)(__PSPI_XFER xf);
+
+/*!
+ * @brief Transfer descriptor.
+ *
+ * A transaction is a list of descriptors linked by \c xf_next, transferred
+ * back to back with the chip-select of the first descriptor held low.
+ * The descriptors belong to the driver from __spiTransfer() until their
+ * \c xf_status is no longer __SPI_XF_PENDING.
+ */
+struct __spiXferTag {
+	__PVOID				xf_csport;		/*!< @brief Chip-select port, __NULL for the device one */
+	u32					xf_cspin;		/*!< @brief Chip-select pin */
+	__CONST u8*			xf_tx;			/*!< @brief Data to send, __NULL to send 0xFF */
+	u8*					xf_rx;			/*!< @brief Received data, __NULL to discard it */
+	u16					xf_len;			/*!< @brief Bytes to transfer */
+	u8					xf_flags;		/*!< @brief @ref SPI_XferFlagsDefines */
+	__VOLATILE i8		xf_status;		/*!< @brief __SPI_XF_PENDING, __DEV_OK or __DEV_ERROR */
+	__SPI_XFER_CALLBACK* xf_callback;	/*!< @brief Optional completion callback */
+	__PVOID				xf_arg;			/*!< @brief User argument for \c xf_callback */
+	__PEVENT			xf_event;		/*!< @brief Optional event, set on completion */
+	__PSPI_XFER			xf_next;		/*!< @brief Next descriptor of the transaction */
+};
+
 typedef struct	__spipdbTag {
 
 	u8				pd_flags;		/*!< @brief Buffer type (static or dynamic) */
@@ -190,6 +250,14 @@ typedef struct	__spipdbTag {
 	pu8				pd_txbuf;		/*!< @brief TX buffer */
 	u8				pd_asscs;		/*!< @brief CS pin assert. If 1, CS pin will be managed. */
 	u8				pd_mode;		/*!< @brief Master or slave. */
+	u8				pd_dma;			/*!< @brief Set by the platform if __spiTransfer() is supported */
+	__VOLATILE u8	pd_xfrun;		/*!< @brief The transfer engine owns the bus */
+	__VOLATILE u8	pd_fifo;		/*!< @brief __spiFlush() owns the bus */
+	__PSPI_XFER		pd_xfhead;		/*!< @brief Descriptor being transferred */
+	__PSPI_XFER		pd_xftail;		/*!< @brief Last queued descriptor */
+	__PVOID			pd_csport;		/*!< @brief Chip-select port of the running transaction */
+	u32				pd_cspin;		/*!< @brief Chip-select pin of the running transaction */
+	__EVENT			pd_xfev;		/*!< @brief Set at the end of each transaction */
 
 } __SPI_PDB, *__PSPI_PDB;
 
@@ -222,6 +290,9 @@ i32 __spiSize(__PDEVICE dv, u8 mode);
 i32 __spiFlush(__PDEVICE dv);
 i32 __spiRead(__PDEVICE dv, __PVOID buf, u16 qty);
 i32 __spiWrite(__PDEVICE dv, __CONST __PVOID buf, u16 qty);
+i32 __spiTransfer(__PDEVICE dv, __PSPI_XFER xf);
+i32 __spiTransferWait(__PDEVICE dv, __PSPI_XFER xf, u32 timeout);
+__VOID __spiXferDone(__PDEVICE dv, i32 status);
 
 #endif // __SPI_H__
 
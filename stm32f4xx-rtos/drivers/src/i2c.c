@@ -39,22 +39,10 @@
 
 #define __i2cEnable()			((dv->dv_plat_ioctl) (dv, __I2C_PLAT_ENABLE_DEVICE, 0, __NULL, 0, __NULL, 0))
 #define __i2cDisable()			((dv->dv_plat_ioctl) (dv, __I2C_PLAT_DISABLE_DEVICE, 0, __NULL, 0, __NULL, 0))
-#define __i2cGenerateStart()	((dv->dv_plat_ioctl) (dv, __I2C_PLAT_GENERATE_START, 0, __NULL, 0, __NULL, 0))
-#define __i2cGenerateStop()		((dv->dv_plat_ioctl) (dv, __I2C_PLAT_GENERATE_STOP, 0, __NULL, 0, __NULL, 0))
-#define __i2cWaitForEvent(x)	((dv->dv_plat_ioctl) (dv, __I2C_PLAT_CHECK_EVENT, x, __NULL, 0, __NULL, 0))
 #define __i2cAbort()			((dv->dv_plat_ioctl) (dv, __I2C_PLAT_ABORT, 0, __NULL, 0, __NULL, 0))
-#define __i2cSendAddress(x)		((dv->dv_plat_ioctl) (dv, __I2C_PLAT_SET_ADDRESS, x, __NULL, 0, __NULL, 0))
 #define __i2cSetOwnAddress(x)	((dv->dv_plat_ioctl) (dv, __I2C_PLAT_SET_OWN_ADDRESS, x, __NULL, 0, __NULL, 0))
-#define __i2cSetAck(x)			((dv->dv_plat_ioctl) (dv, __I2C_PLAT_SET_ACK, x, __NULL, 0, __NULL, 0))
-#define __i2cInitTx()			((dv->dv_plat_ioctl) (dv, __I2C_PLAT_INIT_TX, 0, __NULL, 0, __NULL, 0))
-#define __i2cEndTx()			((dv->dv_plat_ioctl) (dv, __I2C_PLAT_END_TX, 0, __NULL, 0, __NULL, 0))
-#define __i2cInitRx()			((dv->dv_plat_ioctl) (dv, __I2C_PLAT_INIT_RX, 0, __NULL, 0, __NULL, 0))
-#define __i2cEndRx()			((dv->dv_plat_ioctl) (dv, __I2C_PLAT_END_RX, 0, __NULL, 0, __NULL, 0))
-#define __i2cUsingIrq()			((dv->dv_plat_ioctl) (dv, __I2C_PLAT_USE_IRQ, 0, __NULL, 0, __NULL, 0))
-#define __i2cSetAck(x)			((dv->dv_plat_ioctl) (dv, __I2C_PLAT_SET_ACK, x, __NULL, 0, __NULL, 0))
-#define __i2cSendByte(x)		((dv->dv_plat_ioctl) (dv, __I2C_PLAT_WRITE_BYTE, x, __NULL, 0, __NULL, 0))
-#define __i2cReadByte()			((dv->dv_plat_ioctl) (dv, __I2C_PLAT_READ_BYTE, 0, __NULL, 0, __NULL, 0))
-#define __i2cCheckBusy()		if (pd->pd_busy) return __DEV_BUSY;
+#define __i2cJobStart(x)		((dv->dv_plat_ioctl) (dv, __I2C_PLAT_JOB_START, 0, x, 0, __NULL, 0))
+#define __i2cCheckBusy()		if (pd->pd_jobhead) return __DEV_BUSY;
 /**
   * @}
   */
@@ -64,23 +52,46 @@
   */
 
 /*!
- * @brief Toggles __TRUE/__FALSE the I2C internal busy flag.
+ * @brief Removes a job that didn't end in time.
+ *
+ * A running job is aborted, resetting the peripheral.
  *
  * @param	dv		Pointer to the I2C device structure.
- * @param 	val		Boolean value to assign to the busy flag.
+ * @param	job		Job to cancel.
  *
- * @return Nothing.
+ * @return Nothing.
  */
-__STATIC __VOID __i2cSetBusy(__PDEVICE dv, __BOOL val)
+__STATIC __VOID __i2cCancel(__PDEVICE dv, __PI2C_JOB job)
 {
 	__PI2C_PDB pd = dv->dv_pdb;
+	__PI2C_JOB prev;
 
 	__systemStop();
-	pd->pd_busy = val;
+
+	if (job->jb_status == __I2C_JOB_PENDING)
+	{
+		if (pd->pd_jobhead == job)
+		{
+			__i2cAbort();
+			__i2cJobDone(dv, __DEV_TIMEOUT);
+		} else
+		{
+			for (prev = pd->pd_jobhead; prev && prev->jb_next != job; prev = prev->jb_next);
+
+			if (prev)
+			{
+				prev->jb_next = job->jb_next;
+				if (pd->pd_jobtail == job) pd->pd_jobtail = prev;
+			}
+
+			job->jb_next = __NULL;
+			job->jb_status = __DEV_TIMEOUT;
+		}
+	}
+
 	__systemStart();
 }
 
-
 /**
   * @}
   */
@@ -126,6 +137,8 @@ i32 __i2cInit(__PDEVICE dv, __PVOID params)
 	if (dv->dv_rxev) __memSet(dv->dv_rxev, 0, sizeof(__EVENT));
 	if (dv->dv_txev) __memSet(dv->dv_txev, 0, sizeof(__EVENT));
 
+	pd->pd_jobhead = pd->pd_jobtail = __NULL;
+
 	/* Assign buffer size and alloc */
 	if ((pd->pd_rxbuf = __heapAlloc(pd->pd_rxlen)) == __NULL) return __DEV_ERROR;
 	if ((pd->pd_txbuf = __heapAlloc(pd->pd_txlen)) == __NULL)
@@ -212,7 +225,7 @@ i32 __i2cDeinit(__PDEVICE dv)
  * @param	data		Optional data pointer.
  * @param 	len			Length of \c data.
  * @return				__DEV_OK on success, __DEV_ERROR on error, __DEV_UNK_IOCTL if the IOCTL
- * 						code is not supported, __DEV_BUSY if the bus is busy,
+ * 						code is not supported.
  *
  */
 i32 __i2cIOCtl(__PDEVICE dv, u32 cmd, u32 param, __PVOID data, u32 len)
@@ -220,8 +233,6 @@ i32 __i2cIOCtl(__PDEVICE dv, u32 cmd, u32 param, __PVOID data, u32 len)
 	__I2C_PDB* pd = dv->dv_pdb;
 	u8* ptr = (u8*) data;
 
-	__i2cCheckBusy();
-
 	switch (cmd)
 	{
 		case __IOCTL_SET_OWN_ADDR:
@@ -318,9 +329,13 @@ i32 __i2cOpen(__PDEVICE dv, u32 mode)
  */
 i32 __i2cClose(__PDEVICE dv)
 {
+	__PI2C_PDB pd = dv->dv_pdb;
+
 	/* Abort any pending transaction */
 	__i2cAbort();
 
+	while (pd->pd_jobhead) __i2cCancel(dv, pd->pd_jobhead);
+
 	/*	De-init hardware */
 	(dv->dv_plat_ioctl)(dv,	__I2C_PLAT_DEINIT_HW,
 							0, __NULL, 0, __NULL, 0);
@@ -358,119 +373,34 @@ i32 __i2cSize(__PDEVICE dv, u8 mode)
 /*!
  * @brief I2C device driver flush function.
  *
- * Flush remaining unsent bytes through the I2C bus. Called from __deviceFlush().
- * Used only if the driver is configured as a master device.
+ * Sends the TX buffer to the remote device (see __IOCTL_SET_REMOTE_ADDR) as one
+ * job, and sleeps until it ends. The buffer is emptied even on error.
+ * Called from __deviceFlush(). Used only if the driver is configured as a master
+ * device.
  *
  * @param	dv	Pointer to a device.
- * @return	__DEV_OK on success, __DEV_TIMEOUT on timeout, __DEV_ERROR on error,
- * 			__DEV_BUSY if the bus is busy.
+ * @return	__DEV_OK on success, __DEV_TIMEOUT on timeout, __DEV_ERROR on error.
  *
  */
 i32 __i2cFlush(__PDEVICE dv)
 {
-	i32 ret = __DEV_OK;
 	__I2C_PDB* pd = dv->dv_pdb;
-
-	__i2cCheckBusy();
+	__I2C_JOB job;
+	i32 ret;
 
 	/* Flush works only when configured as master */
 	if (!(pd->pd_mode & __I2C_MODE_MASTER) || !pd->pd_txcnt) return __DEV_ERROR;
 
-	__i2cSetBusy(dv, __TRUE);
-
-	/* Say the platform we're starting TX, enable device if needed */
-	__i2cEnable();
-
-	/* When using IRQs the platform should take care of the transmission */
-	if (__i2cUsingIrq() != __DEV_OK)
-	{
-		/*
-		 * Polling mode
-		 */
-
-		/* Generate START */
-		if (__i2cGenerateStart() != __DEV_OK)
-		{
-			ret = __DEV_ERROR;
-			goto ERROR;
-		}
-
-		/* Wait for START sent event */
-		if (__i2cWaitForEvent(__I2C_EVENT_MASTER_MODE) != __DEV_OK)
-		{
-			ret = __DEV_TIMEOUT;
-			goto ERROR;
-		}
-
-		/* Send address set for writing */
-		if (__i2cSendAddress(pd->pd_rmtaddr << 1) != __DEV_OK)
-		{
-			ret = __DEV_ERROR;
-			goto ERROR;
-		}
-
-		/* Wait for ACK */
-		if (__i2cWaitForEvent(__I2C_EVENT_MASTER_TX) != __DEV_OK)
-		{
-			ret = __DEV_ERROR;
-			goto ERROR;
-		}
-
-		/* Transmit buffer */
-		while (pd->pd_txcnt)
-		{
-			if (__i2cSendByte(*(pd->pd_txbuf + pd->pd_tcidx)) != __DEV_OK)
-			{
-				ret = __DEV_ERROR;
-				goto ERROR;
-			}
-
-			if (__i2cWaitForEvent(__I2C_EVENT_BYTE_TRANSMITTED) != __DEV_OK)
-			{
-				ret = __DEV_TIMEOUT;
-				goto ERROR;
-			}
-
-			if (++pd->pd_tcidx >= pd->pd_txlen) pd->pd_tcidx = 0;
-			--pd->pd_txcnt;
-		}
-
-		/* Generate STOP */
-		if (__i2cGenerateStop() != __DEV_OK)
-		{
-			ret = __DEV_ERROR;
-			goto ERROR;
-		}
-
-	} else {
-
-		/*
-		 * Using interrupts
-		 */
-
-		/* Reset TX event */
-		__eventReset(dv->dv_txev);
+	/* The buffer is emptied on each flush, so the data starts at pd_tcidx
+	 * and doesn't wrap (__i2cWrite() stops when the buffer is full). */
+	__memSet(&job, 0, sizeof(job));
+	job.jb_addr = pd->pd_rmtaddr;
+	job.jb_tx = pd->pd_txbuf + pd->pd_tcidx;
+	job.jb_txlen = pd->pd_txcnt;
 
-		/* Start TX */
-		__i2cInitTx();
+	ret = __i2cTransfer(dv, &job, pd->pd_txtmo);
 
-		/* Wait for transmission to end */
-		__eventWait(dv->dv_txev, pd->pd_txtmo);
-
-		/* Say the platform we're finishing TX */
-		__i2cEndTx();
-	}
-
-
-	__i2cDisable();
-	__i2cSetBusy(dv, __FALSE);
-	return __DEV_OK;
-
-ERROR:
-
-	/* Give the platform the chance to abort transmission */
-	__i2cAbort();
-	__i2cSetBusy(dv, __FALSE);
+	pd->pd_tcidx = pd->pd_tbidx = pd->pd_txcnt = 0;
 	return ret;
 }
 
@@ -478,9 +408,9 @@ ERROR:
  * @brief I2C device driver read function.
  *
  * Call this function to read from the I2C bus. If the driver is configured as
- * a master, the reading will take place immediately. Otherwise it will poll
- * on the I2C bus until data is received or the configured timeout value is
- * reached.
+ * a master, the reading is queued as one job, writing first the sub-address
+ * (__IOCTL_SET_REMOTE_SUBADDR) if opened with __I2C_MODE_REPEAT_START, and
+ * the calling thread sleeps until it ends.
  *
  * @param	dv			Pointer to a device.
  * @param 	buf			Pointer to a buffer to receive the data.
@@ -490,219 +420,41 @@ ERROR:
  */
 i32 __i2cRead(__PDEVICE dv, __PVOID buf, u16 qty)
 {
-	i32 ret = __DEV_OK;
 	__I2C_PDB* pd = dv->dv_pdb;
-	u8* data = (u8*) buf;
-	u16 count = 0;
+	__I2C_JOB job;
+	u8 subaddr[4];
+	u8 i;
+	i32 ret;
 
-	__i2cCheckBusy();
+	if (!qty) return __DEV_ERROR;
 
-	if (!qty || qty > pd->pd_rxlen) return __DEV_ERROR;
+	/* @TODO I2C Slave receiver */
+	if (!(pd->pd_mode & __I2C_MODE_MASTER)) return __DEV_ERROR;
 
-	if (pd->pd_mode & __I2C_MODE_MASTER)
-	{
-		/*
-		 * Master receiver
-		 */
+	__memSet(&job, 0, sizeof(job));
+	job.jb_addr = pd->pd_rmtaddr;
+	job.jb_rx = buf;
+	job.jb_rxlen = qty;
 
-		/* Enable device */
-		__i2cEnable();
+	if (pd->pd_mode & __I2C_MODE_REPEAT_START)
+	{
+		/* Check for right sub-address length */
+		if (pd->pd_subaddrlen != 8 && pd->pd_subaddrlen != 16 && pd->pd_subaddrlen != 32)
+			return __DEV_ERROR;
 
-		/* Using interrupts? */
-		if (__i2cUsingIrq() != __DEV_OK)
+		/* Most significant byte first */
+		for (i = 0; i < pd->pd_subaddrlen / 8; i++)
 		{
-			/*
-			 * Master polling mode
-			 */
-
-			/* Generate START */
-			if (__i2cGenerateStart() != __DEV_OK)
-			{
-				ret = __DEV_ERROR;
-				goto MASTER_ERROR;
-			}
-
-			/* Wait for START sent event */
-			if (__i2cWaitForEvent(__I2C_EVENT_MASTER_MODE) != __DEV_OK)
-			{
-				ret = __DEV_TIMEOUT;
-				goto MASTER_ERROR;
-			}
-
-			if (qty == 1)
-			{
-				/* qty = 1 so disable ACKs */
-				__i2cSetAck(__FALSE);
-			} else {
-				__i2cSetAck(__TRUE);
-			}
-
-			if (pd->pd_mode & __I2C_MODE_REPEAT_START)
-			{
-				/* Check for right sub-address length */
-				if (pd->pd_subaddrlen != 8 && pd->pd_subaddrlen != 16 && pd->pd_subaddrlen != 32)
-				{
-					ret = __DEV_ERROR;
-					goto MASTER_ERROR;
-				}
-
-				/* Send address set for writing */
-				if (__i2cSendAddress(pd->pd_rmtaddr << 1) != __DEV_OK)
-				{
-					ret = __DEV_ERROR;
-					goto MASTER_ERROR;
-				}
-
-				/* Wait for address ACK and master write mode */
-				if (__i2cWaitForEvent(__I2C_EVENT_MASTER_TX) != __DEV_OK)
-				{
-					ret = __DEV_ERROR;
-					goto MASTER_ERROR;
-				}
-
-				/* Send internal read address */
-				count = pd->pd_subaddrlen;
-				while (count)
-				{
-					if (__i2cSendByte((pd->pd_subaddr >> (count - 8)) & 0xFF) != __DEV_OK)
-					{
-						ret = __DEV_ERROR;
-						goto MASTER_ERROR;
-					}
-
-					count -= 8;
-
-					/* Wait for byte to be transmitted */
-					if (__i2cWaitForEvent(__I2C_EVENT_BYTE_TRANSMITTED) != __DEV_OK)
-					{
-						ret = __DEV_TIMEOUT;
-						goto MASTER_ERROR;
-					}
-				}
-
-				/* Generate a START condition a second time (__I2C_MODE_REPEAT_START flag) */
-				if (__i2cGenerateStart() != __DEV_OK)
-				{
-					ret = __DEV_ERROR;
-					goto MASTER_ERROR;
-				}
-
-				/* Wait for START sent event */
-				if (__i2cWaitForEvent(__I2C_EVENT_MASTER_MODE) != __DEV_OK)
-				{
-					ret = __DEV_TIMEOUT;
-					goto MASTER_ERROR;
-				}
-
-				/* Resume normal reading */
-			}
-
-			/* Send address set for reading */
-			if (__i2cSendAddress((pd->pd_rmtaddr << 1) | 1) != __DEV_OK)
-			{
-				ret = __DEV_ERROR;
-				goto MASTER_ERROR;
-			}
-
-			/* Wait for master receiver event */
-			if (__i2cWaitForEvent(__I2C_EVENT_MASTER_RX) != __DEV_OK)
-			{
-				ret = __DEV_TIMEOUT;
-				goto MASTER_ERROR;
-			}
-
-			/* Do the reading */
-			count = 0;
-			while (qty)
-			{
-				/* Wait to receive a byte */
-				if (__i2cWaitForEvent(__I2C_EVENT_BYTE_RECEIVED) == __DEV_OK)
-				{
-					if (qty == 2)
-					{
-						/* One byte left, disable ACKs */
-						__i2cSetAck(__FALSE);
-					}
-
-					if (qty == 1)
-					{
-						/* Finishing RX, generate STOP */
-						if (__i2cGenerateStop() != __DEV_OK)
-						{
-							ret = __DEV_ERROR;
-							goto MASTER_ERROR;
-						}
-					}
-
-					/* Read the received byte */
-					*data =__i2cReadByte();
-					data++;
-					count++;
-					qty--;
-				}
-			}
-
-			return count;
-		} else {
-
-			/*
-			 * Master receive with interrupts
-			 */
-
-			/* Reset RX event */
-			__eventReset(dv->dv_rxev);
-
-			/* Specify how many bytes are we reading in the pd_rxqty value */
-			pd->pd_rxqty = qty;
-
-			/* Say the platform to start RX */
-			__i2cInitRx();
-
-			/* Wait for transmission to end */
-			if (__eventWait(dv->dv_rxev, pd->pd_rxtmo) != __EVRET_SUCCESS)
-			{
-				ret = __DEV_TIMEOUT;
-				goto MASTER_ERROR;
-			}
-
-			/* Say the platform to end RX */
-			__i2cEndRx();
-
-			/* Reset quantity */
-			pd->pd_rxqty = 0;
-
-			/* Copy back what we have from reading */
-			count = 0;
-
-			while (count < qty)
-			{
-				if (pd->pd_rxcnt > 0)
-				{
-					*data++ = *(pd->pd_rxbuf + pd->pd_rbidx);
-					if (++pd->pd_rbidx >= pd->pd_rxlen) pd->pd_rbidx = 0;
-					--pd->pd_rxcnt;
-					++count;
-				} else break;
-			}
-
-			pd->pd_rxcnt = 0;
-			__i2cDisable();
-			__i2cSetBusy(dv, __FALSE);
-			return count;
+			subaddr[i] = (pd->pd_subaddr >> (pd->pd_subaddrlen - 8 * (i + 1))) & 0xFF;
 		}
-	} else {
-		/* @TODO I2C Slave receiver */
-		goto SLAVE_ERROR;
+
+		job.jb_tx = subaddr;
+		job.jb_txlen = pd->pd_subaddrlen / 8;
 	}
 
-MASTER_ERROR:
-	/* Say the platform we're finishing RX */
-	__i2cEndRx();
+	if ((ret = __i2cTransfer(dv, &job, pd->pd_rxtmo)) != __DEV_OK) return ret;
 
-SLAVE_ERROR:
-	__i2cDisable();
-	__i2cSetBusy(dv, __FALSE);
-	return ret;
+	return qty;
 }
 
 /*!
@@ -739,6 +491,135 @@ i32 __i2cWrite(__PDEVICE dv, __CONST __PVOID buf, u16 qty)
 	return cnt;
 }
 
+/*!
+ * @brief Queues a master job.
+ *
+ * Jobs for any slave can be queued by several threads (or interrupts) at the
+ * same time, they run in order. The function returns immediately; when the job
+ * ends its \c jb_status is updated, \c jb_event is set and \c jb_work is
+ * submitted, if any.
+ *
+ * @param	dv			Pointer to a device opened as master.
+ * @param	job			Job to queue.
+ * @return				__DEV_OK if queued, otherwise __DEV_ERROR.
+ *
+ */
+i32 __i2cSubmit(__PDEVICE dv, __PI2C_JOB job)
+{
+	__PI2C_PDB pd = dv->dv_pdb;
+
+	if (!job || !(pd->pd_mode & __I2C_MODE_MASTER)) return __DEV_ERROR;
+	if ((job->jb_txlen && !job->jb_tx) || (job->jb_rxlen && !job->jb_rx)) return __DEV_ERROR;
+
+	job->jb_status = __I2C_JOB_PENDING;
+	job->jb_next = __NULL;
+
+	__systemStop();
+
+	if (pd->pd_jobtail)
+	{
+		pd->pd_jobtail->jb_next = job;
+		pd->pd_jobtail = job;
+	} else
+	{
+		pd->pd_jobhead = pd->pd_jobtail = job;
+		__i2cJobStart(job);
+	}
+
+	__systemStart();
+
+	return __DEV_OK;
+}
+
+/*!
+ * @brief Queues a master job and sleeps until it ends.
+ *
+ * Call this function from a thread only. On timeout the job is removed from
+ * the queue (aborted, if running) and can be reused. The thread sleeps on a
+ * private event stored in \c jb_event during the call; the previous value of
+ * \c jb_event is restored, but not set, on return.
+ *
+ * @param	dv			Pointer to a device opened as master.
+ * @param	job			Job to run.
+ * @param	timeout		Maximum time to wait in milliseconds. Zero for infinite.
+ * @return				__DEV_OK on success, __DEV_ERROR on error (i.e. no ACK from
+ * 						the slave), __DEV_TIMEOUT on timeout.
+ *
+ */
+i32 __i2cTransfer(__PDEVICE dv, __PI2C_JOB job, u32 timeout)
+{
+	__EVENT done;
+	__PEVENT prev;
+	i32 ret;
+
+	if (!job) return __DEV_ERROR;
+
+	done.ev_state = __EV_RESET;
+	done.ev_threads = __NULL;
+	done.ev_links = __NULL;
+
+	/* Each caller waits on its own event, set by __i2cJobDone() */
+	prev = job->jb_event;
+	job->jb_event = &done;
+
+	if ((ret = __i2cSubmit(dv, job)) != __DEV_OK)
+	{
+		job->jb_event = prev;
+		return ret;
+	}
+
+	/* Test and wait with interrupts disabled, so the end of the job
+	 * can't be signaled in between. __eventWait() queues the thread
+	 * before enabling them.
+	 */
+	__systemStop();
+
+	ret = __EVRET_SUCCESS;
+	if (job->jb_status == __I2C_JOB_PENDING) ret = __eventWait(&done, timeout);
+
+	__systemStart();
+
+	if (ret != __EVRET_SUCCESS) __i2cCancel(dv, job);
+
+	job->jb_event = prev;
+	return job->jb_status;
+}
+
+/*!
+ * @brief Ends the running job.
+ *
+ * Called from the platform interrupt when the job started with
+ * __I2C_PLAT_JOB_START ends. Starts the next queued job.
+ *
+ * @param	dv			Pointer to a device.
+ * @param	status		Result of the job.
+ * @return				Nothing.
+ *
+ */
+__VOID __i2cJobDone(__PDEVICE dv, i32 status)
+{
+	__PI2C_PDB pd = dv->dv_pdb;
+	__PI2C_JOB job = pd->pd_jobhead;
+
+	if (!job) return;
+
+	if ((pd->pd_jobhead = job->jb_next) != __NULL)
+	{
+		__i2cJobStart(pd->pd_jobhead);
+	} else
+	{
+		pd->pd_jobtail = __NULL;
+	}
+
+	job->jb_next = __NULL;
+	job->jb_status = (i8) status;
+
+	if (job->jb_event) __eventSet(job->jb_event);
+#if __CONFIG_COMPILE_WORK
+	if (job->jb_work) __workSubmit(__NULL, job->jb_work);
+#endif /* __CONFIG_COMPILE_WORK */
+}
+
 /**
   * @}
   */
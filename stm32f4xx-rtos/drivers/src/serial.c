@@ -307,7 +307,7 @@ i32	__serialSize(__PDEVICE dv, u8 mode)
  */
 i32	__serialRead(__PDEVICE dv, __PVOID buf, u16 qty)
 {
-	u16	cnt = 0;
+	u16	cnt = 0, len;
 	__PSTRING	p = buf;
 	__PSERIAL_PDB	pd = dv->dv_pdb;
 
@@ -315,10 +315,20 @@ i32	__serialRead(__PDEVICE dv, __PVOID buf, u16 qty)
 	{
 		if (pd->pd_rxcnt > 0)
 		{
-			*p++ = *(pd->pd_rxbuf + pd->pd_rbidx);
-			if (++pd->pd_rbidx >= pd->pd_rxlen) pd->pd_rbidx = 0;
-			--pd->pd_rxcnt;
-			++cnt;
+			/* Copy the bytes available up to the end of the buffer */
+			len = pd->pd_rxlen - pd->pd_rbidx;
+			if (len > pd->pd_rxcnt) len = pd->pd_rxcnt;
+			if (len > qty - cnt) len = qty - cnt;
+
+			__memCpy(p, pd->pd_rxbuf + pd->pd_rbidx, len);
+			p += len;
+			cnt += len;
+
+			/* pd_rxcnt is also updated by the interrupt */
+			__systemStop();
+			if ((pd->pd_rbidx += len) >= pd->pd_rxlen) pd->pd_rbidx = 0;
+			pd->pd_rxcnt -= len;
+			__systemStart();
 		} else
 		{
 			if (!dv->dv_rxev) return cnt;
@@ -373,7 +383,7 @@ i32	__serialFlush(__PDEVICE dv)
  */
 i32	__serialWrite(__PDEVICE dv, __CONST __PVOID buf, u16 qty)
 {
-	u16 cnt = 0;
+	u16 cnt = 0, len;
 	u8* p = (u8*) buf;
 	__PSERIAL_PDB pd = dv->dv_pdb;
 
@@ -381,10 +391,20 @@ i32	__serialWrite(__PDEVICE dv, __CONST __PVOID buf, u16 qty)
 	{
 		if (pd->pd_txcnt < pd->pd_txlen)
 		{
-			*(pd->pd_txbuf + pd->pd_tbidx) = *p++;
-			if (++pd->pd_tbidx >= pd->pd_txlen) pd->pd_tbidx = 0;
-			++pd->pd_txcnt;
-			++cnt;
+			/* Copy to the free space up to the end of the buffer */
+			len = pd->pd_txlen - pd->pd_tbidx;
+			if (len > pd->pd_txlen - pd->pd_txcnt) len = pd->pd_txlen - pd->pd_txcnt;
+			if (len > qty - cnt) len = qty - cnt;
+
+			__memCpy(pd->pd_txbuf + pd->pd_tbidx, p, len);
+			p += len;
+			cnt += len;
+
+			/* pd_txcnt is also updated by the interrupt while sending */
+			__systemStop();
+			if ((pd->pd_tbidx += len) >= pd->pd_txlen) pd->pd_tbidx = 0;
+			pd->pd_txcnt += len;
+			__systemStart();
 		} else
 		{
 			if (__serialFlush(dv) != __DEV_OK)
@@ -67,6 +67,10 @@ i32 __spiInit(__PDEVICE dv, __PVOID params)
 
 	if (dv->dv_rxev) __memSet(dv->dv_rxev, 0, sizeof(__EVENT));
 	if (dv->dv_txev) __memSet(dv->dv_txev, 0, sizeof(__EVENT));
+	__memSet(&pd->pd_xfev, 0, sizeof(__EVENT));
+
+	pd->pd_xfhead = pd->pd_xftail = __NULL;
+	pd->pd_xfrun = pd->pd_fifo = 0;
 
 	if ((pd->pd_rxbuf = __heapAlloc(pd->pd_rxlen)) == __NULL) return __DEV_ERROR;
 	if ((pd->pd_txbuf = __heapAlloc(pd->pd_txlen)) == __NULL) {
@@ -259,6 +263,22 @@ i32 __spiFlush(__PDEVICE dv)
 	/* something to send? */
 	if (!pd->pd_txcnt) return __DEV_ERROR;
 
+	/* Take the bus from the transfer engine */
+	for (;;)
+	{
+		__systemStop();
+		if (!pd->pd_xfrun)
+		{
+			pd->pd_fifo = 1;
+			__systemStart();
+			break;
+		}
+		__eventReset(&pd->pd_xfev);
+		__systemStart();
+
+		if (__eventWait(&pd->pd_xfev, pd->pd_txtmo) != __EVRET_SUCCESS) return __DEV_TIMEOUT;
+	}
+
 	if (dv->dv_txev) __eventReset(dv->dv_txev);
 
 	/*	Init transmission */
@@ -277,6 +297,16 @@ i32 __spiFlush(__PDEVICE dv)
 	(dv->dv_plat_ioctl)(dv,	__SPI_PLAT_END_TX,  pd->pd_asscs,
 						__NULL, 0, __NULL, 0);
 
+	/* Give the bus back, start the transactions queued meanwhile */
+	__systemStop();
+	pd->pd_fifo = 0;
+	if (pd->pd_xfhead && !pd->pd_xfrun)
+	{
+		pd->pd_xfrun = 1;
+		(dv->dv_plat_ioctl)(dv, __SPI_PLAT_XFER_START, 0, pd->pd_xfhead, 0, __NULL, 0);
+	}
+	__systemStart();
+
 	return ret;
 }
 
@@ -356,6 +386,158 @@ i32 __spiWrite(__PDEVICE dv, __CONST __PVOID buf, u16 qty)
 	return cnt;
 }
 
+/*!
+ * @brief Queues a transaction.
+ *
+ * The descriptors of \c xf (linked by \c xf_next) are transferred full-duplex
+ * by DMA, back to back, keeping the chip-select of the first descriptor low for
+ * the whole transaction. Transactions are served in order, so several chip-selects
+ * can share the bus; __spiWrite() and __spiFlush() wait for the queue to drain.
+ *
+ * The function returns immediately. When a descriptor ends its \c xf_status is
+ * updated, then \c xf_callback is called and \c xf_event is set, both from the
+ * DMA interrupt. On error the rest of the transaction is skipped with the same
+ * status. Can be called from interrupts, including completion callbacks.
+ *
+ * @param	dv			Pointer to a device opened in master mode.
+ * @param	xf			First descriptor of the transaction.
+ * @return				__DEV_OK if queued, __DEV_ERROR if the device has no DMA
+ * 						or a descriptor is empty.
+ *
+ */
+i32 __spiTransfer(__PDEVICE dv, __PSPI_XFER xf)
+{
+	__PSPI_PDB pd = dv->dv_pdb;
+	__PSPI_XFER last;
+
+	if (!xf || !pd->pd_dma || pd->pd_mode != __SPIMODE_MASTER) return __DEV_ERROR;
+
+	for (last = xf; ; last = last->xf_next)
+	{
+		if (!last->xf_len) return __DEV_ERROR;
+
+		last->xf_flags &= ~(__SPI_XF_START | __SPI_XF_END);
+		last->xf_status = __SPI_XF_PENDING;
+		if (!last->xf_next) break;
+	}
+
+	xf->xf_flags |= __SPI_XF_START;
+	last->xf_flags |= __SPI_XF_END;
+
+	__systemStop();
+
+	/* The last descriptor of the previous transaction links this one until it ends */
+	if (pd->pd_xftail)
+	{
+		pd->pd_xftail->xf_next = xf;
+	} else
+	{
+		pd->pd_xfhead = xf;
+	}
+	pd->pd_xftail = last;
+
+	if (!pd->pd_xfrun && !pd->pd_fifo)
+	{
+		pd->pd_xfrun = 1;
+		(dv->dv_plat_ioctl)(dv, __SPI_PLAT_XFER_START, 0, pd->pd_xfhead, 0, __NULL, 0);
+	}
+
+	__systemStart();
+
+	return __DEV_OK;
+}
+
+/*!
+ * @brief Queues a transaction and waits for its end.
+ *
+ * Call this function from a thread only. On timeout the transaction is still
+ * queued, and its descriptors can't be reused until their \c xf_status changes.
+ *
+ * @param	dv			Pointer to a device opened in master mode.
+ * @param	xf			First descriptor of the transaction.
+ * @param	timeout		Maximum time to wait in milliseconds. Zero for infinite.
+ * @return				The status of the last descriptor, __DEV_TIMEOUT on timeout,
+ * 						or the __spiTransfer() error.
+ *
+ */
+i32 __spiTransferWait(__PDEVICE dv, __PSPI_XFER xf, u32 timeout)
+{
+	__PSPI_PDB pd = dv->dv_pdb;
+	__PSPI_XFER last;
+	i32 ret;
+
+	if ((ret = __spiTransfer(dv, xf)) != __DEV_OK) return ret;
+
+	for (last = xf; last->xf_next && !(last->xf_flags & __SPI_XF_END); last = last->xf_next);
+
+	for (;;)
+	{
+		__eventReset(&pd->pd_xfev);
+		if (last->xf_status != __SPI_XF_PENDING) return last->xf_status;
+
+		if (__eventWait(&pd->pd_xfev, timeout) != __EVRET_SUCCESS) return __DEV_TIMEOUT;
+	}
+}
+
+/*!
+ * @brief Ends the descriptor being transferred.
+ *
+ * Called from the platform interrupt when the transfer started with
+ * __SPI_PLAT_XFER_START ends. Starts the next queued descriptor, then
+ * notifies the completed ones.
+ *
+ * @param	dv			Pointer to a device.
+ * @param	status		__DEV_OK, or __DEV_ERROR to skip the rest of the transaction.
+ * @return				Nothing.
+ *
+ */
+__VOID __spiXferDone(__PDEVICE dv, i32 status)
+{
+	__PSPI_PDB pd = dv->dv_pdb;
+	__PSPI_XFER first, last, next;
+
+	first = last = pd->pd_xfhead;
+	if (!first) return;
+
+	if (status != __DEV_OK)
+	{
+		while (!(last->xf_flags & __SPI_XF_END)) last = last->xf_next;
+	}
+
+	next = last->xf_next;
+
+	if (last->xf_flags & __SPI_XF_END)
+	{
+		(dv->dv_plat_ioctl)(dv, __SPI_PLAT_XFER_END, 0, last, 0, __NULL, 0);
+		last->xf_next = __NULL;
+	}
+
+	pd->pd_xfhead = next;
+
+	if (next && !pd->pd_fifo)
+	{
+		(dv->dv_plat_ioctl)(dv, __SPI_PLAT_XFER_START, 0, next, 0, __NULL, 0);
+	} else
+	{
+		if (!next) pd->pd_xftail = __NULL;
+		pd->pd_xfrun = 0;
+	}
+
+	/* Notify, the callbacks may queue again */
+	for (;;)
+	{
+		next = (first == last) ? __NULL : first->xf_next;
+
+		first->xf_status = (i8) status;
+		if (first->xf_callback) first->xf_callback(first);
+		if (first->xf_event) __eventSet(first->xf_event);
+		if (first->xf_flags & __SPI_XF_END) __eventSet(&pd->pd_xfev);
+
+		if (!next) break;
+		first = next;
+	}
+}
+
 /**
   * @}
   */
@@ -77,6 +77,11 @@
 #define __CONFIG_HEAP_DEFRAG_TIME		30000
 #endif
 
+/*! @brief Smallest block __memCpyAsync() moves by DMA, smaller ones are copied at once */
+#if !defined(__CONFIG_MEM_DMA_THRESHOLD) || defined(__DOXYGEN__)
+#define __CONFIG_MEM_DMA_THRESHOLD		512
+#endif
+
 /*! @brief System thread priority */
 #if !defined (__CONFIG_PRIO_SYSTHREAD) || defined(__DOXYGEN__)
 #define __CONFIG_PRIO_SYSTHREAD			50
@@ -114,6 +119,61 @@
 #define __CONFIG_SYSTHREAD_SLEEP_TIME 	100
 #endif
 
+/*! @brief Stop the system tick while idle, until the next thread timeout */
+#if !defined(__CONFIG_TICKLESS_IDLE) || defined(__DOXYGEN__)
+#define __CONFIG_TICKLESS_IDLE			0
+#endif
+
+/*! @brief Measure thread CPU use, interrupts and critical sections (see @ref Profiler) */
+#if !defined(__CONFIG_PROFILER) || defined(__DOXYGEN__)
+#define __CONFIG_PROFILER				0
+#endif
+
+/*! @brief Critical section call sites tracked by the profiler */
+#if !defined(__CONFIG_PROFILER_SITES) || defined(__DOXYGEN__)
+#define __CONFIG_PROFILER_SITES			16
+#endif
+
+/*! @brief Binary log with deferred formatting (see @ref Log) */
+#if !defined(__CONFIG_LOG) || defined(__DOXYGEN__)
+#define __CONFIG_LOG					0
+#endif
+
+/*! @brief Binary log ring size, in words (power of two) */
+#if !defined(__CONFIG_LOG_WORDS) || defined(__DOXYGEN__)
+#define __CONFIG_LOG_WORDS				1024
+#endif
+
+/*! @brief Binary log modules, each with its level and drop counter */
+#if !defined(__CONFIG_LOG_MODULES) || defined(__DOXYGEN__)
+#define __CONFIG_LOG_MODULES			8
+#endif
+
+/*! @brief Initial level of the binary log modules (3 is __LOG_INFO) */
+#if !defined(__CONFIG_LOG_LEVEL) || defined(__DOXYGEN__)
+#define __CONFIG_LOG_LEVEL				3
+#endif
+
+/*! @brief Format the binary log on the debug terminal from a low priority thread */
+#if !defined(__CONFIG_LOG_THREAD) || defined(__DOXYGEN__)
+#define __CONFIG_LOG_THREAD				1
+#endif
+
+/*! @brief Log thread priority */
+#if !defined(__CONFIG_PRIO_LOGTHREAD) || defined(__DOXYGEN__)
+#define __CONFIG_PRIO_LOGTHREAD			200
+#endif
+
+/*! @brief Log thread stack */
+#if !defined(__CONFIG_STACK_LOGTHREAD) || defined(__DOXYGEN__)
+#define __CONFIG_STACK_LOGTHREAD		512
+#endif
+
+/*! @brief Time in milliseconds the log thread sleeps once the ring is empty */
+#if !defined(__CONFIG_LOG_FLUSH_TIME) || defined(__DOXYGEN__)
+#define __CONFIG_LOG_FLUSH_TIME			50
+#endif
+
 /*! @brief Terminal commands to keep in historic */
 #if !defined(__CONFIG_TERM_HIST_DEPTH) || defined(__DOXYGEN__)
 #define __CONFIG_TERM_HIST_DEPTH		3
@@ -163,6 +223,11 @@
 #define __CONFIG_COMPILE_SERIAL			1
 #endif
 
+/*! @brief Buckets of the device names hash table (power of two) */
+#if !defined(__CONFIG_DEVICE_HASH) || defined(__DOXYGEN__)
+#define __CONFIG_DEVICE_HASH			16
+#endif
+
 /*! @brief Compile spi driver */
 #if !defined(__CONFIG_COMPILE_SPI) || defined(__DOXYGEN__)
 #define __CONFIG_COMPILE_SPI			1
@@ -173,6 +238,31 @@
 #define __CONFIG_COMPILE_QUEUE			1
 #endif
 
+/*! @brief Compile fixed-size block pools module */
+#if !defined(__CONFIG_COMPILE_POOL) || defined(__DOXYGEN__)
+#define __CONFIG_COMPILE_POOL			1
+#endif
+
+/*! @brief Compile work queues, functions deferred from interrupts to threads (see @ref Work) */
+#if !defined(__CONFIG_COMPILE_WORK) || defined(__DOXYGEN__)
+#define __CONFIG_COMPILE_WORK			0
+#endif
+
+/*! @brief Priority of the __WORK_HIGH system work queue thread */
+#if !defined(__CONFIG_PRIO_WORKHIGH) || defined(__DOXYGEN__)
+#define __CONFIG_PRIO_WORKHIGH			20
+#endif
+
+/*! @brief Priority of the __WORK_LOW system work queue thread */
+#if !defined(__CONFIG_PRIO_WORKLOW) || defined(__DOXYGEN__)
+#define __CONFIG_PRIO_WORKLOW			150
+#endif
+
+/*! @brief Stack of the system work queue threads */
+#if !defined(__CONFIG_STACK_WORKTHREAD) || defined(__DOXYGEN__)
+#define __CONFIG_STACK_WORKTHREAD		512
+#endif
+
 /*! @brief Compile I2C Driver */
 #if !defined(__CONFIG_COMPILE_I2C) || defined(__DOXYGEN__)
 #define __CONFIG_COMPILE_I2C			1
@@ -188,6 +278,28 @@
 #define __CONFIG_POST_STACK_OVERFLOW	0
 #endif
 
+/*! @brief Paint the thread stacks and track their high-water marks ("stack" terminal command) */
+#if !defined(__CONFIG_STACK_CHECK) || defined(__DOXYGEN__)
+#define __CONFIG_STACK_CHECK			0
+#endif
+
+/*! @brief Stack words checked by each __threadStackCheck() pass */
+#if !defined(__CONFIG_STACK_CHECK_WORDS) || defined(__DOXYGEN__)
+#define __CONFIG_STACK_CHECK_WORDS		128
+#endif
+
+/*! @brief Margin over the peak use of the suggested stack sizes, in percent */
+#if !defined(__CONFIG_STACK_CHECK_MARGIN) || defined(__DOXYGEN__)
+#define __CONFIG_STACK_CHECK_MARGIN		25
+#endif
+
+/*! @brief Guard the bottom of the running thread stack with the MPU, faulting on overflow.
+ * A guard hit halts the system: the fault handler calls __threadPostStackOverflow()
+ * and stops with interrupts disabled, only the watchdog (if enabled) resets the board. */
+#if !defined(__CONFIG_STACK_GUARD) || defined(__DOXYGEN__)
+#define __CONFIG_STACK_GUARD			0
+#endif
+
 /*! @brief If set to any value but zero, it will force the priority
  * value of all the threads with the value defined here below. */
 #if !defined(__CONFIG_DEBUG_RR) || defined(__DOXYGEN__)
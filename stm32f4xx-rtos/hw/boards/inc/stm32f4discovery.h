@@ -27,6 +27,10 @@
 #define BOARD_SPI_RXBUFLEN				600
 #define BOARD_SPI_TXBUFLEN				600
 
+/* DMA stream for __memCpyAsync(), only DMA2 can transfer memory to memory */
+#define BOARD_MEMCPY_DMA				DMA2_Stream1
+#define BOARD_MEMCPY_DMA_IRQ			DMA2_Stream1_IRQn
+
 /* Heartbeat led */
 #define BOARD_HEARTBEAT_LED				GPIO_Pin_15
 #define BOARD_HEARTBEAT_GPIO			GPIOD
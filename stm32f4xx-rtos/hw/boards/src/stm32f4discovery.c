@@ -88,6 +88,11 @@
 #define BOARD_UART1_BUS_ADDR			RCC_APB2Periph_USART1
 #define BOARD_UART1_PORT_BUS_ADDR		RCC_AHB1Periph_GPIOA
 #define BOARD_UART1_REMAP_VALUE			0
+#define BOARD_UART1_RX_DMA				DMA2_Stream2	// __NULL for RXNE interrupts
+#define BOARD_UART1_TX_DMA				DMA2_Stream7	// __NULL for TXE interrupts
+#define BOARD_UART1_DMA_CHANNEL			DMA_Channel_4
+#define BOARD_UART1_RX_DMA_IRQ			58
+#define BOARD_UART1_TX_DMA_IRQ			70
 
 __STATIC __SERIAL_PDB serialPdb[BOARD_UART_COUNT];
 __STATIC __EVENT serialTxEvts[BOARD_UART_COUNT];
@@ -105,7 +110,12 @@ __STATIC UART_PARAMS uartParams[BOARD_UART_COUNT] = {
 		BOARD_UART1_BASE_REG,
 		BOARD_UART1_BUS_ADDR,
 		BOARD_UART1_APB_BUS,
-		BOARD_UART1_REMAP_VALUE
+		BOARD_UART1_REMAP_VALUE,
+		BOARD_UART1_RX_DMA,
+		BOARD_UART1_TX_DMA,
+		BOARD_UART1_DMA_CHANNEL,
+		BOARD_UART1_RX_DMA_IRQ,
+		BOARD_UART1_TX_DMA_IRQ
 	}
 };
 
@@ -165,6 +175,11 @@ __STATIC __DEVICE serialDevices[BOARD_UART_COUNT] = {
 #define BOARD_SPI1_CPOL					SPI_CPOL_Low
 #define BOARD_SPI1_CPHA					SPI_CPHA_1Edge
 #define BOARD_SPI1_NSS_MODE				SPI_NSS_Soft
+#define BOARD_SPI1_RX_DMA				DMA2_Stream0	// __NULL disables __spiTransfer()
+#define BOARD_SPI1_TX_DMA				DMA2_Stream3
+#define BOARD_SPI1_DMA_CHANNEL			DMA_Channel_3
+#define BOARD_SPI1_RX_DMA_IRQ			56
+#define BOARD_SPI1_TX_DMA_IRQ			59
 
 
 /*
@@ -194,6 +209,11 @@ __STATIC SPI_PARAMS spiParams[BOARD_SPI_COUNT] = {
 		BOARD_SPI1_CPOL,
 		BOARD_SPI1_CPHA,
 		BOARD_SPI1_NSS_MODE,
+		BOARD_SPI1_RX_DMA,
+		BOARD_SPI1_TX_DMA,
+		BOARD_SPI1_DMA_CHANNEL,
+		BOARD_SPI1_RX_DMA_IRQ,
+		BOARD_SPI1_TX_DMA_IRQ,
 	}
 };
 
@@ -242,6 +262,11 @@ __STATIC __DEVICE spiDevices[BOARD_SPI_COUNT] = {
 #define BOARD_I2C_PIN_SCL				GPIO_Pin_8
 #define BOARD_I2C_PIN_SDA				GPIO_Pin_9
 #define BOARD_I2C_DEFAULT_SPEED			10000
+#define BOARD_I2C_ER_IRQ				32
+#define BOARD_I2C_RX_DMA				DMA1_Stream0	// __NULL to read by interrupts
+#define BOARD_I2C_TX_DMA				DMA1_Stream6	// __NULL to write by interrupts
+#define BOARD_I2C_DMA_CHANNEL			DMA_Channel_1
+#define BOARD_I2C_RX_DMA_IRQ			11
 
 __STATIC __I2C_PDB i2cPdb[BOARD_I2C_COUNT];
 __STATIC __EVENT i2cTxEvts[BOARD_I2C_COUNT];
@@ -255,7 +280,12 @@ __STATIC I2C_PARAMS i2cParams[BOARD_I2C_COUNT] = {
 		BOARD_I2C_BASE_ADDR,
 		BOARD_I2C_BUS_ADDR,
 		BOARD_I2C_APB_NUM,
-		BOARD_I2C_DEFAULT_SPEED
+		BOARD_I2C_DEFAULT_SPEED,
+		BOARD_I2C_ER_IRQ,
+		BOARD_I2C_RX_DMA,
+		BOARD_I2C_TX_DMA,
+		BOARD_I2C_DMA_CHANNEL,
+		BOARD_I2C_RX_DMA_IRQ,
 	}
 };
 
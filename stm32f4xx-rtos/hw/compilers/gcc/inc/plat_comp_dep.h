@@ -39,6 +39,11 @@ __VOID __pcd_ZeroPSP(__VOID);
 __VOID __pcd_SetSvcPend(__VOID);
 __VOID __pcd_PendSVHandler(__VOID) __attribute__ ((naked));
 
+/*! @brief __memCpy() and __memSet() move 16 byte blocks with LDM/STM */
+#define __PCD_MEM_BLOCKS
+__VOID __pcd_MemCopyBlocks(pu32 dst, pu32 src, u32 blocks);
+__VOID __pcd_MemFillBlocks(pu32 dst, u32 fill, u32 blocks);
+
 extern unsigned long _heap_start;		/*!< @brief Start of heap, from linker file */
 extern unsigned long _heap_avail;		/*!< @brief Available heap, from linker file */
 
@@ -0,0 +1,35 @@
+/***************************************************************************
+ * host_board.h
+ * (C) 2010 Ivan Meleca
+ * Based on original code written by Ruben Meleca
+ * www.milos.it
+
+#   This program is free software; you can redistribute it and/or modify
+#   it under the terms of the GNU General Public License as published by
+#   the Free Software Foundation; either version 2 of the License, or
+#   (at your option) any later version.
+#
+#   This program is distributed in the hope that it will be useful,
+#   but WITHOUT ANY WARRANTY; without even the implied warranty of
+#   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#   GNU General Public License for more details.
+#
+#   You should have received a copy of the GNU General Public License
+#   along with this program; if not, write to the Free Software
+#   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+***************************************************************************/
+#ifndef __HOST_BOARD_H__
+#define __HOST_BOARD_H__
+
+/* Simulated interrupt lines, served after each system tick */
+#define BOARD_HOST_UART1_IRQ			1
+#define BOARD_HOST_I2C1_IRQ				2
+
+/* Heap of the simulated board */
+#define BOARD_HOST_HEAP_SIZE			(1024 * 1024)
+
+/* Stack mapped for each thread, signal frames and libc need more than the target */
+#define BOARD_HOST_STACK_SIZE			(64 * 1024)
+
+#endif // __HOST_BOARD_H__
@@ -0,0 +1,56 @@
+/***************************************************************************
+ * plat_comp_dep.h
+ * (C) 2010 Ivan Meleca
+ * Based on original code written by Ruben Meleca
+ * www.milos.it
+
+#   This program is free software; you can redistribute it and/or modify
+#   it under the terms of the GNU General Public License as published by
+#   the Free Software Foundation; either version 2 of the License, or
+#   (at your option) any later version.
+#
+#   This program is distributed in the hope that it will be useful,
+#   but WITHOUT ANY WARRANTY; without even the implied warranty of
+#   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#   GNU General Public License for more details.
+#
+#   You should have received a copy of the GNU General Public License
+#   along with this program; if not, write to the Free Software
+#   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+***************************************************************************/
+#ifndef __PLAT_COMP_DEP_H_
+#define __PLAT_COMP_DEP_H_
+
+#include <plat_ostypes.h>
+
+/** @addtogroup Platform_Host
+  * @{
+  */
+
+/** @defgroup Platform_Host_Compiler Compiler-related
+  * @{
+  */
+
+#define __pcd_EnableIRQs() 	__hostEnableInterrupts()
+#define __pcd_DisableIRQs()	(__hostIrqOff = 1)
+
+extern __VOLATILE int __hostIrqOff;		/*!< @brief Simulated PRIMASK */
+__VOID __hostEnableInterrupts(__VOID);
+
+extern u8 __hostHeap[];					/*!< @brief Heap area, in plat_cpu.c */
+
+#define __CPU_HEAP_BASE	__hostHeap[0]	/*!< @brief Define here the start of heap */
+
+/*! @brief Define here the size of heap (its address is taken, as for a linker symbol) */
+#define __CPU_HEAP_SIZE	(*(u8*) BOARD_HOST_HEAP_SIZE)
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+#endif /* __PLAT_COMP_DEP_H_ */
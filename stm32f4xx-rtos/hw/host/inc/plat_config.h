@@ -0,0 +1,90 @@
+/***************************************************************************
+ * plat_config.h
+ * (C) 2010 Ivan Meleca
+ * Based on original code written by Ruben Meleca
+ * www.milos.it
+
+#   This program is free software; you can redistribute it and/or modify
+#   it under the terms of the GNU General Public License as published by
+#   the Free Software Foundation; either version 2 of the License, or
+#   (at your option) any later version.
+#
+#   This program is distributed in the hope that it will be useful,
+#   but WITHOUT ANY WARRANTY; without even the implied warranty of
+#   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#   GNU General Public License for more details.
+#
+#   You should have received a copy of the GNU General Public License
+#   along with this program; if not, write to the Free Software
+#   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+***************************************************************************/
+#ifndef __PLAT_CONFIG_H__
+#define __PLAT_CONFIG_H__
+
+/** @addtogroup Platform
+  * @{
+  */
+
+/** @defgroup Platform_Host Host
+  * @brief POSIX host simulator.
+  *
+  * Runs the OS as a single process of a POSIX host (Linux, or any system with
+  * ucontext and setitimer), to debug the core modules and to measure them with
+  * the benchmark of the "bench" Makefile target:
+  *
+  * - Each thread runs on its own ucontext; __cpuScheduleThreadChange() pends a
+  *   swapcontext(), the equivalent of the PendSV exception.
+  * - The system tick is the SIGALRM signal of a 1 ms setitimer() timer.
+  * - __cpuDisableInterrupts() raises a flag instead of masking the signal: a
+  *   tick arriving meanwhile is left pending and served by __cpuEnableInterrupts(),
+  *   as the NVIC does.
+  * - Serial devices read stdin and write stdout.
+  *
+  * The debug terminal is not built: __strFmt() reads its arguments walking the
+  * stack as laid out by the target calling convention.
+  *
+  * The kernel stores pointers in 32 bits words (stack pointers, exclusive
+  * accesses), so on 64 bits hosts the program must be linked at low addresses
+  * (-no-pie) and thread stacks are mapped under 4 GB (MAP_32BIT).
+  * @{
+  */
+
+/** @defgroup PlatformConfig Platform configuration
+  * @{
+  */
+
+/*! @brief Board definition */
+#define BOARD_HOST
+
+#if defined(BOARD_HOST)
+
+#include "host_board.h"
+
+/*! @brief Quantity of interrupts */
+#define __PLATCONFIG_MAX_IRQ	8
+
+#endif // defined(BOARD_HOST)
+
+/*! @brief Check for Context Switch IRQ reentrancy */
+#define __PLATCONFIG_CHECK_CS_REENTRY		1
+
+/*! @brief Platform implementation will provide the interrupt source */
+#define __PLATCONFIG_GET_IRQ_SOURCE			1
+
+/*! @brief No DMA on the host, __memCpyAsync() copies at once */
+#define __PLATCONFIG_DMA_MEMCPY				0
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+#endif /* __PLAT_CONFIG_H__ */
@@ -0,0 +1,207 @@
+/***************************************************************************
+ * plat_cpu.h
+ * (C) 2010 Ivan Meleca
+ * Based on original code written by Ruben Meleca
+ * www.milos.it
+
+#   This program is free software; you can redistribute it and/or modify
+#   it under the terms of the GNU General Public License as published by
+#   the Free Software Foundation; either version 2 of the License, or
+#   (at your option) any later version.
+#
+#   This program is distributed in the hope that it will be useful,
+#   but WITHOUT ANY WARRANTY; without even the implied warranty of
+#   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#   GNU General Public License for more details.
+#
+#   You should have received a copy of the GNU General Public License
+#   along with this program; if not, write to the Free Software
+#   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+***************************************************************************/
+#ifndef __PLAT_CPU_H__
+#define	__PLAT_CPU_H__
+
+#include "global_config.h"
+#include "plat_config.h"
+#include "plat_ostypes.h"
+#include "plat_comp_dep.h"
+
+#define CPU_TICKS_TO_MS(x)			((u32)(x))
+#define CPU_MS_TO_TICKS(x)			((u32)(x))
+
+/** @addtogroup Platform_Host
+  * @{
+  */
+
+/** @addtogroup PlatformFunctions Functions
+  * @{
+  */
+
+/*!
+ * @brief Disable interrupts.
+ *
+ * @return Nothing.
+ */
+#define __cpuDisableInterrupts()		__pcd_DisableIRQs()
+
+/*!
+ * @brief Enable interrupts, serving the pending ones.
+ *
+ * @return Nothing.
+ */
+#define __cpuEnableInterrupts()			__pcd_EnableIRQs()
+
+/*!
+ * @brief Counts the leading zero bits of a 32 bit value (32 if zero).
+ *
+ * Used by the scheduler to find the highest priority ready thread.
+ *
+ * @return The number of leading zeros.
+ */
+#define __cpuCountLeadingZeros(x)		((x) ? (u32) __builtin_clz(x) : 32)
+
+/*!
+ * @brief Sleeps until an interrupt is pending, even if interrupts are disabled.
+ *
+ * @return Nothing.
+ */
+#define __cpuWaitForInterrupt()			__hostWaitForInterrupt()
+
+/*!
+ * @brief Loads a word and marks its address for exclusive access.
+ *
+ * @return The value read.
+ */
+#define __cpuLoadExclusive(p)			__hostLoadExclusive((__VOLATILE u32*) (p))
+
+/*!
+ * @brief Stores a word if the exclusive access marked by
+ * __cpuLoadExclusive() was not lost (interrupt, or another exclusive access).
+ *
+ * @return Zero if the value was stored, otherwise 1.
+ */
+#define __cpuStoreExclusive(v, p)		__hostStoreExclusive((v), (__VOLATILE u32*) (p))
+
+/*!
+ * @brief Drops the exclusive access marked by __cpuLoadExclusive().
+ *
+ * @return Nothing.
+ */
+#define __cpuClearExclusive()			(__hostMonitor = __NULL)
+
+/*!
+ * @brief Completes the memory accesses before the barrier before starting
+ * the ones after it.
+ *
+ * @return Nothing.
+ */
+#define __cpuMemoryBarrier()			__sync_synchronize()
+
+/*!
+ * @brief Reads the monotonic clock of the host, in nanoseconds, or
+ * \c __hostCycles while \c __hostCyclesFake is set (the tests move it).
+ *
+ * @return The nanoseconds count, wraps at 32 bits.
+ */
+#define __cpuGetCycles()				(__hostCyclesFake ? __hostCycles : (u32) __hostGetNanoseconds())
+
+/*!
+ * @brief Frequency of the __cpuGetCycles() counter.
+ *
+ * @return Cycles per second.
+ */
+#define __cpuGetCyclesPerSecond()		(1000000000)
+
+/*!
+ * @brief OS in entering IDLE mode.
+ *
+ * @return Nothing.
+ */
+#define	__cpuIdleIn()
+
+/*!
+ * @brief OS in exiting IDLE mode.
+ *
+ * @return Nothing.
+ */
+#define	__cpuIdleOut()
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+/*
+ * The following macros add support for the NET module.
+ */
+#define __byte_swap2(val)           \
+    (((val & 0xff) << 8) |          \
+     ((val & 0xff00) >> 8))
+#define __byte_swap4(val)           \
+    (((val & 0xff) << 24) |         \
+     ((val & 0xff00) << 8) |        \
+     ((val & 0xff0000) >> 8) |      \
+     ((val & 0xff000000) >> 24))
+#define	__htons(x)	__byte_swap2(x)
+#define	__ntohs(x)	__byte_swap2(x)
+#define	__htonl(x)	__byte_swap4(x)
+#define	__ntohl(x)	__byte_swap4(x)
+#define __chksum_16bit_value(ptr) (u16) ( ((u16) *ptr << 8) | *(ptr + 1) )
+#define __chksum_8bit_value(ptr) (u16) ( ((u16) *ptr << 8) )
+
+/*
+ * Mandatory.
+ */
+__VOID __cpuInitHardware(__VOID);
+__VOID __cpuInitTimers(__VOID);
+__VOID __cpuInitSchedulerTimer(__VOID);
+u32 __cpuMakeStackFrame(u32 stkptr, __PVOID *func, __PVOID param);
+u32 __cpuStackFramePointer(pu8 stkptr, u32 stack);
+__VOID __cpuInitInterrupts(__VOID);
+__VOID __cpuCustomCreateSystemThread(__VOID);
+__VOID __cpuScheduleThreadChange(__VOID);
+__VOID __cpuClearPendingThreadChange(__VOID);
+__BOOL __cpuThreadChangeScheduled(__VOID);
+__VOID __cpuStartMMU(__VOID);
+__VOID __cpuStartWatchdog(__VOID);
+__VOID __cpuResetWatchdog(__VOID);
+__VOID __cpuDelayMs(u32 ms);
+
+/*
+ * Tickless idle, see __CONFIG_TICKLESS_IDLE.
+ */
+#if __CONFIG_TICKLESS_IDLE
+u32 __cpuTicklessMaxTicks(__VOID);
+__VOID __cpuTicklessEnter(u32 ticks);
+u32 __cpuTicklessLeave(__VOID);
+#endif /* __CONFIG_TICKLESS_IDLE */
+
+/*
+ * Stack guard region, see __CONFIG_STACK_GUARD. Not simulated.
+ */
+#define __cpuStackGuard(addr)
+
+/*
+ * Optional.
+ */
+__VOID __cpuHeartBeat(__VOID);
+__BOOL __cpuGetInterruptSource(u32* irq);
+__VOID __cpuInitCycleCounter(__VOID);
+
+/*
+ * Host simulation.
+ */
+extern __VOLATILE u32* __hostMonitor;
+extern __VOLATILE __BOOL __hostCyclesFake;
+extern __VOLATILE u32 __hostCycles;
+u32 __hostLoadExclusive(__VOLATILE u32* ptr);
+u32 __hostStoreExclusive(u32 val, __VOLATILE u32* ptr);
+__VOID __hostWaitForInterrupt(__VOID);
+u64 __hostGetNanoseconds(__VOID);
+__VOID __hostExit(i32 status);
+
+#endif /*__PLAT_CPU_H__ */
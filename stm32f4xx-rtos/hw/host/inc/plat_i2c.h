@@ -0,0 +1,117 @@
+/***************************************************************************
+ * plat_i2c.h
+ * (C) 2010 Ivan Meleca
+ * Based on original code written by Ruben Meleca
+ * www.milos.it
+
+#   This program is free software; you can redistribute it and/or modify
+#   it under the terms of the GNU General Public License as published by
+#   the Free Software Foundation; either version 2 of the License, or
+#   (at your option) any later version.
+#
+#   This program is distributed in the hope that it will be useful,
+#   but WITHOUT ANY WARRANTY; without even the implied warranty of
+#   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#   GNU General Public License for more details.
+#
+#   You should have received a copy of the GNU General Public License
+#   along with this program; if not, write to the Free Software
+#   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+***************************************************************************/
+#ifndef __PLAT_I2C_H__
+#define __PLAT_I2C_H__
+
+#include <core/inc/device.h>
+
+#if __CONFIG_COMPILE_I2C
+
+/** @addtogroup I2C
+  * @{
+  */
+
+/** @defgroup I2C_Platform Platform-related
+  * @{
+  */
+
+/** @defgroup I2C_Host Host
+  *
+  * I2C master of the host simulator, with one simulated slave on the bus: a
+  * register file, as a sensor or an EEPROM. The first byte written selects the
+  * register, the next bytes are written from it on, and the bytes read come
+  * from it on; the register pointer wraps at 256.
+  *
+  * The bus moves \c speed / 9 bytes per second (8 bits and the ACK), START and
+  * address included, in steps of one system tick: the simulated I2C interrupt
+  * follows each tick. The interrupts of the target are counted as they would
+  * be raised: START and address, one per byte, and the byte transfer finished
+  * at the end of the write phase. With \c dma set the phases longer than one
+  * byte raise no byte interrupt, and the read phase ends with the DMA one.
+  * @{
+  */
+
+/** @defgroup I2C_Host_Constants Constants
+  * @{
+  */
+
+/** @defgroup I2C_Host_DefaultDefines Default values
+  *
+  * If the parameter \c params if left to __NULL When calling __deviceInit()
+  * to initialize the I2C driver, the driver will take these values as defaults.
+  *
+  * @{
+  */
+
+#define __PLATI2C_RXBUFF_LEN	64		/*!< @brief RX buffer length */
+#define __PLATI2C_TXBUFF_LEN	64		/*!< @brief TX buffer length */
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+/** @defgroup I2C_Host_Typedefs Typedefs
+  * @{
+  */
+
+/*!
+ * @brief Host I2C device parameters, with the simulated slave.
+ */
+typedef struct {
+	u32				speed;				/*!< @brief Bus speed in Hz */
+	u8				dma;				/*!< @brief Models the DMA streams */
+	u8				slave;				/*!< @brief Address of the slave (7-bit) */
+	u8				stretch;			/*!< @brief The slave holds SCL low, the bus stops */
+	u8				reg;				/*!< @brief Register pointer of the slave */
+	u8				regs[256];			/*!< @brief Registers of the slave */
+	u8				addressed;			/*!< @brief START and address of the running phase sent */
+	u8				first;				/*!< @brief The next byte written selects the register */
+	u32				bytes;				/*!< @brief Bytes moved on the bus, addresses included */
+	u32				irqs;				/*!< @brief Interrupts of the target for these bytes */
+	u64				isr_ns;				/*!< @brief Time spent in the simulated interrupt */
+} I2C_PARAMS, *PI2C_PARAMS;
+
+/**
+  * @}
+  */
+
+i32 __i2cPlatIoCtl(__PDEVICE dv, u32 code, u32 param, __PVOID in, u32 in_len, __PVOID out, u32 out_len);
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+#endif /* __CONFIG_COMPILE_I2C */
+
+#endif /* __PLAT_I2C_H__ */
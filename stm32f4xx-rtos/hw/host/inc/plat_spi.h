@@ -0,0 +1,112 @@
+/***************************************************************************
+ * plat_spi.h
+ * (C) 2010 Ivan Meleca
+ * Based on original code written by Ruben Meleca
+ * www.milos.it
+
+#   This program is free software; you can redistribute it and/or modify
+#   it under the terms of the GNU General Public License as published by
+#   the Free Software Foundation; either version 2 of the License, or
+#   (at your option) any later version.
+#
+#   This program is distributed in the hope that it will be useful,
+#   but WITHOUT ANY WARRANTY; without even the implied warranty of
+#   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#   GNU General Public License for more details.
+#
+#   You should have received a copy of the GNU General Public License
+#   along with this program; if not, write to the Free Software
+#   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+***************************************************************************/
+#ifndef __PLAT_SPI_H__
+#define __PLAT_SPI_H__
+
+#include <core/inc/device.h>
+
+#if __CONFIG_COMPILE_SPI
+
+/** @addtogroup SPI
+  * @{
+  */
+
+/** @defgroup SPI_Platform Platform-related
+  * @{
+  */
+
+/** @defgroup SPI_Host	Host
+  *
+  * SPI master of the host simulator, with MISO wired to MOSI: every byte sent
+  * is received back. The bytes written by __spiWrite() are looped back into
+  * the RX buffer by __spiFlush(), as the TXE and RXNE interrupts of the target
+  * would do.
+  *
+  * With \c dma set the device supports __spiTransfer(). A descriptor is copied
+  * at once when started, and its DMA transfer complete interrupt is raised
+  * right away: the transfers take no bus time, only the time of the driver.
+  * A descriptor started from the interrupt is completed when the interrupt
+  * returns, as a tail-chained interrupt of the target.
+  * @{
+  */
+
+/** @defgroup SPI_Host_Constants Constants
+  * @{
+  */
+
+/** @defgroup SPI_Host_DefaultDefines Default values
+  *
+  * If the parameter \c params if left to __NULL When calling __deviceInit()
+  * to initialize the SPI driver, the driver will take these values as defaults.
+  * @{
+  */
+
+#define __PLATSPI_RXBUFLEN		32			/*!< @brief Default RX buffer length */
+#define __PLATSPI_TXBUFLEN		32			/*!< @brief Default TX buffer length */
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+/** @defgroup SPI_Host_Typedefs Typedefs
+  * @{
+  */
+
+/*!
+ * @brief Host SPI device parameters.
+ */
+typedef struct {
+	u8				dma;				/*!< @brief Models the DMA streams, __spiTransfer() supported */
+	u8				error;				/*!< @brief The next descriptors end with a DMA transfer error */
+	u8				cs;					/*!< @brief Chip-select level, __FALSE while asserted */
+	u8				in_isr;				/*!< @brief The DMA interrupt is being served */
+	u8				pending;			/*!< @brief The DMA interrupt is pending */
+	u32				selects;			/*!< @brief Chip-select assertions */
+	u32				xfers;				/*!< @brief Descriptors transferred */
+	u32				irqs;				/*!< @brief DMA interrupts served */
+} SPI_PARAMS, *PSPI_PARAMS;
+
+/**
+  * @}
+  */
+
+i32 __spiPlatIoCtl(__PDEVICE dv, u32 code, u32 param, __PVOID in, u32 in_len, __PVOID out, u32 out_len);
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+#endif /* __CONFIG_COMPILE_SPI */
+
+#endif /* __PLAT_SPI_H__ */
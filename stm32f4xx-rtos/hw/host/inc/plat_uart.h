@@ -0,0 +1,109 @@
+/***************************************************************************
+ * plat_uart.h
+ * (C) 2010 Ivan Meleca
+ * Based on original code written by Ruben Meleca
+ * www.milos.it
+
+#   This program is free software; you can redistribute it and/or modify
+#   it under the terms of the GNU General Public License as published by
+#   the Free Software Foundation; either version 2 of the License, or
+#   (at your option) any later version.
+#
+#   This program is distributed in the hope that it will be useful,
+#   but WITHOUT ANY WARRANTY; without even the implied warranty of
+#   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#   GNU General Public License for more details.
+#
+#   You should have received a copy of the GNU General Public License
+#   along with this program; if not, write to the Free Software
+#   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+***************************************************************************/
+#ifndef __PLAT_UART_H__
+#define __PLAT_UART_H__
+
+#include <core/inc/device.h>
+
+#if __CONFIG_COMPILE_SERIAL
+
+/** @addtogroup Serial
+  * @{
+  */
+
+/** @defgroup Serial_Platform Platform-related
+  * @{
+  */
+
+/** @defgroup Serial_Host	Host
+  *
+  * Serial devices of the host simulator. The received bytes are read from a
+  * file descriptor (usually stdin) by the UART interrupt, simulated after each
+  * system tick. The transmitted bytes are written at once to another file
+  * descriptor (usually stdout) by __serialFlush().
+  *
+  * A device without RX file descriptor can be fed with __uartLineReceive(),
+  * which models the receive interrupts of the target: one RXNE interrupt per
+  * byte, or with \c rx_dma set a circular DMA stream into the RX buffer with
+  * the half and full buffer interrupts and the IDLE line interrupt.
+  * @{
+  */
+
+/** @defgroup Serial_Host_Constants Constants
+  * @{
+  */
+
+/** @defgroup Serial_Host_DefaultDefines Default values
+  *
+  * If the parameter \c params if left to __NULL When calling __deviceInit()
+  * to initialize the Serial driver, the driver will take these values as defaults.
+  * @{
+  */
+
+#define __PLATUART_RXBUFF_LEN		32
+#define __PLATUART_TXBUFF_LEN		32
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+/** @defgroup Serial_Host_Typedefs Typedefs
+  * @{
+  */
+
+/*!
+ * @brief Host serial device parameters, pre-configured in host_board.c.
+ */
+typedef struct {
+	i32				rx_fd;				/*!< @brief File descriptor to read, -1 for none */
+	i32				tx_fd;				/*!< @brief File descriptor to write, -1 for none */
+	u8				rx_dma;				/*!< @brief __uartLineReceive() models the circular RX DMA */
+	u16				rx_ndtr;			/*!< @brief Simulated DMA NDTR: bytes left to the RX buffer end */
+	u32				rx_irqs;			/*!< @brief Receive interrupts served by __uartLineReceive() */
+} UART_PARAMS, *PUART_PARAMS;
+
+/**
+  * @}
+  */
+
+i32 __serialPlatIoCtl(__PDEVICE dv, u32 code, u32 param, __PVOID in, u32 in_len, __PVOID out, u32 out_len);
+__VOID __uartLineReceive(__PDEVICE dv, __CONST u8* data, u32 len);
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+#endif /* __CONFIG_COMPILE_SERIAL */
+
+#endif /* __PLAT_UART_H__ */
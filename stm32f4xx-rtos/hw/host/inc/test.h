@@ -0,0 +1,59 @@
+/***************************************************************************
+ * test.h
+ * (C) 2010 Ivan Meleca
+ * Based on original code written by Ruben Meleca
+ * www.milos.it
+
+#   This program is free software; you can redistribute it and/or modify
+#   it under the terms of the GNU General Public License as published by
+#   the Free Software Foundation; either version 2 of the License, or
+#   (at your option) any later version.
+#
+#   This program is distributed in the hope that it will be useful,
+#   but WITHOUT ANY WARRANTY; without even the implied warranty of
+#   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#   GNU General Public License for more details.
+#
+#   You should have received a copy of the GNU General Public License
+#   along with this program; if not, write to the Free Software
+#   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+***************************************************************************/
+#ifndef __TEST_H__
+#define __TEST_H__
+
+#include <stddef.h>
+#include <plat_cpu.h>
+
+/*
+ * Host unit tests, run on the host simulator by the "test" Makefile target.
+ * Each suite is a function of its own test_*.c file, listed in test.c.
+ */
+
+/* Counts a check, prints the expression and its place if it fails */
+#define TEST_CHECK(cond)		testCheck((cond) ? __TRUE : __FALSE, #cond, __FILE__, __LINE__)
+
+/* The C library <string.h> is shadowed by common/inc/string.h, the reference functions */
+void* memcpy(void* dst, const void* src, size_t n);
+void* memmove(void* dst, const void* src, size_t n);
+void* memset(void* ptr, int c, size_t n);
+int memcmp(const void* p1, const void* p2, size_t n);
+int strcmp(const char* s1, const char* s2);
+char* strstr(const char* s1, const char* s2);
+
+__BOOL testCheck(__BOOL ok, __CONST char* expr, __CONST char* file, u32 line);
+
+__VOID testMem(__VOID);
+__VOID testLog(__VOID);
+__VOID testStack(__VOID);
+__VOID testDevice(__VOID);
+__VOID testTerminal(__VOID);
+__VOID testPool(__VOID);
+__VOID testLock(__VOID);
+__VOID testSpi(__VOID);
+__VOID testI2c(__VOID);
+__VOID testPendSv(__VOID);
+__VOID testProfile(__VOID);
+__VOID testWork(__VOID);
+
+#endif // __TEST_H__
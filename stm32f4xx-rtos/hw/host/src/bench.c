@@ -0,0 +1,1573 @@
+/***************************************************************************
+ * bench.c
+ * (C) 2010 Ivan Meleca
+ * Based on original code written by Ruben Meleca
+ * www.milos.it
+
+#   This program is free software; you can redistribute it and/or modify
+#   it under the terms of the GNU General Public License as published by
+#   the Free Software Foundation; either version 2 of the License, or
+#   (at your option) any later version.
+#
+#   This program is distributed in the hope that it will be useful,
+#   but WITHOUT ANY WARRANTY; without even the implied warranty of
+#   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#   GNU General Public License for more details.
+#
+#   You should have received a copy of the GNU General Public License
+#   along with this program; if not, write to the Free Software
+#   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+***************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <plat_cpu.h>
+#include <core/inc/system.h>
+#include <core/inc/thread.h>
+#include <core/inc/event.h>
+#include <core/inc/lock.h>
+#include <core/inc/queue.h>
+#include <core/inc/heap.h>
+#include <core/inc/log.h>
+#include <core/inc/work.h>
+#include <core/inc/timer.h>
+#include <core/inc/device.h>
+#include <core/inc/terminal.h>
+#include <drivers/inc/serial.h>
+#include <drivers/inc/spi.h>
+#include <drivers/inc/i2c.h>
+#include <plat_uart.h>
+#include <plat_spi.h>
+#include <plat_i2c.h>
+#include <common/inc/mem.h>
+
+/*
+ * Microbenchmarks of the core and memory primitives, run on the host simulator by the
+ * "bench" Makefile target.
+ *
+ * Each benchmark prints one line with its name, the iterations and the mean
+ * time of one operation in nanoseconds. Names, order and iterations never
+ * change, so the outputs of two builds can be compared line by line. Times
+ * include the 1 ms system tick served meanwhile.
+ */
+
+#define BENCH_PRIO				10			/* Bench thread priority */
+#define BENCH_PRIO_HIGH			5			/* Partner thread priority, preempts the bench thread */
+#define BENCH_STACK				512
+
+#define BENCH_ITER_SWITCH		20000		/* Iterations with context switches */
+#define BENCH_SCHED_MIN			4			/* Fewest ready threads of the scheduler benchmark */
+#define BENCH_SCHED_MAX			128			/* Most ready threads of the scheduler benchmark */
+#define BENCH_ITER				200000		/* Iterations of the other benchmarks */
+#define BENCH_SPSC_SLOTS		16			/* Slots of the single producer, single consumer queues */
+#define BENCH_MEM_BYTES			(64 * 1024 * 1024)	/* Bytes moved by each memory benchmark, at most BENCH_ITER times */
+#define BENCH_MEM_MAX			(64 * 1024)	/* Largest memory block */
+#define BENCH_HEAP_TRACE		100000		/* Operations of the random heap trace */
+#define BENCH_HEAP_SLOTS		256			/* Blocks live at most during the trace */
+#define BENCH_HEAP_CHECK		1000		/* Trace operations between fragmentation checks */
+#define BENCH_WAIT_SOURCES		8			/* Sources served by one thread */
+#define BENCH_WAIT_EVENTS		500			/* Signals of each serving benchmark */
+#define BENCH_WAIT_GAP			3			/* Ticks between two signals */
+#define BENCH_WAIT_PERIOD		4			/* Ticks between two polls, not a multiple of the gap */
+#define BENCH_WAIT_IDLE			0			/* Serving modes: nobody serves the sources */
+#define BENCH_WAIT_POLL			1			/* Polled each BENCH_WAIT_PERIOD ticks */
+#define BENCH_WAIT_SPIN			2			/* Polled in a loop */
+#define BENCH_WAIT_MULTI		3			/* Waited for with __waitMultiple() */
+#define BENCH_LOG_BATCH			64			/* Records logged before emptying the ring, untimed */
+#define BENCH_WORK_BATCH		64			/* Items submitted before the worker runs */
+#define BENCH_TIMER_MAX			1000		/* Most timers armed at once */
+#define BENCH_TIMER_PERIOD		8			/* Timer periods from 1 to this, in ticks */
+#define BENCH_TIMER_JITTER		1000		/* Firing intervals sampled, spread over the timers */
+#define BENCH_TIMER_TICKS		1100		/* Ticks each timer count runs, enough for the samples */
+#define BENCH_TIMER_GAP			2000		/* Longer gaps seen by the spinner are CPU taken, in ns */
+#define BENCH_TIMER_SPIN_PRIO	200			/* Below the timer thread */
+#define BENCH_ISR_SAMPLES		20000		/* Simulated interrupts timed one by one */
+#define BENCH_ISR_BYTES			1024		/* Bytes processed by each simulated interrupt */
+#define BENCH_LOOP_SIZE			1024		/* Loopback device buffer, power of two */
+#define BENCH_DEV_BATCH			64			/* Bytes written to the loopback device before reading them */
+#define BENCH_DEV_LINE			"0123456789abcdefghijklmnopqrst\r\n"	/* Line of 32 bytes */
+#define BENCH_UART_IRQ			(BOARD_HOST_I2C1_IRQ + 1)	/* Vector of the simulated line devices, never raised */
+#define BENCH_UART_BYTES		(256 * 1024)	/* Bytes received by each UART benchmark */
+#define BENCH_UART_FRAME		128			/* Longest frame, the lengths are random */
+#define BENCH_UART_RXBUF		256			/* RX buffer, the DMA ring */
+#define BENCH_UART_BAUD			921600		/* Line speed of the CPU load, 10 bits per byte */
+#define BENCH_SPI_ITER			20000		/* Transactions of each SPI benchmark */
+#define BENCH_SPI_MAX			4096		/* Longest SPI descriptor */
+#define BENCH_SPI_CHAIN			8			/* Descriptors of the chained transaction */
+#define BENCH_SPI_FIFO			256			/* Bytes of the byte-wise path, its buffers */
+#define BENCH_SPI_CLOCK			21000000	/* Bus clock of the CPU load, SPI1 at 84 MHz / 4 */
+#define BENCH_I2C_JOBS			256			/* Register reads of each I2C benchmark */
+#define BENCH_I2C_LEN			32			/* Registers read by each job */
+#define BENCH_I2C_SPEED			400000		/* Fast mode bus */
+#define BENCH_I2C_SLAVE			0x50		/* Address of the simulated slave */
+#define BENCH_TERM_CMDS			64			/* Commands registered to the terminal */
+#define BENCH_TERM_LINES		8192		/* Lines of the command script */
+#define BENCH_TERM_BATCH		32			/* Script lines written to the loopback device at once */
+
+__STATIC __EVENT benchPing;
+__STATIC __EVENT benchPong;
+__STATIC __EVENT benchStop;
+__STATIC __VOLATILE __BOOL benchDone;
+__STATIC __EVENT benchSchedGate[2][BENCH_SCHED_MAX];			/* Equal, mixed priorities */
+__STATIC __PTHREAD benchSchedThreads[2][BENCH_SCHED_MAX];
+__STATIC __VOLATILE u32 benchSchedParked;
+__STATIC __QUEUE benchSpsc[2];								/* Consumer woken by each item, in batches */
+__STATIC __VOLATILE u32 benchSpscItems;
+__STATIC __EVENT benchWaitSrc[BENCH_WAIT_SOURCES];
+__STATIC u64 benchWaitStamp[BENCH_WAIT_SOURCES];			/* Time of the last signal */
+__STATIC u32 benchWaitLatency[BENCH_WAIT_EVENTS];
+__STATIC __EVENT benchWaitGate;
+__STATIC __EVENT benchWaitEnd;
+__STATIC __PVOID benchHeapSlots[BENCH_HEAP_SLOTS];
+__STATIC u32 benchHeapAllocTimes[BENCH_HEAP_TRACE];
+__STATIC u32 benchHeapFreeTimes[BENCH_HEAP_TRACE];
+__STATIC u32 benchSeed = 1;
+__STATIC u32 benchMemSrc[BENCH_MEM_MAX / sizeof(u32) + 1];
+__STATIC u32 benchMemDst[BENCH_MEM_MAX / sizeof(u32) + 2];
+__STATIC __WORK benchWork[BENCH_WORK_BATCH];
+__STATIC __PTIMER benchTimers[BENCH_TIMER_MAX];
+__STATIC u64 benchTimerLast[BENCH_TIMER_MAX];				/* Last firing, zero before the first one */
+__STATIC u32 benchTimerQuota[BENCH_TIMER_MAX];				/* Intervals still to sample */
+__STATIC u32 benchTimerJitter[BENCH_TIMER_JITTER];
+__STATIC u32 benchTimerSamples;
+__STATIC u32 benchTimerFired;
+__STATIC __EVENT benchTimerGate;
+__STATIC __EVENT benchTimerSpun;
+__STATIC u64 benchTimerWall;
+__STATIC u64 benchTimerStolen;
+__STATIC u8 benchIsrData[BENCH_ISR_BYTES];
+__STATIC __VOLATILE u32 benchIsrSum;
+__STATIC u32 benchIsrTimes[BENCH_ISR_SAMPLES];
+__STATIC u8 benchLoopBuf[BENCH_LOOP_SIZE];
+__STATIC u32 benchLoopHead;
+__STATIC u32 benchLoopTail;
+__STATIC __EVENT benchLoopEvent;
+__STATIC __TERMINALCMD benchTermCmds[BENCH_TERM_CMDS];
+__STATIC char benchTermNames[BENCH_TERM_CMDS][12];
+__STATIC __VOLATILE u32 benchTermRuns;
+__STATIC u32 benchTermTarget;
+
+/*
+ * Prints a result line, the mean time of \c ops operations per iteration.
+ * Stdio is not interrupt safe, so interrupts are disabled.
+ */
+__STATIC __VOID benchPrint(__CONST char* name, u32 iter, u64 ns, u32 ops)
+{
+	__systemStop();
+	printf("%-24s %10u %12.1f\n", name, iter, (double) ns / ((double) iter * ops));
+	__systemStart();
+}
+
+/*
+ * Prints a result line that is not a time: \c value over \c samples samples.
+ */
+__STATIC __VOID benchPrintValue(__CONST char* name, u32 samples, double value)
+{
+	__systemStop();
+	printf("%-24s %10u %12.1f\n", name, samples, value);
+	__systemStart();
+}
+
+/*
+ * Pseudo-random number, the same sequence on each run.
+ */
+__STATIC u32 benchRandom(u32 range)
+{
+	benchSeed = benchSeed * 1103515245 + 12345;
+	return (benchSeed >> 16) % range;
+}
+
+/*
+ * CPU time of the process in nanoseconds, which does not count the time the
+ * host runs other processes.
+ */
+__STATIC u64 benchCpuTime(__VOID)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+	return (u64) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+__STATIC int benchCompare(__CONST void* a, __CONST void* b)
+{
+	u32 x = *(__CONST u32*) a, y = *(__CONST u32*) b;
+
+	return (x > y) - (x < y);
+}
+
+/*
+ * Prints the median, the 99th percentile and the maximum of the samples, in
+ * nanoseconds.
+ */
+__STATIC __VOID benchPercentiles(__CONST char* name, u32* ns, u32 cnt)
+{
+	char line[32];
+
+	qsort(ns, cnt, sizeof(u32), benchCompare);
+
+	snprintf(line, sizeof(line), "%s_p50", name);
+	benchPrint(line, cnt, (u64) ns[cnt / 2] * cnt, 1);
+	snprintf(line, sizeof(line), "%s_p99", name);
+	benchPrint(line, cnt, (u64) ns[cnt - cnt / 100 - 1] * cnt, 1);
+	snprintf(line, sizeof(line), "%s_max", name);
+	benchPrint(line, cnt, (u64) ns[cnt - 1] * cnt, 1);
+}
+
+/*
+ * Partner of the yield benchmark, same priority as the bench thread.
+ */
+__STATIC __VOID benchYielder(__VOID)
+{
+	while (!benchDone) __threadYield();
+	__eventWait(&benchStop, 0);
+}
+
+/*
+ * Partner of the ping-pong benchmark, higher priority than the bench thread.
+ */
+__STATIC __VOID benchPonger(__VOID)
+{
+	for (;;)
+	{
+		__eventWait(&benchPing, 0);
+		__eventReset(&benchPing);
+		if (benchDone) break;
+		__eventSet(&benchPong);
+	}
+
+	__eventWait(&benchStop, 0);
+}
+
+/*
+ * Two threads of the same priority yielding to each other, time of one switch.
+ */
+__STATIC __VOID benchThreadYield(__VOID)
+{
+	u64 t;
+	u32 i;
+
+	benchDone = __FALSE;
+	__threadCreate("yield", benchYielder, BENCH_PRIO, BENCH_STACK, 1, __NULL);
+	__threadYield();
+
+	t = __hostGetNanoseconds();
+	for (i = 0; i < BENCH_ITER_SWITCH; i++) __threadYield();
+	t = __hostGetNanoseconds() - t;
+
+	benchDone = __TRUE;
+	__threadYield();
+
+	benchPrint("thread_yield", BENCH_ITER_SWITCH, t, 2);
+}
+
+/*
+ * Thread of the scheduler benchmark. Once let through its gate, it yields
+ * until the end of the measure (equal priorities), or only parks again
+ * (mixed priorities: lower than the bench thread, it stays ready until the
+ * bench thread sleeps).
+ */
+__STATIC __VOID benchSchedThread(__VOID)
+{
+	__PEVENT gate = __threadGetParameter();
+
+	for (;;)
+	{
+		__eventWait(gate, 0);
+		__eventReset(gate);
+
+		while (!benchDone) __threadYield();
+
+		benchSchedParked++;
+	}
+}
+
+/*
+ * Switch cost with \c cnt ready threads: the bench thread and \c cnt - 1
+ * threads of its priority yielding in turn (equal), or the bench thread and
+ * a thread of its priority yielding while the others are ready at lower,
+ * different priorities (mixed). The threads of each kind are created once
+ * and reused.
+ */
+__STATIC __VOID benchSchedRound(u32 cnt, __BOOL mixed)
+{
+	__PEVENT gate = benchSchedGate[mixed];
+	char name[32];
+	u32 i, n;
+	u64 t;
+
+	benchDone = __FALSE;
+	benchSchedParked = 0;
+
+	for (i = 0; i < cnt - 1; i++)
+	{
+		/* One at the bench thread priority, the others below */
+		if (!benchSchedThreads[mixed][i])
+		{
+			gate[i].ev_state = __EV_RESET;
+			gate[i].ev_threads = __NULL;
+			gate[i].ev_links = __NULL;
+			snprintf(name, sizeof(name), "%s%u", mixed ? "mx" : "eq", (unsigned) i);
+			benchSchedThreads[mixed][i] = __threadCreate(name, benchSchedThread,
+				(mixed && i) ? BENCH_PRIO + 1 + (i * 200) / BENCH_SCHED_MAX : BENCH_PRIO, BENCH_STACK, 1, &gate[i]);
+		}
+
+		__eventSet(&gate[i]);
+	}
+
+	/* Once around, every thread waits in the ready queue */
+	__threadYield();
+
+	/* A yield of the bench thread is followed by a switch to each thread yielding */
+	n = BENCH_ITER_SWITCH / (mixed ? 2 : cnt);
+
+	t = __hostGetNanoseconds();
+	for (i = 0; i < n; i++) __threadYield();
+	t = __hostGetNanoseconds() - t;
+
+	/* The lower priority threads run once the bench thread sleeps */
+	benchDone = __TRUE;
+	while (benchSchedParked < cnt - 1) __threadSleep(1);
+
+	snprintf(name, sizeof(name), "sched_%s_%u", mixed ? "mixed" : "equal", (unsigned) cnt);
+	benchPrint(name, n, t, mixed ? 2 : cnt);
+}
+
+/*
+ * The scheduler benchmark from BENCH_SCHED_MIN to BENCH_SCHED_MAX ready threads.
+ */
+__STATIC __VOID benchSched(__VOID)
+{
+	u32 cnt;
+
+	for (cnt = BENCH_SCHED_MIN; cnt <= BENCH_SCHED_MAX; cnt <<= 1) benchSchedRound(cnt, __FALSE);
+	for (cnt = BENCH_SCHED_MIN; cnt <= BENCH_SCHED_MAX; cnt <<= 1) benchSchedRound(cnt, __TRUE);
+}
+
+/*
+ * __eventSet() with no waiting threads, and __eventWait() on a set event.
+ */
+__STATIC __VOID benchEventNoWait(__VOID)
+{
+	u64 t;
+	u32 i;
+
+	__eventReset(&benchPong);
+
+	t = __hostGetNanoseconds();
+	for (i = 0; i < BENCH_ITER; i++) __eventSet(&benchPong);
+	t = __hostGetNanoseconds() - t;
+	benchPrint("event_set", BENCH_ITER, t, 1);
+
+	t = __hostGetNanoseconds();
+	for (i = 0; i < BENCH_ITER; i++) __eventWait(&benchPong, 0);
+	t = __hostGetNanoseconds() - t;
+	benchPrint("event_wait_set", BENCH_ITER, t, 1);
+}
+
+/*
+ * __eventSet() waking a higher priority thread that sets an event back,
+ * time of one round trip (two switches).
+ */
+__STATIC __VOID benchEventPingPong(__VOID)
+{
+	u64 t;
+	u32 i;
+
+	benchDone = __FALSE;
+	__eventReset(&benchPing);
+	__threadCreate("ponger", benchPonger, BENCH_PRIO_HIGH, BENCH_STACK, 1, __NULL);
+
+	t = __hostGetNanoseconds();
+	for (i = 0; i < BENCH_ITER_SWITCH; i++)
+	{
+		__eventReset(&benchPong);
+		__eventSet(&benchPing);
+		__eventWait(&benchPong, 0);
+	}
+	t = __hostGetNanoseconds() - t;
+
+	benchDone = __TRUE;
+	__eventSet(&benchPing);
+
+	benchPrint("event_pingpong", BENCH_ITER_SWITCH, t, 1);
+}
+
+/*
+ * Source of the serving benchmark, higher priority than the bench thread:
+ * for each round every BENCH_WAIT_GAP ticks signals one of the sources not
+ * pending, stamping the time, BENCH_WAIT_EVENTS times.
+ */
+__STATIC __VOID benchWaitProducer(__VOID)
+{
+	u32 i, j, src;
+
+	for (;;)
+	{
+		__eventWait(&benchWaitGate, 0);
+		__eventReset(&benchWaitGate);
+
+		for (i = 0; i < BENCH_WAIT_EVENTS; i++)
+		{
+			__threadSleep(BENCH_WAIT_GAP);
+
+			/* Nobody serves them in the idle round */
+			src = benchRandom(BENCH_WAIT_SOURCES);
+			for (j = 1; j < BENCH_WAIT_SOURCES && benchWaitSrc[src].ev_state != __EV_RESET; j++) src = (src + 1) % BENCH_WAIT_SOURCES;
+
+			benchWaitStamp[src] = __hostGetNanoseconds();
+			__eventSet(&benchWaitSrc[src]);
+		}
+
+		__eventSet(&benchWaitEnd);
+	}
+}
+
+/*
+ * Serves the pending sources, sampling their latency from \c served on.
+ * Returns the sources served.
+ */
+__STATIC u32 benchWaitServe(u32 served)
+{
+	u32 i, cnt = 0;
+
+	for (i = 0; i < BENCH_WAIT_SOURCES; i++)
+	{
+		if (benchWaitSrc[i].ev_state == __EV_RESET) continue;
+
+		/* Stamped before set, and signalled again only once reset */
+		benchWaitLatency[served + cnt++] = (u32) (__hostGetNanoseconds() - benchWaitStamp[i]);
+		__eventReset(&benchWaitSrc[i]);
+	}
+
+	return cnt;
+}
+
+/*
+ * The bench thread serves the BENCH_WAIT_SOURCES sources until every signal
+ * is served, as \c mode tells. Prints the latency from signal to service, the
+ * thread wakeups and the process CPU time per signal, the ticks and the
+ * producer included: BENCH_WAIT_IDLE gives the time of the producer alone.
+ */
+__STATIC __VOID benchWaitRound(__CONST char* name, u8 mode)
+{
+	__WAIT_OBJ objs[BENCH_WAIT_SOURCES];
+	u32 i, served = 0, wakeups = 0;
+	char line[32];
+	u64 cpu;
+
+	for (i = 0; i < BENCH_WAIT_SOURCES; i++)
+	{
+		__eventReset(&benchWaitSrc[i]);
+		objs[i].wo_type = __WAIT_EVENT;
+		objs[i].wo_obj = &benchWaitSrc[i];
+		objs[i].wo_flags = 0;
+	}
+
+	__eventReset(&benchWaitEnd);
+
+	cpu = benchCpuTime();
+	__eventSet(&benchWaitGate);
+
+	while (mode != BENCH_WAIT_IDLE && served < BENCH_WAIT_EVENTS)
+	{
+		switch (mode)
+		{
+			case BENCH_WAIT_POLL:
+				__threadSleep(BENCH_WAIT_PERIOD);
+				break;
+
+			case BENCH_WAIT_SPIN:
+				__threadYield();
+				break;
+
+			case BENCH_WAIT_MULTI:
+				__waitMultiple(objs, BENCH_WAIT_SOURCES, __EV_INFINITE);
+				break;
+		}
+
+		wakeups++;
+		served += benchWaitServe(served);
+	}
+
+	__eventWait(&benchWaitEnd, 0);
+	cpu = benchCpuTime() - cpu;
+
+	if (mode != BENCH_WAIT_IDLE)
+	{
+		snprintf(line, sizeof(line), "%s_latency", name);
+		benchPercentiles(line, benchWaitLatency, BENCH_WAIT_EVENTS);
+		snprintf(line, sizeof(line), "%s_wakeups", name);
+		benchPrintValue(line, BENCH_WAIT_EVENTS, (double) wakeups / BENCH_WAIT_EVENTS);
+	}
+
+	snprintf(line, sizeof(line), "%s_cpu_ns", name);
+	benchPrintValue(line, BENCH_WAIT_EVENTS, (double) cpu / BENCH_WAIT_EVENTS);
+}
+
+/*
+ * One thread serving BENCH_WAIT_SOURCES event sources: polling them each
+ * BENCH_WAIT_PERIOD ticks, spinning on them, or waiting for them all with
+ * __waitMultiple(). Polling bounds the latency by its period, spinning
+ * takes the whole CPU, __waitMultiple() wakes the thread once per signal.
+ */
+__STATIC __VOID benchWaitMultiple(__VOID)
+{
+	__eventReset(&benchWaitGate);
+	__threadCreate("waitsrc", benchWaitProducer, BENCH_PRIO_HIGH, BENCH_STACK, 1, __NULL);
+
+	benchWaitRound("wait8_idle", BENCH_WAIT_IDLE);
+	benchWaitRound("wait8_poll", BENCH_WAIT_POLL);
+	benchWaitRound("wait8_spin", BENCH_WAIT_SPIN);
+	benchWaitRound("wait8_multi", BENCH_WAIT_MULTI);
+}
+
+/*
+ * Uncontended __lockOwn() and __lockRelease().
+ */
+__STATIC __VOID benchLock(__VOID)
+{
+	__PLOCK lock = __lockCreate();
+	u64 t;
+	u32 i;
+
+	t = __hostGetNanoseconds();
+	for (i = 0; i < BENCH_ITER; i++)
+	{
+		__lockOwn(lock, 0);
+		__lockRelease(lock);
+	}
+	t = __hostGetNanoseconds() - t;
+
+	__lockDestroy(lock);
+	benchPrint("lock_own_release", BENCH_ITER, t, 1);
+}
+
+/*
+ * __queueAdd() and __queueGet() of a word, fixed size items.
+ */
+__STATIC __VOID benchQueue(__VOID)
+{
+	__QUEUE queue = {0};
+	u32 val = 0, len;
+	u64 t;
+	u32 i;
+
+	__queueCreate(__QUEUE_ALLOC | __QUEUE_FIXED_SIZE, &queue, 16, sizeof(u32), __NULL, 0);
+
+	t = __hostGetNanoseconds();
+	for (i = 0; i < BENCH_ITER; i++)
+	{
+		__queueAdd(&queue, &i, sizeof(u32));
+		len = sizeof(u32);
+		__queueGet(&queue, &val, &len);
+	}
+	t = __hostGetNanoseconds() - t;
+
+	benchPrint("queue_add_get", BENCH_ITER, t, 1);
+}
+
+/*
+ * Consumer of a __QUEUE_SPSC queue: takes the items in place until the queue
+ * is empty, then waits for data. Stops when empty after benchDone is set.
+ */
+__STATIC __VOID benchSpscConsumer(__VOID)
+{
+	__PQUEUE queue = __threadGetParameter();
+	pu32 item;
+
+	for (;;)
+	{
+		while ((item = __queuePeek(queue, __NULL)) != __NULL)
+		{
+			benchSpscItems += *item;
+			__queueRelease(queue);
+		}
+
+		if (benchDone) break;
+		__queueWaitForData(queue, 0);
+	}
+
+	__eventWait(&benchStop, 0);
+}
+
+/*
+ * Producer side of a __QUEUE_SPSC queue, consumed by another thread, time
+ * of one item. Yields while the queue is full. The last item is sent after
+ * setting benchDone, so the consumer wakes up to stop.
+ */
+__STATIC __VOID benchSpscProduce(__CONST char* name, u32 k, u8 prio, u32 iter)
+{
+	__PQUEUE queue = &benchSpsc[k];
+	pu32 slot;
+	u64 t;
+	u32 i;
+
+	__queueCreate(__QUEUE_ALLOC | __QUEUE_SPSC, queue, BENCH_SPSC_SLOTS, sizeof(u32), __NULL, 0);
+	benchDone = __FALSE;
+	benchSpscItems = 0;
+	__threadCreate(k ? "spscb" : "spscw", benchSpscConsumer, prio, BENCH_STACK, 1, queue);
+
+	t = __hostGetNanoseconds();
+	for (i = 0; i <= iter; i++)
+	{
+		while ((slot = __queueReserve(queue)) == __NULL) __threadYield();
+
+		if (i == iter) benchDone = __TRUE;
+		*slot = 1;
+		__queueCommit(queue, sizeof(u32));
+	}
+
+	while (benchSpscItems <= iter) __threadYield();
+	t = __hostGetNanoseconds() - t;
+
+	benchPrint(name, iter, t, 1);
+}
+
+/*
+ * __queueReserve(), __queueCommit(), __queuePeek() and __queueRelease() of a
+ * word: in the same thread, to a higher priority consumer woken up by each
+ * item, and to a consumer of the same priority taking them in batches.
+ */
+__STATIC __VOID benchQueueSpsc(__VOID)
+{
+	__QUEUE queue = {0};
+	pu32 slot;
+	u64 t;
+	u32 i;
+
+	__queueCreate(__QUEUE_ALLOC | __QUEUE_SPSC, &queue, BENCH_SPSC_SLOTS, sizeof(u32), __NULL, 0);
+
+	t = __hostGetNanoseconds();
+	for (i = 0; i < BENCH_ITER; i++)
+	{
+		slot = __queueReserve(&queue);
+		*slot = i;
+		__queueCommit(&queue, sizeof(u32));
+		slot = __queuePeek(&queue, __NULL);
+		__queueRelease(&queue);
+	}
+	t = __hostGetNanoseconds() - t;
+
+	benchPrint("queue_spsc", BENCH_ITER, t, 1);
+
+	benchSpscProduce("queue_spsc_wake", 0, BENCH_PRIO_HIGH, BENCH_ITER_SWITCH);
+	benchSpscProduce("queue_spsc_batch", 1, BENCH_PRIO, BENCH_ITER);
+}
+
+/*
+ * __heapAlloc() and __heapFree() of a block of the given size.
+ */
+__STATIC __VOID benchHeap(__CONST char* name, u32 size)
+{
+	__PVOID ptr;
+	u64 t;
+	u32 i;
+
+	t = __hostGetNanoseconds();
+	for (i = 0; i < BENCH_ITER; i++)
+	{
+		ptr = __heapAlloc(size);
+		__heapFree(ptr);
+	}
+	t = __hostGetNanoseconds() - t;
+
+	benchPrint(name, BENCH_ITER, t, 1);
+}
+
+/*
+ * Heap walk callback, sums the free space and finds the largest free block.
+ */
+__STATIC __BOOL benchHeapFree(__PVOID block, u32 size, __BOOL free, __PTHREAD owner, __PVOID arg)
+{
+	u32* acc = arg;
+
+	if (free)
+	{
+		acc[0] += size;
+		if (size > acc[1]) acc[1] = size;
+	}
+
+	return __TRUE;
+}
+
+/*
+ * Largest free block over the free space, in percent.
+ */
+__STATIC double benchHeapLargestFree(__VOID)
+{
+	u32 acc[2] = { 0, 0 };
+
+	__heapWalk(benchHeapFree, acc);
+
+	return acc[0] ? 100.0 * acc[1] / acc[0] : 100.0;
+}
+
+/*
+ * Seeded random trace of allocations and frees: each operation picks one of
+ * BENCH_HEAP_SLOTS slots, and frees its block or allocates a new one of 8
+ * bytes to 2 KB (small sizes more likely). Every operation is timed with
+ * interrupts disabled. Prints the percentiles of the allocation and free
+ * times, and the fragmentation: the largest free block over the free space,
+ * the lowest seen every BENCH_HEAP_CHECK operations and at the end.
+ */
+__STATIC __VOID benchHeapTrace(__VOID)
+{
+	u32 i, slot, size, allocs = 0, frees = 0;
+	double frag, worst = 100.0;
+	u64 t;
+
+	benchSeed = 1;
+
+	for (i = 0; i < BENCH_HEAP_TRACE; i++)
+	{
+		slot = benchRandom(BENCH_HEAP_SLOTS);
+
+		if (benchHeapSlots[slot])
+		{
+			__systemStop();
+			t = __hostGetNanoseconds();
+			__heapFree(benchHeapSlots[slot]);
+			benchHeapFreeTimes[frees++] = (u32) (__hostGetNanoseconds() - t);
+			__systemStart();
+			benchHeapSlots[slot] = __NULL;
+		} else {
+			size = 8 + benchRandom(1 << (3 + benchRandom(9)));
+
+			__systemStop();
+			t = __hostGetNanoseconds();
+			benchHeapSlots[slot] = __heapAlloc(size);
+			benchHeapAllocTimes[allocs++] = (u32) (__hostGetNanoseconds() - t);
+			__systemStart();
+		}
+
+		if (i % BENCH_HEAP_CHECK == BENCH_HEAP_CHECK - 1)
+		{
+			frag = benchHeapLargestFree();
+			if (frag < worst) worst = frag;
+		}
+	}
+
+	frag = benchHeapLargestFree();
+
+	for (i = 0; i < BENCH_HEAP_SLOTS; i++)
+	{
+		if (benchHeapSlots[i]) __heapFree(benchHeapSlots[i]);
+		benchHeapSlots[i] = __NULL;
+	}
+
+	benchPercentiles("heap_trace_alloc", benchHeapAllocTimes, allocs);
+	benchPercentiles("heap_trace_free", benchHeapFreeTimes, frees);
+	benchPrintValue("heap_trace_largest_pct", BENCH_HEAP_TRACE, frag);
+	benchPrintValue("heap_trace_worst_pct", BENCH_HEAP_TRACE / BENCH_HEAP_CHECK, worst);
+}
+
+/*
+ * __memCpy() (aligned and unaligned source), __memMove() of overlapping
+ * blocks, __memSet() and __memCmp() of equal blocks, for one block size.
+ */
+__STATIC __VOID benchMem(u32 size)
+{
+	u32 iter = BENCH_MEM_BYTES / size;
+	pu8 src = (pu8) benchMemSrc;
+	pu8 dst = (pu8) benchMemDst;
+	char name[32];
+	u64 t;
+	u32 i;
+
+	if (iter > BENCH_ITER) iter = BENCH_ITER;
+
+	t = __hostGetNanoseconds();
+	for (i = 0; i < iter; i++) __memCpy(dst, src, size);
+	t = __hostGetNanoseconds() - t;
+	snprintf(name, sizeof(name), "mem_cpy_%u", size);
+	benchPrint(name, iter, t, 1);
+
+	t = __hostGetNanoseconds();
+	for (i = 0; i < iter; i++) __memCpy(dst, src + 1, size);
+	t = __hostGetNanoseconds() - t;
+	snprintf(name, sizeof(name), "mem_cpy_unaligned_%u", size);
+	benchPrint(name, iter, t, 1);
+
+	t = __hostGetNanoseconds();
+	for (i = 0; i < iter; i++) __memMove(dst + sizeof(u32), dst, size);
+	t = __hostGetNanoseconds() - t;
+	snprintf(name, sizeof(name), "mem_move_%u", size);
+	benchPrint(name, iter, t, 1);
+
+	t = __hostGetNanoseconds();
+	for (i = 0; i < iter; i++) __memSet(dst, (u8) i, size);
+	t = __hostGetNanoseconds() - t;
+	snprintf(name, sizeof(name), "mem_set_%u", size);
+	benchPrint(name, iter, t, 1);
+
+	__memCpy(dst, src, size);
+	t = __hostGetNanoseconds();
+	for (i = 0; i < iter; i++) __memCmp(dst, src, size);
+	t = __hostGetNanoseconds() - t;
+	snprintf(name, sizeof(name), "mem_cmp_%u", size);
+	benchPrint(name, iter, t, 1);
+}
+
+/*
+ * Empties the binary log ring.
+ */
+__STATIC __VOID benchLogDrain(__VOID)
+{
+	u32 rec[__LOG_MAX_ARGS + 2];
+
+	while (__logRead(rec, __LOG_MAX_ARGS + 2));
+}
+
+/*
+ * __LOG() cost per call: records with no and three arguments, and a record
+ * filtered out by the module level. The ring is emptied every BENCH_LOG_BATCH
+ * records, out of the measure, so no record is dropped.
+ */
+__STATIC __VOID benchLog(__VOID)
+{
+	u64 t0, t;
+	u32 i, j;
+
+	benchLogDrain();
+	__logSetLevel(__LOG_MOD_APP, __LOG_INFO);
+
+	for (i = 0, t = 0; i < BENCH_ITER; i += BENCH_LOG_BATCH)
+	{
+		t0 = __hostGetNanoseconds();
+		for (j = 0; j < BENCH_LOG_BATCH; j++) LOGI(__LOG_MOD_APP, "bench");
+		t += __hostGetNanoseconds() - t0;
+		benchLogDrain();
+	}
+	benchPrint("log_write_0args", BENCH_ITER, t, 1);
+
+	for (i = 0, t = 0; i < BENCH_ITER; i += BENCH_LOG_BATCH)
+	{
+		t0 = __hostGetNanoseconds();
+		for (j = 0; j < BENCH_LOG_BATCH; j++) LOGI(__LOG_MOD_APP, "bench %lu %lu %lu", i, j, i + j);
+		t += __hostGetNanoseconds() - t0;
+		benchLogDrain();
+	}
+	benchPrint("log_write_3args", BENCH_ITER, t, 1);
+
+	t = __hostGetNanoseconds();
+	for (i = 0; i < BENCH_ITER; i++) LOGD(__LOG_MOD_APP, "bench %lu", i);
+	t = __hostGetNanoseconds() - t;
+	benchPrint("log_filtered", BENCH_ITER, t, 1);
+}
+
+/*
+ * Work item of the submit benchmark, does nothing.
+ */
+__STATIC __VOID benchWorkNop(__PVOID arg)
+{
+}
+
+/*
+ * Work item of the round trip benchmark.
+ */
+__STATIC __VOID benchWorkPong(__PVOID arg)
+{
+	__eventSet(&benchPong);
+}
+
+/*
+ * The processing of a received buffer, done by the simulated interrupt or
+ * deferred to a work item.
+ */
+__STATIC __VOID benchIsrProcess(__PVOID arg)
+{
+	u32 i, sum = 0;
+
+	for (i = 0; i < BENCH_ISR_BYTES; i++) sum = (sum << 1 | sum >> 31) ^ benchIsrData[i];
+	benchIsrSum = sum;
+}
+
+/*
+ * Function of the benchmark timers: samples the distance of the interval
+ * between firings to the period.
+ */
+__STATIC __VOID benchTimerFunc(__PVOID param)
+{
+	u32 i = (u32) param;
+	u64 now = __hostGetNanoseconds();
+	i32 d;
+
+	benchTimerFired++;
+
+	if (benchTimerLast[i] && benchTimerQuota[i] && benchTimerSamples < BENCH_TIMER_JITTER)
+	{
+		d = (i32) (now - benchTimerLast[i]) - (i32) (1 + i % BENCH_TIMER_PERIOD) * 1000000;
+		benchTimerJitter[benchTimerSamples++] = (u32) (d < 0 ? -d : d);
+		benchTimerQuota[i]--;
+	}
+
+	benchTimerLast[i] = now;
+}
+
+/*
+ * Lowest priority thread, spins until benchDone counting the CPU time taken
+ * by the other threads and the interrupts: the gaps between two reads.
+ */
+__STATIC __VOID benchTimerSpinner(__VOID)
+{
+	u64 start, now, last, stolen;
+
+	for (;;)
+	{
+		__eventWait(&benchTimerGate, 0);
+		__eventReset(&benchTimerGate);
+
+		stolen = 0;
+		start = last = benchCpuTime();
+		while (!benchDone)
+		{
+			now = benchCpuTime();
+			if (now - last > BENCH_TIMER_GAP) stolen += now - last;
+			last = now;
+		}
+
+		benchTimerWall = last - start;
+		benchTimerStolen = stolen;
+		__eventSet(&benchTimerSpun);
+	}
+}
+
+/*
+ * Runs \c cnt periodic timers (periods 1 to BENCH_TIMER_PERIOD ticks) for
+ * BENCH_TIMER_TICKS ticks, while the spinner measures the CPU taken.
+ * Returns the CPU fraction taken.
+ */
+__STATIC double benchTimerRound(u32 cnt)
+{
+	u32 i;
+
+	benchTimerSamples = benchTimerFired = 0;
+	for (i = 0; i < cnt; i++)
+	{
+		benchTimerLast[i] = 0;
+		benchTimerQuota[i] = BENCH_TIMER_JITTER / cnt;
+		benchTimers[i] = __timerCreate(__TM_NORMAL, 1 + i % BENCH_TIMER_PERIOD, benchTimerFunc, (__PVOID) i);
+	}
+
+	benchDone = __FALSE;
+	__eventReset(&benchTimerSpun);
+	__eventSet(&benchTimerGate);
+	__threadSleep(BENCH_TIMER_TICKS);
+	benchDone = __TRUE;
+	__eventWait(&benchTimerSpun, 0);
+
+	for (i = 0; i < cnt; i++) __timerDestroy(benchTimers[i]);
+
+	return (double) benchTimerStolen / (double) benchTimerWall;
+}
+
+/*
+ * Timer dispatch with 1 to BENCH_TIMER_MAX periodic timers: the CPU load and
+ * the jitter of the interval between two firings of a timer. Then the CPU
+ * time of one expiry, from the load of BENCH_TIMER_MAX timers over the load
+ * without timers (with few timers the difference is within the noise).
+ */
+__STATIC __VOID benchTimer(__VOID)
+{
+	char name[32];
+	double idle, load;
+	u32 cnt;
+
+	__timerInit(__CONFIG_STACK_TIMTHREAD);
+	__eventReset(&benchTimerGate);
+	__threadCreate("tmspin", benchTimerSpinner, BENCH_TIMER_SPIN_PRIO, BENCH_STACK, 1, __NULL);
+
+	idle = benchTimerRound(0);
+
+	for (cnt = 1; cnt <= BENCH_TIMER_MAX; cnt *= 10)
+	{
+		load = benchTimerRound(cnt);
+
+		snprintf(name, sizeof(name), "timer_%u_load_pct", cnt);
+		benchPrintValue(name, cnt, load * 100.0);
+		snprintf(name, sizeof(name), "timer_%u_jitter", cnt);
+		benchPercentiles(name, benchTimerJitter, BENCH_TIMER_JITTER);
+	}
+
+	benchPrintValue("timer_expiry", BENCH_TIMER_MAX, (load - idle) * (double) benchTimerWall / (double) benchTimerFired);
+}
+
+/*
+ * __workSubmit() cost per item, with the worker not running, and the round
+ * trip to a higher priority worker thread. Then the duration of a simulated
+ * interrupt (interrupts disabled) processing a buffer and setting an event,
+ * against the same interrupt deferring the processing to a work item.
+ */
+__STATIC __VOID benchWorkQueue(__VOID)
+{
+	__PWORKQUEUE wq;
+	__WORK wk;
+	u64 t0, t;
+	u32 i, j;
+
+	wq = __workQueueCreate("benchwq", BENCH_PRIO_HIGH, BENCH_STACK);
+
+	for (i = 0; i < BENCH_WORK_BATCH; i++) __workPrepare(&benchWork[i], benchWorkNop, __NULL);
+
+	for (i = 0, t = 0; i < BENCH_ITER; i += BENCH_WORK_BATCH)
+	{
+		__systemDisableScheduler();
+		t0 = __hostGetNanoseconds();
+		for (j = 0; j < BENCH_WORK_BATCH; j++) __workSubmit(wq, &benchWork[j]);
+		t += __hostGetNanoseconds() - t0;
+		__systemEnableScheduler();
+	}
+	benchPrint("work_submit", BENCH_ITER, t, 1);
+
+	__workPrepare(&wk, benchWorkPong, __NULL);
+
+	t = __hostGetNanoseconds();
+	for (i = 0; i < BENCH_ITER_SWITCH; i++)
+	{
+		__eventReset(&benchPong);
+		__workSubmit(wq, &wk);
+		__eventWait(&benchPong, 0);
+	}
+	t = __hostGetNanoseconds() - t;
+	benchPrint("work_roundtrip", BENCH_ITER_SWITCH, t, 1);
+
+	for (i = 0; i < BENCH_ISR_BYTES; i++) benchIsrData[i] = (u8) i;
+
+	for (i = 0; i < BENCH_ISR_SAMPLES; i++)
+	{
+		__systemStop();
+		t = __hostGetNanoseconds();
+		benchIsrProcess(__NULL);
+		__eventSet(&benchPong);
+		benchIsrTimes[i] = (u32) (__hostGetNanoseconds() - t);
+		__systemStart();
+	}
+	benchPercentiles("isr_inline", benchIsrTimes, BENCH_ISR_SAMPLES);
+
+	__workPrepare(&wk, benchIsrProcess, __NULL);
+
+	for (i = 0; i < BENCH_ISR_SAMPLES; i++)
+	{
+		__systemStop();
+		t = __hostGetNanoseconds();
+		__workSubmit(wq, &wk);
+		benchIsrTimes[i] = (u32) (__hostGetNanoseconds() - t);
+		__systemStart();
+	}
+	benchPercentiles("isr_deferred", benchIsrTimes, BENCH_ISR_SAMPLES);
+}
+
+/*
+ * Loopback device, reads return the bytes written.
+ */
+__STATIC i32 benchLoopInit(__PDEVICE dv, __PVOID params)
+{
+	return __DEV_OK;
+}
+
+__STATIC i32 benchLoopOpen(__PDEVICE dv, u32 param)
+{
+	return __DEV_OK;
+}
+
+__STATIC i32 benchLoopClose(__PDEVICE dv)
+{
+	return __DEV_OK;
+}
+
+__STATIC i32 benchLoopRead(__PDEVICE dv, __PVOID buf, u16 qty)
+{
+	pu8 p = buf;
+	u16 i;
+
+	if (qty > benchLoopHead - benchLoopTail) qty = benchLoopHead - benchLoopTail;
+	for (i = 0; i < qty; i++) p[i] = benchLoopBuf[benchLoopTail++ & (BENCH_LOOP_SIZE - 1)];
+
+	return qty;
+}
+
+__STATIC i32 benchLoopWrite(__PDEVICE dv, __CONST __PVOID buf, u16 qty)
+{
+	__CONST u8* p = buf;
+	u16 i;
+
+	if (qty > BENCH_LOOP_SIZE - (benchLoopHead - benchLoopTail)) qty = BENCH_LOOP_SIZE - (benchLoopHead - benchLoopTail);
+	for (i = 0; i < qty; i++) benchLoopBuf[benchLoopHead++ & (BENCH_LOOP_SIZE - 1)] = p[i];
+	if (qty && dv->dv_rxev) __eventSet(dv->dv_rxev);
+
+	return qty;
+}
+
+__STATIC i32 benchLoopSize(__PDEVICE dv, u8 mode)
+{
+	return (mode == __DEV_RXSIZE) ? (i32) (benchLoopHead - benchLoopTail) : 0;
+}
+
+/*
+ * The loopback device, added first so that it is the last of the list, and
+ * other devices to look up.
+ */
+__STATIC __DEVICE benchDevices[] = {
+	{ .dv_name = "loop", .dv_init = benchLoopInit, .dv_open = benchLoopOpen, .dv_close = benchLoopClose,
+	  .dv_read = benchLoopRead, .dv_write = benchLoopWrite, .dv_size = benchLoopSize },
+	{ .dv_name = "dummy0" }, { .dv_name = "dummy1" }, { .dv_name = "dummy2" }, { .dv_name = "dummy3" },
+	{ .dv_name = "dummy4" }, { .dv_name = "dummy5" }, { .dv_name = "dummy6" }, { .dv_name = "dummy7" },
+};
+
+/*
+ * Device layer costs through the loopback device: name lookup, one byte
+ * reads and line reads (32 bytes lines, CR LF ended), through the device
+ * and through a handle.
+ */
+__STATIC __VOID benchDevice(__VOID)
+{
+	__PDEVICE dv;
+	__DEVHANDLE dh;
+	__DEVLINE lr;
+	__DEVIOVEC iov[4];
+	char line[64];
+	u8 ahead[256];
+	u64 t0, t;
+	u32 i, j;
+
+	__deviceAdd(benchDevices, sizeof(benchDevices) / sizeof(__DEVICE));
+
+	t = __hostGetNanoseconds();
+	for (i = 0; i < BENCH_ITER; i++) dv = __deviceFind("loop");
+	t = __hostGetNanoseconds() - t;
+	benchPrint("dev_find", BENCH_ITER, t, 1);
+
+	__deviceInit(dv, __NULL, __DEV_RD_CRLF);
+	__deviceOpen(dv, 0);
+	__memSet(line, 'x', BENCH_DEV_BATCH);
+
+	for (i = 0, t = 0; i < BENCH_ITER; i += BENCH_DEV_BATCH)
+	{
+		benchLoopWrite(dv, line, BENCH_DEV_BATCH);
+		t0 = __hostGetNanoseconds();
+		for (j = 0; j < BENCH_DEV_BATCH; j++) __deviceRead(dv, line, 1);
+		t += __hostGetNanoseconds() - t0;
+	}
+	benchPrint("dev_read_1", BENCH_ITER, t, 1);
+
+	for (i = 0, t = 0; i < BENCH_ITER_SWITCH; i += 16)
+	{
+		for (j = 0; j < 16; j++) benchLoopWrite(dv, BENCH_DEV_LINE, 32);
+		t0 = __hostGetNanoseconds();
+		for (j = 0; j < 16; j++) __deviceReadLine(dv, line, sizeof(line));
+		t += __hostGetNanoseconds() - t0;
+	}
+	benchPrint("dev_readline", BENCH_ITER_SWITCH, t, 1);
+
+	__deviceClose(dv);
+	__deviceOpenHandle(&dh, dv, 0);
+
+	for (i = 0, t = 0; i < BENCH_ITER; i += BENCH_DEV_BATCH)
+	{
+		benchLoopWrite(dv, line, BENCH_DEV_BATCH);
+		t0 = __hostGetNanoseconds();
+		for (j = 0; j < BENCH_DEV_BATCH; j++) __deviceHRead(&dh, line, 1);
+		t += __hostGetNanoseconds() - t0;
+	}
+	benchPrint("dev_hread_1", BENCH_ITER, t, 1);
+
+	for (i = 0; i < 4; i++)
+	{
+		iov[i].iov_base = line + i * 16;
+		iov[i].iov_len = 16;
+	}
+
+	for (i = 0, t = 0; i < BENCH_ITER_SWITCH; i++)
+	{
+		benchLoopWrite(dv, line, BENCH_DEV_BATCH);
+		t0 = __hostGetNanoseconds();
+		__deviceReadV(dv, iov, 4);
+		t += __hostGetNanoseconds() - t0;
+	}
+	benchPrint("dev_readv_4x16", BENCH_ITER_SWITCH, t, 1);
+
+	__deviceLineInit(&lr, &dh, ahead, sizeof(ahead));
+
+	for (i = 0, t = 0; i < BENCH_ITER_SWITCH; i += 16)
+	{
+		for (j = 0; j < 16; j++) benchLoopWrite(dv, BENCH_DEV_LINE, 32);
+		t0 = __hostGetNanoseconds();
+		for (j = 0; j < 16; j++) __deviceLineRead(&lr, line, sizeof(line));
+		t += __hostGetNanoseconds() - t0;
+	}
+	benchPrint("dev_lineread", BENCH_ITER_SWITCH, t, 1);
+
+	__deviceCloseHandle(&dh);
+}
+
+/*
+ * Output device of the terminal benchmark, discards the bytes.
+ */
+__STATIC i32 benchNullWrite(__PDEVICE dv, __CONST __PVOID buf, u16 qty)
+{
+	return qty;
+}
+
+__STATIC i32 benchNullFlush(__PDEVICE dv)
+{
+	return __DEV_OK;
+}
+
+__STATIC __DEVICE benchNullDevice = {
+	.dv_name = "null", .dv_init = benchLoopInit, .dv_open = benchLoopOpen, .dv_close = benchLoopClose,
+	.dv_write = benchNullWrite, .dv_flush = benchNullFlush
+};
+
+/*
+ * Serial devices fed by __uartLineReceive(): one RXNE interrupt per byte, and
+ * circular RX DMA with the IDLE line interrupt.
+ */
+#define BENCH_UART_DEVICE(name, i)	{ \
+	.dv_name = name, .dv_type = __DEV_USART, .dv_rxint = BENCH_UART_IRQ, .dv_txint = BENCH_UART_IRQ, \
+	.dv_rxev = &benchUartEvents[i][0], .dv_txev = &benchUartEvents[i][1], \
+	.dv_pdb = &benchUartPdb[i], .dv_params = &benchUartParams[i], \
+	.dv_init = __serialInit, .dv_deinit = __serialDeinit, .dv_ioctl = __serialIOCtl, \
+	.dv_open = __serialOpen, .dv_close = __serialClose, .dv_read = __serialRead, \
+	.dv_write = __serialWrite, .dv_flush = __serialFlush, .dv_size = __serialSize, \
+	.dv_plat_ioctl = __serialPlatIoCtl }
+
+__STATIC __SERIAL_PDB benchUartPdb[2];
+__STATIC __EVENT benchUartEvents[2][2];
+__STATIC UART_PARAMS benchUartParams[2] = { { -1, -1, 0 }, { -1, -1, 1 } };
+__STATIC __DEVICE benchUartDevices[2] = { BENCH_UART_DEVICE("uartrxne", 0), BENCH_UART_DEVICE("uartdma", 1) };
+
+/*
+ * Reception of BENCH_UART_BYTES bytes in frames of random length on the
+ * simulated line of the host UART, one RXNE interrupt per byte against the
+ * circular DMA with the IDLE line interrupt: the bytes per interrupt, the
+ * time spent in the interrupts per byte, and that time as CPU load at
+ * BENCH_UART_BAUD, in parts per million. The frames are read after each one, untimed.
+ */
+__STATIC __VOID benchUart(__VOID)
+{
+	__SERIAL_CONFIG config = { BENCH_UART_RXBUF, __SERIAL_MINTXBUFLEN };
+	__CONST char* names[2] = { "uart_rxne", "uart_dma" };
+	u8 frame[BENCH_UART_FRAME];
+	char name[32];
+	__PDEVICE dv;
+	PUART_PARAMS params;
+	u32 k, i, len, done;
+	u64 t, t0;
+
+	__deviceAdd(benchUartDevices, 2);
+
+	for (k = 0; k < 2; k++)
+	{
+		dv = &benchUartDevices[k];
+		params = dv->dv_params;
+		__deviceInit(dv, &config, 0);
+		__deviceOpen(dv, BENCH_UART_BAUD);
+
+		for (done = 0, t = 0; done < BENCH_UART_BYTES; done += len)
+		{
+			len = 1 + benchRandom(BENCH_UART_FRAME);
+			if (len > BENCH_UART_BYTES - done) len = BENCH_UART_BYTES - done;
+			for (i = 0; i < len; i++) frame[i] = (u8) (done + i);
+
+			__systemStop();
+			t0 = __hostGetNanoseconds();
+			__uartLineReceive(dv, frame, len);
+			t += __hostGetNanoseconds() - t0;
+			__systemStart();
+
+			__deviceRead(dv, frame, len);
+		}
+
+		snprintf(name, sizeof(name), "%s_bytes_per_irq", names[k]);
+		benchPrintValue(name, BENCH_UART_BYTES, (double) BENCH_UART_BYTES / params->rx_irqs);
+		benchPrint(names[k], BENCH_UART_BYTES, t, 1);
+		snprintf(name, sizeof(name), "%s_load_ppm", names[k]);
+		benchPrintValue(name, BENCH_UART_BYTES, (double) t / BENCH_UART_BYTES * (BENCH_UART_BAUD / 10) / 1e3);
+	}
+}
+
+/*
+ * SPI master of the host loopback model, with the simulated DMA.
+ */
+__STATIC __SPI_PDB benchSpiPdb;
+__STATIC __EVENT benchSpiEvents[2];
+__STATIC SPI_PARAMS benchSpiParams = { 1 };
+__STATIC __DEVICE benchSpiDevice = {
+	.dv_name = "bspi", .dv_type = __DEV_SPI, .dv_rxev = &benchSpiEvents[0], .dv_txev = &benchSpiEvents[1],
+	.dv_pdb = &benchSpiPdb, .dv_params = &benchSpiParams,
+	.dv_init = __spiInit, .dv_deinit = __spiDeinit, .dv_ioctl = __spiIOCtl,
+	.dv_open = __spiOpen, .dv_close = __spiClose, .dv_read = __spiRead,
+	.dv_write = __spiWrite, .dv_flush = __spiFlush, .dv_size = __spiSize,
+	.dv_plat_ioctl = __spiPlatIoCtl
+};
+
+__STATIC __SPI_XFER benchSpiXf[BENCH_SPI_CHAIN];
+__STATIC u8 benchSpiTx[BENCH_SPI_MAX];
+__STATIC u8 benchSpiRx[BENCH_SPI_MAX];
+
+/*
+ * One full-duplex transaction of \c len bytes with __spiTransferWait(): the
+ * time of the driver and of the loopback copy, the throughput in MB/s, and
+ * that time as CPU load over the bus time at BENCH_SPI_CLOCK, in percent.
+ * The time includes the copy of the model, done by the DMA on the target,
+ * so the load is an upper bound.
+ */
+__STATIC __VOID benchSpiXfer(u16 len)
+{
+	char name[32];
+	u64 t;
+	u32 i;
+
+	__memSet(benchSpiXf, 0, sizeof(__SPI_XFER));
+	benchSpiXf[0].xf_tx = benchSpiTx;
+	benchSpiXf[0].xf_rx = benchSpiRx;
+	benchSpiXf[0].xf_len = len;
+
+	t = __hostGetNanoseconds();
+	for (i = 0; i < BENCH_SPI_ITER; i++) __spiTransferWait(&benchSpiDevice, benchSpiXf, 0);
+	t = __hostGetNanoseconds() - t;
+
+	snprintf(name, sizeof(name), "spi_xfer_%u", (unsigned) len);
+	benchPrint(name, BENCH_SPI_ITER, t, 1);
+	snprintf(name, sizeof(name), "spi_xfer_%u_mb_s", (unsigned) len);
+	benchPrintValue(name, BENCH_SPI_ITER, (double) len * BENCH_SPI_ITER * 1e3 / t);
+	snprintf(name, sizeof(name), "spi_xfer_%u_load_pct", (unsigned) len);
+	benchPrintValue(name, BENCH_SPI_ITER, (double) t / BENCH_SPI_ITER * BENCH_SPI_CLOCK / (len * 8.0) / 1e7);
+}
+
+/*
+ * SPI transfer engine on the host loopback model, where a transfer takes no
+ * bus time: single descriptors of growing length, a transaction of
+ * BENCH_SPI_CHAIN descriptors (time per descriptor), and BENCH_SPI_FIFO bytes
+ * through __spiWrite(), __spiFlush() and __spiRead() against one descriptor
+ * of the same length.
+ */
+__STATIC __VOID benchSpi(__VOID)
+{
+	__SPI_CONFIG config = { BENCH_SPI_FIFO, BENCH_SPI_FIFO };
+	u64 t;
+	u32 i;
+
+	for (i = 0; i < BENCH_SPI_MAX; i++) benchSpiTx[i] = (u8) i;
+
+	__deviceAdd(&benchSpiDevice, 1);
+	__deviceInit(&benchSpiDevice, &config, 0);
+	__deviceOpen(&benchSpiDevice, __SPIMODE_MASTER);
+
+	benchSpiXfer(1);
+	benchSpiXfer(16);
+	benchSpiXfer(256);
+	benchSpiXfer(BENCH_SPI_MAX);
+
+	__memSet(benchSpiXf, 0, sizeof(benchSpiXf));
+	for (i = 0; i < BENCH_SPI_CHAIN; i++)
+	{
+		benchSpiXf[i].xf_tx = benchSpiTx + i * 256;
+		benchSpiXf[i].xf_rx = benchSpiRx + i * 256;
+		benchSpiXf[i].xf_len = 256;
+		if (i) benchSpiXf[i - 1].xf_next = &benchSpiXf[i];
+	}
+
+	t = __hostGetNanoseconds();
+	for (i = 0; i < BENCH_SPI_ITER; i++) __spiTransferWait(&benchSpiDevice, benchSpiXf, 0);
+	t = __hostGetNanoseconds() - t;
+	benchPrint("spi_xfer_chain_256", BENCH_SPI_ITER, t, BENCH_SPI_CHAIN);
+
+	__deviceIOCtl(&benchSpiDevice, __IOCTL_ASSERT_CS, 1, __NULL, 0);
+
+	t = __hostGetNanoseconds();
+	for (i = 0; i < BENCH_SPI_ITER; i++)
+	{
+		__deviceWrite(&benchSpiDevice, benchSpiTx, BENCH_SPI_FIFO);
+		__deviceFlush(&benchSpiDevice);
+		__deviceRead(&benchSpiDevice, benchSpiRx, BENCH_SPI_FIFO);
+	}
+	t = __hostGetNanoseconds() - t;
+	benchPrint("spi_fifo_256", BENCH_SPI_ITER, t, 1);
+}
+
+/*
+ * I2C masters of the host model, the bus moved by the simulated interrupt
+ * after each tick: one interrupt per byte, and DMA for the longer phases.
+ */
+#define BENCH_I2C_DEVICE(name, i)	{ \
+	.dv_name = name, .dv_type = __DEV_I2C, .dv_rxint = BOARD_HOST_I2C1_IRQ, .dv_txint = BOARD_HOST_I2C1_IRQ, \
+	.dv_pdb = &benchI2cPdb[i], .dv_params = &benchI2cParams[i], \
+	.dv_init = __i2cInit, .dv_deinit = __i2cDeinit, .dv_ioctl = __i2cIOCtl, \
+	.dv_open = __i2cOpen, .dv_close = __i2cClose, .dv_read = __i2cRead, \
+	.dv_write = __i2cWrite, .dv_flush = __i2cFlush, .dv_size = __i2cSize, \
+	.dv_plat_ioctl = __i2cPlatIoCtl }
+
+__STATIC __I2C_PDB benchI2cPdb[2];
+__STATIC I2C_PARAMS benchI2cParams[2] = {
+	{ BENCH_I2C_SPEED, 0, BENCH_I2C_SLAVE }, { BENCH_I2C_SPEED, 1, BENCH_I2C_SLAVE }
+};
+__STATIC __DEVICE benchI2cDevices[2] = { BENCH_I2C_DEVICE("i2cirq", 0), BENCH_I2C_DEVICE("i2cdma", 1) };
+
+/*
+ * BENCH_I2C_JOBS register reads of BENCH_I2C_LEN bytes with __i2cTransfer(),
+ * one interrupt per byte against DMA: the interrupts of the target per bus
+ * byte, the time spent in the interrupts per job, and that time as CPU load
+ * while the bus runs, in parts per million. The calling thread sleeps during
+ * each job, so the interrupts are all the CPU taken by the transfers.
+ */
+__STATIC __VOID benchI2c(__VOID)
+{
+	__CONST char* names[2] = { "i2c_irq", "i2c_dma" };
+	u8 rx[BENCH_I2C_LEN];
+	u8 reg = 0;
+	__I2C_JOB job;
+	char name[32];
+	__PDEVICE dv;
+	PI2C_PARAMS params;
+	u32 k, i;
+	u64 t;
+
+	__deviceAdd(benchI2cDevices, 2);
+
+	for (k = 0; k < 2; k++)
+	{
+		dv = &benchI2cDevices[k];
+		params = dv->dv_params;
+		__deviceInit(dv, __NULL, 0);
+		__deviceOpen(dv, __I2C_MODE_MASTER);
+
+		__memSet(&job, 0, sizeof(job));
+		job.jb_addr = BENCH_I2C_SLAVE;
+		job.jb_tx = &reg;
+		job.jb_txlen = 1;
+		job.jb_rx = rx;
+		job.jb_rxlen = BENCH_I2C_LEN;
+
+		t = __hostGetNanoseconds();
+		for (i = 0; i < BENCH_I2C_JOBS; i++) __i2cTransfer(dv, &job, 0);
+		t = __hostGetNanoseconds() - t;
+
+		snprintf(name, sizeof(name), "%s_irqs_per_byte", names[k]);
+		benchPrintValue(name, params->bytes, (double) params->irqs / params->bytes);
+		benchPrint(names[k], BENCH_I2C_JOBS, params->isr_ns, 1);
+		snprintf(name, sizeof(name), "%s_load_ppm", names[k]);
+		benchPrintValue(name, BENCH_I2C_JOBS, (double) params->isr_ns * 1e6 / t);
+
+		__deviceClose(dv);
+	}
+}
+
+/*
+ * Command of the terminal benchmark, wakes up the bench thread at the end
+ * of each batch.
+ */
+__STATIC __VOID benchTermCommand(__PTERMINAL term, __PSTRING cmd, __PSTRING params)
+{
+	if (++benchTermRuns == benchTermTarget) __eventSet(&benchPong);
+}
+
+/*
+ * Terminal replaying a command script through the loopback device, from
+ * the reception of the line to the command function.
+ */
+__STATIC __VOID benchTerminal(__VOID)
+{
+	__PDEVICE dv = __deviceFind("loop");
+	__PTERMINAL term;
+	char line[32];
+	u64 t;
+	u32 i, j, len;
+
+	__deviceAdd(&benchNullDevice, 1);
+	__deviceInit(&benchNullDevice, __NULL, 0);
+	__deviceOpen(&benchNullDevice, 0);
+
+	benchLoopEvent.ev_state = __EV_RESET;
+	benchLoopEvent.ev_threads = __NULL;
+	benchLoopEvent.ev_links = __NULL;
+	dv->dv_rxev = &benchLoopEvent;
+	benchLoopHead = benchLoopTail = 0;
+	__deviceOpen(dv, 0);
+
+	for (i = 0; i < BENCH_TERM_CMDS; i++)
+	{
+		snprintf(benchTermNames[i], sizeof(benchTermNames[i]), "diag%02u", (unsigned) ((i * 37) % BENCH_TERM_CMDS));
+		benchTermCmds[i].cmd = benchTermNames[i];
+		benchTermCmds[i].func = benchTermCommand;
+	}
+
+	term = __terminalCreate("bterm", dv, &benchNullDevice, 0, __NULL, 0);
+	__terminalAddCommand(term, benchTermCmds, BENCH_TERM_CMDS);
+	__terminalStart(term);
+
+	/* Let the terminal write its banner */
+	__threadSleep(2);
+
+	for (i = 0, t = __hostGetNanoseconds(); i < BENCH_TERM_LINES; i += BENCH_TERM_BATCH)
+	{
+		__eventReset(&benchPong);
+		benchTermTarget = benchTermRuns + BENCH_TERM_BATCH;
+
+		for (j = 0; j < BENCH_TERM_BATCH; j++)
+		{
+			len = snprintf(line, sizeof(line), "diag%02u on %u\r", (unsigned) ((i + j) * 13 % BENCH_TERM_CMDS), (unsigned) j);
+			benchLoopWrite(dv, line, len);
+		}
+
+		__eventWait(&benchPong, 0);
+	}
+	t = __hostGetNanoseconds() - t;
+	benchPrint("term_command", BENCH_TERM_LINES, t, 1);
+}
+
+/*
+ * Runs every benchmark, then ends the process.
+ */
+__STATIC __VOID benchThread(__VOID)
+{
+	__systemStop();
+	printf("%-24s %10s %12s\n", "# name", "iterations", "ns/op");
+	__systemStart();
+
+	benchThreadYield();
+	benchSched();
+	benchEventNoWait();
+	benchEventPingPong();
+	benchWaitMultiple();
+	benchLock();
+	benchQueue();
+	benchQueueSpsc();
+	benchHeap("heap_alloc_free_16", 16);
+	benchHeap("heap_alloc_free_256", 256);
+	benchHeapTrace();
+	benchMem(1);
+	benchMem(16);
+	benchMem(256);
+	benchMem(4096);
+	benchMem(BENCH_MEM_MAX);
+	benchLog();
+	benchWorkQueue();
+	benchTimer();
+	benchDevice();
+	benchUart();
+	benchSpi();
+	benchI2c();
+	benchTerminal();
+
+	__hostExit(0);
+}
+
+/*
+ * Application entry point, called from the system thread.
+ */
+__STATIC __VOID benchEntry(__VOID)
+{
+	__eventReset(&benchStop);
+	__threadCreate("bench", benchThread, BENCH_PRIO, BENCH_STACK, 1, __NULL);
+}
+
+int main(void)
+{
+	__systemInit(benchEntry);
+	return 0;
+}
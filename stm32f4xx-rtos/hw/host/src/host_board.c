@@ -0,0 +1,96 @@
+/***************************************************************************
+ * host_board.c
+ * (C) 2010 Ivan Meleca
+ * Based on original code written by Ruben Meleca
+ * www.milos.it
+
+#   This program is free software; you can redistribute it and/or modify
+#   it under the terms of the GNU General Public License as published by
+#   the Free Software Foundation; either version 2 of the License, or
+#   (at your option) any later version.
+#
+#   This program is distributed in the hope that it will be useful,
+#   but WITHOUT ANY WARRANTY; without even the implied warranty of
+#   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#   GNU General Public License for more details.
+#
+#   You should have received a copy of the GNU General Public License
+#   along with this program; if not, write to the Free Software
+#   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+***************************************************************************/
+
+#include <plat_config.h>
+
+#ifdef BOARD_HOST
+
+#include "host_board.h"
+#include <drivers/inc/serial.h>
+
+#if __CONFIG_COMPILE_SERIAL
+
+/*
+ * Serial devices of the host simulator: "serial1" reads stdin and writes
+ * stdout, so the debug terminal runs in the host terminal.
+ */
+
+/* UART count for the host */
+#define BOARD_UART_COUNT				1
+
+/* UART1 parameters */
+#define BOARD_UART1_RX_FD				0		// stdin
+#define BOARD_UART1_TX_FD				1		// stdout
+
+__STATIC __SERIAL_PDB serialPdb[BOARD_UART_COUNT];
+__STATIC __EVENT serialTxEvts[BOARD_UART_COUNT];
+__STATIC __EVENT serialRxEvts[BOARD_UART_COUNT];
+
+__STATIC UART_PARAMS uartParams[BOARD_UART_COUNT] = {
+	{
+		BOARD_UART1_RX_FD,
+		BOARD_UART1_TX_FD
+	}
+};
+
+__STATIC __DEVICE serialDevices[BOARD_UART_COUNT] = {
+		{
+			"serial1",
+			__DEV_USART,
+			0,
+			BOARD_HOST_UART1_IRQ,
+			BOARD_HOST_UART1_IRQ,
+			0,
+			0,
+			&serialTxEvts[0],		// TX event manager
+			&serialRxEvts[0],		// RX event manager
+			__NULL,
+			&serialPdb[0],
+			&uartParams[0],
+			__NULL,					// Pointer to next device driver
+			__serialInit,			// Device init function
+			__serialDeinit,			// Device destroy function
+			__serialIOCtl,			// Device IO control function
+			__serialOpen,			// Device open function
+			__serialClose,			// Device close function
+			__serialRead,			// Device read function
+			__serialWrite,			// Device write function
+			__serialFlush,			// Device flush function
+			__serialSize,			// Device size function
+			__serialPlatIoCtl,		// Platform-related IO control */
+		}
+};
+
+#endif // __CONFIG_COMPILE_SERIAL
+
+/*
+ * Board initialization, called from __cpuInitHardware().
+ */
+__VOID __boardInitHW(__VOID)
+{
+	/* Add every board __DEVICE */
+#if __CONFIG_COMPILE_SERIAL
+	__deviceAdd(serialDevices, BOARD_UART_COUNT);
+#endif /* __CONFIG_COMPILE_SERIAL */
+}
+
+#endif /* BOARD_HOST */
@@ -0,0 +1,610 @@
+/***************************************************************************
+ * plat_cpu.c
+ * (C) 2010 Ivan Meleca
+ * Based on original code written by Ruben Meleca
+ * www.milos.it
+
+#   This program is free software; you can redistribute it and/or modify
+#   it under the terms of the GNU General Public License as published by
+#   the Free Software Foundation; either version 2 of the License, or
+#   (at your option) any later version.
+#
+#   This program is distributed in the hope that it will be useful,
+#   but WITHOUT ANY WARRANTY; without even the implied warranty of
+#   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#   GNU General Public License for more details.
+#
+#   You should have received a copy of the GNU General Public License
+#   along with this program; if not, write to the Free Software
+#   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+***************************************************************************/
+
+#define _GNU_SOURCE
+
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/time.h>
+#include <time.h>
+#include <ucontext.h>
+
+#include "plat_cpu.h"
+#include <core/inc/thread.h>
+#include <core/inc/system.h>
+#include <core/inc/intrvect.h>
+
+extern __VOID __boardInitHW(__VOID);
+extern __VOLATILE pu32 __threadSp;
+extern __VOID __intArrival(__VOID);
+__VOID __cpuSysTickHandler(__VOID);
+
+/** @addtogroup Platform_Host
+  * @{
+  */
+
+#define HOST_TICK_US			1000				/*!< @brief System tick period, in microseconds */
+
+#ifndef MAP_32BIT
+#define MAP_32BIT				0					/*!< @brief 32 bits hosts map anywhere */
+#endif
+
+u8 __hostHeap[BOARD_HOST_HEAP_SIZE] __attribute__ ((aligned (8)));	/*!< @brief Heap area */
+
+__VOLATILE int __hostIrqOff = 1;					/*!< @brief Interrupts disabled (PRIMASK) */
+__VOLATILE u32* __hostMonitor = __NULL;				/*!< @brief Address marked by __cpuLoadExclusive() */
+__VOLATILE __BOOL __hostCyclesFake = __FALSE;		/*!< @brief __cpuGetCycles() returns __hostCycles */
+__VOLATILE u32 __hostCycles = 0;					/*!< @brief Cycle counter set by the tests */
+
+__STATIC __VOLATILE sig_atomic_t __hostTickPending = 0;	/*!< @brief System tick pending */
+__STATIC __VOLATILE sig_atomic_t __hostSwitchPending = 0;	/*!< @brief Context switch pending (PendSV) */
+__STATIC __VOLATILE sig_atomic_t __hostInIsr = 0;		/*!< @brief Serving an interrupt */
+__STATIC u32 __hostIrqSource = 0;					/*!< @brief Interrupt being served, see __cpuGetInterruptSource() */
+
+/*! @brief Thread context, at the base of the mapped stack area. */
+typedef struct {
+	ucontext_t		hc_context;						/*!< @brief Saved context, first */
+	__PVOID*		hc_func;						/*!< @brief Thread function */
+} HOST_THREAD;
+
+__STATIC ucontext_t __hostMainContext;				/*!< @brief Context of main(), until the first switch */
+__STATIC ucontext_t* __hostContext = &__hostMainContext;	/*!< @brief Running context */
+
+#if __CONFIG_TICKLESS_IDLE
+__STATIC u64 __hostTicklessStart;					/*!< @brief Time of __cpuTicklessEnter() */
+#endif /* __CONFIG_TICKLESS_IDLE */
+
+/** @defgroup PlatformFunctions Functions
+  * @{
+  */
+
+/*!
+ * @brief Programs the system tick timer.
+ *
+ * Internal platform function.
+ *
+ * @param	first	Microseconds to the first tick.
+ * @return Nothing.
+ */
+__STATIC __VOID __hostSetTimer(u32 first)
+{
+	struct itimerval tv;
+
+	tv.it_value.tv_sec = first / 1000000;
+	tv.it_value.tv_usec = first % 1000000;
+	tv.it_interval.tv_sec = 0;
+	tv.it_interval.tv_usec = HOST_TICK_US;
+
+	setitimer(ITIMER_REAL, &tv, __NULL);
+}
+
+/*!
+ * @brief Context switch, the equivalent of the PendSV handler.
+ *
+ * Internal platform function, called with interrupts disabled.
+ * When __threadChange() goes idle the running context goes on as idle loop.
+ *
+ * @return Nothing.
+ */
+__STATIC __VOID __hostSwitch(__VOID)
+{
+	ucontext_t* prev = __hostContext;
+
+	__threadChange();
+
+	if (!__threadSp) return;
+	__hostContext = (ucontext_t*) (uintptr_t) *__threadSp;
+
+	/* Back here when this context is switched in again */
+	if (__hostContext != prev) swapcontext(prev, __hostContext);
+}
+
+/*!
+ * @brief Interrupts of the simulated board: the system tick, then the UART
+ * and the I2C bus.
+ *
+ * Internal platform function. Interrupts are enabled while serving them,
+ * a tick arriving meanwhile is left pending.
+ *
+ * @return Nothing.
+ */
+__STATIC __VOID __hostIsr(__VOID)
+{
+	__hostMonitor = __NULL;
+	__hostInIsr = 1;
+	__hostIrqOff = 0;
+
+	__cpuSysTickHandler();
+
+	__hostIrqSource = BOARD_HOST_UART1_IRQ;
+	__intArrival();
+
+	__hostIrqSource = BOARD_HOST_I2C1_IRQ;
+	__intArrival();
+
+	__hostIrqOff = 1;
+	__hostInIsr = 0;
+	__hostMonitor = __NULL;
+}
+
+/*!
+ * @brief Enables interrupts.
+ *
+ * Serves the pending tick and then the pending context switch, as the NVIC
+ * does when PRIMASK is cleared. Within an interrupt only clears the flag.
+ *
+ * @return Nothing.
+ */
+__VOID __hostEnableInterrupts(__VOID)
+{
+	for (;;)
+	{
+		__hostIrqOff = 1;
+
+		if (!__hostInIsr)
+		{
+			if (__hostTickPending)
+			{
+				__hostTickPending = 0;
+				__hostIsr();
+				continue;
+			}
+
+			if (__hostSwitchPending)
+			{
+				__hostSwitchPending = 0;
+				__hostSwitch();
+				continue;
+			}
+		}
+
+		__hostIrqOff = 0;
+
+		/* A tick that arrived before clearing the flag is still pending */
+		if (__hostInIsr || !__hostTickPending) return;
+	}
+}
+
+/*!
+ * @brief SIGALRM handler, the system tick.
+ *
+ * With interrupts enabled the tick is served at once, and a context switch
+ * can take place from the handler: the switched out context returns from it
+ * when switched in again.
+ *
+ * @param	sig		Signal number.
+ * @return Nothing.
+ */
+__STATIC __VOID __hostSignal(int sig)
+{
+	__hostTickPending = 1;
+
+	if (__hostIrqOff || __hostInIsr) return;
+
+	__hostEnableInterrupts();
+}
+
+/*!
+ * @brief Loads a word and marks its address for exclusive access.
+ *
+ * The mark is dropped by every interrupt and context switch.
+ *
+ * @param	ptr		Word address.
+ * @return	The value read.
+ */
+u32 __hostLoadExclusive(__VOLATILE u32* ptr)
+{
+	__hostMonitor = ptr;
+	return *ptr;
+}
+
+/*!
+ * @brief Stores a word if the mark of __hostLoadExclusive() is still there.
+ *
+ * @param	val		Value to store.
+ * @param	ptr		Word address.
+ * @return	Zero if the value was stored, otherwise 1.
+ */
+u32 __hostStoreExclusive(u32 val, __VOLATILE u32* ptr)
+{
+	int off = __hostIrqOff;
+	u32 ret = 1;
+
+	__hostIrqOff = 1;
+
+	if (__hostMonitor == ptr)
+	{
+		*ptr = val;
+		ret = 0;
+	}
+
+	__hostMonitor = __NULL;
+
+	if (!off) __hostEnableInterrupts();
+	return ret;
+}
+
+/*!
+ * @brief Entry of every thread, the equivalent of the exception return that
+ * starts it on the target.
+ *
+ * Internal platform function. The thread is switched in with interrupts
+ * disabled, as the exception return does it enables them before running the
+ * thread function, so a thread that never calls the kernel is preempted.
+ *
+ * @return Nothing.
+ */
+__STATIC __VOID __hostThreadStart(__VOID)
+{
+	__VOID (*func)(__VOID) = (__VOID (*)(__VOID)) ((HOST_THREAD*) __hostContext)->hc_func;
+
+	__hostEnableInterrupts();
+	func();
+}
+
+/*!
+ * @brief Sleeps until the next tick, if none is pending.
+ *
+ * @return Nothing.
+ */
+__VOID __hostWaitForInterrupt(__VOID)
+{
+	sigset_t alrm, old, wait;
+
+	sigemptyset(&alrm);
+	sigaddset(&alrm, SIGALRM);
+	sigprocmask(SIG_BLOCK, &alrm, &old);
+
+	wait = old;
+	sigdelset(&wait, SIGALRM);
+	if (!__hostTickPending) sigsuspend(&wait);
+
+	sigprocmask(SIG_SETMASK, &old, __NULL);
+}
+
+/*!
+ * @brief Reads the monotonic clock of the host.
+ *
+ * @return Nanoseconds.
+ */
+u64 __hostGetNanoseconds(__VOID)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (u64) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/*!
+ * @brief Stops the simulation and ends the process.
+ *
+ * Can be called from any thread.
+ *
+ * @param	status	Exit status of the process.
+ * @return Never.
+ */
+__VOID __hostExit(i32 status)
+{
+	__systemStop();
+	__hostSetTimer(0);
+	fflush(stdout);
+	exit(status);
+}
+
+/*!
+ * @brief Prepares the context of a new thread.
+ *
+ * The thread runs on a stack mapped apart (BOARD_HOST_STACK_SIZE bytes), the
+ * stack allocated by __threadCreate() is not used. The context is stored at
+ * the base of the mapped area, and its address is the thread stack pointer.
+ * The mapped area is not released when the thread is destroyed.
+ * Returning from the thread function ends the process (it faults on the target).
+ * Called from __threadCreate().
+ *
+ * @param	stkptr	Stack pointer start address.
+ * @param	func	Pointer to thread execution function.
+ * @param	param	Optional parameter to retrieve with __threadGetParameter().
+ * @return	Address of the context.
+ */
+u32 __cpuMakeStackFrame(u32 stkptr, __PVOID *func, __PVOID param)
+{
+	HOST_THREAD* ctx;
+
+	ctx = mmap(__NULL, BOARD_HOST_STACK_SIZE, PROT_READ | PROT_WRITE,
+			MAP_PRIVATE | MAP_ANONYMOUS | MAP_32BIT, -1, 0);
+
+	if (ctx == MAP_FAILED || (uintptr_t) ctx > 0xFFFFFFFFUL)
+	{
+		fprintf(stderr, "host: cannot map a thread stack under 4 GB\n");
+		abort();
+	}
+
+	getcontext(&ctx->hc_context);
+	ctx->hc_context.uc_stack.ss_sp = ctx + 1;
+	ctx->hc_context.uc_stack.ss_size = BOARD_HOST_STACK_SIZE - sizeof(HOST_THREAD);
+	ctx->hc_context.uc_link = __NULL;
+	sigemptyset(&ctx->hc_context.uc_sigmask);
+	ctx->hc_func = func;
+	makecontext(&ctx->hc_context, __hostThreadStart, 0);
+
+	return (u32) (uintptr_t) ctx;
+}
+
+/*!
+ * @brief Initializes interrupts.
+ *
+ * Installs the SIGALRM handler. Called from __systemInit().
+ *
+ * @return Nothing.
+ */
+__VOID __cpuInitInterrupts(__VOID)
+{
+	struct sigaction sa = {{0}};
+
+	if ((uintptr_t) __hostHeap > 0xFFFFFFFFUL)
+	{
+		fprintf(stderr, "host: link with -no-pie, the heap must be under 4 GB\n");
+		abort();
+	}
+
+	sa.sa_handler = __hostSignal;
+	sigemptyset(&sa.sa_mask);
+	sa.sa_flags = SA_RESTART;
+	sigaction(SIGALRM, &sa, __NULL);
+}
+
+#if __CONFIG_TICKLESS_IDLE
+/*!
+ * @brief Maximum ticks the system tick timer can be stretched to.
+ *
+ * @return The maximum ticks for __cpuTicklessEnter().
+ */
+u32 __cpuTicklessMaxTicks(__VOID)
+{
+	return 1000;
+}
+
+/*!
+ * @brief Stretches the system tick period.
+ *
+ * Called from __systemIdle() with interrupts disabled.
+ *
+ * @param ticks	Ticks to sleep, from 2 to __cpuTicklessMaxTicks().
+ * @return Nothing.
+ */
+__VOID __cpuTicklessEnter(u32 ticks)
+{
+	__hostTicklessStart = __hostGetNanoseconds();
+	__hostSetTimer(ticks * HOST_TICK_US);
+}
+
+/*!
+ * @brief Restores the system tick period after __cpuTicklessEnter().
+ *
+ * Called from __systemIdle() with interrupts disabled.
+ *
+ * @return The whole ticks elapsed that the system tick interrupt will not account.
+ */
+u32 __cpuTicklessLeave(__VOID)
+{
+	u32 ticks;
+
+	ticks = (__hostGetNanoseconds() - __hostTicklessStart) / (HOST_TICK_US * 1000);
+	__hostSetTimer(HOST_TICK_US);
+
+	/* The pending tick accounts for one */
+	if (__hostTickPending && ticks) ticks--;
+
+	return ticks;
+}
+#endif /* __CONFIG_TICKLESS_IDLE */
+
+/*!
+ * @brief Initializes platform optional timers.
+ *
+ * @return Nothing.
+ */
+__VOID __cpuInitTimers(__VOID)
+{
+}
+
+/*!
+ * @brief System tick interrupt handler.
+ *
+ * As required in @ref platisrimpl, this function call
+ * the __systemProcessTick() function.
+ *
+ * @return Nothing.
+ */
+__VOID __cpuSysTickHandler(__VOID)
+{
+	__systemEnterISR();
+	__systemProcessTick();
+	__systemLeaveISR();
+}
+
+/*!
+ * @brief Returns the simulated interrupt being served.
+ *
+ * @param	irq		Interrupt number.
+ * @return	__TRUE.
+ */
+__BOOL __cpuGetInterruptSource(u32* irq)
+{
+	*irq = __hostIrqSource;
+	return __TRUE;
+}
+
+/*!
+ * @brief Extra configuration before entering first context switch.
+ *
+ * The first switch saves the main() context, never switched in again.
+ *
+ * @return Nothing.
+ */
+__VOID __cpuCustomCreateSystemThread(__VOID)
+{
+}
+
+/*!
+ * @brief Forces a context switch.
+ *
+ * Used on __threadSleep(), __threadYield() and __eventWait().
+ * The switch takes place as soon as interrupts are enabled and no interrupt
+ * is being served.
+ *
+ * @return Nothing.
+ */
+__VOID	__cpuScheduleThreadChange(__VOID)
+{
+	__hostSwitchPending = 1;
+	if (!__hostIrqOff && !__hostInIsr) __hostEnableInterrupts();
+}
+
+/*!
+ * @brief Disables a forced context switch.
+ *
+ * @return Nothing.
+ */
+__VOID	__cpuClearPendingThreadChange(__VOID)
+{
+	__hostSwitchPending = 0;
+}
+
+/*!
+ * @brief Checks for a previously pended call to the scheduler.
+ *
+ * @return __TRUE if a context switch is pending.
+ */
+__BOOL	__cpuThreadChangeScheduled(__VOID)
+{
+	return __hostSwitchPending ? __TRUE : __FALSE;
+}
+
+/*!
+ * @brief Starts the watchdog, if available.
+ *
+ * @return Nothing.
+ */
+__VOID	__cpuStartWatchdog(__VOID)
+{
+}
+
+/*!
+ * @brief Resets the watchdog, if available.
+ *
+ * @return Nothing.
+ */
+__VOID	__cpuResetWatchdog(__VOID)
+{
+}
+
+/*!
+ * @brief Initializes the platform hardware.
+ *
+ * Called from __systemInit().
+ *
+ * @return Nothing.
+ */
+__VOID	__cpuInitHardware(__VOID)
+{
+	/* Stdout is also written by the serial devices, keep the order */
+	setvbuf(stdout, __NULL, _IONBF, 0);
+
+	/* Call board-specific initialization */
+	__boardInitHW();
+}
+
+/*!
+ * @brief Initializes the main timer for context-switching.
+ *
+ * Starts the 1 ms SIGALRM timer. Called from __systemInit().
+ *
+ * @return Nothing.
+ */
+__VOID 	__cpuInitSchedulerTimer(__VOID)
+{
+	__hostSetTimer(HOST_TICK_US);
+}
+
+/*!
+ * @brief Aligns the stack pointer address, if required.
+ *
+ * Called from __threadCreate().
+ *
+ * @return The aligned top of the stack.
+ */
+u32 __cpuStackFramePointer(pu8 stkptr, u32 stack)
+{
+	return ((u32) (uintptr_t) (stkptr + stack)) & 0xFFFFFFF8;
+}
+
+/*!
+ * @brief Starts memory manager, if any.
+ *
+ * @return Nothing.
+ */
+__VOID	__cpuStartMMU(__VOID)
+{
+}
+
+/*!
+ * @brief Heartbeat, called each 100ms from the __systemThread().
+ *
+ * @return Nothing.
+ */
+__VOID	__cpuHeartBeat(__VOID)
+{
+}
+
+/*!
+ * @brief Starts the cycle counter. The host clock always runs.
+ *
+ * @return Nothing.
+ */
+__VOID __cpuInitCycleCounter(__VOID)
+{
+}
+
+/*!
+ * @brief Busy waits.
+ *
+ * @param	ms		Milliseconds.
+ * @return Nothing.
+ */
+__VOID __cpuDelayMs(u32 ms)
+{
+	u64 end = __hostGetNanoseconds() + (u64) ms * 1000000;
+
+	while (__hostGetNanoseconds() < end);
+}
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
@@ -0,0 +1,226 @@
+/***************************************************************************
+ * plat_i2c.c
+ * (C) 2010 Ivan Meleca
+ * Based on original code written by Ruben Meleca
+ * www.milos.it
+
+#   This program is free software; you can redistribute it and/or modify
+#   it under the terms of the GNU General Public License as published by
+#   the Free Software Foundation; either version 2 of the License, or
+#   (at your option) any later version.
+#
+#   This program is distributed in the hope that it will be useful,
+#   but WITHOUT ANY WARRANTY; without even the implied warranty of
+#   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#   GNU General Public License for more details.
+#
+#   You should have received a copy of the GNU General Public License
+#   along with this program; if not, write to the Free Software
+#   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+***************************************************************************/
+
+#include "plat_i2c.h"
+#include <drivers/inc/i2c.h>
+#include <core/inc/intrvect.h>
+
+#if __CONFIG_COMPILE_I2C
+
+/*
+ * Job phase codes (pd_jobstate), as the target.
+ */
+#define I2C_JOBSTATE_IDLE			0	/* No job running */
+#define I2C_JOBSTATE_WRITE			1	/* Writing jb_tx */
+#define I2C_JOBSTATE_READ			2	/* Reading into jb_rx */
+
+/*
+ * Ends the running job with a STOP, the next one starts from __i2cJobDone().
+ */
+__STATIC __VOID __i2cJobEnd(__PDEVICE dv, i32 status)
+{
+	PI2C_PARAMS params = dv->dv_params;
+
+	((__PI2C_PDB) dv->dv_pdb)->pd_jobstate = I2C_JOBSTATE_IDLE;
+	params->addressed = 0;
+
+	__i2cJobDone(dv, status);
+}
+
+/*
+ * Moves one byte on the bus: the address after a START, or a data byte.
+ */
+__STATIC __VOID __i2cBusByte(__PDEVICE dv, __PI2C_JOB jb)
+{
+	PI2C_PARAMS params = dv->dv_params;
+	__PI2C_PDB pd = dv->dv_pdb;
+	u16 len;
+
+	params->bytes++;
+
+	if (!params->addressed)
+	{
+		/* START, then ADDR, or the missing ACK error */
+		params->irqs += 2;
+
+		if (jb->jb_addr != params->slave)
+		{
+			__i2cJobEnd(dv, __DEV_ERROR);
+			return;
+		}
+
+		params->addressed = 1;
+		params->first = 1;
+
+		/* Address only, the slave acknowledged */
+		if (pd->pd_jobstate == I2C_JOBSTATE_WRITE && !jb->jb_txlen) __i2cJobEnd(dv, __DEV_OK);
+		return;
+	}
+
+	if (pd->pd_jobstate == I2C_JOBSTATE_WRITE)
+	{
+		len = jb->jb_txlen;
+
+		if (params->first)
+		{
+			params->reg = jb->jb_tx[pd->pd_jobidx++];
+			params->first = 0;
+		} else
+		{
+			params->regs[params->reg++] = jb->jb_tx[pd->pd_jobidx++];
+		}
+
+		/* TXE, by DMA for the longer phases */
+		if (!params->dma || len == 1) params->irqs++;
+		if (pd->pd_jobidx < len) return;
+
+		/* BTF, every byte is out */
+		params->irqs++;
+
+		if (jb->jb_rxlen)
+		{
+			/* Repeated START for the read phase */
+			pd->pd_jobidx = 0;
+			pd->pd_jobstate = I2C_JOBSTATE_READ;
+			params->addressed = 0;
+		} else
+		{
+			__i2cJobEnd(dv, __DEV_OK);
+		}
+	} else
+	{
+		len = jb->jb_rxlen;
+
+		jb->jb_rx[pd->pd_jobidx++] = params->regs[params->reg++];
+
+		/* RXNE, or the DMA transfer complete after the last byte */
+		if (!params->dma || len == 1) params->irqs++;
+		else if (pd->pd_jobidx == len) params->irqs++;
+
+		if (pd->pd_jobidx == len) __i2cJobEnd(dv, __DEV_OK);
+	}
+}
+
+/*
+ * Simulated I2C interrupt, after each system tick: moves on the bus the
+ * bytes of one tick, running the queued jobs.
+ */
+__VOID __i2cHostIsr(__PVOID pVoid)
+{
+	__PDEVICE dv = (__PDEVICE) pVoid;
+	__PI2C_PDB pd = dv->dv_pdb;
+	PI2C_PARAMS params = dv->dv_params;
+	u32 budget;
+	u64 t;
+
+	if (pd->pd_jobstate == I2C_JOBSTATE_IDLE || params->stretch) return;
+
+	t = __hostGetNanoseconds();
+	__systemEnterISR();
+
+	/* Bytes of one tick, 9 bit times each */
+	budget = params->speed / 9 / 1000;
+	if (!budget) budget = 1;
+
+	while (budget-- && pd->pd_jobhead && pd->pd_jobstate != I2C_JOBSTATE_IDLE)
+	{
+		__i2cBusByte(dv, pd->pd_jobhead);
+	}
+
+	__systemLeaveISR();
+	params->isr_ns += __hostGetNanoseconds() - t;
+}
+
+/*
+ * @brief I2C for the host IO control function
+ *
+ * Called from @ref I2C driver to perform platform-related tasks.
+ *
+ * @param	dv		Pointer to device.
+ * @param	code	IO control code.
+ *
+ * @arg	__I2C_PLAT_INIT_HW			Initialize hardware.
+ * @arg	__I2C_PLAT_SET_SPEED		Set the bus speed.
+ * @arg	__I2C_PLAT_JOB_START		Start the job in \c in.
+ * @arg	__I2C_PLAT_SET_IRQ			Configure interrupts.
+ * @arg	__I2C_PLAT_ABORT			Abort the running job.
+ *
+ * @param	param	Optional parameter.
+ * @param	in		Input buffer pointer.
+ * @param	in_len	Input buffer pointer length.
+ * @param	out		Output buffer pointer.
+ * @param	out_len Output buffer pointer length.
+ *
+ * @return 	A value depending on the requested code execution.
+ *
+ */
+i32 __i2cPlatIoCtl(__PDEVICE dv, u32 code, u32 param, __PVOID in, u32 in_len, __PVOID out, u32 out_len)
+{
+	PI2C_PARAMS params = dv->dv_params;
+	__PI2C_PDB pd = dv->dv_pdb;
+	__PI2C_JOB jb;
+
+	switch (code)
+	{
+		case __I2C_PLAT_INIT_HW:
+			pd->pd_jobstate = I2C_JOBSTATE_IDLE;
+			pd->pd_speed = params->speed;
+			params->addressed = 0;
+			params->bytes = params->irqs = 0;
+			params->isr_ns = 0;
+			return __DEV_OK;
+
+		case __I2C_PLAT_SET_SPEED:
+			params->speed = pd->pd_speed = param;
+			return __DEV_OK;
+
+		case __I2C_PLAT_JOB_START:
+			jb = (__PI2C_JOB) in;
+			pd->pd_jobidx = 0;
+			pd->pd_jobstate = (jb->jb_txlen || !jb->jb_rxlen) ? I2C_JOBSTATE_WRITE : I2C_JOBSTATE_READ;
+			params->addressed = 0;
+			return __DEV_OK;
+
+		case __I2C_PLAT_SET_IRQ:
+			__intSetVector(dv->dv_txint, __i2cHostIsr, dv);
+			return __DEV_OK;
+
+		case __I2C_PLAT_RESET_IRQ:
+			__intSetVector(dv->dv_txint, __NULL, __NULL);
+			return __DEV_OK;
+
+		case __I2C_PLAT_ABORT:
+			pd->pd_jobstate = I2C_JOBSTATE_IDLE;
+			params->addressed = 0;
+			return __DEV_OK;
+
+		case __I2C_PLAT_DEINIT_HW:
+		case __I2C_PLAT_ENABLE_DEVICE:
+		case __I2C_PLAT_DISABLE_DEVICE:
+		case __I2C_PLAT_SET_OWN_ADDRESS:
+			return __DEV_OK;
+	}
+
+	return __DEV_UNK_IOCTL;
+}
+
+#endif /* __CONFIG_COMPILE_I2C */
@@ -0,0 +1,203 @@
+/***************************************************************************
+ * plat_spi.c
+ * (C) 2010 Ivan Meleca
+ * Based on original code written by Ruben Meleca
+ * www.milos.it
+
+#   This program is free software; you can redistribute it and/or modify
+#   it under the terms of the GNU General Public License as published by
+#   the Free Software Foundation; either version 2 of the License, or
+#   (at your option) any later version.
+#
+#   This program is distributed in the hope that it will be useful,
+#   but WITHOUT ANY WARRANTY; without even the implied warranty of
+#   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#   GNU General Public License for more details.
+#
+#   You should have received a copy of the GNU General Public License
+#   along with this program; if not, write to the Free Software
+#   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+***************************************************************************/
+
+#include "plat_spi.h"
+#include <drivers/inc/spi.h>
+
+#if __CONFIG_COMPILE_SPI
+
+/*
+ * Sends all the unsent bytes of the TX buffer, each one received back into
+ * the RX buffer, then sets the RX and TX events.
+ */
+__STATIC u8 __spiInitTx(__PDEVICE dv, __BOOL cs)
+{
+	__PSPI_PDB pd = dv->dv_pdb;
+	PSPI_PARAMS params = dv->dv_params;
+	u8 c;
+
+	__systemStop();
+	__systemEnterISR();
+
+	if (cs)
+	{
+		params->cs = __FALSE;
+		params->selects++;
+	}
+
+	while (pd->pd_txcnt)
+	{
+		c = *(pd->pd_txbuf + pd->pd_tcidx);
+		if (++pd->pd_tcidx >= pd->pd_txlen) pd->pd_tcidx = 0;
+		--pd->pd_txcnt;
+
+		*(pd->pd_rxbuf + pd->pd_rcidx) = c;
+		if (++pd->pd_rcidx >= pd->pd_rxlen) pd->pd_rcidx = 0;
+		if (++pd->pd_rxcnt > pd->pd_rxlen) pd->pd_rxerr |= __SPIERR_OVERFLOW;
+	}
+
+	if (cs) params->cs = __TRUE;
+
+	if (dv->dv_rxev) __eventSet(dv->dv_rxev);
+	if (dv->dv_txev) __eventSet(dv->dv_txev);
+
+	__systemLeaveISR();
+	__systemStart();
+
+	return __DEV_OK;
+}
+
+/*
+ * Simulated DMA transfer complete interrupt. Raised again while being served,
+ * by the next descriptor started from __spiXferDone(), it is served again
+ * before returning.
+ */
+__STATIC __VOID __spiDmaIsr(__PDEVICE dv)
+{
+	PSPI_PARAMS params = dv->dv_params;
+
+	params->pending = 1;
+	if (params->in_isr) return;
+
+	params->in_isr = 1;
+	__systemEnterISR();
+
+	while (params->pending)
+	{
+		params->pending = 0;
+		params->irqs++;
+		__spiXferDone(dv, params->error ? __DEV_ERROR : __DEV_OK);
+	}
+
+	__systemLeaveISR();
+	params->in_isr = 0;
+}
+
+/*
+ * Transfers a descriptor at once, then raises the DMA interrupt. Called with
+ * interrupts disabled.
+ */
+__STATIC i32 __spiXferStart(__PDEVICE dv, __PSPI_XFER xf)
+{
+	PSPI_PARAMS params = dv->dv_params;
+	u32 i;
+	u8 c;
+
+	if ((xf->xf_flags & __SPI_XF_START) && !(xf->xf_flags & __SPI_XF_NOCS))
+	{
+		params->cs = __FALSE;
+		params->selects++;
+	}
+
+	/* Byte by byte, \c xf_tx and \c xf_rx can be the same buffer */
+	for (i = 0; i < xf->xf_len; i++)
+	{
+		c = xf->xf_tx ? xf->xf_tx[i] : 0xFF;
+		if (xf->xf_rx) xf->xf_rx[i] = c;
+	}
+
+	params->xfers++;
+	__spiDmaIsr(dv);
+
+	return __DEV_OK;
+}
+
+/*!
+ * @brief SPI for the host IO control function
+ *
+ * Called from @ref SPI driver to perform platform-related
+ * tasks. The bus speed has no meaning on the host and is accepted.
+ *
+ * @param	dv		Pointer to device.
+ * @param	code	IO control code.
+ *
+ * @arg	__SPI_PLAT_INIT_HW			Initialize hardware.
+ * @arg	__SPI_PLAT_CHAR_OUTPUT		Character output.
+ * @arg	__SPI_PLAT_CHAR_INPUT		Character input.
+ * @arg __SPI_PLAT_INIT_TX			Start transmission. If \c param = 1, CS is asserted.
+ * @arg __SPI_PLAT_XFER_START		Transfer the descriptor in \c in.
+ * @arg __SPI_PLAT_XFER_END			End a transaction, release the chip-select.
+ *
+ * @param	param	Optional parameter.
+ * @param	in		Input buffer pointer.
+ * @param	in_len	Input buffer pointer length.
+ * @param	out		Output buffer pointer.
+ * @param	out_len Output buffer pointer length.
+ *
+ * @return 	A value depending on the requested code execution.
+ *
+ */
+i32 __spiPlatIoCtl(__PDEVICE dv, u32 code, u32 param, __PVOID in, u32 in_len, __PVOID out, u32 out_len)
+{
+	PSPI_PARAMS params = dv->dv_params;
+	__PSPI_PDB pd = dv->dv_pdb;
+	__STATIC u8 data;
+
+	switch (code)
+	{
+		case __SPI_PLAT_INIT_HW:
+			pd->pd_dma = (pd->pd_mode == __SPIMODE_MASTER) ? params->dma : 0;
+			params->cs = __TRUE;
+			params->in_isr = params->pending = 0;
+			params->selects = params->xfers = params->irqs = 0;
+			return __DEV_OK;
+
+		case __SPI_PLAT_CHAR_OUTPUT:
+			/* Received back */
+			data = (u8) param;
+			return __DEV_OK;
+
+		case __SPI_PLAT_CHAR_INPUT:
+			return data;
+
+		case __SPI_PLAT_INIT_TX:
+			return __spiInitTx(dv, param && (pd->pd_mode == __SPIMODE_MASTER));
+
+		case __SPI_PLAT_SET_CS:
+			if (!param && params->cs) params->selects++;
+			params->cs = (u8) param;
+			return __DEV_OK;
+
+		case __SPI_PLAT_XFER_START:
+			return __spiXferStart(dv, (__PSPI_XFER) in);
+
+		case __SPI_PLAT_XFER_END:
+			params->cs = __TRUE;
+			return __DEV_OK;
+
+		case __SPI_PLAT_INIT_DEFAULTS:
+			pd->pd_rxlen = __PLATSPI_RXBUFLEN;
+			pd->pd_txlen = __PLATSPI_TXBUFLEN;
+			return __DEV_OK;
+
+		case __SPI_PLAT_DEINIT_HW:
+		case __SPI_PLAT_SET_SPEED:
+		case __SPI_PLAT_END_TX:
+		case __SPI_PLAT_SET_IRQ:
+		case __SPI_PLAT_RESET_IRQ:
+			return __DEV_OK;
+	}
+
+	return __DEV_UNK_IOCTL;
+}
+
+#endif /* __CONFIG_COMPILE_SPI */
@@ -0,0 +1,274 @@
+/***************************************************************************
+ * plat_uart.c
+ * (C) 2010 Ivan Meleca
+ * Based on original code written by Ruben Meleca
+ * www.milos.it
+
+#   This program is free software; you can redistribute it and/or modify
+#   it under the terms of the GNU General Public License as published by
+#   the Free Software Foundation; either version 2 of the License, or
+#   (at your option) any later version.
+#
+#   This program is distributed in the hope that it will be useful,
+#   but WITHOUT ANY WARRANTY; without even the implied warranty of
+#   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#   GNU General Public License for more details.
+#
+#   You should have received a copy of the GNU General Public License
+#   along with this program; if not, write to the Free Software
+#   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+***************************************************************************/
+
+#include <poll.h>
+#include <unistd.h>
+
+#include "plat_uart.h"
+#include <drivers/inc/serial.h>
+#include <core/inc/intrvect.h>
+
+#if __CONFIG_COMPILE_SERIAL
+
+/*
+ * Writes all the unsent bytes of the TX buffer, then sets the TX event.
+ */
+__STATIC u8 __uartInitTx(__PDEVICE dv)
+{
+	__PSERIAL_PDB pd = dv->dv_pdb;
+	PUART_PARAMS params = dv->dv_params;
+	u16 len;
+
+	__systemStop();
+
+	while (pd->pd_txcnt)
+	{
+		len = pd->pd_txlen - pd->pd_tcidx;
+		if (len > pd->pd_txcnt) len = pd->pd_txcnt;
+
+		/* Dropped if there is no output */
+		if (params->tx_fd >= 0 && write(params->tx_fd, pd->pd_txbuf + pd->pd_tcidx, len) <= 0) break;
+
+		if ((pd->pd_tcidx += len) >= pd->pd_txlen) pd->pd_tcidx = 0;
+		pd->pd_txcnt -= len;
+	}
+
+	__eventSet(dv->dv_txev);
+	__systemStart();
+
+	return pd->pd_txcnt ? __DEV_WRITE_ERROR : __DEV_OK;
+}
+
+/*
+ * Simulated UART interrupt, after each system tick: reads the bytes available.
+ */
+__VOID __uartISR(__PVOID pVoid)
+{
+	__PDEVICE dv = (__PDEVICE) pVoid;
+	__PSERIAL_PDB pd = dv->dv_pdb;
+	PUART_PARAMS params = dv->dv_params;
+	struct pollfd pfd;
+	ssize_t got;
+	u16 len;
+
+	if (params->rx_fd < 0) return;
+
+	pfd.fd = params->rx_fd;
+	pfd.events = POLLIN;
+	if (poll(&pfd, 1, 0) <= 0 || !(pfd.revents & POLLIN)) return;
+
+	__systemEnterISR();
+
+	/* Up to the buffer wrap, the rest on the next tick */
+	len = pd->pd_rxlen - pd->pd_rcidx;
+	if ((got = read(params->rx_fd, pd->pd_rxbuf + pd->pd_rcidx, len)) > 0)
+	{
+		if ((pd->pd_rcidx += got) >= pd->pd_rxlen) pd->pd_rcidx = 0;
+		pd->pd_rxcnt += got;
+
+		if (pd->pd_rxcnt > pd->pd_rxlen)
+		{
+			/* Unread bytes overwritten, keep the newest ones */
+			pd->pd_rxerr |= __SERIALERR_OVERFLOW;
+			pd->pd_rbidx = pd->pd_rcidx;
+			pd->pd_rxcnt = pd->pd_rxlen;
+		}
+
+		__eventSet(dv->dv_rxev);
+	}
+
+	__systemLeaveISR();
+}
+
+/*
+ * Accounts the bytes written by the simulated RX DMA since the last call, as
+ * the target driver does. Called from interrupts only.
+ */
+__STATIC __VOID __uartDmaRxUpdate(__PDEVICE dv)
+{
+	__PSERIAL_PDB pd = dv->dv_pdb;
+	u32 idx, cnt;
+
+	/* DMA write position */
+	idx = pd->pd_rxlen - ((UART_PARAMS*) dv->dv_params)->rx_ndtr;
+	if (idx >= pd->pd_rxlen) idx = 0;
+
+	if (idx == pd->pd_rcidx) return;
+
+	cnt = (idx > pd->pd_rcidx) ? idx - pd->pd_rcidx : pd->pd_rxlen - pd->pd_rcidx + idx;
+	pd->pd_rcidx = idx;
+
+	cnt += pd->pd_rxcnt;
+	if (cnt > pd->pd_rxlen)
+	{
+		/* Unread bytes overwritten, keep the newest ones */
+		pd->pd_rxerr |= __SERIALERR_OVERFLOW;
+		pd->pd_rbidx = idx;
+		cnt = pd->pd_rxlen;
+	}
+
+	pd->pd_rxcnt = cnt;
+	__eventSet(dv->dv_rxev);
+}
+
+/*
+ * Simulated DMA half or full buffer, or IDLE line interrupt.
+ */
+__STATIC __VOID __uartDmaISR(__PDEVICE dv)
+{
+	__systemEnterISR();
+
+	((UART_PARAMS*) dv->dv_params)->rx_irqs++;
+	__uartDmaRxUpdate(dv);
+
+	__systemLeaveISR();
+}
+
+/*
+ * Simulated RXNE interrupt, one byte received.
+ */
+__STATIC __VOID __uartRxneISR(__PDEVICE dv, u8 c)
+{
+	__PSERIAL_PDB pd = dv->dv_pdb;
+
+	__systemEnterISR();
+
+	((UART_PARAMS*) dv->dv_params)->rx_irqs++;
+
+	*(pd->pd_rxbuf + pd->pd_rcidx) = c;
+	if (++pd->pd_rcidx >= pd->pd_rxlen) pd->pd_rcidx = 0;
+	if (++pd->pd_rxcnt > pd->pd_rxlen) pd->pd_rxerr |= __SERIALERR_OVERFLOW;
+	__eventSet(dv->dv_rxev);
+
+	__systemLeaveISR();
+}
+
+/*
+ * Simulates a frame received on the RX line, then the line going idle.
+ *
+ * Without \c rx_dma each byte raises an RXNE interrupt. With \c rx_dma the
+ * bytes are stored in the RX buffer by a circular DMA stream, raising the
+ * half and full buffer interrupts, and the IDLE line interrupt ends the
+ * frame. Call with interrupts disabled, as the interrupts arrive.
+ */
+__VOID __uartLineReceive(__PDEVICE dv, __CONST u8* data, u32 len)
+{
+	__PSERIAL_PDB pd = dv->dv_pdb;
+	PUART_PARAMS params = dv->dv_params;
+	u32 i;
+
+	if (!params->rx_dma)
+	{
+		for (i = 0; i < len; i++) __uartRxneISR(dv, data[i]);
+		return;
+	}
+
+	for (i = 0; i < len; i++)
+	{
+		pd->pd_rxbuf[pd->pd_rxlen - params->rx_ndtr] = data[i];
+
+		/* Reloaded at the end of the buffer */
+		if (!--params->rx_ndtr)
+		{
+			__uartDmaISR(dv);
+			params->rx_ndtr = pd->pd_rxlen;
+		} else if (params->rx_ndtr == pd->pd_rxlen / 2)
+		{
+			__uartDmaISR(dv);
+		}
+	}
+
+	if (len) __uartDmaISR(dv);
+}
+
+/*
+ * @brief UART for the host IO control function
+ *
+ * Called from @ref Serial driver to perform platform-related
+ * tasks. Line settings have no meaning on the host and are accepted.
+ *
+ * @param	dv		Pointer to device.
+ * @param	code	IO control code.
+ *
+ * @arg	__SERIAL_PLAT_INIT_HW			Initialize hardware.
+ * @arg	__SERIAL_PLAT_CHAR_OUTPUT		Character output.
+ * @arg	__SERIAL_PLAT_CHAR_INPUT		Character input.
+ * @arg __SERIAL_PLAT_INIT_TX			Start transmission.
+ * @arg __SERIAL_PLAT_SET_IRQ			Configure interrupts.
+ *
+ * @param	param	Optional parameter.
+ * @param	in		Input buffer pointer.
+ * @param	in_len	Input buffer pointer length.
+ * @param	out		Output buffer pointer.
+ * @param	out_len Output buffer pointer length.
+ *
+ * @return 	A value depending on the requested code execution.
+ *
+ */
+i32 __serialPlatIoCtl(__PDEVICE dv, u32 code, u32 param, __PVOID in, u32 in_len, __PVOID out, u32 out_len)
+{
+	PUART_PARAMS params = dv->dv_params;
+	u8 c;
+
+	switch (code)
+	{
+		case __SERIAL_PLAT_INIT_HW:
+			/* The simulated DMA starts at the RX buffer */
+			params->rx_ndtr = ((__PSERIAL_PDB) dv->dv_pdb)->pd_rxlen;
+			params->rx_irqs = 0;
+			return __DEV_OK;
+
+		case __SERIAL_PLAT_DEINIT_HW:
+			return __DEV_OK;
+
+		case __SERIAL_PLAT_CHAR_OUTPUT:
+			c = (u8) param;
+			if (params->tx_fd >= 0 && write(params->tx_fd, &c, 1) != 1) return __DEV_WRITE_ERROR;
+			return __DEV_OK;
+
+		case __SERIAL_PLAT_CHAR_INPUT:
+			if (params->rx_fd < 0 || read(params->rx_fd, out, 1) != 1) return __DEV_READ_ERROR;
+			return __DEV_OK;
+
+		case __SERIAL_PLAT_INIT_TX:
+			return __uartInitTx(dv);
+
+		case __SERIAL_PLAT_SET_IRQ:
+			__intSetVector(dv->dv_txint, __uartISR, dv);
+			return __DEV_OK;
+
+		case __SERIAL_PLAT_RESET_IRQ:
+			__intSetVector(dv->dv_txint, __NULL, __NULL);
+			return __DEV_OK;
+
+		case __SERIAL_PLAT_SET_PARITY:
+		case __SERIAL_PLAT_SET_STOP_BITS:
+		case __SERIAL_PLAT_SET_FLOW_CONTROL:
+		case __SERIAL_PLAT_SET_LENGTH:
+		case __SERIAL_PLAT_SET_BAUDRATE:
+			return __DEV_OK;
+	}
+
+	return __DEV_UNK_IOCTL;
+}
+
+#endif // __CONFIG_COMPILE_SERIAL
@@ -0,0 +1,115 @@
+/***************************************************************************
+ * test.c
+ * (C) 2010 Ivan Meleca
+ * Based on original code written by Ruben Meleca
+ * www.milos.it
+
+#   This program is free software; you can redistribute it and/or modify
+#   it under the terms of the GNU General Public License as published by
+#   the Free Software Foundation; either version 2 of the License, or
+#   (at your option) any later version.
+#
+#   This program is distributed in the hope that it will be useful,
+#   but WITHOUT ANY WARRANTY; without even the implied warranty of
+#   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#   GNU General Public License for more details.
+#
+#   You should have received a copy of the GNU General Public License
+#   along with this program; if not, write to the Free Software
+#   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+***************************************************************************/
+
+#include <stdio.h>
+
+#include <plat_cpu.h>
+#include <core/inc/system.h>
+#include <core/inc/thread.h>
+#include <test.h>
+
+/*
+ * Runs the host unit tests in a thread, one suite after the other, and
+ * prints the checks and the failures of each suite. The process exits with
+ * status 1 if any check failed.
+ */
+
+#define TEST_PRIO				10			/* Test thread priority */
+#define TEST_STACK				512
+#define TEST_MAX_REPORTS		20			/* Failures printed per suite, the others are only counted */
+
+typedef struct {
+	__CONST char*	name;
+	__VOID			(*run)(__VOID);
+} TEST_SUITE;
+
+__STATIC TEST_SUITE testSuites[] = {
+	{ "mem",		testMem },
+	{ "log",		testLog },
+	{ "stack",		testStack },
+	{ "device",		testDevice },
+	{ "terminal",	testTerminal },
+	{ "pool",		testPool },
+	{ "lock",		testLock },
+	{ "spi",		testSpi },
+	{ "i2c",		testI2c },
+	{ "pendsv",		testPendSv },
+	{ "profile",	testProfile },
+	{ "work",		testWork },
+};
+
+__STATIC u32 testChecks;
+__STATIC u32 testFailed;
+
+/*
+ * Counts a check. Stdio is not interrupt safe, so interrupts are disabled.
+ */
+__BOOL testCheck(__BOOL ok, __CONST char* expr, __CONST char* file, u32 line)
+{
+	testChecks++;
+	if (ok) return __TRUE;
+
+	if (++testFailed <= TEST_MAX_REPORTS)
+	{
+		__systemStop();
+		printf("%s:%u: check failed: %s\n", file, line, expr);
+		__systemStart();
+	}
+
+	return __FALSE;
+}
+
+/*
+ * Runs every suite, then ends the process.
+ */
+__STATIC __VOID testThread(__VOID)
+{
+	u32 i, failed = 0;
+
+	for (i = 0; i < sizeof(testSuites) / sizeof(TEST_SUITE); i++)
+	{
+		testChecks = testFailed = 0;
+		testSuites[i].run();
+
+		__systemStop();
+		printf("%-12s %8u checks %6u failed\n", testSuites[i].name, testChecks, testFailed);
+		__systemStart();
+
+		failed += testFailed;
+	}
+
+	__hostExit(failed ? 1 : 0);
+}
+
+/*
+ * Application entry point, called from the system thread.
+ */
+__STATIC __VOID testEntry(__VOID)
+{
+	__threadCreate("test", testThread, TEST_PRIO, TEST_STACK, 1, __NULL);
+}
+
+int main(void)
+{
+	__systemInit(testEntry);
+	return 0;
+}
@@ -0,0 +1,230 @@
+/***************************************************************************
+ * test_device.c
+ * (C) 2010 Ivan Meleca
+ * Based on original code written by Ruben Meleca
+ * www.milos.it
+
+
+#   This program is free software; you can redistribute it and/or modify
+#   it under the terms of the GNU General Public License as published by
+#   the Free Software Foundation; either version 2 of the License, or
+#   (at your option) any later version.
+#
+#   This program is distributed in the hope that it will be useful,
+#   but WITHOUT ANY WARRANTY; without even the implied warranty of
+#   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#   GNU General Public License for more details.
+#
+#   You should have received a copy of the GNU General Public License
+#   along with this program; if not, write to the Free Software
+#   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+***************************************************************************/
+
+#include <plat_cpu.h>
+#include <core/inc/device.h>
+#include <common/inc/mem.h>
+#include <test.h>
+
+/*
+ * Buffered line reader (__deviceLineRead()) against a reference model that
+ * takes the stream one byte at a time. Random streams of letters, CR and LF
+ * are read in each end of line mode, with random line buffer and read ahead
+ * sizes, through a device returning random amounts of bytes per read.
+ */
+
+#define TEST_DEV_STREAMS		400			/* Streams per end of line mode */
+#define TEST_DEV_STREAM_MAX		600			/* Longest stream */
+#define TEST_DEV_LINES_MAX		(TEST_DEV_STREAM_MAX + 1)
+#define TEST_DEV_CR				0x0D
+#define TEST_DEV_LF				0x0A
+
+__STATIC u8 testDevStream[TEST_DEV_STREAM_MAX];
+__STATIC u32 testDevLen;
+__STATIC u32 testDevPos;
+__STATIC u32 testDevSeed = 1;
+
+/* Lines expected, each \c testDevLineLen[] bytes at \c testDevLineOff[] of \c testDevLines */
+__STATIC char testDevLines[TEST_DEV_STREAM_MAX];
+__STATIC u16 testDevLineOff[TEST_DEV_LINES_MAX];
+__STATIC u16 testDevLineLen[TEST_DEV_LINES_MAX];
+__STATIC u32 testDevLineCount;
+
+/*
+ * Pseudo-random number, the same sequence on each run.
+ */
+__STATIC u32 testDevRandom(u32 range)
+{
+	testDevSeed = testDevSeed * 1103515245 + 12345;
+	return (testDevSeed >> 16) % range;
+}
+
+/*
+ * Stream device: reads return 1 to 7 bytes of the stream, and the size
+ * buffered is the rest of the stream, or a random amount that can be
+ * wrong, as drivers racing with the reception.
+ */
+__STATIC i32 testDevInit(__PDEVICE dv, __PVOID params)
+{
+	return __DEV_OK;
+}
+
+__STATIC i32 testDevOpen(__PDEVICE dv, u32 param)
+{
+	return __DEV_OK;
+}
+
+__STATIC i32 testDevClose(__PDEVICE dv)
+{
+	return __DEV_OK;
+}
+
+__STATIC i32 testDevRead(__PDEVICE dv, __PVOID buf, u16 qty)
+{
+	u32 n = testDevRandom(7) + 1;
+
+	if (n > qty) n = qty;
+	if (n > testDevLen - testDevPos) n = testDevLen - testDevPos;
+
+	__memCpy(buf, testDevStream + testDevPos, n);
+	testDevPos += n;
+
+	return n;
+}
+
+__STATIC i32 testDevSize(__PDEVICE dv, u8 mode)
+{
+	if (mode != __DEV_RXSIZE) return 0;
+
+	return testDevRandom(2) ? (i32) (testDevLen - testDevPos) : (i32) testDevRandom(16);
+}
+
+__STATIC __DEVICE testDevDevice = {
+	.dv_name = "tline", .dv_init = testDevInit, .dv_open = testDevOpen, .dv_close = testDevClose,
+	.dv_read = testDevRead, .dv_size = testDevSize
+};
+
+/*
+ * Random stream: letters, CR and LF, with runs of the same end of line.
+ */
+__STATIC __VOID testDevMakeStream(__VOID)
+{
+	u32 i, r;
+
+	testDevLen = testDevRandom(TEST_DEV_STREAM_MAX + 1);
+	testDevPos = 0;
+
+	for (i = 0; i < testDevLen; i++)
+	{
+		r = testDevRandom(10);
+		testDevStream[i] = (r < 6) ? (u8) ('a' + testDevRandom(26)) : (r < 8) ? TEST_DEV_CR : TEST_DEV_LF;
+	}
+}
+
+/*
+ * Reference model: the lines returned by successive reads into a buffer of
+ * \c qty bytes. A line ends at a CR or a LF allowed by \c mode, a LF right
+ * after a CR that ended a line (with __DEV_RD_LF) is skipped, the other CR
+ * and LF are dropped. A line of \c qty - 1 bytes is returned at once, its
+ * end of line makes the next line, empty. The bytes after the last end of
+ * line are not a line: the read fails.
+ */
+__STATIC __VOID testDevModel(u32 mode, u16 qty)
+{
+	u32 i, len = 0, off = 0;
+	__BOOL skiplf = __FALSE;
+	u8 c;
+
+	testDevLineCount = 0;
+
+	for (i = 0; i < testDevLen; i++)
+	{
+		c = testDevStream[i];
+
+		if (c == TEST_DEV_LF && skiplf)
+		{
+			skiplf = __FALSE;
+			continue;
+		}
+
+		skiplf = __FALSE;
+
+		if (c == TEST_DEV_CR || c == TEST_DEV_LF)
+		{
+			if ((c == TEST_DEV_CR && (mode & __DEV_RD_CR)) || (c == TEST_DEV_LF && (mode & __DEV_RD_LF)))
+			{
+				testDevLineOff[testDevLineCount] = off;
+				testDevLineLen[testDevLineCount++] = len;
+				off += len;
+				len = 0;
+				skiplf = (c == TEST_DEV_CR && (mode & __DEV_RD_LF));
+			}
+			continue;
+		}
+
+		testDevLines[off + len++] = c;
+
+		if (len == qty - 1)
+		{
+			testDevLineOff[testDevLineCount] = off;
+			testDevLineLen[testDevLineCount++] = len;
+			off += len;
+			len = 0;
+		}
+	}
+}
+
+/*
+ * Reads every stream in one end of line mode, and compares with the model.
+ */
+__STATIC __VOID testDevLineMode(u32 mode)
+{
+	__DEVHANDLE dh;
+	__DEVLINE lr;
+	u8 ahead[64];
+	char line[48];
+	u32 i, n, bad;
+	u16 qty;
+	i32 ret;
+
+	__deviceInit(&testDevDevice, __NULL, mode);
+	TEST_CHECK(__deviceOpenHandle(&dh, &testDevDevice, 0) == __DEV_OK);
+
+	for (n = 0; n < TEST_DEV_STREAMS; n++)
+	{
+		testDevMakeStream();
+		qty = (u16) (testDevRandom(sizeof(line) - 1) + 2);
+		testDevModel(mode, qty);
+
+		__deviceLineInit(&lr, &dh, ahead, (u16) (testDevRandom(sizeof(ahead)) + 1));
+
+		for (i = 0, bad = 0; i < testDevLineCount; i++)
+		{
+			__memSet(line, 0x55, sizeof(line));
+			ret = __deviceLineRead(&lr, line, qty);
+
+			if (ret != testDevLineLen[i] || line[ret < 0 ? 0 : ret] != 0 ||
+				memcmp(line, testDevLines + testDevLineOff[i], testDevLineLen[i]) != 0) bad++;
+		}
+
+		TEST_CHECK(bad == 0);
+
+		/* Nothing after the last line */
+		TEST_CHECK(__deviceLineRead(&lr, line, qty) == __DEV_ERROR);
+		TEST_CHECK(testDevPos == testDevLen);
+	}
+
+	TEST_CHECK(__deviceLineRead(&lr, line, 0) == __DEV_ERROR);
+	__deviceCloseHandle(&dh);
+}
+
+__VOID testDevice(__VOID)
+{
+	__deviceAdd(&testDevDevice, 1);
+	TEST_CHECK(__deviceFind("tline") == &testDevDevice);
+	TEST_CHECK(__deviceFind("tlin") == __NULL);
+
+	testDevLineMode(__DEV_RD_CR);
+	testDevLineMode(__DEV_RD_LF);
+	testDevLineMode(__DEV_RD_CRLF);
+}
@@ -0,0 +1,204 @@
+/***************************************************************************
+ * test_i2c.c
+ * (C) 2010 Ivan Meleca
+ * Based on original code written by Ruben Meleca
+ * www.milos.it
+
+
+#   This program is free software; you can redistribute it and/or modify
+#   it under the terms of the GNU General Public License as published by
+#   the Free Software Foundation; either version 2 of the License, or
+#   (at your option) any later version.
+#
+#   This program is distributed in the hope that it will be useful,
+#   but WITHOUT ANY WARRANTY; without even the implied warranty of
+#   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#   GNU General Public License for more details.
+#
+#   You should have received a copy of the GNU General Public License
+#   along with this program; if not, write to the Free Software
+#   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+***************************************************************************/
+
+
+#include <plat_cpu.h>
+#include <core/inc/device.h>
+#include <core/inc/event.h>
+#include <drivers/inc/i2c.h>
+#include <plat_i2c.h>
+#include <common/inc/mem.h>
+#include <test.h>
+
+/*
+ * I2C master jobs against the register file slave of the host model: write
+ * and read phases with the repeated START, the missing ACK, jobs queued by
+ * __i2cSubmit() running in order, the timeout of a job held by the slave,
+ * the __deviceRead() and __deviceFlush() paths, the bus time, and the
+ * interrupts saved by DMA.
+ */
+
+#define TEST_I2C_SLAVE			0x50		/* Address of the simulated slave */
+#define TEST_I2C_SPEED			400000		/* Fast mode, 44 bytes per tick */
+#define TEST_I2C_LEN			100			/* Bytes of the longer read */
+
+__STATIC __I2C_PDB testI2cPdb;
+__STATIC I2C_PARAMS testI2cParams = { TEST_I2C_SPEED, 0, TEST_I2C_SLAVE };
+__STATIC __DEVICE testI2cDevice = {
+	.dv_name = "ti2c", .dv_type = __DEV_I2C, .dv_rxint = BOARD_HOST_I2C1_IRQ, .dv_txint = BOARD_HOST_I2C1_IRQ,
+	.dv_pdb = &testI2cPdb, .dv_params = &testI2cParams,
+	.dv_init = __i2cInit, .dv_deinit = __i2cDeinit, .dv_ioctl = __i2cIOCtl,
+	.dv_open = __i2cOpen, .dv_close = __i2cClose, .dv_read = __i2cRead,
+	.dv_write = __i2cWrite, .dv_flush = __i2cFlush, .dv_size = __i2cSize,
+	.dv_plat_ioctl = __i2cPlatIoCtl
+};
+
+__STATIC u8 testI2cRx[TEST_I2C_LEN];
+
+/*
+ * Reads \c len registers from \c reg, the interrupts of the target counted.
+ */
+__STATIC u32 testI2cReadIrqs(u8 reg, u16 len)
+{
+	__I2C_JOB job;
+	u32 irqs = testI2cParams.irqs;
+
+	__memSet(&job, 0, sizeof(job));
+	job.jb_addr = TEST_I2C_SLAVE;
+	job.jb_tx = &reg;
+	job.jb_txlen = 1;
+	job.jb_rx = testI2cRx;
+	job.jb_rxlen = len;
+	TEST_CHECK(__i2cTransfer(&testI2cDevice, &job, 0) == __DEV_OK);
+
+	return testI2cParams.irqs - irqs;
+}
+
+__VOID testI2c(__VOID)
+{
+	I2C_PARAMS* params = &testI2cParams;
+	__I2C_PDB* pd = &testI2cPdb;
+	__I2C_JOB job[3];
+	__EVENT ev[3];
+	u8 w[4] = { 0x10, 0xA1, 0xB2, 0xC3 };
+	u8 w2[2] = { 0x20, 0x01 };
+	u8 w3[2] = { 0x20, 0x02 };
+	u8 r[4];
+	u8 subaddr = 0x11;
+	u32 i, ticks, irqs;
+	__BOOL ok;
+
+	__deviceAdd(&testI2cDevice, 1);
+	TEST_CHECK(__deviceInit(&testI2cDevice, __NULL, 0) == __DEV_OK);
+	TEST_CHECK(__deviceOpen(&testI2cDevice, __I2C_MODE_MASTER) == __DEV_OK);
+
+	/* Register address, then the data */
+	__memSet(job, 0, sizeof(job));
+	job[0].jb_addr = TEST_I2C_SLAVE;
+	job[0].jb_tx = w;
+	job[0].jb_txlen = 4;
+	TEST_CHECK(__i2cTransfer(&testI2cDevice, &job[0], 0) == __DEV_OK);
+	TEST_CHECK(params->regs[0x10] == 0xA1 && params->regs[0x11] == 0xB2 && params->regs[0x12] == 0xC3);
+	TEST_CHECK(params->bytes == 5);
+
+	/* Register address, repeated START, the data back */
+	__memSet(r, 0, sizeof(r));
+	job[0].jb_txlen = 1;
+	job[0].jb_rx = r;
+	job[0].jb_rxlen = 3;
+	TEST_CHECK(__i2cTransfer(&testI2cDevice, &job[0], 0) == __DEV_OK);
+	TEST_CHECK(r[0] == 0xA1 && r[1] == 0xB2 && r[2] == 0xC3);
+	TEST_CHECK(params->bytes == 5 + 6);
+
+	/* Address only: acknowledged, then no slave at another address */
+	__memSet(job, 0, sizeof(job));
+	job[0].jb_addr = TEST_I2C_SLAVE;
+	TEST_CHECK(__i2cTransfer(&testI2cDevice, &job[0], 0) == __DEV_OK);
+	job[0].jb_addr = TEST_I2C_SLAVE + 1;
+	TEST_CHECK(__i2cTransfer(&testI2cDevice, &job[0], 0) == __DEV_ERROR);
+
+	/* Missing buffers are refused */
+	job[0].jb_addr = TEST_I2C_SLAVE;
+	job[0].jb_rxlen = 1;
+	TEST_CHECK(__i2cSubmit(&testI2cDevice, &job[0]) == __DEV_ERROR);
+
+	/* Queued jobs run in order: write, read back, write again */
+	__memSet(job, 0, sizeof(job));
+	__memSet(ev, 0, sizeof(ev));
+	for (i = 0; i < 3; i++)
+	{
+		job[i].jb_addr = TEST_I2C_SLAVE;
+		ev[i].ev_state = __EV_RESET;
+		job[i].jb_event = &ev[i];
+	}
+	job[0].jb_tx = w2;
+	job[0].jb_txlen = 2;
+	job[1].jb_tx = w2;
+	job[1].jb_txlen = 1;
+	job[1].jb_rx = r;
+	job[1].jb_rxlen = 1;
+	job[2].jb_tx = w3;
+	job[2].jb_txlen = 2;
+	r[0] = 0;
+	for (i = 0; i < 3; i++) TEST_CHECK(__i2cSubmit(&testI2cDevice, &job[i]) == __DEV_OK);
+	TEST_CHECK(job[2].jb_status == __I2C_JOB_PENDING);
+	TEST_CHECK(__eventWait(&ev[2], 100) == __EVRET_SUCCESS);
+	for (i = 0; i < 3; i++) TEST_CHECK(job[i].jb_status == __DEV_OK);
+	TEST_CHECK(r[0] == 0x01 && params->regs[0x20] == 0x02);
+	TEST_CHECK(pd->pd_jobhead == __NULL && pd->pd_jobtail == __NULL);
+
+	/* The slave holds the bus: the running job times out and is aborted */
+	params->stretch = 1;
+	__memSet(job, 0, sizeof(job));
+	__eventReset(&ev[2]);
+	for (i = 0; i < 3; i++)
+	{
+		job[i].jb_addr = TEST_I2C_SLAVE;
+		job[i].jb_tx = w;
+		job[i].jb_txlen = 4;
+	}
+	job[2].jb_event = &ev[2];
+	TEST_CHECK(__i2cTransfer(&testI2cDevice, &job[0], 5) == __DEV_TIMEOUT);
+	TEST_CHECK(pd->pd_jobhead == __NULL && pd->pd_jobtail == __NULL);
+
+	/* A queued job times out and leaves the queue, the running one ends when the bus is released */
+	TEST_CHECK(__i2cSubmit(&testI2cDevice, &job[2]) == __DEV_OK);
+	TEST_CHECK(__i2cTransfer(&testI2cDevice, &job[1], 5) == __DEV_TIMEOUT);
+	TEST_CHECK(pd->pd_jobhead == &job[2] && pd->pd_jobtail == &job[2] && job[2].jb_next == __NULL);
+	TEST_CHECK(job[2].jb_status == __I2C_JOB_PENDING);
+	params->stretch = 0;
+	TEST_CHECK(__eventWait(&ev[2], 100) == __EVRET_SUCCESS);
+	TEST_CHECK(job[2].jb_status == __DEV_OK);
+	TEST_CHECK(pd->pd_jobhead == __NULL && pd->pd_jobtail == __NULL);
+	TEST_CHECK(__i2cTransfer(&testI2cDevice, &job[0], 0) == __DEV_OK);
+
+	/* Device calls: sub-address read and buffered write */
+	__deviceIOCtl(&testI2cDevice, __IOCTL_SET_REMOTE_ADDR, TEST_I2C_SLAVE, __NULL, 0);
+	__deviceIOCtl(&testI2cDevice, __IOCTL_SET_MODE, __I2C_MODE_MASTER | __I2C_MODE_REPEAT_START, __NULL, 0);
+	__deviceIOCtl(&testI2cDevice, __IOCTL_SET_REMOTE_SUBADDR, 8, &subaddr, 1);
+	__memSet(r, 0, sizeof(r));
+	TEST_CHECK(__deviceRead(&testI2cDevice, r, 2) == 2);
+	TEST_CHECK(r[0] == 0xB2 && r[1] == 0xC3);
+	TEST_CHECK(__deviceWrite(&testI2cDevice, w3, 2) == 2);
+	TEST_CHECK(__deviceFlush(&testI2cDevice) == __DEV_OK);
+	TEST_CHECK(params->regs[0x20] == 0x02 && __deviceSize(&testI2cDevice, __DEV_TXSIZE) == 0);
+	__deviceIOCtl(&testI2cDevice, __IOCTL_SET_MODE, __I2C_MODE_MASTER, __NULL, 0);
+
+	/* Bus time: 1 + 1 + 1 + TEST_I2C_LEN bytes at 44 bytes per tick */
+	for (i = 0; i < TEST_I2C_LEN; i++) params->regs[i] = (u8) (i ^ 0x5A);
+	ticks = __systemGetTickCount();
+	irqs = testI2cReadIrqs(0, TEST_I2C_LEN);
+	ticks = __systemGetTickCount() - ticks;
+	TEST_CHECK(ticks >= (3 + TEST_I2C_LEN) / 44);
+	for (i = 0, ok = __TRUE; i < TEST_I2C_LEN; i++) ok &= (testI2cRx[i] == (u8) (i ^ 0x5A));
+	TEST_CHECK(ok);
+
+	/* Interrupts: START and address twice, the register byte, BTF, a byte each */
+	TEST_CHECK(irqs == 2 + 1 + 1 + 2 + TEST_I2C_LEN);
+	params->dma = 1;
+	TEST_CHECK(testI2cReadIrqs(0, TEST_I2C_LEN) == 2 + 1 + 1 + 2 + 1);
+	TEST_CHECK(testI2cReadIrqs(0, 1) == 2 + 1 + 1 + 2 + 1);
+	params->dma = 0;
+
+	__deviceClose(&testI2cDevice);
+}
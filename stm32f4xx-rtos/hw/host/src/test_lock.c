@@ -0,0 +1,255 @@
+/***************************************************************************
+ * test_lock.c
+ * (C) 2010 Ivan Meleca
+ * Based on original code written by Ruben Meleca
+ * www.milos.it
+
+
+#   This program is free software; you can redistribute it and/or modify
+#   it under the terms of the GNU General Public License as published by
+#   the Free Software Foundation; either version 2 of the License, or
+#   (at your option) any later version.
+#
+#   This program is distributed in the hope that it will be useful,
+#   but WITHOUT ANY WARRANTY; without even the implied warranty of
+#   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#   GNU General Public License for more details.
+#
+#   You should have received a copy of the GNU General Public License
+#   along with this program; if not, write to the Free Software
+#   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+***************************************************************************/
+
+#include <core/inc/system.h>
+#include <core/inc/thread.h>
+#include <core/inc/event.h>
+#include <core/inc/lock.h>
+#include <test.h>
+
+/*
+ * Priority inversion: a low priority thread owns a lock wanted by a high
+ * priority one, while a medium priority thread keeps the CPU busy. The
+ * owner must run at the high priority until it releases the lock, so the
+ * high thread waits no longer than the hold time. Then a chain of threads,
+ * each owning a lock and waiting for the next one, longer than
+ * __LOCK_MAX_NESTING: the priority is inherited down to that depth, and a
+ * boosted waiter moves ahead of the lower priority ones in its lock's list.
+ */
+
+#define TEST_LOCK_HOLD			20			/* Ticks the low priority thread holds the lock */
+#define TEST_LOCK_SPIN			200			/* Ticks the medium priority thread keeps the CPU */
+#define TEST_LOCK_LOW			30
+#define TEST_LOCK_MEDIUM		20
+#define TEST_LOCK_HIGH			15
+#define TEST_LOCK_CHAIN			(__LOCK_MAX_NESTING + 1)
+#define TEST_LOCK_CHAIN_PRIO	40			/* Priority of the first thread of the chain, the next ones higher */
+#define TEST_LOCK_BYSTANDER		35			/* Waits for the second lock of the chain */
+#define TEST_LOCK_STACK			512
+
+__STATIC __PLOCK testLockLock;
+__STATIC __PLOCK testLockChain[TEST_LOCK_CHAIN];
+__STATIC __EVENT testLockGo = { .ev_state = __EV_RESET, .ev_threads = __NULL, .ev_links = __NULL };
+
+__STATIC __VOLATILE u32 testLockDone;
+__STATIC __VOLATILE u32 testLockWaited;			/* Ticks the high priority thread waited */
+__STATIC __VOLATILE u32 testLockLowPrio;		/* Low thread priority after releasing */
+__STATIC __VOLATILE u32 testLockChainPrio[TEST_LOCK_CHAIN];
+__STATIC __VOLATILE u32 testLockFails;
+__STATIC __VOLATILE u32 testLockByOwned;		/* The bystander owned its lock */
+__STATIC __VOLATILE u32 testLockByFirst;		/* The bystander owned the lock before the boosted waiter */
+
+/*
+ * Spins for a number of ticks, without leaving the CPU.
+ */
+__STATIC __VOID testLockSpin(u32 ticks)
+{
+	u32 start = __systemGetTickCount();
+
+	while (__systemGetTickCount() - start < ticks);
+}
+
+__STATIC __VOID testLockLowThread(__VOID)
+{
+	if (!__lockOwn(testLockLock, 1000)) testLockFails++;
+	testLockSpin(TEST_LOCK_HOLD);
+	if (!__lockRelease(testLockLock)) testLockFails++;
+
+	testLockLowPrio = __threadGetCurrent()->th_priority;
+	testLockDone++;
+
+	for (;;) __threadSleep(1000);
+}
+
+__STATIC __VOID testLockMediumThread(__VOID)
+{
+	testLockSpin(TEST_LOCK_SPIN);
+	testLockDone++;
+
+	for (;;) __threadSleep(1000);
+}
+
+__STATIC __VOID testLockHighThread(__VOID)
+{
+	u32 start = __systemGetTickCount();
+
+	if (!__lockOwn(testLockLock, 1000)) testLockFails++;
+	testLockWaited = __systemGetTickCount() - start;
+	if (!__lockRelease(testLockLock)) testLockFails++;
+	testLockDone++;
+
+	for (;;) __threadSleep(1000);
+}
+
+/*
+ * Thread of the chain: owns its lock, then waits for the next one, the
+ * last one for the testLockGo event. Releases both in reverse order.
+ */
+__STATIC __VOID testLockChainThread(__VOID)
+{
+	u32 i = (u32) __threadGetParameter();
+
+	if (!__lockOwn(testLockChain[i], 1000)) testLockFails++;
+
+	if (i + 1 < TEST_LOCK_CHAIN)
+	{
+		if (!__lockOwn(testLockChain[i + 1], 10000)) testLockFails++;
+		if (i == 0) testLockByFirst = testLockByOwned;
+		if (!__lockRelease(testLockChain[i + 1])) testLockFails++;
+	} else {
+		__eventWait(&testLockGo, 10000);
+	}
+
+	if (!__lockRelease(testLockChain[i])) testLockFails++;
+
+	testLockChainPrio[i] = __threadGetCurrent()->th_priority;
+	testLockDone++;
+
+	for (;;) __threadSleep(1000);
+}
+
+/*
+ * Waits for the second lock of the chain, after the first thread.
+ */
+__STATIC __VOID testLockBystander(__VOID)
+{
+	if (!__lockOwn(testLockChain[1], 10000)) testLockFails++;
+	testLockByOwned = 1;
+	if (!__lockRelease(testLockChain[1])) testLockFails++;
+	testLockDone++;
+
+	for (;;) __threadSleep(1000);
+}
+
+/*
+ * Waits for the first lock of the chain, or for a lock with a timeout.
+ */
+__STATIC __VOID testLockWaiter(__VOID)
+{
+	__PLOCK lock = __threadGetParameter();
+
+	if (__lockOwn(lock, lock == testLockChain[0] ? 10000 : 5))
+	{
+		__lockRelease(lock);
+	} else {
+		testLockFails++;
+	}
+	testLockDone++;
+
+	for (;;) __threadSleep(1000);
+}
+
+__VOID testLock(__VOID)
+{
+	char name[8];
+	__PTHREAD low, th[TEST_LOCK_CHAIN], by;
+	__PLOCK lock;
+	u32 count, i;
+
+	/* Uncontended own and release, and a timeout */
+	count = __lockGetCount();
+	if (!TEST_CHECK((testLockLock = __lockCreate()) != __NULL)) return;
+	TEST_CHECK(__lockGetCount() == count + 1);
+	TEST_CHECK(__lockOwn(testLockLock, 0));
+	TEST_CHECK(__lockOwn(testLockLock, 0));
+	TEST_CHECK(__lockGetOwner(testLockLock) == __threadGetCurrent());
+	TEST_CHECK(__lockRelease(testLockLock));
+	TEST_CHECK(__lockGetOwner(testLockLock) == __NULL && testLockLock->owns == 1);
+
+	/* Priority inversion */
+	testLockDone = testLockFails = 0;
+	low = __threadCreate("lklow", testLockLowThread, TEST_LOCK_LOW, TEST_LOCK_STACK, 1, __NULL);
+	__threadSleep(2);
+	TEST_CHECK(__lockGetOwner(testLockLock) == low);
+	TEST_CHECK(!__lockOwn(testLockLock, 1));
+
+	__threadCreate("lkmed", testLockMediumThread, TEST_LOCK_MEDIUM, TEST_LOCK_STACK, 1, __NULL);
+	__threadCreate("lkhigh", testLockHighThread, TEST_LOCK_HIGH, TEST_LOCK_STACK, 1, __NULL);
+	__threadSleep(1);
+	TEST_CHECK(__lockGetOwner(testLockLock) == low);
+	TEST_CHECK(low->th_priority == TEST_LOCK_HIGH && low->th_basepriority == TEST_LOCK_LOW);
+	TEST_CHECK(low->th_locks == testLockLock);
+
+	while (testLockDone < 3) __threadSleep(1);
+	TEST_CHECK(testLockFails == 0);
+	TEST_CHECK(testLockWaited <= TEST_LOCK_HOLD);
+	TEST_CHECK(testLockLowPrio == TEST_LOCK_LOW && low->th_priority == TEST_LOCK_LOW);
+	TEST_CHECK(low->th_locks == __NULL);
+	TEST_CHECK(testLockLock->contended == 2 && testLockLock->hold_max >= TEST_LOCK_HOLD);
+
+	__lockDestroy(testLockLock);
+	TEST_CHECK(__lockGetCount() == count);
+
+	/* Chain of nested locks, the last thread first */
+	testLockDone = testLockFails = 0;
+	for (i = 0; i < TEST_LOCK_CHAIN; i++) TEST_CHECK((testLockChain[i] = __lockCreate()) != __NULL);
+	for (i = TEST_LOCK_CHAIN; i--; )
+	{
+		name[0] = 'n';
+		name[1] = '0' + i;
+		name[2] = 0;
+		th[i] = __threadCreate(name, testLockChainThread, TEST_LOCK_CHAIN_PRIO - i, TEST_LOCK_STACK, 1, (__PVOID) i);
+		__threadSleep(1);
+	}
+	for (i = 0; i < TEST_LOCK_CHAIN; i++) TEST_CHECK(__lockGetOwner(testLockChain[i]) == th[i]);
+	for (i = 0; i + 1 < TEST_LOCK_CHAIN; i++) TEST_CHECK(th[i]->th_lockwait == testLockChain[i + 1]);
+
+	/* The bystander waits ahead of the first thread */
+	by = __threadCreate("lkby", testLockBystander, TEST_LOCK_BYSTANDER, TEST_LOCK_STACK, 1, __NULL);
+	__threadSleep(1);
+	TEST_CHECK(testLockChain[1]->event.ev_threads == by);
+	TEST_CHECK(th[1]->th_priority == TEST_LOCK_BYSTANDER);
+
+	/* A high priority waiter on the first lock boosts the chain down to __LOCK_MAX_NESTING */
+	__threadCreate("lkwait", testLockWaiter, TEST_LOCK_HIGH, TEST_LOCK_STACK, 1, testLockChain[0]);
+	__threadSleep(1);
+	for (i = 0; i < __LOCK_MAX_NESTING; i++) TEST_CHECK(th[i]->th_priority == TEST_LOCK_HIGH);
+	TEST_CHECK(th[TEST_LOCK_CHAIN - 1]->th_priority == TEST_LOCK_CHAIN_PRIO - TEST_LOCK_CHAIN + 1);
+	TEST_CHECK(testLockChain[1]->event.ev_threads == th[0]);
+	TEST_CHECK(th[0]->th_evnext == by && by->th_evprev == th[0]);
+
+	/* Unwind */
+	__eventSet(&testLockGo);
+	while (testLockDone < TEST_LOCK_CHAIN + 2) __threadSleep(1);
+	TEST_CHECK(testLockFails == 0);
+	TEST_CHECK(testLockByOwned && !testLockByFirst);
+	for (i = 0; i < TEST_LOCK_CHAIN; i++)
+	{
+		TEST_CHECK(testLockChainPrio[i] == TEST_LOCK_CHAIN_PRIO - i);
+		TEST_CHECK(th[i]->th_locks == __NULL && __lockGetOwner(testLockChain[i]) == __NULL);
+		__lockDestroy(testLockChain[i]);
+	}
+	TEST_CHECK(__lockGetCount() == count);
+
+	/* A lock destroyed with its waiters flag set leaves the owner's list */
+	testLockDone = testLockFails = 0;
+	if (!TEST_CHECK((lock = __lockCreate()) != __NULL)) return;
+	TEST_CHECK(__lockOwn(lock, 0));
+	__threadCreate("lktmo", testLockWaiter, TEST_LOCK_HIGH, TEST_LOCK_STACK, 1, lock);
+	while (!testLockDone) __threadSleep(1);
+	TEST_CHECK(testLockFails == 1);
+	TEST_CHECK(__threadGetCurrent()->th_locks == lock);
+	__lockDestroy(lock);
+	TEST_CHECK(__threadGetCurrent()->th_locks == __NULL);
+	TEST_CHECK(__lockGetCount() == count);
+}
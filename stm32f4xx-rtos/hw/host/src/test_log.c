@@ -0,0 +1,249 @@
+/***************************************************************************
+ * test_log.c
+ * (C) 2010 Ivan Meleca
+ * Based on original code written by Ruben Meleca
+ * www.milos.it
+
+
+#   This program is free software; you can redistribute it and/or modify
+#   it under the terms of the GNU General Public License as published by
+#   the Free Software Foundation; either version 2 of the License, or
+#   (at your option) any later version.
+#
+#   This program is distributed in the hope that it will be useful,
+#   but WITHOUT ANY WARRANTY; without even the implied warranty of
+#   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#   GNU General Public License for more details.
+#
+#   You should have received a copy of the GNU General Public License
+#   along with this program; if not, write to the Free Software
+#   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+***************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <plat_cpu.h>
+#include <core/inc/system.h>
+#include <core/inc/log.h>
+#include <test.h>
+
+/*
+ * Binary log: the records read back from the ring, the level filter, the
+ * ring full of records (drops counted by module, nothing lost or reordered),
+ * records across the ring end, and a snapshot decoded by tools/logdecode.
+ */
+
+#define TEST_LOG_MOD			(__LOG_MOD_APP + 1)		/* Module of the records */
+#define TEST_LOG_OTHER			(__LOG_MOD_APP + 2)		/* Module that never logs */
+#define TEST_LOG_REC			(__LOG_MAX_ARGS + 2)	/* Longest record */
+#define TEST_LOG_SNAP			(16 * 1024)				/* Snapshot buffer */
+#define TEST_LOG_DECODER		"./logdecode"
+
+__STATIC u32 testLogSnap[TEST_LOG_SNAP / sizeof(u32)];
+
+/*
+ * Empties the ring.
+ */
+__STATIC __VOID testLogDrain(__VOID)
+{
+	u32 rec[TEST_LOG_REC];
+
+	while (__logRead(rec, TEST_LOG_REC));
+}
+
+/*
+ * Format string of a record.
+ */
+__STATIC __CONST char* testLogFormat(pu32 rec)
+{
+	return __start_milos_log + __LOG_HDR_ID(rec[0]);
+}
+
+/*
+ * Records written and read back: header fields, format string, timestamp and
+ * arguments. Records above the module level are not stored.
+ */
+__STATIC __VOID testLogRecords(__VOID)
+{
+	u32 args[__LOG_MAX_ARGS + 2] = { 1, 2, 3, 4, 5, 6, 7, 8, 9, 10 };
+	u32 rec[TEST_LOG_REC];
+	u32 t0, i;
+
+	testLogDrain();
+	__logSetLevel(TEST_LOG_MOD, __LOG_INFO);
+	t0 = __cpuGetCycles();
+
+	LOGI(TEST_LOG_MOD, "no args");
+	LOGW(TEST_LOG_MOD, "three %lu %lu %lu", 10, 20, 30);
+	LOGD(TEST_LOG_MOD, "filtered %lu", 1);
+	TEST_CHECK(__logGetUsed() == 2 + 5);
+
+	TEST_CHECK(__logRead(rec, TEST_LOG_REC) == 2);
+	TEST_CHECK(rec[0] & __LOG_HDR_VALID);
+	TEST_CHECK(__LOG_HDR_MODULE(rec[0]) == TEST_LOG_MOD);
+	TEST_CHECK(__LOG_HDR_LEVEL(rec[0]) == __LOG_INFO);
+	TEST_CHECK(__LOG_HDR_ARGS(rec[0]) == 0);
+	TEST_CHECK(strcmp(testLogFormat(rec), "no args") == 0);
+	TEST_CHECK((i32) (rec[1] - t0) >= 0);
+	t0 = rec[1];
+
+	TEST_CHECK(__logRead(rec, 4) == 0);
+	TEST_CHECK(__logRead(rec, TEST_LOG_REC) == 5);
+	TEST_CHECK(__LOG_HDR_LEVEL(rec[0]) == __LOG_WARN);
+	TEST_CHECK(__LOG_HDR_ARGS(rec[0]) == 3);
+	TEST_CHECK(strcmp(testLogFormat(rec), "three %lu %lu %lu") == 0);
+	TEST_CHECK((i32) (rec[1] - t0) >= 0);
+	TEST_CHECK(rec[2] == 10 && rec[3] == 20 && rec[4] == 30);
+
+	TEST_CHECK(__logRead(rec, TEST_LOG_REC) == 0);
+	TEST_CHECK(__logGetUsed() == 0);
+
+	/* Arguments past __LOG_MAX_ARGS are ignored */
+	__logWrite((TEST_LOG_MOD << 8) | (__LOG_INFO << 5) | __LOG_HDR_VALID, testLogFormat(rec), args, __LOG_MAX_ARGS + 2);
+	TEST_CHECK(__logRead(rec, TEST_LOG_REC) == TEST_LOG_REC);
+	TEST_CHECK(__LOG_HDR_ARGS(rec[0]) == __LOG_MAX_ARGS);
+	for (i = 0; i < __LOG_MAX_ARGS; i++) TEST_CHECK(rec[2 + i] == args[i]);
+
+	__logSetLevel(TEST_LOG_MOD, __LOG_OFF);
+	LOGE(TEST_LOG_MOD, "off");
+	TEST_CHECK(__logGetUsed() == 0);
+}
+
+/*
+ * The ring filled up: the records that don't fit are dropped and counted
+ * for their module only, the stored ones come back in order. Then records
+ * of three words, which cross the end of the ring, one at a time.
+ */
+__STATIC __VOID testLogOverflow(__VOID)
+{
+	u32 fit = __CONFIG_LOG_WORDS / 4;
+	u32 drops = __logGetDrops(TEST_LOG_MOD);
+	u32 total = __logGetDrops(__CONFIG_LOG_MODULES);
+	u32 other = __logGetDrops(TEST_LOG_OTHER);
+	u32 rec[TEST_LOG_REC];
+	u32 i, ok;
+
+	testLogDrain();
+	__logSetLevel(TEST_LOG_MOD, __LOG_DEBUG);
+
+	for (i = 0; i < fit + 10; i++) LOGD(TEST_LOG_MOD, "seq %lu %lu", i, ~i);
+
+	TEST_CHECK(__logGetUsed() == __CONFIG_LOG_WORDS);
+	TEST_CHECK(__logGetDrops(TEST_LOG_MOD) - drops == 10);
+	TEST_CHECK(__logGetDrops(__CONFIG_LOG_MODULES) - total == 10);
+	TEST_CHECK(__logGetDrops(TEST_LOG_OTHER) == other);
+
+	for (i = 0, ok = 0; __logRead(rec, TEST_LOG_REC) == 4; i++)
+		if (rec[2] == i && rec[3] == ~i) ok++;
+
+	TEST_CHECK(i == fit);
+	TEST_CHECK(ok == fit);
+	TEST_CHECK(__logGetUsed() == 0);
+
+	/* Room again after the drain */
+	LOGD(TEST_LOG_MOD, "again");
+	TEST_CHECK(__logRead(rec, TEST_LOG_REC) == 2);
+	TEST_CHECK(__logGetDrops(TEST_LOG_MOD) - drops == 10);
+
+	for (i = 0, ok = 0; i < 3 * __CONFIG_LOG_WORDS; i++)
+	{
+		LOGD(TEST_LOG_MOD, "wrap %lu", i);
+		if (__logRead(rec, TEST_LOG_REC) == 3 && rec[2] == i) ok++;
+	}
+	TEST_CHECK(ok == 3 * __CONFIG_LOG_WORDS);
+
+	__logSetLevel(TEST_LOG_MOD, __LOG_OFF);
+}
+
+/*
+ * Runs the host decoder on a snapshot file and checks each record line.
+ * The header line of the decoder shows the drop counters.
+ */
+__STATIC __VOID testLogDecode(__VOID)
+{
+	__STATIC __CONST char* expect[] = {
+		"I 3: value 42 hex beef\n",
+		"W 3: negative -5 padded [   7]\n",
+		"E 3: percent 100%\n",
+		"D 3: missing <?>\n",
+	};
+	__PLOG_HEADER lh = (__PLOG_HEADER) testLogSnap;
+	char path[] = "/tmp/test_logXXXXXX";
+	char cmd[64], line[160], head[64];
+	u32 used, len, i;
+	FILE* f;
+	int fd;
+
+	testLogDrain();
+	__logSetLevel(TEST_LOG_MOD, __LOG_DEBUG);
+
+	LOGI(TEST_LOG_MOD, "value %lu hex %lx", 42, 0xBEEF);
+	LOGW(TEST_LOG_MOD, "negative %ld padded [%4lu]", (u32) -5, 7);
+	LOGE(TEST_LOG_MOD, "percent %lu%%", 100);
+	LOGD(TEST_LOG_MOD, "missing %lu");
+
+	__logSetLevel(TEST_LOG_MOD, __LOG_OFF);
+
+	/* Too small, then the records stay in the ring */
+	used = __logGetUsed();
+	TEST_CHECK(__logSnapshot(testLogSnap, sizeof(__LOG_HEADER)) == 0);
+
+	len = __logSnapshot(testLogSnap, sizeof(testLogSnap));
+	TEST_CHECK(len > sizeof(__LOG_HEADER));
+	TEST_CHECK(__logGetUsed() == used);
+	TEST_CHECK(lh->lh_magic == __LOG_MAGIC);
+	TEST_CHECK(lh->lh_modules == __CONFIG_LOG_MODULES);
+	TEST_CHECK(lh->lh_words == used);
+	TEST_CHECK(lh->lh_drops == __logGetDrops(__CONFIG_LOG_MODULES));
+	TEST_CHECK(((pu32) (lh + 1))[TEST_LOG_MOD] == __logGetDrops(TEST_LOG_MOD));
+
+	/* A snapshot that can't take every record ends at a whole one, the last has two words */
+	TEST_CHECK(__logSnapshot(testLogSnap, len - sizeof(u32)) == len - 2 * sizeof(u32));
+
+	len = __logSnapshot(testLogSnap, sizeof(testLogSnap));
+	testLogDrain();
+
+	/* Stdio and the decoder process, with interrupts disabled */
+	__systemStop();
+
+	fd = mkstemp(path);
+	f = (fd >= 0) ? fdopen(fd, "wb") : __NULL;
+	TEST_CHECK(f && fwrite(testLogSnap, 1, len, f) == len);
+	if (f) fclose(f);
+
+	snprintf(cmd, sizeof(cmd), "%s %s", TEST_LOG_DECODER, path);
+	snprintf(head, sizeof(head), "# %u records dropped", lh->lh_drops);
+
+	f = popen(cmd, "r");
+	TEST_CHECK(f != __NULL);
+
+	if (f)
+	{
+		TEST_CHECK(fgets(line, sizeof(line), f) && strstr(line, head) == line);
+		TEST_CHECK(strstr(line, "module 3: ") != __NULL);
+
+		for (i = 0; i < sizeof(expect) / sizeof(expect[0]); i++)
+		{
+			/* "[    0.000012] I 3: text\n" */
+			TEST_CHECK(fgets(line, sizeof(line), f) && line[0] == '[' && strstr(line, "] ") == line + 13);
+			TEST_CHECK(strstr(line, expect[i]) == line + 15);
+		}
+
+		TEST_CHECK(!fgets(line, sizeof(line), f));
+		TEST_CHECK(pclose(f) == 0);
+	}
+
+	unlink(path);
+
+	__systemStart();
+}
+
+__VOID testLog(__VOID)
+{
+	testLogRecords();
+	testLogOverflow();
+	testLogDecode();
+}
@@ -0,0 +1,169 @@
+/***************************************************************************
+ * test_mem.c
+ * (C) 2010 Ivan Meleca
+ * Based on original code written by Ruben Meleca
+ * www.milos.it
+
+#   This program is free software; you can redistribute it and/or modify
+#   it under the terms of the GNU General Public License as published by
+#   the Free Software Foundation; either version 2 of the License, or
+#   (at your option) any later version.
+#
+#   This program is distributed in the hope that it will be useful,
+#   but WITHOUT ANY WARRANTY; without even the implied warranty of
+#   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#   GNU General Public License for more details.
+#
+#   You should have received a copy of the GNU General Public License
+#   along with this program; if not, write to the Free Software
+#   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+***************************************************************************/
+
+#include <plat_cpu.h>
+#include <common/inc/mem.h>
+#include <test.h>
+
+/*
+ * __memCpy(), __memMove(), __memSet() and __memCmp() against the C library,
+ * for every size up to 259 bytes and sizes around each power of two up to
+ * 64 KB + 3, with every misalignment of source and destination. Guard bytes
+ * around the destination must never change.
+ */
+
+#define TEST_MEM_MAX			(64 * 1024 + 3)		/* Largest block */
+#define TEST_MEM_GUARD			8					/* Bytes checked before and after the destination */
+#define TEST_MEM_SHIFT			9					/* Overlaps tried by __memMove(), 1 to 8 bytes each way */
+#define TEST_MEM_BUF			(TEST_MEM_MAX + 2 * TEST_MEM_GUARD + 2 * TEST_MEM_SHIFT + 8)
+
+__STATIC u32 testMemSrc[TEST_MEM_BUF / sizeof(u32) + 1];
+__STATIC u32 testMemDst[TEST_MEM_BUF / sizeof(u32) + 1];
+__STATIC u32 testMemRef[TEST_MEM_BUF / sizeof(u32) + 1];
+
+/*
+ * Next size to test after \c size: all up to 259, then the powers of two
+ * from 512 with three bytes below and above.
+ */
+__STATIC u32 testMemNextSize(u32 size)
+{
+	u32 p;
+
+	if (size < 259) return size + 1;
+
+	for (p = 512; p <= 65536; p <<= 1)
+	{
+		if (size < p - 3) return p - 3;
+		if (size < p + 3) return size + 1;
+	}
+
+	return TEST_MEM_MAX + 1;
+}
+
+/*
+ * Fills a buffer with a pattern that changes with \c seed.
+ */
+__STATIC __VOID testMemFill(pu8 buf, u32 len, u32 seed)
+{
+	u32 i;
+
+	for (i = 0; i < len; i++) buf[i] = (u8) (i * 7 + seed * 13 + (i >> 8));
+}
+
+/*
+ * __memCpy() and __memSet() of one size and alignment, against memcpy()
+ * and memset() on a copy of the destination buffer.
+ */
+__STATIC __VOID testMemCpySet(u32 size, u32 soff, u32 doff)
+{
+	pu8 src = (pu8) testMemSrc + soff;
+	pu8 dst = (pu8) testMemDst + TEST_MEM_GUARD + doff;
+	pu8 ref = (pu8) testMemRef + TEST_MEM_GUARD + doff;
+	u32 len = size + 2 * TEST_MEM_GUARD;
+
+	testMemFill(src, size, size + soff);
+	testMemFill(dst - TEST_MEM_GUARD, len, doff);
+	memcpy(ref - TEST_MEM_GUARD, dst - TEST_MEM_GUARD, len);
+
+	__memCpy(dst, src, size);
+	memcpy(ref, src, size);
+	TEST_CHECK(memcmp(dst - TEST_MEM_GUARD, ref - TEST_MEM_GUARD, len) == 0);
+
+	__memSet(dst, (u8) (size ^ 0xA5), size);
+	memset(ref, (u8) (size ^ 0xA5), size);
+	TEST_CHECK(memcmp(dst - TEST_MEM_GUARD, ref - TEST_MEM_GUARD, len) == 0);
+}
+
+/*
+ * __memMove() of one size and alignment with the source shifted by
+ * -8 to 8 bytes from the destination, against memmove().
+ */
+__STATIC __VOID testMemMove(u32 size, u32 soff, u32 doff)
+{
+	pu8 buf = (pu8) testMemDst;
+	pu8 ref = (pu8) testMemRef;
+	u32 base = TEST_MEM_GUARD + TEST_MEM_SHIFT + doff;
+	u32 len = size + 2 * (TEST_MEM_GUARD + TEST_MEM_SHIFT) + 4;
+	i32 shift;
+
+	for (shift = 1 - TEST_MEM_SHIFT; shift < TEST_MEM_SHIFT; shift++)
+	{
+		/* Misalign the source by soff on top of the shift */
+		i32 s = shift + (i32) soff;
+
+		testMemFill(buf, len, size + shift);
+		memcpy(ref, buf, len);
+
+		__memMove(buf + base, buf + base + s, size);
+		memmove(ref + base, ref + base + s, size);
+		if (!TEST_CHECK(memcmp(buf, ref, len) == 0)) return;
+	}
+}
+
+/*
+ * __memCmp() of equal blocks, and of blocks differing at the first, a
+ * middle and the last byte.
+ */
+__STATIC __VOID testMemCmp(u32 size, u32 soff, u32 doff)
+{
+	pu8 a = (pu8) testMemSrc + soff;
+	pu8 b = (pu8) testMemDst + doff;
+	u32 at[3], i;
+
+	testMemFill(a, size, size);
+	memcpy(b, a, size);
+	TEST_CHECK(__memCmp(a, b, size) == 0);
+
+	if (!size) return;
+
+	at[0] = 0;
+	at[1] = size / 2;
+	at[2] = size - 1;
+
+	for (i = 0; i < 3; i++)
+	{
+		b[at[i]] ^= 0x80;
+		TEST_CHECK(__memCmp(a, b, size) != 0);
+		b[at[i]] ^= 0x80;
+	}
+}
+
+/*
+ * Every size and misalignment.
+ */
+__VOID testMem(__VOID)
+{
+	u32 size, soff, doff;
+
+	for (size = 0; size <= TEST_MEM_MAX; size = testMemNextSize(size))
+	{
+		for (soff = 0; soff < sizeof(u32); soff++)
+		{
+			for (doff = 0; doff < sizeof(u32); doff++)
+			{
+				testMemCpySet(size, soff, doff);
+				testMemMove(size, soff, doff);
+				testMemCmp(size, soff, doff);
+			}
+		}
+	}
+}
@@ -0,0 +1,349 @@
+/***************************************************************************
+ * test_pendsv.c
+ * (C) 2010 Ivan Meleca
+ * Based on original code written by Ruben Meleca
+ * www.milos.it
+
+
+#   This program is free software; you can redistribute it and/or modify
+#   it under the terms of the GNU General Public License as published by
+#   the Free Software Foundation; either version 2 of the License, or
+#   (at your option) any later version.
+#
+#   This program is distributed in the hope that it will be useful,
+#   but WITHOUT ANY WARRANTY; without even the implied warranty of
+#   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#   GNU General Public License for more details.
+#
+#   You should have received a copy of the GNU General Public License
+#   along with this program; if not, write to the Free Software
+#   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+***************************************************************************/
+
+
+#include <plat_cpu.h>
+#include <core/inc/thread.h>
+#include <common/inc/mem.h>
+#include <test.h>
+
+/*
+ * Context switch of the Cortex-M4F target (__pcd_PendSVHandler() in
+ * hw/compilers/gcc/src/plat_comp_dep.c) on a register-level model: the
+ * exception entry and return of the core with automatic and lazy FPU state
+ * stacking (FPCCR.ASPEN and LSPEN set), and the handler, one step for each
+ * instruction. Keep testPsvHandler() in step with the handler.
+ *
+ * Threads with and without FPU context are switched in random order, each
+ * one changing its registers while running: every thread must get back its
+ * own core and FPU registers, the handler must move no FPU register for the
+ * threads without FPU context, and the stack used by a switched out thread
+ * must be the documented one.
+ */
+
+#define TEST_PSV_THREADS		4			/* Threads 0 and 1 use the FPU from the start, 2 from the middle */
+#define TEST_PSV_LATE			2			/* The thread using the FPU from the middle */
+#define TEST_PSV_SWITCHES		2000		/* Context switches */
+#define TEST_PSV_STACK			128			/* Words of stack of each thread */
+#define TEST_PSV_EXC_NOFPU		0xFFFFFFFD	/* EXC_RETURN: thread mode, process stack, basic frame */
+#define TEST_PSV_EXC_FPU		0xFFFFFFED	/* EXC_RETURN: thread mode, process stack, extended frame */
+
+/* Core of the model, the registers of the running thread */
+typedef struct {
+	u32		r[13];			/* R0-R12 */
+	u32		lr;				/* R14 */
+	u32		pc;
+	u32		xpsr;
+	u32		psp;			/* Word index in testPsvMem, 0 before the first switch */
+	u32		s[32];			/* S0-S31 */
+	u32		fpscr;
+	__BOOL	fpca;			/* CONTROL.FPCA: the thread has an active FPU context */
+	__BOOL	lspact;			/* FPCCR.LSPACT: lazy stacking pending at fpcar */
+	u32		fpcar;			/* FPCAR: S0 of the reserved extended frame */
+	u32		fpwords;		/* FPU registers moved to or from the memory */
+} TEST_PSV_CORE;
+
+__STATIC u32 testPsvMem[TEST_PSV_THREADS * TEST_PSV_STACK + 1];
+__STATIC TEST_PSV_CORE testPsvCore;
+__STATIC u32 testPsvSp[TEST_PSV_THREADS];		/* __threadSp of each thread, its saved PSP */
+__STATIC u32 testPsvRunning;
+__STATIC u32 testPsvNext;
+__STATIC u32 testPsvSeed = 1;
+
+/* Registers each thread expects, as it left them */
+__STATIC u32 testPsvR[TEST_PSV_THREADS][13];
+__STATIC u32 testPsvS[TEST_PSV_THREADS][32];
+__STATIC __BOOL testPsvFpu[TEST_PSV_THREADS];
+
+__STATIC u32 testPsvRandom(u32 range)
+{
+	testPsvSeed = testPsvSeed * 1103515245 + 12345;
+	return (testPsvSeed >> 16) % range;
+}
+
+__STATIC __VOID testPsvPush(u32* sp, u32 value)
+{
+	testPsvMem[--(*sp)] = value;
+}
+
+__STATIC u32 testPsvPop(u32* sp)
+{
+	return testPsvMem[(*sp)++];
+}
+
+/*
+ * First FPU instruction after an exception entry: the lazy stacking saves
+ * S0-S15 and FPSCR in the reserved space of the extended frame.
+ */
+__STATIC __VOID testPsvLazy(__VOID)
+{
+	TEST_PSV_CORE* c = &testPsvCore;
+	u32 i;
+
+	if (!c->lspact) return;
+
+	for (i = 0; i < 16; i++) testPsvMem[c->fpcar + i] = c->s[i];
+	testPsvMem[c->fpcar + 16] = c->fpscr;
+	c->fpwords += 17;
+	c->lspact = __FALSE;
+}
+
+/*
+ * Exception entry from thread mode on the process stack: the basic frame,
+ * or the extended one with its FPU part only reserved.
+ */
+__STATIC __VOID testPsvEntry(__VOID)
+{
+	TEST_PSV_CORE* c = &testPsvCore;
+
+	if (c->fpca)
+	{
+		c->psp -= 18;				/* S0-S15, FPSCR, reserved */
+		c->fpcar = c->psp;
+		c->lspact = __TRUE;
+	}
+
+	testPsvPush(&c->psp, c->xpsr);
+	testPsvPush(&c->psp, c->pc);
+	testPsvPush(&c->psp, c->lr);
+	testPsvPush(&c->psp, c->r[12]);
+	testPsvPush(&c->psp, c->r[3]);
+	testPsvPush(&c->psp, c->r[2]);
+	testPsvPush(&c->psp, c->r[1]);
+	testPsvPush(&c->psp, c->r[0]);
+
+	c->lr = c->fpca ? TEST_PSV_EXC_FPU : TEST_PSV_EXC_NOFPU;
+	c->fpca = __FALSE;
+}
+
+/*
+ * Exception return to the process stack, the frame given by EXC_RETURN bit 4.
+ */
+__STATIC __VOID testPsvReturn(__VOID)
+{
+	TEST_PSV_CORE* c = &testPsvCore;
+	u32 exc = c->lr;
+	u32 i;
+
+	c->r[0] = testPsvPop(&c->psp);
+	c->r[1] = testPsvPop(&c->psp);
+	c->r[2] = testPsvPop(&c->psp);
+	c->r[3] = testPsvPop(&c->psp);
+	c->r[12] = testPsvPop(&c->psp);
+	c->lr = testPsvPop(&c->psp);
+	c->pc = testPsvPop(&c->psp);
+	c->xpsr = testPsvPop(&c->psp);
+
+	c->fpca = !(exc & 0x10);
+
+	if (c->fpca)
+	{
+		/* Still pending: the registers were never saved, nor changed */
+		if (c->lspact)
+		{
+			c->lspact = __FALSE;
+		} else
+		{
+			for (i = 0; i < 16; i++) c->s[i] = testPsvMem[c->psp + i];
+			c->fpscr = testPsvMem[c->psp + 16];
+			c->fpwords += 17;
+		}
+		c->psp += 18;
+	}
+}
+
+/*
+ * __pcd_PendSVHandler(), on the model.
+ */
+__STATIC __VOID testPsvHandler(__VOID)
+{
+	TEST_PSV_CORE* c = &testPsvCore;
+	u32 r0, i;
+
+	r0 = c->psp;											/* MRS R0, PSP */
+	if (r0)													/* CBZ R0, OSPendSVSKIP */
+	{
+		if (!(c->lr & 0x10))								/* TST LR, #0x10; IT EQ */
+		{
+			testPsvLazy();									/* VSTMDBEQ R0!, {S16-S31} */
+			for (i = 32; i > 16; i--) testPsvPush(&r0, c->s[i - 1]);
+			c->fpwords += 16;
+		}
+		testPsvPush(&r0, c->lr);							/* STMDB R0!, {R4-R11, LR} */
+		for (i = 12; i > 4; i--) testPsvPush(&r0, c->r[i - 1]);
+
+		testPsvSp[testPsvRunning] = r0;						/* STR R0, [__threadSp] */
+	}
+
+	testPsvRunning = testPsvNext;							/* BLX __threadChange */
+
+	r0 = testPsvSp[testPsvRunning];							/* LDR R0, [__threadSp] */
+	for (i = 4; i < 12; i++) c->r[i] = testPsvPop(&r0);		/* LDMIA R0!, {R4-R11, LR} */
+	c->lr = testPsvPop(&r0);
+	if (!(c->lr & 0x10))									/* TST LR, #0x10; IT EQ */
+	{
+		testPsvLazy();										/* VLDMIAEQ R0!, {S16-S31} */
+		for (i = 16; i < 32; i++) c->s[i] = testPsvPop(&r0);
+		c->fpwords += 16;
+	}
+
+	c->psp = r0;											/* MSR PSP, R0 */
+}
+
+/*
+ * Initial frame of a thread, as __cpuMakeStackFrame() of the target.
+ */
+__STATIC u32 testPsvFrame(u32 top, u32 func)
+{
+	u32 sp = top;
+
+	testPsvPush(&sp, 0x01000000);	/* xPSR */
+	testPsvPush(&sp, func);
+	testPsvPush(&sp, 0x14);			/* R14 */
+	testPsvPush(&sp, 0x12);			/* R12 */
+	testPsvPush(&sp, 0x03);
+	testPsvPush(&sp, 0x02);
+	testPsvPush(&sp, 0x01);
+	testPsvPush(&sp, 0);			/* R0 */
+	testPsvPush(&sp, TEST_PSV_EXC_NOFPU);
+	testPsvPush(&sp, 0x11);			/* R11 */
+	testPsvPush(&sp, 0x10);
+	testPsvPush(&sp, 0x09);
+	testPsvPush(&sp, 0x08);
+	testPsvPush(&sp, 0x07);
+	testPsvPush(&sp, 0x06);
+	testPsvPush(&sp, 0x05);
+	testPsvPush(&sp, 0x04);			/* R4 */
+
+	return sp;
+}
+
+/*
+ * The running thread checks that its registers are the ones it left, then
+ * changes them (the FPU ones if it uses the FPU, the first FPU instruction
+ * setting CONTROL.FPCA).
+ */
+__STATIC __BOOL testPsvRun(u32 th)
+{
+	TEST_PSV_CORE* c = &testPsvCore;
+	__BOOL ok = __TRUE;
+	u32 i;
+
+	for (i = 0; i < 13; i++) ok &= (c->r[i] == testPsvR[th][i]);
+	if (testPsvFpu[th] && c->fpca)
+	{
+		for (i = 0; i < 32; i++) ok &= (c->s[i] == testPsvS[th][i]);
+	}
+
+	for (i = 0; i < 13; i++) c->r[i] = testPsvR[th][i] = (th << 24) | testPsvRandom(0x10000);
+	c->pc = 0x08000000 + th * 0x100;
+
+	if (testPsvFpu[th])
+	{
+		testPsvLazy();
+		c->fpca = __TRUE;
+		for (i = 0; i < 32; i++) c->s[i] = testPsvS[th][i] = (th << 24) | 0x800000 | testPsvRandom(0x10000);
+	}
+
+	return ok;
+}
+
+__STATIC __VOID testPsvSwitch(u32 next)
+{
+	testPsvNext = next;
+	testPsvEntry();
+	testPsvHandler();
+	testPsvReturn();
+}
+
+__VOID testPendSv(__VOID)
+{
+	TEST_PSV_CORE* c = &testPsvCore;
+	u32 i, k, prev, next, sp, fpwords;
+	__BOOL ok;
+
+	__memSet(c, 0, sizeof(TEST_PSV_CORE));
+	__memSet(testPsvFpu, 0, sizeof(testPsvFpu));
+
+	for (i = 0; i < TEST_PSV_THREADS; i++)
+	{
+		testPsvSp[i] = testPsvFrame((i + 1) * TEST_PSV_STACK + 1, 0x08000000 + i * 0x100);
+		for (k = 0; k < 13; k++) testPsvR[i][k] = (k < 4) ? k : (k == 12) ? 0x12 : k;
+		testPsvR[i][10] = 0x10;
+		testPsvR[i][11] = 0x11;
+	}
+
+	/* A new thread starts without FPU context */
+	TEST_CHECK(testPsvMem[testPsvSp[0] + 8] == TEST_PSV_EXC_NOFPU);
+
+	/* First switch, from main() on the main stack (PSP zero): nothing saved */
+	testPsvNext = 3;
+	c->lr = 0xFFFFFFF9;
+	testPsvHandler();
+	testPsvReturn();
+	TEST_CHECK(testPsvRunning == 3 && c->pc == 0x08000300 && c->r[4] == 0x04 && c->r[11] == 0x11);
+	TEST_CHECK(c->psp == 4 * TEST_PSV_STACK + 1 && !c->fpca);
+
+	/* Integer threads only: no FPU register moved at all */
+	for (i = 0, ok = __TRUE; i < TEST_PSV_SWITCHES / 4; i++)
+	{
+		ok &= testPsvRun(testPsvRunning);
+		testPsvSwitch(TEST_PSV_LATE + testPsvRandom(2));
+	}
+	TEST_CHECK(ok);
+	TEST_CHECK(c->fpwords == 0);
+
+	/* The other threads use the FPU, one of them from the middle */
+	testPsvFpu[0] = testPsvFpu[1] = __TRUE;
+	for (i = 0, ok = __TRUE, fpwords = 0; i < TEST_PSV_SWITCHES; i++)
+	{
+		if (i == TEST_PSV_SWITCHES / 2) testPsvFpu[TEST_PSV_LATE] = __TRUE;
+		ok &= testPsvRun(testPsvRunning);
+
+		prev = testPsvRunning;
+		do next = testPsvRandom(TEST_PSV_THREADS); while (next == prev);
+
+		/* Between integer threads the FPU stays untouched */
+		fpwords = c->fpwords;
+		testPsvSwitch(next);
+		if (!testPsvFpu[prev] && !testPsvFpu[next]) ok &= (c->fpwords == fpwords);
+	}
+	TEST_CHECK(ok);
+	TEST_CHECK(testPsvRun(testPsvRunning));
+
+	/* Stack of a switched out thread: 17 words, 51 with FPU context */
+	for (i = 0; i < TEST_PSV_THREADS; i++)
+	{
+		if (i == testPsvRunning) continue;
+
+		sp = (i + 1) * TEST_PSV_STACK + 1 - testPsvSp[i];
+		if (testPsvFpu[i])
+		{
+			TEST_CHECK(sp == 51 && testPsvMem[testPsvSp[i] + 8] == TEST_PSV_EXC_FPU);
+		} else
+		{
+			TEST_CHECK(sp == 17 && testPsvMem[testPsvSp[i] + 8] == TEST_PSV_EXC_NOFPU);
+		}
+	}
+	TEST_CHECK(51 * sizeof(u32) == 204 && __TH_MINSTACKSIZE >= 204);
+}
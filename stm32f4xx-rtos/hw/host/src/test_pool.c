@@ -0,0 +1,305 @@
+/***************************************************************************
+ * test_pool.c
+ * (C) 2010 Ivan Meleca
+ * Based on original code written by Ruben Meleca
+ * www.milos.it
+
+
+#   This program is free software; you can redistribute it and/or modify
+#   it under the terms of the GNU General Public License as published by
+#   the Free Software Foundation; either version 2 of the License, or
+#   (at your option) any later version.
+#
+#   This program is distributed in the hope that it will be useful,
+#   but WITHOUT ANY WARRANTY; without even the implied warranty of
+#   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#   GNU General Public License for more details.
+#
+#   You should have received a copy of the GNU General Public License
+#   along with this program; if not, write to the Free Software
+#   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+***************************************************************************/
+
+
+#include <plat_cpu.h>
+#include <core/inc/system.h>
+#include <core/inc/thread.h>
+#include <core/inc/event.h>
+#include <core/inc/intrvect.h>
+#include <core/inc/pool.h>
+#include <test.h>
+
+/*
+ * Block pool under concurrent use: threads of two priorities allocate,
+ * with and without waiting, and free blocks, while the system tick
+ * interrupt (SIGALRM on the host) allocates and frees blocks too. Each
+ * block is tagged with its holder when handed out, and filled with a
+ * pattern checked when it is freed, so a block handed out twice is seen.
+ * Then the counters, and the waiters woken up by __poolDestroy().
+ */
+
+#define TEST_POOL_BLOCKS		16			/* Blocks of the pool */
+#define TEST_POOL_SIZE			24			/* Bytes of each block */
+#define TEST_POOL_THREADS		4			/* Threads using the pool */
+#define TEST_POOL_HOLD			4			/* Blocks held by each thread at most */
+#define TEST_POOL_ISR_HOLD		4			/* Blocks held by the interrupt at most */
+#define TEST_POOL_TICKS			400			/* Interrupts to run the threads for */
+#define TEST_POOL_PRIO			11			/* Threads priority, the first thread one level higher */
+#define TEST_POOL_STACK			512
+
+__STATIC u32 testPoolArea[__POOL_AREA_SIZE(TEST_POOL_SIZE, TEST_POOL_BLOCKS) / sizeof(u32)];
+__STATIC __POOL testPoolPool;
+
+/* Holder of each block, zero when free: thread number + 1, or the interrupt */
+#define TEST_POOL_ISR			(TEST_POOL_THREADS + 1)
+__STATIC __VOLATILE u8 testPoolOwner[TEST_POOL_BLOCKS];
+
+__STATIC __VOLATILE u32 testPoolTwice;			/* Blocks handed out while held */
+__STATIC __VOLATILE u32 testPoolBadFill;		/* Blocks changed while held */
+__STATIC __VOLATILE u32 testPoolAllocs;			/* Blocks handed out */
+__STATIC __VOLATILE u32 testPoolFails;			/* Empty pool found, waiting included */
+__STATIC __VOLATILE u32 testPoolMinSeen;		/* Lowest \c avail read by the threads */
+__STATIC __VOLATILE u32 testPoolTicks;
+__STATIC __VOLATILE u32 testPoolDone;
+__STATIC __VOLATILE __PVOID testPoolWaitResult;
+
+__STATIC __PVOID testPoolIsrHeld[TEST_POOL_ISR_HOLD];
+__STATIC u32 testPoolIsrCount;
+
+/*
+ * Index of a block of the pool.
+ */
+__STATIC u32 testPoolIndex(__PVOID blk)
+{
+	return ((u8*) blk - (u8*) testPoolPool.ref) / testPoolPool.block_size;
+}
+
+/*
+ * Tags a block just handed out, and fills it. Called with interrupts
+ * disabled or from the interrupt.
+ */
+__STATIC __VOID testPoolTake(__PVOID blk, u8 owner)
+{
+	u32 i = testPoolIndex(blk);
+
+	if (testPoolOwner[i]) testPoolTwice++;
+	testPoolOwner[i] = owner;
+	testPoolAllocs++;
+
+	memset(blk, owner, TEST_POOL_SIZE);
+}
+
+/*
+ * Checks and untags a block about to be freed. Called with interrupts
+ * disabled or from the interrupt.
+ */
+__STATIC __VOID testPoolGive(__PVOID blk, u8 owner)
+{
+	u32 i = testPoolIndex(blk);
+	pu8 p = blk;
+	u32 j;
+
+	for (j = 0; j < TEST_POOL_SIZE; j++) if (p[j] != owner) break;
+	if (j < TEST_POOL_SIZE || testPoolOwner[i] != owner) testPoolBadFill++;
+
+	testPoolOwner[i] = 0;
+}
+
+/*
+ * The interrupt: frees its oldest block on odd ticks, allocates one on
+ * even ticks. Only frees after TEST_POOL_TICKS ticks.
+ */
+__STATIC __VOID testPoolIsr(__PVOID arg)
+{
+	__PVOID blk;
+	u32 i;
+
+	if (++testPoolTicks & 1)
+	{
+		if (!testPoolIsrCount) return;
+
+		blk = testPoolIsrHeld[0];
+		for (i = 1; i < testPoolIsrCount; i++) testPoolIsrHeld[i - 1] = testPoolIsrHeld[i];
+		testPoolIsrCount--;
+
+		testPoolGive(blk, TEST_POOL_ISR);
+		__poolFree(&testPoolPool, blk);
+	} else {
+		if (testPoolIsrCount == TEST_POOL_ISR_HOLD || testPoolTicks >= TEST_POOL_TICKS) return;
+
+		if ((blk = __poolAlloc(&testPoolPool)) == __NULL)
+		{
+			testPoolFails++;
+			return;
+		}
+
+		testPoolTake(blk, TEST_POOL_ISR);
+		testPoolIsrHeld[testPoolIsrCount++] = blk;
+	}
+}
+
+/*
+ * Thread using the pool until TEST_POOL_TICKS interrupts ran: allocates
+ * (every other time waiting up to 2 ms) while it holds less than
+ * TEST_POOL_HOLD blocks, and frees a block otherwise or at random. It
+ * sleeps at times with its blocks, letting the lower priority threads run.
+ */
+__STATIC __VOID testPoolThread(__VOID)
+{
+	u8 owner = (u8) (u32) __threadGetParameter();
+	__PVOID held[TEST_POOL_HOLD];
+	__PVOID blk;
+	u32 cnt = 0, seed = owner, avail, n = 0, i;
+
+	while (testPoolTicks < TEST_POOL_TICKS || cnt)
+	{
+		seed = seed * 1103515245 + 12345;
+
+		if (testPoolTicks < TEST_POOL_TICKS && cnt < TEST_POOL_HOLD && (seed >> 16) % 3)
+		{
+			blk = (n++ & 1) ? __poolAllocWait(&testPoolPool, 2) : __poolAlloc(&testPoolPool);
+
+			__systemStop();
+			avail = testPoolPool.avail;
+			if (avail < testPoolMinSeen) testPoolMinSeen = avail;
+			if (blk)
+			{
+				testPoolTake(blk, owner);
+			} else {
+				testPoolFails++;
+			}
+			__systemStart();
+
+			if (blk) held[cnt++] = blk;
+		} else if (cnt) {
+			i = (seed >> 20) % cnt;
+			blk = held[i];
+			held[i] = held[--cnt];
+
+			__systemStop();
+			testPoolGive(blk, owner);
+			__systemStart();
+
+			__poolFree(&testPoolPool, blk);
+		}
+
+		if (!((seed >> 24) & 7))
+		{
+			__threadSleep(1);
+		} else if (!((seed >> 24) & 1)) {
+			__threadYield();
+		}
+	}
+
+	__systemStop();
+	testPoolDone++;
+	__systemStart();
+
+	for (;;) __threadSleep(1000);
+}
+
+/*
+ * Waits for a block of the pool, for ever.
+ */
+__STATIC __VOID testPoolWaiter(__VOID)
+{
+	testPoolWaitResult = __poolAllocWait(&testPoolPool, 0);
+
+	__systemStop();
+	testPoolDone++;
+	__systemStart();
+
+	for (;;) __threadSleep(1000);
+}
+
+__VOID testPool(__VOID)
+{
+	char name[8];
+	__PVOID blk[TEST_POOL_BLOCKS];
+	__PPOOL pl;
+	u32 i;
+
+	TEST_CHECK(!__poolCreate(__POOL_STATIC, &testPoolPool, TEST_POOL_SIZE, TEST_POOL_BLOCKS, testPoolArea, sizeof(testPoolArea) - 1));
+	if (!TEST_CHECK(__poolCreate(__POOL_STATIC, &testPoolPool, TEST_POOL_SIZE, TEST_POOL_BLOCKS, testPoolArea, sizeof(testPoolArea)))) return;
+	TEST_CHECK(testPoolPool.block_size == TEST_POOL_SIZE);
+
+	for (pl = __poolGetList(); pl && pl != &testPoolPool; pl = pl->next);
+	TEST_CHECK(pl == &testPoolPool);
+
+	/* Foreign and misaligned blocks are refused */
+	TEST_CHECK(!__poolFree(&testPoolPool, (__PVOID) testPoolOwner));
+	TEST_CHECK(!__poolFree(&testPoolPool, (u8*) testPoolArea + 4));
+	TEST_CHECK(!__poolFree(&testPoolPool, (u8*) testPoolArea + sizeof(testPoolArea)));
+
+	/* Empty the pool and fill it again, from one thread */
+	for (i = 0; i < TEST_POOL_BLOCKS; i++) blk[i] = __poolAlloc(&testPoolPool);
+	TEST_CHECK(__poolAlloc(&testPoolPool) == __NULL);
+	TEST_CHECK(__poolAllocWait(&testPoolPool, 3) == __NULL);
+	TEST_CHECK(testPoolPool.avail == 0 && testPoolPool.min_avail == 0);
+	/* __poolAllocWait() tries before and after waiting */
+	TEST_CHECK(testPoolPool.allocs == TEST_POOL_BLOCKS && testPoolPool.fails == 3);
+	for (i = 0; i < TEST_POOL_BLOCKS; i++) TEST_CHECK(blk[i] && testPoolIndex(blk[i]) < TEST_POOL_BLOCKS && __poolFree(&testPoolPool, blk[i]));
+	TEST_CHECK(testPoolPool.avail == TEST_POOL_BLOCKS);
+
+	/* Concurrent use, with the interrupt */
+	testPoolPool.min_avail = TEST_POOL_BLOCKS;
+	testPoolPool.allocs = testPoolPool.fails = 0;
+	testPoolMinSeen = TEST_POOL_BLOCKS;
+	testPoolDone = 0;
+
+	for (i = 0; i < TEST_POOL_THREADS; i++)
+	{
+		name[0] = 'p';
+		name[1] = '0' + i;
+		name[2] = 0;
+		__threadCreate(name, testPoolThread, i ? TEST_POOL_PRIO + 1 : TEST_POOL_PRIO, TEST_POOL_STACK, 1, (__PVOID) (i + 1));
+	}
+
+	__intSetVector(BOARD_HOST_UART1_IRQ, testPoolIsr, __NULL);
+	while (testPoolDone < TEST_POOL_THREADS) __threadSleep(1);
+
+	/* The interrupt returns its blocks */
+	while (testPoolIsrCount) __threadSleep(1);
+	__intSetVector(BOARD_HOST_UART1_IRQ, __NULL, __NULL);
+
+	TEST_CHECK(testPoolTwice == 0);
+	TEST_CHECK(testPoolBadFill == 0);
+	TEST_CHECK(testPoolPool.avail == TEST_POOL_BLOCKS);
+	TEST_CHECK(testPoolPool.waiting == 0);
+	TEST_CHECK(testPoolPool.allocs == testPoolAllocs);
+	TEST_CHECK(testPoolPool.min_avail <= testPoolMinSeen);
+	TEST_CHECK(testPoolPool.min_avail == 0);
+	TEST_CHECK(testPoolFails > 0);
+	TEST_CHECK(testPoolPool.fails >= testPoolFails);
+	for (i = 0; i < TEST_POOL_BLOCKS; i++) TEST_CHECK(testPoolOwner[i] == 0);
+
+	/* Every block is in the free list once */
+	for (i = 0; i < TEST_POOL_BLOCKS; i++) blk[i] = __poolAlloc(&testPoolPool);
+	for (i = 0; i < TEST_POOL_BLOCKS; i++) TEST_CHECK(blk[i] && testPoolOwner[testPoolIndex(blk[i])]++ == 0);
+	TEST_CHECK(__poolAlloc(&testPoolPool) == __NULL);
+	memset((__PVOID) testPoolOwner, 0, sizeof(testPoolOwner));
+
+	/* A higher priority waiter gets the block freed */
+	testPoolDone = 0;
+	testPoolWaitResult = __NULL;
+	__threadCreate("pwait1", testPoolWaiter, TEST_POOL_PRIO - 2, TEST_POOL_STACK, 1, __NULL);
+	TEST_CHECK(testPoolPool.waiting == 1);
+	TEST_CHECK(__poolFree(&testPoolPool, blk[0]));
+	TEST_CHECK(testPoolDone == 1 && testPoolWaitResult == blk[0]);
+	TEST_CHECK(testPoolPool.waiting == 0 && testPoolPool.avail == 0);
+
+	/* A waiter is woken up with no block when the pool is destroyed */
+	testPoolDone = 0;
+	testPoolWaitResult = testPoolPool.ref;
+	__threadCreate("pwait2", testPoolWaiter, TEST_POOL_PRIO - 2, TEST_POOL_STACK, 1, __NULL);
+	TEST_CHECK(testPoolPool.waiting == 1);
+
+	__poolDestroy(&testPoolPool);
+	while (!testPoolDone) __threadSleep(1);
+	TEST_CHECK(testPoolWaitResult == __NULL);
+	TEST_CHECK(__poolAlloc(&testPoolPool) == __NULL);
+
+	for (pl = __poolGetList(); pl && pl != &testPoolPool; pl = pl->next);
+	TEST_CHECK(pl == __NULL);
+}
@@ -0,0 +1,193 @@
+/***************************************************************************
+ * test_profile.c
+ * (C) 2010 Ivan Meleca
+ * Based on original code written by Ruben Meleca
+ * www.milos.it
+
+
+#   This program is free software; you can redistribute it and/or modify
+#   it under the terms of the GNU General Public License as published by
+#   the Free Software Foundation; either version 2 of the License, or
+#   (at your option) any later version.
+#
+#   This program is distributed in the hope that it will be useful,
+#   but WITHOUT ANY WARRANTY; without even the implied warranty of
+#   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#   GNU General Public License for more details.
+#
+#   You should have received a copy of the GNU General Public License
+#   along with this program; if not, write to the Free Software
+#   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+***************************************************************************/
+
+#include <plat_cpu.h>
+#include <core/inc/system.h>
+#include <core/inc/thread.h>
+#include <core/inc/profile.h>
+#include <test.h>
+
+/*
+ * Profiler accounting against a fake cycle counter (__hostCycles), moved by
+ * hand between the hooks: the cycles of each thread with the interrupts
+ * taken out, the idle cycles, the switches and the preemptions, a counter
+ * wrap, and the longest critical section of each site. The hooks are called
+ * directly, with interrupts disabled so the tick does not account meanwhile;
+ * two fake threads are switched in and out.
+ */
+
+#define TEST_PROF_SITE_A		0x08001234	/* Critical section call sites */
+#define TEST_PROF_SITE_B		0x08005678
+
+__STATIC __THREAD testProfA;
+__STATIC __THREAD testProfB;
+
+/* Moves the fake cycle counter */
+#define testProfRun(n)			(__hostCycles += (n))
+
+/*
+ * Thread cycles, idle cycles, interrupts, switches and preemptions.
+ */
+__STATIC __VOID testProfThreads(__VOID)
+{
+	__PROF_HEADER hdr;
+	u64 cycles;
+
+	testProfA.th_status = testProfB.th_status = __THSTS_RUNNING;
+
+	__hostCycles = 1000;
+	__profReset();
+	__profSwitch(&testProfA);
+
+	/* A runs 500, switched out still ready */
+	testProfRun(500);
+	testProfA.th_status = __THSTS_READY;
+	__profSwitch(&testProfB);
+
+	TEST_CHECK(testProfA.th_cycles == 500);
+	TEST_CHECK(testProfA.th_switches == 1);
+	TEST_CHECK(testProfA.th_preempts == 1);
+	TEST_CHECK(testProfB.th_switches == 1);
+
+	/* B runs 300, nested interrupts take 130 of them, the tick among them */
+	testProfRun(100);
+	__systemEnterISR();
+	testProfRun(50);
+	__systemEnterISR();
+	testProfRun(60);
+	__profTick();
+	__systemLeaveISR();
+	testProfRun(20);
+	__systemLeaveISR();
+	testProfRun(70);
+	testProfB.th_status = __THSTS_WAITING;
+	__profSwitch(__NULL);
+
+	TEST_CHECK(testProfB.th_cycles == 170);
+	TEST_CHECK(testProfB.th_preempts == 0);
+
+	/* Idle 400, with a tick and an interrupt in the middle */
+	testProfRun(150);
+	__profTick();
+	testProfRun(100);
+	__systemEnterISR();
+	testProfRun(40);
+	__systemLeaveISR();
+	testProfRun(110);
+
+	/* A again, switching to the running thread is no switch */
+	testProfA.th_status = __THSTS_RUNNING;
+	__profSwitch(&testProfA);
+	__profSwitch(&testProfA);
+
+	TEST_CHECK(testProfA.th_switches == 2);
+	TEST_CHECK(testProfA.th_cycles == 500);
+
+	/* A runs 250, accounted by the tick before any switch */
+	testProfRun(250);
+	__profTick();
+
+	TEST_CHECK(testProfA.th_cycles == 750);
+
+	__profGetTotals(&hdr);
+
+	TEST_CHECK(hdr.ph_magic == __PROF_MAGIC);
+	TEST_CHECK(hdr.ph_hz == __cpuGetCyclesPerSecond());
+	TEST_CHECK(hdr.ph_idle == 360);
+	TEST_CHECK(hdr.ph_isr == 170);
+	TEST_CHECK(hdr.ph_isrcount == 2);
+	TEST_CHECK(hdr.ph_isrmax == 130);
+	TEST_CHECK(hdr.ph_switches == 4);
+	TEST_CHECK(testProfA.th_cycles + testProfB.th_cycles + hdr.ph_idle + hdr.ph_isr == 1450);
+
+	/* The counter wraps while A runs */
+	testProfRun(0xFFFFFF00 - __hostCycles);
+	__profTick();
+	cycles = testProfA.th_cycles;
+	testProfRun(0x300);
+	testProfA.th_status = __THSTS_SLEEPING;
+	__profSwitch(&testProfB);
+
+	TEST_CHECK(__hostCycles == 0x200);
+	TEST_CHECK(testProfA.th_cycles == cycles + 0x300);
+	TEST_CHECK(testProfA.th_preempts == 1);
+	TEST_CHECK(testProfB.th_switches == 2);
+}
+
+/*
+ * Longest critical section and count of each site.
+ */
+__STATIC __VOID testProfSections(__VOID)
+{
+	__PPROF_SITE ps = __profGetSites();
+
+	__profReset();
+
+	__profCsEnter(TEST_PROF_SITE_A);
+	testProfRun(700);
+	__profCsLeave();
+
+	__profCsEnter(TEST_PROF_SITE_B);
+	testProfRun(50);
+	__profCsLeave();
+
+	__profCsEnter(TEST_PROF_SITE_A);
+	testProfRun(300);
+	__profCsLeave();
+
+	/* Sleeping with interrupts disabled does not count */
+	__profCsEnter(TEST_PROF_SITE_B);
+	testProfRun(5000);
+	__profCsRestart();
+	testProfRun(80);
+	__profCsLeave();
+
+	TEST_CHECK(ps[0].ps_site == TEST_PROF_SITE_A);
+	TEST_CHECK(ps[0].ps_count == 2);
+	TEST_CHECK(ps[0].ps_max == 700);
+	TEST_CHECK(ps[1].ps_site == TEST_PROF_SITE_B);
+	TEST_CHECK(ps[1].ps_count == 2);
+	TEST_CHECK(ps[1].ps_max == 80);
+	TEST_CHECK(ps[2].ps_site == 0);
+}
+
+__VOID testProfile(__VOID)
+{
+	__PTHREAD self = __threadGetCurrent();
+
+	__systemStop();
+	__hostCyclesFake = __TRUE;
+
+	testProfThreads();
+	testProfSections();
+
+	/* Back to this thread and the host clock */
+	__profSwitch(self);
+	__hostCyclesFake = __FALSE;
+	__profCsRestart();
+
+	__systemStart();
+
+	/* The section above ended at a test site */
+	__profReset();
+}
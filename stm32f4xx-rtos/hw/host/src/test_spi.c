@@ -0,0 +1,214 @@
+/***************************************************************************
+ * test_spi.c
+ * (C) 2010 Ivan Meleca
+ * Based on original code written by Ruben Meleca
+ * www.milos.it
+
+
+#   This program is free software; you can redistribute it and/or modify
+#   it under the terms of the GNU General Public License as published by
+#   the Free Software Foundation; either version 2 of the License, or
+#   (at your option) any later version.
+#
+#   This program is distributed in the hope that it will be useful,
+#   but WITHOUT ANY WARRANTY; without even the implied warranty of
+#   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#   GNU General Public License for more details.
+#
+#   You should have received a copy of the GNU General Public License
+#   along with this program; if not, write to the Free Software
+#   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+***************************************************************************/
+
+
+#include <plat_cpu.h>
+#include <core/inc/device.h>
+#include <common/inc/mem.h>
+#include <drivers/inc/spi.h>
+#include <plat_spi.h>
+#include <test.h>
+
+/*
+ * SPI transfer engine (__spiTransfer()) on the loopback model of the host:
+ * data and chip-select of chained descriptors, completion order, transactions
+ * queued from the completion callbacks, the DMA error path, and the byte-wise
+ * path of __spiWrite() and __spiFlush().
+ */
+
+#define TEST_SPI_LEN			64			/* Bytes of each descriptor */
+#define TEST_SPI_CHAIN			1000		/* Descriptors queued from the callbacks */
+
+__STATIC __SPI_PDB testSpiPdb;
+__STATIC __EVENT testSpiEvents[2];
+__STATIC SPI_PARAMS testSpiParams = { 1 };
+__STATIC __DEVICE testSpiDevice = {
+	.dv_name = "tspi", .dv_type = __DEV_SPI, .dv_rxev = &testSpiEvents[0], .dv_txev = &testSpiEvents[1],
+	.dv_pdb = &testSpiPdb, .dv_params = &testSpiParams,
+	.dv_init = __spiInit, .dv_deinit = __spiDeinit, .dv_ioctl = __spiIOCtl,
+	.dv_open = __spiOpen, .dv_close = __spiClose, .dv_read = __spiRead,
+	.dv_write = __spiWrite, .dv_flush = __spiFlush, .dv_size = __spiSize,
+	.dv_plat_ioctl = __spiPlatIoCtl
+};
+
+__STATIC __SPI_XFER testSpiXf[4];
+__STATIC u8 testSpiTx[TEST_SPI_LEN];
+__STATIC u8 testSpiRx[3][TEST_SPI_LEN];
+__STATIC u32 testSpiOrder[TEST_SPI_CHAIN];
+__STATIC u32 testSpiDone;
+__STATIC u32 testSpiRequeue;
+__STATIC u32 testSpiDepth;
+__STATIC __BOOL testSpiNested;
+
+/*
+ * Records the completion order, by the index in \c xf_arg.
+ */
+__STATIC __VOID testSpiCallback(__PSPI_XFER xf)
+{
+	if (testSpiDone < TEST_SPI_CHAIN) testSpiOrder[testSpiDone] = (u32) xf->xf_arg;
+	testSpiDone++;
+}
+
+/*
+ * Queues the same descriptor again until \c testSpiRequeue transactions are
+ * done, from the DMA interrupt. A new transaction must start after the
+ * callback returns, not within it.
+ */
+__STATIC __VOID testSpiAgain(__PSPI_XFER xf)
+{
+	if (++testSpiDepth > 1) testSpiNested = __TRUE;
+	if (++testSpiDone < testSpiRequeue) __spiTransfer(&testSpiDevice, xf);
+	testSpiDepth--;
+}
+
+__STATIC __VOID testSpiReset(__VOID)
+{
+	u32 i;
+
+	__memSet(testSpiXf, 0, sizeof(testSpiXf));
+	__memSet(testSpiRx, 0, sizeof(testSpiRx));
+	for (i = 0; i < TEST_SPI_LEN; i++) testSpiTx[i] = (u8) (i * 7 + 1);
+	for (i = 0; i < 4; i++)
+	{
+		testSpiXf[i].xf_callback = testSpiCallback;
+		testSpiXf[i].xf_arg = (__PVOID) i;
+		testSpiXf[i].xf_len = TEST_SPI_LEN;
+	}
+	testSpiDone = 0;
+}
+
+__VOID testSpi(__VOID)
+{
+	SPI_PARAMS* params = &testSpiParams;
+	__SPI_PDB* pd = &testSpiPdb;
+	u8 buf[TEST_SPI_LEN];
+	u32 i, selects, xfers;
+	__BOOL ok;
+
+	__deviceAdd(&testSpiDevice, 1);
+	TEST_CHECK(__deviceInit(&testSpiDevice, __NULL, 0) == __DEV_OK);
+
+	/* No transfer engine in slave mode */
+	__deviceOpen(&testSpiDevice, __SPIMODE_SLAVE);
+	testSpiReset();
+	TEST_CHECK(pd->pd_dma == 0);
+	TEST_CHECK(__spiTransfer(&testSpiDevice, &testSpiXf[0]) == __DEV_ERROR);
+	__deviceClose(&testSpiDevice);
+
+	__deviceOpen(&testSpiDevice, __SPIMODE_MASTER);
+	TEST_CHECK(pd->pd_dma == 1);
+	TEST_CHECK(params->cs == __TRUE);
+
+	/* One descriptor, the received data is the data sent */
+	testSpiReset();
+	testSpiXf[0].xf_tx = testSpiTx;
+	testSpiXf[0].xf_rx = testSpiRx[0];
+	TEST_CHECK(__spiTransferWait(&testSpiDevice, &testSpiXf[0], 0) == __DEV_OK);
+	TEST_CHECK(testSpiXf[0].xf_status == __DEV_OK);
+	TEST_CHECK(memcmp(testSpiRx[0], testSpiTx, TEST_SPI_LEN) == 0);
+	TEST_CHECK(params->selects == 1 && params->xfers == 1 && params->irqs == 1);
+	TEST_CHECK(params->cs == __TRUE);
+	TEST_CHECK(pd->pd_xfhead == __NULL && pd->pd_xftail == __NULL && !pd->pd_xfrun);
+
+	/* Empty descriptors are refused, nothing is queued */
+	testSpiReset();
+	testSpiXf[0].xf_next = &testSpiXf[1];
+	testSpiXf[1].xf_len = 0;
+	TEST_CHECK(__spiTransfer(&testSpiDevice, &testSpiXf[0]) == __DEV_ERROR);
+	TEST_CHECK(testSpiDone == 0 && params->xfers == 1);
+
+	/*
+	 * A transaction of three descriptors under one chip-select: TX only,
+	 * RX only with 0xFF sent, and in place. Then a second transaction with no
+	 * chip-select.
+	 */
+	testSpiReset();
+	selects = params->selects;
+	xfers = params->xfers;
+	testSpiXf[0].xf_tx = testSpiTx;
+	testSpiXf[0].xf_next = &testSpiXf[1];
+	testSpiXf[1].xf_rx = testSpiRx[1];
+	testSpiXf[1].xf_next = &testSpiXf[2];
+	__memCpy(testSpiRx[2], testSpiTx, TEST_SPI_LEN);
+	testSpiXf[2].xf_tx = testSpiRx[2];
+	testSpiXf[2].xf_rx = testSpiRx[2];
+	testSpiXf[3].xf_tx = testSpiTx;
+	testSpiXf[3].xf_flags = __SPI_XF_NOCS;
+	TEST_CHECK(__spiTransfer(&testSpiDevice, &testSpiXf[0]) == __DEV_OK);
+	TEST_CHECK(__spiTransferWait(&testSpiDevice, &testSpiXf[3], 0) == __DEV_OK);
+	TEST_CHECK(testSpiDone == 4);
+	for (i = 0; i < 4; i++) TEST_CHECK(testSpiOrder[i] == i && testSpiXf[i].xf_status == __DEV_OK);
+	for (i = 0, ok = __TRUE; i < TEST_SPI_LEN; i++) ok &= (testSpiRx[1][i] == 0xFF);
+	TEST_CHECK(ok);
+	TEST_CHECK(memcmp(testSpiRx[2], testSpiTx, TEST_SPI_LEN) == 0);
+	TEST_CHECK(params->selects == selects + 1);
+	TEST_CHECK(params->xfers == xfers + 4);
+	TEST_CHECK(testSpiXf[2].xf_next == __NULL && testSpiXf[3].xf_next == __NULL);
+	TEST_CHECK((testSpiXf[0].xf_flags & __SPI_XF_START) && (testSpiXf[2].xf_flags & __SPI_XF_END));
+	TEST_CHECK(params->cs == __TRUE);
+
+	/* Queued again from the callbacks, served one after the other */
+	testSpiReset();
+	xfers = params->xfers;
+	testSpiRequeue = TEST_SPI_CHAIN;
+	testSpiNested = __FALSE;
+	testSpiXf[0].xf_callback = testSpiAgain;
+	testSpiXf[0].xf_tx = testSpiTx;
+	TEST_CHECK(__spiTransfer(&testSpiDevice, &testSpiXf[0]) == __DEV_OK);
+	TEST_CHECK(testSpiDone == TEST_SPI_CHAIN);
+	TEST_CHECK(params->xfers == xfers + TEST_SPI_CHAIN);
+	TEST_CHECK(!testSpiNested);
+	TEST_CHECK(pd->pd_xfhead == __NULL && !pd->pd_xfrun);
+
+	/* A DMA error skips the rest of the transaction, with the same status */
+	testSpiReset();
+	xfers = params->xfers;
+	testSpiXf[0].xf_next = &testSpiXf[1];
+	testSpiXf[1].xf_next = &testSpiXf[2];
+	params->error = 1;
+	TEST_CHECK(__spiTransferWait(&testSpiDevice, &testSpiXf[0], 0) == __DEV_ERROR);
+	params->error = 0;
+	for (i = 0; i < 3; i++) TEST_CHECK(testSpiXf[i].xf_status == __DEV_ERROR);
+	TEST_CHECK(testSpiDone == 3 && params->xfers == xfers + 1);
+	TEST_CHECK(params->cs == __TRUE);
+
+	/* The engine goes on after the error */
+	testSpiReset();
+	testSpiXf[0].xf_tx = testSpiTx;
+	testSpiXf[0].xf_rx = testSpiRx[0];
+	TEST_CHECK(__spiTransferWait(&testSpiDevice, &testSpiXf[0], 0) == __DEV_OK);
+	TEST_CHECK(memcmp(testSpiRx[0], testSpiTx, TEST_SPI_LEN) == 0);
+
+	/* Byte-wise path, the bytes written are read back */
+	selects = params->selects;
+	__deviceIOCtl(&testSpiDevice, __IOCTL_ASSERT_CS, 1, __NULL, 0);
+	TEST_CHECK(__deviceWrite(&testSpiDevice, testSpiTx, 20) == 20);
+	TEST_CHECK(__deviceFlush(&testSpiDevice) == __DEV_OK);
+	TEST_CHECK(__deviceSize(&testSpiDevice, __DEV_RXSIZE) == 20);
+	TEST_CHECK(__deviceRead(&testSpiDevice, buf, 20) == 20);
+	TEST_CHECK(memcmp(buf, testSpiTx, 20) == 0);
+	TEST_CHECK(params->selects == selects + 1 && params->cs == __TRUE);
+	TEST_CHECK(!pd->pd_fifo);
+
+	__deviceClose(&testSpiDevice);
+}
@@ -0,0 +1,165 @@
+/***************************************************************************
+ * test_stack.c
+ * (C) 2010 Ivan Meleca
+ * Based on original code written by Ruben Meleca
+ * www.milos.it
+
+
+#   This program is free software; you can redistribute it and/or modify
+#   it under the terms of the GNU General Public License as published by
+#   the Free Software Foundation; either version 2 of the License, or
+#   (at your option) any later version.
+#
+#   This program is distributed in the hope that it will be useful,
+#   but WITHOUT ANY WARRANTY; without even the implied warranty of
+#   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#   GNU General Public License for more details.
+#
+#   You should have received a copy of the GNU General Public License
+#   along with this program; if not, write to the Free Software
+#   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+***************************************************************************/
+
+#include <plat_cpu.h>
+#include <core/inc/system.h>
+#include <core/inc/thread.h>
+#include <core/inc/event.h>
+#include <test.h>
+
+/*
+ * Stack high-water marks (__CONFIG_STACK_CHECK). The simulator runs the
+ * threads on stacks of their own, so the painted stack of a thread is only
+ * written by the tests, standing for the deepest calls of the thread.
+ */
+
+#define TEST_STACK_PRIO			200			/* Below the test thread, the thread never runs before the end */
+#define TEST_STACK_SIZE			2048		/* Stack of the thread, bytes */
+#define TEST_STACK_PAINT		(__TH_STACKPAINT * 0x01010101UL)
+
+__STATIC __EVENT testStackNever;
+
+/*
+ * Thread whose stack is checked, it waits forever.
+ */
+__STATIC __VOID testStackThread(__VOID)
+{
+	__eventWait(&testStackNever, 0);
+}
+
+/*
+ * Runs enough __threadStackCheck() passes to check every stack twice, as
+ * the system thread would.
+ */
+__STATIC __VOID testStackRounds(__VOID)
+{
+	__PTHREAD th;
+	u32 words = 0, passes;
+
+	for (th = __threadGetChain(); th; th = (__PTHREAD) th->th_lstnext) words += th->th_stksize / sizeof(u32);
+	passes = 4 * (words / __CONFIG_STACK_CHECK_WORDS + __threadGetCount());
+
+	__systemDisableScheduler();
+	while (passes--) __threadStackCheck();
+	__systemEnableScheduler();
+}
+
+/*
+ * Bytes in use with the deepest written word at \c idx words from the bottom.
+ */
+__STATIC u32 testStackPeakAt(__PTHREAD th, u32 idx)
+{
+	return th->th_stksize - idx * sizeof(u32);
+}
+
+/*
+ * Suggested size for a peak use, as documented by __threadStackSuggest().
+ */
+__STATIC u32 testStackSuggestFor(u32 peak)
+{
+	u32 size = (peak + peak * __CONFIG_STACK_CHECK_MARGIN / 100 + 7) & ~7;
+
+	return (size < __TH_MINSTACKSIZE) ? __TH_MINSTACKSIZE : size;
+}
+
+__VOID testStack(__VOID)
+{
+	__PTHREAD th;
+	pu32 stk;
+	u32 words, passes, i, deep;
+
+	testStackNever.ev_state = __EV_RESET;
+	testStackNever.ev_threads = __NULL;
+	testStackNever.ev_links = __NULL;
+
+	th = __threadCreate("stk", testStackThread, TEST_STACK_PRIO, TEST_STACK_SIZE, 1, __NULL);
+	if (!TEST_CHECK(th != __NULL)) return;
+
+	stk = (pu32) th->th_stkptr;
+	words = th->th_stkfree;
+	TEST_CHECK(words > 0 && words <= TEST_STACK_SIZE / sizeof(u32));
+
+	/* Painted from the bottom up to the initial stack pointer, nothing used */
+	for (i = 0; i < words && stk[i] == TEST_STACK_PAINT; i++);
+	TEST_CHECK(i == words);
+	testStackRounds();
+	TEST_CHECK(th->th_stkfree == words);
+	TEST_CHECK(__threadStackPeak(th) == testStackPeakAt(th, words));
+	TEST_CHECK(__threadStackSuggest(th) == __TH_MINSTACKSIZE);
+
+	/* Shallow use: the suggestion doesn't go below the minimum */
+	stk[words - 10] = 0;
+	testStackRounds();
+	TEST_CHECK(__threadStackPeak(th) == testStackPeakAt(th, words - 10));
+	TEST_CHECK(__threadStackSuggest(th) == __TH_MINSTACKSIZE);
+
+	/* Sparse writes: a large local never written leaves painted words under
+	 * the written ones, the deepest written word is the mark.
+	 */
+	deep = words - 250;
+	stk[deep] = 0x12345678;
+	stk[deep + 40] = 0;
+	stk[deep + 41] = 1;
+	stk[deep + 200] = 2;
+	testStackRounds();
+	TEST_CHECK(th->th_stkfree == deep);
+	TEST_CHECK(__threadStackPeak(th) == testStackPeakAt(th, deep));
+	TEST_CHECK(__threadStackSuggest(th) == testStackSuggestFor(testStackPeakAt(th, deep)));
+
+	/* The peak never decreases: painted again, or used less deep */
+	stk[deep] = TEST_STACK_PAINT;
+	stk[deep + 40] = TEST_STACK_PAINT;
+	testStackRounds();
+	TEST_CHECK(__threadStackPeak(th) == testStackPeakAt(th, deep));
+	stk[deep + 100] = 3;
+	testStackRounds();
+	TEST_CHECK(__threadStackPeak(th) == testStackPeakAt(th, deep));
+
+	/* Budgeted passes: a mark just under the old one is found after checking
+	 * every word from the bottom, __CONFIG_STACK_CHECK_WORDS per pass for all
+	 * the threads, within two rounds.
+	 */
+	stk[deep - 1] = 4;
+	__systemDisableScheduler();
+	for (passes = 0; th->th_stkfree != deep - 1 && passes < 1000; passes++) __threadStackCheck();
+	__systemEnableScheduler();
+	TEST_CHECK(__threadStackPeak(th) == testStackPeakAt(th, deep - 1));
+	TEST_CHECK(passes > (deep - 1) / __CONFIG_STACK_CHECK_WORDS);
+	TEST_CHECK(passes <= 2 * (words / __CONFIG_STACK_CHECK_WORDS + 1) * __threadGetCount());
+
+	/* Full overflow: the bottom word written */
+	stk[0] = 0;
+	testStackRounds();
+	TEST_CHECK(th->th_stkfree == 0);
+	TEST_CHECK(__threadStackPeak(th) == TEST_STACK_SIZE);
+	TEST_CHECK(__threadStackSuggest(th) == testStackSuggestFor(TEST_STACK_SIZE));
+	TEST_CHECK(__threadStackSuggest(th) == TEST_STACK_SIZE + TEST_STACK_SIZE / 4);
+
+	/* Once full, nothing more to check */
+	stk[0] = TEST_STACK_PAINT;
+	testStackRounds();
+	TEST_CHECK(__threadStackPeak(th) == TEST_STACK_SIZE);
+
+	/* The host threads run on other stacks */
+	TEST_CHECK(__threadStackUsed(th) == 0);
+}
@@ -0,0 +1,266 @@
+/***************************************************************************
+ * test_terminal.c
+ * (C) 2010 Ivan Meleca
+ * Based on original code written by Ruben Meleca
+ * www.milos.it
+
+
+#   This program is free software; you can redistribute it and/or modify
+#   it under the terms of the GNU General Public License as published by
+#   the Free Software Foundation; either version 2 of the License, or
+#   (at your option) any later version.
+#
+#   This program is distributed in the hope that it will be useful,
+#   but WITHOUT ANY WARRANTY; without even the implied warranty of
+#   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#   GNU General Public License for more details.
+#
+#   You should have received a copy of the GNU General Public License
+#   along with this program; if not, write to the Free Software
+#   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+***************************************************************************/
+
+#include <plat_cpu.h>
+#include <core/inc/thread.h>
+#include <core/inc/event.h>
+#include <core/inc/device.h>
+#include <core/inc/terminal.h>
+#include <common/inc/mem.h>
+#include <common/inc/string.h>
+#include <test.h>
+
+/*
+ * Terminal line handling, through a running terminal: lines are typed into
+ * a loopback input device, and the echo goes to a capture device. Covers
+ * the split of a line into argv, the command lookup, and the TAB completion
+ * (a single match, the prefix shared by several commands, the listing of
+ * the commands, and no match).
+ */
+
+#define TEST_TERM_RING			256			/* Input buffer, power of two */
+#define TEST_TERM_OUT			512			/* Captured output */
+#define TEST_TERM_WAIT			1000		/* Milliseconds waiting for the prompt */
+
+__STATIC u8 testTermRing[TEST_TERM_RING];
+__STATIC u32 testTermHead;
+__STATIC u32 testTermTail;
+__STATIC __EVENT testTermRxEvent;
+
+__STATIC char testTermOut[TEST_TERM_OUT];
+__STATIC u32 testTermOutLen;
+
+__STATIC char testTermPrompt[] = "> ";
+
+/* The last command run, copied from the terminal */
+__STATIC u32 testTermRuns;
+__STATIC u8 testTermArgc;
+__STATIC char testTermArgv[__TERMINAL_MAXARGS][__TERMINAL_DEF_LINELEN];
+__STATIC char testTermParams[__TERMINAL_DEF_LINELEN];
+
+/*
+ * Input device, reads return the bytes typed.
+ */
+__STATIC i32 testTermInit(__PDEVICE dv, __PVOID params)
+{
+	return __DEV_OK;
+}
+
+__STATIC i32 testTermOpen(__PDEVICE dv, u32 param)
+{
+	return __DEV_OK;
+}
+
+__STATIC i32 testTermClose(__PDEVICE dv)
+{
+	return __DEV_OK;
+}
+
+__STATIC i32 testTermRead(__PDEVICE dv, __PVOID buf, u16 qty)
+{
+	pu8 p = buf;
+	u16 i;
+
+	if (qty > testTermHead - testTermTail) qty = testTermHead - testTermTail;
+	for (i = 0; i < qty; i++) p[i] = testTermRing[testTermTail++ & (TEST_TERM_RING - 1)];
+
+	return qty;
+}
+
+__STATIC i32 testTermSize(__PDEVICE dv, u8 mode)
+{
+	return (mode == __DEV_RXSIZE) ? (i32) (testTermHead - testTermTail) : 0;
+}
+
+/*
+ * Output device, keeps the bytes written as a string.
+ */
+__STATIC i32 testTermWrite(__PDEVICE dv, __CONST __PVOID buf, u16 qty)
+{
+	if (qty > TEST_TERM_OUT - 1 - testTermOutLen) qty = TEST_TERM_OUT - 1 - testTermOutLen;
+	__memCpy(testTermOut + testTermOutLen, buf, qty);
+	testTermOutLen += qty;
+	testTermOut[testTermOutLen] = 0;
+
+	return qty;
+}
+
+__STATIC i32 testTermFlush(__PDEVICE dv)
+{
+	return __DEV_OK;
+}
+
+__STATIC __DEVICE testTermIn = {
+	.dv_name = "tterm_in", .dv_init = testTermInit, .dv_open = testTermOpen, .dv_close = testTermClose,
+	.dv_read = testTermRead, .dv_size = testTermSize
+};
+
+__STATIC __DEVICE testTermOutput = {
+	.dv_name = "tterm_out", .dv_init = testTermInit, .dv_open = testTermOpen, .dv_close = testTermClose,
+	.dv_write = testTermWrite, .dv_flush = testTermFlush
+};
+
+/*
+ * Command function of every test command, copies the arguments.
+ */
+__STATIC __VOID testTermCommand(__PTERMINAL term, __PSTRING cmd, __PSTRING params)
+{
+	u8 i;
+
+	testTermRuns++;
+	testTermArgc = term->argc;
+	for (i = 0; i < term->argc; i++) __strCpy(testTermArgv[i], term->argv[i]);
+	__strCpy(testTermParams, params ? params : "");
+}
+
+/* Added out of order, the terminal sorts them */
+__STATIC __TERMINALCMD testTermCmds[] = {
+	{ "threads",	testTermCommand, __NULL },
+	{ "echo",		testTermCommand, __NULL },
+	{ "devices",	testTermCommand, __NULL },
+	{ "defrag",		testTermCommand, __NULL },
+	{ "dev",		testTermCommand, __NULL },
+	{ "arp",		testTermCommand, __NULL },
+};
+
+/*
+ * Waits for the prompt at the end of a line. The prompt written after a
+ * listing of commands follows the line typed, not an end of line.
+ */
+__STATIC __BOOL testTermWaitPrompt(__VOID)
+{
+	u32 i;
+
+	for (i = 0; i < TEST_TERM_WAIT; i++)
+	{
+		if (testTermOutLen >= 4 && strcmp(testTermOut + testTermOutLen - 4, "\r\n> ") == 0) return __TRUE;
+		__threadSleep(1);
+	}
+
+	return __FALSE;
+}
+
+/*
+ * Types a line, waits for the terminal to handle it, and compares the
+ * output with \c echo. Returns the commands run.
+ */
+__STATIC u32 testTermLine(__CONST char* line, __CONST char* echo)
+{
+	u32 runs = testTermRuns;
+
+	testTermOutLen = 0;
+	testTermOut[0] = 0;
+	testTermArgc = 0;
+
+	while (*line) testTermRing[testTermHead++ & (TEST_TERM_RING - 1)] = *line++;
+	__eventSet(&testTermRxEvent);
+
+	TEST_CHECK(testTermWaitPrompt());
+	TEST_CHECK(strcmp(testTermOut, echo) == 0);
+
+	return testTermRuns - runs;
+}
+
+__VOID testTerminal(__VOID)
+{
+	__PTERMINAL term;
+
+	testTermRxEvent.ev_state = __EV_RESET;
+	testTermRxEvent.ev_threads = __NULL;
+	testTermRxEvent.ev_links = __NULL;
+	testTermIn.dv_rxev = &testTermRxEvent;
+
+	__deviceAdd(&testTermIn, 1);
+	__deviceAdd(&testTermOutput, 1);
+	__deviceInit(&testTermIn, __NULL, 0);
+	__deviceInit(&testTermOutput, __NULL, 0);
+	__deviceOpen(&testTermIn, 0);
+	__deviceOpen(&testTermOutput, 0);
+
+	term = __terminalCreate("tterm", &testTermIn, &testTermOutput, 0, testTermPrompt, __TERMINAL_ECHO_ENABLED);
+	if (!TEST_CHECK(term != __NULL)) return;
+
+	__terminalAddCommand(term, testTermCmds, sizeof(testTermCmds) / sizeof(__TERMINALCMD));
+	TEST_CHECK(__terminalStart(term));
+
+	/* The banner */
+	TEST_CHECK(testTermWaitPrompt());
+
+	/* Split at runs of spaces */
+	TEST_CHECK(testTermLine("echo  a   b c\r", "echo  a   b c\r\n> ") == 1);
+	TEST_CHECK(testTermArgc == 4);
+	TEST_CHECK(strcmp(testTermArgv[0], "echo") == 0);
+	TEST_CHECK(strcmp(testTermArgv[1], "a") == 0);
+	TEST_CHECK(strcmp(testTermArgv[2], "b") == 0);
+	TEST_CHECK(strcmp(testTermArgv[3], "c") == 0);
+	TEST_CHECK(strcmp(testTermParams, "  a   b c") == 0);
+
+	/* Leading and trailing spaces */
+	TEST_CHECK(testTermLine("  echo   x \r", "  echo   x \r\n> ") == 1);
+	TEST_CHECK(testTermArgc == 2);
+	TEST_CHECK(strcmp(testTermArgv[0], "echo") == 0);
+	TEST_CHECK(strcmp(testTermArgv[1], "x") == 0);
+	TEST_CHECK(strcmp(testTermParams, "   x ") == 0);
+
+	/* The last argument takes the rest of the line */
+	TEST_CHECK(testTermLine("echo 1 2 3 4 5 6 7  8 9\r", "echo 1 2 3 4 5 6 7  8 9\r\n> ") == 1);
+	TEST_CHECK(testTermArgc == __TERMINAL_MAXARGS);
+	TEST_CHECK(strcmp(testTermArgv[1], "1") == 0);
+	TEST_CHECK(strcmp(testTermArgv[6], "6") == 0);
+	TEST_CHECK(strcmp(testTermArgv[7], "7  8 9") == 0);
+
+	/* Empty and blank lines run nothing */
+	TEST_CHECK(testTermLine("\r", "\r\n> ") == 0);
+	TEST_CHECK(testTermLine("    \r", "    \r\n> ") == 0);
+
+	/* Exact name, not a longer one sharing it */
+	TEST_CHECK(testTermLine("dev\r", "dev\r\n> ") == 1);
+	TEST_CHECK(testTermArgc == 1 && strcmp(testTermArgv[0], "dev") == 0);
+
+	/* Unknown command */
+	TEST_CHECK(testTermLine("de\r", "de\r\nUnknown Command\r\n\r\n> ") == 0);
+
+	/* Single match: completed, and a space added */
+	TEST_CHECK(testTermLine("thr\t\r", "threads \r\n> ") == 1);
+	TEST_CHECK(testTermArgc == 1 && strcmp(testTermArgv[0], "threads") == 0);
+	TEST_CHECK(testTermLine("a\tall\r", "arp all\r\n> ") == 1);
+	TEST_CHECK(testTermArgc == 2 && strcmp(testTermArgv[0], "arp") == 0 && strcmp(testTermArgv[1], "all") == 0);
+
+	/* Full name typed: nothing added */
+	TEST_CHECK(testTermLine("echo\t\r", "echo\r\n> ") == 1);
+
+	/* Several matches: the shared prefix is added */
+	TEST_CHECK(testTermLine("d\tfrag\r", "defrag\r\n> ") == 1);
+	TEST_CHECK(testTermArgc == 1 && strcmp(testTermArgv[0], "defrag") == 0);
+
+	/* Nothing to add: the matches are listed, and the line written again */
+	TEST_CHECK(testTermLine("dev\tices x\r", "dev\r\ndev  devices  \r\n> devices x\r\n> ") == 1);
+	TEST_CHECK(testTermArgc == 2 && strcmp(testTermArgv[0], "devices") == 0 && strcmp(testTermArgv[1], "x") == 0);
+
+	/* No match */
+	TEST_CHECK(testTermLine("zz\t\r", "zz\r\nUnknown Command\r\n\r\n> ") == 0);
+
+	/* Only the command is completed */
+	TEST_CHECK(testTermLine("echo t\t\r", "echo t\r\n> ") == 1);
+	TEST_CHECK(testTermArgc == 2 && strcmp(testTermArgv[1], "t") == 0);
+}
@@ -0,0 +1,196 @@
+/***************************************************************************
+ * test_work.c
+ * (C) 2010 Ivan Meleca
+ * Based on original code written by Ruben Meleca
+ * www.milos.it
+
+
+#   This program is free software; you can redistribute it and/or modify
+#   it under the terms of the GNU General Public License as published by
+#   the Free Software Foundation; either version 2 of the License, or
+#   (at your option) any later version.
+#
+#   This program is distributed in the hope that it will be useful,
+#   but WITHOUT ANY WARRANTY; without even the implied warranty of
+#   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#   GNU General Public License for more details.
+#
+#   You should have received a copy of the GNU General Public License
+#   along with this program; if not, write to the Free Software
+#   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+***************************************************************************/
+
+#include <plat_cpu.h>
+#include <core/inc/system.h>
+#include <core/inc/thread.h>
+#include <core/inc/work.h>
+#include <test.h>
+
+/*
+ * Work queue served by a thread of higher priority than the test thread:
+ * the items of one batch (submitted with the scheduler disabled) are called
+ * in submission order, an item submitted again while pending is called
+ * once, an item submitting itself again is called after the rest of its
+ * batch. Then the delayed items: the delay, the timer stopped once expired
+ * and used again, a delay started again, a cancelled delay.
+ */
+
+#define TEST_WORK_PRIO			5			/* Worker priority, above the test thread */
+#define TEST_WORK_STACK			512
+#define TEST_WORK_BATCH			8			/* Items submitted at once */
+#define TEST_WORK_CALLS			32			/* Calls recorded at most */
+#define TEST_WORK_DELAY			30			/* Delay of the delayed item, in ticks */
+#define TEST_WORK_LATE			20			/* Ticks the delayed item can be late */
+
+__STATIC __PWORKQUEUE testWorkQueue;
+__STATIC __WORK testWorkItems[TEST_WORK_BATCH];
+__STATIC __DELAYED_WORK testWorkDelayed;
+
+__STATIC u32 testWorkCalls[TEST_WORK_CALLS];	/* Arguments of the calls, in order */
+__STATIC __VOLATILE u32 testWorkCount;
+__STATIC __VOLATILE u32 testWorkAgain;			/* Times the item submits itself */
+__STATIC __VOLATILE u32 testWorkStillPending;	/* Items called while pending */
+__STATIC __VOLATILE u32 testWorkTick;			/* Tick of the last delayed call */
+
+/*
+ * Records the call, submits the item again while testWorkAgain.
+ */
+__STATIC __VOID testWorkFunc(__PVOID arg)
+{
+	u32 i = (u32) arg;
+
+	if (testWorkCount < TEST_WORK_CALLS) testWorkCalls[testWorkCount] = i;
+	testWorkCount++;
+
+	if (__workIsPending(&testWorkItems[i])) testWorkStillPending++;
+
+	if (i == 0 && testWorkAgain)
+	{
+		testWorkAgain--;
+		if (!__workSubmit(testWorkQueue, &testWorkItems[i])) testWorkStillPending++;
+	}
+}
+
+__STATIC __VOID testWorkDelayedFunc(__PVOID arg)
+{
+	testWorkTick = __systemGetTickCount();
+	testWorkCount++;
+}
+
+/*
+ * Submission order, pending items and items submitting themselves.
+ */
+__STATIC __VOID testWorkBatch(__VOID)
+{
+	u32 i;
+
+	for (i = 0; i < TEST_WORK_BATCH; i++) __workPrepare(&testWorkItems[i], testWorkFunc, (__PVOID) i);
+
+	/* One batch, the third item submitted twice */
+	testWorkCount = 0;
+	__systemDisableScheduler();
+
+	for (i = 0; i < TEST_WORK_BATCH; i++)
+	{
+		TEST_CHECK(__workSubmit(testWorkQueue, &testWorkItems[i]));
+		if (i == 2) TEST_CHECK(!__workSubmit(testWorkQueue, &testWorkItems[i]));
+	}
+
+	TEST_CHECK(testWorkCount == 0);
+	TEST_CHECK(__workIsPending(&testWorkItems[2]));
+	__systemEnableScheduler();
+
+	TEST_CHECK(testWorkCount == TEST_WORK_BATCH);
+	for (i = 0; i < TEST_WORK_BATCH; i++) TEST_CHECK(testWorkCalls[i] == i);
+	TEST_CHECK(testWorkQueue->wq_runs == TEST_WORK_BATCH);
+	TEST_CHECK(testWorkQueue->wq_batch == TEST_WORK_BATCH);
+
+	/* The first item submits itself twice: called after the second one, then alone */
+	testWorkCount = 0;
+	testWorkAgain = 2;
+	__systemDisableScheduler();
+	TEST_CHECK(__workSubmit(testWorkQueue, &testWorkItems[0]));
+	TEST_CHECK(__workSubmit(testWorkQueue, &testWorkItems[1]));
+	__systemEnableScheduler();
+
+	TEST_CHECK(testWorkCount == 4);
+	TEST_CHECK(testWorkCalls[0] == 0);
+	TEST_CHECK(testWorkCalls[1] == 1);
+	TEST_CHECK(testWorkCalls[2] == 0);
+	TEST_CHECK(testWorkCalls[3] == 0);
+
+	for (i = 0; i < TEST_WORK_BATCH; i++) TEST_CHECK(!__workIsPending(&testWorkItems[i]));
+	TEST_CHECK(testWorkStillPending == 0);
+}
+
+/*
+ * Delayed items.
+ */
+__STATIC __VOID testWorkDelays(__VOID)
+{
+	__PTIMER timer;
+	u32 start;
+
+	__workPrepareDelayed(&testWorkDelayed, testWorkDelayedFunc, __NULL);
+	testWorkCount = 0;
+
+	/* Called once after the delay, the timer stops */
+	start = __systemGetTickCount();
+	TEST_CHECK(__workSubmitDelayed(testWorkQueue, &testWorkDelayed, TEST_WORK_DELAY));
+	__threadSleep(TEST_WORK_DELAY / 2);
+	TEST_CHECK(testWorkCount == 0);
+	__threadSleep(TEST_WORK_DELAY + TEST_WORK_LATE);
+	TEST_CHECK(testWorkCount == 1);
+	TEST_CHECK(testWorkTick - start >= TEST_WORK_DELAY);
+	TEST_CHECK(testWorkTick - start <= TEST_WORK_DELAY + TEST_WORK_LATE);
+	__threadSleep(TEST_WORK_DELAY * 3);
+	TEST_CHECK(testWorkCount == 1);
+
+	/* The stopped timer serves the next delay */
+	timer = testWorkDelayed.dw_timer;
+	TEST_CHECK(timer != __NULL);
+	TEST_CHECK(__workSubmitDelayed(testWorkQueue, &testWorkDelayed, TEST_WORK_DELAY));
+	TEST_CHECK(testWorkDelayed.dw_timer == timer);
+	__threadSleep(TEST_WORK_DELAY * 2 + TEST_WORK_LATE);
+	TEST_CHECK(testWorkCount == 2);
+
+	/* Submitted again before expiring, the delay starts again */
+	TEST_CHECK(__workSubmitDelayed(testWorkQueue, &testWorkDelayed, TEST_WORK_DELAY));
+	__threadSleep(TEST_WORK_DELAY / 2);
+	start = __systemGetTickCount();
+	TEST_CHECK(__workSubmitDelayed(testWorkQueue, &testWorkDelayed, TEST_WORK_DELAY));
+	__threadSleep(TEST_WORK_DELAY * 3 / 4);
+	TEST_CHECK(testWorkCount == 2);
+	__threadSleep(TEST_WORK_DELAY + TEST_WORK_LATE);
+	TEST_CHECK(testWorkCount == 3);
+	TEST_CHECK(testWorkTick - start >= TEST_WORK_DELAY);
+
+	/* Cancelled, never called */
+	TEST_CHECK(__workSubmitDelayed(testWorkQueue, &testWorkDelayed, TEST_WORK_DELAY));
+	__threadSleep(TEST_WORK_DELAY / 2);
+	TEST_CHECK(__workCancelDelayed(&testWorkDelayed));
+	__threadSleep(TEST_WORK_DELAY * 2);
+	TEST_CHECK(testWorkCount == 3);
+
+	/* No delay, called at once by the higher priority worker */
+	TEST_CHECK(__workSubmitDelayed(testWorkQueue, &testWorkDelayed, 0));
+	TEST_CHECK(testWorkCount == 4);
+
+	__workDestroyDelayed(&testWorkDelayed);
+	TEST_CHECK(testWorkDelayed.dw_timer == __NULL);
+	TEST_CHECK(!__workCancelDelayed(&testWorkDelayed));
+}
+
+__VOID testWork(__VOID)
+{
+	testWorkQueue = __workQueueCreate("testwq", TEST_WORK_PRIO, TEST_WORK_STACK);
+	TEST_CHECK(testWorkQueue != __NULL);
+	if (!testWorkQueue) return;
+
+	/* The worker starts waiting for items */
+	__threadSleep(1);
+
+	testWorkBatch();
+	testWorkDelays();
+}
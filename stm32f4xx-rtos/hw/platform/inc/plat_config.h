@@ -66,6 +66,9 @@
 /*! @brief Platform implementation will provide the interrupt source */
 #define __PLATCONFIG_GET_IRQ_SOURCE			1
 
+/*! @brief Platform implementation provides __cpuDmaMemCpy(), on BOARD_MEMCPY_DMA */
+#define __PLATCONFIG_DMA_MEMCPY				1
+
 /**
   * @}
   */
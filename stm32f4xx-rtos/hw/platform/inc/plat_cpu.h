@@ -33,6 +33,7 @@
 #include "plat_config.h"
 #include "plat_ostypes.h"
 #include "plat_comp_dep.h"
+#include <stm32f4xx_dma.h>
 #include <stm32f4xx_gpio.h>
 #include <stm32f4xx_flash.h>
 #include <stm32f4xx_i2c.h>
@@ -70,6 +71,67 @@
  */
 #define __cpuEnableInterrupts()			__pcd_EnableIRQs()
 
+/*!
+ * @brief Counts the leading zero bits of a 32 bit value (32 if zero).
+ *
+ * Used by the scheduler to find the highest priority ready thread.
+ *
+ * @return The number of leading zeros.
+ */
+#define __cpuCountLeadingZeros(x)		__CLZ(x)
+
+/*!
+ * @brief Sleeps until an interrupt is pending, even if interrupts are disabled.
+ *
+ * @return Nothing.
+ */
+#define __cpuWaitForInterrupt()			__WFI()
+
+/*!
+ * @brief Loads a word and marks its address for exclusive access.
+ *
+ * @return The value read.
+ */
+#define __cpuLoadExclusive(p)			__LDREXW((__VOLATILE u32*) (p))
+
+/*!
+ * @brief Stores a word if the exclusive access marked by
+ * __cpuLoadExclusive() was not lost (interrupt, or another exclusive access).
+ *
+ * @return Zero if the value was stored, otherwise 1.
+ */
+#define __cpuStoreExclusive(v, p)		__STREXW((v), (__VOLATILE u32*) (p))
+
+/*!
+ * @brief Drops the exclusive access marked by __cpuLoadExclusive().
+ *
+ * @return Nothing.
+ */
+#define __cpuClearExclusive()			__CLREX()
+
+/*!
+ * @brief Completes the memory accesses before the barrier before starting
+ * the ones after it.
+ *
+ * @return Nothing.
+ */
+#define __cpuMemoryBarrier()			__DMB()
+
+/*!
+ * @brief Reads the free running CPU cycle counter (DWT CYCCNT), started by
+ * __cpuInitCycleCounter().
+ *
+ * @return The cycle count, wraps at 32 bits.
+ */
+#define __cpuGetCycles()				(__CPU_DWT_CYCCNT)
+
+/*!
+ * @brief Frequency of the __cpuGetCycles() counter.
+ *
+ * @return Cycles per second.
+ */
+#define __cpuGetCyclesPerSecond()		(SystemCoreClock)
+
 /*!
  * @brief OS in entering IDLE mode.
  *
@@ -111,6 +173,21 @@
 #define __chksum_16bit_value(ptr) (u16) ( ((u16) *ptr << 8) | *(ptr + 1) )
 #define __chksum_8bit_value(ptr) (u16) ( ((u16) *ptr << 8) )
 
+/*
+ * DWT registers, not defined by the CMSIS version in use.
+ */
+#define __CPU_DWT_CTRL			(*(__VOLATILE u32*) 0xE0001000)	/*!< @brief DWT control register */
+#define __CPU_DWT_CYCCNT		(*(__VOLATILE u32*) 0xE0001004)	/*!< @brief DWT cycle counter */
+#define __CPU_DWT_CYCCNTENA		0x00000001						/*!< @brief Cycle counter enable bit */
+
+/*
+ * DMA stream interrupt flags, see __cpuDmaGetFlags().
+ */
+#define __CPU_DMA_TE	0x08		/*!< @brief Transfer error */
+#define __CPU_DMA_HT	0x10		/*!< @brief Half transfer */
+#define __CPU_DMA_TC	0x20		/*!< @brief Transfer complete */
+#define __CPU_DMA_ALL	0x3D		/*!< @brief All flags, including FIFO and direct mode errors */
+
 /*
  * Mandatory.
  */
@@ -129,12 +206,34 @@ __VOID __cpuStartWatchdog(__VOID);
 __VOID __cpuResetWatchdog(__VOID);
 __VOID __cpuDelayMs(u32 ms);
 
+/*
+ * Tickless idle, see __CONFIG_TICKLESS_IDLE.
+ */
+#if __CONFIG_TICKLESS_IDLE
+u32 __cpuTicklessMaxTicks(__VOID);
+__VOID __cpuTicklessEnter(u32 ticks);
+u32 __cpuTicklessLeave(__VOID);
+#endif /* __CONFIG_TICKLESS_IDLE */
+
+/*
+ * Stack guard region, see __CONFIG_STACK_GUARD.
+ */
+#if __CONFIG_STACK_GUARD
+__VOID __cpuStackGuard(u32 addr);
+#endif /* __CONFIG_STACK_GUARD */
+
 /*
  * Optional.
  */
 __VOID __cpuHeartBeat(__VOID);
 __VOID __cpuPinConfigure(u32 pin, GPIO_TypeDef* port, GPIOSpeed_TypeDef speed, GPIOMode_TypeDef mode, GPIOOType_TypeDef outmode, GPIOPuPd_TypeDef pupd);
 __BOOL __cpuGetInterruptSource(u32* irq);
+__VOID __cpuDmaEnableClock(DMA_Stream_TypeDef* stream);
+u32 __cpuDmaGetFlags(DMA_Stream_TypeDef* stream);
+#if __PLATCONFIG_DMA_MEMCPY
+__BOOL __cpuDmaMemCpy(__PVOID dst, __CONST __PVOID src, u32 qty, __VOID (*done)(__PVOID), __PVOID arg);
+#endif /* __PLATCONFIG_DMA_MEMCPY */
+__VOID __cpuInitCycleCounter(__VOID);
 
 /*
  * Basic support for the IO module.
@@ -42,18 +42,6 @@
   * @{
   */
 
-/** @defgroup I2C_Stm32_Modes Mode
-  * @{
-  */
-
-#define __PLATI2C_MODE_INTERRUPTS	1	/*!< @brief If 1, the driver will work with interrupts,
-													otherwise polling mode will be used. */
-
-/**
-  * @}
-  */
-
-
 /** @defgroup I2C_Stm32_DefaultDefines Default values
   *
   * If the parameter \c params if left to __NULL When calling __deviceInit()
@@ -90,8 +78,11 @@ typedef struct {
 	u32				bus_clock_addr;		/*!< @brief I2C bus clock address */
 	u8				apb_bus_num;		/*!< @brief I2C APB bus number */
 	u32				default_speed;		/*!< @brief I2C default speed */
-	u8				rxstep;				/*!< @brief Used to manage RX steps */
-	u8				subaddr_cnt;		/*!< @brief Counter of the sub-address bits sent */
+	u8				er_irq;				/*!< @brief Error interrupt */
+	DMA_Stream_TypeDef*	rx_dma;			/*!< @brief RX DMA stream, __NULL to read by interrupts */
+	DMA_Stream_TypeDef*	tx_dma;			/*!< @brief TX DMA stream, __NULL to write by interrupts */
+	u32				dma_channel;		/*!< @brief DMA channel of both streams */
+	u8				rx_dma_irq;			/*!< @brief RX DMA stream interrupt */
 } I2C_PARAMS, *PI2C_PARAMS;
 
 /**
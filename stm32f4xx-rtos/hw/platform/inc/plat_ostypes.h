@@ -40,6 +40,7 @@
 typedef	char					i8;			/*!< @brief 8 bits signed char */
 typedef	short					i16;		/*!< @brief 16 bits signed int */
 typedef	signed int				i32;		/*!< @brief 32 bits signed int */
+typedef	unsigned long long		u64;		/*!< @brief 64 bits unsigned int */
 typedef	unsigned char			__BOOL;		/*!< @brief Boolean for function return */
 typedef float					flt32;		/*!< @brief 32 bits float value */
 typedef double					flt64;		/*!< @brief 64 bits float value */
@@ -87,6 +87,11 @@ typedef struct {
 	u32				cpol;
 	u32				cpha;
 	u32				nss_mode;
+	DMA_Stream_TypeDef*	rx_dma;		/*!< @brief RX DMA stream (i.e. DMA2_Stream0). __NULL disables __spiTransfer() */
+	DMA_Stream_TypeDef*	tx_dma;		/*!< @brief TX DMA stream (i.e. DMA2_Stream3) */
+	u32				dma_channel;	/*!< @brief DMA channel of both streams (i.e. DMA_Channel_3) */
+	u8				rx_dma_irq;		/*!< @brief RX DMA stream interrupt number */
+	u8				tx_dma_irq;		/*!< @brief TX DMA stream interrupt number */
 
 } SPI_PARAMS, *PSPI_PARAMS;
 
@@ -80,8 +80,37 @@ typedef struct {
 	u8				apb_bus_num;		/*!< @brief APB bus number (i.e. 1) */
 	u32				remap_value;		/*!< @brief Remap value (i.e. GPIO_Remap_USART1).
 													Can be zero (no remap) */
+	DMA_Stream_TypeDef*	rx_dma;			/*!< @brief RX DMA stream (i.e. DMA2_Stream2).
+													__NULL to receive one byte per interrupt */
+	DMA_Stream_TypeDef*	tx_dma;			/*!< @brief TX DMA stream (i.e. DMA2_Stream7).
+													__NULL to transmit one byte per interrupt */
+	u32				dma_channel;		/*!< @brief DMA channel of both streams (i.e. DMA_Channel_4) */
+	u8				rx_dma_irq;			/*!< @brief RX DMA stream interrupt number */
+	u8				tx_dma_irq;			/*!< @brief TX DMA stream interrupt number */
 } UART_PARAMS, *PUART_PARAMS;
 
+/**
+  * @}
+  */
+
+/** @defgroup Serial_Stm32_Dma DMA mode
+  *
+  * When the \c rx_dma member of UART_PARAMS is set, the RX buffer of the
+  * Serial driver is the target of a circular DMA transfer. The received
+  * bytes are accounted in blocks on the USART IDLE-line interrupt (end of
+  * a frame) and on the DMA half and full transfer interrupts, so the
+  * reader is woken up once per frame instead of once per byte. The RX
+  * buffer length should be at least twice the longest expected frame.
+  *
+  * When the \c tx_dma member is set, __serialFlush() starts a DMA transfer
+  * of the contiguous unsent bytes of the TX buffer. The DMA transfer
+  * complete interrupt chains the bytes left after the buffer wrap and
+  * those written in the meantime.
+  *
+  * Both streams must use the same channel (\c dma_channel).
+  * @{
+  */
+
 /**
   * @}
   */
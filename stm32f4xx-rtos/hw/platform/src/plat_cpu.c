@@ -23,6 +23,7 @@
 #include "plat_cpu.h"
 #include <core/inc/thread.h>
 #include <core/inc/system.h>
+#include <core/inc/intrvect.h>
 #include <common/inc/io.h>
 
 extern __VOID __boardInitHW(__VOID);
@@ -43,6 +44,12 @@ extern __VOID __boardInitHW(__VOID);
 #define DBGMCU_APB1_FZ			(DBGMCU_CR + 0x04)	/*!< @brief Address of Debug MCU - See RM0090- Reference manual@page 1296, stm32f4xx_dbgmcu.h */
 #define DBGMCU_APB2_FZ			(DBGMCU_CR + 0x08)	/*!< @brief Address of Debug MCU - See RM0090- Reference manual@page 1296, stm32f4xx_dbgmcu.h */
 #define SYSTICK_RELOAD			(SystemCoreClock / 1000)
+#define MPU_GUARD_REGION		7					/*!< @brief MPU region of the stack guard (__CONFIG_STACK_GUARD), the highest has priority */
+#define MPU_RASR_XN				(1UL << 28)			/*!< @brief Region attributes: execute never, no access (AP = 0) - See PM0214 programming manual @page 190 */
+
+#if __CONFIG_TICKLESS_IDLE
+__STATIC u32 __cpuTicklessPhase;			/*!< @brief Cycles of the current tick elapsed on __cpuTicklessEnter() */
+#endif /* __CONFIG_TICKLESS_IDLE */
 
 /** @defgroup PlatformFunctions Functions
   * @{
@@ -84,6 +91,8 @@ __STATIC __VOID __cpuInitSVCPendingInterrupt(__VOID)
  * of the thread is in the right place on the stack. For example, when using the
  * STM32, this function reorders the stack having in mind the way the CortexM3
  * restores the registers (in a particular order) when returning from an ISR.
+ * Threads start without FPU context (EXC_RETURN 0xFFFFFFFD), the first FPU
+ * instruction they execute makes the context switch save S16-S31 too.
  * Called from __threadCreate().
  *
  * @param	stkptr	Stack pointer start address.
@@ -105,6 +114,7 @@ u32 __cpuMakeStackFrame(u32 stkptr, __PVOID *func, __PVOID param)
 	*(--stk)	= (u32)0x00000001L; 	/* R1 */
 	*(--stk) 	= (u32)0;				/* R0 */
 	 
+	*(--stk) = (u32)0xFFFFFFFDL;	/* EXC_RETURN: thread mode, process stack, no FPU frame */
 	*(--stk) = (u32)0x00000011L; 	/* R11 */
 	*(--stk) = (u32)0x00000010L; 	/* R10 */
 	*(--stk) = (u32)0x00000009L; 	/* R9 */
@@ -134,6 +144,10 @@ __VOID __cpuInitInterrupts(__VOID)
 	NVIC_SetVectorTable(NVIC_VectTab_FLASH, 0x0);   
 #endif
 
+	/* Automatic and lazy FPU state stacking, required by __pcd_PendSVHandler
+	 * (reset values, set again in case the startup code changed them) */
+	FPU->FPCCR |= FPU_FPCCR_ASPEN_Msk | FPU_FPCCR_LSPEN_Msk;
+
 	/* Init SVCPend Interrupt */
 	__cpuInitSVCPendingInterrupt();	
 }
@@ -150,6 +164,83 @@ __VOID __cpuSetTimerSYSTICK(__VOID)
 	SysTick_Config(SYSTICK_RELOAD);
 }
 
+#if __CONFIG_TICKLESS_IDLE
+
+/*!
+ * @brief Maximum ticks the SYSTICK timer can be stretched to.
+ *
+ * The SYSTICK reload register is 24 bits wide (about 99 ticks at 168 MHz).
+ *
+ * @return The maximum ticks for __cpuTicklessEnter().
+ */
+u32 __cpuTicklessMaxTicks(__VOID)
+{
+	return SysTick_LOAD_RELOAD_Msk / SYSTICK_RELOAD;
+}
+
+/*!
+ * @brief Stretches the SYSTICK period up to the given tick boundary.
+ *
+ * Called from __systemIdle() with interrupts disabled. The SYSTICK interrupt
+ * will arrive after \c ticks tick boundaries, keeping the phase of the
+ * current tick.
+ *
+ * @param ticks	Ticks to sleep, from 2 to __cpuTicklessMaxTicks().
+ * @return Nothing.
+ */
+__VOID __cpuTicklessEnter(u32 ticks)
+{
+	u32 val;
+
+	SysTick->CTRL &= ~SysTick_CTRL_ENABLE_Msk;
+	val = SysTick->VAL;
+	__cpuTicklessPhase = SYSTICK_RELOAD - val;
+
+	SysTick->LOAD = val + ((ticks - 1) * SYSTICK_RELOAD) - 1;
+	SysTick->VAL = 0;
+	SysTick->CTRL |= SysTick_CTRL_ENABLE_Msk;
+}
+
+/*!
+ * @brief Restores the SYSTICK period after __cpuTicklessEnter().
+ *
+ * Called from __systemIdle() with interrupts disabled, when the CPU is waked
+ * up by the SYSTICK or by any other interrupt. The next SYSTICK interrupt is
+ * programmed on the next tick boundary.
+ *
+ * @return The whole ticks elapsed that the SYSTICK interrupt will not account.
+ */
+u32 __cpuTicklessLeave(__VOID)
+{
+	u32 ctrl, load, done, ticks, rest;
+
+	/* Reading CTRL clears COUNTFLAG, so read it once */
+	ctrl = SysTick->CTRL;
+	SysTick->CTRL = ctrl & ~SysTick_CTRL_ENABLE_Msk;
+
+	/* Cycles elapsed from the last tick boundary before sleeping */
+	load = SysTick->LOAD + 1;
+	done = __cpuTicklessPhase + (load - SysTick->VAL);
+	if (ctrl & SysTick_CTRL_COUNTFLAG_Msk) done += load;
+
+	ticks = done / SYSTICK_RELOAD;
+	rest = SYSTICK_RELOAD - (done % SYSTICK_RELOAD);
+	if (rest < 2) rest = 2;
+
+	/* Run up to the next tick boundary, then reload the normal period */
+	SysTick->LOAD = rest - 1;
+	SysTick->VAL = 0;
+	SysTick->CTRL |= SysTick_CTRL_ENABLE_Msk;
+	SysTick->LOAD = SYSTICK_RELOAD - 1;
+
+	/* On expiration the pending SYSTICK interrupt accounts for one tick */
+	if (ctrl & SysTick_CTRL_COUNTFLAG_Msk) ticks--;
+
+	return ticks;
+}
+
+#endif /* __CONFIG_TICKLESS_IDLE */
+
 /*!
  * @brief Initializes platform optional timers.
  *
@@ -334,12 +425,58 @@ u32 __cpuStackFramePointer(pu8 stkptr, u32 stack)
 /*!
  * @brief Starts memory manager, if any.
  *
+ * With __CONFIG_STACK_GUARD, enables the MPU (the default memory map stays
+ * accessible) and the memory management fault.
+ *
  * @return Nothing.
  */
 __VOID	__cpuStartMMU(__VOID)
 {
+#if __CONFIG_STACK_GUARD
+	MPU->CTRL = MPU_CTRL_PRIVDEFENA_Msk | MPU_CTRL_ENABLE_Msk;
+	SCB->SHCSR |= SCB_SHCSR_MEMFAULTENA_Msk;
+	__DSB();
+	__ISB();
+#endif /* __CONFIG_STACK_GUARD */
+}
+
+#if __CONFIG_STACK_GUARD
+
+/*!
+ * @brief Moves the stack guard region.
+ *
+ * Called from __threadChange() with the guard of the thread to run: any
+ * access to its __TH_STACKGUARD bytes raises a memory management fault.
+ *
+ * @param	addr	Guard address, aligned to __TH_STACKGUARD.
+ * @return Nothing.
+ */
+__VOID __cpuStackGuard(u32 addr)
+{
+	/* No access, never executed. Region size is 2 ^ (SIZE + 1) */
+	MPU->RBAR = addr | MPU_RBAR_VALID_Msk | MPU_GUARD_REGION;
+	MPU->RASR = MPU_RASR_XN | ((__builtin_ctz(__TH_STACKGUARD) - 1) << MPU_RASR_SIZE_Pos) | MPU_RASR_ENABLE_Msk;
+}
+
+/*!
+ * @brief Memory management fault: the running thread overflowed its stack.
+ *
+ * The memory under the stack may already be overwritten, so the system
+ * halts: after __threadPostStackOverflow() no thread or interrupt runs
+ * again, the watchdog (if enabled) resets the board.
+ *
+ * @return Never.
+ */
+void MemManage_Handler(void)
+{
+	__threadPostStackOverflow(__threadGetCurrent());
+
+	__cpuDisableInterrupts();
+	for (;;);
 }
 
+#endif /* __CONFIG_STACK_GUARD */
+
 /*!
  * @brief Heartbeat, called each 100ms from the __systemThread().
  *
@@ -438,6 +575,201 @@ __VOID __cpuPinConfigure(u32 pin, GPIO_TypeDef* port, GPIOSpeed_TypeDef speed, G
 	GPIO_Init(port, &GPIO_InitStructure);
 }
 
+/*!
+ * @brief Enables the clock of the DMA controller of a stream.
+ *
+ * @param	stream	DMA stream (i.e. DMA2_Stream7).
+ * @return Nothing.
+ */
+__VOID __cpuDmaEnableClock(DMA_Stream_TypeDef* stream)
+{
+	RCC_AHB1PeriphClockCmd(((u32) stream >= (u32) DMA2_Stream0) ?
+			RCC_AHB1Periph_DMA2 : RCC_AHB1Periph_DMA1, ENABLE);
+}
+
+/*!
+ * @brief Reads and clears the interrupt flags of a DMA stream.
+ *
+ * The flags of the eight streams of a controller are packed in the LISR/HISR
+ * registers; this function returns those of \c stream shifted to bit 0.
+ *
+ * @param	stream	DMA stream (i.e. DMA2_Stream7).
+ * @return	The flags, as a combination of __CPU_DMA_TE, __CPU_DMA_HT and __CPU_DMA_TC.
+ */
+u32 __cpuDmaGetFlags(DMA_Stream_TypeDef* stream)
+{
+	__STATIC __CONST u8 shifts[4] = { 0, 6, 16, 22 };
+	DMA_TypeDef* dma = (DMA_TypeDef*) ((u32) stream & ~0xFF);
+	u32 idx = (((u32) stream & 0xFF) - 0x10) / 0x18;
+	u32 shift = shifts[idx & 3];
+	u32 flags;
+
+	if (idx < 4)
+	{
+		flags = (dma->LISR >> shift) & __CPU_DMA_ALL;
+		dma->LIFCR = flags << shift;
+	} else
+	{
+		flags = (dma->HISR >> shift) & __CPU_DMA_ALL;
+		dma->HIFCR = flags << shift;
+	}
+
+	return flags;
+}
+
+#if __PLATCONFIG_DMA_MEMCPY
+
+/* Words of a single transfer, NDTR has 16 bits */
+#define __CPU_MEMDMA_MAX		0xFFFF
+
+/* The CCM RAM is not connected to the DMA controllers */
+#define __CPU_IS_CCM(p)			(((u32) (p) & 0xFFFF0000) == 0x10000000)
+
+__STATIC u32 __cpuMemDmaDst;						/* Next destination address */
+__STATIC u32 __cpuMemDmaSrc;						/* Next source address */
+__STATIC u32 __cpuMemDmaLeft;						/* Words not started yet */
+__STATIC __VOID (*__cpuMemDmaDone)(__PVOID);		/* Completion callback, may be __NULL */
+__STATIC __PVOID __cpuMemDmaArg;					/* Completion callback parameter */
+__STATIC __BOOL __cpuMemDmaInit = __FALSE;			/* Stream configured */
+__STATIC volatile __BOOL __cpuMemDmaBusy = __FALSE;	/* A copy is running */
+
+/*
+ * Starts the next transfer of a __cpuDmaMemCpy() copy.
+ */
+__STATIC __VOID __cpuMemDmaStart(__VOID)
+{
+	u32 n = (__cpuMemDmaLeft > __CPU_MEMDMA_MAX) ? __CPU_MEMDMA_MAX : __cpuMemDmaLeft;
+
+	__cpuDmaGetFlags(BOARD_MEMCPY_DMA);
+	BOARD_MEMCPY_DMA->PAR = __cpuMemDmaSrc;
+	BOARD_MEMCPY_DMA->M0AR = __cpuMemDmaDst;
+	BOARD_MEMCPY_DMA->NDTR = n;
+
+	__cpuMemDmaSrc += n * sizeof(u32);
+	__cpuMemDmaDst += n * sizeof(u32);
+	__cpuMemDmaLeft -= n;
+
+	BOARD_MEMCPY_DMA->CR |= DMA_SxCR_EN;
+}
+
+/*
+ * Memory to memory DMA stream interrupt.
+ */
+__STATIC __VOID __cpuMemDmaIsr(__PVOID param)
+{
+	__VOID (*done)(__PVOID);
+	u32 flags;
+
+	__systemEnterISR();
+
+	flags = __cpuDmaGetFlags(BOARD_MEMCPY_DMA);
+	if (flags & (__CPU_DMA_TC | __CPU_DMA_TE))
+	{
+		if (__cpuMemDmaLeft > 0 && !(flags & __CPU_DMA_TE))
+		{
+			__cpuMemDmaStart();
+		} else
+		{
+			BOARD_MEMCPY_DMA->CR &= ~DMA_SxCR_EN;
+			done = __cpuMemDmaDone;
+			__cpuMemDmaDone = __NULL;
+			__cpuMemDmaLeft = 0;
+			__cpuMemDmaBusy = __FALSE;
+			if (done) done(__cpuMemDmaArg);
+		}
+	}
+
+	__systemLeaveISR();
+}
+
+/*!
+ * @brief Copies memory with the BOARD_MEMCPY_DMA stream, for __memCpyAsync().
+ *
+ * The copy is split in transfers of up to 64K words, chained by the
+ * stream interrupt. One copy runs at a time.
+ *
+ * @param	dst		Word-aligned destination.
+ * @param	src		Word-aligned source.
+ * @param	qty		Quantity of bytes, multiple of 4.
+ * @param	done	Function called from the interrupt at the end of the copy,
+ * 					or __NULL.
+ * @param	arg		Parameter of \c done.
+ * @return	__TRUE if the copy started, __FALSE if the stream is busy or the
+ * 			blocks cannot be reached by the DMA.
+ */
+__BOOL __cpuDmaMemCpy(__PVOID dst, __CONST __PVOID src, u32 qty, __VOID (*done)(__PVOID), __PVOID arg)
+{
+	DMA_InitTypeDef DMA_InitStructure;
+	NVIC_InitTypeDef NVIC_InitStructure;
+
+	if (qty == 0 || (((u32) dst | (u32) src | qty) & (sizeof(u32) - 1))) return __FALSE;
+	if (__CPU_IS_CCM(dst) || __CPU_IS_CCM(src)) return __FALSE;
+
+	__systemStop();
+
+	if (__cpuMemDmaBusy)
+	{
+		__systemStart();
+		return __FALSE;
+	}
+
+	if (!__cpuMemDmaInit)
+	{
+		__cpuDmaEnableClock(BOARD_MEMCPY_DMA);
+		DMA_DeInit(BOARD_MEMCPY_DMA);
+
+		/* The FIFO is mandatory in memory to memory mode */
+		DMA_StructInit(&DMA_InitStructure);
+		DMA_InitStructure.DMA_Channel				= DMA_Channel_0;
+		DMA_InitStructure.DMA_DIR					= DMA_DIR_MemoryToMemory;
+		DMA_InitStructure.DMA_PeripheralInc			= DMA_PeripheralInc_Enable;
+		DMA_InitStructure.DMA_MemoryInc				= DMA_MemoryInc_Enable;
+		DMA_InitStructure.DMA_PeripheralDataSize	= DMA_PeripheralDataSize_Word;
+		DMA_InitStructure.DMA_MemoryDataSize		= DMA_MemoryDataSize_Word;
+		DMA_InitStructure.DMA_FIFOMode				= DMA_FIFOMode_Enable;
+		DMA_InitStructure.DMA_FIFOThreshold			= DMA_FIFOThreshold_Full;
+		DMA_InitStructure.DMA_Priority				= DMA_Priority_Low;
+		DMA_InitStructure.DMA_BufferSize			= 1;
+		DMA_Init(BOARD_MEMCPY_DMA, &DMA_InitStructure);
+		DMA_ITConfig(BOARD_MEMCPY_DMA, DMA_IT_TC | DMA_IT_TE, ENABLE);
+
+		__intSetVector(BOARD_MEMCPY_DMA_IRQ, __cpuMemDmaIsr, __NULL);
+
+		NVIC_InitStructure.NVIC_IRQChannel = BOARD_MEMCPY_DMA_IRQ;
+		NVIC_InitStructure.NVIC_IRQChannelPreemptionPriority = 1;
+		NVIC_InitStructure.NVIC_IRQChannelSubPriority = 3;
+		NVIC_InitStructure.NVIC_IRQChannelCmd = ENABLE;
+		NVIC_Init(&NVIC_InitStructure);
+
+		__cpuMemDmaInit = __TRUE;
+	}
+
+	__cpuMemDmaDst = (u32) dst;
+	__cpuMemDmaSrc = (u32) src;
+	__cpuMemDmaLeft = qty / sizeof(u32);
+	__cpuMemDmaDone = done;
+	__cpuMemDmaArg = arg;
+	__cpuMemDmaBusy = __TRUE;
+	__cpuMemDmaStart();
+
+	__systemStart();
+	return __TRUE;
+}
+
+#endif /* __PLATCONFIG_DMA_MEMCPY */
+
+/*!
+ * @brief Starts the DWT cycle counter read by __cpuGetCycles().
+ *
+ * @return Nothing.
+ */
+__VOID __cpuInitCycleCounter(__VOID)
+{
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+	__CPU_DWT_CYCCNT = 0;
+	__CPU_DWT_CTRL |= __CPU_DWT_CYCCNTENA;
+}
+
 #if __CONFIG_COMPILE_IO
 
 /*!
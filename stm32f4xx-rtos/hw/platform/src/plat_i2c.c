@@ -38,18 +38,11 @@
   */
 
 /*!
- * @brief Reception state codes
- *
- * ST has done this I2C interface a little tricky,
- * so we will be using this state codes for reception.
+ * @brief Job phase codes (\c pd_jobstate).
  */
-#define I2C_RXSTATE_RESET			0	/*!< @brief Initial (reset) state */
-#define I2C_RXSTATE_SEND_SUBADDR	1	/*!< @brief Send sub-address */
-#define I2C_RXSTATE_SUBADDR_SENT	2	/*!< @brief Sub-address sent */
-#define I2C_RXSTATE_1				3	/*!< @brief DataN-2 */
-#define I2C_RXSTATE_2				4	/*!< @brief DataN-2 and DataN-1 */
-#define I2C_RXSTATE_3				5	/*!< @brief DataN */
-#define I2C_RXSTATE_4				6	/*!< @brief DataN */
+#define I2C_JOBSTATE_IDLE			0	/*!< @brief No job running */
+#define I2C_JOBSTATE_WRITE			1	/*!< @brief Writing \c jb_tx */
+#define I2C_JOBSTATE_READ			2	/*!< @brief Reading into \c jb_rx */
 
 /**
   * @}
@@ -63,6 +56,45 @@
   * @{
   */
 
+/*!
+ * @brief Configures the DMA streams, if any.
+ *
+ * Both streams are left disabled, each job sets address and length.
+ *
+ * @param	dv		Device to configure.
+ *
+ * @return Nothing.
+ */
+__STATIC __VOID __i2cSetDma(__PDEVICE dv)
+{
+	DMA_InitTypeDef DMA_InitStructure;
+	PI2C_PARAMS params = dv->dv_params;
+
+	DMA_StructInit(&DMA_InitStructure);
+	DMA_InitStructure.DMA_Channel				= params->dma_channel;
+	DMA_InitStructure.DMA_PeripheralBaseAddr	= (u32) &params->base_addr->DR;
+	DMA_InitStructure.DMA_MemoryInc				= DMA_MemoryInc_Enable;
+	DMA_InitStructure.DMA_BufferSize			= 1;
+	DMA_InitStructure.DMA_Priority				= DMA_Priority_High;
+
+	if (params->rx_dma)
+	{
+		__cpuDmaEnableClock(params->rx_dma);
+		DMA_DeInit(params->rx_dma);
+		DMA_InitStructure.DMA_DIR = DMA_DIR_PeripheralToMemory;
+		DMA_Init(params->rx_dma, &DMA_InitStructure);
+		DMA_ITConfig(params->rx_dma, DMA_IT_TC | DMA_IT_TE, ENABLE);
+	}
+
+	if (params->tx_dma)
+	{
+		__cpuDmaEnableClock(params->tx_dma);
+		DMA_DeInit(params->tx_dma);
+		DMA_InitStructure.DMA_DIR = DMA_DIR_MemoryToPeripheral;
+		DMA_Init(params->tx_dma, &DMA_InitStructure);
+	}
+}
+
 /*!
  * @brief Sets hardware parameters.
  *
@@ -112,6 +144,9 @@ __STATIC u8 __i2cSetParameters(__PDEVICE dv)
 	I2C_Init(params->base_addr, &I2C_InitStructure);
 	I2C_Cmd(params->base_addr, ENABLE);
 
+	__i2cSetDma(dv);
+	((__PI2C_PDB) dv->dv_pdb)->pd_jobstate = I2C_JOBSTATE_IDLE;
+
 	return __DEV_OK;
 }
 
@@ -141,365 +176,268 @@ __STATIC u8 __i2cSetSpeed(__PDEVICE dv, u32 spd)
   	return __DEV_OK;
 }
 
-#if __PLATI2C_MODE_INTERRUPTS
-
 /*!
- * @brief Transmits a byte from the driver's TX buffer, and increment
- * the offset variables.
+ * @brief Starts a master job. Called with interrupts disabled.
  *
- * @param pd		PDB of the I2C device.
- * @param params	Pointer to a I2C_PARAMS structure.
+ * The whole job then runs from the I2C and DMA interrupts.
  *
- * @return			__TRUE if there is still data to send. __FALSE if there is no
- * 					more data to send.
- *
+ * @param	dv		Pointer to the device.
+ * @param	jb		Job to start (head of the queue).
+ *
+ * @return __DEV_OK.
  */
-__STATIC __BOOL __i2cTxBufferByte(__I2C_PDB* pd, I2C_PARAMS* params)
+__STATIC i32 __i2cJobStart(__PDEVICE dv, __PI2C_JOB jb)
 {
-	if (pd->pd_txcnt)
-	{
-		I2C_SendData(params->base_addr, *(pd->pd_txbuf + pd->pd_tcidx));
-		if (++pd->pd_tcidx >= pd->pd_txlen) pd->pd_tcidx = 0;
-		if (--pd->pd_txcnt == 0) return __FALSE;
+	PI2C_PARAMS params = dv->dv_params;
+	__PI2C_PDB pd = dv->dv_pdb;
+	I2C_TypeDef* pI2C = params->base_addr;
 
-		return __TRUE;
-	}
+	/* STOP of the previous job still on the bus (a bit time at most) */
+	while (pI2C->CR1 & I2C_CR1_STOP);
+
+	pd->pd_jobidx = 0;
+	pd->pd_jobstate = (jb->jb_txlen || !jb->jb_rxlen) ? I2C_JOBSTATE_WRITE : I2C_JOBSTATE_READ;
+
+	I2C_AcknowledgeConfig(pI2C, ENABLE);
+	I2C_ITConfig(pI2C, I2C_IT_EVT | I2C_IT_ERR, ENABLE);
+	I2C_GenerateSTART(pI2C, ENABLE);
 
-	return __FALSE;
+	return __DEV_OK;
 }
-
 
 /*!
- * @brief Receives a byte from the I2C and stores it in the RX buffer
- * of the driver.
- *
- * @param pd		PDB of the I2C device.
- * @param params	Pointer to a I2C_PARAMS structure.
+ * @brief Ends the running job and starts the next one, if any.
  *
- * @return			Nothing.
+ * @param	dv		Pointer to the device.
+ * @param	status	Result of the job.
  *
+ * @return Nothing.
  */
-__STATIC __VOID __i2cRxBufferByte(__I2C_PDB* pd, I2C_PARAMS* params)
+__STATIC __VOID __i2cJobEnd(__PDEVICE dv, i32 status)
 {
-	/* Receive byte */
-	*(pd->pd_rxbuf + pd->pd_rcidx) = I2C_ReceiveData(params->base_addr);
-	if (++pd->pd_rcidx >= pd->pd_rxlen) pd->pd_rcidx = 0;
-	if (++pd->pd_rxcnt > pd->pd_rxlen) pd->pd_rxerr |= __I2C_ERR_OVERFLOW;
+	PI2C_PARAMS params = dv->dv_params;
+	__PI2C_PDB pd = dv->dv_pdb;
+
+	params->base_addr->CR2 &= ~(I2C_CR2_ITBUFEN | I2C_CR2_DMAEN | I2C_CR2_LAST);
+	pd->pd_jobstate = I2C_JOBSTATE_IDLE;
+
+	__i2cJobDone(dv, status);
+
+	if (!pd->pd_jobhead) I2C_ITConfig(params->base_addr, I2C_IT_EVT | I2C_IT_ERR, DISABLE);
 }
 
 /*!
- * @brief Main interrupt service routine for the I2C driver.
+ * @brief Event interrupt service routine.
+ *
+ * Runs the job phases. Writes of more than one byte and reads of more than
+ * one byte use DMA if the stream is configured, otherwise each byte is moved
+ * by the TXE/RXNE interrupt.
  */
-__VOID __i2cISR(__PVOID pVoid)
+__VOID __i2cEvIsr(__PVOID pVoid)
 {
 	__PDEVICE dv = (__PDEVICE) pVoid;
-	__I2C_PDB* pd = dv->dv_pdb;
-	I2C_PARAMS* params = dv->dv_params;
+	__PI2C_PDB pd = dv->dv_pdb;
+	PI2C_PARAMS params = dv->dv_params;
+	I2C_TypeDef* pI2C = params->base_addr;
+	__PI2C_JOB jb = pd->pd_jobhead;
+	u16 sr1;
 
 	__systemEnterISR();
 
-	/* Check the current event using the ST library */
-	switch (I2C_GetLastEvent(params->base_addr))
-	{
-		/*
-		 * Received after sending the START bit (EV 5)
-		 */
-		case I2C_EVENT_MASTER_MODE_SELECT:
-
-			/* Check if there is something to read */
-			if (pd->pd_rxqty)
-			{
-				/*
-				 * READING
-				 */
+	sr1 = pI2C->SR1;
 
-				/* Has to send a second START? */
-				if (pd->pd_mode & __I2C_MODE_REPEAT_START && params->rxstep == I2C_RXSTATE_RESET)
-				{
-					/*
-					 * Starting sub-address transmission.
-					 */
-
-					/* Send address in write mode */
-					params->rxstep = I2C_RXSTATE_SEND_SUBADDR;
-					I2C_Send7bitAddress(params->base_addr, (u8) (pd->pd_rmtaddr << 1), I2C_Direction_Transmitter);
-				} else {
-
-					/*
-					 * Prepare reception code for I2C_EVENT_MASTER_BYTE_RECEIVED event, to struggle
-					 * with the N>2, N=2, N=1 situation.
-					 */
-					params->rxstep = I2C_RXSTATE_1;
-
-					/* Send address in read mode */
-					I2C_Send7bitAddress(params->base_addr, (u8) (pd->pd_rmtaddr << 1) | 1, I2C_Direction_Receiver);
-				}
-			} else {
-				/*
-				 * WRITING
-				 */
-
-				/* Send address in write mode */
-				I2C_Send7bitAddress(params->base_addr, (u8) (pd->pd_rmtaddr << 1), I2C_Direction_Transmitter);
-			}
-			break;
+	if (!jb || pd->pd_jobstate == I2C_JOBSTATE_IDLE)
+	{
+		I2C_ITConfig(pI2C, I2C_IT_EVT | I2C_IT_BUF, DISABLE);
+		__systemLeaveISR();
+		return;
+	}
 
-		/*
-		 * After sending the address and receiving the ACK (EV 6)
-		 */
-		case I2C_EVENT_MASTER_TRANSMITTER_MODE_SELECTED:
+	if (sr1 & I2C_SR1_SB)
+	{
+		/* EV5, writing the address clears SB */
+		if (pd->pd_jobstate == I2C_JOBSTATE_READ)
+		{
+			I2C_Send7bitAddress(pI2C, (u8) (jb->jb_addr << 1), I2C_Direction_Receiver);
+		} else {
+			I2C_Send7bitAddress(pI2C, (u8) (jb->jb_addr << 1), I2C_Direction_Transmitter);
+		}
+	} else if (sr1 & I2C_SR1_ADDR)
+	{
+		/* EV6, reading SR2 clears ADDR */
+		if (pd->pd_jobstate == I2C_JOBSTATE_WRITE)
+		{
+			(__VOID) pI2C->SR2;
 
-			/* If reading send the first byte of the sub-address */
-			if (pd->pd_rxqty && params->rxstep == I2C_RXSTATE_SEND_SUBADDR)
+			if (!jb->jb_txlen)
 			{
-				params->subaddr_cnt = pd->pd_subaddrlen;
-				I2C_SendData(params->base_addr, (u8) (pd->pd_subaddr >> (params->subaddr_cnt - 8)) & 0xFF);
-				params->subaddr_cnt -= 8;
-
-				if (params->subaddr_cnt == 0)
-				{
-					I2C_ITConfig(params->base_addr, I2C_IT_BUF, DISABLE);
-				}
-
+				/* Address only, the slave acknowledged */
+				I2C_GenerateSTOP(pI2C, ENABLE);
+				__i2cJobEnd(dv, __DEV_OK);
+			} else if (params->tx_dma && jb->jb_txlen > 1)
+			{
+				/* Stale TC/HT/FE flags of the previous job would fire at once */
+				__cpuDmaGetFlags(params->tx_dma);
+				params->tx_dma->M0AR = (u32) jb->jb_tx;
+				params->tx_dma->NDTR = jb->jb_txlen;
+				pd->pd_jobidx = jb->jb_txlen;
+				pI2C->CR2 |= I2C_CR2_DMAEN;
+				DMA_Cmd(params->tx_dma, ENABLE);
 			} else {
-				/* If writing start sending bytes */
-				if (__i2cTxBufferByte(pd, params) == __FALSE)
-				{
-					I2C_ITConfig(params->base_addr, I2C_IT_BUF, DISABLE);
-				}
+				I2C_SendData(pI2C, jb->jb_tx[pd->pd_jobidx++]);
+				if (pd->pd_jobidx < jb->jb_txlen) I2C_ITConfig(pI2C, I2C_IT_BUF, ENABLE);
 			}
-			break;
-
-		/*
-		 * I2C TX buffer is empty and the data is being output through the shift register (EV 8)
-		 */
-		case I2C_EVENT_MASTER_BYTE_TRANSMITTING:
-
-			/* If reading and sending the sub-address */
-			if (pd->pd_rxqty)
+		} else {
+			if (jb->jb_rxlen == 1)
 			{
-				if (params->rxstep == I2C_RXSTATE_SEND_SUBADDR)
-				{
-					if (params->subaddr_cnt)
-					{
-						/* Send sub-address byte */
-						I2C_SendData(params->base_addr, (u8) (pd->pd_subaddr >> (params->subaddr_cnt - 8)) & 0xFF);
-
-						/* Keep track of the sub-address byte we have to send */
-						params->subaddr_cnt -= 8;
-
-						if (params->subaddr_cnt == 0)
-						{
-							I2C_ITConfig(params->base_addr, I2C_IT_BUF, DISABLE);
-						}
-
-					} else {
-						/* Sub-address sent, wait for I2C_EVENT_MASTER_BYTE_TRANSMITTED */
-					}
-				}
+				/* NACK and STOP must be programmed before clearing ADDR */
+				I2C_AcknowledgeConfig(pI2C, DISABLE);
+				(__VOID) pI2C->SR2;
+				I2C_GenerateSTOP(pI2C, ENABLE);
+				I2C_ITConfig(pI2C, I2C_IT_BUF, ENABLE);
+			} else if (params->rx_dma)
+			{
+				/* LAST makes the hardware NACK the final byte */
+				__cpuDmaGetFlags(params->rx_dma);
+				params->rx_dma->M0AR = (u32) jb->jb_rx;
+				params->rx_dma->NDTR = jb->jb_rxlen;
+				pI2C->CR2 |= I2C_CR2_DMAEN | I2C_CR2_LAST;
+				DMA_Cmd(params->rx_dma, ENABLE);
+				(__VOID) pI2C->SR2;
 			} else {
-				/* If transmitting, keep sending */
-				if (__i2cTxBufferByte(pd, params) == __FALSE)
-				{
-					I2C_ITConfig(params->base_addr, I2C_IT_BUF, DISABLE);
-				}
+				(__VOID) pI2C->SR2;
+				I2C_ITConfig(pI2C, I2C_IT_BUF, ENABLE);
 			}
-			break;
-
-		/*
-		 * After transmitting a byte (EV 8_2)
-		 */
-		case I2C_EVENT_MASTER_BYTE_TRANSMITTED:
+		}
+	} else if (pd->pd_jobstate == I2C_JOBSTATE_READ)
+	{
+		if (sr1 & I2C_SR1_RXNE)
+		{
+			jb->jb_rx[pd->pd_jobidx++] = I2C_ReceiveData(pI2C);
 
-			/* Check if we're done with the sub-address */
-			if (pd->pd_rxqty)
+			if (pd->pd_jobidx == jb->jb_rxlen)
 			{
-				if (params->rxstep == I2C_RXSTATE_SEND_SUBADDR)
-				{
-					if (params->subaddr_cnt == 0)
-					{
-						/* Send START again */
-						I2C_GenerateSTART(params->base_addr, ENABLE);
-
-						/* Change step to prevent sending sub-address twice */
-						params->rxstep = I2C_RXSTATE_SUBADDR_SENT;
-					} else {
-						/* Send sub-address byte */
-						I2C_SendData(params->base_addr, (u8) (pd->pd_subaddr >> (params->subaddr_cnt - 8)) & 0xFF);
-
-						/* Keep track of the sub-address byte we have to send */
-						params->subaddr_cnt -= 8;
-
-						if (params->subaddr_cnt == 0)
-						{
-							I2C_ITConfig(params->base_addr, I2C_IT_BUF, DISABLE);
-						}
-					}
-				}
-			} else {
-				/* If transmitting, check if there are still more to send */
-				if (!pd->pd_txcnt)
-				{
-					/* Done with transmission */
-					I2C_GenerateSTOP(params->base_addr, ENABLE);
-					I2C_ITConfig(params->base_addr, I2C_IT_EVT, DISABLE);
-					__eventSet(dv->dv_txev);
-				} else {
-					/* Not done, we may have had a delay, keep sending */
-					if (__i2cTxBufferByte(pd, params) == __FALSE)
-					{
-						I2C_ITConfig(params->base_addr, I2C_IT_BUF, DISABLE);
-					}
-				}
+				__i2cJobEnd(dv, __DEV_OK);
+			} else if (jb->jb_rxlen - pd->pd_jobidx == 1)
+			{
+				/* The byte being received is the last one */
+				I2C_AcknowledgeConfig(pI2C, DISABLE);
+				I2C_GenerateSTOP(pI2C, ENABLE);
 			}
-			break;
+		}
+	} else if ((sr1 & I2C_SR1_TXE) && pd->pd_jobidx < jb->jb_txlen)
+	{
+		/* EV8 */
+		I2C_SendData(pI2C, jb->jb_tx[pd->pd_jobidx++]);
+		if (pd->pd_jobidx == jb->jb_txlen) I2C_ITConfig(pI2C, I2C_IT_BUF, DISABLE);
+	} else if ((sr1 & I2C_SR1_BTF) && (!params->tx_dma || !params->tx_dma->NDTR))
+	{
+		/* EV8_2, every byte is out */
+		pI2C->CR2 &= ~I2C_CR2_DMAEN;
 
-		/*
-		 * After sending the address in read-mode
-		 */
-		case I2C_EVENT_MASTER_RECEIVER_MODE_SELECTED:
+		if (jb->jb_rxlen)
+		{
+			/* Repeated START for the read phase, it also clears BTF */
+			pd->pd_jobidx = 0;
+			pd->pd_jobstate = I2C_JOBSTATE_READ;
+			I2C_GenerateSTART(pI2C, ENABLE);
+		} else {
+			I2C_GenerateSTOP(pI2C, ENABLE);
+			__i2cJobEnd(dv, __DEV_OK);
+		}
+	}
 
-			I2C_ITConfig(params->base_addr, I2C_IT_BUF, ENABLE);
+	__systemLeaveISR();
+}
 
-			/* Disable ACKs generation if reading just one byte */
-			if (pd->pd_rxqty == 1)
-			{
-				I2C_AcknowledgeConfig(params->base_addr, DISABLE);
-				I2C_GenerateSTOP(params->base_addr, ENABLE);
-			}
-			break;
+/*!
+ * @brief Error interrupt service routine.
+ *
+ * Ends the running job with __DEV_ERROR on a missing ACK, bus error, lost
+ * arbitration or overrun.
+ */
+__VOID __i2cErIsr(__PVOID pVoid)
+{
+	__PDEVICE dv = (__PDEVICE) pVoid;
+	PI2C_PARAMS params = dv->dv_params;
+	I2C_TypeDef* pI2C = params->base_addr;
+	u16 sr1;
 
-		/*
-		 * MASTER READING
-		 */
+	__systemEnterISR();
 
-		/* From ST documentation
-		 *
-		 * Method 2: transfer sequence for master receiver when N>2
-		 *
-		 * When 3 bytes remain to be read:
-		 *	(1) RxNE = 1 => Nothing (DataN-2 not read)
-		 *	(2) DataN-1 received
-		 *	(3) BTF = 1 because both shift and data registers are full: DataN-2 in DR and DataN-1 in
-		 *	  the shift register => SCL tied low: no other data will be received on the bus.
-		 *	(4) Clear ACK bit
-		 *	(5) Read DataN-2 in DR => This will launch the DataN reception in the shift register
-		 *	(6) DataN received (with a NACK)
-		 *	(7) Program START/STOP
-		 *	(8) Read DataN-1
-		 *	(9) RxNE = 1
-		 *	(10) Read DataN
-		 *
-		 * So we will be handling special N>2 case here, reusing params->rxstep.
-		 * params->rxstep is set to I2C_RXSTATE_1 in the I2C_EVENT_MASTER_MODE_SELECT
-		 * event after sending the START bit, and eventually handling the second START
-		 * condition.
-		 *
-		 * I2C_RXSTATE_1 and I2C_RXSTATE_4 steps will be handled in the
-		 * I2C_EVENT_MASTER_BYTE_RECEIVED event case. I2C_RXSTATE_2 and I2C_RXSTATE_3
-		 * will be handled in the (I2C_EVENT_MASTER_BYTE_RECEIVED | 0x4) case (BUSY flag
-		 * plus I2C_EVENT_MASTER_BYTE_RECEIVED event).
-		 *
-		 */
+	sr1 = pI2C->SR1;
+	pI2C->SR1 = ~(sr1 & (I2C_SR1_AF | I2C_SR1_BERR | I2C_SR1_ARLO | I2C_SR1_OVR));
 
-		case I2C_EVENT_MASTER_BYTE_RECEIVED:
+	/* After a lost arbitration the bus belongs to another master */
+	if (!(sr1 & I2C_SR1_ARLO)) I2C_GenerateSTOP(pI2C, ENABLE);
 
-			if (pd->pd_rxqty > 2 && pd->pd_rxcnt >= pd->pd_rxqty - 3)
-			{
-				switch (params->rxstep)
-				{
-					case I2C_RXSTATE_1:
-						/* (1) RxNE = 1 => Nothing (DataN-2 not read) */
-						params->rxstep = I2C_RXSTATE_2;
-						__systemLeaveISR();
-						return;
-
-					case I2C_RXSTATE_4:
-						/*
-						 *	(9) RxNE = 1
-						 *	(10) Read DataN
-						 */
-
-						/* break here, the reading is done below */
-						break;
+	/* Disabling a stream can set its TC flag, clear them too */
+	if (params->rx_dma)
+	{
+		DMA_Cmd(params->rx_dma, DISABLE);
+		__cpuDmaGetFlags(params->rx_dma);
+	}
 
-					default:
-						__systemLeaveISR();
-						return;
-				}
-			}
+	if (params->tx_dma)
+	{
+		DMA_Cmd(params->tx_dma, DISABLE);
+		__cpuDmaGetFlags(params->tx_dma);
+	}
 
-			/*
-			 * Handle pd->pd_rxqty == 2
-			 */
+	if (((__PI2C_PDB) dv->dv_pdb)->pd_jobstate != I2C_JOBSTATE_IDLE) __i2cJobEnd(dv, __DEV_ERROR);
 
-			/*
-			 * Handle pd->pd_rxqty == 1
-			 */
+	__systemLeaveISR();
+}
 
-			__i2cRxBufferByte(pd, params);
+/*!
+ * @brief RX DMA stream interrupt service routine.
+ *
+ * The last byte was received (and NACKed), the job ends with a STOP.
+ */
+__VOID __i2cRxDmaIsr(__PVOID pVoid)
+{
+	__PDEVICE dv = (__PDEVICE) pVoid;
+	PI2C_PARAMS params = dv->dv_params;
+	u32 flags;
 
-			if (pd->pd_rxcnt == pd->pd_rxqty)
-			{
-				__eventSet(dv->dv_rxev);
-				I2C_ITConfig(params->base_addr, I2C_IT_BUF | I2C_IT_EVT , DISABLE);
-			}
-			break;
+	__systemEnterISR();
 
-		case (I2C_EVENT_MASTER_BYTE_RECEIVED | 0x4):
-			if (pd->pd_rxqty > 2 && pd->pd_rxcnt >= pd->pd_rxqty - 3)
-			{
-				switch (params->rxstep)
-				{
-					case I2C_RXSTATE_2:
-						/*
-						 * (2) DataN-1 received
-						 * (3) BTF = 1 because both shift and data registers are full: DataN-2 in DR and DataN-1 in
-						 * the shift register => SCL tied low: no other data will be received on the bus.
-						 */
-
-						/*
-						 * (4) Clear ACK bit
-						 */
-						I2C_AcknowledgeConfig(params->base_addr, DISABLE);
-
-						/*
-						 * (5) Read DataN-2 in DR => This will launch the DataN reception in the shift register
-						 */
-						__i2cRxBufferByte(pd, params);
-						params->rxstep = I2C_RXSTATE_3;
-
-					case I2C_RXSTATE_3:
-						/*
-						 * (6) DataN received (with a NACK)
-						 */
-
-						/*
-						 * (7) Program START/STOP
-						 */
-						 I2C_GenerateSTOP(params->base_addr, ENABLE);
-
-						/*
-						 * (8) Read DataN-1
-						 */
-						__i2cRxBufferByte(pd, params);
-
-						/*
-						 * Wait for DataN (the next interrupt).
-						 */
-						params->rxstep = I2C_RXSTATE_4;
-
-						__systemLeaveISR();
-						return;
-				}
-			}
-			break;
+	flags = __cpuDmaGetFlags(params->rx_dma);
+
+	if ((flags & (__CPU_DMA_TC | __CPU_DMA_TE)) &&
+		((__PI2C_PDB) dv->dv_pdb)->pd_jobstate == I2C_JOBSTATE_READ)
+	{
+		I2C_GenerateSTOP(params->base_addr, ENABLE);
+		__i2cJobEnd(dv, (flags & __CPU_DMA_TE) ? __DEV_ERROR : __DEV_OK);
 	}
 
 	__systemLeaveISR();
 }
 
-#endif /* __PLATI2C_MODE_INTERRUPTS */
+/*!
+ * @brief Enables or disables an interrupt channel.
+ *
+ * @param	irq		Interrupt number.
+ * @param	fn		Service routine, __NULL to disable.
+ * @param	dv		Device passed to the routine.
+ *
+ * @return Nothing.
+ */
+__STATIC __VOID __i2cSetVector(u8 irq, __INTFUNC* fn, __PDEVICE dv)
+{
+	NVIC_InitTypeDef NVIC_InitStructure;
+
+	if (fn) __intSetVector(irq, fn, dv);
+
+	NVIC_InitStructure.NVIC_IRQChannel = irq;
+	NVIC_InitStructure.NVIC_IRQChannelPreemptionPriority = 0;
+	NVIC_InitStructure.NVIC_IRQChannelSubPriority = 0;
+	NVIC_InitStructure.NVIC_IRQChannelCmd = fn ? ENABLE : DISABLE;
+	NVIC_Init(&NVIC_InitStructure);
+
+	if (!fn) __intSetVector(irq, __NULL, __NULL);
+}
+
 
 /*!
  * @brief I2C for stm32 IO control function
@@ -512,8 +450,6 @@ __VOID __i2cISR(__PVOID pVoid)
  *
  * @arg	@ref __I2C_PLAT_INIT_HW			Initialize hardware.
  * @arg @ref __I2C_PLAT_SET_SPEED		Set bus speed.
- * @arg @ref __I2C_PLAT_INIT_TX			Start transmission.
- * @arg @ref __I2C_PLAT_SET_IRQ			Configure interrupts.
  * @arg @ref __I2C_PLAT_ENABLE_DEVICE	Enable device.
  * @arg @ref __I2C_PLAT_DISABLE_DEVICE	Disable device.
  * @arg @ref __I2C_PLAT_SET_IRQ			Set interrupts.
@@ -525,14 +461,9 @@ __VOID __i2cISR(__PVOID pVoid)
  * @arg @ref __I2C_PLAT_CHECK_EVENT		Check for a given event.
  * @arg @ref __I2C_PLAT_SET_ACK			Configure automatic ACK generation.
  * @arg @ref __I2C_PLAT_ABORT			Abort and set to a reset (stable) state.
- * @arg @ref __I2C_PLAT_USE_IRQ			Driver is asking is the platform supports interrupt
- * 										mode.
- * @arg @ref __I2C_PLAT_INIT_TX			Start transmission.
- * @arg @ref __I2C_PLAT_END_TX			End transmission.
- * @arg @ref __I2C_PLAT_INIT_RX			Start reception.
- * @arg @ref __I2C_PLAT_END_RX			End reception.
  * @arg @ref __I2C_PLAT_WRITE_BYTE		Write a single byte.
  * @arg @ref __I2C_PLAT_READ_BYTE		Read a single byte.
+ * @arg @ref __I2C_PLAT_JOB_START		Start the job in \c in.
  *
  * @param	param	Optional parameter.
  * @param	in		Input buffer pointer.
@@ -551,16 +482,6 @@ i32 __i2cPlatIoCtl(__PDEVICE dv, u32 code, u32 param, __PVOID in, u32 in_len, __
 
 	switch (code)
 	{
-		/*
-		 * Using IRQ mode, platform will make every transaction on its own.
-		 */
-		case __I2C_PLAT_USE_IRQ:
-#if __PLATI2C_MODE_INTERRUPTS
-			return __DEV_OK;
-#else
-			return __DEV_ERROR; //__DEV_OK;
-#endif /* __PLATI2C_MODE_INTERRUPTS */
-
 		/*
 		 * Set hardware parameters.
 		 */
@@ -574,91 +495,29 @@ i32 __i2cPlatIoCtl(__PDEVICE dv, u32 code, u32 param, __PVOID in, u32 in_len, __
 			return __i2cSetSpeed(dv, param);
 
 		/*
-		 * Start reception.
+		 * Start a job.
 		 */
-		case __I2C_PLAT_INIT_RX:
-			/* Use params->rxstep to cycle through a state machine in case
-			 * we have to send sub-address.  */
-			params->rxstep = I2C_RXSTATE_RESET;
-
-			/* Reset sub-address sent counter */
-			params->subaddr_cnt = 0;
-
-			I2C_AcknowledgeConfig(params->base_addr, ENABLE);
-
-			/*
-			 * FALL
-			 */
-
-		/*
-		 * Start transmission.
-		 */
-		case __I2C_PLAT_INIT_TX:
-			/* Transmitting the START condition will chain all the interrupts
-			 * needed for transmission
-			 */
-			I2C_ITConfig(params->base_addr, I2C_IT_EVT | I2C_IT_BUF, ENABLE);
-			I2C_GenerateSTART(params->base_addr, ENABLE);
-			return __DEV_OK;
-
-		/*
-		 * End reception.
-		 */
-		case __I2C_PLAT_END_RX:
-			/*
-			 * FALL
-			 */
+		case __I2C_PLAT_JOB_START:
+			return __i2cJobStart(dv, (__PI2C_JOB) in);
 
 		/*
-		 * End transmission.
-		 */
-		case __I2C_PLAT_END_TX:
-			/* Ending DATA TX */
-			// I2C_ITConfig(params->base_addr, I2C_IT_BUF | I2C_IT_EVT, DISABLE);
-			return __DEV_OK;
-
-		/*
-		 * Configure interrupts.
+		 * Configure interrupts.
 		 */
 		case __I2C_PLAT_SET_IRQ:
-#if __PLATI2C_MODE_INTERRUPTS
-		{
-			NVIC_InitTypeDef NVIC_InitStructure;
-
-			/* Initial IRQ mapping */
-			__intSetVector(dv->dv_txint,__i2cISR,dv);
-
-			/* 	SET the NVIC channel */
-			NVIC_InitStructure.NVIC_IRQChannel = dv->dv_txint;
-			NVIC_InitStructure.NVIC_IRQChannelPreemptionPriority = 0;
-			NVIC_InitStructure.NVIC_IRQChannelSubPriority = 0;
-			NVIC_InitStructure.NVIC_IRQChannelCmd = ENABLE;
-			NVIC_Init(&NVIC_InitStructure);
-			I2C_ITConfig(I2C1, I2C_IT_EVT | I2C_IT_BUF, ENABLE);
-		}
-#endif /* __PLATI2C_MODE_INTERRUPTS */
+			__i2cSetVector(dv->dv_txint, __i2cEvIsr, dv);
+			__i2cSetVector(params->er_irq, __i2cErIsr, dv);
+			if (params->rx_dma) __i2cSetVector(params->rx_dma_irq, __i2cRxDmaIsr, dv);
 			return __DEV_OK;
 
 		/*
-		 * Disable interrupts.
+		 * Disable interrupts.
 		 */
 		case __I2C_PLAT_RESET_IRQ:
-#if __PLATI2C_MODE_INTERRUPTS
-		{
-			NVIC_InitTypeDef NVIC_InitStructure;
-
-			/* Disable I2C interrupts */
-			I2C_ITConfig(params->base_addr, I2C_IT_BUF | I2C_IT_EVT, DISABLE);
+			I2C_ITConfig(params->base_addr, I2C_IT_BUF | I2C_IT_EVT | I2C_IT_ERR, DISABLE);
 
-			NVIC_InitStructure.NVIC_IRQChannel = dv->dv_txint;
-			NVIC_InitStructure.NVIC_IRQChannelPreemptionPriority = 0;
-			NVIC_InitStructure.NVIC_IRQChannelSubPriority = 0;
-			NVIC_InitStructure.NVIC_IRQChannelCmd = DISABLE;
-			NVIC_Init(&NVIC_InitStructure);
-
-			__intSetVector(dv->dv_txint,__NULL,__NULL);
-		}
-#endif /* __PLATI2C_MODE_INTERRUPTS */
+			__i2cSetVector(dv->dv_txint, __NULL, dv);
+			__i2cSetVector(params->er_irq, __NULL, dv);
+			if (params->rx_dma) __i2cSetVector(params->rx_dma_irq, __NULL, dv);
 			return __DEV_OK;
 
 		/*
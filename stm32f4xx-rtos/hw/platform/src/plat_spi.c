@@ -32,8 +32,151 @@
 
 #if __CONFIG_COMPILE_SPI
 
-/*
- *
+/* Sent when a descriptor has no TX data, and sink for RX data nobody wants */
+__STATIC __CONST u8 __spiDummyTx = 0xFF;
+__STATIC u8 __spiDummyRx;
+
+/*
+ * Programs the DMA streams used by __spiTransfer(). Both streams run for every
+ * descriptor, the end of a transfer is the RX transfer complete interrupt.
+ */
+__STATIC __VOID __spiSetDma(__PDEVICE dv)
+{
+	DMA_InitTypeDef DMA_InitStructure;
+	NVIC_InitTypeDef NVIC_InitStructure;
+	PSPI_PARAMS params = dv->dv_params;
+	__PSPI_PDB pd = dv->dv_pdb;
+
+	pd->pd_dma = 0;
+	if (!params->rx_dma || !params->tx_dma) return;
+
+	__cpuDmaEnableClock(params->rx_dma);
+	DMA_DeInit(params->rx_dma);
+	DMA_DeInit(params->tx_dma);
+
+	DMA_StructInit(&DMA_InitStructure);
+	DMA_InitStructure.DMA_Channel				= params->dma_channel;
+	DMA_InitStructure.DMA_PeripheralBaseAddr	= (u32) &params->base_addr->DR;
+	DMA_InitStructure.DMA_Memory0BaseAddr		= (u32) &__spiDummyRx;
+	DMA_InitStructure.DMA_BufferSize			= 1;
+	DMA_InitStructure.DMA_Priority				= DMA_Priority_High;
+
+	DMA_InitStructure.DMA_DIR					= DMA_DIR_PeripheralToMemory;
+	DMA_Init(params->rx_dma, &DMA_InitStructure);
+
+	DMA_InitStructure.DMA_DIR					= DMA_DIR_MemoryToPeripheral;
+	DMA_Init(params->tx_dma, &DMA_InitStructure);
+
+	DMA_ITConfig(params->rx_dma, DMA_IT_TC | DMA_IT_TE, ENABLE);
+	DMA_ITConfig(params->tx_dma, DMA_IT_TE, ENABLE);
+
+	NVIC_InitStructure.NVIC_IRQChannelPreemptionPriority = 1;
+	NVIC_InitStructure.NVIC_IRQChannelSubPriority = 2;
+	NVIC_InitStructure.NVIC_IRQChannelCmd = ENABLE;
+	NVIC_InitStructure.NVIC_IRQChannel = params->rx_dma_irq;
+	NVIC_Init(&NVIC_InitStructure);
+	NVIC_InitStructure.NVIC_IRQChannel = params->tx_dma_irq;
+	NVIC_Init(&NVIC_InitStructure);
+
+	pd->pd_dma = 1;
+}
+
+/*
+ * Starts the DMA transfer of a descriptor. Called with interrupts disabled.
+ */
+__STATIC i32 __spiXferStart(__PDEVICE dv, __PSPI_XFER xf)
+{
+	PSPI_PARAMS params = dv->dv_params;
+	__PSPI_PDB pd = dv->dv_pdb;
+	SPI_TypeDef* pSPI = params->base_addr;
+
+	if (xf->xf_flags & __SPI_XF_START)
+	{
+		/* The byte-wise interrupt would steal the received data */
+		SPI_I2S_ITConfig(pSPI, SPI_I2S_IT_RXNE, DISABLE);
+		(__VOID) pSPI->DR;
+		SPI_I2S_DMACmd(pSPI, SPI_I2S_DMAReq_Rx | SPI_I2S_DMAReq_Tx, ENABLE);
+
+		pd->pd_csport = __NULL;
+		if (!(xf->xf_flags & __SPI_XF_NOCS))
+		{
+			pd->pd_csport = xf->xf_csport ? xf->xf_csport : params->port_cs;
+			pd->pd_cspin = xf->xf_csport ? xf->xf_cspin : params->pin_cs;
+			if (pd->pd_csport && pd->pd_cspin) __pinSet((GPIO_TypeDef*) pd->pd_csport, pd->pd_cspin, __FALSE);
+		}
+	}
+
+	__cpuDmaGetFlags(params->rx_dma);
+	__cpuDmaGetFlags(params->tx_dma);
+
+	params->rx_dma->M0AR = xf->xf_rx ? (u32) xf->xf_rx : (u32) &__spiDummyRx;
+	params->rx_dma->NDTR = xf->xf_len;
+	if (xf->xf_rx) params->rx_dma->CR |= DMA_SxCR_MINC;
+	else params->rx_dma->CR &= ~DMA_SxCR_MINC;
+
+	params->tx_dma->M0AR = xf->xf_tx ? (u32) xf->xf_tx : (u32) &__spiDummyTx;
+	params->tx_dma->NDTR = xf->xf_len;
+	if (xf->xf_tx) params->tx_dma->CR |= DMA_SxCR_MINC;
+	else params->tx_dma->CR &= ~DMA_SxCR_MINC;
+
+	/* RX first, so no received byte is missed */
+	params->rx_dma->CR |= DMA_SxCR_EN;
+	params->tx_dma->CR |= DMA_SxCR_EN;
+
+	return __DEV_OK;
+}
+
+/*
+ * Ends a transaction: releases the chip-select and gives the bus back
+ * to the interrupt-driven path.
+ */
+__STATIC i32 __spiXferEnd(__PDEVICE dv)
+{
+	PSPI_PARAMS params = dv->dv_params;
+	__PSPI_PDB pd = dv->dv_pdb;
+	SPI_TypeDef* pSPI = params->base_addr;
+
+	/* Last byte received, the clock stops in a few cycles */
+	while (SPI_I2S_GetFlagStatus(pSPI, SPI_I2S_FLAG_BSY) != RESET);
+
+	if (pd->pd_csport && pd->pd_cspin) __pinSet((GPIO_TypeDef*) pd->pd_csport, pd->pd_cspin, __TRUE);
+	pd->pd_csport = __NULL;
+
+	SPI_I2S_DMACmd(pSPI, SPI_I2S_DMAReq_Rx | SPI_I2S_DMAReq_Tx, DISABLE);
+	SPI_I2S_ITConfig(pSPI, SPI_I2S_IT_RXNE, ENABLE);
+
+	return __DEV_OK;
+}
+
+/*
+ * RX and TX DMA streams interrupt.
+ */
+__VOID __spiDmaIsr(__PVOID param)
+{
+	__PDEVICE dv = (__PDEVICE) param;
+	PSPI_PARAMS params = dv->dv_params;
+	u32 rx, tx;
+
+	__systemEnterISR();
+
+	tx = __cpuDmaGetFlags(params->tx_dma);
+	rx = __cpuDmaGetFlags(params->rx_dma);
+
+	if ((rx | tx) & __CPU_DMA_TE)
+	{
+		params->rx_dma->CR &= ~DMA_SxCR_EN;
+		params->tx_dma->CR &= ~DMA_SxCR_EN;
+		__spiXferDone(dv, __DEV_ERROR);
+	} else if (rx & __CPU_DMA_TC)
+	{
+		__spiXferDone(dv, __DEV_OK);
+	}
+
+	__systemLeaveISR();
+}
+
+/*
+ *
  */
 __STATIC u8 __spiSetParameters(__PDEVICE dv)
 {
@@ -133,6 +276,8 @@ __STATIC u8 __spiSetParameters(__PDEVICE dv)
 
  	SPI_Cmd(pSPI, ENABLE);
 
+	if (pd->pd_mode == __SPIMODE_MASTER) __spiSetDma(dv);
+
  	return __DEV_OK;
 }
 
@@ -207,6 +352,11 @@ __STATIC __VOID __spiEnableIrq(__PDEVICE dv)
 	pSPI = params->base_addr;
 
 	__intSetVector(dv->dv_txint,__spiIsr,dv);
+	if (params->rx_dma && params->tx_dma)
+	{
+		__intSetVector(params->rx_dma_irq, __spiDmaIsr, dv);
+		__intSetVector(params->tx_dma_irq, __spiDmaIsr, dv);
+	}
 	SPI_I2S_ITConfig(pSPI, SPI_I2S_IT_RXNE, ENABLE);
 }
 
@@ -219,6 +369,11 @@ __STATIC __VOID __spiDisableIrq(__PDEVICE dv)
 	pSPI = params->base_addr;
 
 	__intSetVector(dv->dv_txint,__NULL,__NULL);
+	if (params->rx_dma && params->tx_dma)
+	{
+		__intSetVector(params->rx_dma_irq, __NULL, __NULL);
+		__intSetVector(params->tx_dma_irq, __NULL, __NULL);
+	}
 	SPI_I2S_ITConfig(pSPI, SPI_I2S_IT_RXNE, DISABLE);
 }
 
@@ -266,6 +421,8 @@ __STATIC __VOID __spiSpeed(__PDEVICE dv, u8 speed )
  * @arg	__SPI_PLAT_CHAR_INPUT		Character input.
  * @arg __SPI_PLAT_INIT_TX			Start transmission. If \c param = 1, CS is asserted.
  * @arg __SPI_PLAT_SET_IRQ			Configure interrupts.
+ * @arg __SPI_PLAT_XFER_START		Start the DMA transfer of the descriptor in \c in.
+ * @arg __SPI_PLAT_XFER_END			End a transaction, release the chip-select.
  *
  * @param	param	Optional parameter.
  * @param	in		Input buffer pointer.
@@ -316,6 +473,12 @@ i32 __spiPlatIoCtl(__PDEVICE dv, u32 code, u32 param, __PVOID in, u32 in_len, __
 		case __SPI_PLAT_DEINIT_HW:
 			break;
 
+		case __SPI_PLAT_XFER_START:
+			return __spiXferStart(dv, (__PSPI_XFER) in);
+
+		case __SPI_PLAT_XFER_END:
+			return __spiXferEnd(dv);
+
 		case __SPI_PLAT_INIT_DEFAULTS:
 			/* Use default values */
 			pd->pd_rxlen = __PLATSPI_RXBUFLEN;
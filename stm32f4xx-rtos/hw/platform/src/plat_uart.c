@@ -121,6 +121,7 @@ __STATIC i32 __uartSetClock(__PDEVICE dv)
 __STATIC i32 __uartSetNVIC(__PDEVICE dv)
 {
 	NVIC_InitTypeDef NVIC_InitStructure;
+	PUART_PARAMS params = dv->dv_params;
 
 	/* 	SET the SERIAL NVIC channel */
 	NVIC_InitStructure.NVIC_IRQChannel 						= dv->dv_txint;
@@ -130,6 +131,100 @@ __STATIC i32 __uartSetNVIC(__PDEVICE dv)
 
 	NVIC_Init(&NVIC_InitStructure);
 
+	/* DMA streams channels */
+	if (params->rx_dma)
+	{
+		NVIC_InitStructure.NVIC_IRQChannel = params->rx_dma_irq;
+		NVIC_Init(&NVIC_InitStructure);
+	}
+
+	if (params->tx_dma)
+	{
+		NVIC_InitStructure.NVIC_IRQChannel = params->tx_dma_irq;
+		NVIC_Init(&NVIC_InitStructure);
+	}
+
+	return __DEV_OK;
+}
+
+/*
+ * Programs the DMA streams. The RX stream writes the whole RX buffer in circular
+ * mode, the TX stream is started by __uartDmaTxNext().
+ */
+__STATIC i32 __uartSetDma(__PDEVICE dv)
+{
+	DMA_InitTypeDef DMA_InitStructure;
+	__PSERIAL_PDB pd = dv->dv_pdb;
+	PUART_PARAMS params = dv->dv_params;
+	DMA_Stream_TypeDef* stream = params->rx_dma ? params->rx_dma : params->tx_dma;
+
+	if (!stream) return __DEV_OK;
+
+	__cpuDmaEnableClock(stream);
+
+	DMA_StructInit(&DMA_InitStructure);
+	DMA_InitStructure.DMA_Channel				= params->dma_channel;
+	DMA_InitStructure.DMA_PeripheralBaseAddr	= (u32) &params->base_addr->DR;
+	DMA_InitStructure.DMA_MemoryInc				= DMA_MemoryInc_Enable;
+	DMA_InitStructure.DMA_Priority				= DMA_Priority_High;
+
+	if (params->rx_dma)
+	{
+		DMA_DeInit(params->rx_dma);
+
+		DMA_InitStructure.DMA_Memory0BaseAddr	= (u32) pd->pd_rxbuf;
+		DMA_InitStructure.DMA_DIR				= DMA_DIR_PeripheralToMemory;
+		DMA_InitStructure.DMA_BufferSize		= pd->pd_rxlen;
+		DMA_InitStructure.DMA_Mode				= DMA_Mode_Circular;
+		DMA_Init(params->rx_dma, &DMA_InitStructure);
+
+		pd->pd_rcidx = pd->pd_rbidx = pd->pd_rxcnt = 0;
+
+		DMA_ITConfig(params->rx_dma, DMA_IT_HT | DMA_IT_TC, ENABLE);
+		DMA_Cmd(params->rx_dma, ENABLE);
+		USART_DMACmd(params->base_addr, USART_DMAReq_Rx, ENABLE);
+	}
+
+	if (params->tx_dma)
+	{
+		DMA_DeInit(params->tx_dma);
+
+		DMA_InitStructure.DMA_Memory0BaseAddr	= (u32) pd->pd_txbuf;
+		DMA_InitStructure.DMA_DIR				= DMA_DIR_MemoryToPeripheral;
+		DMA_InitStructure.DMA_BufferSize		= 1;
+		DMA_InitStructure.DMA_Mode				= DMA_Mode_Normal;
+		DMA_Init(params->tx_dma, &DMA_InitStructure);
+
+		pd->pd_txdma = 0;
+
+		DMA_ITConfig(params->tx_dma, DMA_IT_TC | DMA_IT_TE, ENABLE);
+		USART_DMACmd(params->base_addr, USART_DMAReq_Tx, ENABLE);
+	}
+
+	return __DEV_OK;
+}
+
+/*
+ * Stops the DMA streams.
+ */
+__STATIC i32 __uartResetDma(__PDEVICE dv)
+{
+	PUART_PARAMS params = dv->dv_params;
+
+	if (params->rx_dma)
+	{
+		USART_DMACmd(params->base_addr, USART_DMAReq_Rx, DISABLE);
+		USART_ITConfig(params->base_addr, USART_IT_IDLE, DISABLE);
+		DMA_DeInit(params->rx_dma);
+	}
+
+	if (params->tx_dma)
+	{
+		USART_DMACmd(params->base_addr, USART_DMAReq_Tx, DISABLE);
+		DMA_DeInit(params->tx_dma);
+		((__PSERIAL_PDB) dv->dv_pdb)->pd_txdma = 0;
+	}
+
 	return __DEV_OK;
 }
 
@@ -163,9 +258,19 @@ __STATIC i32 __uartSetParameters(__PDEVICE dv)
 
 	__uartSetClock(dv);
 
-	/* 	Enable the USART Receive interrupt: this interrupt is generated when the
-   		USART receive data register is not empty */
-  	USART_ITConfig(params->base_addr, USART_IT_RXNE, ENABLE);
+	__uartSetDma(dv);
+
+	if (params->rx_dma)
+	{
+		/*	Enable the USART IDLE line interrupt: generated when the line stays
+			idle for one frame after a reception, that is at the end of a message */
+		USART_ITConfig(params->base_addr, USART_IT_IDLE, ENABLE);
+	} else
+	{
+		/* 	Enable the USART Receive interrupt: this interrupt is generated when the
+	   		USART receive data register is not empty */
+	  	USART_ITConfig(params->base_addr, USART_IT_RXNE, ENABLE);
+	}
 
   	/* 	Enable USART1 */
   	USART_Cmd(params->base_addr, ENABLE);
@@ -187,10 +292,108 @@ __STATIC u8 __uartCharInput(__PDEVICE dv)
 	return pSERIAL->DR;
 }
 
+/*
+ * Accounts the bytes written by the RX DMA since the last call.
+ * Called from interrupts only.
+ */
+__STATIC __VOID __uartDmaRxUpdate(__PDEVICE dv)
+{
+	__PSERIAL_PDB pd = dv->dv_pdb;
+	u32 idx, cnt;
+
+	/* DMA write position */
+	idx = pd->pd_rxlen - ((UART_PARAMS*) dv->dv_params)->rx_dma->NDTR;
+	if (idx >= pd->pd_rxlen) idx = 0;
+
+	if (idx == pd->pd_rcidx) return;
+
+	cnt = (idx > pd->pd_rcidx) ? idx - pd->pd_rcidx : pd->pd_rxlen - pd->pd_rcidx + idx;
+	pd->pd_rcidx = idx;
+
+	cnt += pd->pd_rxcnt;
+	if (cnt > pd->pd_rxlen)
+	{
+		/* Unread bytes overwritten, keep the newest ones */
+		pd->pd_rxerr |= __SERIALERR_OVERFLOW;
+		pd->pd_rbidx = idx;
+		cnt = pd->pd_rxlen;
+	}
+
+	pd->pd_rxcnt = cnt;
+	__eventSet(dv->dv_rxev);
+}
+
+/*
+ * Starts the TX DMA on the contiguous unsent bytes of the TX buffer, or sets
+ * the TX event if there are none. Call with interrupts disabled.
+ */
+__STATIC __VOID __uartDmaTxNext(__PDEVICE dv)
+{
+	__PSERIAL_PDB pd = dv->dv_pdb;
+	DMA_Stream_TypeDef* stream = ((UART_PARAMS*) dv->dv_params)->tx_dma;
+	u16 len;
+
+	/* Running, the transfer complete interrupt will call again */
+	if (pd->pd_txdma) return;
+
+	if (!pd->pd_txcnt)
+	{
+		__eventSet(dv->dv_txev);
+		return;
+	}
+
+	len = pd->pd_txlen - pd->pd_tcidx;
+	if (len > pd->pd_txcnt) len = pd->pd_txcnt;
+
+	pd->pd_txdma = len;
+	stream->M0AR = (u32) (pd->pd_txbuf + pd->pd_tcidx);
+	stream->NDTR = len;
+	stream->CR |= DMA_SxCR_EN;
+}
+
+/*
+ * RX DMA stream interrupt (half and full buffer).
+ */
+__VOID __uartRxDmaISR(__PVOID pVoid)
+{
+	__PDEVICE dv = (__PDEVICE) pVoid;
+
+	__systemEnterISR();
+
+	__cpuDmaGetFlags(((UART_PARAMS*) dv->dv_params)->rx_dma);
+	__uartDmaRxUpdate(dv);
+
+	__systemLeaveISR();
+}
+
+/*
+ * TX DMA stream interrupt (transfer complete).
+ */
+__VOID __uartTxDmaISR(__PVOID pVoid)
+{
+	__PDEVICE dv = (__PDEVICE) pVoid;
+	__PSERIAL_PDB pd = dv->dv_pdb;
+
+	__systemEnterISR();
+
+	/* On transfer error the segment is dropped as well */
+	if (__cpuDmaGetFlags(((UART_PARAMS*) dv->dv_params)->tx_dma) & (__CPU_DMA_TC | __CPU_DMA_TE))
+	{
+		if ((pd->pd_tcidx += pd->pd_txdma) >= pd->pd_txlen) pd->pd_tcidx = 0;
+		pd->pd_txcnt -= pd->pd_txdma;
+		pd->pd_txdma = 0;
+
+		__uartDmaTxNext(dv);
+	}
+
+	__systemLeaveISR();
+}
+
 __VOID __uartISR(__PVOID pVoid)
 {
 	__PDEVICE dv;
 	__PSERIAL_PDB pd;
+	PUART_PARAMS params;
 	USART_TypeDef* pSERIAL;
 	u32	irr;
 
@@ -198,8 +401,9 @@ __VOID __uartISR(__PVOID pVoid)
 
 	dv = (__PDEVICE) pVoid;
 	pd = dv->dv_pdb;
+	params = dv->dv_params;
 
-	pSERIAL = ((UART_PARAMS*) dv->dv_params)->base_addr;
+	pSERIAL = params->base_addr;
 	irr = pSERIAL->SR;
 
 	if (irr & USART_FLAG_TC)
@@ -207,7 +411,23 @@ __VOID __uartISR(__PVOID pVoid)
 		pSERIAL->SR &= ~USART_FLAG_TC;
 	}
 
-	if (irr & USART_FLAG_TXE)
+	if (params->rx_dma)
+	{
+		if (irr & USART_FLAG_IDLE)
+		{
+			/* Cleared by reading SR then DR */
+			(__VOID) pSERIAL->DR;
+			__uartDmaRxUpdate(dv);
+		}
+	} else if (irr & USART_FLAG_RXNE)
+	{
+		*(pd->pd_rxbuf + pd->pd_rcidx) = __uartCharInput(dv);
+		if (++pd->pd_rcidx >= pd->pd_rxlen) pd->pd_rcidx = 0;
+		if (++pd->pd_rxcnt > pd->pd_rxlen) pd->pd_rxerr |= __SERIALERR_OVERFLOW;
+		__eventSet(dv->dv_rxev);
+	}
+
+	if (!params->tx_dma && (irr & USART_FLAG_TXE))
 	{
 		pSERIAL->SR &= ~USART_FLAG_TXE;
 
@@ -227,20 +447,21 @@ __VOID __uartISR(__PVOID pVoid)
 		}
 	}
 
-	if (irr & USART_FLAG_RXNE)
-	{
-		*(pd->pd_rxbuf + pd->pd_rcidx) = __uartCharInput(dv);
-		if (++pd->pd_rcidx >= pd->pd_rxlen) pd->pd_rcidx = 0;
-		if (++pd->pd_rxcnt > pd->pd_rxlen) pd->pd_rxerr |= __SERIALERR_OVERFLOW;
-		__eventSet(dv->dv_rxev);
-	}
-
 	__systemLeaveISR();
 }
 
 u8 __uartInitTx(__PDEVICE dv)
 {
 	USART_TypeDef* pSERIAL;
+
+	if (((UART_PARAMS*) dv->dv_params)->tx_dma)
+	{
+		__systemStop();
+		__uartDmaTxNext(dv);
+		__systemStart();
+		return __DEV_OK;
+	}
+
 	pSERIAL = ((UART_PARAMS*) dv->dv_params)->base_addr;
 	pSERIAL->CR1 |= USART_FLAG_TXE;
 
@@ -257,6 +478,7 @@ u8 __uartInitTx(__PDEVICE dv)
  * @param	code	IO control code.
  *
  * @arg	__SERIAL_PLAT_INIT_HW			Initialize hardware.
+ * @arg	__SERIAL_PLAT_DEINIT_HW			Stop the DMA streams.
  * @arg __SERIAL_PLAT_SET_BAUDRATE		Set baudrate.
  * @arg	__SERIAL_PLAT_CHAR_OUTPUT		Character output.
  * @arg	__SERIAL_PLAT_CHAR_INPUT		Character input.
@@ -280,6 +502,9 @@ i32 __serialPlatIoCtl(__PDEVICE dv, u32 code, u32 param, __PVOID in, u32 in_len,
 		case __SERIAL_PLAT_INIT_HW:
 			return __uartSetParameters(dv);
 
+		case __SERIAL_PLAT_DEINIT_HW:
+			return __uartResetDma(dv);
+
 		case __SERIAL_PLAT_CHAR_OUTPUT:
 			return __uartCharOutput(dv, (u8) param);
 
@@ -293,10 +518,18 @@ i32 __serialPlatIoCtl(__PDEVICE dv, u32 code, u32 param, __PVOID in, u32 in_len,
 
 		case __SERIAL_PLAT_SET_IRQ:
 			__intSetVector(dv->dv_txint,__uartISR,dv);
+			if (((UART_PARAMS*) dv->dv_params)->rx_dma)
+				__intSetVector(((UART_PARAMS*) dv->dv_params)->rx_dma_irq, __uartRxDmaISR, dv);
+			if (((UART_PARAMS*) dv->dv_params)->tx_dma)
+				__intSetVector(((UART_PARAMS*) dv->dv_params)->tx_dma_irq, __uartTxDmaISR, dv);
 			return __DEV_OK;
 
 		case __SERIAL_PLAT_RESET_IRQ:
 			__intSetVector(dv->dv_txint,__NULL,__NULL);
+			if (((UART_PARAMS*) dv->dv_params)->rx_dma)
+				__intSetVector(((UART_PARAMS*) dv->dv_params)->rx_dma_irq, __NULL, __NULL);
+			if (((UART_PARAMS*) dv->dv_params)->tx_dma)
+				__intSetVector(((UART_PARAMS*) dv->dv_params)->tx_dma_irq, __NULL, __NULL);
 			return __DEV_OK;
 
 		case __SERIAL_PLAT_SET_PARITY:
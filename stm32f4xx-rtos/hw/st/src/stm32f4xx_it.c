@@ -67,10 +67,11 @@ void HardFault_Handler(void)
 
 /**
   * @brief  This function handles Memory Manage exception.
+  *         Weak: plat_cpu.c replaces it when __CONFIG_STACK_GUARD is set.
   * @param  None
   * @retval None
   */
-void MemManage_Handler(void)
+__attribute__((weak)) void MemManage_Handler(void)
 {
   /* Go to infinite loop when Memory Manage exception occurs */
   while (1)
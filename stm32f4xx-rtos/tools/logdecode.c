@@ -0,0 +1,227 @@
+/***************************************************************************
+ * logdecode.c
+ * (C) 2010 Ivan Meleca
+ * Based on original code written by Ruben Meleca
+ * www.milos.it
+
+#   This program is free software; you can redistribute it and/or modify
+#   it under the terms of the GNU General Public License as published by
+#   the Free Software Foundation; either version 2 of the License, or
+#   (at your option) any later version.
+#
+#   This program is distributed in the hope that it will be useful,
+#   but WITHOUT ANY WARRANTY; without even the implied warranty of
+#   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#   GNU General Public License for more details.
+#
+#   You should have received a copy of the GNU General Public License
+#   along with this program; if not, write to the Free Software
+#   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+***************************************************************************/
+
+/*
+ * Host decoder of the binary log (core/src/log.c).
+ *
+ * Reads a __logSnapshot() image, taken by the application or dumped from the
+ * target memory by a debugger, and prints its records as text:
+ *
+ *   logdecode snapshot.bin
+ *
+ * Each line shows the time since the first record, the level, the module
+ * and the formatted text. Arguments are 32 bit words: %s arguments point to
+ * the target memory and are shown as addresses.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#define LOG_MAGIC			0x31474F4C		/* "LOG1" */
+#define LOG_HEADER_WORDS	6
+
+#define HDR_ID(h)			((h) >> 16)
+#define HDR_MODULE(h)		(((h) >> 8) & 0xFF)
+#define HDR_LEVEL(h)		(((h) >> 5) & 0x07)
+#define HDR_ARGS(h)			((h) & 0x0F)
+
+/*
+ * Little-endian word of the snapshot.
+ */
+static uint32_t word(const unsigned char* p)
+{
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t) p[3] << 24);
+}
+
+/*
+ * Prints the text of a record, a printf() format with 32 bit arguments.
+ * Length modifiers are dropped, the host int is 32 bits wide.
+ */
+static void print_record(const char* fmt, const uint32_t* args, uint32_t nargs)
+{
+	char spec[32];
+	uint32_t n = 0, arg;
+	size_t len;
+
+	while (*fmt)
+	{
+		if (*fmt != '%')
+		{
+			putchar(*fmt++);
+			continue;
+		}
+
+		if (fmt[1] == '%')
+		{
+			putchar('%');
+			fmt += 2;
+			continue;
+		}
+
+		/* Flags, width and precision are kept */
+		len = 0;
+		spec[len++] = *fmt++;
+		while (*fmt && strchr("-+ #0123456789.", *fmt) && len < sizeof(spec) - 2) spec[len++] = *fmt++;
+		while (*fmt && strchr("hlLqjzt", *fmt)) fmt++;
+		if (!*fmt) break;
+
+		arg = (n < nargs) ? args[n] : 0;
+		if (n++ >= nargs)
+		{
+			printf("<?>");
+			fmt++;
+			continue;
+		}
+
+		switch (*fmt)
+		{
+			case 'd':
+			case 'i':
+			case 'c':
+				spec[len++] = *fmt;
+				spec[len] = 0;
+				printf(spec, (int32_t) arg);
+				break;
+
+			case 'u':
+			case 'x':
+			case 'X':
+			case 'o':
+				spec[len++] = *fmt;
+				spec[len] = 0;
+				printf(spec, arg);
+				break;
+
+			case 's':
+				printf("<str %08X>", arg);
+				break;
+
+			case 'p':
+				printf("%08X", arg);
+				break;
+
+			default:
+				printf("<%%%c ?>", *fmt);
+				break;
+		}
+
+		fmt++;
+	}
+
+	putchar('\n');
+}
+
+int main(int argc, char** argv)
+{
+	static const char levels[] = "-EWID???";
+	uint32_t hz, modules, fmtlen, words, drops, hdr, stamp, last, i, args[16];
+	unsigned long long time = 0;
+	const unsigned char* rec;
+	const char* fmts;
+	unsigned char* buf;
+	long size;
+	FILE* f;
+
+	if (argc != 2)
+	{
+		fprintf(stderr, "usage: %s snapshot\n", argv[0]);
+		return 2;
+	}
+
+	f = fopen(argv[1], "rb");
+	if (!f)
+	{
+		perror(argv[1]);
+		return 1;
+	}
+
+	fseek(f, 0, SEEK_END);
+	size = ftell(f);
+	fseek(f, 0, SEEK_SET);
+
+	buf = malloc(size + 1);
+	if (!buf || fread(buf, 1, size, f) != (size_t) size)
+	{
+		fprintf(stderr, "%s: read error\n", argv[1]);
+		return 1;
+	}
+	fclose(f);
+	buf[size] = 0;
+
+	if (size < LOG_HEADER_WORDS * 4 || word(buf) != LOG_MAGIC)
+	{
+		fprintf(stderr, "%s: not a log snapshot\n", argv[1]);
+		return 1;
+	}
+
+	hz = word(buf + 4);
+	modules = word(buf + 8);
+	fmtlen = word(buf + 12);
+	words = word(buf + 16);
+	drops = word(buf + 20);
+
+	if (!hz || (unsigned long long) LOG_HEADER_WORDS * 4 + (modules + words) * 4ULL + fmtlen > (unsigned long) size)
+	{
+		fprintf(stderr, "%s: truncated snapshot\n", argv[1]);
+		return 1;
+	}
+
+	printf("# %u records dropped", drops);
+	for (i = 0; i < modules; i++)
+	{
+		if (word(buf + (LOG_HEADER_WORDS + i) * 4)) printf(", module %u: %u", i, word(buf + (LOG_HEADER_WORDS + i) * 4));
+	}
+	printf("\n");
+
+	fmts = (const char*) buf + (LOG_HEADER_WORDS + modules) * 4;
+	rec = (const unsigned char*) fmts + fmtlen;
+	last = words ? word(rec + 4) : 0;
+
+	while (words >= 2)
+	{
+		hdr = word(rec);
+		if (HDR_ARGS(hdr) + 2 > words || HDR_ID(hdr) >= fmtlen)
+		{
+			fprintf(stderr, "corrupted record\n");
+			return 1;
+		}
+
+		/* Timestamps wrap at 32 bits */
+		stamp = word(rec + 4);
+		time += (uint32_t) (stamp - last);
+		last = stamp;
+
+		for (i = 0; i < HDR_ARGS(hdr); i++) args[i] = word(rec + 8 + i * 4);
+
+		printf("[%5llu.%06llu] %c %u: ", time / hz, (time % hz) * 1000000 / hz,
+				levels[HDR_LEVEL(hdr)], HDR_MODULE(hdr));
+		print_record(fmts + HDR_ID(hdr), args, HDR_ARGS(hdr));
+
+		words -= HDR_ARGS(hdr) + 2;
+		rec += (HDR_ARGS(hdr) + 2) * 4;
+	}
+
+	free(buf);
+	return 0;
+}